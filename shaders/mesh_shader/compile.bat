@@ -1,4 +1,5 @@
 glslc base.task -o SPIR-V/base.task.spv --target-spv=spv1.4
 glslc base.mesh -o SPIR-V/base.mesh.spv --target-spv=spv1.4
+glslc packed.mesh -o SPIR-V/packed.mesh.spv --target-spv=spv1.4
 glslc base.frag -o SPIR-V/base.frag.spv
 pause
\ No newline at end of file
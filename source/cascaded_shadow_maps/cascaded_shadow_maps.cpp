@@ -16,7 +16,10 @@ CascadedShadowMapsDemo::CascadedShadowMapsDemo() :
 	vk_sampler_scene_(VK_NULL_HANDLE),
 	vk_shadow_map_depth_format_(VK_FORMAT_D16_UNORM),
 	vk_render_pass_depth_(VK_NULL_HANDLE),
-	mvp_buffer_size_(sizeof(glm::mat4)),
+	uniform_ring_(this),
+	ring_mvp_(0),
+	ring_viewer_(0),
+	ring_cas_(0),
 	terrain_edge_length_(1.0f),
 	tree_(this),
 	tree_scale_(1.0f),
@@ -69,6 +72,8 @@ CascadedShadowMapsDemo::CascadedShadowMapsDemo() :
 	z_near_ = 1.0f;
 	z_far_ = 128.0f;	// 128 1024
 
+	cfg_frame_uniform_copies_ = true;	// the matrices of Update are in uniform_ring_
+
 	memset(&ubo_cas_, 0, sizeof(ubo_cas_));
 
 	memset(&shadow_maps_, 0, sizeof(shadow_maps_));
@@ -77,15 +82,11 @@ CascadedShadowMapsDemo::CascadedShadowMapsDemo() :
 	memset(&texture_detail_, 0, sizeof(texture_detail_));
 	memset(&vk_image_depth_, 0, sizeof(vk_image_depth_));
 
-	memset(&uniform_buffer_depth_mvp_list_, 0, sizeof(uniform_buffer_depth_mvp_list_));
 	memset(&uniform_buffer_overlay_mvp_, 0, sizeof(uniform_buffer_overlay_mvp_));
-	memset(&uniform_buffer_mvp_, 0, sizeof(uniform_buffer_mvp_));
 	memset(&uniform_buffer_model_matrix_, 0, sizeof(uniform_buffer_model_matrix_));
-	memset(&uniform_buffer_viewer_, 0, sizeof(uniform_buffer_viewer_));
 	memset(&uniform_buffer_terrain_, 0, sizeof(uniform_buffer_terrain_));
 	memset(&uniform_buffer_directional_light_, 0, sizeof(uniform_buffer_directional_light_));
 	memset(&uniform_buffer_fog_, 0, sizeof(uniform_buffer_fog_));
-	memset(&uniform_buffer_cas_, 0, sizeof(uniform_buffer_cas_));
 
 	memset(&terrain_, 0, sizeof(terrain_));
 	memset(&instance_buffer_, 0, sizeof(instance_buffer_));
@@ -107,15 +108,13 @@ CascadedShadowMapsDemo::~CascadedShadowMapsDemo() {
 
 bool CascadedShadowMapsDemo::Init() {
 	if (!VkDemo::Init("cascaded_shadow_maps" /* shader files directory */,
-		64, 0, 16, 64)) {
+		64, 0, 16, 64, 16)) {
 		return false;
 	}
 
 	vk_shadow_map_depth_format_ = GetIdealDepthFormat();
 	printf("vk_shadow_map_depth_format_ = %s\n", Vk_FormatToStr(vk_shadow_map_depth_format_));
 
-	mvp_buffer_size_ = (uint32_t)GetAlignedMinOffsetSize(sizeof(ubo_mat_s));
-
 	// init textur tiles
 	Str_SPrintf(texture_tiles_.lowest_, MAX_PATH, "%s/terrain/lowestTile.tga", textures_dir_);
 	Str_SPrintf(texture_tiles_.low_, MAX_PATH, "%s/terrain/lowTile.tga", textures_dir_);
@@ -375,15 +374,20 @@ void CascadedShadowMapsDemo::WindowSizeChanged() {
 	OnViewportChanged();
 }
 
+bool CascadedShadowMapsDemo::SwapchainImageCountChanged() {
+	// a ring copy per image, the sets on the ring are written again
+	if (!uniform_ring_.Resize()) {
+		return false;
+	}
+
+	FreeDescriptorSets();
+
+	return AllocDescriptorSets();
+}
+
 void CascadedShadowMapsDemo::Update() {
 	UpdateMVPViewerUniformBuffers();
 
-	char* buf = (char*)MapBuffer(uniform_buffer_depth_mvp_list_);
-	if (!buf) {
-		return;	// error
-	}
-	char* cur_buf = buf;
-
 	float w_over_h = (float)cfg_viewport_cx_ / cfg_viewport_cy_;
 
 	for (uint32_t i = 0; i < SHADOW_MAP_COUNT; i++) {
@@ -423,15 +427,11 @@ void CascadedShadowMapsDemo::Update() {
 			-frustom_radius, frustom_radius,
 			0.0f, frustom_radius * 2.0f);
 
-		ubo_mat_s* ubo_mat = (ubo_mat_s*)cur_buf;
+		ubo_mat_s* ubo_mat = (ubo_mat_s*)uniform_ring_.GetFrameData(shadow_maps_[i].ring_light_vp_);
 		ubo_cas_.light_vp[i] = ubo_mat->matrix_ = light_proj_mat * light_view_mat;
-
-		cur_buf += mvp_buffer_size_;
 	}
 
-	UnmapBuffer(uniform_buffer_depth_mvp_list_);
-
-	UpdateBuffer(uniform_buffer_cas_, &ubo_cas_, sizeof(ubo_cas_));
+	uniform_ring_.Write(ring_cas_, &ubo_cas_, sizeof(ubo_cas_));
 }
 
 void CascadedShadowMapsDemo::FuncKeyDown(uint32_t key) {
@@ -726,29 +726,31 @@ bool CascadedShadowMapsDemo::CreateDepthFramebuffers() {
 
 // uniform buffer
 bool CascadedShadowMapsDemo::CreateUniformBuffers() {
-	uint32_t ubo_buf_depth_mvp_lst_sz = mvp_buffer_size_ * SHADOW_MAP_COUNT;
-	uint32_t ubo_buf_overlay_mvp_lst_sz = mvp_buffer_size_ * SHADOW_MAP_COUNT;
+	size_t ring_copy_size =
+		GetAlignedMinOffsetSize(sizeof(ubo_mat_s)) * SHADOW_MAP_COUNT +
+		GetAlignedMinOffsetSize(sizeof(ubo_mvp_sep_s)) +
+		GetAlignedMinOffsetSize(sizeof(ubo_viewer_s)) +
+		GetAlignedMinOffsetSize(sizeof(ubo_cas_s));
 
-	return CreateBuffer(uniform_buffer_depth_mvp_list_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			ubo_buf_depth_mvp_lst_sz) &&
-		CreateBuffer(uniform_buffer_overlay_mvp_,
+	if (!uniform_ring_.Init(ring_copy_size)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < SHADOW_MAP_COUNT; ++i) {
+		shadow_maps_[i].ring_light_vp_ = uniform_ring_.Alloc(sizeof(ubo_mat_s));
+	}
+	ring_mvp_ = uniform_ring_.Alloc(sizeof(ubo_mvp_sep_s));
+	ring_viewer_ = uniform_ring_.Alloc(sizeof(ubo_viewer_s));
+	ring_cas_ = uniform_ring_.Alloc(sizeof(ubo_cas_s));
+
+	return CreateBuffer(uniform_buffer_overlay_mvp_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 			sizeof(ubo_mat_s)) &&
-		CreateBuffer(uniform_buffer_mvp_, 
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_mvp_sep_s)) &&
 		CreateBuffer(uniform_buffer_model_matrix_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			sizeof(ubo_mat_s)) &&
-		CreateBuffer(uniform_buffer_viewer_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_viewer_s)) &&
 		CreateBuffer(uniform_buffer_terrain_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -760,23 +762,16 @@ bool CascadedShadowMapsDemo::CreateUniformBuffers() {
 		CreateBuffer(uniform_buffer_fog_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_fog_s)) &&
-		CreateBuffer(uniform_buffer_cas_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_cas_s));
+			sizeof(ubo_fog_s));
 }
 
 void CascadedShadowMapsDemo::DestroyUniformBuffers() {
-	DestroyBuffer(uniform_buffer_cas_);
 	DestroyBuffer(uniform_buffer_fog_);
 	DestroyBuffer(uniform_buffer_directional_light_);
 	DestroyBuffer(uniform_buffer_terrain_);
-	DestroyBuffer(uniform_buffer_viewer_);
 	DestroyBuffer(uniform_buffer_model_matrix_);
-	DestroyBuffer(uniform_buffer_mvp_);
 	DestroyBuffer(uniform_buffer_overlay_mvp_);
-	DestroyBuffer(uniform_buffer_depth_mvp_list_);
+	uniform_ring_.Shutdown();
 }
 
 // vertex buffer
@@ -866,7 +861,7 @@ bool CascadedShadowMapsDemo::CreateDescSetLayout_Depth() {
 
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT);
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT);	// light vp
 	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 1, VK_SHADER_STAGE_VERTEX_BIT);
 
 	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -900,8 +895,8 @@ bool CascadedShadowMapsDemo::CreateDescSetLayout_MVPViewerDepthTex() {
 
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
 	Vk_PushDescriptorSetLayoutBinding_Tex(bindings, 2, VK_SHADER_STAGE_FRAGMENT_BIT);
 
 	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -991,8 +986,8 @@ bool CascadedShadowMapsDemo::CreateDescSetLayout_Cas() {
 
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	// ubo_terrain
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 0, VK_SHADER_STAGE_FRAGMENT_BIT);
+	// ubo_cas
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 0, VK_SHADER_STAGE_FRAGMENT_BIT);
 
 	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	create_info.pNext = nullptr;
@@ -1048,8 +1043,8 @@ bool CascadedShadowMapsDemo::AllocDescriptorSets() {
 		Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_terrain_tex_, 0, texture_terrain_);
 		Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_terrain_tex_, 1, texture_detail_);
 
-		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_depth_tex_, 0, uniform_buffer_mvp_.buffer_, 0, uniform_buffer_mvp_.memory_size_);
-		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_depth_tex_, 1, uniform_buffer_viewer_.buffer_, 0, uniform_buffer_viewer_.memory_size_);
+		Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_depth_tex_, 0, uniform_ring_.GetBuffer(), sizeof(ubo_mvp_sep_s));
+		Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_depth_tex_, 1, uniform_ring_.GetBuffer(), sizeof(ubo_viewer_s));
 		Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_mvp_viewer_depth_tex_, 2, vk_image_depth_);
 
 		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_light_, 0, uniform_buffer_directional_light_.buffer_, 0, uniform_buffer_directional_light_.memory_size_);
@@ -1061,7 +1056,7 @@ bool CascadedShadowMapsDemo::AllocDescriptorSets() {
 		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_overlay_, 0, uniform_buffer_overlay_mvp_.buffer_, 0, uniform_buffer_overlay_mvp_.memory_size_);
 		Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_overlay_, 1, vk_image_depth_);
 
-		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_cas_, 0, uniform_buffer_cas_.buffer_, 0, uniform_buffer_cas_.memory_size_);
+		Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_cas_, 0, uniform_ring_.GetBuffer(), sizeof(ubo_cas_s));
 
 		vkUpdateDescriptorSets(vk_device_,
 			(uint32_t)buffer.write_descriptor_sets_.size(), buffer.write_descriptor_sets_.data(), 0, nullptr);
@@ -1093,10 +1088,7 @@ bool CascadedShadowMapsDemo::AllocDescriptorSets() {
 
 		for (uint32_t i = 0; i < SHADOW_MAP_COUNT; ++i) {
 			shadow_maps_[i].desc_set_ = sets[i];
-			Vk_PushWriteDescriptorSet_UBO(buffer, sets[i], 0,
-				uniform_buffer_depth_mvp_list_.buffer_,
-				mvp_buffer_size_ * i,
-				mvp_buffer_size_);
+			Vk_PushWriteDescriptorSet_DynamicUBO(buffer, sets[i], 0, uniform_ring_.GetBuffer(), sizeof(ubo_mat_s));
 			Vk_PushWriteDescriptorSet_UBO(buffer, sets[i], 1, 
 				uniform_buffer_model_matrix_.buffer_, 0, uniform_buffer_model_matrix_.memory_size_);
 		}
@@ -1652,12 +1644,12 @@ void CascadedShadowMapsDemo::UpdateTerrain() {
 void CascadedShadowMapsDemo::BuildCommandBuffer(const scene_pipelines_s& scene_pipelines) {
 	uint32_t sz_draw_cmd_buffer = (uint32_t)vk_draw_cmd_buffer_count_;
 	for (uint32_t i = 0; i < sz_draw_cmd_buffer; ++i) {
-		BuildOneCommandBuffer(vk_draw_cmd_buffers_[i], vk_framebuffers_[i], scene_pipelines);
+		BuildOneCommandBuffer(vk_draw_cmd_buffers_[i], i, vk_framebuffers_[i], scene_pipelines);
 	}
 }
 
 void CascadedShadowMapsDemo::BuildOneCommandBuffer(
-	VkCommandBuffer cmd_buf, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines)
+	VkCommandBuffer cmd_buf, uint32_t image, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines)
 {
 	VkCommandBufferBeginInfo cmd_buf_begin_info = {};
 
@@ -1668,8 +1660,8 @@ void CascadedShadowMapsDemo::BuildOneCommandBuffer(
 
 	vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info);
 
-	BuildCommandBuffer_DepthPasses(cmd_buf);
-	BuildCommandBuffer_ScenePass(cmd_buf, scene_fb, scene_pipelines);
+	BuildCommandBuffer_DepthPasses(cmd_buf, image);
+	BuildCommandBuffer_ScenePass(cmd_buf, image, scene_fb, scene_pipelines);
 
 	VkResult rt = vkEndCommandBuffer(cmd_buf);
 	if (rt != VK_SUCCESS) {
@@ -1677,15 +1669,22 @@ void CascadedShadowMapsDemo::BuildOneCommandBuffer(
 	}
 }
 
-void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPasses(VkCommandBuffer cmd_buf) {
+void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPasses(VkCommandBuffer cmd_buf, uint32_t image) {
 	for (uint32_t i = 0; i < SHADOW_MAP_COUNT; ++i) {
-		BuildCommandBuffer_DepthPass(cmd_buf, shadow_maps_[i]);
+		BuildCommandBuffer_DepthPass(cmd_buf, image, shadow_maps_[i]);
 	}
 }
 
 void CascadedShadowMapsDemo::BuildCommandBuffer_ScenePass(
-	VkCommandBuffer cmd_buf, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines)
+	VkCommandBuffer cmd_buf, uint32_t image, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines)
 {
+	// set 0: mvp, viewer, set 5: cas
+	std::array<uint32_t, 3> dynamic_offsets = {
+		uniform_ring_.GetDynamicOffset(ring_mvp_, image),
+		uniform_ring_.GetDynamicOffset(ring_viewer_, image),
+		uniform_ring_.GetDynamicOffset(ring_cas_, image)
+	};
+
 	VkRenderPassBeginInfo render_pass_begin_info = {};
 
 	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1743,7 +1742,7 @@ void CascadedShadowMapsDemo::BuildCommandBuffer_ScenePass(
 
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			vk_pipeline_layout_terrain_, 0, (uint32_t)descriptor_sets.size(),
-			descriptor_sets.data(), 0, nullptr);
+			descriptor_sets.data(), (uint32_t)dynamic_offsets.size(), dynamic_offsets.data());
 
 		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, scene_pipelines.pipeline_terrain_);
 
@@ -1800,7 +1799,8 @@ void CascadedShadowMapsDemo::BuildCommandBuffer_ScenePass(
 
 			vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 				vk_pipeline_layout_vegetation_, 0,
-				(uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+				(uint32_t)descriptor_sets.size(), descriptor_sets.data(),
+				(uint32_t)dynamic_offsets.size(), dynamic_offsets.data());
 
 			if (vk_mat->vk_texture_.image_) {
 				// texture
@@ -1852,7 +1852,7 @@ void CascadedShadowMapsDemo::BuildCommandBuffer_ScenePass(
 	vkCmdEndRenderPass(cmd_buf);
 }
 
-void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_buf, const shadow_map_s& shadow_map) {
+void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_buf, uint32_t image, const shadow_map_s& shadow_map) {
 	VkRenderPassBeginInfo render_pass_begin_info = {};
 
 	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1895,12 +1895,13 @@ void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_bu
 
 	VkDescriptorSet descriptor_sets[1] = {};
 	VkDeviceSize offset[1] = { 0 };
+	uint32_t light_vp_offset = uniform_ring_.GetDynamicOffset(shadow_map.ring_light_vp_, image);
 
 	// draw terrain
 	descriptor_sets[0] = shadow_map.desc_set_;
 
 	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-		vk_pipeline_layout_depth_, 0, 1, descriptor_sets, 0, nullptr);
+		vk_pipeline_layout_depth_, 0, 1, descriptor_sets, 1, &light_vp_offset);
 
 	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_depth_terrain_);
 
@@ -1948,7 +1949,7 @@ void CascadedShadowMapsDemo::BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_bu
 
 			vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 				vk_pipeline_layout_depth_, 0,
-				(uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+				(uint32_t)descriptor_sets.size(), descriptor_sets.data(), 1, &light_vp_offset);
 
 			if (vk_mat->vk_texture_.image_) {
 				// texture
@@ -1986,13 +1987,13 @@ void CascadedShadowMapsDemo::UpdateMVPViewerUniformBuffers() {
 
 	ubo_cas_.inv_view_mvp_ = glm::inverse(mvp);
 
-	UpdateBuffer(uniform_buffer_mvp_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
+	uniform_ring_.Write(ring_mvp_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
 
 	ubo_viewer_s ubo_viewer = {};
 
 	ubo_viewer.pos_ = glm::vec4(camera_.pos_, 1.0f);
 
-	UpdateBuffer(uniform_buffer_viewer_, &ubo_viewer, sizeof(ubo_viewer));
+	uniform_ring_.Write(ring_viewer_, &ubo_viewer, sizeof(ubo_viewer));
 
 	for (uint32_t i = 0; i < SHADOW_MAP_COUNT; i++) {
 		float f = shadow_maps_[i].z_far_;
@@ -2041,9 +2042,9 @@ void CascadedShadowMapsDemo::SetupFogUniformBuffer() {
 
 void CascadedShadowMapsDemo::CalcLightDir(glm::vec3& light_dir) const {
 	float r = glm::radians(light_angle_);
-	light_dir.x = -std::cosf(r);
+	light_dir.x = -cosf(r);
 	light_dir.y = 0.0f;
-	light_dir.z = -std::sinf(r);
+	light_dir.z = -sinf(r);
 }
 
 void CascadedShadowMapsDemo::UpdateSkyColor() {
@@ -18,6 +18,7 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					WindowSizeChanged() override;
+	bool					SwapchainImageCountChanged() override;
 	void					Update() override;
 
 protected:
@@ -49,6 +50,7 @@ private:
 
 	struct shadow_map_s {
 		VkDescriptorSet		desc_set_;
+		uint32_t			ring_light_vp_;		// range of uniform_ring_
 		VkImageView			depth_image_view_;
 		VkFramebuffer		framebuffer_;
 		float				z_near_;
@@ -71,18 +73,18 @@ private:
 	VkFormat				vk_shadow_map_depth_format_;
 	VkRenderPass			vk_render_pass_depth_;
 
-	uint32_t				mvp_buffer_size_;	// each mvp matrix needed size in VkBuffer
-
-	vk_buffer_s				uniform_buffer_depth_mvp_list_;
 	vk_buffer_s				uniform_buffer_overlay_mvp_;
 
-	vk_buffer_s				uniform_buffer_mvp_;
 	vk_buffer_s				uniform_buffer_model_matrix_;
-	vk_buffer_s				uniform_buffer_viewer_;
 	vk_buffer_s				uniform_buffer_terrain_;
 	vk_buffer_s				uniform_buffer_directional_light_;
 	vk_buffer_s				uniform_buffer_fog_;
-	vk_buffer_s				uniform_buffer_cas_;
+
+	// rewritten every frame, ranges of uniform_ring_, the light matrices are in shadow_maps_
+	VkUniformRing			uniform_ring_;
+	uint32_t				ring_mvp_;
+	uint32_t				ring_viewer_;
+	uint32_t				ring_cas_;
 
 	// terrain
 	float					terrain_edge_length_;
@@ -96,14 +98,14 @@ private:
 	vk_buffer_s				overlay_vertex_buffer_;
 
 	// descriptor
-	VkDescriptorSetLayout	vk_desc_set_layout_depth_;
+	VkDescriptorSetLayout	vk_desc_set_layout_depth_;	// binding 0: dynamic
 	VkDescriptorSetLayout	vk_desc_set_layout_overlay_;
-	VkDescriptorSetLayout	vk_desc_set_layout_mvp_viewer_depth_tex_;
+	VkDescriptorSetLayout	vk_desc_set_layout_mvp_viewer_depth_tex_;	// bindings 0, 1: dynamic
 	VkDescriptorSetLayout	vk_desc_set_layout_terrain_tex_;
 	VkDescriptorSetLayout	vk_desc_set_layout_material_texture_;	// model
 	VkDescriptorSetLayout	vk_desc_set_layout_bind0_ubo_;
 	VkDescriptorSetLayout   vk_desc_set_layout_terrain_;
-	VkDescriptorSetLayout	vk_desc_set_layout_cas_;
+	VkDescriptorSetLayout	vk_desc_set_layout_cas_;	// dynamic
 
 	VkDescriptorSet			vk_desc_set_overlay_;
 	VkDescriptorSet			vk_desc_set_terrain_tex_;
@@ -215,12 +217,13 @@ private:
 	// build command buffer
 	void					BuildCommandBuffer(const scene_pipelines_s& scene_pipelines);
 	
+	// image: the copy of uniform_ring_ the command buffer reads
 	void					BuildOneCommandBuffer(
-								VkCommandBuffer cmd_buf, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines);
-	void					BuildCommandBuffer_DepthPasses(VkCommandBuffer cmd_buf);
+								VkCommandBuffer cmd_buf, uint32_t image, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines);
+	void					BuildCommandBuffer_DepthPasses(VkCommandBuffer cmd_buf, uint32_t image);
 	void					BuildCommandBuffer_ScenePass(
-								VkCommandBuffer cmd_buf, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines);
-	void					BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_buf, const shadow_map_s & shadow_map);
+								VkCommandBuffer cmd_buf, uint32_t image, VkFramebuffer scene_fb, const scene_pipelines_s& scene_pipelines);
+	void					BuildCommandBuffer_DepthPass(VkCommandBuffer cmd_buf, uint32_t image, const shadow_map_s & shadow_map);
 
 	void					UpdateMVPViewerUniformBuffers();
 	void					SetupTerrainUniformBuffer();
@@ -0,0 +1,2181 @@
+/******************************************************************************
+ block compression: BC1 ~ BC7 formats and their CPU decoders
+
+   blocks are 4x4 texels, 8 bytes (BC1, BC4) or 16 bytes (the others),
+   decoders follow the D3D11 functional specification with integer exact
+   endpoint interpolation, BC1 / BC3 / BC4 / BC5 have SSE2 and AVX2 versions
+   giving the same bytes as the scalar ones, block rows decode in parallel
+
+   encoders for BC1 / BC3 / BC4 / BC5 / BC7 (modes 1 and 6) fit endpoints along
+   the principal axis of each block and refine them by least squares, the
+   quality presets trade search effort for error
+ *****************************************************************************/
+
+#include "inc.h"
+
+#if defined(CPU_X86)
+# include <immintrin.h>
+#endif
+
+// minimum blocks per job of Img_Decompress
+static const int BC_DECODE_MIN_BLOCKS = 4096;
+
+/*
+================================================================================
+formats
+================================================================================
+*/
+
+COMMON_API int Img_GetBlockBytes(image_format_t fmt) {
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:
+	case image_format_t::BC1_SRGB:
+	case image_format_t::BC4_UNORM:
+	case image_format_t::BC4_SNORM:
+		return 8;
+	case image_format_t::BC2_UNORM:
+	case image_format_t::BC2_SRGB:
+	case image_format_t::BC3_UNORM:
+	case image_format_t::BC3_SRGB:
+	case image_format_t::BC5_UNORM:
+	case image_format_t::BC5_SNORM:
+	case image_format_t::BC6H_UFLOAT:
+	case image_format_t::BC6H_SFLOAT:
+	case image_format_t::BC7_UNORM:
+	case image_format_t::BC7_SRGB:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+COMMON_API bool Img_IsCompressed(image_format_t fmt) {
+	return Img_GetBlockBytes(fmt) != 0;
+}
+
+static size_t Img_GetPixelBytes(image_format_t fmt) {
+	switch (fmt) {
+	case image_format_t::R8G8B8A8:
+		return 4;
+	case image_format_t::R16G16B16A16_FLOAT:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static int Img_GetLevelExtent(int size, int level) {
+	int extent = size >> level;
+	return extent > 0 ? extent : 1;
+}
+
+COMMON_API size_t Img_GetLevelSize(const image_s& image, int level) {
+	size_t w = (size_t)Img_GetLevelExtent(image.width_, level);
+	size_t h = (size_t)Img_GetLevelExtent(image.height_, level);
+
+	int block_bytes = Img_GetBlockBytes(image.format_);
+	if (block_bytes) {
+		return ((w + 3) >> 2) * ((h + 3) >> 2) * block_bytes;
+	}
+	else {
+		return w * h * Img_GetPixelBytes(image.format_);
+	}
+}
+
+COMMON_API size_t Img_GetSubresourceOffset(const image_s& image, int layer, int level) {
+	int mip_levels = image.mip_levels_ > 1 ? image.mip_levels_ : 1;
+
+	size_t layer_size = 0;
+	size_t level_offset = 0;
+	for (int i = 0; i < mip_levels; ++i) {
+		size_t level_size = Img_GetLevelSize(image, i);
+		level_offset += i < level ? level_size : 0;
+		layer_size += level_size;
+	}
+
+	return layer_size * layer + level_offset;
+}
+
+COMMON_API size_t Img_GetDataSize(const image_s& image) {
+	int array_layers = image.array_layers_ > 1 ? image.array_layers_ : 1;
+	return Img_GetSubresourceOffset(image, array_layers, 0);
+}
+
+/*
+================================================================================
+BC1 ~ BC5
+================================================================================
+*/
+
+static uint16_t BC_Read16(const byte_t* p) {
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t BC_Read32(const byte_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// color block, 16 RGBA texels to rgba
+//   BC1 switches to 3 colors + transparent black when color0 <= color1,
+//   BC2 and BC3 always use 4 colors
+static void BC1_DecodeColors(const byte_t* block, byte_t* rgba, bool allow_transparent) {
+	uint16_t c0 = BC_Read16(block);
+	uint16_t c1 = BC_Read16(block + 2);
+	uint32_t indices = BC_Read32(block + 4);
+
+	byte_t colors[4][4];
+
+	auto Expand565 = [](uint16_t c, byte_t color[4]) {
+		uint32_t r = (c >> 11) & 31;
+		uint32_t g = (c >> 5) & 63;
+		uint32_t b = c & 31;
+		color[0] = (byte_t)((r << 3) | (r >> 2));
+		color[1] = (byte_t)((g << 2) | (g >> 4));
+		color[2] = (byte_t)((b << 3) | (b >> 2));
+		color[3] = 255;
+	};
+
+	Expand565(c0, colors[0]);
+	Expand565(c1, colors[1]);
+
+	if (c0 > c1 || !allow_transparent) {
+		for (int k = 0; k < 3; ++k) {
+			colors[2][k] = (byte_t)((2 * colors[0][k] + colors[1][k] + 1) / 3);
+			colors[3][k] = (byte_t)((colors[0][k] + 2 * colors[1][k] + 1) / 3);
+		}
+		colors[2][3] = colors[3][3] = 255;
+	}
+	else {
+		for (int k = 0; k < 3; ++k) {
+			colors[2][k] = (byte_t)((colors[0][k] + colors[1][k] + 1) / 2);
+		}
+		colors[2][3] = 255;
+		colors[3][0] = colors[3][1] = colors[3][2] = colors[3][3] = 0;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		memcpy(rgba + i * 4, colors[(indices >> (i * 2)) & 3], 4);
+	}
+}
+
+// BC4 block (BC3 alpha, BC5 red / green), 16 values to dst[i * stride]
+static void BC4_DecodeChannel(const byte_t* block, byte_t* dst, int stride, bool snorm) {
+	int values[8];
+
+	if (snorm) {
+		int a0 = (int8_t)block[0];
+		int a1 = (int8_t)block[1];
+		a0 = a0 < -127 ? -127 : a0;
+		a1 = a1 < -127 ? -127 : a1;
+
+		auto Lerp = [](int a, int b, int wa, int wb, int d) -> int {
+			int t = a * wa + b * wb;
+			return (t + (t >= 0 ? d / 2 : -d / 2)) / d;	// round half away from zero
+		};
+
+		values[0] = a0;
+		values[1] = a1;
+		if (a0 > a1) {
+			for (int i = 1; i < 7; ++i) {
+				values[i + 1] = Lerp(a0, a1, 7 - i, i, 7);
+			}
+		}
+		else {
+			for (int i = 1; i < 5; ++i) {
+				values[i + 1] = Lerp(a0, a1, 5 - i, i, 5);
+			}
+			values[6] = -127;
+			values[7] = 127;
+		}
+	}
+	else {
+		int a0 = block[0];
+		int a1 = block[1];
+
+		values[0] = a0;
+		values[1] = a1;
+		if (a0 > a1) {
+			for (int i = 1; i < 7; ++i) {
+				values[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+			}
+		}
+		else {
+			for (int i = 1; i < 5; ++i) {
+				values[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			}
+			values[6] = 0;
+			values[7] = 255;
+		}
+	}
+
+	// 48 bits of 3 bit indices
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i) {
+		indices |= (uint64_t)block[2 + i] << (i * 8);
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		dst[i * stride] = (byte_t)values[(indices >> (i * 3)) & 7];
+	}
+}
+
+static void BC1_DecodeBlock(const byte_t* block, byte_t* rgba) {
+	BC1_DecodeColors(block, rgba, true);
+}
+
+static void BC2_DecodeBlock(const byte_t* block, byte_t* rgba) {
+	BC1_DecodeColors(block + 8, rgba, false);
+
+	for (int i = 0; i < 16; ++i) {
+		uint32_t a = (block[i >> 1] >> ((i & 1) * 4)) & 15;
+		rgba[i * 4 + 3] = (byte_t)(a * 17);
+	}
+}
+
+static void BC3_DecodeBlock(const byte_t* block, byte_t* rgba) {
+	BC1_DecodeColors(block + 8, rgba, false);
+	BC4_DecodeChannel(block, rgba + 3, 4, false);
+}
+
+// the channels BC4 and BC5 don't store are 0, alpha is 1 (127 in SNORM)
+static void BC4_DecodeBlock(const byte_t* block, byte_t* rgba, bool snorm) {
+	for (int i = 0; i < 16; ++i) {
+		rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+		rgba[i * 4 + 3] = snorm ? 127 : 255;
+	}
+
+	BC4_DecodeChannel(block, rgba, 4, snorm);
+}
+
+static void BC5_DecodeBlock(const byte_t* block, byte_t* rgba, bool snorm) {
+	for (int i = 0; i < 16; ++i) {
+		rgba[i * 4 + 2] = 0;
+		rgba[i * 4 + 3] = snorm ? 127 : 255;
+	}
+
+	BC4_DecodeChannel(block, rgba, 4, snorm);
+	BC4_DecodeChannel(block + 8, rgba + 1, 4, snorm);
+}
+
+#if defined(CPU_X86)
+
+/*
+================================================================================
+BC1 ~ BC5 SSE2 / AVX2
+================================================================================
+*/
+
+// color0 color1 color2 color3 of a BC1 color block as 4 RGBA8 lanes
+static __m128i BC1_Palette_SSE2(const byte_t* block, bool allow_transparent) {
+	uint16_t c0 = BC_Read16(block);
+	uint16_t c1 = BC_Read16(block + 2);
+
+	auto Expand565 = [](uint16_t c, short rgba[4]) {
+		int r = (c >> 11) & 31;
+		int g = (c >> 5) & 63;
+		int b = c & 31;
+		rgba[0] = (short)((r << 3) | (r >> 2));
+		rgba[1] = (short)((g << 2) | (g >> 4));
+		rgba[2] = (short)((b << 3) | (b >> 2));
+		rgba[3] = 255;
+	};
+
+	short e0[4], e1[4];
+	Expand565(c0, e0);
+	Expand565(c1, e1);
+
+	// 16 bit lanes: color0 color1, the same swapped
+	__m128i a = _mm_setr_epi16(e0[0], e0[1], e0[2], e0[3], e1[0], e1[1], e1[2], e1[3]);
+	__m128i b = _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2));
+
+	__m128i c23;
+	if (c0 > c1 || !allow_transparent) {
+		// (2a + b + 1) / 3, exact for 0 ~ 766 as multiply by 21846 / 65536
+		__m128i t = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(a, a), b), _mm_set1_epi16(1));
+		c23 = _mm_mulhi_epu16(t, _mm_set1_epi16(21846));
+	}
+	else {
+		// (a + b + 1) / 2, then transparent black
+		c23 = _mm_and_si128(_mm_avg_epu16(a, b), _mm_setr_epi32(-1, -1, 0, 0));
+	}
+
+	return _mm_packus_epi16(a, c23);
+}
+
+// 4 rows of 4 RGBA texels, BC1 colors
+static void BC1_DecodeColors_SSE2(const byte_t* block, bool allow_transparent, __m128i rows[4]) {
+	__m128i palette = BC1_Palette_SSE2(block, allow_transparent);
+	uint32_t indices = BC_Read32(block + 4);
+
+	__m128i colors[4] = {
+		_mm_shuffle_epi32(palette, 0x00),
+		_mm_shuffle_epi32(palette, 0x55),
+		_mm_shuffle_epi32(palette, 0xaa),
+		_mm_shuffle_epi32(palette, 0xff)
+	};
+
+	// 2 bit index of texel x stays at bits 2x ~ 2x + 1 of its lane
+	const __m128i MASK = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+	const __m128i UNIT = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+
+	for (int y = 0; y < 4; ++y) {
+		__m128i idx = _mm_and_si128(_mm_set1_epi32((int)(indices >> (y * 8))), MASK);
+
+		__m128i row = _mm_and_si128(_mm_cmpeq_epi32(idx, _mm_setzero_si128()), colors[0]);
+		__m128i k = UNIT;
+		for (int i = 1; i < 4; ++i) {
+			row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(idx, k), colors[i]));
+			k = _mm_add_epi32(k, UNIT);
+		}
+
+		rows[y] = row;
+	}
+}
+
+// indices shifted per lane, colors picked by a dword permute, 2 rows at once
+TARGET_AVX2 static void BC1_DecodeColors_AVX2(const byte_t* block, bool allow_transparent, __m128i rows[4]) {
+	__m256i palette = _mm256_broadcastsi128_si256(BC1_Palette_SSE2(block, allow_transparent));
+	__m256i indices = _mm256_set1_epi32((int)BC_Read32(block + 4));
+	__m256i mask = _mm256_set1_epi32(3);
+
+	__m256i idx01 = _mm256_and_si256(_mm256_srlv_epi32(indices, _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14)), mask);
+	__m256i idx23 = _mm256_and_si256(_mm256_srlv_epi32(indices, _mm256_setr_epi32(16, 18, 20, 22, 24, 26, 28, 30)), mask);
+
+	__m256i rows01 = _mm256_permutevar8x32_epi32(palette, idx01);
+	__m256i rows23 = _mm256_permutevar8x32_epi32(palette, idx23);
+
+	rows[0] = _mm256_castsi256_si128(rows01);
+	rows[1] = _mm256_extracti128_si256(rows01, 1);
+	rows[2] = _mm256_castsi256_si128(rows23);
+	rows[3] = _mm256_extracti128_si256(rows23, 1);
+}
+
+// the 8 values of a BC4 block in the low 8 bytes
+static __m128i BC4_Palette_SSE2(const byte_t* block, bool snorm) {
+	int a0 = snorm ? (int8_t)block[0] : block[0];
+	int a1 = snorm ? (int8_t)block[1] : block[1];
+	if (snorm) {
+		a0 = a0 < -127 ? -127 : a0;
+		a1 = a1 < -127 ? -127 : a1;
+	}
+
+	__m128i wa, wb, tail;
+	int d;
+	if (a0 > a1) {
+		wa = _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1);
+		wb = _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6);
+		tail = _mm_setzero_si128();
+		d = 7;
+	}
+	else {
+		wa = _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0);
+		wb = _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0);
+		tail = snorm ? _mm_setr_epi16(0, 0, 0, 0, 0, 0, -127, 127) : _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255);
+		d = 5;
+	}
+
+	// (t + d / 2) / d as multiply by 65536 / d rounded up, exact for t < 1800
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(_mm_set1_epi16((short)a0), wa), _mm_mullo_epi16(_mm_set1_epi16((short)a1), wb));
+	__m128i half = _mm_set1_epi16((short)(d / 2));
+	__m128i rcp = _mm_set1_epi16(d == 7 ? 9363 : 13108);
+
+	__m128i values;
+	if (snorm) {
+		// round half away from zero
+		__m128i sign = _mm_srai_epi16(t, 15);
+		__m128i abs = _mm_sub_epi16(_mm_xor_si128(t, sign), sign);
+		__m128i q = _mm_mulhi_epu16(_mm_add_epi16(abs, half), rcp);
+		values = _mm_packs_epi16(_mm_add_epi16(_mm_sub_epi16(_mm_xor_si128(q, sign), sign), tail), _mm_setzero_si128());
+	}
+	else {
+		__m128i q = _mm_mulhi_epu16(_mm_add_epi16(t, half), rcp);
+		values = _mm_packus_epi16(_mm_add_epi16(q, tail), _mm_setzero_si128());
+	}
+
+	return values;
+}
+
+// 16 values of a BC4 block
+static __m128i BC4_Lookup_SSE2(const byte_t* block, __m128i palette) {
+	alignas(16) byte_t values[16];
+	alignas(16) byte_t texels[16];
+	_mm_store_si128((__m128i*)values, palette);
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i) {
+		indices |= (uint64_t)block[2 + i] << (i * 8);
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		texels[i] = values[(indices >> (i * 3)) & 7];
+	}
+
+	return _mm_load_si128((const __m128i*)texels);
+}
+
+// the 3 bit indices are moved to 16 bit lanes, shifted to bits 13 ~ 15, and looked up by pshufb
+TARGET_AVX2 static __m128i BC4_Lookup_AVX2(const byte_t* block, __m128i palette) {
+	const __m128i GATHER_LO = _mm_setr_epi8(2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5);
+	const __m128i GATHER_HI = _mm_setr_epi8(5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 7, -128, 7, -128);
+	const __m128i SHIFT = _mm_setr_epi16(8192, 1024, 128, 4096, 512, 64, 2048, 256);
+
+	__m128i bytes = _mm_loadl_epi64((const __m128i*)block);
+
+	__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bytes, GATHER_LO), SHIFT), 13);
+	__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bytes, GATHER_HI), SHIFT), 13);
+
+	return _mm_shuffle_epi8(palette, _mm_packus_epi16(lo, hi));
+}
+
+// byte 3 of each texel from 16 alpha values
+static void BC_MergeAlpha_SSE2(__m128i rows[4], __m128i alpha) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_unpacklo_epi8(zero, alpha);
+	__m128i hi = _mm_unpackhi_epi8(zero, alpha);
+	__m128i rgb = _mm_set1_epi32(0x00ffffff);
+
+	rows[0] = _mm_or_si128(_mm_and_si128(rows[0], rgb), _mm_unpacklo_epi16(zero, lo));
+	rows[1] = _mm_or_si128(_mm_and_si128(rows[1], rgb), _mm_unpackhi_epi16(zero, lo));
+	rows[2] = _mm_or_si128(_mm_and_si128(rows[2], rgb), _mm_unpacklo_epi16(zero, hi));
+	rows[3] = _mm_or_si128(_mm_and_si128(rows[3], rgb), _mm_unpackhi_epi16(zero, hi));
+}
+
+// 4 rows of (red, green, 0, alpha)
+static void BC_StoreRG_SSE2(__m128i red, __m128i green, byte_t alpha, byte_t* dst, size_t pitch) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi32(alpha << 24);
+	__m128i lo = _mm_unpacklo_epi8(red, green);
+	__m128i hi = _mm_unpackhi_epi8(red, green);
+
+	_mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_unpacklo_epi16(lo, zero), a));
+	_mm_storeu_si128((__m128i*)(dst + pitch), _mm_or_si128(_mm_unpackhi_epi16(lo, zero), a));
+	_mm_storeu_si128((__m128i*)(dst + pitch * 2), _mm_or_si128(_mm_unpacklo_epi16(hi, zero), a));
+	_mm_storeu_si128((__m128i*)(dst + pitch * 3), _mm_or_si128(_mm_unpackhi_epi16(hi, zero), a));
+}
+
+static void BC_StoreRows_SSE2(const __m128i rows[4], byte_t* dst, size_t pitch) {
+	for (int y = 0; y < 4; ++y) {
+		_mm_storeu_si128((__m128i*)(dst + pitch * y), rows[y]);
+	}
+}
+
+static void BC1_Decode_SSE2(const byte_t* block, byte_t* dst, size_t pitch) {
+	__m128i rows[4];
+	BC1_DecodeColors_SSE2(block, true, rows);
+	BC_StoreRows_SSE2(rows, dst, pitch);
+}
+
+static void BC3_Decode_SSE2(const byte_t* block, byte_t* dst, size_t pitch) {
+	__m128i rows[4];
+	BC1_DecodeColors_SSE2(block + 8, false, rows);
+	BC_MergeAlpha_SSE2(rows, BC4_Lookup_SSE2(block, BC4_Palette_SSE2(block, false)));
+	BC_StoreRows_SSE2(rows, dst, pitch);
+}
+
+TARGET_AVX2 static void BC1_Decode_AVX2(const byte_t* block, byte_t* dst, size_t pitch) {
+	__m128i rows[4];
+	BC1_DecodeColors_AVX2(block, true, rows);
+	BC_StoreRows_SSE2(rows, dst, pitch);
+}
+
+TARGET_AVX2 static void BC3_Decode_AVX2(const byte_t* block, byte_t* dst, size_t pitch) {
+	__m128i rows[4];
+	BC1_DecodeColors_AVX2(block + 8, false, rows);
+	BC_MergeAlpha_SSE2(rows, BC4_Lookup_AVX2(block, BC4_Palette_SSE2(block, false)));
+	BC_StoreRows_SSE2(rows, dst, pitch);
+}
+
+template<bool SNORM>
+static void BC4_Decode_SSE2(const byte_t* block, byte_t* dst, size_t pitch) {
+	BC_StoreRG_SSE2(BC4_Lookup_SSE2(block, BC4_Palette_SSE2(block, SNORM)), _mm_setzero_si128(), SNORM ? 127 : 255, dst, pitch);
+}
+
+template<bool SNORM>
+TARGET_AVX2 static void BC4_Decode_AVX2(const byte_t* block, byte_t* dst, size_t pitch) {
+	BC_StoreRG_SSE2(BC4_Lookup_AVX2(block, BC4_Palette_SSE2(block, SNORM)), _mm_setzero_si128(), SNORM ? 127 : 255, dst, pitch);
+}
+
+template<bool SNORM>
+static void BC5_Decode_SSE2(const byte_t* block, byte_t* dst, size_t pitch) {
+	BC_StoreRG_SSE2(BC4_Lookup_SSE2(block, BC4_Palette_SSE2(block, SNORM)),
+		BC4_Lookup_SSE2(block + 8, BC4_Palette_SSE2(block + 8, SNORM)), SNORM ? 127 : 255, dst, pitch);
+}
+
+template<bool SNORM>
+TARGET_AVX2 static void BC5_Decode_AVX2(const byte_t* block, byte_t* dst, size_t pitch) {
+	BC_StoreRG_SSE2(BC4_Lookup_AVX2(block, BC4_Palette_SSE2(block, SNORM)),
+		BC4_Lookup_AVX2(block + 8, BC4_Palette_SSE2(block + 8, SNORM)), SNORM ? 127 : 255, dst, pitch);
+}
+
+#endif
+
+/*
+================================================================================
+BC6H, BC7 shared
+================================================================================
+*/
+
+// 128 bits, read from the least significant bit
+struct bc_bits_s {
+	uint64_t	lo_;
+	uint64_t	hi_;
+};
+
+static void BC_InitBits(const byte_t* block, bc_bits_s& bits) {
+	bits.lo_ = (uint64_t)BC_Read32(block) | ((uint64_t)BC_Read32(block + 4) << 32);
+	bits.hi_ = (uint64_t)BC_Read32(block + 8) | ((uint64_t)BC_Read32(block + 12) << 32);
+}
+
+static uint32_t BC_ReadBits(bc_bits_s& bits, int count) {
+	if (count <= 0) {
+		return 0;
+	}
+
+	uint32_t value = (uint32_t)(bits.lo_ & ((1ull << count) - 1));
+	bits.lo_ = (bits.lo_ >> count) | (bits.hi_ << (64 - count));
+	bits.hi_ >>= count;
+
+	return value;
+}
+
+// partitions of 2 subsets, bit i: the subset of texel i
+static const uint16_t BC_PARTITIONS_2[64] = {
+	0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+	0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+	0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+	0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+	0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+	0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+	0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+	0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+// partitions of 3 subsets, bits 2i ~ 2i+1: the subset of texel i
+static const uint32_t BC_PARTITIONS_3[64] = {
+	0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+	0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+	0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+	0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+	0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+	0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+	0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+	0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+};
+
+// anchor texels, their index has one bit less (texel 0 is the anchor of subset 0)
+static const uint8_t BC_ANCHORS_2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const uint8_t BC_ANCHORS_3_SUBSET_1[64] = {
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+static const uint8_t BC_ANCHORS_3_SUBSET_2[64] = {
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+static const int BC_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+static const int BC_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int BC_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const int* BC_GetWeights(int index_bits) {
+	return index_bits == 2 ? BC_WEIGHTS_2 : (index_bits == 3 ? BC_WEIGHTS_3 : BC_WEIGHTS_4);
+}
+
+static int BC_GetSubset(int num_subset, int partition, int texel) {
+	if (num_subset == 2) {
+		return (BC_PARTITIONS_2[partition] >> texel) & 1;
+	}
+	else if (num_subset == 3) {
+		return (BC_PARTITIONS_3[partition] >> (texel * 2)) & 3;
+	}
+	else {
+		return 0;
+	}
+}
+
+static bool BC_IsAnchor(int num_subset, int partition, int texel) {
+	if (texel == 0) {
+		return true;
+	}
+	else if (num_subset == 2) {
+		return texel == BC_ANCHORS_2[partition];
+	}
+	else if (num_subset == 3) {
+		return texel == BC_ANCHORS_3_SUBSET_1[partition] || texel == BC_ANCHORS_3_SUBSET_2[partition];
+	}
+	else {
+		return false;
+	}
+}
+
+/*
+================================================================================
+BC6H
+================================================================================
+*/
+
+// endpoint fields: channel * 4 + (w, x, y, z), then the partition
+enum bc6h_field_t : uint8_t {
+	BC6H_RW, BC6H_RX, BC6H_RY, BC6H_RZ,
+	BC6H_GW, BC6H_GX, BC6H_GY, BC6H_GZ,
+	BC6H_BW, BC6H_BX, BC6H_BY, BC6H_BZ,
+	BC6H_D
+};
+
+// bits [lsb_, lsb_ + count_) of a field, reversed_: the first bit read is the most significant one
+struct bc6h_segment_s {
+	uint8_t			field_;
+	uint8_t			lsb_;
+	uint8_t			count_;
+	uint8_t			reversed_;
+};
+
+struct bc6h_mode_s {
+	uint8_t					value_;
+	uint8_t					mode_bits_;
+	uint8_t					num_region_;
+	bool					transformed_;	// x, y, z are deltas from w
+	uint8_t					endpoint_bits_;
+	uint8_t					delta_bits_[3];
+	const bc6h_segment_s*	segments_;
+	size_t					num_segment_;
+};
+
+// bit layouts of the 14 modes, in the order of the specification
+static const bc6h_segment_s BC6H_SEGMENTS_1[] = {
+	{ BC6H_GY, 4, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_BZ, 4, 1, 0 }, { BC6H_RW, 0, 10, 0 },
+	{ BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 5, 0 }, { BC6H_GZ, 4, 1, 0 },
+	{ BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 5, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 },
+	{ BC6H_BX, 0, 5, 0 }, { BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 5, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 5, 0 }, { BC6H_BZ, 3, 1, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_2[] = {
+	{ BC6H_GY, 5, 1, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_GZ, 5, 1, 0 }, { BC6H_RW, 0, 7, 0 },
+	{ BC6H_BZ, 0, 1, 0 }, { BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 7, 0 },
+	{ BC6H_BY, 5, 1, 0 }, { BC6H_BZ, 2, 1, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BW, 0, 7, 0 },
+	{ BC6H_BZ, 3, 1, 0 }, { BC6H_BZ, 5, 1, 0 }, { BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 6, 0 },
+	{ BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 6, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 6, 0 },
+	{ BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 6, 0 }, { BC6H_RZ, 0, 6, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_3[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 5, 0 },
+	{ BC6H_RW, 10, 1, 0 }, { BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 4, 0 }, { BC6H_GW, 10, 1, 0 },
+	{ BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 4, 0 }, { BC6H_BW, 10, 1, 0 },
+	{ BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 5, 0 }, { BC6H_BZ, 2, 1, 0 },
+	{ BC6H_RZ, 0, 5, 0 }, { BC6H_BZ, 3, 1, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_4[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 4, 0 },
+	{ BC6H_RW, 10, 1, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 5, 0 },
+	{ BC6H_GW, 10, 1, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 4, 0 }, { BC6H_BW, 10, 1, 0 },
+	{ BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 4, 0 }, { BC6H_BZ, 0, 1, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 4, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BZ, 3, 1, 0 },
+	{ BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_5[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 4, 0 },
+	{ BC6H_RW, 10, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 4, 0 },
+	{ BC6H_GW, 10, 1, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 5, 0 },
+	{ BC6H_BW, 10, 1, 0 }, { BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 4, 0 }, { BC6H_BZ, 1, 1, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 4, 0 }, { BC6H_BZ, 4, 1, 0 }, { BC6H_BZ, 3, 1, 0 },
+	{ BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_6[] = {
+	{ BC6H_RW, 0, 9, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 9, 0 }, { BC6H_GY, 4, 1, 0 },
+	{ BC6H_BW, 0, 9, 0 }, { BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 5, 0 }, { BC6H_GZ, 4, 1, 0 },
+	{ BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 5, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 },
+	{ BC6H_BX, 0, 5, 0 }, { BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 5, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 5, 0 }, { BC6H_BZ, 3, 1, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_7[] = {
+	{ BC6H_RW, 0, 8, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 8, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BW, 0, 8, 0 }, { BC6H_BZ, 3, 1, 0 },
+	{ BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 6, 0 }, { BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 5, 0 },
+	{ BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 5, 0 }, { BC6H_BZ, 1, 1, 0 },
+	{ BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 6, 0 }, { BC6H_RZ, 0, 6, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_8[] = {
+	{ BC6H_RW, 0, 8, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 8, 0 },
+	{ BC6H_GY, 5, 1, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BW, 0, 8, 0 }, { BC6H_GZ, 5, 1, 0 },
+	{ BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 5, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_GY, 0, 4, 0 },
+	{ BC6H_GX, 0, 6, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 5, 0 }, { BC6H_BZ, 1, 1, 0 },
+	{ BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 5, 0 }, { BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 5, 0 },
+	{ BC6H_BZ, 3, 1, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_9[] = {
+	{ BC6H_RW, 0, 8, 0 }, { BC6H_BZ, 1, 1, 0 }, { BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 8, 0 },
+	{ BC6H_BY, 5, 1, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BW, 0, 8, 0 }, { BC6H_BZ, 5, 1, 0 },
+	{ BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 5, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_GY, 0, 4, 0 },
+	{ BC6H_GX, 0, 5, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 6, 0 },
+	{ BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 5, 0 }, { BC6H_BZ, 2, 1, 0 }, { BC6H_RZ, 0, 5, 0 },
+	{ BC6H_BZ, 3, 1, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_10[] = {
+	{ BC6H_RW, 0, 6, 0 }, { BC6H_GZ, 4, 1, 0 }, { BC6H_BZ, 0, 1, 0 }, { BC6H_BZ, 1, 1, 0 },
+	{ BC6H_BY, 4, 1, 0 }, { BC6H_GW, 0, 6, 0 }, { BC6H_GY, 5, 1, 0 }, { BC6H_BY, 5, 1, 0 },
+	{ BC6H_BZ, 2, 1, 0 }, { BC6H_GY, 4, 1, 0 }, { BC6H_BW, 0, 6, 0 }, { BC6H_GZ, 5, 1, 0 },
+	{ BC6H_BZ, 3, 1, 0 }, { BC6H_BZ, 5, 1, 0 }, { BC6H_BZ, 4, 1, 0 }, { BC6H_RX, 0, 6, 0 },
+	{ BC6H_GY, 0, 4, 0 }, { BC6H_GX, 0, 6, 0 }, { BC6H_GZ, 0, 4, 0 }, { BC6H_BX, 0, 6, 0 },
+	{ BC6H_BY, 0, 4, 0 }, { BC6H_RY, 0, 6, 0 }, { BC6H_RZ, 0, 6, 0 }, { BC6H_D, 0, 5, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_11[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 10, 0 },
+	{ BC6H_GX, 0, 10, 0 }, { BC6H_BX, 0, 10, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_12[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 9, 0 },
+	{ BC6H_RW, 10, 1, 0 }, { BC6H_GX, 0, 9, 0 }, { BC6H_GW, 10, 1, 0 }, { BC6H_BX, 0, 9, 0 },
+	{ BC6H_BW, 10, 1, 0 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_13[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 8, 0 },
+	{ BC6H_RW, 10, 2, 1 }, { BC6H_GX, 0, 8, 0 }, { BC6H_GW, 10, 2, 1 }, { BC6H_BX, 0, 8, 0 },
+	{ BC6H_BW, 10, 2, 1 }
+};
+
+static const bc6h_segment_s BC6H_SEGMENTS_14[] = {
+	{ BC6H_RW, 0, 10, 0 }, { BC6H_GW, 0, 10, 0 }, { BC6H_BW, 0, 10, 0 }, { BC6H_RX, 0, 4, 0 },
+	{ BC6H_RW, 10, 6, 1 }, { BC6H_GX, 0, 4, 0 }, { BC6H_GW, 10, 6, 1 }, { BC6H_BX, 0, 4, 0 },
+	{ BC6H_BW, 10, 6, 1 }
+};
+
+static const bc6h_mode_s BC6H_MODES[] = {
+	{ 0x00, 2, 2, true , 10, {  5,  5,  5 }, BC6H_SEGMENTS_1, COUNT_OF(BC6H_SEGMENTS_1) },
+	{ 0x01, 2, 2, true ,  7, {  6,  6,  6 }, BC6H_SEGMENTS_2, COUNT_OF(BC6H_SEGMENTS_2) },
+	{ 0x02, 5, 2, true , 11, {  5,  4,  4 }, BC6H_SEGMENTS_3, COUNT_OF(BC6H_SEGMENTS_3) },
+	{ 0x06, 5, 2, true , 11, {  4,  5,  4 }, BC6H_SEGMENTS_4, COUNT_OF(BC6H_SEGMENTS_4) },
+	{ 0x0a, 5, 2, true , 11, {  4,  4,  5 }, BC6H_SEGMENTS_5, COUNT_OF(BC6H_SEGMENTS_5) },
+	{ 0x0e, 5, 2, true ,  9, {  5,  5,  5 }, BC6H_SEGMENTS_6, COUNT_OF(BC6H_SEGMENTS_6) },
+	{ 0x12, 5, 2, true ,  8, {  6,  5,  5 }, BC6H_SEGMENTS_7, COUNT_OF(BC6H_SEGMENTS_7) },
+	{ 0x16, 5, 2, true ,  8, {  5,  6,  5 }, BC6H_SEGMENTS_8, COUNT_OF(BC6H_SEGMENTS_8) },
+	{ 0x1a, 5, 2, true ,  8, {  5,  5,  6 }, BC6H_SEGMENTS_9, COUNT_OF(BC6H_SEGMENTS_9) },
+	{ 0x1e, 5, 2, false,  6, {  6,  6,  6 }, BC6H_SEGMENTS_10, COUNT_OF(BC6H_SEGMENTS_10) },
+	{ 0x03, 5, 1, false, 10, { 10, 10, 10 }, BC6H_SEGMENTS_11, COUNT_OF(BC6H_SEGMENTS_11) },
+	{ 0x07, 5, 1, true , 11, {  9,  9,  9 }, BC6H_SEGMENTS_12, COUNT_OF(BC6H_SEGMENTS_12) },
+	{ 0x0b, 5, 1, true , 12, {  8,  8,  8 }, BC6H_SEGMENTS_13, COUNT_OF(BC6H_SEGMENTS_13) },
+	{ 0x0f, 5, 1, true , 16, {  4,  4,  4 }, BC6H_SEGMENTS_14, COUNT_OF(BC6H_SEGMENTS_14) },
+};
+
+static int BC6H_SignExtend(int value, int bits) {
+	int shift = 32 - bits;
+	return (int)((uint32_t)value << shift) >> shift;
+}
+
+static int BC6H_Unquantize(int value, int bits, bool sign) {
+	if (!sign) {
+		if (bits >= 15 || value == 0) {
+			return value;
+		}
+		else if (value == (1 << bits) - 1) {
+			return 0xffff;
+		}
+		else {
+			return ((value << 16) + 0x8000) >> bits;
+		}
+	}
+	else {
+		if (bits >= 16 || value == 0) {
+			return value;
+		}
+
+		int magnitude = value < 0 ? -value : value;
+		int unquantized = 0;
+		if (magnitude >= (1 << (bits - 1)) - 1) {
+			unquantized = 0x7fff;
+		}
+		else {
+			unquantized = ((magnitude << 15) + 0x4000) >> (bits - 1);
+		}
+
+		return value < 0 ? -unquantized : unquantized;
+	}
+}
+
+static float16_t BC6H_FinishUnquantize(int value, bool sign) {
+	if (!sign) {
+		return (float16_t)((value * 31) >> 6);
+	}
+	else if (value < 0) {
+		return (float16_t)(0x8000 | (((-value) * 31) >> 5));
+	}
+	else {
+		return (float16_t)((value * 31) >> 5);
+	}
+}
+
+// 16 RGBA half float texels, alpha is 1, reserved modes decode to 0
+static void BC6H_DecodeBlock(const byte_t* block, float16_t* rgba, bool sign) {
+	bc_bits_s bits;
+	BC_InitBits(block, bits);
+
+	uint32_t value = BC_ReadBits(bits, 2);
+	if (value > 1) {
+		value |= BC_ReadBits(bits, 3) << 2;
+	}
+
+	const bc6h_mode_s* mode = nullptr;
+	for (const bc6h_mode_s& it : BC6H_MODES) {
+		if (it.value_ == value) {
+			mode = &it;
+			break;
+		}
+	}
+
+	if (!mode) {
+		memset(rgba, 0, 16 * 4 * sizeof(float16_t));
+		return;
+	}
+
+	int fields[13] = {};
+	for (size_t i = 0; i < mode->num_segment_; ++i) {
+		const bc6h_segment_s& seg = mode->segments_[i];
+		uint32_t v = BC_ReadBits(bits, seg.count_);
+		if (seg.reversed_) {
+			uint32_t r = 0;
+			for (int k = 0; k < seg.count_; ++k) {
+				r |= ((v >> k) & 1) << (seg.count_ - 1 - k);
+			}
+			v = r;
+		}
+		fields[seg.field_] |= (int)(v << seg.lsb_);
+	}
+
+	int num_endpoint = mode->num_region_ * 2;
+	int endpoint_bits = mode->endpoint_bits_;
+	int endpoint_mask = (1 << endpoint_bits) - 1;
+
+	// endpoints[e][c], e: w, x, y, z
+	int endpoints[4][3];
+	for (int c = 0; c < 3; ++c) {
+		int* f = fields + c * 4;
+
+		endpoints[0][c] = sign ? BC6H_SignExtend(f[0], endpoint_bits) : f[0];
+
+		for (int e = 1; e < num_endpoint; ++e) {
+			if (mode->transformed_) {
+				int delta = BC6H_SignExtend(f[e], mode->delta_bits_[c]);
+				int v = (f[0] + delta) & endpoint_mask;
+				endpoints[e][c] = sign ? BC6H_SignExtend(v, endpoint_bits) : v;
+			}
+			else {
+				endpoints[e][c] = sign ? BC6H_SignExtend(f[e], endpoint_bits) : f[e];
+			}
+		}
+
+		for (int e = 0; e < num_endpoint; ++e) {
+			endpoints[e][c] = BC6H_Unquantize(endpoints[e][c], endpoint_bits, sign);
+		}
+	}
+
+	int partition = fields[BC6H_D];
+	int index_bits = mode->num_region_ == 2 ? 3 : 4;
+	const int* weights = BC_GetWeights(index_bits);
+
+	for (int i = 0; i < 16; ++i) {
+		int region = BC_GetSubset(mode->num_region_, partition, i);
+		int index = BC_ReadBits(bits, index_bits - (BC_IsAnchor(mode->num_region_, partition, i) ? 1 : 0));
+		int w = weights[index];
+
+		const int* e0 = endpoints[region * 2];
+		const int* e1 = endpoints[region * 2 + 1];
+
+		for (int c = 0; c < 3; ++c) {
+			int v = (e0[c] * (64 - w) + e1[c] * w + 32) >> 6;
+			rgba[i * 4 + c] = BC6H_FinishUnquantize(v, sign);
+		}
+		rgba[i * 4 + 3] = 0x3c00;
+	}
+}
+
+/*
+================================================================================
+BC7
+================================================================================
+*/
+
+struct bc7_mode_s {
+	int		num_subset_;
+	int		partition_bits_;
+	int		rotation_bits_;
+	int		index_selection_bits_;
+	int		color_bits_;
+	int		alpha_bits_;
+	int		endpoint_pbits_;	// one p-bit per endpoint
+	int		shared_pbits_;		// one p-bit per subset
+	int		index_bits_;
+	int		index2_bits_;		// second index set of mode 4 / 5
+};
+
+static const bc7_mode_s BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+// 16 RGBA texels, reserved mode (no bit in the first byte) decodes to 0
+static void BC7_DecodeBlock(const byte_t* block, byte_t* rgba) {
+	int m = 0;
+	while (m < 8 && !(block[0] & (1 << m))) {
+		m++;
+	}
+
+	if (m == 8) {
+		memset(rgba, 0, 64);
+		return;
+	}
+
+	const bc7_mode_s& mode = BC7_MODES[m];
+
+	bc_bits_s bits;
+	BC_InitBits(block, bits);
+	BC_ReadBits(bits, m + 1);
+
+	int partition = BC_ReadBits(bits, mode.partition_bits_);
+	int rotation = BC_ReadBits(bits, mode.rotation_bits_);
+	int index_selection = BC_ReadBits(bits, mode.index_selection_bits_);
+
+	int num_endpoint = mode.num_subset_ * 2;
+	int endpoints[6][4];
+
+	for (int c = 0; c < 3; ++c) {
+		for (int e = 0; e < num_endpoint; ++e) {
+			endpoints[e][c] = BC_ReadBits(bits, mode.color_bits_);
+		}
+	}
+
+	for (int e = 0; e < num_endpoint; ++e) {
+		endpoints[e][3] = BC_ReadBits(bits, mode.alpha_bits_);
+	}
+
+	int color_bits = mode.color_bits_;
+	int alpha_bits = mode.alpha_bits_;
+
+	if (mode.endpoint_pbits_ || mode.shared_pbits_) {
+		int pbits[6];
+		if (mode.endpoint_pbits_) {
+			for (int e = 0; e < num_endpoint; ++e) {
+				pbits[e] = BC_ReadBits(bits, 1);
+			}
+		}
+		else {
+			for (int s = 0; s < mode.num_subset_; ++s) {
+				pbits[s * 2] = pbits[s * 2 + 1] = BC_ReadBits(bits, 1);
+			}
+		}
+
+		for (int e = 0; e < num_endpoint; ++e) {
+			for (int c = 0; c < 4; ++c) {
+				endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+			}
+		}
+
+		color_bits++;
+		alpha_bits += alpha_bits ? 1 : 0;
+	}
+
+	auto Expand = [](int v, int bits) -> int {
+		return (v << (8 - bits)) | (v >> (2 * bits - 8));
+	};
+
+	for (int e = 0; e < num_endpoint; ++e) {
+		for (int c = 0; c < 3; ++c) {
+			endpoints[e][c] = Expand(endpoints[e][c], color_bits);
+		}
+		endpoints[e][3] = alpha_bits ? Expand(endpoints[e][3], alpha_bits) : 255;
+	}
+
+	int indices[16];
+	int indices2[16];
+
+	for (int i = 0; i < 16; ++i) {
+		indices[i] = BC_ReadBits(bits, mode.index_bits_ - (BC_IsAnchor(mode.num_subset_, partition, i) ? 1 : 0));
+	}
+
+	if (mode.index2_bits_) {
+		for (int i = 0; i < 16; ++i) {
+			indices2[i] = BC_ReadBits(bits, mode.index2_bits_ - (i == 0 ? 1 : 0));
+		}
+	}
+
+	// mode 4 / 5: colors from the first index set, alpha from the second one, swapped by index_selection
+	const int* color_indices = indices;
+	const int* alpha_indices = indices;
+	int color_index_bits = mode.index_bits_;
+	int alpha_index_bits = mode.index_bits_;
+
+	if (mode.index2_bits_) {
+		alpha_indices = indices2;
+		alpha_index_bits = mode.index2_bits_;
+
+		if (index_selection) {
+			std::swap(color_indices, alpha_indices);
+			std::swap(color_index_bits, alpha_index_bits);
+		}
+	}
+
+	const int* color_weights = BC_GetWeights(color_index_bits);
+	const int* alpha_weights = BC_GetWeights(alpha_index_bits);
+
+	for (int i = 0; i < 16; ++i) {
+		int subset = BC_GetSubset(mode.num_subset_, partition, i);
+		const int* e0 = endpoints[subset * 2];
+		const int* e1 = endpoints[subset * 2 + 1];
+
+		int w = color_weights[color_indices[i]];
+		int wa = alpha_weights[alpha_indices[i]];
+
+		byte_t* texel = rgba + i * 4;
+		for (int c = 0; c < 3; ++c) {
+			texel[c] = (byte_t)((e0[c] * (64 - w) + e1[c] * w + 32) >> 6);
+		}
+		texel[3] = (byte_t)((e0[3] * (64 - wa) + e1[3] * wa + 32) >> 6);
+
+		if (rotation) {
+			std::swap(texel[3], texel[rotation - 1]);
+		}
+	}
+}
+
+/*
+================================================================================
+block decoders
+================================================================================
+*/
+
+// decodes one block to 4 rows of 4 texels, pitch bytes apart
+typedef void (*bc_decode_block_t)(const byte_t* block, byte_t* dst, size_t pitch);
+
+static void BC_StoreTexels(const byte_t* texels, size_t texel_bytes, byte_t* dst, size_t pitch) {
+	for (int y = 0; y < 4; ++y) {
+		memcpy(dst + pitch * y, texels + texel_bytes * 4 * y, texel_bytes * 4);
+	}
+}
+
+static void BC1_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC1_DecodeBlock(block, texels);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+static void BC2_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC2_DecodeBlock(block, texels);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+static void BC3_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC3_DecodeBlock(block, texels);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+template<bool SNORM>
+static void BC4_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC4_DecodeBlock(block, texels, SNORM);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+template<bool SNORM>
+static void BC5_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC5_DecodeBlock(block, texels, SNORM);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+template<bool SIGN>
+static void BC6H_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) float16_t texels[64];
+	BC6H_DecodeBlock(block, texels, SIGN);
+	BC_StoreTexels((const byte_t*)texels, 8, dst, pitch);
+}
+
+static void BC7_Decode_Scalar(const byte_t* block, byte_t* dst, size_t pitch) {
+	alignas(16) byte_t texels[64];
+	BC7_DecodeBlock(block, texels);
+	BC_StoreTexels(texels, 4, dst, pitch);
+}
+
+static bc_decode_block_t BC_GetBlockDecoder(image_format_t fmt) {
+#if defined(CPU_X86)
+	simd_level_t simd_level = Cpu_GetSIMDLevel();
+
+	if (simd_level >= simd_level_t::AVX2) {
+		switch (fmt) {
+		case image_format_t::BC1_UNORM:
+		case image_format_t::BC1_SRGB:		return BC1_Decode_AVX2;
+		case image_format_t::BC3_UNORM:
+		case image_format_t::BC3_SRGB:		return BC3_Decode_AVX2;
+		case image_format_t::BC4_UNORM:		return BC4_Decode_AVX2<false>;
+		case image_format_t::BC4_SNORM:		return BC4_Decode_AVX2<true>;
+		case image_format_t::BC5_UNORM:		return BC5_Decode_AVX2<false>;
+		case image_format_t::BC5_SNORM:		return BC5_Decode_AVX2<true>;
+		default:							break;
+		}
+	}
+
+	if (simd_level >= simd_level_t::SSE2) {
+		switch (fmt) {
+		case image_format_t::BC1_UNORM:
+		case image_format_t::BC1_SRGB:		return BC1_Decode_SSE2;
+		case image_format_t::BC3_UNORM:
+		case image_format_t::BC3_SRGB:		return BC3_Decode_SSE2;
+		case image_format_t::BC4_UNORM:		return BC4_Decode_SSE2<false>;
+		case image_format_t::BC4_SNORM:		return BC4_Decode_SSE2<true>;
+		case image_format_t::BC5_UNORM:		return BC5_Decode_SSE2<false>;
+		case image_format_t::BC5_SNORM:		return BC5_Decode_SSE2<true>;
+		default:							break;
+		}
+	}
+#endif
+
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:
+	case image_format_t::BC1_SRGB:		return BC1_Decode_Scalar;
+	case image_format_t::BC2_UNORM:
+	case image_format_t::BC2_SRGB:		return BC2_Decode_Scalar;
+	case image_format_t::BC3_UNORM:
+	case image_format_t::BC3_SRGB:		return BC3_Decode_Scalar;
+	case image_format_t::BC4_UNORM:		return BC4_Decode_Scalar<false>;
+	case image_format_t::BC4_SNORM:		return BC4_Decode_Scalar<true>;
+	case image_format_t::BC5_UNORM:		return BC5_Decode_Scalar<false>;
+	case image_format_t::BC5_SNORM:		return BC5_Decode_Scalar<true>;
+	case image_format_t::BC6H_UFLOAT:	return BC6H_Decode_Scalar<false>;
+	case image_format_t::BC6H_SFLOAT:	return BC6H_Decode_Scalar<true>;
+	default:							return BC7_Decode_Scalar;
+	}
+}
+
+/*
+================================================================================
+Img_Decompress
+================================================================================
+*/
+
+COMMON_API bool Img_Decompress(const image_s& image, int layer, int level, image_s& decompressed) {
+	memset(&decompressed, 0, sizeof(decompressed));
+
+	if (!Img_IsCompressed(image.format_)) {
+		printf("Not a block compressed image\n");
+		return false;
+	}
+
+	int mip_levels = image.mip_levels_ > 1 ? image.mip_levels_ : 1;
+	int array_layers = image.array_layers_ > 1 ? image.array_layers_ : 1;
+	if (layer < 0 || layer >= array_layers || level < 0 || level >= mip_levels) {
+		printf("Bad subresource: layer %d, level %d\n", layer, level);
+		return false;
+	}
+
+	bool hdr = image.format_ == image_format_t::BC6H_UFLOAT || image.format_ == image_format_t::BC6H_SFLOAT;
+
+	int w = Img_GetLevelExtent(image.width_, level);
+	int h = Img_GetLevelExtent(image.height_, level);
+	if (!Img_Create(w, h, hdr ? image_format_t::R16G16B16A16_FLOAT : image_format_t::R8G8B8A8, decompressed)) {
+		return false;
+	}
+
+	size_t texel_bytes = hdr ? 8 : 4;
+	size_t pitch = (size_t)w * texel_bytes;
+	int block_bytes = Img_GetBlockBytes(image.format_);
+	const byte_t* blocks = image.pixels_ + Img_GetSubresourceOffset(image, layer, level);
+	bc_decode_block_t Decode = BC_GetBlockDecoder(image.format_);
+
+	int blocks_x = (w + 3) / 4;
+	int blocks_y = (h + 3) / 4;
+
+	// block rows per job
+	uint32_t grain = (uint32_t)((BC_DECODE_MIN_BLOCKS + blocks_x - 1) / blocks_x);
+
+	Job_ParallelFor(0, (uint32_t)blocks_y, grain, [&](uint32_t row_begin, uint32_t row_end) {
+		// 16 texels, RGBA8 or RGBA16F
+		alignas(16) byte_t texels[16 * 8];
+
+		for (int row = (int)row_begin; row < (int)row_end; ++row) {
+			const byte_t* block = blocks + (size_t)row * blocks_x * block_bytes;
+			byte_t* dst = decompressed.pixels_ + (size_t)row * 4 * pitch;
+			int cy = h - row * 4 < 4 ? h - row * 4 : 4;
+
+			for (int bx = 0; bx < w; bx += 4, block += block_bytes) {
+				int cx = w - bx < 4 ? w - bx : 4;
+
+				if (cx == 4 && cy == 4) {
+					Decode(block, dst + bx * texel_bytes, pitch);
+					continue;
+				}
+
+				// blocks on the right / bottom edge hang over the image
+				Decode(block, texels, texel_bytes * 4);
+				for (int y = 0; y < cy; ++y) {
+					memcpy(dst + pitch * y + bx * texel_bytes, texels + y * 4 * texel_bytes, cx * texel_bytes);
+				}
+			}
+		}
+	});
+
+	return true;
+}
+
+/*
+================================================================================
+encoders, shared
+================================================================================
+*/
+
+// minimum block rows per job of Img_Compress
+static const int BC_ENCODE_TASK_ROWS = 4;
+
+struct bc_bit_writer_s {
+	byte_t*					bytes_;
+	int						pos_;
+};
+
+static void BC_WriteBits(bc_bit_writer_s& bits, uint32_t value, int count) {
+	for (int k = 0; k < count; ++k, ++bits.pos_) {
+		bits.bytes_[bits.pos_ >> 3] |= (byte_t)(((value >> k) & 1) << (bits.pos_ & 7));
+	}
+}
+
+// line through the texels not skipped, channels: 3 (RGB) or 4 (RGBA)
+//   pca: ends of the principal axis, otherwise the bounding box diagonal pointing the way the colors correlate, inset a little
+static void BC_FitLine(const byte_t* rgba, const bool* skip, int channels, bool pca, float e0[4], float e1[4]) {
+	float mean[4] = {}, lo[4], hi[4];
+	int n = 0;
+
+	for (int c = 0; c < 4; ++c) {
+		lo[c] = 255.0f;
+		hi[c] = 0.0f;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		if (skip && skip[i]) {
+			continue;
+		}
+
+		for (int c = 0; c < channels; ++c) {
+			float v = rgba[i * 4 + c];
+			mean[c] += v;
+			lo[c] = v < lo[c] ? v : lo[c];
+			hi[c] = v > hi[c] ? v : hi[c];
+		}
+		n++;
+	}
+
+	if (!n) {
+		memset(e0, 0, sizeof(float) * 4);
+		memset(e1, 0, sizeof(float) * 4);
+		return;
+	}
+
+	float cov[4][4] = {};
+	for (int c = 0; c < channels; ++c) {
+		mean[c] /= n;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		if (skip && skip[i]) {
+			continue;
+		}
+
+		float d[4];
+		for (int c = 0; c < channels; ++c) {
+			d[c] = rgba[i * 4 + c] - mean[c];
+		}
+
+		for (int a = 0; a < channels; ++a) {
+			for (int b = a; b < channels; ++b) {
+				cov[a][b] += d[a] * d[b];
+			}
+		}
+	}
+
+	for (int a = 0; a < channels; ++a) {
+		for (int b = 0; b < a; ++b) {
+			cov[a][b] = cov[b][a];
+		}
+	}
+
+	// channel of the largest range leads
+	int lead = 0;
+	for (int c = 1; c < channels; ++c) {
+		lead = hi[c] - lo[c] > hi[lead] - lo[lead] ? c : lead;
+	}
+
+	if (!pca) {
+		for (int c = 0; c < channels; ++c) {
+			float inset = (hi[c] - lo[c]) / 16.0f;
+			bool flip = c != lead && cov[c][lead] < 0.0f;
+			e0[c] = flip ? hi[c] - inset : lo[c] + inset;
+			e1[c] = flip ? lo[c] + inset : hi[c] - inset;
+		}
+		for (int c = channels; c < 4; ++c) {
+			e0[c] = e1[c] = 255.0f;
+		}
+		return;
+	}
+
+	// power iteration from the bounding box diagonal
+	float axis[4] = {};
+	for (int c = 0; c < channels; ++c) {
+		axis[c] = (c != lead && cov[c][lead] < 0.0f) ? lo[c] - hi[c] : hi[c] - lo[c];
+	}
+
+	for (int it = 0; it < 8; ++it) {
+		float next[4] = {};
+		float len = 0.0f;
+		for (int a = 0; a < channels; ++a) {
+			for (int b = 0; b < channels; ++b) {
+				next[a] += cov[a][b] * axis[b];
+			}
+			len = fabsf(next[a]) > len ? fabsf(next[a]) : len;
+		}
+
+		if (len < 1.0e-6f) {
+			break;
+		}
+
+		for (int c = 0; c < channels; ++c) {
+			axis[c] = next[c] / len;
+		}
+	}
+
+	float len2 = 0.0f;
+	for (int c = 0; c < channels; ++c) {
+		len2 += axis[c] * axis[c];
+	}
+
+	float t_lo = 0.0f, t_hi = 0.0f;
+	if (len2 > 1.0e-12f) {
+		t_lo = 3.4e38f;
+		t_hi = -3.4e38f;
+		for (int i = 0; i < 16; ++i) {
+			if (skip && skip[i]) {
+				continue;
+			}
+
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c) {
+				t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+			}
+			t_lo = t < t_lo ? t : t_lo;
+			t_hi = t > t_hi ? t : t_hi;
+		}
+		t_lo /= len2;
+		t_hi /= len2;
+	}
+
+	for (int c = 0; c < channels; ++c) {
+		float v0 = mean[c] + axis[c] * t_lo;
+		float v1 = mean[c] + axis[c] * t_hi;
+		e0[c] = v0 < 0.0f ? 0.0f : (v0 > 255.0f ? 255.0f : v0);
+		e1[c] = v1 < 0.0f ? 0.0f : (v1 > 255.0f ? 255.0f : v1);
+	}
+	for (int c = channels; c < 4; ++c) {
+		e0[c] = e1[c] = 255.0f;
+	}
+}
+
+// endpoints minimizing the squared error for fixed interpolation weights (of e0, 0 ~ 1), false if degenerate
+static bool BC_LeastSquares(const byte_t* rgba, const float* weights, int channels, float e0[4], float e1[4]) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+
+	for (int i = 0; i < 16; ++i) {
+		float a = weights[i];
+		if (a < 0.0f) {
+			continue;	// skipped texel
+		}
+
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; ++c) {
+			ax[c] += a * rgba[i * 4 + c];
+			bx[c] += b * rgba[i * 4 + c];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1.0e-6f) {
+		return false;
+	}
+
+	for (int c = 0; c < channels; ++c) {
+		float v0 = (bb * ax[c] - ab * bx[c]) / det;
+		float v1 = (aa * bx[c] - ab * ax[c]) / det;
+		e0[c] = v0 < 0.0f ? 0.0f : (v0 > 255.0f ? 255.0f : v0);
+		e1[c] = v1 < 0.0f ? 0.0f : (v1 > 255.0f ? 255.0f : v1);
+	}
+
+	return true;
+}
+
+/*
+================================================================================
+BC1 ~ BC5 encoders
+================================================================================
+*/
+
+static void BC1_Expand565(uint16_t c, int rgb[3]) {
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static uint16_t BC1_Quantize565(const float rgb[3]) {
+	int r = (int)(rgb[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(rgb[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(rgb[2] * 31.0f / 255.0f + 0.5f);
+	r = r < 0 ? 0 : (r > 31 ? 31 : r);
+	g = g < 0 ? 0 : (g > 63 ? 63 : g);
+	b = b < 0 ? 0 : (b > 31 ? 31 : b);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// endpoint pairs whose color 2 ((2 * e0 + e1 + 1) / 3) hits every 8 bit value as close as possible
+struct bc1_single_color_s {
+	byte_t					q5_[256][2];
+	byte_t					q6_[256][2];
+
+	bc1_single_color_s() {
+		Build(5, q5_);
+		Build(6, q6_);
+	}
+
+	static void Build(int bits, byte_t table[256][2]) {
+		int n = 1 << bits;
+		for (int v = 0; v < 256; ++v) {
+			int best = 0x7fffffff;
+			for (int q0 = 0; q0 < n; ++q0) {
+				for (int q1 = 0; q1 < n; ++q1) {
+					int e0 = (q0 << (8 - bits)) | (q0 >> (2 * bits - 8));
+					int e1 = (q1 << (8 - bits)) | (q1 >> (2 * bits - 8));
+					// prefer close endpoints, they survive filtering between blocks better
+					int err = abs((2 * e0 + e1 + 1) / 3 - v) * 100 + abs(e0 - e1);
+					if (err < best) {
+						best = err;
+						table[v][0] = (byte_t)q0;
+						table[v][1] = (byte_t)q1;
+					}
+				}
+			}
+		}
+	}
+};
+
+static const bc1_single_color_s& BC1_GetSingleColorTable() {
+	static bc1_single_color_s table;
+	return table;
+}
+
+// indices and squared error of endpoints c0 c1 as the decoder sees them
+//   four: colors 2, 3 interpolated (c0 > c1, or any BC2 / BC3 block), otherwise color 2 is the average
+//   and 3 is transparent black, given to the transparent texels only
+static int BC1_Evaluate(const byte_t* rgba, const bool* transparent, uint16_t c0, uint16_t c1, bool four, uint32_t& indices) {
+	int palette[4][3];
+	BC1_Expand565(c0, palette[0]);
+	BC1_Expand565(c1, palette[1]);
+
+	for (int c = 0; c < 3; ++c) {
+		if (four) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+			palette[3][c] = 0;
+		}
+	}
+
+	int num_color = four ? 4 : 3;
+	int error = 0;
+	indices = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		if (transparent[i]) {
+			indices |= 3u << (i * 2);
+			continue;
+		}
+
+		const byte_t* texel = rgba + i * 4;
+		int best = 0x7fffffff, best_k = 0;
+		for (int k = 0; k < num_color; ++k) {
+			int dr = texel[0] - palette[k][0];
+			int dg = texel[1] - palette[k][1];
+			int db = texel[2] - palette[k][2];
+			int d = dr * dr + dg * dg + db * db;
+			if (d < best) {
+				best = d;
+				best_k = k;
+			}
+		}
+
+		indices |= (uint32_t)best_k << (i * 2);
+		error += best;
+	}
+
+	return error;
+}
+
+// color block of BC1 (transparent texels: alpha < 128) or BC2 / BC3 (always 4 colors)
+static void BC1_EncodeColors(const byte_t* rgba, bool always_four, bc_quality_t quality, byte_t* block) {
+	bool transparent[16];
+	bool any_transparent = false, all_transparent = true, solid = true;
+
+	for (int i = 0; i < 16; ++i) {
+		transparent[i] = !always_four && rgba[i * 4 + 3] < 128;
+		any_transparent |= transparent[i];
+		all_transparent &= transparent[i];
+		solid &= memcmp(rgba + i * 4, rgba, 3) == 0;
+	}
+
+	memset(block, 0, 8);
+
+	if (all_transparent) {
+		memset(block + 4, 0xff, 4);
+		return;
+	}
+
+	int best_error = 0x7fffffff;
+	uint16_t best_c0 = 0, best_c1 = 0;
+	uint32_t best_indices = 0;
+	bool best_four = true;
+
+	// four: 4 color mode wanted, BC1 orders the endpoints to select the mode
+	auto Try = [&](uint16_t c0, uint16_t c1, bool four) {
+		if (!always_four && (four ? c0 < c1 : c0 > c1)) {
+			std::swap(c0, c1);
+		}
+
+		bool decoded_four = always_four || c0 > c1;
+
+		uint32_t indices;
+		int error = BC1_Evaluate(rgba, transparent, c0, c1, decoded_four, indices);
+		if (error < best_error) {
+			best_error = error;
+			best_c0 = c0;
+			best_c1 = c1;
+			best_indices = indices;
+			best_four = decoded_four;
+		}
+	};
+
+	if (solid && !any_transparent && quality != bc_quality_t::FAST) {
+		const bc1_single_color_s& table = BC1_GetSingleColorTable();
+		uint16_t c0 = (uint16_t)((table.q5_[rgba[0]][0] << 11) | (table.q6_[rgba[1]][0] << 5) | table.q5_[rgba[2]][0]);
+		uint16_t c1 = (uint16_t)((table.q5_[rgba[0]][1] << 11) | (table.q6_[rgba[1]][1] << 5) | table.q5_[rgba[2]][1]);
+		Try(c0, c1, true);
+	}
+
+	float e0[4], e1[4];
+	BC_FitLine(rgba, transparent, 3, quality != bc_quality_t::FAST, e0, e1);
+
+	uint16_t q0 = BC1_Quantize565(e0);
+	uint16_t q1 = BC1_Quantize565(e1);
+
+	Try(q0, q1, !any_transparent);
+	if (quality == bc_quality_t::HIGH && !any_transparent && !always_four) {
+		Try(q0, q1, false);
+	}
+
+	// least squares endpoints for the indices found, kept while they improve
+	int num_refine = quality == bc_quality_t::HIGH ? 4 : (quality == bc_quality_t::NORMAL ? 1 : 0);
+	for (int it = 0; it < num_refine && best_error > 0; ++it) {
+		static const float WEIGHTS_4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		static const float WEIGHTS_3[4] = { 1.0f, 0.0f, 0.5f, -1.0f };
+
+		float weights[16];
+		for (int i = 0; i < 16; ++i) {
+			int k = (best_indices >> (i * 2)) & 3;
+			weights[i] = transparent[i] ? -1.0f : (best_four ? WEIGHTS_4[k] : WEIGHTS_3[k]);
+		}
+
+		if (!BC_LeastSquares(rgba, weights, 3, e0, e1)) {
+			break;
+		}
+
+		int error = best_error;
+		Try(BC1_Quantize565(e0), BC1_Quantize565(e1), best_four);
+		if (best_error == error) {
+			break;
+		}
+	}
+
+	block[0] = (byte_t)(best_c0 & 0xff);
+	block[1] = (byte_t)(best_c0 >> 8);
+	block[2] = (byte_t)(best_c1 & 0xff);
+	block[3] = (byte_t)(best_c1 >> 8);
+	block[4] = (byte_t)(best_indices & 0xff);
+	block[5] = (byte_t)((best_indices >> 8) & 0xff);
+	block[6] = (byte_t)((best_indices >> 16) & 0xff);
+	block[7] = (byte_t)(best_indices >> 24);
+}
+
+// indices and squared error of a BC4 (unorm) block with endpoints a0 a1, the palette as BC4_DecodeChannel builds it
+static int BC4_Evaluate(const byte_t* values, int a0, int a1, uint64_t& indices) {
+	int palette[8];
+	palette[0] = a0;
+	palette[1] = a1;
+
+	if (a0 > a1) {
+		for (int i = 1; i < 7; ++i) {
+			palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+	}
+	else {
+		for (int i = 1; i < 5; ++i) {
+			palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	int error = 0;
+	indices = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		int best = 0x7fffffff, best_k = 0;
+		for (int k = 0; k < 8; ++k) {
+			int d = (values[i] - palette[k]) * (values[i] - palette[k]);
+			if (d < best) {
+				best = d;
+				best_k = k;
+			}
+		}
+
+		indices |= (uint64_t)best_k << (i * 3);
+		error += best;
+	}
+
+	return error;
+}
+
+// 16 values src[i * stride] to a BC4 (unorm) block
+//   FAST: 8 value mode over min ~ max, NORMAL: also the 6 value mode over the values between 0 and 255,
+//   HIGH: endpoints moved inwards as well
+static void BC4_EncodeChannel(const byte_t* src, int stride, bc_quality_t quality, byte_t* block) {
+	byte_t values[16];
+	int lo = 255, hi = 0, inner_lo = 255, inner_hi = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		int v = src[i * stride];
+		values[i] = (byte_t)v;
+		lo = v < lo ? v : lo;
+		hi = v > hi ? v : hi;
+		if (v != 0 && v != 255) {
+			inner_lo = v < inner_lo ? v : inner_lo;
+			inner_hi = v > inner_hi ? v : inner_hi;
+		}
+	}
+
+	int best_error = 0x7fffffff;
+	int best_a0 = hi, best_a1 = lo;
+	uint64_t best_indices = 0;
+
+	auto Try = [&](int a0, int a1) {
+		uint64_t indices;
+		int error = BC4_Evaluate(values, a0, a1, indices);
+		if (error < best_error) {
+			best_error = error;
+			best_a0 = a0;
+			best_a1 = a1;
+			best_indices = indices;
+		}
+	};
+
+	Try(hi, lo);
+
+	int range = quality == bc_quality_t::HIGH ? 4 : 1;
+
+	for (int d0 = 0; d0 < range && best_error > 0; ++d0) {
+		for (int d1 = 0; d1 < range; ++d1) {
+			if (hi - d0 > lo + d1) {
+				Try(hi - d0, lo + d1);
+			}
+
+			if (quality != bc_quality_t::FAST && inner_lo + d0 <= inner_hi - d1) {
+				Try(inner_lo + d0, inner_hi - d1);
+			}
+		}
+	}
+
+	block[0] = (byte_t)best_a0;
+	block[1] = (byte_t)best_a1;
+	for (int i = 0; i < 6; ++i) {
+		block[2 + i] = (byte_t)((best_indices >> (i * 8)) & 0xff);
+	}
+}
+
+/*
+================================================================================
+BC7 encoder
+================================================================================
+*/
+
+// nearest 8 bit value of a color_bits endpoint with its p-bit, returns the stored endpoint
+static int BC7_QuantizeEndpoint(float v, int color_bits, int pbit, int& decoded) {
+	int bits = color_bits + 1;
+	int max_q = (1 << color_bits) - 1;
+	int guess = (int)((v * ((1 << bits) - 1) / 255.0f - pbit) * 0.5f + 0.5f);
+
+	int best_q = 0, best_d = 0x7fffffff;
+	for (int q = guess - 1; q <= guess + 1; ++q) {
+		if (q < 0 || q > max_q) {
+			continue;
+		}
+
+		int x = (q << 1) | pbit;
+		int e = (x << (8 - bits)) | (x >> (2 * bits - 8));
+		int d = abs(e - (int)(v + 0.5f));
+		if (d < best_d) {
+			best_d = d;
+			best_q = q;
+			decoded = e;
+		}
+	}
+
+	return best_q;
+}
+
+// nearest interpolated color of each texel of one subset, channels 3 (alpha ignored) or 4, returns the squared error
+static int BC7_AssignIndices(const byte_t* rgba, const bool* skip, int channels, const int e0[4], const int e1[4],
+	int index_bits, byte_t indices[16])
+{
+	const int* weights = BC_GetWeights(index_bits);
+	int num = 1 << index_bits;
+
+	int palette[16][4];
+	for (int k = 0; k < num; ++k) {
+		for (int c = 0; c < channels; ++c) {
+			palette[k][c] = (e0[c] * (64 - weights[k]) + e1[c] * weights[k] + 32) >> 6;
+		}
+	}
+
+	int error = 0;
+	for (int i = 0; i < 16; ++i) {
+		if (skip && skip[i]) {
+			continue;
+		}
+
+		const byte_t* texel = rgba + i * 4;
+		int best = 0x7fffffff, best_k = 0;
+		for (int k = 0; k < num; ++k) {
+			int d = 0;
+			for (int c = 0; c < channels; ++c) {
+				d += (texel[c] - palette[k][c]) * (texel[c] - palette[k][c]);
+			}
+			if (d < best) {
+				best = d;
+				best_k = k;
+			}
+		}
+
+		indices[i] = (byte_t)best_k;
+		error += best;
+	}
+
+	return error;
+}
+
+struct bc7_subset_s {
+	int						q_[2][4];		// stored endpoints
+	int						pbits_[2];
+	byte_t					indices_[16];
+	int						error_;
+};
+
+// endpoints of one subset: a line fit, quantized with every p-bit choice, then least squares refined
+//   shared_pbit: one p-bit for both endpoints (mode 1), otherwise one per endpoint (mode 6)
+static void BC7_EncodeSubset(const byte_t* rgba, const bool* skip, int channels, int color_bits, bool shared_pbit,
+	int index_bits, bc_quality_t quality, bc7_subset_s& subset)
+{
+	float e0[4], e1[4];
+	BC_FitLine(rgba, skip, channels, quality != bc_quality_t::FAST, e0, e1);
+
+	subset.error_ = 0x7fffffff;
+
+	auto Try = [&](const float f0[4], const float f1[4]) {
+		int num_pbits = shared_pbit ? 2 : 4;
+		for (int p = 0; p < num_pbits; ++p) {
+			int p0 = p & 1;
+			int p1 = shared_pbit ? p0 : p >> 1;
+
+			bc7_subset_s s;
+			int d0[4] = { 255, 255, 255, 255 }, d1[4] = { 255, 255, 255, 255 };
+			for (int c = 0; c < 4; ++c) {
+				s.q_[0][c] = s.q_[1][c] = 0;
+			}
+			for (int c = 0; c < channels; ++c) {
+				s.q_[0][c] = BC7_QuantizeEndpoint(f0[c], color_bits, p0, d0[c]);
+				s.q_[1][c] = BC7_QuantizeEndpoint(f1[c], color_bits, p1, d1[c]);
+			}
+			s.pbits_[0] = p0;
+			s.pbits_[1] = p1;
+			s.error_ = BC7_AssignIndices(rgba, skip, channels, d0, d1, index_bits, s.indices_);
+
+			if (s.error_ < subset.error_) {
+				subset = s;
+			}
+		}
+	};
+
+	Try(e0, e1);
+
+	int num_refine = quality == bc_quality_t::HIGH ? 2 : (quality == bc_quality_t::NORMAL ? 1 : 0);
+	const int* weights = BC_GetWeights(index_bits);
+
+	for (int it = 0; it < num_refine && subset.error_ > 0; ++it) {
+		float w[16];
+		for (int i = 0; i < 16; ++i) {
+			w[i] = skip && skip[i] ? -1.0f : 1.0f - weights[subset.indices_[i]] / 64.0f;
+		}
+
+		if (!BC_LeastSquares(rgba, w, channels, e0, e1)) {
+			break;
+		}
+
+		int error = subset.error_;
+		Try(e0, e1);
+		if (subset.error_ == error) {
+			break;
+		}
+	}
+}
+
+// the anchor index must have its top bit clear, otherwise swap the endpoints of the subset and invert its indices
+static void BC7_FixAnchor(bc7_subset_s& subset, const bool* skip, int anchor, int index_bits) {
+	int max_index = (1 << index_bits) - 1;
+	if (subset.indices_[anchor] <= max_index >> 1) {
+		return;
+	}
+
+	for (int c = 0; c < 4; ++c) {
+		std::swap(subset.q_[0][c], subset.q_[1][c]);
+	}
+	std::swap(subset.pbits_[0], subset.pbits_[1]);
+
+	for (int i = 0; i < 16; ++i) {
+		if (!skip || !skip[i]) {
+			subset.indices_[i] = (byte_t)(max_index - subset.indices_[i]);
+		}
+	}
+}
+
+// mode 6: one subset, RGBA 7 bits + a p-bit per endpoint, 4 bit indices
+static int BC7_EncodeMode6(const byte_t* rgba, bc_quality_t quality, byte_t* block) {
+	bc7_subset_s s;
+	BC7_EncodeSubset(rgba, nullptr, 4, 7, false, 4, quality, s);
+	BC7_FixAnchor(s, nullptr, 0, 4);
+
+	memset(block, 0, 16);
+	bc_bit_writer_s bits = { block, 0 };
+
+	BC_WriteBits(bits, 1 << 6, 7);
+	for (int c = 0; c < 4; ++c) {
+		BC_WriteBits(bits, s.q_[0][c], 7);
+		BC_WriteBits(bits, s.q_[1][c], 7);
+	}
+	BC_WriteBits(bits, s.pbits_[0], 1);
+	BC_WriteBits(bits, s.pbits_[1], 1);
+	for (int i = 0; i < 16; ++i) {
+		BC_WriteBits(bits, s.indices_[i], i == 0 ? 3 : 4);
+	}
+
+	return s.error_;
+}
+
+// mode 1: two subsets, RGB 6 bits + a p-bit per subset, 3 bit indices, opaque blocks only
+//   the partitions are ranked by how well a line fits each subset, the best few are encoded
+static int BC7_EncodeMode1(const byte_t* rgba, bc_quality_t quality, byte_t* block) {
+	const int NUM_CANDIDATE = 4;
+
+	int candidates[NUM_CANDIDATE];
+	float candidate_costs[NUM_CANDIDATE];
+	for (int k = 0; k < NUM_CANDIDATE; ++k) {
+		candidates[k] = 0;
+		candidate_costs[k] = 3.4e38f;
+	}
+
+	for (int p = 0; p < 64; ++p) {
+		float cost = 0.0f;
+
+		for (int s = 0; s < 2; ++s) {
+			float mean[3] = {}, cov[3][3] = {};
+			int n = 0;
+			for (int i = 0; i < 16; ++i) {
+				if (BC_GetSubset(2, p, i) == s) {
+					for (int c = 0; c < 3; ++c) {
+						mean[c] += rgba[i * 4 + c];
+					}
+					n++;
+				}
+			}
+			for (int c = 0; c < 3; ++c) {
+				mean[c] /= n;
+			}
+			for (int i = 0; i < 16; ++i) {
+				if (BC_GetSubset(2, p, i) == s) {
+					float d[3];
+					for (int c = 0; c < 3; ++c) {
+						d[c] = rgba[i * 4 + c] - mean[c];
+					}
+					for (int a = 0; a < 3; ++a) {
+						for (int b = 0; b < 3; ++b) {
+							cov[a][b] += d[a] * d[b];
+						}
+					}
+				}
+			}
+
+			// spread off the principal axis: trace - largest eigenvalue
+			float axis[3] = { 1.0f, 1.0f, 1.0f };
+			float lambda = 0.0f;
+			for (int it = 0; it < 4; ++it) {
+				float next[3] = {};
+				for (int a = 0; a < 3; ++a) {
+					for (int b = 0; b < 3; ++b) {
+						next[a] += cov[a][b] * axis[b];
+					}
+				}
+				float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+				if (len < 1.0e-6f) {
+					break;
+				}
+				lambda = len / sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+				for (int c = 0; c < 3; ++c) {
+					axis[c] = next[c] / len;
+				}
+			}
+
+			cost += cov[0][0] + cov[1][1] + cov[2][2] - lambda;
+		}
+
+		for (int k = 0; k < NUM_CANDIDATE; ++k) {
+			if (cost < candidate_costs[k]) {
+				for (int j = NUM_CANDIDATE - 1; j > k; --j) {
+					candidates[j] = candidates[j - 1];
+					candidate_costs[j] = candidate_costs[j - 1];
+				}
+				candidates[k] = p;
+				candidate_costs[k] = cost;
+				break;
+			}
+		}
+	}
+
+	int best_error = 0x7fffffff;
+	int best_partition = 0;
+	bc7_subset_s best[2];
+
+	for (int k = 0; k < NUM_CANDIDATE; ++k) {
+		int p = candidates[k];
+		bc7_subset_s subsets[2];
+		int error = 0;
+
+		for (int s = 0; s < 2; ++s) {
+			bool skip[16];
+			for (int i = 0; i < 16; ++i) {
+				skip[i] = BC_GetSubset(2, p, i) != s;
+			}
+
+			BC7_EncodeSubset(rgba, skip, 3, 6, true, 3, quality, subsets[s]);
+			BC7_FixAnchor(subsets[s], skip, s == 0 ? 0 : BC_ANCHORS_2[p], 3);
+			error += subsets[s].error_;
+		}
+
+		if (error < best_error) {
+			best_error = error;
+			best_partition = p;
+			best[0] = subsets[0];
+			best[1] = subsets[1];
+		}
+	}
+
+	memset(block, 0, 16);
+	bc_bit_writer_s bits = { block, 0 };
+
+	BC_WriteBits(bits, 1 << 1, 2);
+	BC_WriteBits(bits, best_partition, 6);
+	for (int c = 0; c < 3; ++c) {
+		for (int s = 0; s < 2; ++s) {
+			BC_WriteBits(bits, best[s].q_[0][c], 6);
+			BC_WriteBits(bits, best[s].q_[1][c], 6);
+		}
+	}
+	BC_WriteBits(bits, best[0].pbits_[0], 1);
+	BC_WriteBits(bits, best[1].pbits_[0], 1);
+	for (int i = 0; i < 16; ++i) {
+		int s = BC_GetSubset(2, best_partition, i);
+		BC_WriteBits(bits, best[s].indices_[i], BC_IsAnchor(2, best_partition, i) ? 2 : 3);
+	}
+
+	return best_error;
+}
+
+// mode 6 for every block, HIGH also tries mode 1 on opaque blocks
+static void BC7_EncodeBlock(const byte_t* rgba, bc_quality_t quality, byte_t* block) {
+	int error = BC7_EncodeMode6(rgba, quality, block);
+
+	bool opaque = true;
+	for (int i = 0; i < 16; ++i) {
+		opaque &= rgba[i * 4 + 3] == 255;
+	}
+
+	if (quality == bc_quality_t::HIGH && opaque && error > 0) {
+		byte_t mode1[16];
+		if (BC7_EncodeMode1(rgba, quality, mode1) < error) {
+			memcpy(block, mode1, 16);
+		}
+	}
+}
+
+/*
+================================================================================
+Img_Compress
+================================================================================
+*/
+
+COMMON_API bool Img_Compress(const image_s& image, image_format_t fmt, bc_quality_t quality, image_s& compressed) {
+	memset(&compressed, 0, sizeof(compressed));
+
+	if (image.format_ != image_format_t::R8G8B8A8) {
+		printf("Img_Compress: source must be R8G8B8A8\n");
+		return false;
+	}
+
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:
+	case image_format_t::BC1_SRGB:
+	case image_format_t::BC3_UNORM:
+	case image_format_t::BC3_SRGB:
+	case image_format_t::BC4_UNORM:
+	case image_format_t::BC5_UNORM:
+	case image_format_t::BC7_UNORM:
+	case image_format_t::BC7_SRGB:
+		break;
+	default:
+		printf("Img_Compress: unsupported format %d\n", (int)fmt);
+		return false;
+	}
+
+	compressed.width_ = image.width_;
+	compressed.height_ = image.height_;
+	compressed.format_ = fmt;
+	compressed.mip_levels_ = image.mip_levels_ > 1 ? image.mip_levels_ : 1;
+	compressed.array_layers_ = image.array_layers_ > 1 ? image.array_layers_ : 1;
+	compressed.cubemap_ = image.cubemap_;
+
+	compressed.pixels_ = (byte_t*)TEMP_ALLOC(Img_GetDataSize(compressed));
+	if (!compressed.pixels_) {
+		printf("Memory overflow\n");
+		memset(&compressed, 0, sizeof(compressed));
+		return false;
+	}
+
+	int block_bytes = Img_GetBlockBytes(fmt);
+
+	// tasks of a few block rows over every subresource, small levels are one task each
+	struct task_s {
+		int					layer_;
+		int					level_;
+		int					row_begin_;
+		int					row_end_;
+	};
+
+	std::vector<task_s> tasks;
+	for (int layer = 0; layer < compressed.array_layers_; ++layer) {
+		for (int level = 0; level < compressed.mip_levels_; ++level) {
+			int h = Img_GetLevelExtent(image.height_, level);
+			int blocks_y = (h + 3) / 4;
+			for (int row = 0; row < blocks_y; row += BC_ENCODE_TASK_ROWS) {
+				tasks.push_back({ layer, level, row, row + BC_ENCODE_TASK_ROWS < blocks_y ? row + BC_ENCODE_TASK_ROWS : blocks_y });
+			}
+		}
+	}
+
+	Job_ParallelFor(0, (uint32_t)tasks.size(), 1, [&](uint32_t task_begin, uint32_t task_end) {
+		alignas(16) byte_t rgba[64];
+
+		for (uint32_t t = task_begin; t < task_end; ++t) {
+			const task_s& task = tasks[t];
+
+			int w = Img_GetLevelExtent(image.width_, task.level_);
+			int h = Img_GetLevelExtent(image.height_, task.level_);
+			int blocks_x = (w + 3) / 4;
+
+			const byte_t* src = image.pixels_ + Img_GetSubresourceOffset(image, task.layer_, task.level_);
+			byte_t* dst = compressed.pixels_ + Img_GetSubresourceOffset(compressed, task.layer_, task.level_);
+
+			for (int row = task.row_begin_; row < task.row_end_; ++row) {
+				for (int bx = 0; bx < blocks_x; ++bx) {
+					// texels past the edge repeat the last row / column
+					for (int y = 0; y < 4; ++y) {
+						int sy = row * 4 + y < h ? row * 4 + y : h - 1;
+						for (int x = 0; x < 4; ++x) {
+							int sx = bx * 4 + x < w ? bx * 4 + x : w - 1;
+							memcpy(rgba + (y * 4 + x) * 4, src + ((size_t)sy * w + sx) * 4, 4);
+						}
+					}
+
+					byte_t* block = dst + ((size_t)row * blocks_x + bx) * block_bytes;
+
+					switch (fmt) {
+					case image_format_t::BC1_UNORM:
+					case image_format_t::BC1_SRGB:
+						BC1_EncodeColors(rgba, false, quality, block);
+						break;
+					case image_format_t::BC3_UNORM:
+					case image_format_t::BC3_SRGB:
+						BC4_EncodeChannel(rgba + 3, 4, quality, block);
+						BC1_EncodeColors(rgba, true, quality, block + 8);
+						break;
+					case image_format_t::BC4_UNORM:
+						BC4_EncodeChannel(rgba, 4, quality, block);
+						break;
+					case image_format_t::BC5_UNORM:
+						BC4_EncodeChannel(rgba, 4, quality, block);
+						BC4_EncodeChannel(rgba + 1, 4, quality, block + 8);
+						break;
+					default:
+						BC7_EncodeBlock(rgba, quality, block);
+						break;
+					}
+				}
+			}
+		}
+	});
+
+	return true;
+}
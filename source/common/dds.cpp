@@ -3,6 +3,13 @@
  *****************************************************************************/
 
 #include "inc.h"
+
+#if defined(__linux__)
+// the Windows types dds.h uses besides DWORD
+typedef uint8_t		BYTE;
+typedef uint32_t	UINT;
+#endif
+
 #include <dds.h>
 
 static void PrintDDSInfo(const DDS_HEADER* head) {
@@ -299,305 +306,203 @@ static const uint32_t CUBEMAP_OFFSET_Y[] = { 1, 1, 2, 0, 1, 1 };
 
 static const size_t SIZEOF_HEAD = sizeof(DDS_HEADER);
 
-bool Image_LoadDDS(const char* filename, image_s& image) {
-#pragma pack(push, 1)
-	union bc1_clr_s {
-		uint16_t		word_;
-		struct {
-			uint16_t	b_ : 5;
-			uint16_t	g_ : 6;
-			uint16_t	r_ : 5;
-		};
-	};
+// DDS_HEADER::dwCubemapFlags
+static const DWORD DDS_CUBEMAP = 0x00000200;	// DDSCAPS2_CUBEMAP
+
+// DDS_HEADER_DXT10::miscFlag
+static const UINT DDS_RESOURCE_MISC_TEXTURECUBE = 0x00000004;
+
+static bool DDS_GetCompressedFormat(const DDS_HEADER* head, const DDS_HEADER_DXT10* dx10, image_format_t& fmt) {
+	if (dx10) {
+		switch (dx10->dxgiFormat) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:			fmt = image_format_t::BC1_UNORM; return true;
+		case DXGI_FORMAT_BC1_UNORM_SRGB:	fmt = image_format_t::BC1_SRGB; return true;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:			fmt = image_format_t::BC2_UNORM; return true;
+		case DXGI_FORMAT_BC2_UNORM_SRGB:	fmt = image_format_t::BC2_SRGB; return true;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:			fmt = image_format_t::BC3_UNORM; return true;
+		case DXGI_FORMAT_BC3_UNORM_SRGB:	fmt = image_format_t::BC3_SRGB; return true;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:			fmt = image_format_t::BC4_UNORM; return true;
+		case DXGI_FORMAT_BC4_SNORM:			fmt = image_format_t::BC4_SNORM; return true;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:			fmt = image_format_t::BC5_UNORM; return true;
+		case DXGI_FORMAT_BC5_SNORM:			fmt = image_format_t::BC5_SNORM; return true;
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:			fmt = image_format_t::BC6H_UFLOAT; return true;
+		case DXGI_FORMAT_BC6H_SF16:			fmt = image_format_t::BC6H_SFLOAT; return true;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:			fmt = image_format_t::BC7_UNORM; return true;
+		case DXGI_FORMAT_BC7_UNORM_SRGB:	fmt = image_format_t::BC7_SRGB; return true;
+		default:
+			return false;
+		}
+	}
 
-	struct bc1_clr_idx_s {
-		uint32_t	a_ : 2;
-		uint32_t	b_ : 2;
-		uint32_t	c_ : 2;
-		uint32_t	d_ : 2;
-		uint32_t	e_ : 2;
-		uint32_t	f_ : 2;
-		uint32_t	g_ : 2;
-		uint32_t	h_ : 2;
-		uint32_t	i_ : 2;
-		uint32_t	j_ : 2;
-		uint32_t	k_ : 2;
-		uint32_t	l_ : 2;
-		uint32_t	m_ : 2;
-		uint32_t	n_ : 2;
-		uint32_t	o_ : 2;
-		uint32_t	p_ : 2;
-	};
+	if (!(head->ddspf.dwFlags & DDPF_FOURCC)) {
+		return false;
+	}
 
-	struct bc1_s {
-		bc1_clr_s	colors_[2];
-		bc1_clr_idx_s	idx_;
-	};
-#pragma pack(pop)
+	// DXT2 / DXT4 are the premultiplied alpha flavors of DXT3 / DXT5
+	switch (head->ddspf.dwFourCC) {
+	case MAKEFOURCC('D', 'X', 'T', '1'):	fmt = image_format_t::BC1_UNORM; return true;
+	case MAKEFOURCC('D', 'X', 'T', '2'):
+	case MAKEFOURCC('D', 'X', 'T', '3'):	fmt = image_format_t::BC2_UNORM; return true;
+	case MAKEFOURCC('D', 'X', 'T', '4'):
+	case MAKEFOURCC('D', 'X', 'T', '5'):	fmt = image_format_t::BC3_UNORM; return true;
+	case MAKEFOURCC('A', 'T', 'I', '1'):
+	case MAKEFOURCC('B', 'C', '4', 'U'):	fmt = image_format_t::BC4_UNORM; return true;
+	case MAKEFOURCC('B', 'C', '4', 'S'):	fmt = image_format_t::BC4_SNORM; return true;
+	case MAKEFOURCC('A', 'T', 'I', '2'):
+	case MAKEFOURCC('B', 'C', '5', 'U'):	fmt = image_format_t::BC5_UNORM; return true;
+	case MAKEFOURCC('B', 'C', '5', 'S'):	fmt = image_format_t::BC5_SNORM; return true;
+	default:
+		return false;
+	}
+}
 
-	struct rgba32_s {
-		byte_t		r_;
-		byte_t		g_;
-		byte_t		b_;
-		byte_t		a_;
-	};
+// every mip level and layer, blocks copied as they are
+static bool DDS_LoadCompressed(const DDS_HEADER* head, const DDS_HEADER_DXT10* dx10, image_format_t fmt,
+	const byte_t* data, size_t data_size, image_s& image)
+{
+	if (!head->dwWidth || !head->dwHeight) {
+		printf("Bad dds size\n");
+		return false;
+	}
 
-	// https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression?source=recommendations
-	// https://learn.microsoft.com/en-us/windows/win32/direct3d9/opaque-and-1-bit-alpha-textures
-	/*
-	
-	The 1-bit alpha format is distinguished from the opaque format by comparing the two 16-bit color 
-	values stored in the block. They are treated as unsigned integers. If the first color is greater 
-	than the second, it implies that only opaque texels are defined. This means four colors are used 
-	to represent the texels. In four-color encoding, there are two derived colors and all four colors 
-	are equally distributed in RGB color space. This format is analogous to RGB 5:6:5 format. Otherwise, 
-	for 1-bit alpha transparency, three colors are used and the fourth is reserved to represent transparent 
-	texels.
-
-	 */
-	
-	auto Load_DDSPF_DXT1 = [](DDS_HEADER* head, image_s& image) -> bool {
-
-		auto CopyPixels = [head](const byte_t * src_pixels, byte_t * dst_pixels, uint32_t dst_pic_w, uint32_t dst_pic_h) {
-			if (head->dwWidth >= 4 && head->dwHeight >= 4) {
-
-				const bc1_s* src_block = (const bc1_s*)src_pixels;
-
-				uint32_t x_blocks = head->dwWidth >> 2;
-				uint32_t y_blocks = head->dwHeight >> 2;
-
-				for (uint32_t by = 0; by < y_blocks; ++by) {
-					for (uint32_t bx = 0; bx < x_blocks; ++bx) {
-						int src_x = bx * 4;
-						int src_y = by * 4;
-						int dst_y = head->dwHeight - src_y - 1;
-						byte_t* dst_pixels_block = dst_pixels + dst_y * dst_pic_w * 4 + src_x * 4;
-
-						// https://www.fsdeveloper.com/wiki/index.php?title=DXT_compression_explained
-						rgba32_s color_table[4];
-
-						//bool _1_bit_alpha_transparency = src_block->colors_[0].word_ <= src_block->colors_[1].word_;
-
-						color_table[0].r_ = (byte_t)((src_block->colors_[0].r_ / 31.0f) * 255.0f);
-						color_table[0].g_ = (byte_t)((src_block->colors_[0].g_ / 63.0f) * 255.0f);
-						color_table[0].b_ = (byte_t)((src_block->colors_[0].b_ / 31.0f) * 255.0f);
-						color_table[0].a_ = 255;
-
-						color_table[1].r_ = (byte_t)((src_block->colors_[1].r_ / 31.0f) * 255.0f);
-						color_table[1].g_ = (byte_t)((src_block->colors_[1].g_ / 63.0f) * 255.0f);
-						color_table[1].b_ = (byte_t)((src_block->colors_[1].b_ / 31.0f) * 255.0f);
-						color_table[1].a_ = 255;
-
-						// interpolate
-						float delta_r = (float)color_table[3].r_ - (float)color_table[0].r_;
-						float delta_g = (float)color_table[3].g_ - (float)color_table[0].g_;
-						float delta_b = (float)color_table[3].b_ - (float)color_table[0].b_;
-
-						color_table[2].r_ = (byte_t)(color_table[0].r_ * 0.666667f + color_table[1].r_ * 0.333333f);
-						color_table[2].g_ = (byte_t)(color_table[0].g_ * 0.666667f + color_table[1].g_ * 0.333333f);
-						color_table[2].b_ = (byte_t)(color_table[0].b_ * 0.666667f + color_table[1].b_ * 0.333333f);
-						color_table[2].a_ = 255;
-
-						/*
-						if (_1_bit_alpha_transparency) {
-							// transparency texels
-							color_table[3].r_ = 0;
-							color_table[3].g_ = 0;
-							color_table[3].b_ = 0;
-							color_table[3].a_ = 0;
-						}
-						else {
-							color_table[3].r_ = (byte_t)(color_table[0].r_ * 0.333333f + color_table[1].r_ * 0.666667f);
-							color_table[3].g_ = (byte_t)(color_table[0].g_ * 0.333333f + color_table[1].g_ * 0.666667f);
-							color_table[3].b_ = (byte_t)(color_table[0].b_ * 0.333333f + color_table[1].b_ * 0.666667f);
-							color_table[3].a_ = 255;
-						}
-						*/
-
-						color_table[3].r_ = (byte_t)(color_table[0].r_ * 0.333333f + color_table[1].r_ * 0.666667f);
-						color_table[3].g_ = (byte_t)(color_table[0].g_ * 0.333333f + color_table[1].g_ * 0.666667f);
-						color_table[3].b_ = (byte_t)(color_table[0].b_ * 0.333333f + color_table[1].b_ * 0.666667f);
-						color_table[3].a_ = 255;
-
-						/*
-
-						 block:
-
-						 | d c b a |
-						 | h g f e |
-						 | l k j i |
-						 | p o n m |
-
-						*/
-
-						uint32_t idx[16] = {
-							src_block->idx_.a_,
-							src_block->idx_.b_,
-							src_block->idx_.c_,
-							src_block->idx_.d_,
-							src_block->idx_.e_,
-							src_block->idx_.f_,
-							src_block->idx_.g_,
-							src_block->idx_.h_,
-							src_block->idx_.i_,
-							src_block->idx_.j_,
-							src_block->idx_.k_,
-							src_block->idx_.l_,
-							src_block->idx_.m_,
-							src_block->idx_.n_,
-							src_block->idx_.o_,
-							src_block->idx_.p_,
-						};
+	bool texture_2d = dx10 ? dx10->resourceDimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		: !(head->dwCubemapFlags & DDS_FLAGS_VOLUME);
+	if (!texture_2d) {
+		printf("Only support 2D textures\n");
+		return false;
+	}
 
-						for (int i = 0; i < 16; ++i) {
-							int x = 4 - i % 4 - 1;
-							int y = i / 4;
+	uint32_t max_mip_levels = 1;
+	for (uint32_t sz = head->dwWidth > head->dwHeight ? head->dwWidth : head->dwHeight; sz > 1; sz >>= 1) {
+		max_mip_levels++;
+	}
 
-							byte_t* dst_pixel = dst_pixels_block - y * dst_pic_w * 4 + x * 4;
+	uint32_t mip_levels = head->dwMipMapCount > 1 ? head->dwMipMapCount : 1;
+	if (mip_levels > max_mip_levels) {
+		printf("Bad mipmap\n");
+		return false;
+	}
 
-							int colr_idx = idx[i];
-							dst_pixel[0] = color_table[colr_idx].r_;
-							dst_pixel[1] = color_table[colr_idx].g_;
-							dst_pixel[2] = color_table[colr_idx].b_;
-							dst_pixel[3] = color_table[colr_idx].a_;
-						}
+	uint32_t array_layers = 1;
+	bool cubemap = false;
 
-						src_block++;
-					}
-				}
-			}
-			else {
-				for (uint32_t y = 0; y < head->dwHeight; ++y) {
-					const byte_t* src_pixel = (const byte_t*)(src_pixels + y * head->dwWidth * 4);
-					byte_t* dst_pixel = dst_pixels + y * dst_pic_w * 4;
-
-					// TO FIX
-					for (uint32_t x = 0; x < head->dwWidth; ++x) {
-						dst_pixel[0] = src_pixel[2];
-						dst_pixel[1] = src_pixel[1];
-						dst_pixel[2] = src_pixel[0];
-						dst_pixel[3] = src_pixel[3];
-
-						src_pixel += 4;
-						dst_pixel += 4;
-					}
-				}
-			}
-		};
+	if (dx10) {
+		array_layers = dx10->arraySize ? dx10->arraySize : 1;
+		if (dx10->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) {
+			cubemap = true;
+			array_layers *= 6;
+		}
+	}
+	else if (head->dwCubemapFlags & DDS_CUBEMAP) {
+		if ((head->dwCubemapFlags & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES) {
+			printf("Only support DDS_CUBEMAP_ALLFACES cubemap mode\n");
+			return false;
+		}
 
-		bool ok = false;
+		cubemap = true;
+		array_layers = 6;
+	}
 
-		// (head->dwWidth * head->dwHeight) / 16 * 8
-		//   16 pixels per block, 8 bytes per block
-		uint32_t total_bytes_per_pic = (head->dwWidth * head->dwHeight) >> 1;
-		if (head->dwWidth < 4 || head->dwHeight < 4) {
-			total_bytes_per_pic = head->dwWidth * head->dwHeight * 4;
-		}
+	if (cubemap && head->dwWidth != head->dwHeight) {
+		printf("cubemap width not equal to height\n");
+		return false;
+	}
 
-		bool mipmap_error = false;
-		if (head->dwSurfaceFlags & DDS_SURFACE_FLAGS_MIPMAP) {
-			uint32_t mip_map_count = head->dwMipMapCount;
-			uint32_t w = head->dwWidth;
-			uint32_t h = head->dwHeight;
+	image.width_ = (int)head->dwWidth;
+	image.height_ = (int)head->dwHeight;
+	image.format_ = fmt;
+	image.mip_levels_ = (int)mip_levels;
+	image.array_layers_ = (int)array_layers;
+	image.cubemap_ = cubemap;
+
+	size_t size = Img_GetDataSize(image);
+	if (size > data_size) {
+		printf("Truncated dds file\n");
+		memset(&image, 0, sizeof(image));
+		return false;
+	}
 
-			for (uint32_t i = 1; i < mip_map_count; ++i) {
-				w >>= 1;
-				h >>= 1;
+	image.pixels_ = (byte_t*)TEMP_ALLOC(size);
+	if (!image.pixels_) {
+		printf("Memory overflow\n");
+		memset(&image, 0, sizeof(image));
+		return false;
+	}
 
-				if (!w || !h) {
-					mipmap_error = true;
-					break;
-				}
+	memcpy(image.pixels_, data, size);
 
-				if (w < 4 || h < 4) {
-					if (w >= 2 && h >= 2) {
-						total_bytes_per_pic += w * h * 4;
-					}
-				}
-				else {
-					total_bytes_per_pic += w * h / 2;
-				}
-			}
-		}
+	return true;
+}
 
-		if (mipmap_error) {
-			printf("Bad mipmap\n");
-			return false;
+// what Img_Load always returned: level 0 with rows from the bottom, cube maps unfolded to the cross above
+static bool DDS_DecompressLevel0(const image_s& compressed, image_s& image) {
+	auto CopyFlipped = [](const image_s& src, image_s& dst, uint32_t dst_x, uint32_t dst_y) {
+		size_t texel_bytes = src.format_ == image_format_t::R8G8B8A8 ? 4 : 8;
+		size_t row_bytes = src.width_ * texel_bytes;
+
+		for (int y = 0; y < src.height_; ++y) {
+			const byte_t* src_row = src.pixels_ + y * row_bytes;
+			byte_t* dst_row = dst.pixels_ + ((dst_y + src.height_ - y - 1) * (size_t)dst.width_ + dst_x) * texel_bytes;
+			memcpy(dst_row, src_row, row_bytes);
 		}
+	};
 
-		const byte_t* src_pixels = (const byte_t*)(head + 1);
+	image_s face = {};
 
-		// use mipmap level 0 only
-		if (head->dwSurfaceFlags & DDS_SURFACE_FLAGS_CUBEMAP) {
-			if (head->dwWidth != head->dwHeight) {
-				printf("cubemap width not equal to height\n");
-			}
-			else {
-				if (head->dwCubemapFlags == DDS_CUBEMAP_ALLFACES) {
-					uint32_t dst_w = head->dwWidth * 4;
-					uint32_t dst_h = head->dwHeight * 3;
+	if (!compressed.cubemap_) {
+		if (!Img_Decompress(compressed, 0, 0, face)) {
+			return false;
+		}
 
-					uint32_t num_dst_pixels = dst_w * dst_h;
+		bool ok = Img_Create(face.width_, face.height_, face.format_, image);
+		if (ok) {
+			CopyFlipped(face, image, 0, 0);
+		}
+		else {
+			printf("Memory overflow\n");
+		}
 
-					byte_t* dst_pixels = (byte_t*)TEMP_ALLOC(4 * num_dst_pixels);
-					if (!dst_pixels) {
-						printf("Memory overflow\n");
-					}
-					else {
-						// fill zero
-						memset(dst_pixels, 0, num_dst_pixels * 4);
+		Img_Free(face);
 
-						image.width_ = (int)dst_w;
-						image.height_ = (int)dst_h;
-						image.format_ = image_format_t::R8G8B8A8;
-						image.pixels_ = dst_pixels;
+		return ok;
+	}
 
-						auto CopyPicture = [head, dst_w, dst_h, dst_pixels, CopyPixels](const byte_t* src,
-							uint32_t dst_offset_x, uint32_t dst_offset_y)
-							{
-								byte_t* dst = dst_pixels + (dst_offset_y * dst_w + dst_offset_x) * 4;
-								CopyPixels(src, dst, dst_w, dst_h);
-							};
+	uint32_t face_size = (uint32_t)compressed.width_;
+	bool hdr = compressed.format_ == image_format_t::BC6H_UFLOAT || compressed.format_ == image_format_t::BC6H_SFLOAT;
 
-						for (int i = 0; i < 6; ++i) {
-							CopyPicture(
-								src_pixels + i * total_bytes_per_pic,
-								CUBEMAP_OFFSET_X[i] * head->dwWidth,
-								CUBEMAP_OFFSET_Y[i] * head->dwHeight);
-						}
+	if (!Img_Create(face_size * 4, face_size * 3,
+		hdr ? image_format_t::R16G16B16A16_FLOAT : image_format_t::R8G8B8A8, image))
+	{
+		printf("Memory overflow\n");
+		return false;
+	}
 
-						ok = true;
-					}
+	// fill zero
+	memset(image.pixels_, 0, (size_t)image.width_ * image.height_ * (hdr ? 8 : 4));
 
-				}
-				else {
-					printf("Only support DDS_CUBEMAP_ALLFACES cubemap mode\n");
-				}
-			}
+	for (int i = 0; i < 6; ++i) {
+		if (!Img_Decompress(compressed, i, 0, face)) {
+			Img_Free(image);
+			return false;
 		}
-		else {
-			// not a cubemap
-			uint32_t num_dst_pixels = head->dwWidth * head->dwHeight;
-
-			byte_t* dst_pixels = (byte_t*)TEMP_ALLOC(num_dst_pixels * 4);
-			if (!dst_pixels) {
-				printf("Memory overflow\n");
-			}
-			else {
-				image.width_ = (int)head->dwWidth;
-				image.height_ = (int)head->dwHeight;
-				image.format_ = image_format_t::R8G8B8A8;
-				image.pixels_ = dst_pixels;
 
-				CopyPixels(src_pixels, dst_pixels, head->dwWidth, head->dwHeight);
+		CopyFlipped(face, image, CUBEMAP_OFFSET_X[i] * face_size, CUBEMAP_OFFSET_Y[i] * face_size);
 
-				ok = true;
-			}
-		}
+		Img_Free(face);
+	}
 
-		return ok;
-	};
+	return true;
+}
 
+// keep_compressed: false to decode block compressed files as Img_Load always did
+bool Image_LoadDDS(const char* filename, image_s& image, bool keep_compressed) {
 	auto Load_DDSPF_A8R8G8B8 = [](DDS_HEADER* head, image_s& image) -> bool {
 		bool ok = false;
 
@@ -784,11 +689,37 @@ bool Image_LoadDDS(const char* filename, image_s& image) {
 
 	DDS_HEADER * head = (DDS_HEADER*)(magic + 1);
 
+	const byte_t* data = (const byte_t*)(head + 1);
+	size_t data_offset = sizeof(DWORD) + SIZEOF_HEAD;
+
+	const DDS_HEADER_DXT10* dx10 = nullptr;
+	if ((head->ddspf.dwFlags & DDPF_FOURCC) && head->ddspf.dwFourCC == DDSPF_DX10.dwFourCC) {
+		dx10 = (const DDS_HEADER_DXT10*)data;
+		data += sizeof(DDS_HEADER_DXT10);
+		data_offset += sizeof(DDS_HEADER_DXT10);
+	}
+
+	if ((size_t)file_size < data_offset) {
+		printf("Bad dds file\n");
+		File_FreeBinary(buffer);
+		return false;
+	}
+
 	bool ok = false;
+	image_format_t compressed_format = image_format_t::R8G8B8A8;
 
 	if (head->dwSurfaceFlags & DDS_SURFACE_FLAGS_TEXTURE) {
-		if (memcmp(&head->ddspf, &DDSPF_DXT1, sizeof(head->ddspf)) == 0) {
-			ok = Load_DDSPF_DXT1(head, image);
+		if (DDS_GetCompressedFormat(head, dx10, compressed_format)) {
+			if (keep_compressed) {
+				ok = DDS_LoadCompressed(head, dx10, compressed_format, data, file_size - data_offset, image);
+			}
+			else {
+				image_s compressed = {};
+				if (DDS_LoadCompressed(head, dx10, compressed_format, data, file_size - data_offset, compressed)) {
+					ok = DDS_DecompressLevel0(compressed, image);
+					Img_Free(compressed);
+				}
+			}
 		}
 		else if (memcmp(&head->ddspf, &DDSPF_A8R8G8B8, sizeof(head->ddspf)) == 0) {
 			ok = Load_DDSPF_A8R8G8B8(head, image);
@@ -809,3 +740,114 @@ bool Image_LoadDDS(const char* filename, image_s& image) {
 
 	return ok;
 }
+
+/*
+================================================================================
+writer
+================================================================================
+*/
+
+static DXGI_FORMAT DDS_GetDXGIFormat(image_format_t fmt) {
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:		return DXGI_FORMAT_BC1_UNORM;
+	case image_format_t::BC1_SRGB:		return DXGI_FORMAT_BC1_UNORM_SRGB;
+	case image_format_t::BC2_UNORM:		return DXGI_FORMAT_BC2_UNORM;
+	case image_format_t::BC2_SRGB:		return DXGI_FORMAT_BC2_UNORM_SRGB;
+	case image_format_t::BC3_UNORM:		return DXGI_FORMAT_BC3_UNORM;
+	case image_format_t::BC3_SRGB:		return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case image_format_t::BC4_UNORM:		return DXGI_FORMAT_BC4_UNORM;
+	case image_format_t::BC4_SNORM:		return DXGI_FORMAT_BC4_SNORM;
+	case image_format_t::BC5_UNORM:		return DXGI_FORMAT_BC5_UNORM;
+	case image_format_t::BC5_SNORM:		return DXGI_FORMAT_BC5_SNORM;
+	case image_format_t::BC6H_UFLOAT:	return DXGI_FORMAT_BC6H_UF16;
+	case image_format_t::BC6H_SFLOAT:	return DXGI_FORMAT_BC6H_SF16;
+	case image_format_t::BC7_UNORM:		return DXGI_FORMAT_BC7_UNORM;
+	case image_format_t::BC7_SRGB:		return DXGI_FORMAT_BC7_UNORM_SRGB;
+	default:							return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+// FourCC of the formats older readers know, 0: DX10 header only
+static DWORD DDS_GetLegacyFourCC(image_format_t fmt) {
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:		return MAKEFOURCC('D', 'X', 'T', '1');
+	case image_format_t::BC2_UNORM:		return MAKEFOURCC('D', 'X', 'T', '3');
+	case image_format_t::BC3_UNORM:		return MAKEFOURCC('D', 'X', 'T', '5');
+	case image_format_t::BC4_UNORM:		return MAKEFOURCC('B', 'C', '4', 'U');
+	case image_format_t::BC4_SNORM:		return MAKEFOURCC('B', 'C', '4', 'S');
+	case image_format_t::BC5_UNORM:		return MAKEFOURCC('A', 'T', 'I', '2');
+	case image_format_t::BC5_SNORM:		return MAKEFOURCC('B', 'C', '5', 'S');
+	default:							return 0;
+	}
+}
+
+// block compressed images with all their levels and layers, the DX10 header only when the legacy one
+// can't describe the format or the layers
+bool Image_SaveDDS(const char* filename, const image_s& image) {
+	if (!Img_IsCompressed(image.format_)) {
+		printf("Only support block compressed dds files\n");
+		return false;
+	}
+
+	uint32_t mip_levels = image.mip_levels_ > 1 ? (uint32_t)image.mip_levels_ : 1;
+	uint32_t array_layers = image.array_layers_ > 1 ? (uint32_t)image.array_layers_ : 1;
+
+	if (image.cubemap_ && (array_layers % 6 || image.width_ != image.height_)) {
+		printf("Bad cubemap\n");
+		return false;
+	}
+
+	DWORD four_cc = DDS_GetLegacyFourCC(image.format_);
+	bool legacy = four_cc && (array_layers == 1 || (image.cubemap_ && array_layers == 6));
+
+	DDS_HEADER head = {};
+
+	head.dwSize = (DWORD)SIZEOF_HEAD;
+	head.dwHeaderFlags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_LINEARSIZE | (mip_levels > 1 ? DDS_HEADER_FLAGS_MIPMAP : 0);
+	head.dwHeight = (DWORD)image.height_;
+	head.dwWidth = (DWORD)image.width_;
+	head.dwPitchOrLinearSize = (DWORD)Img_GetLevelSize(image, 0);
+	head.dwMipMapCount = mip_levels;
+	head.dwSurfaceFlags = DDS_SURFACE_FLAGS_TEXTURE
+		| (mip_levels > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0)
+		| (image.cubemap_ ? DDS_SURFACE_FLAGS_CUBEMAP : 0);
+	head.dwCubemapFlags = image.cubemap_ ? DDS_CUBEMAP_ALLFACES : 0;
+
+	if (legacy) {
+		head.ddspf = DDSPF_DXT1;
+		head.ddspf.dwFourCC = four_cc;
+	}
+	else {
+		head.ddspf = DDSPF_DX10;
+	}
+
+	DDS_HEADER_DXT10 dx10 = {};
+
+	dx10.dxgiFormat = DDS_GetDXGIFormat(image.format_);
+	dx10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+	dx10.miscFlag = image.cubemap_ ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+	dx10.arraySize = image.cubemap_ ? array_layers / 6 : array_layers;
+	dx10.reserved = 0;
+
+	FILE* f = File_Open(filename, "wb");
+	if (!f) {
+		printf("Could not open file \"%s\" to write\n", filename);
+		return false;
+	}
+
+	DWORD magic = DDS_MAGIC;
+	size_t size = Img_GetDataSize(image);
+
+	bool ok = fwrite(&magic, sizeof(magic), 1, f) == 1
+		&& fwrite(&head, sizeof(head), 1, f) == 1
+		&& (legacy || fwrite(&dx10, sizeof(dx10), 1, f) == 1)
+		&& fwrite(image.pixels_, 1, size, f) == size;
+
+	fclose(f);
+
+	if (!ok) {
+		printf("Failed to write \"%s\"\n", filename);
+	}
+
+	return ok;
+}
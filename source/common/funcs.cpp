@@ -6,6 +6,28 @@
 #include <pnglibconf.h>
 #include <png.h>
 #include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+#if defined(CPU_X86)
+# include <immintrin.h>
+# if !defined(_MSC_VER)
+#  include <cpuid.h>
+# endif
+#endif
+
+#if defined(PLATFORM_LINUX)
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <string>
+# include <locale>
+# include <codecvt>
+#endif
 
 /*
 ================================================================================
@@ -16,6 +38,30 @@ common
 static char	g_data_folder[MAX_PATH];
 static char g_shaders_folder[MAX_PATH];
 
+static void Str_WCopy(wchar_t* dst, int dst_cap, const wchar_t* src) {
+#if defined(_MSC_VER)
+	wcsncpy_s(dst, dst_cap, src, _TRUNCATE);
+#endif
+
+#if defined(__GNUC__)
+	wcsncpy(dst, src, dst_cap - 1);
+	dst[dst_cap - 1] = 0;
+#endif
+}
+
+static void Str_WCat(wchar_t* dst, int dst_cap, const wchar_t* src) {
+#if defined(_MSC_VER)
+	wcsncat_s(dst, dst_cap, src, _TRUNCATE);
+#endif
+
+#if defined(__GNUC__)
+	int l = (int)wcslen(dst);
+	if (dst_cap > (l + 1)) {
+		wcsncat(dst, src, dst_cap - l - 1);
+	}
+#endif
+}
+
 static wchar_t * FindDoubleDots(wchar_t* path) {
 	wchar_t* pc = wcsstr(path, L"..\\");
 	if (!pc) {
@@ -37,8 +83,8 @@ static wchar_t * RFindSlash(wchar_t* path) {
 static void Str_EraseDoubleDotsInPath(wchar_t* path) {
 	wchar_t sl[2][MAX_PATH];
 
-	wcscpy_s(sl[0], MAX_PATH, path);
-	wcscpy_s(sl[1], MAX_PATH, path);
+	Str_WCopy(sl[0], MAX_PATH, path);
+	Str_WCopy(sl[1], MAX_PATH, path);
 
 	int srcidx = 0;
 	int dstidx = 1 - srcidx;
@@ -54,8 +100,8 @@ static void Str_EraseDoubleDotsInPath(wchar_t* path) {
 			wchar_t* pc2 = RFindSlash(sl[srcidx]);
 			if (pc2) {
 				pc2[1] = 0;
-				wcscpy_s(sl[dstidx], MAX_PATH, sl[srcidx]);
-				wcscat_s(sl[dstidx], MAX_PATH, pc + 3);
+				Str_WCopy(sl[dstidx], MAX_PATH, sl[srcidx]);
+				Str_WCat(sl[dstidx], MAX_PATH, pc + 3);
 
 				srcidx = 1 - srcidx;
 				dstidx = 1 - srcidx;
@@ -72,7 +118,7 @@ static void Str_EraseDoubleDotsInPath(wchar_t* path) {
 		}
 	}
 
-	wcscpy_s(path, MAX_PATH, sl[srcidx]);
+	Str_WCopy(path, MAX_PATH, sl[srcidx]);
 }
 
 static bool IsDirectorySeparator(wchar_t c) {
@@ -100,7 +146,7 @@ void Common_Init() {
 	GetModuleFileName(GetModuleHandle(NULL), buffer, MAX_PATH);
 
 	Str_ExtractFileDirSelf(buffer);
-	wcscat_s(buffer, L"\\..\\..\\..");
+	Str_WCat(buffer, MAX_PATH, L"\\..\\..\\..");
 	Str_EraseDoubleDotsInPath(buffer);
 
 	char cbuffer[MAX_PATH];
@@ -108,6 +154,18 @@ void Common_Init() {
 
 	Str_SPrintf(g_data_folder, COUNT_OF(g_data_folder), "%s\\data", cbuffer);
 	Str_SPrintf(g_shaders_folder, COUNT_OF(g_shaders_folder), "%s\\shaders", cbuffer);
+#elif defined(PLATFORM_LINUX)
+	// single configuration generators put the executables in <repo>/bin
+	char exe_path[MAX_PATH] = {};
+	char exe_dir[MAX_PATH] = {};
+	ssize_t len = readlink("/proc/self/exe", exe_path, MAX_PATH - 1);
+	if (len > 0) {
+		exe_path[len] = 0;
+		Str_ExtractFileDir(exe_path, exe_dir, MAX_PATH);
+	}
+
+	Str_SPrintf(g_data_folder, COUNT_OF(g_data_folder), "%s/../data", exe_dir);
+	Str_SPrintf(g_shaders_folder, COUNT_OF(g_shaders_folder), "%s/../shaders", exe_dir);
 #endif
 
 	// randomize
@@ -115,6 +173,12 @@ void Common_Init() {
 
 	InitHalfFloatToFloatTables();
 	InitFloatToHalfFloatTables();
+
+	Job_Init(0);
+}
+
+void Common_Shutdown() {
+	Job_Shutdown();
 }
 
 COMMON_API const char * GetDataFolder() {
@@ -175,7 +239,7 @@ static void InitHalfFloatToFloatTables() {
 
 	// exponent table
 	g_exponent_table[0] = 0;
-	g_exponent_table[32] = 0x8000000;
+	g_exponent_table[32] = 0x80000000;
 
 	for (uint32_t i = 1; i <= 30; ++i) {
 		g_exponent_table[i] = i << 23;
@@ -192,8 +256,10 @@ static void InitHalfFloatToFloatTables() {
 	g_offset_table[0] = 0;
 	g_offset_table[32] = 0;
 
-	for (uint32_t i = 1; i < 32; ++i) {
-		g_offset_table[i] = 1024;
+	for (uint32_t i = 1; i < 64; ++i) {
+		if (i != 32) {
+			g_offset_table[i] = 1024;
+		}
 	}
 }
 
@@ -257,24 +323,416 @@ COMMON_API float16_t FloatToHalfFloat(float f) {
 	return g_base_table[(fu.i_ >> 23) & 0x1ff] + ((fu.i_ & 0x007fffff) >> g_shift_table[(fu.i_ >> 23) & 0x1ff]);
 }
 
+/*
+  array conversions give the results of the F16C instructions on every path:
+  NaNs are quieted, float to half rounds to nearest even
+*/
+
+static float HalfFloatToFloat_Quiet(float16_t h) {
+	float_uint_s fu;
+
+	fu.i_ = g_mantissa_table[g_offset_table[h >> 10] + (h & 0x3ff)] + g_exponent_table[h >> 10];
+	if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff)) {
+		fu.i_ |= 0x00400000;
+	}
+
+	return fu.f_;
+}
+
+static float16_t FloatToHalfFloat_RNE(float f) {
+	float_uint_s fu;
+
+	fu.f_ = f;
+
+	uint32_t idx = (fu.i_ >> 23) & 0x1ff;
+	uint32_t mantissa = fu.i_ & 0x007fffff;
+	uint32_t shift = g_shift_table[idx];
+	uint32_t h = g_base_table[idx] + (mantissa >> shift);
+
+	int32_t e = (int32_t)(idx & 0xff) - 127;
+	if (e == 128) {				// NaN keeps the top of its payload
+		return (float16_t)(mantissa ? (h | 0x0200) : h);
+	}
+
+	if (e < -25 || e > 15) {	// zero or infinity whatever the rounding
+		return (float16_t)h;
+	}
+
+	// denorms shift the implicit 1 in, a carry may reach the exponent
+	uint32_t significand = e < -14 ? (mantissa | 0x00800000) : mantissa;
+	uint32_t rest = significand & ((1u << shift) - 1);
+	uint32_t half = 1u << (shift - 1);
+	if (rest > half || (rest == half && (h & 1))) {
+		h++;
+	}
+
+	return (float16_t)h;
+}
+
+#if defined(CPU_X86)
+
+// 4 halves in the low 16 bits of each lane
+static inline __m128 HalfFloatToFloat_SSE2(__m128i h) {
+	__m128i exp_mantissa = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+
+	// rebias by a multiply, exact for denorms too
+	__m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exp_mantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+
+	__m128i inf_nan = _mm_cmpgt_epi32(exp_mantissa, _mm_set1_epi32(0x7bff));
+	__m128i nan = _mm_cmpgt_epi32(exp_mantissa, _mm_set1_epi32(0x7c00));
+	__m128i bits = _mm_or_si128(_mm_castps_si128(f), _mm_and_si128(inf_nan, _mm_set1_epi32(0x7f800000)));
+	bits = _mm_or_si128(bits, _mm_and_si128(nan, _mm_set1_epi32(0x00400000)));
+
+	return _mm_castsi128_ps(_mm_or_si128(bits, sign));
+}
+
+// 4 halves in the low 16 bits of each lane
+static inline __m128i FloatToHalfFloat_SSE2(__m128 f) {
+	__m128i x = _mm_castps_si128(f);
+	__m128i sign = _mm_and_si128(x, _mm_set1_epi32((int)0x80000000));
+	__m128i a = _mm_xor_si128(x, sign);
+
+	// overflow, infinity, NaN
+	__m128i nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f800000));
+	__m128i big = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x477fffff));
+	__m128i payload = _mm_or_si128(_mm_set1_epi32(0x0200), _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(0x03ff)));
+	__m128i h_big = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, payload));
+
+	// denorms: adding 0.5 rounds the mantissa into place
+	const __m128i DENORM_MAGIC = _mm_set1_epi32(126 << 23);
+	__m128i small = _mm_cmpgt_epi32(_mm_set1_epi32(113 << 23), a);
+	__m128i h_small = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(DENORM_MAGIC))), DENORM_MAGIC);
+
+	// normals: rebias, round to nearest even, the carry may reach infinity
+	__m128i odd = _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(1));
+	__m128i h_normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(a, _mm_set1_epi32((int)0xc8000fff)), odd), 13);
+
+	__m128i h = _mm_or_si128(_mm_and_si128(big, h_big), _mm_andnot_si128(big, h_normal));
+	h = _mm_or_si128(_mm_and_si128(small, h_small), _mm_andnot_si128(small, h));
+
+	return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+}
+
+static void HalfFloatToFloatArray_SSE2(const float16_t* src, float* dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_ps(dst + i, HalfFloatToFloat_SSE2(_mm_unpacklo_epi16(h, _mm_setzero_si128())));
+		_mm_storeu_ps(dst + i + 4, HalfFloatToFloat_SSE2(_mm_unpackhi_epi16(h, _mm_setzero_si128())));
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = HalfFloatToFloat_Quiet(src[i]);
+	}
+}
+
+static void FloatToHalfFloatArray_SSE2(const float* src, float16_t* dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = FloatToHalfFloat_SSE2(_mm_loadu_ps(src + i));
+		__m128i hi = FloatToHalfFloat_SSE2(_mm_loadu_ps(src + i + 4));
+
+		// sign extend so the signed pack keeps the 16 bits
+		lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+		hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = FloatToHalfFloat_RNE(src[i]);
+	}
+}
+
+TARGET_F16C static void HalfFloatToFloatArray_F16C(const float16_t* src, float* dst, size_t count) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 lo = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i)));
+		__m256 hi = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i + 8)));
+		_mm256_storeu_ps(dst + i, lo);
+		_mm256_storeu_ps(dst + i + 8, hi);
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = HalfFloatToFloat_Quiet(src[i]);
+	}
+}
+
+TARGET_F16C static void FloatToHalfFloatArray_F16C(const float* src, float16_t* dst, size_t count) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i lo = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		__m128i hi = _mm256_cvtps_ph(_mm256_loadu_ps(src + i + 8), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(dst + i), lo);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), hi);
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = FloatToHalfFloat_RNE(src[i]);
+	}
+}
+
+#endif
+
+COMMON_API void HalfFloatToFloatArray(const float16_t* src, float* dst, size_t count) {
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		HalfFloatToFloatArray_F16C(src, dst, count);
+		return;
+	case simd_level_t::SSE2:
+		HalfFloatToFloatArray_SSE2(src, dst, count);
+		return;
+	default:
+		break;
+	}
+#endif
+
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = HalfFloatToFloat_Quiet(src[i]);
+	}
+}
+
+COMMON_API void FloatToHalfFloatArray(const float* src, float16_t* dst, size_t count) {
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		FloatToHalfFloatArray_F16C(src, dst, count);
+		return;
+	case simd_level_t::SSE2:
+		FloatToHalfFloatArray_SSE2(src, dst, count);
+		return;
+	default:
+		break;
+	}
+#endif
+
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = FloatToHalfFloat_RNE(src[i]);
+	}
+}
+
 /*
 ================================================================================
 random number generator
 ================================================================================
 */
-static std::atomic<uint32_t> g_rand_next = 1;
+static const uint64_t PCG_MULTIPLIER = 6364136223846793005ull;
+
+// 24 bits to [0, 1], the same multiply in every path
+static const float RAND_UNORM24_SCALE = 1.0f / 16777215.0f;
+
+COMMON_API void Rand_Init(rand_stream_s& rs, uint64_t seed, uint64_t stream) {
+	rs.state_ = 0;
+	rs.inc_ = (stream << 1) | 1;
+	Rand_Next(rs);
+	rs.state_ += seed;
+	Rand_Next(rs);
+}
+
+COMMON_API rand_stream_s Rand_Split(rand_stream_s& rs) {
+	uint64_t seed = Rand_Next(rs);
+	seed = (seed << 32) | Rand_Next(rs);
+	uint64_t stream = Rand_Next(rs);
+	stream = (stream << 32) | Rand_Next(rs);
+
+	rand_stream_s child;
+	Rand_Init(child, seed, stream);
+	return child;
+}
+
+COMMON_API void Rand_Advance(rand_stream_s& rs, uint64_t delta) {
+	// the LCG step composed by squaring
+	uint64_t cur_mult = PCG_MULTIPLIER, cur_plus = rs.inc_;
+	uint64_t acc_mult = 1, acc_plus = 0;
+
+	while (delta) {
+		if (delta & 1) {
+			acc_mult *= cur_mult;
+			acc_plus = acc_plus * cur_mult + cur_plus;
+		}
+		cur_plus = (cur_mult + 1) * cur_plus;
+		cur_mult *= cur_mult;
+		delta >>= 1;
+	}
+
+	rs.state_ = acc_mult * rs.state_ + acc_plus;
+}
+
+COMMON_API uint32_t Rand_Next(rand_stream_s& rs) {
+	uint64_t old = rs.state_;
+	rs.state_ = old * PCG_MULTIPLIER + rs.inc_;
+
+	// XSH RR
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+}
+
+COMMON_API uint32_t Rand_Range(rand_stream_s& rs, uint32_t bound) {
+	if (!bound) {
+		return 0;
+	}
+
+	// Lemire: multiply, reject the few low products that would bias
+	uint64_t m = (uint64_t)Rand_Next(rs) * bound;
+	if ((uint32_t)m < bound) {
+		uint32_t threshold = (0u - bound) % bound;
+		while ((uint32_t)m < threshold) {
+			m = (uint64_t)Rand_Next(rs) * bound;
+		}
+	}
+
+	return (uint32_t)(m >> 32);
+}
+
+// return [0, 1]
+COMMON_API float Rand_Float01(rand_stream_s& rs) {
+	return (float)(Rand_Next(rs) >> 8) * RAND_UNORM24_SCALE;
+}
+
+// return [-1, 1]
+COMMON_API float Rand_FloatNeg1Pos1(rand_stream_s& rs) {
+	// odd integers -(2^24 - 1) ~ 2^24 - 1, exact in a float
+	return (float)((int32_t)(Rand_Next(rs) >> 8) * 2 - 16777215) * RAND_UNORM24_SCALE;
+}
+
+// counter-based: a bijection of i keyed by k0, k1, only 32-bit multiplies so it vectorizes
+static inline uint32_t Rand_CounterHash(uint32_t i, uint32_t k0, uint32_t k1) {
+	uint32_t x = i * 0x9E3779B9u + k0;
+	x ^= x >> 16;
+	x *= 0x21F0AAADu;
+	x ^= k1;
+	x ^= x >> 15;
+	x *= 0x735A2D97u;
+	x ^= x >> 15;
+	return x;
+}
+
+static void Rand_Fill_Scalar(float* dst, size_t count, uint32_t k0, uint32_t k1, bool neg1pos1) {
+	for (size_t i = 0; i < count; ++i) {
+		int32_t v = (int32_t)(Rand_CounterHash((uint32_t)i, k0, k1) >> 8);
+		if (neg1pos1) {
+			v = v * 2 - 16777215;
+		}
+		dst[i] = (float)v * RAND_UNORM24_SCALE;
+	}
+}
+
+#if defined(CPU_X86)
+
+// no 32-bit multiply before SSE4.1: two 32x32->64 multiplies, low halves put back in order
+static inline __m128i Rand_Mul32_SSE2(__m128i a, __m128i b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void Rand_Fill_SSE2(float* dst, size_t count, uint32_t k0, uint32_t k1, bool neg1pos1) {
+	const __m128i golden = _mm_set1_epi32((int)0x9E3779B9u);
+	const __m128i m0 = _mm_set1_epi32((int)0x21F0AAADu);
+	const __m128i m1 = _mm_set1_epi32((int)0x735A2D97u);
+	const __m128i key0 = _mm_set1_epi32((int)k0);
+	const __m128i key1 = _mm_set1_epi32((int)k1);
+	const __m128i bias = _mm_set1_epi32(neg1pos1 ? 16777215 : 0);
+	const int shift = neg1pos1 ? 1 : 0;
+	const __m128 scale = _mm_set1_ps(RAND_UNORM24_SCALE);
+
+	__m128i counter = _mm_setr_epi32(0, 1, 2, 3);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_add_epi32(Rand_Mul32_SSE2(counter, golden), key0);
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+		x = Rand_Mul32_SSE2(x, m0);
+		x = _mm_xor_si128(x, key1);
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+		x = Rand_Mul32_SSE2(x, m1);
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+
+		__m128i v = _mm_sub_epi32(_mm_sll_epi32(_mm_srli_epi32(x, 8), _mm_cvtsi32_si128(shift)), bias);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+
+		counter = _mm_add_epi32(counter, _mm_set1_epi32(4));
+	}
+
+	Rand_Fill_Scalar(dst + i, count - i, k0 + (uint32_t)i * 0x9E3779B9u, k1, neg1pos1);
+}
+
+TARGET_AVX2 static void Rand_Fill_AVX2(float* dst, size_t count, uint32_t k0, uint32_t k1, bool neg1pos1) {
+	const __m256i golden = _mm256_set1_epi32((int)0x9E3779B9u);
+	const __m256i m0 = _mm256_set1_epi32((int)0x21F0AAADu);
+	const __m256i m1 = _mm256_set1_epi32((int)0x735A2D97u);
+	const __m256i key0 = _mm256_set1_epi32((int)k0);
+	const __m256i key1 = _mm256_set1_epi32((int)k1);
+	const __m256i bias = _mm256_set1_epi32(neg1pos1 ? 16777215 : 0);
+	const __m128i shift = _mm_cvtsi32_si128(neg1pos1 ? 1 : 0);
+	const __m256 scale = _mm256_set1_ps(RAND_UNORM24_SCALE);
+
+	__m256i counter = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_add_epi32(_mm256_mullo_epi32(counter, golden), key0);
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+		x = _mm256_mullo_epi32(x, m0);
+		x = _mm256_xor_si256(x, key1);
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+		x = _mm256_mullo_epi32(x, m1);
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+
+		__m256i v = _mm256_sub_epi32(_mm256_sll_epi32(_mm256_srli_epi32(x, 8), shift), bias);
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+
+		counter = _mm256_add_epi32(counter, _mm256_set1_epi32(8));
+	}
+
+	Rand_Fill_Scalar(dst + i, count - i, k0 + (uint32_t)i * 0x9E3779B9u, k1, neg1pos1);
+}
+
+#endif
+
+static void Rand_Fill(rand_stream_s& rs, float* dst, size_t count, bool neg1pos1) {
+	uint32_t k0 = Rand_Next(rs);
+	uint32_t k1 = Rand_Next(rs);
+
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		Rand_Fill_AVX2(dst, count, k0, k1, neg1pos1);
+		return;
+	case simd_level_t::SSE2:
+		Rand_Fill_SSE2(dst, count, k0, k1, neg1pos1);
+		return;
+	default:
+		break;
+	}
+#endif
+
+	Rand_Fill_Scalar(dst, count, k0, k1, neg1pos1);
+}
+
+COMMON_API void Rand_Fill01(rand_stream_s& rs, float* dst, size_t count) {
+	Rand_Fill(rs, dst, count, false);
+}
+
+COMMON_API void Rand_FillNeg1Pos1(rand_stream_s& rs, float* dst, size_t count) {
+	Rand_Fill(rs, dst, count, true);
+}
+
+// compatibility layer: the LCG of the POSIX example, a seed gives the sequence it always gave
+
+static thread_local uint32_t t_rand_next = 1;
 
 COMMON_API void SRand(uint32_t seed) {
-	g_rand_next.store(seed);
+	t_rand_next = seed;
 }
 
 static const uint32_t RAND_MAX_VALUE = 32767;
 
 COMMON_API uint32_t Rand() {
-	uint32_t next = g_rand_next.load();
-	next = next * 1103515245 + 12345;
-	g_rand_next.store(next);
-	return next / 65536 % 32768;
+	t_rand_next = t_rand_next * 1103515245 + 12345;
+	return t_rand_next / 65536 % 32768;
 }
 
 // return [0, 1]
@@ -288,6 +746,86 @@ COMMON_API float RandNeg1Pos1() {
 	return f * 2.0f - 1.0f;
 }
 
+COMMON_API uint32_t RandHash(uint32_t seed, uint32_t x, uint32_t y) {
+	// murmur3 finalizer over the combined key
+	uint32_t h = seed ^ (x * 0x9E3779B1u) ^ (y * 0x85EBCA77u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+/*
+================================================================================
+thread
+================================================================================
+*/
+COMMON_API uint32_t Thread_GetHardwareConcurrency() {
+	uint32_t n = std::thread::hardware_concurrency();
+	return n ? n : 1;
+}
+
+COMMON_API void Thread_Run(uint32_t count, const std::function<void(uint32_t idx)>& func) {
+	// one index per chunk, the pool threads are reused instead of started per call
+	Job_ParallelFor(0, count, 1, [&func](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			func(i);
+		}
+	});
+}
+
+/*
+================================================================================
+cpu
+================================================================================
+*/
+
+static simd_level_t Cpu_DetectSIMDLevel() {
+#if defined(CPU_X86)
+# if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool f16c = (info[2] & (1 << 29)) != 0;
+
+	// the os must save the ymm registers
+	if (max_leaf >= 7 && osxsave && avx && f16c && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5)) {
+			return simd_level_t::AVX2;
+		}
+	}
+	return simd_level_t::SSE2;
+# else
+	// __builtin_cpu_supports does not know f16c on every gcc
+	unsigned int eax, ebx, ecx, edx;
+	bool f16c = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 29)) != 0;
+
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && f16c ? simd_level_t::AVX2 : simd_level_t::SSE2;
+# endif
+#else
+	return simd_level_t::SCALAR;
+#endif
+}
+
+static simd_level_t g_simd_level_supported = Cpu_DetectSIMDLevel();
+static simd_level_t g_simd_level = g_simd_level_supported;
+
+COMMON_API simd_level_t Cpu_GetSIMDLevel() {
+	return g_simd_level;
+}
+
+COMMON_API void Cpu_SetSIMDLevel(simd_level_t level) {
+	g_simd_level = level < g_simd_level_supported ? level : g_simd_level_supported;
+}
+
 /*
 ================================================================================
 file
@@ -391,6 +929,110 @@ COMMON_API void File_FreeText(char* data) {
 	}
 }
 
+COMMON_API bool File_GetStat(const char* filename, uint64_t& size, int64_t& mtime) {
+	size = 0;
+	mtime = 0;
+
+#if defined(_MSC_VER)
+	char16_t char16_filename[1024];
+	Str_UTF8ToUTF16(filename, char16_filename, 1024);
+
+	struct _stat64 st;
+	if (_wstat64((const wchar_t*)char16_filename, &st) != 0) {
+		return false;
+	}
+#endif
+
+#if defined(__GNUC__)
+	struct stat st;
+	if (stat(filename, &st) != 0) {
+		return false;
+	}
+#endif
+
+	size = (uint64_t)st.st_size;
+	mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+COMMON_API bool File_Map(const char* filename, file_mapping_s& mapping) {
+	mapping.data_ = nullptr;
+	mapping.size_ = 0;
+
+#if defined(_MSC_VER)
+	char16_t char16_filename[1024];
+	Str_UTF8ToUTF16(filename, char16_filename, 1024);
+
+	HANDLE file = CreateFileW((const wchar_t*)char16_filename, GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE file_mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!file_mapping) {
+		return false;
+	}
+
+	// the view keeps the mapping object alive
+	void* data = MapViewOfFile(file_mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(file_mapping);
+	if (!data) {
+		return false;
+	}
+
+	mapping.data_ = data;
+	mapping.size_ = (size_t)sz.QuadPart;
+	return true;
+#endif
+
+#if defined(__GNUC__)
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	mapping.data_ = data;
+	mapping.size_ = (size_t)st.st_size;
+	return true;
+#endif
+}
+
+COMMON_API void File_Unmap(file_mapping_s& mapping) {
+	if (mapping.data_) {
+#if defined(_MSC_VER)
+		UnmapViewOfFile(mapping.data_);
+#endif
+
+#if defined(__GNUC__)
+		munmap(mapping.data_, mapping.size_);
+#endif
+	}
+
+	mapping.data_ = nullptr;
+	mapping.size_ = 0;
+}
+
 /*
 ================================================================================
 string
@@ -504,6 +1146,7 @@ COMMON_API int Str_UTF8ToUTF16(const char* utf8, char16_t* utf16, int utf16_char
 	}
 	else {
 		memcpy(utf16, u16_conv.c_str(), sizeof(char16_t) * u16_conv.size());
+		utf16[u16_conv.size()] = 0;
 		return (int)u16_conv.size();
 	}
 #else
@@ -661,6 +1304,7 @@ COMMON_API int Str_UTF8ToUTF32(const char* utf8, char32_t* utf32, int utf32_char
 	}
 	else {
 		memcpy(utf32, u32_conv.c_str(), sizeof(char32_t) * u32_conv.size());
+		utf32[u32_conv.size()] = 0;
 		return (int)u32_conv.size();
 	}
 #else
@@ -712,6 +1356,7 @@ COMMON_API int Str_UTF16ToUTF8(const char16_t* utf16, char* utf8, int utf8_bytes
 	}
 	else {
 		memcpy(utf8, u8_conv.c_str(), sizeof(char) * u8_conv.size());
+		utf8[u8_conv.size()] = 0;
 		return (int)u8_conv.size();
 	}
 #else
@@ -783,6 +1428,7 @@ COMMON_API int Str_UTF32ToUTF8(const char32_t* utf32, char* utf8, int utf8_bytes
 	}
 	else {
 		memcpy(utf8, u8_conv.c_str(), sizeof(char) * u8_conv.size());
+		utf8[u8_conv.size()] = 0;
 		return (int)u8_conv.size();
 	}
 #else
@@ -1206,15 +1852,117 @@ image
 ================================================================================
 */
 
-static bool Image_LoadBMP(const char* filename, image_s& image);
-static bool Image_LoadPNG(const char* filename, image_s& image);
-static bool Image_LoadTGA(const char* filename, image_s& image);
+#pragma pack(push, 1)
+
+struct bmpfilehead_s {
+	word_t				bfType;
+	dword_t				bfSize;
+	word_t				bfReserved1;
+	word_t				bfReserved2;
+	dword_t				bfOffBits;
+};
+
+struct bmpinfohead_s {
+	dword_t				biSize;
+	int					biWidth;
+	int					biHeight;
+	word_t				biPlanes;
+	word_t				biBitCount;
+	dword_t				biCompression;
+	dword_t				biSizeImage;
+	int					biXPelsPerMeter;
+	int					biYPelsPerMeter;
+	dword_t				biClrUsed;
+	dword_t				biClrImportant;
+};
+
+struct tgahead_s {
+	byte_t				id_length;
+	byte_t				colormap_type;
+	byte_t				image_type;
+	word_t				colormap_index;
+	word_t				colormap_length;
+	byte_t				colormap_size;
+	word_t				x_origin;
+	word_t				y_origin;
+	word_t				width;
+	word_t				height;
+	byte_t				pixel_size;
+	byte_t				attributes;
+};
+
+#pragma pack(pop)
+
+// the R8G8B8A8 rows a decoder writes, row 0 is the bottom row of the picture
+struct image_target_s {
+	byte_t *				row0_;
+	ptrdiff_t				step_;		// negative when the top row comes first in memory
+
+	byte_t *				Row(int y) const { return row0_ + step_ * y; }
+};
+
+// load: nullptr for the layout of Img_Load (allocated, bottom row first)
+static bool Image_LoadBMP(const char* filename, const image_load_s* load, image_s& image);
+static bool Image_LoadPNG(const char* filename, const image_load_s* load, image_s& image);
+static bool Image_LoadTGA(const char* filename, const image_load_s* load, image_s& image);
+bool Image_LoadDDS(const char* filename, image_s& image, bool keep_compressed);	// dds.cpp
+
+// once the size is known: image points to its final memory, target to its rows
+static bool Image_BeginTarget(const image_load_s* load, int width, int height, image_s& image, image_target_s& target) {
+	if (width <= 0 || height <= 0) {
+		printf("Bad image size %dx%d\n", width, height);
+		return false;
+	}
+
+	size_t pitch = (size_t)width * 4;
+	size_t size = pitch * height;
+
+	image.width_ = width;
+	image.height_ = height;
+	image.format_ = image_format_t::R8G8B8A8;
+
+	if (load && load->dst_) {
+		if (load->dst_size_ < size) {
+			printf("%dx%d image does not fit in %zu bytes\n", width, height, load->dst_size_);
+			return false;
+		}
+		image.pixels_ = load->dst_;
+	}
+	else {
+		image.pixels_ = (byte_t*)TEMP_ALLOC(size);
+		if (!image.pixels_) {
+			printf("Could not allocate memory for image\n");
+			return false;
+		}
+	}
+
+	if (load && load->top_first_) {
+		target.row0_ = image.pixels_ + pitch * (height - 1);
+		target.step_ = -(ptrdiff_t)pitch;
+	}
+	else {
+		target.row0_ = image.pixels_;
+		target.step_ = (ptrdiff_t)pitch;
+	}
+
+	return true;
+}
+
+static void Image_AbortTarget(const image_load_s* load, image_s& image) {
+	if (!(load && load->dst_)) {
+		TEMP_FREE(image.pixels_);
+	}
+	memset(&image, 0, sizeof(image));
+}
 
 COMMON_API bool Img_Create(int width, int height, image_format_t fmt, image_s& image) {
 	image.width_ = width;
 	image.height_ = height;
 	image.format_ = fmt;
 	image.pixels_ = nullptr;
+	image.mip_levels_ = 1;
+	image.array_layers_ = 1;
+	image.cubemap_ = false;
 
 	if (fmt == image_format_t::R8G8B8A8) {
 		image.pixels_ = (byte_t*)TEMP_ALLOC(width * height * 4);
@@ -1222,6 +1970,10 @@ COMMON_API bool Img_Create(int width, int height, image_format_t fmt, image_s& i
 	else if (fmt == image_format_t::R16G16B16A16_FLOAT) {
 		image.pixels_ = (byte_t*)TEMP_ALLOC(width * height * 8);
 	}
+	else if (Img_IsCompressed(fmt)) {
+		// level 0 of one layer
+		image.pixels_ = (byte_t*)TEMP_ALLOC(Img_GetLevelSize(image, 0));
+	}
 	else {
 		printf("Unknown image format %d\n", (int)fmt);
 	}
@@ -1237,17 +1989,16 @@ COMMON_API bool Img_Load(const char* filename, image_s& image) {
 	}
 
 	if (Str_ICmp(ext, ".bmp") == 0) {
-		return Image_LoadBMP(filename, image);
+		return Image_LoadBMP(filename, nullptr, image);
 	}
 	else if (Str_ICmp(ext, ".png") == 0) {
-		return Image_LoadPNG(filename, image);
+		return Image_LoadPNG(filename, nullptr, image);
 	}
 	else if (Str_ICmp(ext, ".tga") == 0) {
-		return Image_LoadTGA(filename, image);
+		return Image_LoadTGA(filename, nullptr, image);
 	}
 	else if (Str_ICmp(ext, ".dds") == 0) {
-		bool Image_LoadDDS(const char* filename, image_s & image);
-		return Image_LoadDDS(filename, image);
+		return Image_LoadDDS(filename, image, false);
 	}
 	else {
 		printf("Unsupported image file format %s.\n", ext + 1);
@@ -1255,8 +2006,128 @@ COMMON_API bool Img_Load(const char* filename, image_s& image) {
 	}
 }
 
+COMMON_API bool Img_LoadCompressed(const char* filename, image_s& image) {
+	const char* ext = strrchr(filename, '.');
+	if (ext && Str_ICmp(ext, ".dds") == 0) {
+		return Image_LoadDDS(filename, image, true);
+	}
+	else {
+		return Img_Load(filename, image);
+	}
+}
+
+static bool Image_LoadRGBA(const image_load_s* load, image_s& image) {
+	const char* ext = strrchr(load->filename_, '.');
+
+	if (ext && Str_ICmp(ext, ".bmp") == 0) {
+		return Image_LoadBMP(load->filename_, load, image);
+	}
+	else if (ext && Str_ICmp(ext, ".png") == 0) {
+		return Image_LoadPNG(load->filename_, load, image);
+	}
+	else if (ext && Str_ICmp(ext, ".tga") == 0) {
+		return Image_LoadTGA(load->filename_, load, image);
+	}
+	else {
+		printf("Img_LoadBatch: unsupported file \"%s\"\n", load->filename_);
+		return false;
+	}
+}
+
+COMMON_API bool Img_LoadBatch(image_load_s* loads, uint32_t count) {
+	std::atomic<uint32_t> num_failed = 0;
+
+	// one job per file
+	Job_ParallelFor(0, count, 1, [&](uint32_t file_begin, uint32_t file_end) {
+		for (uint32_t i = file_begin; i < file_end; ++i) {
+			image_load_s& load = loads[i];
+			load.ok_ = Image_LoadRGBA(&load, load.image_);
+			if (!load.ok_) {
+				printf("Failed to load \"%s\"\n", load.filename_);
+				num_failed++;
+			}
+		}
+	});
+
+	return num_failed == 0;
+}
+
+COMMON_API bool Img_GetSize(const char* filename, int& width, int& height) {
+	width = height = 0;
+
+	const char* ext = strrchr(filename, '.');
+	if (!ext) {
+		printf("Could not get filename extension.\n");
+		return false;
+	}
+
+	if (Str_ICmp(ext, ".png") == 0) {
+		png_image image_png;
+		memset(&image_png, 0, sizeof(image_png));
+		image_png.version = PNG_IMAGE_VERSION;
+
+		if (!png_image_begin_read_from_file(&image_png, filename)) {
+			printf("png_image_begin_read_from_file failed\n");
+			return false;
+		}
+
+		width = (int)image_png.width;
+		height = (int)image_png.height;
+		png_image_free(&image_png);
+
+		return true;
+	}
+
+	bool bmp = Str_ICmp(ext, ".bmp") == 0;
+	bool tga = Str_ICmp(ext, ".tga") == 0;
+	if (!bmp && !tga) {
+		printf("Unsupported image file format %s.\n", ext + 1);
+		return false;
+	}
+
+	// only the header is read
+	FILE* f = File_Open(filename, "rb");
+	if (!f) {
+		printf("Failed to open file \"%s\".\n", filename);
+		return false;
+	}
+
+	bool ok = false;
+
+	if (bmp) {
+		struct {
+			bmpfilehead_s	file_;
+			bmpinfohead_s	info_;
+		} head;
+
+		if (fread(&head, sizeof(head), 1, f) == 1) {
+			width = head.info_.biWidth;
+			height = head.info_.biHeight;
+			ok = true;
+		}
+	}
+	else {
+		tgahead_s head;
+
+		if (fread(&head, sizeof(head), 1, f) == 1) {
+			width = head.width;
+			height = head.height;
+			ok = true;
+		}
+	}
+
+	fclose(f);
+
+	if (!ok) {
+		printf("Could not read the header of \"%s\"\n", filename);
+	}
+
+	return ok;
+}
+
 static bool Image_SaveBMP(const char* filename, const image_s& image);
 static bool Image_SavePNG(const char* filename, const image_s& image);
+bool Image_SaveDDS(const char* filename, const image_s& image);	// dds.cpp
 
 COMMON_API bool Img_Save(const char* filename, const image_s& image) {
 	const char* ext = strrchr(filename, '.');
@@ -1271,6 +2142,9 @@ COMMON_API bool Img_Save(const char* filename, const image_s& image) {
 	else if (Str_ICmp(ext, ".png") == 0) {
 		return Image_SavePNG(filename, image);
 	}
+	else if (Str_ICmp(ext, ".dds") == 0) {
+		return Image_SaveDDS(filename, image);
+	}
 	else {
 		printf("Unsupported image file format %s.\n", ext + 1);
 		return false;
@@ -1284,34 +2158,10 @@ COMMON_API void Img_Free(image_s& image) {
 	}
 
 	image.width_ = image.height_ = 0;
+	image.mip_levels_ = image.array_layers_ = 0;
+	image.cubemap_ = false;
 }
 
-#pragma pack(push, 1)
-
-struct bmpfilehead_s {
-	word_t				bfType;
-	dword_t				bfSize;
-	word_t				bfReserved1;
-	word_t				bfReserved2;
-	dword_t				bfOffBits;
-};
-
-struct bmpinfohead_s {
-	dword_t				biSize;
-	int					biWidth;
-	int					biHeight;
-	word_t				biPlanes;
-	word_t				biBitCount;
-	dword_t				biCompression;
-	dword_t				biSizeImage;
-	int					biXPelsPerMeter;
-	int					biYPelsPerMeter;
-	dword_t				biClrUsed;
-	dword_t				biClrImportant;
-};
-
-#pragma pack(pop)
-
 #ifndef BI_RGB
 #define BI_RGB			0L
 #endif
@@ -1336,19 +2186,28 @@ struct bmpinfohead_s {
 #define BI_PNG			5L
 #endif
 
-static bool Image_LoadBMP(const char* filename, image_s& image) {
+static bool Image_LoadBMP(const char* filename, const image_load_s* load, image_s& image) {
 	memset(&image, 0, sizeof(image));
 
-	void* buffer = nullptr;
-	int32_t file_size = 0;
-	if (!File_LoadBinary32(filename, buffer, file_size)) {
+	// decoded straight from the mapped file
+	file_mapping_s mapping;
+	if (!File_Map(filename, mapping)) {
 		printf("Failed to load file \"%s\".\n", filename);
 		return false;
 	}
 
-	bmpfilehead_s* filehead = (bmpfilehead_s*)buffer;
+	int32_t file_size = (int32_t)mapping.size_;
+	if (mapping.size_ < sizeof(bmpfilehead_s) + sizeof(bmpinfohead_s)) {
+		File_Unmap(mapping);
+		printf("Bad size\n");
+		return false;
+	}
+
+	bmpfilehead_s* filehead = (bmpfilehead_s*)mapping.data_;
 	bmpinfohead_s* infohead = (bmpinfohead_s*)(filehead + 1);
 
+	image_target_s target;
+
 	if (8 == infohead->biBitCount) {
 		if (BI_RGB == infohead->biCompression) { // uncompressed mode
 			int src_line_len = (infohead->biWidth + 3) & ~3;
@@ -1357,30 +2216,23 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 				+ src_line_len * infohead->biHeight);
 
 			if (palette_size < 0) {
-				File_FreeBinary(buffer);
+				File_Unmap(mapping);
 				printf("Bad size\n");
 				return false;
 			}
 
-			image.width_ = infohead->biWidth;
-			image.height_ = infohead->biHeight;
-			image.format_ = image_format_t::R8G8B8A8;
-			image.pixels_ = (byte_t*)TEMP_ALLOC(infohead->biWidth * 4 * infohead->biHeight);
-
-			if (!image.pixels_) {
-				File_FreeBinary(buffer);
-				printf("Could not allocate memory for image\n");
+			if (!Image_BeginTarget(load, infohead->biWidth, infohead->biHeight, image, target)) {
+				File_Unmap(mapping);
 				return false;
 			}
 
 			byte_t* palette = (byte_t*)(infohead + 1);
 			byte_t* src = palette + palette_size;
 
-			int dst_line_len = infohead->biWidth * 4;
 
 			for (int h = 0; h < infohead->biHeight; h++) { // OpenGL store bottom row first, same as BMP
 				byte_t* src_line = src + src_line_len * h;
-				byte_t* dst_line = image.pixels_ + dst_line_len * h;
+				byte_t* dst_line = target.Row(h);
 
 				for (int w = 0; w < infohead->biWidth; w++) {
 					byte_t idx = src_line[w];
@@ -1397,30 +2249,22 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 		}
 		else if (BI_RLE8 == infohead->biCompression) { 
 			// http://msdn.microsoft.com/en-us/library/windows/desktop/dd183383%28v=vs.85%29.aspx
-			image.width_ = infohead->biWidth;
-			image.height_ = infohead->biHeight;
-			image.format_ = image_format_t::R8G8B8A8;
-			image.pixels_ = (byte_t*)TEMP_ALLOC(infohead->biWidth * 4 * infohead->biHeight);
-
-			if (!image.pixels_) {
-				File_FreeBinary(buffer);
-				printf("Could not allocate memory for image\n");
+			if (!Image_BeginTarget(load, infohead->biWidth, infohead->biHeight, image, target)) {
+				File_Unmap(mapping);
 				return false;
 			}
 
-			// fill to white
-			memset(image.pixels_, 255, infohead->biWidth * 4 * infohead->biHeight);
+			// fill to white, the rows are contiguous whichever comes first
+			memset(image.pixels_, 255, (size_t)infohead->biWidth * 4 * infohead->biHeight);
 
 			byte_t* palette = (byte_t*)(infohead + 1);
 			byte_t* src = palette + 4 * 256;
 
-			int dst_line_len = infohead->biWidth * 4;
-
 			byte_t* s = src;
 
 			int line = 0;
 			int clrxpos = 0;
-			byte_t* dst_line = (byte_t*)image.pixels_;
+			byte_t* dst_line = target.Row(0);
 
 			bool breakloop = false;
 			while (!breakloop) {
@@ -1467,23 +2311,25 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 						switch (byte2) {
 						case 0: // end of line
 							line++;
-							dst_line = (byte_t*)image.pixels_ + dst_line_len * line;
 							if (clrxpos != infohead->biWidth) {
-								TEMP_FREE(image.pixels_);
-								image.pixels_ = nullptr;
-								File_FreeBinary(buffer);
+								Image_AbortTarget(load, image);
+								File_Unmap(mapping);
 								printf("Bad data\n");
 								return false;
 							}
+							if (line == infohead->biHeight) {
+								breakloop = true;	// no end of bitmap marker
+								break;
+							}
+							dst_line = target.Row(line);
 							clrxpos = 0;
 							break;
 						case 1: // end of bitmap
 							breakloop = true;
 							break;
 						case 2: // Delta.The 2 bytes following the escape contain unsigned values indicating the horizontal and vertical offsets of the next pixel from the current position.
-							TEMP_FREE(image.pixels_);
-							image.pixels_ = nullptr;
-							File_FreeBinary(buffer);
+							Image_AbortTarget(load, image);
+							File_Unmap(mapping);
 							printf("Did not know how to handle delta yet\n");
 							return false;
 						}
@@ -1492,7 +2338,7 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 			}
 		}
 		else {
-			File_FreeBinary(buffer);
+			File_Unmap(mapping);
 			printf("Unsupported compression mode %d\n", infohead->biCompression);
 			return false;
 		}
@@ -1503,29 +2349,22 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 
 		int valid_size = sizeof(bmpfilehead_s) + sizeof(bmpinfohead_s) + src_line_len * infohead->biHeight;
 		if (valid_size > file_size) {
-			File_FreeBinary(buffer);
+			File_Unmap(mapping);
 			printf("Bad size\n");
 			return false;
 		}
 
-		image.width_ = infohead->biWidth;
-		image.height_ = infohead->biHeight;
-		image.format_ = image_format_t::R8G8B8A8;
-		image.pixels_ = (byte_t*)TEMP_ALLOC(infohead->biWidth * 4 * infohead->biHeight);
-
-		if (!image.pixels_) {
-			File_FreeBinary(buffer);
-			printf("Could not allocate memory for image\n");
+		if (!Image_BeginTarget(load, infohead->biWidth, infohead->biHeight, image, target)) {
+			File_Unmap(mapping);
 			return false;
 		}
 
 		byte_t * src = (byte_t*)(infohead + 1);
 
-		int dst_line_len = infohead->biWidth * 4;
 
 		for (int h = 0; h < infohead->biHeight; h++) { // OpenGL store bottom row first, same as BMP
 			byte_t* src_line = src + src_line_len * h;
-			byte_t* dst_line = (byte_t*)image.pixels_ + dst_line_len * h;
+			byte_t* dst_line = target.Row(h);
 
 			for (int w = 0; w < infohead->biWidth; w++) {
 				uint16_t src_clr = *(uint16_t*)(src_line + w * 2);
@@ -1547,29 +2386,22 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 
 		int valid_size = sizeof(bmpfilehead_s) + sizeof(bmpinfohead_s) + src_line_len * infohead->biHeight;
 		if (valid_size > file_size) {
-			File_FreeBinary(buffer);
+			File_Unmap(mapping);
 			printf("Bad size\n");
 			return false;
 		}
 
-		image.width_ = infohead->biWidth;
-		image.height_ = infohead->biHeight;
-		image.format_ = image_format_t::R8G8B8A8;
-		image.pixels_ = (byte_t*)TEMP_ALLOC(infohead->biWidth * 4 * infohead->biHeight);
-
-		if (!image.pixels_) {
-			File_FreeBinary(buffer);
-			printf("Could not allocate memory for image\n");
+		if (!Image_BeginTarget(load, infohead->biWidth, infohead->biHeight, image, target)) {
+			File_Unmap(mapping);
 			return false;
 		}
 
 		byte_t * src = (byte_t*)(infohead + 1);
 
-		int dst_line_len = infohead->biWidth * 4;
 
 		for (int h = 0; h < infohead->biHeight; h++) { //OpenGL store bottom row first, same as BMP
 			byte_t* src_line = src + src_line_len * h;
-			byte_t* dst_line = image.pixels_ + dst_line_len * h;
+			byte_t* dst_line = target.Row(h);
 
 			for (int w = 0; w < infohead->biWidth; w++) {
 				byte_t* src_clr = src_line + w * 3;
@@ -1587,29 +2419,22 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 
 		int valid_size = sizeof(bmpfilehead_s) + sizeof(bmpinfohead_s) + src_line_len * infohead->biHeight;
 		if (valid_size > file_size) {
-			File_FreeBinary(buffer);
+			File_Unmap(mapping);
 			printf("Bad size\n");
 			return false;
 		}
 
-		image.width_ = infohead->biWidth;
-		image.height_ = infohead->biHeight;
-		image.format_ = image_format_t::R8G8B8A8;
-		image.pixels_ = (byte_t*)TEMP_ALLOC(infohead->biWidth * 4 * infohead->biHeight);
-
-		if (!image.pixels_) {
-			File_FreeBinary(buffer);
-			printf("Could not allocate memory for image\n");
+		if (!Image_BeginTarget(load, infohead->biWidth, infohead->biHeight, image, target)) {
+			File_Unmap(mapping);
 			return false;
 		}
 
 		byte_t* src = (byte_t*)(infohead + 1);
 
-		int dst_line_len = infohead->biWidth * 4;
 
 		for (int h = 0; h < infohead->biHeight; h++) { //OpenGL store bottom row first, same as BMP
 			byte_t* src_line = src + src_line_len * h;
-			byte_t* dst_line = image.pixels_ + dst_line_len * h;
+			byte_t* dst_line = target.Row(h);
 
 			for (int w = 0; w < infohead->biWidth; w++) {
 				byte_t* src_clr = src_line + w * 4;
@@ -1621,13 +2446,18 @@ static bool Image_LoadBMP(const char* filename, image_s& image) {
 			}
 		}
 	}
+	else {
+		File_Unmap(mapping);
+		printf("Unsupported bmp bit count %d\n", infohead->biBitCount);
+		return false;
+	}
 
-	File_FreeBinary(buffer);
+	File_Unmap(mapping);
 
 	return true;
 }
 
-static bool Image_LoadPNG(const char* filename, image_s& image) {
+static bool Image_LoadPNG(const char* filename, const image_load_s* load, image_s& image) {
 	memset(&image, 0, sizeof(image));
 
 	bool result = false;
@@ -1637,43 +2467,25 @@ static bool Image_LoadPNG(const char* filename, image_s& image) {
 	image_png.version = PNG_IMAGE_VERSION;
 
 	if (png_image_begin_read_from_file(&image_png, filename)) {
-		png_bytep buffer_png;
-
 		image_png.format = PNG_FORMAT_RGBA;
-		size_t size = PNG_IMAGE_SIZE(image_png); // get image size
-		buffer_png = (png_bytep)TEMP_ALLOC(size);
-
-		if (png_image_finish_read(&image_png, NULL /*background*/, buffer_png, 0 /*row_stride*/, NULL /*colormap*/)) {
-			// test write to bmp
-
-			image.width_ = (int)image_png.width;
-			image.height_ = (int)image_png.height;
-			image.format_ = image_format_t::R8G8B8A8;
-			image.pixels_ = (byte_t*)TEMP_ALLOC(image_png.height * image_png.width * 4 /* rgba */);
-
-			if (image.pixels_) {
-				// revert y
-				for (int y = 0; y < (int)image_png.height; ++y) {
-					byte_t* src_line = buffer_png + (image_png.height - y - 1) * image_png.width * 4;
-					byte_t* dst_line = image.pixels_ + y * image_png.width * 4;
-					memcpy(dst_line, src_line, image_png.width * 4);
-				}
 
-				result = true;
+		image_target_s target;
+		if (Image_BeginTarget(load, (int)image_png.width, (int)image_png.height, image, target)) {
+			// decoded in place: a negative stride makes libpng store the bottom row first
+			png_int_32 row_stride = (png_int_32)PNG_IMAGE_ROW_STRIDE(image_png);
 
+			if (png_image_finish_read(&image_png, NULL /*background*/, image.pixels_,
+				target.step_ > 0 ? -row_stride : row_stride, NULL /*colormap*/))
+			{
+				result = true;
 			}
 			else {
-				printf("Could not allocate memory to load image \"%s\"\n", filename);
+				printf("png_image_finish_read failed\n");
+				Image_AbortTarget(load, image);
 			}
 		}
-		else {
-			printf("png_image_finish_read failed\n");
-		}
 
 		png_image_free(&image_png); //2017-01-20 Fri.
-
-		TEMP_FREE(buffer_png);
-		buffer_png = nullptr;
 	}
 	else {
 		printf("png_image_begin_read_from_file failed\n");
@@ -1684,27 +2496,10 @@ static bool Image_LoadPNG(const char* filename, image_s& image) {
 
 static bool Image_HasAlpha(const image_s& image);
 
-static bool Image_LoadTGA(const char* filename, image_s& image) {
+static bool Image_LoadTGA(const char* filename, const image_load_s* load, image_s& image) {
 	static const byte_t IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR = 2;
 	static const byte_t IMAGE_TYPE_RUN_LENGTH_TRUE_COLOR = 10;
 
-#pragma pack(push, 1)
-	struct head_t {
-		byte_t	id_length;
-		byte_t	colormap_type;
-		byte_t	image_type;
-		word_t	colormap_index;
-		word_t	colormap_length;
-		byte_t	colormap_size;
-		word_t	x_origin;
-		word_t	y_origin;
-		word_t	width;
-		word_t	height;
-		byte_t	pixel_size;
-		byte_t	attributes;
-	};
-#pragma pack(pop)
-
 	struct stream_t {
 		byte_t*	data;
 		int		pos;
@@ -1713,42 +2508,53 @@ static bool Image_LoadTGA(const char* filename, image_s& image) {
 
 	memset(&image, 0, sizeof(image));
 
-	void* buffer = nullptr;
-	int32_t file_size = 0;
-	if (!File_LoadBinary32(filename, buffer, file_size)) {
+	// decoded straight from the mapped file
+	file_mapping_s mapping;
+	if (!File_Map(filename, mapping)) {
 		printf("Failed to load file \"%s\".\n", filename);
 		return false;
 	}
 
-	head_t* head = (head_t*)buffer;
+	if (mapping.size_ < sizeof(tgahead_s)) {
+		File_Unmap(mapping);
+		printf("Bad size\n");
+		return false;
+	}
+
+	tgahead_s* head = (tgahead_s*)mapping.data_;
 	byte_t a = head->attributes & (1 << 5); // 0: left-bottom is origin, 1: left-top is origin
 	if (a != 0 || (head->image_type != IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR && head->image_type != IMAGE_TYPE_RUN_LENGTH_TRUE_COLOR)) {
-		File_FreeBinary(buffer);
+		File_Unmap(mapping);
 		printf("Unsupported tga image type\n");
 		return false;
 	}
 
 	if (head->colormap_type != 0 || (head->pixel_size != 24 && head->pixel_size != 32)) {
-		File_FreeBinary(buffer);
+		File_Unmap(mapping);
 		printf("Unsupported tga pixel size\n");
 		return false;
 	}
 
 	int columns = head->width;
 	int rows = head->height;
-	int numpixels = columns * rows;
+
+	image_target_s target;
+	if (!Image_BeginTarget(load, columns, rows, image, target)) {
+		File_Unmap(mapping);
+		return false;
+	}
 
 	//setup reading stream
 	stream_t stream;
-	stream.data = (byte_t*)buffer;
+	stream.data = (byte_t*)mapping.data_;
 	stream.pos = sizeof(*head);
 
-	byte_t * targa_rgba = (byte_t*)TEMP_ALLOC(numpixels * 4); // destination rgba data
 	stream.pos += head->id_length; // skip TARGA image comment
 
+	// the bottom row comes first in the file, as in Img_Load
 	if (IMAGE_TYPE_UNCOMPRESSED_TRUE_COLOR == head->image_type) {
-		for (int row = rows - 1; row >= 0; row--) {
-			byte_t * pixbuf = targa_rgba + row * columns * 4;
+		for (int row = 0; row < rows; row++) {
+			byte_t * pixbuf = target.Row(row);
 			for (int column = 0; column < columns; ++column) {
 				if (24 == head->pixel_size) {
 					pixbuf[2] = stream.GetByte(); // blue
@@ -1767,8 +2573,8 @@ static bool Image_LoadTGA(const char* filename, image_s& image) {
 		}
 	}
 	else { // IMAGE_TYPE_RUN_LENGTH_TRUE_COLOR
-		for (int row = rows - 1; row >= 0; row--) {
-			byte_t * pixbuf = targa_rgba + row * columns * 4;
+		for (int row = 0; row < rows; row++) {
+			byte_t * pixbuf = target.Row(row);
 			for (int column = 0; column < columns;) {
 				byte_t packet_header = stream.GetByte();
 				int packet_size = 1 + (packet_header & 0x7f);
@@ -1799,13 +2605,13 @@ static bool Image_LoadTGA(const char* filename, image_s& image) {
 						++column;
 						if (column == columns) {  // run spans across rows
 							column = 0;
-							if (row > 0) {
-								row--;
+							if (row < rows - 1) {
+								row++;
 							}
 							else {
 								goto break_out;
 							}
-							pixbuf = targa_rgba + row * columns * 4;
+							pixbuf = target.Row(row);
 						}
 					}
 				}
@@ -1828,13 +2634,13 @@ static bool Image_LoadTGA(const char* filename, image_s& image) {
 						++column;
 						if (column == columns) { // pixel packet run spans across rows
 							column = 0;
-							if (row > 0) {
-								row--;
+							if (row < rows - 1) {
+								row++;
 							}
 							else {
 								goto break_out;
 							}
-							pixbuf = targa_rgba + row * columns * 4;
+							pixbuf = target.Row(row);
 						}
 					}
 				}
@@ -1843,27 +2649,7 @@ static bool Image_LoadTGA(const char* filename, image_s& image) {
 	break_out:;
 	}
 
-	image.width_ = head->width;
-	image.height_ = head->height;
-	image.format_ = image_format_t::R8G8B8A8;
-	image.pixels_ = (byte_t*)TEMP_ALLOC(numpixels * 4);
-
-	File_FreeBinary(buffer);
-
-	if (!image.pixels_) {
-		TEMP_FREE(targa_rgba);
-		return false;
-	}
-
-	// revert y
-	for (int y = 0; y < image.height_; ++y) {
-		const byte_t* src_line = targa_rgba + (image.height_ - y - 1) * image.width_ * 4;
-		byte_t * dst_line = image.pixels_ + y * image.width_ * 4;
-
-		memcpy(dst_line, src_line, image.width_ * 4);
-	}
-	
-	TEMP_FREE(targa_rgba);
+	File_Unmap(mapping);
 
 	return true;
 }
@@ -2029,30 +2815,16 @@ static bool Image_SavePNG(const char* filename, const image_s& image) {
 		image_png.height = image.height_;
 		image_png.format = dst_format;
 
-		size_t size = PNG_IMAGE_SIZE(image_png); // get image size
-		png_bytep buffer_png = (png_bytep)TEMP_ALLOC(size);
-
-		// convert height direction
-		for (int h = 0; h < image.height_; ++h) {
-			const byte_t* src_line = image.pixels_ + h * image.width_ * 4;
-			png_bytep dst_line = buffer_png + (image.height_ - h - 1) * image.width_ * 4;
-
-			memcpy(dst_line, src_line, image.width_ * 4);
-		}
-
-		// save to file
+		// save to file, the bottom row first as stored: a negative stride
 		bool ok = false;
 
-		if (png_image_write_to_file(&image_png, filename, 0, buffer_png, PNG_IMAGE_ROW_STRIDE(image_png), nullptr)) {
+		if (png_image_write_to_file(&image_png, filename, 0, image.pixels_, -(png_int_32)PNG_IMAGE_ROW_STRIDE(image_png), nullptr)) {
 			png_image_free(&image_png);
 			ok = true;
 		}
 		else {
-			printf("png_image_write_to_file failed\n");
-		}
-
-		TEMP_FREE(buffer_png);
-		buffer_png = nullptr;
+			printf("png_image_write_to_file failed\n");
+		}
 
 		return ok;
 	}
@@ -2072,19 +2844,23 @@ static bool Image_SavePNG(const char* filename, const image_s& image) {
 
 		const float gamma_correction = 2.2f;
 
+		std::vector<float> float_line((size_t)image.width_ * 4);
+
 		// convert height direction
 		for (int h = 0; h < image.height_; ++h) {
 			const float16_t * src_line = (const float16_t*)image.pixels_ + h * image.width_ * 4;
 			png_bytep dst_line = buffer_png + (image.height_ - h - 1) * image.width_ * 4;
 
+			HalfFloatToFloatArray(src_line, float_line.data(), float_line.size());
+
 			for (int x = 0; x < image.width_; ++x) {
-				const float16_t* src_p = src_line + x * 4;
+				const float* src_p = float_line.data() + x * 4;
 				png_bytep dst_p = dst_line + x * 4;
 
-				float fr = HalfFloatToFloat(src_p[0]);
-				float fg = HalfFloatToFloat(src_p[1]);
-				float fb = HalfFloatToFloat(src_p[2]);
-				float fa = HalfFloatToFloat(src_p[3]);
+				float fr = src_p[0];
+				float fg = src_p[1];
+				float fb = src_p[2];
+				float fa = src_p[3];
 
 				// printf("%f,%f,%f,%f\n", r, g, b, a);
 
@@ -2093,10 +2869,10 @@ static bool Image_SavePNG(const char* filename, const image_s& image) {
 				byte_t bb = (byte_t)((fb + 1.0f) * 0.5f * 255.0f);
 				byte_t ba = (byte_t)((fa + 1.0f) * 0.5f * 255.0f);
 
-				byte_t br2 = (byte_t)(255.0f * std::powf((float)br / 255.0f, gamma_correction));
-				byte_t bg2 = (byte_t)(255.0f * std::powf((float)bg / 255.0f, gamma_correction));
-				byte_t bb2 = (byte_t)(255.0f * std::powf((float)bb / 255.0f, gamma_correction));
-				byte_t ba2 = (byte_t)(255.0f * std::powf((float)ba / 255.0f, gamma_correction));
+				byte_t br2 = (byte_t)(255.0f * powf((float)br / 255.0f, gamma_correction));
+				byte_t bg2 = (byte_t)(255.0f * powf((float)bg / 255.0f, gamma_correction));
+				byte_t bb2 = (byte_t)(255.0f * powf((float)bb / 255.0f, gamma_correction));
+				byte_t ba2 = (byte_t)(255.0f * powf((float)ba / 255.0f, gamma_correction));
 
 				dst_p[0] = br2;
 				dst_p[1] = bg2;
@@ -2152,6 +2928,10 @@ COMMON_API uint32_t Terrain_GetVertexCountPerEdge(terrain_size_t sz) {
 		return 513;
 	case terrain_size_t::TS_1K:
 		return 1025;
+	case terrain_size_t::TS_2K:
+		return 2049;
+	case terrain_size_t::TS_4K:
+		return 4097;
 	default:
 		printf("unknown size %d, set vertex_count_per_edge to 33\n", sz);
 		return 33;
@@ -2180,191 +2960,35 @@ COMMON_API void Terrain_Free(terrain_s& terrain) {
 	}
 }
 
-COMMON_API bool	Terrain_Texture(const terrain_texture_tiles_s& tile_images,
-	const terrain_s& terrain, 
-	int width, int height, image_s& texture) 
-{
-	struct tile_s {
-		const char* filename_;
-		image_s		image_;
-		float		full_lower_;
-		float		full_upper_;
-		float		vanish_lower_;
-		float		vanish_upper_;
-	} tiles[4] = {};
-
-	/*
-	
-	tile 
-	
-	|----- vanish_upper_
-	|
-	|----- full_upper_
-	|      100%
-	|----- full_lower_
-	|
-	|----- vanish_lower_
-	
-	*/
-
-	auto GetPrecentage = [](const tile_s& tile, float z) -> float {
-		if (z > tile.vanish_upper_ || z < tile.vanish_lower_) {
-			return 0.0f;
-		}
-
-		if (z > tile.full_upper_) {
-			return (tile.vanish_upper_ - z) / (tile.vanish_upper_ - tile.full_upper_);
-		}
-
-		if (z < tile.full_lower_) {
-			return (z - tile.vanish_lower_) / (tile.full_lower_ - tile.vanish_lower_);
-		}
-
-		return 1.0f;
-	};
-
-	auto GetPixel = [](const image_s& image, float u, float v) -> glm::uvec3 {
-
-		int x = int((image.width_ * u) + 0.5f);
-		int y = int((image.height_ * v) + 0.5f);
-
-		if (x >= image.width_) {
-			x = image.width_ - 1;
-		}
-
-		if (y >= image.height_) {
-			y = image.height_ - 1;
-		}
-
-		const byte_t* pixel = image.pixels_ + y * image.width_ * 4 + x * 4;
-
-		return glm::uvec3(pixel[0], pixel[1], pixel[2]);
-	};
-
-	int vertex_count_per_edge = terrain.vertex_count_per_edge_;
-	int z_count = vertex_count_per_edge * vertex_count_per_edge;
-
-	float min_z = 9999999999.0f;
-	float max_z = -9999999999.0f;
-
-	for (int i = 0; i < z_count; ++i) {
-		float z = terrain.heights_[i];
-		if (z < min_z) {
-			min_z = z;
-		}
-		if (z > max_z) {
-			max_z = z;
-		}
-	}
-
-	float step = (max_z - min_z) / 7.0f;
-
-	tiles[0].filename_ = tile_images.lowest_;
-	tiles[0].full_lower_ = min_z;
-	
-	tiles[1].filename_ = tile_images.low_;
-	tiles[1].full_lower_ = min_z + step * 2.0f;
-
-	tiles[2].filename_ = tile_images.high_;
-	tiles[2].full_lower_ = min_z + step * 4.0f;
-
-	tiles[3].filename_ = tile_images.hightest_;
-	tiles[3].full_lower_ = min_z + step * 6.0f;
-
-	for (int i = 0; i < 4; ++i) {
-		tiles[i].full_upper_ = tiles[i].full_lower_ + step;
-		tiles[i].vanish_lower_ = tiles[i].full_lower_ - step;
-		tiles[i].vanish_upper_ = tiles[i].full_upper_ + step;
-	}
-
-	for (int i = 0; i < 4; ++i) {
-		if (!Img_Load(tiles[i].filename_, tiles[i].image_)) {
-
-			for (int i = 0; i < 4; ++i) {
-				if (tiles[i].image_.pixels_) {
-					Img_Free(tiles[i].image_);
-				}
-			}
-
-			return false;
-		}
-	}
-
-	if (!Img_Create(width, height, image_format_t::R8G8B8A8, texture)) {
-		for (int i = 0; i < 4; ++i) {
-			if (tiles[i].image_.pixels_) {
-				Img_Free(tiles[i].image_);
-			}
-		}
-		return false;
-	}
-
-	for (int row = 0; row < height; ++row) {
-		float v = (float)row / (height - 1);
-		float y = v * (vertex_count_per_edge - 1);
-		for (int col = 0; col < width; ++col) {
-			float u = (float)col / (width - 1);
-			float x = u * (vertex_count_per_edge - 1);
-
-			int ix = (int)x;
-			int iy = (int)y;
-
-			float z = terrain.heights_[iy * vertex_count_per_edge + ix];
-
-			float percentage[4];
-			glm::uvec3 pixels[4];
-
-			for (int i = 0; i < 4; ++i) {
-				percentage[i] = GetPrecentage(tiles[i], z);
-				pixels[i] = GetPixel(tiles[i].image_, u, v);
-			}
-
-			glm::vec3 combined = glm::uvec3(0);
-
-			for (int i = 0; i < 4; ++i) {
-				combined.r += (float)pixels[i].r * percentage[i];
-				combined.g += (float)pixels[i].g * percentage[i];
-				combined.b += (float)pixels[i].b * percentage[i];
-			}
-
-			if (combined.r > 255.0f) {
-				combined.r = 255.0f;
-			}
-
-			if (combined.g > 255.0f) {
-				combined.g = 255.0f;
-			}
-
-			if (combined.b > 255.0f) {
-				combined.b = 255.0f;
-			}
-
-			byte_t* dst_pixel = texture.pixels_ + row * width * 4 + col * 4;
-			dst_pixel[0] = (byte_t)combined.r;
-			dst_pixel[1] = (byte_t)combined.g;
-			dst_pixel[2] = (byte_t)combined.b;
-			dst_pixel[3] = 255;
-		}
-	}
-
-	for (int i = 0; i < 4; ++i) {
-		if (tiles[i].image_.pixels_) {
-			Img_Free(tiles[i].image_);
-		}
-	}
-
-	return true;
-}
-
 /*
 ================================================================================
 model
 ================================================================================
 */
 
+static uint32_t g_model_load_thread_count = 1;
+static bool g_model_weld_vertices = true;
+static bool g_model_use_cache = true;
+
 static bool Model_LoadPLY(const char* filename, model_s & model);
 static bool Model_LoadObj(const char* filename, model_s & model);
 
+COMMON_API void Model_SetLoadThreadCount(uint32_t count) {
+	g_model_load_thread_count = count;
+}
+
+COMMON_API void Model_SetWeldVertices(bool weld) {
+	g_model_weld_vertices = weld;
+}
+
+COMMON_API bool Model_GetWeldVertices() {
+	return g_model_weld_vertices;
+}
+
+COMMON_API void Model_SetUseCache(bool use) {
+	g_model_use_cache = use;
+}
+
 COMMON_API bool Model_Load(const char* filename, 
 	bool move_to_origin, model_s& model, const glm::mat4* transform)
 {
@@ -2376,22 +3000,28 @@ COMMON_API bool Model_Load(const char* filename,
 		return false;
 	}
 
-	bool load_ok = false;
+	bool is_ply = Str_ICmp(ext + 1, "ply") == 0;
+	bool is_obj = Str_ICmp(ext + 1, "obj") == 0;
 
-	if (Str_ICmp(ext + 1, "ply") == 0) {
-		load_ok = Model_LoadPLY(filename, model);
-	}
-	else if (Str_ICmp(ext + 1, "obj") == 0) {
-		load_ok = Model_LoadObj(filename, model);
-	}
-	else {
+	if (!is_ply && !is_obj) {
 		printf("Unsupported model file format %s.\n", ext + 1);
 		return false;
 	}
-	
-	if (!load_ok) {
-		Model_Free(model);
-		return false;
+
+	bool from_cache = g_model_use_cache && Model_LoadCache(filename, model);
+
+	if (!from_cache) {
+		bool load_ok = is_ply ? Model_LoadPLY(filename, model) : Model_LoadObj(filename, model);
+
+		if (!load_ok) {
+			Model_Free(model);
+			return false;
+		}
+
+		if (g_model_use_cache) {
+			// not fatal, e.g. read-only data folder
+			Model_SaveCache(filename, model);
+		}
 	}
 
 	// calculate min max
@@ -2435,35 +3065,44 @@ COMMON_API bool Model_Load(const char* filename,
 	float min_pos[3] = { 1.0e30f, 1.0e30f, 1.0e30f };
 	float max_pos[3] = { -1.0e30f, -1.0e30f, -1.0e30f };
 
-	for (uint32_t i = 0; i < model.num_vertex_; ++i) {
-		glm::vec3* v_pos = (glm::vec3*)v;
-		if (transform) {
-			glm::vec4 v_new_pos = *transform * glm::vec4(*v_pos, 1.0f);
-			v_pos->x = v_new_pos.x;
-			v_pos->y = v_new_pos.y;
-			v_pos->z = v_new_pos.z;
-
-			if (normal_offset) {
-				glm::vec3* v_normal = (glm::vec3*)(v + normal_offset);
-				glm::vec4 v_new_normal = *transform * glm::vec4(*v_normal, 0.0f);
-				v_normal->x = v_new_normal.x;
-				v_normal->y = v_new_normal.y;
-				v_normal->z = v_new_normal.z;
-			}
+	if (from_cache && !transform) {
+		// bounds are stored in the cache
+		for (int j = 0; j < 3; ++j) {
+			min_pos[j] = model.min_[j];
+			max_pos[j] = model.max_[j];
 		}
+	}
+	else {
+		for (uint32_t i = 0; i < model.num_vertex_; ++i) {
+			glm::vec3* v_pos = (glm::vec3*)v;
+			if (transform) {
+				glm::vec4 v_new_pos = *transform * glm::vec4(*v_pos, 1.0f);
+				v_pos->x = v_new_pos.x;
+				v_pos->y = v_new_pos.y;
+				v_pos->z = v_new_pos.z;
+
+				if (normal_offset) {
+					glm::vec3* v_normal = (glm::vec3*)(v + normal_offset);
+					glm::vec4 v_new_normal = *transform * glm::vec4(*v_normal, 0.0f);
+					v_normal->x = v_new_normal.x;
+					v_normal->y = v_new_normal.y;
+					v_normal->z = v_new_normal.z;
+				}
+			}
 
-		float* pos = (float*)v_pos;
+			float* pos = (float*)v_pos;
 
-		for (int j = 0; j < 3; ++j) {
-			if (pos[j] < min_pos[j]) {
-				min_pos[j] = pos[j];
-			}
-			if (pos[j] > max_pos[j]) {
-				max_pos[j] = pos[j];
+			for (int j = 0; j < 3; ++j) {
+				if (pos[j] < min_pos[j]) {
+					min_pos[j] = pos[j];
+				}
+				if (pos[j] > max_pos[j]) {
+					max_pos[j] = pos[j];
+				}
 			}
-		}
 
-		v += stride;
+			v += stride;
+		}
 	}
 
 	model.min_[0] = min_pos[0];
@@ -2505,7 +3144,46 @@ COMMON_API bool Model_Load(const char* filename,
 	return true;
 }
 
+COMMON_API uint32_t Model_GetVertexSize(vertex_format_t fmt) {
+	switch (fmt) {
+	case vertex_format_t::VF_POS:
+		return sizeof(vertex_pos_s);
+	case vertex_format_t::VF_POS_COLOR:
+		return sizeof(vertex_pos_color_s);
+	case vertex_format_t::VF_POS_NORMAL:
+		return sizeof(vertex_pos_normal_s);
+	case vertex_format_t::VF_POS_UV:
+		return sizeof(vertex_pos_uv_s);
+	case vertex_format_t::VF_POS_NORMAL_COLOR:
+		return sizeof(vertex_pos_normal_color_s);
+	case vertex_format_t::VF_POS_NORMAL_UV:
+		return sizeof(vertex_pos_normal_uv_s);
+	case vertex_format_t::VF_POS_NORMAL_UV_TANGENT:
+		return sizeof(vertex_pos_normal_uv_tangent_s);
+	default:
+		return 0;
+	}
+}
+
 COMMON_API void Model_Free(model_s& model) {
+	if (model.mapping_.data_) {
+		// arrays inside the mapping are released with it
+		if (Model_IsMapped(model, model.parts_)) {
+			model.parts_ = nullptr;
+		}
+		if (Model_IsMapped(model, model.materials_)) {
+			model.materials_ = nullptr;
+		}
+		if (Model_IsMapped(model, model.indices_)) {
+			model.indices_ = nullptr;
+		}
+		if (Model_IsMapped(model, model.vertices_)) {
+			model.vertices_ = nullptr;
+		}
+
+		File_Unmap(model.mapping_);
+	}
+
 	SAFE_FREE(model.parts_);
 	SAFE_FREE(model.materials_);
 	SAFE_FREE(model.indices_);
@@ -2606,11 +3284,92 @@ static bool Model_LoadPLY(const char* filename, model_s& model) {
 	return true;
 }
 
+/*
+
+ weld face corners that reference the same (position, normal, uv) triple
+
+ open addressing hash table of unique vertex indices, keyed on the obj indices,
+ unique vertices are numbered in order of first appearance so the result is deterministic
+
+ corner_to_vertex: [num_corner] unique vertex index of each corner, in face order
+ unique_keys: [num_corner] obj indices of each unique vertex
+ return: number of unique vertices
+
+ */
+static uint32_t Model_WeldObjCorners(const Obj::face_group_s* face_groups, uint32_t num_face_group,
+	uint32_t num_corner, bool use_uv, uint32_t* corner_to_vertex, Obj::face_vertex_s* unique_keys)
+{
+	uint32_t table_size = 1;
+	while (table_size < num_corner * 2) {
+		table_size <<= 1;
+	}
+	uint32_t table_mask = table_size - 1;
+
+	uint32_t* table = (uint32_t*)TEMP_ALLOC(sizeof(uint32_t) * table_size);
+	if (!table) {
+		return 0;
+	}
+	memset(table, 0xff, sizeof(uint32_t) * table_size);
+
+	uint32_t num_unique = 0;
+	uint32_t corner = 0;
+
+	for (uint32_t i = 0; i < num_face_group; ++i) {
+		const Obj::face_group_s* fg = face_groups + i;
+
+		for (uint32_t j = 0; j < fg->face_count_; ++j) {
+			const Obj::face_s* f = fg->faces_ + j;
+			if (f->vertex_count_ != 3 && f->vertex_count_ != 4) {
+				continue;
+			}
+
+			for (uint32_t k = 0; k < f->vertex_count_; ++k) {
+				Obj::face_vertex_s key = f->vertices_[k];
+				if (!use_uv) {
+					key.uv_idx_ = 0;
+				}
+
+				uint32_t h = key.pos_idx_ * 0x9E3779B1u;
+				h ^= key.normal_idx_ * 0x85EBCA77u;
+				h ^= key.uv_idx_ * 0xC2B2AE3Du;
+				h ^= h >> 15;
+
+				uint32_t slot = h & table_mask;
+				while (true) {
+					uint32_t v = table[slot];
+					if (v == VK_INVALID_INDEX) {
+						v = num_unique++;
+						unique_keys[v] = key;
+						table[slot] = v;
+						corner_to_vertex[corner++] = v;
+						break;
+					}
+
+					const Obj::face_vertex_s& other = unique_keys[v];
+					if (other.pos_idx_ == key.pos_idx_ && other.normal_idx_ == key.normal_idx_ &&
+						other.uv_idx_ == key.uv_idx_) {
+						corner_to_vertex[corner++] = v;
+						break;
+					}
+
+					slot = (slot + 1) & table_mask;
+				}
+			}
+		}
+	}
+
+	TEMP_FREE(table);
+
+	return num_unique;
+}
+
 static bool Model_LoadObj(const char* filename, model_s& model) {
 	memset(&model, 0, sizeof(model));
 
+	uint32_t num_threads = g_model_load_thread_count ? g_model_load_thread_count : Thread_GetHardwareConcurrency();
+
 	Obj obj;
-	if (!obj.Load(filename)) {
+	if (!obj.Load(filename, nullptr, num_threads)) {
 		return false;
 	}
 
@@ -2630,11 +3389,41 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 
 	// allocate buffers
 
+	// the faces are split into ranges of about the same size, the vertex/index offset
+	// of each range is recorded so the ranges can be converted concurrently
+	struct face_range_s {
+		uint32_t	group_idx_;
+		uint32_t	face_idx_;
+		uint32_t	vertex_offset_;
+		uint32_t	index_offset_;
+	};
+
+	uint32_t num_face = 0;
+	for (uint32_t i = 0; i < num_face_group; ++i) {
+		num_face += face_group[i].face_count_;
+	}
+
+	uint32_t faces_per_range = (num_face + num_threads - 1) / num_threads;
+	if (faces_per_range < 4096) {
+		faces_per_range = 4096;
+	}
+
+	std::vector<face_range_s> ranges;
+	std::vector<uint32_t> group_index_offsets(num_face_group + 1);
+
 	uint32_t num_vertex = 0;
 	uint32_t num_index = 0;
+	uint32_t face_counter = 0;
 	for (uint32_t i = 0; i < num_face_group; ++i) {
 		const Obj::face_group_s* fg = face_group + i;
+
+		group_index_offsets[i] = num_index;
+
 		for (uint32_t j = 0; j < fg->face_count_; ++j) {
+			if (face_counter++ % faces_per_range == 0) {
+				ranges.push_back({ i, j, num_vertex, num_index });
+			}
+
 			const Obj::face_s* f = fg->faces_ + j;
 			if (f->vertex_count_ == 3) {
 				num_vertex += 3;
@@ -2648,6 +3437,34 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 		}
 	}
 
+	group_index_offsets[num_face_group] = num_index;
+
+	uint32_t num_corner = num_vertex;
+
+	// weld shared corners, num_vertex becomes the unique vertex count
+	uint32_t* corner_to_vertex = nullptr;
+	Obj::face_vertex_s* vertex_keys = nullptr;
+
+	if (g_model_weld_vertices && num_corner) {
+		corner_to_vertex = (uint32_t*)TEMP_ALLOC(sizeof(uint32_t) * num_corner);
+		vertex_keys = (Obj::face_vertex_s*)TEMP_ALLOC(sizeof(Obj::face_vertex_s) * num_corner);
+
+		uint32_t num_unique = 0;
+		if (corner_to_vertex && vertex_keys) {
+			num_unique = Model_WeldObjCorners(face_group, num_face_group, num_corner, uv_lst != nullptr,
+				corner_to_vertex, vertex_keys);
+		}
+
+		if (!num_unique) {
+			SAFE_FREE(vertex_keys);
+			SAFE_FREE(corner_to_vertex);
+			printf("Could not weld vertices\n");
+			return false;
+		}
+
+		num_vertex = num_unique;
+	}
+
 	size_t vertex_size = 0;
 
 	if (uv_lst) {
@@ -2664,6 +3481,8 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 		size_t materials_size = sizeof(model_material_s) * num_material;
 		materials = (model_material_s*)TEMP_ALLOC(materials_size);
 		if (!materials) {
+			SAFE_FREE(vertex_keys);
+			SAFE_FREE(corner_to_vertex);
 			printf("Could not allocate materials\n");
 			return false;
 		}
@@ -2674,6 +3493,8 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 		size_t parts_size = sizeof(model_part_s) * num_face_group;
 		parts = (model_part_s*)TEMP_ALLOC(parts_size);
 		if (!parts) {
+			SAFE_FREE(vertex_keys);
+			SAFE_FREE(corner_to_vertex);
 			SAFE_FREE(materials);
 			printf("Could not allocate parts\n");
 			return false;
@@ -2687,6 +3508,8 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 	uint32_t* indices = (uint32_t*)TEMP_ALLOC(indices_size);
 
 	if (!vertices || !indices) {
+		SAFE_FREE(vertex_keys);
+		SAFE_FREE(corner_to_vertex);
 		SAFE_FREE(indices);
 		SAFE_FREE(vertices);
 		SAFE_FREE(parts);
@@ -2729,68 +3552,111 @@ static bool Model_LoadObj(const char* filename, model_s& model) {
 		}
 	}
 
-	// faces
-	uint32_t written_vet = 0;
-	uint32_t written_idx = 0;
-	
+	// parts
 	for (uint32_t i = 0; i < num_face_group; ++i) {
-		const Obj::face_group_s* src_fg = face_group + i;
 		model_part_s* dst_fg = parts + i;
 
-		dst_fg->material_idx_ = src_fg->material_idx_;
-		dst_fg->index_offset_ = written_idx;
+		dst_fg->material_idx_ = face_group[i].material_idx_;
+		dst_fg->index_offset_ = group_index_offsets[i];
+		dst_fg->index_count_ = group_index_offsets[i + 1] - group_index_offsets[i];
+	}
+
+	auto WriteVertex = [&](uint32_t dst_idx, const Obj::face_vertex_s* fv) {
+		if (uv_lst) {
+			vertex_pos_normal_uv_s* dst_vertex = (vertex_pos_normal_uv_s*)(vertices + vertex_size * dst_idx);
 
-		for (uint32_t j = 0; j < src_fg->face_count_; ++j) {
-			const Obj::face_s* f = src_fg->faces_ + j;
+			dst_vertex->pos_ = pos_lst[fv->pos_idx_];
+			dst_vertex->normal_ = normal_lst[fv->normal_idx_];
+			dst_vertex->uv_ = uv_lst[fv->uv_idx_];
+		}
+		else {
+			vertex_pos_normal_s* dst_vertex = (vertex_pos_normal_s*)(vertices + vertex_size * dst_idx);
+
+			dst_vertex->pos_ = pos_lst[fv->pos_idx_];
+			dst_vertex->normal_ = normal_lst[fv->normal_idx_];
+		}
+	};
+
+	// faces
+	auto ConvertFaces = [&](uint32_t range_idx) {
+		const face_range_s& range = ranges[range_idx];
 
-			// copy vertex
-			uint32_t face_vet0 = written_vet;
+		uint32_t written_corner = range.vertex_offset_;
+		uint32_t written_idx = range.index_offset_;
+		uint32_t face_count = 0;
 
-			for (uint32_t k = 0; k < f->vertex_count_; ++k) {
-				const Obj::face_vertex_s* fv = f->vertices_ + k;
-
-				if (uv_lst) {
-					vertex_pos_normal_uv_s* dst_vertex = (vertex_pos_normal_uv_s*)(vertices + vertex_size * (face_vet0 + k));
-					
-					dst_vertex->pos_ = pos_lst[fv->pos_idx_];
-					dst_vertex->normal_ = normal_lst[fv->normal_idx_];
-					dst_vertex->uv_ = uv_lst[fv->uv_idx_];
+		uint32_t j = range.face_idx_;
+		for (uint32_t i = range.group_idx_; i < num_face_group && face_count < faces_per_range; ++i, j = 0) {
+			const Obj::face_group_s* src_fg = face_group + i;
+
+			for (; j < src_fg->face_count_ && face_count < faces_per_range; ++j, ++face_count) {
+				const Obj::face_s* f = src_fg->faces_ + j;
+				if (f->vertex_count_ != 3 && f->vertex_count_ != 4) {
+					continue;	// ignore other faces
 				}
-				else {
-					vertex_pos_normal_s* dst_vertex = (vertex_pos_normal_s*)(vertices + vertex_size * (face_vet0 + k));
 
-					dst_vertex->pos_ = pos_lst[fv->pos_idx_];
-					dst_vertex->normal_ = normal_lst[fv->normal_idx_];
+				uint32_t v[4];
+
+				for (uint32_t k = 0; k < f->vertex_count_; ++k) {
+					if (corner_to_vertex) {
+						v[k] = corner_to_vertex[written_corner + k];
+					}
+					else {
+						// copy vertex
+						v[k] = written_corner + k;
+						WriteVertex(v[k], f->vertices_ + k);
+					}
 				}
-			}
 
-			written_vet += f->vertex_count_;
+				written_corner += f->vertex_count_;
 
-			// setup index
-			if (f->vertex_count_ == 3) {
-				indices[written_idx + 0] = face_vet0;
-				indices[written_idx + 1] = face_vet0 + 1;
-				indices[written_idx + 2] = face_vet0 + 2;
+				// setup index
+				if (f->vertex_count_ == 3) {
+					indices[written_idx + 0] = v[0];
+					indices[written_idx + 1] = v[1];
+					indices[written_idx + 2] = v[2];
 
-				written_idx += 3;
-			}
-			else if (f->vertex_count_ == 4) {
-				indices[written_idx + 0] = face_vet0;
-				indices[written_idx + 1] = face_vet0 + 1;
-				indices[written_idx + 2] = face_vet0 + 2;
+					written_idx += 3;
+				}
+				else {
+					indices[written_idx + 0] = v[0];
+					indices[written_idx + 1] = v[1];
+					indices[written_idx + 2] = v[2];
 
-				indices[written_idx + 3] = face_vet0 + 2;
-				indices[written_idx + 4] = face_vet0 + 3;
-				indices[written_idx + 5] = face_vet0;
+					indices[written_idx + 3] = v[2];
+					indices[written_idx + 4] = v[3];
+					indices[written_idx + 5] = v[0];
 
-				written_idx += 6;
+					written_idx += 6;
+				}
 			}
-			// ignore other faces
 		}
+	};
+
+	Thread_Run((uint32_t)ranges.size(), ConvertFaces);
+
+	// unique vertices
+	if (vertex_keys) {
+		uint32_t vertices_per_range = (num_vertex + num_threads - 1) / num_threads;
+		if (vertices_per_range < 4096) {
+			vertices_per_range = 4096;
+		}
+
+		uint32_t vertex_range_count = (num_vertex + vertices_per_range - 1) / vertices_per_range;
+
+		Thread_Run(vertex_range_count, [&](uint32_t range_idx) {
+			uint32_t first = range_idx * vertices_per_range;
+			uint32_t last = first + vertices_per_range < num_vertex ? first + vertices_per_range : num_vertex;
 
-		dst_fg->index_count_ = written_idx - dst_fg->index_offset_;
+			for (uint32_t i = first; i < last; ++i) {
+				WriteVertex(i, vertex_keys + i);
+			}
+		});
 	}
 
+	SAFE_FREE(vertex_keys);
+	SAFE_FREE(corner_to_vertex);
+
 	return true;
 }
 
@@ -2800,7 +3666,7 @@ helper
 ================================================================================
 */
 COMMON_API void CalculateFrustumCorners(const frustum_s& frustum, glm::vec3 corners[8]) {
-	float tan = std::tanf(glm::radians(frustum.fovy_ * 0.5f));
+	float tan = tanf(glm::radians(frustum.fovy_ * 0.5f));
 
 	float z_near = frustum.z_near_;
 	float z_far = frustum.z_far_;
@@ -3234,6 +4100,14 @@ void Vk_PushDescriptorSetLayoutBinding_UBO(
 		stage_flags);
 }
 
+void Vk_PushDescriptorSetLayoutBinding_DynamicUBO(
+	std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	uint32_t binding, VkShaderStageFlags stage_flags)
+{
+	Vk_PushDescriptorSetLayoutBinding(bindings, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		stage_flags);
+}
+
 void Vk_PushDescriptorSetLayoutBinding_Tex(std::vector<VkDescriptorSetLayoutBinding>& bindings,
 	uint32_t binding, VkShaderStageFlags stage_flags)
 {
@@ -3279,6 +4153,37 @@ void Vk_PushWriteDescriptorSet_UBO(
 		});
 }
 
+void Vk_PushWriteDescriptorSet_DynamicUBO(
+	update_desc_sets_buffer_s& buffer,
+	VkDescriptorSet vk_desc_set, uint32_t binding,
+	VkBuffer vk_buffer, VkDeviceSize vk_buffer_range)
+{
+	VkDescriptorBufferInfo* desc_buf_info = (VkDescriptorBufferInfo*)TEMP_ALLOC(sizeof(VkDescriptorBufferInfo));
+	if (!desc_buf_info) {
+		return;
+	}
+
+	desc_buf_info->buffer = vk_buffer;
+	desc_buf_info->offset = 0;	// the dynamic offset of vkCmdBindDescriptorSets adds to it
+	desc_buf_info->range = vk_buffer_range;
+
+	buffer.desc_buf_infos_.push_back(desc_buf_info);
+
+	buffer.write_descriptor_sets_.push_back(
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = vk_desc_set,
+			.dstBinding = binding,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			.pImageInfo = nullptr,
+			.pBufferInfo = desc_buf_info,
+			.pTexelBufferView = nullptr
+		});
+}
+
 void Vk_PushWriteDescriptorSet_Tex(
 	update_desc_sets_buffer_s& buffer,
 	VkDescriptorSet vk_desc_set, uint32_t binding, const vk_image_s& texture)
@@ -68,14 +68,16 @@ common
 #define	TEMP_ALLOC(sz)		malloc(sz)
 #define TEMP_FREE(ptr)		free(ptr)
 
+// Common_Init starts the job pool, Common_Shutdown joins it
 COMMON_API void				Common_Init();
+COMMON_API void				Common_Shutdown();
 
 COMMON_API const char *		GetDataFolder();
 COMMON_API const char *		GetShadersFolder();
 
 // s: struct
 // f: field
-#define GET_FIELD_OFFSET(s, f) (uint32_t)(&(((s*)0)->f))
+#define GET_FIELD_OFFSET(s, f) (uint32_t)offsetof(s, f)
 
 #define COUNT_OF(a)		(sizeof(a) / sizeof(a[0]))
 
@@ -89,13 +91,46 @@ COMMON_API bool				IsBigEndian();
 COMMON_API float			HalfFloatToFloat(float16_t h);
 COMMON_API float16_t		FloatToHalfFloat(float f);
 
+// bulk conversions, same results as the F16C instructions on every SIMD level:
+// NaNs are quieted, float to half rounds to nearest even (FloatToHalfFloat truncates)
+COMMON_API void				HalfFloatToFloatArray(const float16_t* src, float* dst, size_t count);
+COMMON_API void				FloatToHalfFloatArray(const float* src, float16_t* dst, size_t count);
+
 /*
 ================================================================================
 random number generator
 ================================================================================
 */
+// PCG32 (pcg-random.org): 64-bit state, streams of the same seed never overlap
+struct rand_stream_s {
+	uint64_t				state_;
+	uint64_t				inc_;		// odd, selects the stream
+};
+
+// deterministic per task: the same (seed, stream) always gives the same sequence
+COMMON_API void				Rand_Init(rand_stream_s & rs, uint64_t seed, uint64_t stream);
+// a child stream seeded by 4 draws of the parent, for tasks spawned in a fixed order
+COMMON_API rand_stream_s	Rand_Split(rand_stream_s & rs);
+// skip delta draws in O(log delta)
+COMMON_API void				Rand_Advance(rand_stream_s & rs, uint64_t delta);
+
+COMMON_API uint32_t			Rand_Next(rand_stream_s & rs);
+// [0, bound), unbiased
+COMMON_API uint32_t			Rand_Range(rand_stream_s & rs, uint32_t bound);
+// return [0, 1], 24 bits
+COMMON_API float			Rand_Float01(rand_stream_s & rs);
+// return [-1, 1], symmetric
+COMMON_API float			Rand_FloatNeg1Pos1(rand_stream_s & rs);
+
+// dst[i] = hash of (2 draws of rs, i): every SIMD level writes the same values, i wraps at 2^32
+COMMON_API void				Rand_Fill01(rand_stream_s & rs, float* dst, size_t count);
+COMMON_API void				Rand_FillNeg1Pos1(rand_stream_s & rs, float* dst, size_t count);
+
+// compatibility: the legacy LCG, its state is per thread and SRand seeds the calling thread's only
+// a thread never seeded starts from seed 1, whatever thread it is and whenever it was created
 // https://www.man7.org/linux/man-pages/man3/srand.3.html
 COMMON_API void				SRand(uint32_t seed);
+// return [0, 32767]
 COMMON_API uint32_t			Rand();
 
 // return [0, 1]
@@ -104,6 +139,133 @@ COMMON_API float			Rand01();
 // return [-1, 1]
 COMMON_API float			RandNeg1Pos1();
 
+// stateless, the same (seed, x, y) always gives the same value
+// for random values keyed by position, independent of the generation order
+COMMON_API uint32_t			RandHash(uint32_t seed, uint32_t x, uint32_t y);
+
+/*
+================================================================================
+thread
+================================================================================
+*/
+COMMON_API uint32_t			Thread_GetHardwareConcurrency();
+
+// call func(0) ~ func(count - 1) on the job pool, func(0) runs on the calling thread
+// return after all of them finished, count may exceed the pool size: no func may wait for another
+COMMON_API void				Thread_Run(uint32_t count, const std::function<void(uint32_t idx)> & func);
+
+/*
+================================================================================
+jobs
+================================================================================
+*/
+
+// Common_Init starts the pool with hardware concurrency - 1 workers, the waiting thread is the last one,
+// without it the pool starts on first use
+// num_thread counts that thread too, 0: hardware concurrency, replaces the current pool: no job may be running
+COMMON_API void				Job_Init(uint32_t num_thread);
+COMMON_API void				Job_Shutdown();
+COMMON_API uint32_t			Job_GetWorkerCount();
+
+struct job_stats_s {
+	uint64_t				executed_;
+	uint64_t				steals_;		// jobs taken from another worker's deque
+	double					idle_ms_;		// spinning or asleep with nothing to run
+};
+
+// worker Job_GetWorkerCount(): the threads outside the pool, running jobs while they wait
+COMMON_API void				Job_GetStats(uint32_t worker, job_stats_s & stats);
+COMMON_API void				Job_ResetStats();
+
+// about 4 chunks per thread
+COMMON_API uint32_t			Job_GetDefaultGrain(uint32_t count);
+
+// func(chunk_begin, chunk_end) over [begin, end) in chunks of grain indices (0: Job_GetDefaultGrain),
+// the calling thread runs the first chunk and helps until the last one finished, nesting is fine
+COMMON_API void				Job_ParallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+								const std::function<void(uint32_t begin, uint32_t end)> & func);
+
+// func queued without waiting for it, pending counts the jobs not finished yet,
+// with no worker in the pool func runs right away on the calling thread
+COMMON_API void				Job_Async(std::atomic<uint32_t> & pending, const std::function<void()> & func);
+// until pending is 0, the calling thread runs queued jobs meanwhile
+COMMON_API void				Job_Wait(std::atomic<uint32_t> & pending);
+
+// map(chunk_begin, chunk_end, identity) per chunk, partials reduced in chunk order:
+// the result only depends on grain, not on the thread count
+// map: T(uint32_t chunk_begin, uint32_t chunk_end, const T & init), reduce: T(const T & a, const T & b)
+template<typename T, typename MAP, typename REDUCE>
+T Job_ParallelReduce(uint32_t begin, uint32_t end, uint32_t grain, const T & identity, const MAP & map, const REDUCE & reduce) {
+	if (end <= begin) {
+		return identity;
+	}
+
+	uint32_t count = end - begin;
+	if (!grain) {
+		grain = Job_GetDefaultGrain(count);
+	}
+
+	// a struct, std::vector<bool> packs bits which threads cannot write apart
+	struct partial_s {
+		T					value_;
+	};
+
+	uint32_t num_chunk = (uint32_t)(((uint64_t)count + grain - 1) / grain);
+	std::vector<partial_s> partials(num_chunk, partial_s{ identity });
+
+	Job_ParallelFor(0, num_chunk, 1, [&](uint32_t c0, uint32_t c1) {
+		for (uint32_t c = c0; c < c1; ++c) {
+			uint32_t chunk_begin = begin + c * grain;
+			uint32_t chunk_end = end - chunk_begin > grain ? chunk_begin + grain : end;
+			partials[c].value_ = map(chunk_begin, chunk_end, identity);
+		}
+	});
+
+	T result = identity;
+	for (const partial_s& p : partials) {
+		result = reduce(result, p.value_);
+	}
+
+	return result;
+}
+
+// tasks run on the pool once every task they depend on finished
+struct job_graph_s;
+
+COMMON_API job_graph_s *	Job_CreateGraph();
+COMMON_API void				Job_DestroyGraph(job_graph_s * graph);
+COMMON_API uint32_t			Job_AddTask(job_graph_s * graph, const std::function<void()> & func);
+// task runs after before finished
+COMMON_API void				Job_AddDependency(job_graph_s * graph, uint32_t before, uint32_t task);
+// return after every task ran, false when the dependencies have a cycle, a graph may run again
+COMMON_API bool				Job_RunGraph(job_graph_s * graph);
+
+/*
+================================================================================
+cpu
+================================================================================
+*/
+enum class simd_level_t : int32_t {
+	SCALAR,
+	SSE2,
+	AVX2		// with F16C
+};
+
+// functions using AVX2 / F16C intrinsics, only called when Cpu_GetSIMDLevel() returns AVX2
+#if defined(__GNUC__)
+# define TARGET_AVX2		__attribute__((target("avx2")))
+# define TARGET_F16C		__attribute__((target("avx2,f16c")))
+#else
+# define TARGET_AVX2
+# define TARGET_F16C
+#endif
+
+// highest instruction set supported by cpu and os, lowered by Cpu_SetSIMDLevel
+COMMON_API simd_level_t		Cpu_GetSIMDLevel();
+
+// use at most level, e.g. to compare against the scalar path
+COMMON_API void				Cpu_SetSIMDLevel(simd_level_t level);
+
 /*
 ================================================================================
 file
@@ -116,6 +278,18 @@ COMMON_API void				File_FreeBinary(void* data);
 COMMON_API bool				File_LoadText(const char* filename, char*& data, int32_t& len);
 COMMON_API void				File_FreeText(char* data);
 
+// size in bytes, mtime in seconds since epoch
+COMMON_API bool				File_GetStat(const char* filename, uint64_t& size, int64_t& mtime);
+
+// whole file mapped into memory, pages are copy-on-write so changes stay private to the process
+struct file_mapping_s {
+	void *					data_;
+	size_t					size_;
+};
+
+COMMON_API bool				File_Map(const char* filename, file_mapping_s& mapping);
+COMMON_API void				File_Unmap(file_mapping_s& mapping);
+
 /*
 ================================================================================
 string
@@ -200,7 +374,22 @@ image
 
 enum class image_format_t : int32_t {
 	R8G8B8A8,
-	R16G16B16A16_FLOAT
+	R16G16B16A16_FLOAT,
+	// block compressed, 4x4 texels per block
+	BC1_UNORM,				// RGB, 1 bit alpha: 8 bytes per block
+	BC1_SRGB,
+	BC2_UNORM,				// RGB, 4 bits alpha: 16 bytes
+	BC2_SRGB,
+	BC3_UNORM,				// RGBA: 16 bytes
+	BC3_SRGB,
+	BC4_UNORM,				// R: 8 bytes
+	BC4_SNORM,
+	BC5_UNORM,				// RG: 16 bytes
+	BC5_SNORM,
+	BC6H_UFLOAT,			// RGB half float: 16 bytes
+	BC6H_SFLOAT,
+	BC7_UNORM,				// RGBA: 16 bytes
+	BC7_SRGB
 	// ...
 };
 
@@ -209,13 +398,66 @@ struct image_s {
 	int						height_;
 	image_format_t			format_;
 	byte_t*					pixels_;
+	// pixels_ holds every subresource, layer by layer, each layer from level 0 down (the DDS order)
+	// 0 means 1
+	int						mip_levels_;
+	int						array_layers_;	// 6 faces per cube
+	bool					cubemap_;
 };
 
 COMMON_API bool				Img_Create(int width, int height, image_format_t fmt, image_s& image);
 COMMON_API bool				Img_Load(const char * filename, image_s & image);
+// block compressed DDS files keep their blocks, mip levels and layers (rows from the top),
+// other files are loaded by Img_Load
+COMMON_API bool				Img_LoadCompressed(const char* filename, image_s& image);
 COMMON_API bool				Img_Save(const char* filename, const image_s& image);
 COMMON_API void				Img_Free(image_s & image);
 
+// one file of Img_LoadBatch, decoded straight into its final memory
+struct image_load_s {
+	const char *			filename_;
+	bool					top_first_;		// false: bottom row first, as Img_Load
+	byte_t *				dst_;			// caller memory (a mapped staging buffer...), nullptr: allocated
+	size_t					dst_size_;		// bytes at dst_, at least width * height * 4
+	image_s					image_;			// out: R8G8B8A8, Img_Free only when dst_ is nullptr
+	bool					ok_;			// out
+};
+
+// bmp / png / tga files decoded in parallel, one job per file,
+// returns true if every file loaded
+COMMON_API bool				Img_LoadBatch(image_load_s* loads, uint32_t count);
+// from the file header, to size image_load_s::dst_
+COMMON_API bool				Img_GetSize(const char* filename, int& width, int& height);
+
+COMMON_API bool				Img_IsCompressed(image_format_t fmt);
+COMMON_API int				Img_GetBlockBytes(image_format_t fmt);	// 0: not block compressed
+COMMON_API size_t			Img_GetLevelSize(const image_s& image, int level);	// bytes of one layer
+COMMON_API size_t			Img_GetSubresourceOffset(const image_s& image, int layer, int level);
+COMMON_API size_t			Img_GetDataSize(const image_s& image);
+
+// decodes one subresource of a block compressed image to R8G8B8A8 (R16G16B16A16_FLOAT for BC6H),
+// SNORM formats keep signed bytes
+COMMON_API bool				Img_Decompress(const image_s& image, int layer, int level, image_s& decompressed);
+
+enum class mip_filter_t : int32_t {
+	BOX,					// average of the texels under the footprint
+	KAISER					// windowed sinc, sharper
+};
+
+// full mip chain of an R8G8B8A8 image for every layer, each level filtered from the one above,
+// srgb: color channels are filtered in linear space
+COMMON_API bool				Img_GenerateMipmaps(const image_s& image, mip_filter_t filter, bool srgb, image_s& mipmapped);
+
+enum class bc_quality_t : int32_t {
+	FAST,
+	NORMAL,
+	HIGH
+};
+
+// block compresses every subresource of an R8G8B8A8 image (rows from the top, as the blocks are)
+// to BC1 / BC3 / BC7 (UNORM or SRGB), BC4_UNORM or BC5_UNORM
+COMMON_API bool				Img_Compress(const image_s& image, image_format_t fmt, bc_quality_t quality, image_s& compressed);
+
 /*
 ================================================================================
 terrain
@@ -233,7 +475,9 @@ enum class terrain_size_t : int {	// edge length of the squared terrain
 	TS_128,
 	TS_256,
 	TS_512,
-	TS_1K
+	TS_1K,
+	TS_2K,
+	TS_4K
 };
 
 struct terrain_gen_params_s {
@@ -255,6 +499,38 @@ COMMON_API uint32_t			Terrain_GetVertexCountPerEdge(terrain_size_t sz);
 COMMON_API bool				Terrain_Generate(const terrain_gen_params_s & params, terrain_s& terrain);
 COMMON_API void				Terrain_Free(terrain_s& terrain);
 
+// FIR erosion filter, smooths the heights in place, filter: [0 ~ 1]
+COMMON_API void				Terrain_Erode(terrain_s& terrain, float filter);
+
+// heights in fewer bits for GPU buffers, the data is an array of uints
+enum class terrain_height_format_t : int32_t {
+	FLOAT32,
+	UNORM16,		// [min_z, max_z] in 65536 steps, two to a uint, the first in the low half
+	FLOAT16,		// two to a uint, as unpackHalf2x16 reads them
+	BLOCK_DELTA		// 8x8 vertex blocks: num_block_ headers (base | shift << 16),
+					// then 16 uints of 8 bit deltas per block, q = base + (delta << shift)
+};
+
+struct terrain_packed_s {
+	terrain_height_format_t	format_;
+	int						vertex_count_per_edge_;
+	float					min_z_;
+	float					scale_z_;			// UNORM16, BLOCK_DELTA: height = min_z_ + q * scale_z_
+	uint32_t				blocks_per_row_;	// BLOCK_DELTA
+	uint32_t				num_block_;			// BLOCK_DELTA
+	uint32_t*				data_;
+	size_t					size_;				// bytes
+	float					max_error_;			// of the decoded heights
+	float					rms_error_;
+};
+
+// heights outside [min_z, max_z] are clamped by the 16 bit formats
+COMMON_API bool				Terrain_Pack(const terrain_s& terrain, terrain_height_format_t format, float min_z, float max_z,
+								terrain_packed_s& packed);
+// decodes as the shaders do, free the terrain with Terrain_Free
+COMMON_API bool				Terrain_Unpack(const terrain_packed_s& packed, terrain_s& terrain);
+COMMON_API void				Terrain_FreePacked(terrain_packed_s& packed);
+
 struct terrain_texture_tiles_s {
 	char					lowest_[MAX_PATH];
 	char					low_[MAX_PATH];
@@ -266,6 +542,55 @@ COMMON_API bool				Terrain_Texture(const terrain_texture_tiles_s & tile_images,
 								const terrain_s& terrain, 
 								int width, int height, image_s & texture);
 
+// world: a grid of tiles generated on demand, for terrains too large for one array
+//   every tile has (tile_size_ + 1) ^ 2 vertices, the last row / column is the first
+//   row / column of the next tile and gets exactly the same heights
+//   generated tiles are kept in a LRU cache limited by cache_budget_
+
+struct terrain_world_params_s {
+	terrain_gen_algorithm_t algo_;
+	uint32_t				tile_size_;		// quads per tile edge, power of 2: [32 ~ 1024]
+	uint32_t				num_tile_x_;
+	uint32_t				num_tile_y_;
+	uint32_t				seed_;
+	float					min_z_;
+	float					max_z_;
+	int						iterations_;	// for fault-formation, fault lines across the whole world
+	float					filter_;		// for fault-formation
+	float					roughness_;		// for mid-point
+	uint64_t				cache_budget_;	// bytes of cached tile heights
+};
+
+struct terrain_cache_stats_s {
+	uint32_t				num_tile_;
+	uint64_t				bytes_;
+	uint64_t				hits_;
+	uint64_t				misses_;
+	uint64_t				evictions_;
+};
+
+struct terrain_world_s;
+
+COMMON_API terrain_world_s*	Terrain_CreateWorld(const terrain_world_params_s & params);
+COMMON_API void				Terrain_DestroyWorld(terrain_world_s* world);
+
+// vertex count of the whole world
+COMMON_API void				Terrain_GetWorldSize(const terrain_world_s* world, uint32_t& vertex_count_x, uint32_t& vertex_count_y);
+
+// generate the missing tiles of [tile_x0, tile_x1) x [tile_y0, tile_y1) in parallel
+COMMON_API bool				Terrain_RequestTiles(terrain_world_s* world,
+								uint32_t tile_x0, uint32_t tile_y0, uint32_t tile_x1, uint32_t tile_y1);
+
+// the heights stay valid and cached until Terrain_ReleaseTile, do not Terrain_Free the tile
+COMMON_API bool				Terrain_AcquireTile(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y, terrain_s& tile);
+COMMON_API void				Terrain_ReleaseTile(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y);
+
+// copy the square window starting at world vertex (x, y), free it with Terrain_Free
+COMMON_API bool				Terrain_GetWorldRegion(terrain_world_s* world, uint32_t x, uint32_t y,
+								int vertex_count_per_edge, terrain_s& terrain);
+
+COMMON_API void				Terrain_GetCacheStats(terrain_world_s* world, terrain_cache_stats_s & stats);
+
 /*
 ================================================================================
 model
@@ -369,10 +694,48 @@ struct model_s {
 	uint32_t				num_parts_;
 	float					min_[3];
 	float					max_[3];
+	file_mapping_s			mapping_;	// arrays point into it when loaded from the binary cache
 };
 
 COMMON_API bool				Model_Load(const char* filename, bool move_to_origin, model_s & model, const glm::mat4 * transform = nullptr);
 COMMON_API void				Model_Free(model_s& model);
+COMMON_API uint32_t			Model_GetVertexSize(vertex_format_t fmt);
+
+// number of threads used to load model files, 1: serial (default), 0: hardware concurrency
+COMMON_API void				Model_SetLoadThreadCount(uint32_t count);
+
+// share vertices between faces of obj models (default), false: one vertex per face corner
+COMMON_API void				Model_SetWeldVertices(bool weld);
+COMMON_API bool				Model_GetWeldVertices();
+
+// binary cache, <filename>.mcache next to the source file
+//   Model_Load maps it instead of parsing the source while its path, size and mtime still match,
+//   and writes it after parsing (default), false: always parse the source
+COMMON_API void				Model_SetUseCache(bool use);
+COMMON_API void				Model_GetCacheFilename(const char* filename, char* cache_filename, int cache_filename_cap);
+COMMON_API bool				Model_LoadCache(const char* filename, model_s & model);
+COMMON_API bool				Model_SaveCache(const char* filename, const model_s & model);	// model as parsed, no transform
+
+// true if p points into the cache file mapping of model, it must not be freed
+COMMON_API bool				Model_IsMapped(const model_s & model, const void * p);
+
+// post-transform vertex cache
+//   ACMR: average cache miss ratio, transformed vertices per triangle (0.5 ~ 3)
+//   ATVR: average transformed vertex ratio, transformed vertices per referenced vertex (>= 1)
+struct model_optimize_stats_s {
+	float					acmr_before_;
+	float					atvr_before_;
+	float					acmr_after_;
+	float					atvr_after_;
+};
+
+// simulate a FIFO post-transform cache of cache_size entries
+COMMON_API void				Model_AnalyzeVertexCache(const uint32_t * indices, uint32_t index_count,
+								uint32_t vertex_count, uint32_t cache_size, float & acmr, float & atvr);
+
+// reorder the triangles of each part for the vertex cache (tipsify) and then overdraw,
+// then the vertices in order of first use
+COMMON_API bool				Model_Optimize(model_s & model, uint32_t cache_size = 16, model_optimize_stats_s * stats = nullptr);
 
 /*
 ================================================================================
@@ -401,12 +764,17 @@ entrance
 #define DEMO_MAIN(DEMO_CLASS)		\
 int main(int argc, char** argv) {	\
 	Common_Init();					\
-	DEMO_CLASS demo;				\
-	if (!demo.Init()) {				\
-		demo.Shutdown();			\
-		return 1;					\
+	int rt = 1;						\
+	{								\
+		DEMO_CLASS demo;			\
+		if (demo.ParseCommandLine(argc, argv)) {	\
+			if (demo.Init()) {		\
+				demo.MainLoop();	\
+				rt = 0;				\
+			}						\
+			demo.Shutdown();		\
+		}							\
 	}								\
-	demo.MainLoop();				\
-	demo.Shutdown();				\
-	return 0;						\
+	Common_Shutdown();				\
+	return rt;						\
 }
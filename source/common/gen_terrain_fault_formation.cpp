@@ -6,6 +6,170 @@
 
 #include "inc.h"
 
+#if defined(CPU_X86)
+# include <immintrin.h>
+#endif
+
+/*
+================================================================================
+fault lines
+================================================================================
+*/
+
+struct fault_line_s {
+	float					p0_x_;
+	float					p0_y_;
+	float					dir_x_;		// pt1 - pt0
+	float					dir_y_;
+	float					add_z_;
+};
+
+// minimum rows per thread
+static const uint32_t FAULT_FORMATION_MIN_ROWS = 16;
+
+/*
+  a sample pt is on the right side of line pt0 -> pt1 if
+    cross(pt - pt0, pt1 - pt0).z = (pt.x - pt0.x) * dir.y - dir.x * (pt.y - pt0.y) > 0
+
+  evaluated with exactly these float operations by every path, so the heights do not
+  depend on the instruction set or the number of threads
+
+  each row gets all the fault lines while it is in cache
+
+  x, y are world coordinates, exact in float up to 2^24, so a vertex gets the same
+  height whichever tile it is generated for
+ */
+
+static void FaultFormation_Row_Scalar(float* row, uint32_t x_begin, uint32_t count, uint32_t y,
+	const fault_line_s* lines, uint32_t num_line)
+{
+	for (uint32_t l = 0; l < num_line; ++l) {
+		const fault_line_s& line = lines[l];
+		float dir_x_mul_y = line.dir_x_ * ((float)y - line.p0_y_);
+
+		for (uint32_t x = 0; x < count; ++x) {
+			float c = ((float)(x_begin + x) - line.p0_x_) * line.dir_y_ - dir_x_mul_y;
+			if (c > 0.0f) {
+				row[x] += line.add_z_;
+			}
+		}
+	}
+}
+
+#if defined(CPU_X86)
+
+static void FaultFormation_Row_SSE2(float* row, uint32_t x_begin, uint32_t count, uint32_t y,
+	const fault_line_s* lines, uint32_t num_line)
+{
+	uint32_t count4 = count & ~3u;
+
+	for (uint32_t l = 0; l < num_line; ++l) {
+		const fault_line_s& line = lines[l];
+		float dir_x_mul_y = line.dir_x_ * ((float)y - line.p0_y_);
+
+		__m128 p0_x = _mm_set1_ps(line.p0_x_);
+		__m128 dir_y = _mm_set1_ps(line.dir_y_);
+		__m128 dxy = _mm_set1_ps(dir_x_mul_y);
+		__m128 add_z = _mm_set1_ps(line.add_z_);
+		__m128 zero = _mm_setzero_ps();
+		__m128 four = _mm_set1_ps(4.0f);
+		__m128 x = _mm_add_ps(_mm_set1_ps((float)x_begin), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+
+		for (uint32_t i = 0; i < count4; i += 4) {
+			__m128 c = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x, p0_x), dir_y), dxy);
+			__m128 mask = _mm_cmpgt_ps(c, zero);
+			__m128 h = _mm_loadu_ps(row + i);
+			h = _mm_or_ps(_mm_and_ps(mask, _mm_add_ps(h, add_z)), _mm_andnot_ps(mask, h));
+			_mm_storeu_ps(row + i, h);
+			x = _mm_add_ps(x, four);
+		}
+
+		for (uint32_t i = count4; i < count; ++i) {
+			float c = ((float)(x_begin + i) - line.p0_x_) * line.dir_y_ - dir_x_mul_y;
+			if (c > 0.0f) {
+				row[i] += line.add_z_;
+			}
+		}
+	}
+}
+
+TARGET_AVX2 static void FaultFormation_Row_AVX2(float* row, uint32_t x_begin, uint32_t count, uint32_t y,
+	const fault_line_s* lines, uint32_t num_line)
+{
+	uint32_t count8 = count & ~7u;
+
+	for (uint32_t l = 0; l < num_line; ++l) {
+		const fault_line_s& line = lines[l];
+		float dir_x_mul_y = line.dir_x_ * ((float)y - line.p0_y_);
+
+		__m256 p0_x = _mm256_set1_ps(line.p0_x_);
+		__m256 dir_y = _mm256_set1_ps(line.dir_y_);
+		__m256 dxy = _mm256_set1_ps(dir_x_mul_y);
+		__m256 add_z = _mm256_set1_ps(line.add_z_);
+		__m256 zero = _mm256_setzero_ps();
+		__m256 eight = _mm256_set1_ps(8.0f);
+		__m256 x = _mm256_add_ps(_mm256_set1_ps((float)x_begin), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+
+		for (uint32_t i = 0; i < count8; i += 8) {
+			__m256 c = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x, p0_x), dir_y), dxy);
+			__m256 mask = _mm256_cmp_ps(c, zero, _CMP_GT_OQ);
+			__m256 h = _mm256_loadu_ps(row + i);
+			h = _mm256_blendv_ps(h, _mm256_add_ps(h, add_z), mask);
+			_mm256_storeu_ps(row + i, h);
+			x = _mm256_add_ps(x, eight);
+		}
+
+		for (uint32_t i = count8; i < count; ++i) {
+			float c = ((float)(x_begin + i) - line.p0_x_) * line.dir_y_ - dir_x_mul_y;
+			if (c > 0.0f) {
+				row[i] += line.add_z_;
+			}
+		}
+	}
+}
+
+#endif
+
+// region [x_begin, x_begin + width) x [y_begin, y_begin + height) of the world
+static void FaultFormation_Apply(float* heights_buffer, uint32_t x_begin, uint32_t y_begin,
+	uint32_t width, uint32_t height, const fault_line_s* lines, uint32_t num_line, uint32_t max_thread)
+{
+	auto Row = FaultFormation_Row_Scalar;
+
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		Row = FaultFormation_Row_AVX2;
+		break;
+	case simd_level_t::SSE2:
+		Row = FaultFormation_Row_SSE2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	uint32_t num_thread = (height + FAULT_FORMATION_MIN_ROWS - 1) / FAULT_FORMATION_MIN_ROWS;
+	if (num_thread > max_thread) {
+		num_thread = max_thread;
+	}
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		uint32_t row_begin = (uint32_t)((uint64_t)height * idx / num_thread);
+		uint32_t row_end = (uint32_t)((uint64_t)height * (idx + 1) / num_thread);
+
+		for (uint32_t r = row_begin; r < row_end; ++r) {
+			Row(heights_buffer + (size_t)r * width, x_begin, width, y_begin + r, lines, num_line);
+		}
+	});
+}
+
+/*
+================================================================================
+fault formation
+================================================================================
+*/
+
 bool gen_terrain_fault_formation(terrain_size_t sz, float min_z, float max_z, 
 	int iterations, float filter, terrain_s& terrain) {
 
@@ -35,153 +199,197 @@ bool gen_terrain_fault_formation(terrain_size_t sz, float min_z, float max_z,
 		}
 	};
 
-	auto UpdateZ = [](float* heights_buffer, uint32_t vertex_count_per_edge, glm::vec2 pt0, glm::vec2 pt1, float z_add) {
-		glm::vec2 pt1_pt0 = pt1 - pt0;
-		
-		for (uint32_t y = 0; y < vertex_count_per_edge; ++y) {
-			for (uint32_t x = 0; x < vertex_count_per_edge; ++x) {
-				glm::vec2 pt = glm::vec2(x, y);
+	// clear result
+	terrain.vertex_count_per_edge_ = 0;
+	terrain.heights_ = nullptr;
 
-				glm::vec2 pt_pt0 = pt - pt0;
+	uint32_t vertex_count_per_edge = Terrain_GetVertexCountPerEdge(sz);
 
-				glm::vec3 c = glm::cross(glm::vec3(pt_pt0, 0.0f), glm::vec3(pt1_pt0, 0.0f));
-				if (c.z > 0.0f) {
-					// on right side of line pt0 -> pt1
-					heights_buffer[y * vertex_count_per_edge + x] += z_add;
-				}
-			}
-		}
-	};
+	// allocate buffers
+	float* heights_buffer = new float[vertex_count_per_edge * vertex_count_per_edge];
+	if (!heights_buffer) {
+		printf("Could not alloc height buffer\n");
+		return false;
+	}
 
-	// filter: [0 ~ 1]
-	auto Erode = [](float* heights_buffer, uint32_t vertex_count_per_edge, float filter) {
+	// fill zero
+	memset(heights_buffer, 0, sizeof(float) * vertex_count_per_edge * vertex_count_per_edge);
 
-		// FIR filter
-		auto FilterHeightBand = [](float* height_band, uint32_t vertex_count, uint32_t step, uint32_t count, float filter) {
-			float v = height_band[0];
-			uint32_t j = step;
+	// draw every line first, in the same random sequence as applying them one by one
+	std::vector<fault_line_s> lines(iterations > 0 ? iterations : 0);
 
-			// go through the height band and apply the erosion filter
-			for (uint32_t i = 0; i < count - 1; ++i) {
-				if (j >= vertex_count) {
-					break;
-				}
+	for (int i = 0; i < iterations; ++i) {
 
-				height_band[j] = filter * v + (1 - filter) * height_band[j];
+		float add_z = max_z - ((max_z - min_z) * i / iterations);
 
-				v = height_band[j];
-				j += step;
-			}
-		};
+		int edge0 = Rand() % 4;
+		int edge1 = (edge0 + (Rand() % 3) + 1) % 4;
 
-		uint32_t vertex_count = vertex_count_per_edge * vertex_count_per_edge;
+		glm::vec2 pt0 = GetRandomVec2(vertex_count_per_edge, edge0);
+		glm::vec2 pt1 = GetRandomVec2(vertex_count_per_edge, edge1);
 
-		// erode left to right
+		glm::vec2 pt1_pt0 = pt1 - pt0;
 
-		/*
-		
-		y
-		|____
-		|    |
-		0____|__x
+		lines[i] = { pt0.x, pt0.y, pt1_pt0.x, pt1_pt0.y, add_z };
+	}
 
-		  -->
-		
-		*/
+	FaultFormation_Apply(heights_buffer, 0, 0, vertex_count_per_edge, vertex_count_per_edge,
+		lines.data(), (uint32_t)lines.size(), Thread_GetHardwareConcurrency());
 
-		for (uint32_t i = 0; i < vertex_count_per_edge; ++i) {
-			FilterHeightBand(heights_buffer + i, vertex_count,
-				vertex_count_per_edge /*step*/, vertex_count_per_edge, filter);
-		}
+	terrain.vertex_count_per_edge_ = vertex_count_per_edge;
+	terrain.heights_ = heights_buffer;
+
+	Terrain_Erode(terrain, 0.33f);
+
+	return true;
+}
+
+/*
+================================================================================
+fault formation, world tiles
+================================================================================
+*/
+
+/*
+  the fault lines cross the whole world and are evaluated in world coordinates
 
-		// erode right to left
+  the erosion of a vertex restarts at a block boundary at least one block before it,
+  blocks are aligned in world coordinates, so every vertex gets the same heights from
+  whichever tile generates it and the tiles have no seams
 
-		/*
+  the block grows until filter ^ block is below float precision, the restart has no
+  visible effect
+ */
 
-		y
-		|____
-		|    |
-		0____|__x
+static uint32_t FaultFormation_TileErodeBlock(const terrain_world_params_s& params) {
+	uint32_t block = 32;
+	while (block < params.tile_size_ && powf(params.filter_, (float)block) > 1.0e-7f) {
+		block *= 2;
+	}
+	return block < params.tile_size_ ? block : params.tile_size_;
+}
 
-		  <--
+static void FaultFormation_WorldLines(const terrain_world_params_s& params, std::vector<fault_line_s>& lines) {
+	float dim_x = (float)(params.num_tile_x_ * params.tile_size_);
+	float dim_y = (float)(params.num_tile_y_ * params.tile_size_);
+	int iterations = params.iterations_ > 0 ? params.iterations_ : 0;
 
-		*/
+	// [0, 1] keyed by line and draw, the same lines for every tile
+	auto Random01 = [&params](int line, uint32_t draw) {
+		return (RandHash(params.seed_, (uint32_t)line, draw) & 0xFFFFFF) / (float)0xFFFFFF;
+	};
 
-		for (uint32_t i = 0; i < vertex_count_per_edge; ++i) {
-			FilterHeightBand(heights_buffer + vertex_count_per_edge - i - 1, vertex_count,
-				vertex_count_per_edge /*step*/, vertex_count_per_edge, filter);
+	auto GetRandomVec2 = [dim_x, dim_y](int edge, float t) -> glm::vec2 {
+		switch (edge) {
+		case 0:
+			return glm::vec2(dim_x * t, 0.0f);
+		case 1:
+			return glm::vec2(dim_x, dim_y * t);
+		case 2:
+			return glm::vec2(dim_x * t, dim_y);
+		default:	// case 3
+			return glm::vec2(0.0f, dim_y * t);
 		}
+	};
 
-		// erode top to bottom
+	lines.resize(iterations);
 
-		/*
+	for (int i = 0; i < iterations; ++i) {
+		float add_z = params.max_z_ - ((params.max_z_ - params.min_z_) * i / iterations);
 
-		y            |
-		|____        |
-		|    |      \|/
-		0____|__x
+		int edge0 = (int)(RandHash(params.seed_, (uint32_t)i, 0) % 4);
+		int edge1 = (edge0 + (int)(RandHash(params.seed_, (uint32_t)i, 1) % 3) + 1) % 4;
 
-		*/
+		glm::vec2 pt0 = GetRandomVec2(edge0, Random01(i, 2));
+		glm::vec2 pt1 = GetRandomVec2(edge1, Random01(i, 3));
 
-		for (uint32_t i = 0; i < vertex_count_per_edge; ++i) {
-			FilterHeightBand(
-				heights_buffer + vertex_count_per_edge * (vertex_count_per_edge - 1) - i * vertex_count_per_edge,
-				vertex_count,
-				1 /*step*/, vertex_count_per_edge, filter);
-		}
+		glm::vec2 pt1_pt0 = pt1 - pt0;
 
-		// erode from bottom to top
+		lines[i] = { pt0.x, pt0.y, pt1_pt0.x, pt1_pt0.y, add_z };
+	}
+}
 
-		/*
+// heights: (tile_size_ + 1) ^ 2
+bool gen_tile_fault_formation(const terrain_world_params_s& params, uint32_t tile_x, uint32_t tile_y, float* heights) {
+	std::vector<fault_line_s> lines;
+	FaultFormation_WorldLines(params, lines);
 
-		y           /|\
-		|____        |
-		|    |       |
-		0____|__x    |
+	uint32_t tile_size = params.tile_size_;
+	uint32_t block = FaultFormation_TileErodeBlock(params);
 
-		*/
+	// the tile and one erosion block before it
+	uint32_t x0 = tile_x * tile_size;
+	uint32_t y0 = tile_y * tile_size;
+	uint32_t region_x0 = x0 >= block ? x0 - block : 0;
+	uint32_t region_y0 = y0 >= block ? y0 - block : 0;
+	uint32_t width = x0 + tile_size + 1 - region_x0;
+	uint32_t height = y0 + tile_size + 1 - region_y0;
 
-		for (uint32_t i = 0; i < vertex_count_per_edge; ++i) {
-			FilterHeightBand(
-				heights_buffer + i * vertex_count_per_edge,
-				vertex_count,
-				1 /*step*/, vertex_count_per_edge, filter);
-		}
-	};
+	std::vector<float> raw((size_t)width * height, 0.0f);
+	FaultFormation_Apply(raw.data(), region_x0, region_y0, width, height, lines.data(), (uint32_t)lines.size(), 1);
 
-	// clear result
-	terrain.vertex_count_per_edge_ = 0;
-	terrain.heights_ = nullptr;
+	float filter = params.filter_;
+	float one_minus_filter = 1 - filter;
 
-	uint32_t vertex_count_per_edge = Terrain_GetVertexCountPerEdge(sz);
+	// columns, the rows of the tile over the whole region width
+	std::vector<float> columns((size_t)width * (tile_size + 1));
+	std::vector<float> v1(width), v2(width);
 
-	// allocate buffers
-	float* heights_buffer = new float[vertex_count_per_edge * vertex_count_per_edge];
-	if (!heights_buffer) {
-		printf("Could not alloc height buffer\n");
-		return false;
-	}
+	for (uint32_t b = y0; b <= y0 + tile_size; b += block) {
+		uint32_t start = b >= block ? b - block : 0;
+		uint32_t end = b + block - 1 < y0 + tile_size ? b + block - 1 : y0 + tile_size;
 
-	// fill zero
-	memset(heights_buffer, 0, sizeof(float) * vertex_count_per_edge * vertex_count_per_edge);
+		const float* src = raw.data() + (size_t)(start - region_y0) * width;
+		for (uint32_t x = 0; x < width; ++x) {
+			v1[x] = v2[x] = src[x];
+		}
 
-	for (int i = 0; i < iterations; ++i) {
+		if (start == b) {	// world edge, not filtered
+			memcpy(columns.data() + (size_t)(b - y0) * width, src, sizeof(float) * width);
+		}
 
-		float add_z = max_z - ((max_z - min_z) * i / iterations);
+		for (uint32_t y = start + 1; y <= end; ++y) {
+			src = raw.data() + (size_t)(y - region_y0) * width;
+			float* dst = y >= b ? columns.data() + (size_t)(y - y0) * width : nullptr;
 
-		int edge0 = Rand() % 4;
-		int edge1 = (edge0 + (Rand() % 3) + 1) % 4;
+			for (uint32_t x = 0; x < width; ++x) {
+				float h1 = filter * v1[x] + one_minus_filter * src[x];
+				v1[x] = h1;
 
-		glm::vec2 pt0 = GetRandomVec2(vertex_count_per_edge, edge0);
-		glm::vec2 pt1 = GetRandomVec2(vertex_count_per_edge, edge1);
+				float h2 = filter * v2[x] + one_minus_filter * h1;
+				v2[x] = h2;
 
-		UpdateZ(heights_buffer, vertex_count_per_edge, pt0, pt1, add_z);
+				if (dst) {
+					dst[x] = h2;
+				}
+			}
+		}
 	}
 
-	Erode(heights_buffer, vertex_count_per_edge, 0.33f);
+	// rows
+	for (uint32_t r = 0; r <= tile_size; ++r) {
+		const float* src = columns.data() + (size_t)r * width;
+		float* dst = heights + (size_t)r * (tile_size + 1);
 
-	terrain.vertex_count_per_edge_ = vertex_count_per_edge;
-	terrain.heights_ = heights_buffer;
+		for (uint32_t b = x0; b <= x0 + tile_size; b += block) {
+			uint32_t start = b >= block ? b - block : 0;
+			uint32_t end = b + block - 1 < x0 + tile_size ? b + block - 1 : x0 + tile_size;
+
+			float h1 = src[start - region_x0], h2 = h1;
+			if (start == b) {
+				dst[b - x0] = h1;
+			}
+
+			for (uint32_t x = start + 1; x <= end; ++x) {
+				h1 = filter * h1 + one_minus_filter * src[x - region_x0];
+				h2 = filter * h2 + one_minus_filter * h1;
+
+				if (x >= b) {
+					dst[x - x0] = h2;
+				}
+			}
+		}
+	}
 
 	return true;
 }
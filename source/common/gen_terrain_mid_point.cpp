@@ -175,3 +175,236 @@ bool gen_terrain_mid_point(terrain_size_t sz, float min_z, float max_z, float ro
 
 	return true;
 }
+
+/*
+================================================================================
+mid-point, world tiles
+================================================================================
+*/
+
+/*
+  for tiles the mid-point of an edge only depends on the two end points, the
+  center of a square on its four corners, so a tile only depends on the heights
+  of its corners and the vertices on a shared edge get the same heights in both
+  tiles
+
+  the tile corners are generated once for the whole world, the displacement sign
+  of every vertex is a hash of its world position
+ */
+
+// power of 2 tiles covering the world
+static uint32_t MidPoint_WorldTiles(const terrain_world_params_s& params) {
+	uint32_t tiles = 1;
+	while (tiles < params.num_tile_x_ || tiles < params.num_tile_y_) {
+		tiles *= 2;
+	}
+	return tiles;
+}
+
+// displacement of the vertices created with squares of step vertices
+static float MidPoint_Delta(const terrain_world_params_s& params, uint32_t step) {
+	uint32_t level = 0;
+	for (uint32_t s = MidPoint_WorldTiles(params) * params.tile_size_; s > step; s /= 2) {
+		level++;
+	}
+
+	return (params.max_z_ - params.min_z_) * 0.5f * powf(2.0f, -1.0f * params.roughness_ * level);
+}
+
+static float MidPoint_Displace(const terrain_world_params_s& params, uint32_t x, uint32_t y, float delta) {
+	return (RandHash(params.seed_, x, y) & 0x80000000u) ? -delta : delta;
+}
+
+// displace the squares of heights (pitch vertices per row, world vertex (x0, y0) first)
+// from step down to 2 vertices, unit: world vertices per grid cell
+static void MidPoint_Refine(const terrain_world_params_s& params, float* heights, uint32_t pitch,
+	uint32_t count_x, uint32_t count_y, uint32_t x0, uint32_t y0, uint32_t unit, uint32_t step)
+{
+	auto At = [heights, pitch](uint32_t x, uint32_t y) -> float& {
+		return heights[(size_t)y * pitch + x];
+	};
+
+	for (; step >= 2; step /= 2) {
+		uint32_t half = step / 2;
+		float delta = MidPoint_Delta(params, step * unit);
+
+		// centers
+		for (uint32_t y = half; y < count_y; y += step) {
+			for (uint32_t x = half; x < count_x; x += step) {
+				float h = (At(x - half, y - half) + At(x + half, y - half) + At(x + half, y + half) + At(x - half, y + half)) * 0.25f;
+				At(x, y) = h + MidPoint_Displace(params, x0 + x * unit, y0 + y * unit, delta);
+			}
+		}
+
+		// horizontal edges
+		for (uint32_t y = 0; y < count_y; y += step) {
+			for (uint32_t x = half; x < count_x; x += step) {
+				float h = (At(x - half, y) + At(x + half, y)) * 0.5f;
+				At(x, y) = h + MidPoint_Displace(params, x0 + x * unit, y0 + y * unit, delta);
+			}
+		}
+
+		// vertical edges
+		for (uint32_t y = half; y < count_y; y += step) {
+			for (uint32_t x = 0; x < count_x; x += step) {
+				float h = (At(x, y - half) + At(x, y + half)) * 0.5f;
+				At(x, y) = h + MidPoint_Displace(params, x0 + x * unit, y0 + y * unit, delta);
+			}
+		}
+	}
+}
+
+// corners: (num_tile_x_ + 1) * (num_tile_y_ + 1) heights of the tile corners
+// [lo, hi]: range of every height of the world before it is scaled to [min_z_, max_z_]
+void gen_world_mid_point(const terrain_world_params_s& params, std::vector<float>& corners, float& lo, float& hi) {
+	uint32_t tiles = MidPoint_WorldTiles(params);
+	uint32_t count = tiles + 1;
+
+	std::vector<float> grid((size_t)count * count);
+
+	float delta = MidPoint_Delta(params, tiles * params.tile_size_);
+	uint32_t dim = tiles * params.tile_size_;
+
+	auto Random = [&params](uint32_t x, uint32_t y) {
+		return (RandHash(params.seed_, x, y) & 0xFFFFFF) / (float)0xFFFFFF * 2.0f - 1.0f;
+	};
+
+	grid[0] = Random(0, 0) * delta;
+	grid[tiles] = Random(dim, 0) * delta;
+	grid[(size_t)tiles * count + tiles] = Random(dim, dim) * delta;
+	grid[(size_t)tiles * count] = Random(0, dim) * delta;
+
+	MidPoint_Refine(params, grid.data(), count, count, count, 0, 0, params.tile_size_, tiles);
+
+	corners.resize((size_t)(params.num_tile_x_ + 1) * (params.num_tile_y_ + 1));
+
+	lo = 9999999999.0f;
+	hi = -9999999999.0f;
+
+	for (uint32_t y = 0; y <= params.num_tile_y_; ++y) {
+		for (uint32_t x = 0; x <= params.num_tile_x_; ++x) {
+			float z = grid[(size_t)y * count + x];
+			corners[(size_t)y * (params.num_tile_x_ + 1) + x] = z;
+			lo = z < lo ? z : lo;
+			hi = z > hi ? z : hi;
+		}
+	}
+
+	// the vertices inside the tiles move at most the sum of their displacements
+	float displacement = 0.0f;
+	for (uint32_t step = params.tile_size_; step >= 2; step /= 2) {
+		displacement += MidPoint_Delta(params, step);
+	}
+
+	lo -= displacement;
+	hi += displacement;
+}
+
+// heights: (tile_size_ + 1) ^ 2
+bool gen_tile_mid_point(const terrain_world_params_s& params, const float* corners, float lo, float hi,
+	uint32_t tile_x, uint32_t tile_y, float* heights)
+{
+	uint32_t tile_size = params.tile_size_;
+	uint32_t corner_pitch = params.num_tile_x_ + 1;
+
+	// the tile and its neighbors, the filter reads 4 vertices into them
+	uint32_t tx0 = tile_x > 0 ? tile_x - 1 : 0;
+	uint32_t ty0 = tile_y > 0 ? tile_y - 1 : 0;
+	uint32_t tx1 = tile_x + 2 < params.num_tile_x_ ? tile_x + 2 : params.num_tile_x_;
+	uint32_t ty1 = tile_y + 2 < params.num_tile_y_ ? tile_y + 2 : params.num_tile_y_;
+
+	uint32_t width = (tx1 - tx0) * tile_size + 1;
+	uint32_t height = (ty1 - ty0) * tile_size + 1;
+
+	std::vector<float> heights_buffer((size_t)width * height);
+	std::vector<float> filter_buffer((size_t)width * height);
+
+	for (uint32_t ty = ty0; ty < ty1; ++ty) {
+		for (uint32_t tx = tx0; tx < tx1; ++tx) {
+			float* tile = heights_buffer.data() + (size_t)(ty - ty0) * tile_size * width + (tx - tx0) * tile_size;
+
+			tile[0] = corners[(size_t)ty * corner_pitch + tx];
+			tile[tile_size] = corners[(size_t)ty * corner_pitch + tx + 1];
+			tile[(size_t)tile_size * width] = corners[(size_t)(ty + 1) * corner_pitch + tx];
+			tile[(size_t)tile_size * width + tile_size] = corners[(size_t)(ty + 1) * corner_pitch + tx + 1];
+
+			MidPoint_Refine(params, tile, width, tile_size + 1, tile_size + 1,
+				tx * tile_size, ty * tile_size, 1, tile_size);
+		}
+	}
+
+	// filter height values, the window shrinks by one vertex each pass
+	// and the neighbors are clamped to the world edges only
+	const int filter_count = 4;
+
+	int region_x0 = (int)(tx0 * tile_size);
+	int region_y0 = (int)(ty0 * tile_size);
+	int world_x1 = (int)(params.num_tile_x_ * tile_size);
+	int world_y1 = (int)(params.num_tile_y_ * tile_size);
+
+	float* src = heights_buffer.data();
+	float* dst = filter_buffer.data();
+
+	auto get_buffer_z = [&](const float* buffer, int x, int y) {
+		x = x < 0 ? 0 : (x > world_x1 ? world_x1 : x);
+		y = y < 0 ? 0 : (y > world_y1 ? world_y1 : y);
+		return buffer[(size_t)(y - region_y0) * width + (x - region_x0)];
+	};
+
+	for (int f = 0; f < filter_count; ++f) {
+		int margin = filter_count - 1 - f;
+		int x_begin = (int)(tile_x * tile_size) - margin;
+		int y_begin = (int)(tile_y * tile_size) - margin;
+		int x_end = (int)((tile_x + 1) * tile_size) + margin;
+		int y_end = (int)((tile_y + 1) * tile_size) + margin;
+
+		x_begin = x_begin < 0 ? 0 : x_begin;
+		y_begin = y_begin < 0 ? 0 : y_begin;
+		x_end = x_end > world_x1 ? world_x1 : x_end;
+		y_end = y_end > world_y1 ? world_y1 : y_end;
+
+		for (int y = y_begin; y <= y_end; ++y) {
+			for (int x = x_begin; x <= x_end; ++x) {
+				float h0 = get_buffer_z(src, x, y);
+				float h1 = get_buffer_z(src, x - 1, y);
+				float h2 = get_buffer_z(src, x + 1, y);
+				float h3 = get_buffer_z(src, x, y - 1);
+				float h4 = get_buffer_z(src, x, y + 1);
+				float h5 = get_buffer_z(src, x - 1, y - 1);
+				float h6 = get_buffer_z(src, x - 1, y + 1);
+				float h7 = get_buffer_z(src, x + 1, y + 1);
+				float h8 = get_buffer_z(src, x + 1, y - 1);
+
+				dst[(size_t)(y - region_y0) * width + (x - region_x0)] = (h0 + h1 + h2 + h3 + h4 + h5 + h6 + h7 + h8) / 9.0f;
+			}
+		}
+
+		std::swap(src, dst);
+	}
+
+	// shift to user defined range
+	float real_delta_inv = 1.0f / (hi - lo);
+	float idea_delta = params.max_z_ - params.min_z_;
+
+	for (uint32_t y = 0; y <= tile_size; ++y) {
+		for (uint32_t x = 0; x <= tile_size; ++x) {
+			float old_z = get_buffer_z(src, (int)(tile_x * tile_size + x), (int)(tile_y * tile_size + y));
+
+			float f = (old_z - lo) * real_delta_inv;
+			float new_z = params.min_z_ + idea_delta * f;
+
+			// clamp
+			if (new_z < params.min_z_) {
+				new_z = params.min_z_;
+			}
+
+			if (new_z > params.max_z_) {
+				new_z = params.max_z_;
+			}
+
+			heights[(size_t)y * (tile_size + 1) + x] = new_z;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,304 @@
+/******************************************************************************
+ image_mipmap.cpp
+
+   mip chains of R8G8B8A8 images
+
+   every level is resampled from the level above kept in float, so the
+   rounding of one level does not feed the next, odd sizes are handled by
+   weighting each source texel by its overlap with the destination footprint,
+   the two passes are separable with their weight tables built once per level
+ *****************************************************************************/
+
+#include "inc.h"
+
+// minimum rows per thread
+static const int MIPMAP_MIN_ROWS = 32;
+
+// kaiser window: shape and radius in destination texels
+static const float MIPMAP_KAISER_ALPHA = 4.0f;
+static const float MIPMAP_KAISER_RADIUS = 3.0f;
+
+struct mipmap_tap_s {
+	int						first_;		// first source texel
+	int						count_;
+	int						weight_;	// offset of the weights in the table
+};
+
+struct mipmap_weights_s {
+	std::vector<mipmap_tap_s>	taps_;		// one per destination texel
+	std::vector<float>			weights_;
+};
+
+/*
+================================================================================
+sRGB
+================================================================================
+*/
+
+static float Mipmap_SRGBToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+struct mipmap_srgb_table_s {
+	float					to_linear_[256];
+	float					thresholds_[255];	// linear value halfway between two 8 bit codes
+
+	mipmap_srgb_table_s() {
+		for (int i = 0; i < 256; ++i) {
+			to_linear_[i] = Mipmap_SRGBToLinear(i / 255.0f);
+		}
+
+		for (int i = 0; i < 255; ++i) {
+			thresholds_[i] = Mipmap_SRGBToLinear((i + 0.5f) / 255.0f);
+		}
+	}
+
+	byte_t ToSRGB(float linear) const {
+		// first code whose upper threshold is above the value
+		int lo = 0, hi = 255;
+		while (lo < hi) {
+			int mid = (lo + hi) >> 1;
+			if (linear < thresholds_[mid]) {
+				hi = mid;
+			}
+			else {
+				lo = mid + 1;
+			}
+		}
+		return (byte_t)lo;
+	}
+};
+
+static const mipmap_srgb_table_s& Mipmap_GetSRGBTable() {
+	static mipmap_srgb_table_s table;
+	return table;
+}
+
+/*
+================================================================================
+filters
+================================================================================
+*/
+
+static float Mipmap_BesselI0(float x) {
+	float sum = 1.0f, term = 1.0f, q = x * x * 0.25f;
+	for (int k = 1; k < 20; ++k) {
+		term *= q / (float)(k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float Mipmap_Kaiser(float x) {
+	if (fabsf(x) >= MIPMAP_KAISER_RADIUS) {
+		return 0.0f;
+	}
+
+	float t = x / MIPMAP_KAISER_RADIUS;
+	float window = Mipmap_BesselI0(MIPMAP_KAISER_ALPHA * sqrtf(1.0f - t * t)) / Mipmap_BesselI0(MIPMAP_KAISER_ALPHA);
+	float sinc = fabsf(x) < 1.0e-5f ? 1.0f : sinf((float)MATH_PI * x) / ((float)MATH_PI * x);
+	return sinc * window;
+}
+
+// weights of the source texels contributing to each of dst_size texels, edges clamped
+static void Mipmap_BuildWeights(int src_size, int dst_size, mip_filter_t filter, mipmap_weights_s& table) {
+	float scale = (float)src_size / dst_size;
+
+	table.taps_.resize(dst_size);
+	table.weights_.clear();
+
+	for (int i = 0; i < dst_size; ++i) {
+		mipmap_tap_s& tap = table.taps_[i];
+		tap.weight_ = (int)table.weights_.size();
+
+		float lo = i * scale;
+		float hi = (i + 1) * scale;
+
+		if (filter == mip_filter_t::BOX) {
+			tap.first_ = (int)lo;
+			int last = (int)ceilf(hi) - 1;
+			last = last < src_size - 1 ? last : src_size - 1;
+			tap.count_ = last - tap.first_ + 1;
+
+			for (int j = tap.first_; j <= last; ++j) {
+				float a = lo > j ? lo : (float)j;
+				float b = hi < j + 1 ? hi : (float)(j + 1);
+				table.weights_.push_back((b - a) / scale);
+			}
+			continue;
+		}
+
+		// kaiser, in destination texel units around the footprint center
+		float center = (lo + hi) * 0.5f;
+		float support = MIPMAP_KAISER_RADIUS * scale;
+		int first = (int)floorf(center - support);
+		int last = (int)ceilf(center + support);
+
+		tap.first_ = first;
+		tap.count_ = last - first + 1;
+
+		float sum = 0.0f;
+		for (int j = first; j <= last; ++j) {
+			float w = Mipmap_Kaiser((j + 0.5f - center) / scale);
+			table.weights_.push_back(w);
+			sum += w;
+		}
+
+		for (int k = 0; k < tap.count_; ++k) {
+			table.weights_[tap.weight_ + k] /= sum;
+		}
+	}
+}
+
+static int Mipmap_Clamp(int v, int size) {
+	return v < 0 ? 0 : (v >= size ? size - 1 : v);
+}
+
+// src: src_w x src_h RGBA floats, dst: dst_w x dst_h
+static void Mipmap_Resample(const float* src, int src_w, int src_h, float* dst, int dst_w, int dst_h,
+	mip_filter_t filter, std::vector<float>& temp)
+{
+	mipmap_weights_s tx, ty;
+	Mipmap_BuildWeights(src_w, dst_w, filter, tx);
+	Mipmap_BuildWeights(src_h, dst_h, filter, ty);
+
+	// horizontal: src_h x dst_w
+	temp.resize((size_t)src_h * dst_w * 4);
+
+	uint32_t num_thread = (uint32_t)((src_h + MIPMAP_MIN_ROWS - 1) / MIPMAP_MIN_ROWS);
+	uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+	num_thread = num_thread > hardware_threads ? hardware_threads : num_thread;
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		int row_begin = (int)((int64_t)src_h * idx / num_thread);
+		int row_end = (int)((int64_t)src_h * (idx + 1) / num_thread);
+
+		for (int y = row_begin; y < row_end; ++y) {
+			const float* row = src + (size_t)y * src_w * 4;
+			float* out = temp.data() + (size_t)y * dst_w * 4;
+
+			for (int x = 0; x < dst_w; ++x) {
+				const mipmap_tap_s& tap = tx.taps_[x];
+				const float* w = tx.weights_.data() + tap.weight_;
+				float sum[4] = {};
+
+				for (int k = 0; k < tap.count_; ++k) {
+					const float* texel = row + Mipmap_Clamp(tap.first_ + k, src_w) * 4;
+					sum[0] += texel[0] * w[k];
+					sum[1] += texel[1] * w[k];
+					sum[2] += texel[2] * w[k];
+					sum[3] += texel[3] * w[k];
+				}
+
+				memcpy(out + x * 4, sum, sizeof(sum));
+			}
+		}
+	});
+
+	// vertical
+	num_thread = (uint32_t)((dst_h + MIPMAP_MIN_ROWS - 1) / MIPMAP_MIN_ROWS);
+	num_thread = num_thread > hardware_threads ? hardware_threads : num_thread;
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		int row_begin = (int)((int64_t)dst_h * idx / num_thread);
+		int row_end = (int)((int64_t)dst_h * (idx + 1) / num_thread);
+
+		for (int y = row_begin; y < row_end; ++y) {
+			const mipmap_tap_s& tap = ty.taps_[y];
+			const float* w = ty.weights_.data() + tap.weight_;
+			float* out = dst + (size_t)y * dst_w * 4;
+
+			memset(out, 0, sizeof(float) * dst_w * 4);
+
+			for (int k = 0; k < tap.count_; ++k) {
+				const float* row = temp.data() + (size_t)Mipmap_Clamp(tap.first_ + k, src_h) * dst_w * 4;
+				for (int x = 0; x < dst_w * 4; ++x) {
+					out[x] += row[x] * w[k];
+				}
+			}
+		}
+	});
+}
+
+/*
+================================================================================
+Img_GenerateMipmaps
+================================================================================
+*/
+
+static void Mipmap_Store(const float* src, size_t num_texel, bool srgb, byte_t* dst) {
+	const mipmap_srgb_table_s& table = Mipmap_GetSRGBTable();
+
+	for (size_t i = 0; i < num_texel * 4; ++i) {
+		float v = src[i] < 0.0f ? 0.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+		if (srgb && (i & 3) != 3) {
+			dst[i] = table.ToSRGB(v);
+		}
+		else {
+			dst[i] = (byte_t)(v * 255.0f + 0.5f);
+		}
+	}
+}
+
+COMMON_API bool Img_GenerateMipmaps(const image_s& image, mip_filter_t filter, bool srgb, image_s& mipmapped) {
+	memset(&mipmapped, 0, sizeof(mipmapped));
+
+	if (image.format_ != image_format_t::R8G8B8A8) {
+		printf("Img_GenerateMipmaps: source must be R8G8B8A8\n");
+		return false;
+	}
+
+	int mip_levels = 1;
+	for (int size = image.width_ > image.height_ ? image.width_ : image.height_; size > 1; size >>= 1) {
+		mip_levels++;
+	}
+
+	mipmapped.width_ = image.width_;
+	mipmapped.height_ = image.height_;
+	mipmapped.format_ = image_format_t::R8G8B8A8;
+	mipmapped.mip_levels_ = mip_levels;
+	mipmapped.array_layers_ = image.array_layers_ > 1 ? image.array_layers_ : 1;
+	mipmapped.cubemap_ = image.cubemap_;
+
+	mipmapped.pixels_ = (byte_t*)TEMP_ALLOC(Img_GetDataSize(mipmapped));
+	if (!mipmapped.pixels_) {
+		printf("Memory overflow\n");
+		memset(&mipmapped, 0, sizeof(mipmapped));
+		return false;
+	}
+
+	const mipmap_srgb_table_s& table = Mipmap_GetSRGBTable();
+	size_t num_texel = (size_t)image.width_ * image.height_;
+
+	std::vector<float> level, next, temp;
+
+	for (int layer = 0; layer < mipmapped.array_layers_; ++layer) {
+		// level 0 of the source layer (the source may have levels of its own)
+		const byte_t* src = image.pixels_ + Img_GetSubresourceOffset(image, layer, 0);
+		memcpy(mipmapped.pixels_ + Img_GetSubresourceOffset(mipmapped, layer, 0), src, num_texel * 4);
+
+		level.resize(num_texel * 4);
+		for (size_t i = 0; i < num_texel * 4; ++i) {
+			level[i] = srgb && (i & 3) != 3 ? table.to_linear_[src[i]] : src[i] / 255.0f;
+		}
+
+		int w = image.width_;
+		int h = image.height_;
+
+		for (int l = 1; l < mip_levels; ++l) {
+			int next_w = w > 1 ? w >> 1 : 1;
+			int next_h = h > 1 ? h >> 1 : 1;
+
+			next.resize((size_t)next_w * next_h * 4);
+			Mipmap_Resample(level.data(), w, h, next.data(), next_w, next_h, filter, temp);
+			Mipmap_Store(next.data(), (size_t)next_w * next_h, srgb,
+				mipmapped.pixels_ + Img_GetSubresourceOffset(mipmapped, layer, l));
+
+			level.swap(next);
+			w = next_w;
+			h = next_h;
+		}
+	}
+
+	return true;
+}
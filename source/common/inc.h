@@ -13,6 +13,10 @@
 # error "unsupported platform."
 #endif
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# define	CPU_X86
+#endif
+
 #if defined(PLATFORM_WINDOWS)
 # if defined(COMMON_MODULE)
 #  define COMMON_API __declspec(dllexport)
@@ -34,10 +38,13 @@
 
 #if defined(PLATFORM_LINUX)
 # define VK_USE_PLATFORM_XLIB_KHR
+# include <X11/keysym.h>				// KEY_F1 ... of funcs.h
 #endif
 
 // stdlib
 #include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -51,6 +58,12 @@
 // stl
 #include <vector>
 #include <array>
+#include <functional>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "MathLib/MathLib.h"
 #include "MathLib/Vec2.h"
@@ -74,5 +87,9 @@
 #include "ply.h"
 #include "obj.h"
 #include "vk_defines.h"
+#include "vk_memory.h"
 #include "vk_demo.h"
+#include "vk_upload.h"
+#include "vk_uniform.h"
+#include "vk_stream.h"
 #include "vk_model.h"
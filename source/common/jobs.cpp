@@ -0,0 +1,506 @@
+/******************************************************************************
+ jobs.cpp
+
+   work-stealing job pool
+
+   every worker owns a deque: it runs its newest job first, idle workers
+   steal the oldest job of another one, which for a range split in halves
+   is the largest piece left, threads outside the pool queue their jobs in
+   a shared deque
+
+   a thread waiting for jobs runs queued jobs meanwhile instead of blocking,
+   so jobs can wait for jobs of their own (nested Job_ParallelFor, Thread_Run
+   inside Thread_Run) without running out of workers
+
+   Common_Init starts the pool and Common_Shutdown joins it, a Job_* call
+   before starts it on first use, from any thread, static initializers
+   included
+ *****************************************************************************/
+
+#include "inc.h"
+
+#include <atomic>
+#include <chrono>
+
+// tries of a worker with nothing to do before it sleeps
+static const uint32_t JOB_SPIN_COUNT = 64;
+
+struct pool_job_s {
+	std::function<void()>	func_;
+	std::atomic<uint32_t>*	pending_;	// decremented once func_ returned
+};
+
+struct pool_worker_s {
+	std::mutex				mutex_;
+	std::deque<pool_job_s*>	jobs_;
+	std::thread				thread_;
+	uint32_t				random_;	// victim choice
+
+	// stats
+	std::atomic<uint64_t>	executed_;
+	std::atomic<uint64_t>	steals_;
+	std::atomic<uint64_t>	idle_ns_;
+};
+
+struct job_pool_s {
+	std::vector<pool_worker_s*>	workers_;
+	pool_worker_s			external_;		// jobs queued by threads outside the pool, their stats
+
+	std::mutex				sleep_mutex_;
+	std::condition_variable	cv_;
+	std::atomic<uint32_t>	queued_;		// jobs in every deque
+	std::atomic<uint32_t>	sleeping_;
+	bool					stop_;
+};
+
+static std::atomic<job_pool_s*>	g_job_pool = nullptr;
+static std::mutex				g_job_pool_mutex;
+
+// the worker running on this thread, nullptr outside the pool
+static thread_local pool_worker_s*	t_job_worker = nullptr;
+
+/*
+================================================================================
+pool
+================================================================================
+*/
+
+static uint64_t Pool_NowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void Pool_Push(job_pool_s* pool, pool_job_s* job) {
+	pool_worker_s* queue = t_job_worker ? t_job_worker : &pool->external_;
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex_);
+		queue->jobs_.push_back(job);
+	}
+
+	// a worker going to sleep counts itself before it checks queued_, one of the two sees the other
+	pool->queued_++;
+	if (pool->sleeping_.load()) {
+		std::lock_guard<std::mutex> lock(pool->sleep_mutex_);
+		pool->cv_.notify_one();
+	}
+}
+
+static pool_job_s* Pool_TakeBack(pool_worker_s* queue) {
+	std::lock_guard<std::mutex> lock(queue->mutex_);
+	if (queue->jobs_.empty()) {
+		return nullptr;
+	}
+	pool_job_s* job = queue->jobs_.back();
+	queue->jobs_.pop_back();
+	return job;
+}
+
+static pool_job_s* Pool_TakeFront(pool_worker_s* queue) {
+	std::lock_guard<std::mutex> lock(queue->mutex_);
+	if (queue->jobs_.empty()) {
+		return nullptr;
+	}
+	pool_job_s* job = queue->jobs_.front();
+	queue->jobs_.pop_front();
+	return job;
+}
+
+// own newest, then the oldest of the external queue, then the oldest of another worker
+static pool_job_s* Pool_Pop(job_pool_s* pool, pool_worker_s* self) {
+	if (!pool->queued_.load()) {
+		return nullptr;
+	}
+
+	pool_job_s* job = nullptr;
+	if (self) {
+		job = Pool_TakeBack(self);
+		if (!job) {
+			job = Pool_TakeFront(&pool->external_);
+		}
+	}
+	else {
+		job = Pool_TakeBack(&pool->external_);
+	}
+
+	if (!job) {
+		uint32_t num_worker = (uint32_t)pool->workers_.size();
+		pool_worker_s* thief = self ? self : &pool->external_;
+
+		// xorshift, only a spread of the victims
+		uint32_t r = thief->random_;
+		r ^= r << 13;
+		r ^= r >> 17;
+		r ^= r << 5;
+		thief->random_ = r;
+
+		for (uint32_t i = 0; i < num_worker && !job; ++i) {
+			pool_worker_s* victim = pool->workers_[(r + i) % num_worker];
+			if (victim != self) {
+				job = Pool_TakeFront(victim);
+			}
+		}
+
+		if (job) {
+			thief->steals_++;
+		}
+	}
+
+	if (job) {
+		pool->queued_--;
+	}
+
+	return job;
+}
+
+static void Pool_Execute(pool_worker_s* self, pool_job_s* job) {
+	std::atomic<uint32_t>* pending = job->pending_;
+
+	job->func_();
+	delete job;
+
+	self->executed_++;
+
+	// last access of the job's group, the waiter may return right after
+	pending->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+static void Pool_WorkerMain(job_pool_s* pool, pool_worker_s* self) {
+	t_job_worker = self;
+
+	while (true) {
+		pool_job_s* job = Pool_Pop(pool, self);
+		if (job) {
+			Pool_Execute(self, job);
+			continue;
+		}
+
+		uint64_t t0 = Pool_NowNs();
+
+		for (uint32_t i = 0; i < JOB_SPIN_COUNT && !job; ++i) {
+			std::this_thread::yield();
+			job = Pool_Pop(pool, self);
+		}
+
+		if (!job) {
+			std::unique_lock<std::mutex> lock(pool->sleep_mutex_);
+			pool->sleeping_++;
+			pool->cv_.wait(lock, [pool] { return pool->queued_.load() > 0 || pool->stop_; });
+			pool->sleeping_--;
+
+			if (pool->stop_ && !pool->queued_.load()) {
+				break;
+			}
+		}
+
+		self->idle_ns_ += Pool_NowNs() - t0;
+
+		if (job) {
+			Pool_Execute(self, job);
+		}
+	}
+
+	t_job_worker = nullptr;
+}
+
+// until pending is 0, running queued jobs meanwhile
+static void Pool_Wait(job_pool_s* pool, std::atomic<uint32_t>& pending) {
+	pool_worker_s* self = t_job_worker;
+	pool_worker_s* stats = self ? self : &pool->external_;
+
+	while (pending.load(std::memory_order_acquire)) {
+		pool_job_s* job = Pool_Pop(pool, self);
+		if (job) {
+			Pool_Execute(stats, job);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+static job_pool_s* Pool_Create(uint32_t num_worker) {
+	job_pool_s* pool = new job_pool_s();
+	pool->queued_ = 0;
+	pool->sleeping_ = 0;
+	pool->stop_ = false;
+	pool->external_.random_ = 0x9E3779B9;
+	pool->external_.executed_ = 0;
+	pool->external_.steals_ = 0;
+	pool->external_.idle_ns_ = 0;
+
+	pool->workers_.resize(num_worker);
+	for (uint32_t i = 0; i < num_worker; ++i) {
+		pool_worker_s* worker = new pool_worker_s();
+		worker->random_ = 0x9E3779B9 * (i + 2);
+		worker->executed_ = 0;
+		worker->steals_ = 0;
+		worker->idle_ns_ = 0;
+		pool->workers_[i] = worker;
+	}
+
+	// every deque exists before any worker steals
+	for (pool_worker_s* worker : pool->workers_) {
+		worker->thread_ = std::thread(Pool_WorkerMain, pool, worker);
+	}
+
+	return pool;
+}
+
+static void Pool_Destroy(job_pool_s* pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool->sleep_mutex_);
+		pool->stop_ = true;
+		pool->cv_.notify_all();
+	}
+
+	// the others may still steal from a worker until they stopped too
+	for (pool_worker_s* worker : pool->workers_) {
+		worker->thread_.join();
+	}
+	for (pool_worker_s* worker : pool->workers_) {
+		delete worker;
+	}
+
+	delete pool;
+}
+
+// never destroyed at exit: joining threads from a static destructor hangs in a dll on windows
+static job_pool_s* Pool_Get() {
+	job_pool_s* pool = g_job_pool.load(std::memory_order_acquire);
+	if (pool) {
+		return pool;
+	}
+
+	std::lock_guard<std::mutex> lock(g_job_pool_mutex);
+	pool = g_job_pool.load(std::memory_order_acquire);
+	if (!pool) {
+		uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+		pool = Pool_Create(hardware_threads - 1);
+		g_job_pool.store(pool, std::memory_order_release);
+	}
+
+	return pool;
+}
+
+/*
+================================================================================
+Job_*
+================================================================================
+*/
+
+COMMON_API void Job_Init(uint32_t num_thread) {
+	std::lock_guard<std::mutex> lock(g_job_pool_mutex);
+
+	job_pool_s* pool = g_job_pool.load(std::memory_order_acquire);
+	if (pool) {
+		Pool_Destroy(pool);
+	}
+
+	if (!num_thread) {
+		num_thread = Thread_GetHardwareConcurrency();
+	}
+
+	g_job_pool.store(Pool_Create(num_thread - 1), std::memory_order_release);
+}
+
+COMMON_API void Job_Shutdown() {
+	std::lock_guard<std::mutex> lock(g_job_pool_mutex);
+
+	job_pool_s* pool = g_job_pool.load(std::memory_order_acquire);
+	if (pool) {
+		Pool_Destroy(pool);
+		g_job_pool.store(nullptr, std::memory_order_release);
+	}
+}
+
+COMMON_API uint32_t Job_GetWorkerCount() {
+	return (uint32_t)Pool_Get()->workers_.size();
+}
+
+COMMON_API void Job_GetStats(uint32_t worker, job_stats_s& stats) {
+	job_pool_s* pool = Pool_Get();
+
+	const pool_worker_s* w = worker < (uint32_t)pool->workers_.size() ? pool->workers_[worker] : &pool->external_;
+	stats.executed_ = w->executed_.load();
+	stats.steals_ = w->steals_.load();
+	stats.idle_ms_ = w->idle_ns_.load() * 1.0e-6;
+}
+
+COMMON_API void Job_ResetStats() {
+	job_pool_s* pool = Pool_Get();
+
+	pool->external_.executed_ = 0;
+	pool->external_.steals_ = 0;
+	pool->external_.idle_ns_ = 0;
+
+	for (pool_worker_s* worker : pool->workers_) {
+		worker->executed_ = 0;
+		worker->steals_ = 0;
+		worker->idle_ns_ = 0;
+	}
+}
+
+COMMON_API uint32_t Job_GetDefaultGrain(uint32_t count) {
+	// about 4 chunks per thread
+	uint32_t num_chunk = (Job_GetWorkerCount() + 1) * 4;
+	uint32_t grain = count / num_chunk;
+	return grain ? grain : 1;
+}
+
+COMMON_API void Job_ParallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+	const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+	if (end <= begin) {
+		return;
+	}
+
+	uint32_t count = end - begin;
+	if (!grain) {
+		grain = Job_GetDefaultGrain(count);
+	}
+
+	uint32_t num_chunk = (uint32_t)(((uint64_t)count + grain - 1) / grain);
+	if (num_chunk == 1) {
+		func(begin, end);
+		return;
+	}
+
+	job_pool_s* pool = Pool_Get();
+	std::atomic<uint32_t> pending = 0;
+
+	// chunks [c0, c1): the upper half goes to the deque, the lower half is split on until one chunk is left
+	std::function<void(uint32_t, uint32_t)> split = [&](uint32_t c0, uint32_t c1) {
+		while (c1 - c0 > 1) {
+			uint32_t mid = c0 + (c1 - c0) / 2;
+
+			pending++;
+			Pool_Push(pool, new pool_job_s{ [&split, mid, c1] { split(mid, c1); }, &pending });
+
+			c1 = mid;
+		}
+
+		uint32_t chunk_begin = begin + c0 * grain;
+		uint32_t chunk_end = end - chunk_begin > grain ? chunk_begin + grain : end;
+		func(chunk_begin, chunk_end);
+	};
+
+	split(0, num_chunk);
+
+	Pool_Wait(pool, pending);
+}
+
+COMMON_API void Job_Async(std::atomic<uint32_t>& pending, const std::function<void()>& func) {
+	job_pool_s* pool = Pool_Get();
+
+	// nobody would run it before a wait
+	if (pool->workers_.empty()) {
+		func();
+		return;
+	}
+
+	pending++;
+	Pool_Push(pool, new pool_job_s{ func, &pending });
+}
+
+COMMON_API void Job_Wait(std::atomic<uint32_t>& pending) {
+	Pool_Wait(Pool_Get(), pending);
+}
+
+/*
+================================================================================
+graph
+================================================================================
+*/
+
+struct job_graph_task_s {
+	std::function<void()>	func_;
+	std::vector<uint32_t>	successors_;
+	uint32_t				num_dependency_;
+	std::atomic<uint32_t>	remaining_;		// dependencies not finished in the current run
+};
+
+struct job_graph_s {
+	std::deque<job_graph_task_s>	tasks_;	// stable addresses, atomics do not move
+	std::atomic<uint32_t>	pending_;
+};
+
+COMMON_API job_graph_s* Job_CreateGraph() {
+	job_graph_s* graph = new job_graph_s();
+	graph->pending_ = 0;
+	return graph;
+}
+
+COMMON_API void Job_DestroyGraph(job_graph_s* graph) {
+	delete graph;
+}
+
+COMMON_API uint32_t Job_AddTask(job_graph_s* graph, const std::function<void()>& func) {
+	job_graph_task_s& task = graph->tasks_.emplace_back();
+	task.func_ = func;
+	task.num_dependency_ = 0;
+	task.remaining_ = 0;
+	return (uint32_t)graph->tasks_.size() - 1;
+}
+
+COMMON_API void Job_AddDependency(job_graph_s* graph, uint32_t before, uint32_t task) {
+	graph->tasks_[before].successors_.push_back(task);
+	graph->tasks_[task].num_dependency_++;
+}
+
+static void Graph_PushTask(job_pool_s* pool, job_graph_s* graph, uint32_t idx) {
+	Pool_Push(pool, new pool_job_s{ [pool, graph, idx] {
+		job_graph_task_s& task = graph->tasks_[idx];
+		task.func_();
+
+		for (uint32_t s : task.successors_) {
+			if (graph->tasks_[s].remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				Graph_PushTask(pool, graph, s);
+			}
+		}
+	}, &graph->pending_ });
+}
+
+COMMON_API bool Job_RunGraph(job_graph_s* graph) {
+	uint32_t num_task = (uint32_t)graph->tasks_.size();
+	if (!num_task) {
+		return true;
+	}
+
+	// Kahn's algorithm: every task reachable from the roots, or a cycle
+	std::vector<uint32_t> remaining(num_task), ready;
+	for (uint32_t i = 0; i < num_task; ++i) {
+		remaining[i] = graph->tasks_[i].num_dependency_;
+		if (!remaining[i]) {
+			ready.push_back(i);
+		}
+	}
+
+	uint32_t num_root = (uint32_t)ready.size();
+	for (size_t i = 0; i < ready.size(); ++i) {
+		for (uint32_t s : graph->tasks_[ready[i]].successors_) {
+			if (!--remaining[s]) {
+				ready.push_back(s);
+			}
+		}
+	}
+
+	if ((uint32_t)ready.size() != num_task) {
+		printf("Job_RunGraph: the dependencies have a cycle\n");
+		return false;
+	}
+
+	for (job_graph_task_s& task : graph->tasks_) {
+		task.remaining_ = task.num_dependency_;
+	}
+
+	job_pool_s* pool = Pool_Get();
+	graph->pending_ = num_task;
+
+	for (uint32_t i = 0; i < num_root; ++i) {
+		Graph_PushTask(pool, graph, ready[i]);
+	}
+
+	Pool_Wait(pool, graph->pending_);
+
+	return true;
+}
@@ -0,0 +1,266 @@
+/******************************************************************************
+ model_cache.cpp
+
+   versioned binary cache of model_s, written next to the source model file
+   and memory mapped by Model_Load on later loads instead of parsing it again
+
+   layout: header, vertices, indices, parts, materials, each section aligned
+   to MODEL_CACHE_ALIGNMENT bytes, native byte order
+ *****************************************************************************/
+
+#include "inc.h"
+#include <algorithm>
+
+static const uint32_t MODEL_CACHE_MAGIC = 0x434C444D;		// "MDLC"
+static const uint32_t MODEL_CACHE_VERSION = 1;
+static const uint64_t MODEL_CACHE_ALIGNMENT = 16;
+
+// load options which change the content
+static const uint32_t MODEL_CACHE_FLAG_WELD_VERTICES = 1;
+
+struct model_cache_header_s {
+	uint32_t				magic_;
+	uint32_t				version_;
+	uint32_t				flags_;
+	uint32_t				header_size_;
+	uint32_t				material_size_;		// MAX_PATH differs between platforms
+	int32_t					vertex_format_;
+	uint32_t				vertex_size_;
+	uint32_t				num_vertex_;
+	uint32_t				num_index_;
+	uint32_t				num_material_;
+	uint32_t				num_parts_;
+	uint32_t				reserved_;
+	uint64_t				source_size_;
+	int64_t					source_mtime_;
+	char					source_path_[MAX_PATH];
+	float					min_[3];
+	float					max_[3];
+	uint64_t				vertices_offset_;
+	uint64_t				indices_offset_;
+	uint64_t				parts_offset_;
+	uint64_t				materials_offset_;
+	uint64_t				file_size_;
+};
+
+static uint64_t ModelCache_Align(uint64_t offset) {
+	return (offset + MODEL_CACHE_ALIGNMENT - 1) & ~(MODEL_CACHE_ALIGNMENT - 1);
+}
+
+static uint32_t ModelCache_Flags() {
+	return Model_GetWeldVertices() ? MODEL_CACHE_FLAG_WELD_VERTICES : 0;
+}
+
+COMMON_API void Model_GetCacheFilename(const char* filename, char* cache_filename, int cache_filename_cap) {
+	Str_SPrintf(cache_filename, cache_filename_cap, "%s.mcache", filename);
+}
+
+COMMON_API bool Model_IsMapped(const model_s& model, const void* p) {
+	const char* begin = (const char*)model.mapping_.data_;
+	return begin && (const char*)p >= begin && (const char*)p < begin + model.mapping_.size_;
+}
+
+COMMON_API bool Model_LoadCache(const char* filename, model_s& model) {
+	memset(&model, 0, sizeof(model));
+
+	uint64_t source_size = 0;
+	int64_t source_mtime = 0;
+	if (!File_GetStat(filename, source_size, source_mtime)) {
+		return false;
+	}
+
+	char cache_filename[MAX_PATH];
+	Model_GetCacheFilename(filename, cache_filename, MAX_PATH);
+
+	file_mapping_s mapping = {};
+	if (!File_Map(cache_filename, mapping)) {
+		return false;	// not baked yet
+	}
+
+	const model_cache_header_s* header = (const model_cache_header_s*)mapping.data_;
+
+	char source_path[MAX_PATH];
+	Str_Copy(source_path, MAX_PATH, filename);
+
+	// stale or foreign cache files are rewritten by the caller
+	bool valid = mapping.size_ >= sizeof(model_cache_header_s)
+		&& header->magic_ == MODEL_CACHE_MAGIC
+		&& header->version_ == MODEL_CACHE_VERSION
+		&& header->header_size_ == sizeof(model_cache_header_s)
+		&& header->material_size_ == sizeof(model_material_s)
+		&& header->flags_ == ModelCache_Flags()
+		&& header->file_size_ == mapping.size_
+		&& header->source_size_ == source_size
+		&& header->source_mtime_ == source_mtime
+		&& strncmp(header->source_path_, source_path, MAX_PATH) == 0;
+
+	if (valid) {
+		uint32_t vertex_size = Model_GetVertexSize((vertex_format_t)header->vertex_format_);
+
+		auto SectionFits = [&mapping](uint64_t offset, uint64_t count, uint64_t elem_size) {
+			return offset <= mapping.size_ && count * elem_size <= mapping.size_ - offset;
+		};
+
+		valid = vertex_size && vertex_size == header->vertex_size_
+			&& SectionFits(header->vertices_offset_, header->num_vertex_, vertex_size)
+			&& SectionFits(header->indices_offset_, header->num_index_, sizeof(uint32_t))
+			&& SectionFits(header->parts_offset_, header->num_parts_, sizeof(model_part_s))
+			&& SectionFits(header->materials_offset_, header->num_material_, sizeof(model_material_s));
+	}
+
+	if (!valid) {
+		File_Unmap(mapping);
+		return false;
+	}
+
+	char* base = (char*)mapping.data_;
+
+	model.vertex_format_ = (vertex_format_t)header->vertex_format_;
+	model.num_vertex_ = header->num_vertex_;
+	model.num_index_ = header->num_index_;
+	model.num_material_ = header->num_material_;
+	model.num_parts_ = header->num_parts_;
+
+	model.vertices_ = base + header->vertices_offset_;
+	model.indices_ = (uint32_t*)(base + header->indices_offset_);
+	model.parts_ = header->num_parts_ ? (model_part_s*)(base + header->parts_offset_) : nullptr;
+	model.materials_ = header->num_material_ ? (model_material_s*)(base + header->materials_offset_) : nullptr;
+
+	for (int j = 0; j < 3; ++j) {
+		model.min_[j] = header->min_[j];
+		model.max_[j] = header->max_[j];
+	}
+
+	model.mapping_ = mapping;
+
+	for (uint32_t i = 0; i < model.num_parts_; ++i) {
+		const model_part_s& part = model.parts_[i];
+		if ((uint64_t)part.index_offset_ + part.index_count_ > model.num_index_) {
+			printf("Model_LoadCache: bad part in %s\n", cache_filename);
+			Model_Free(model);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+COMMON_API bool Model_SaveCache(const char* filename, const model_s& model) {
+	uint32_t vertex_size = Model_GetVertexSize(model.vertex_format_);
+	if (!vertex_size) {
+		printf("Model_SaveCache: bad vertex format\n");
+		return false;
+	}
+
+	model_cache_header_s header;
+	memset(&header, 0, sizeof(header));
+
+	if (!File_GetStat(filename, header.source_size_, header.source_mtime_)) {
+		printf("Model_SaveCache: could not stat %s\n", filename);
+		return false;
+	}
+
+	header.magic_ = MODEL_CACHE_MAGIC;
+	header.version_ = MODEL_CACHE_VERSION;
+	header.flags_ = ModelCache_Flags();
+	header.header_size_ = sizeof(model_cache_header_s);
+	header.material_size_ = sizeof(model_material_s);
+	header.vertex_format_ = (int32_t)model.vertex_format_;
+	header.vertex_size_ = vertex_size;
+	header.num_vertex_ = model.num_vertex_;
+	header.num_index_ = model.num_index_;
+	header.num_material_ = model.num_material_;
+	header.num_parts_ = model.num_parts_;
+	Str_Copy(header.source_path_, MAX_PATH, filename);
+
+	// bounds of the untransformed model
+	for (int j = 0; j < 3; ++j) {
+		header.min_[j] = 1.0e30f;
+		header.max_[j] = -1.0e30f;
+	}
+
+	const char* v = (const char*)model.vertices_;
+	for (uint32_t i = 0; i < model.num_vertex_; ++i) {
+		const float* pos = (const float*)(v + (size_t)vertex_size * i);
+		for (int j = 0; j < 3; ++j) {
+			if (pos[j] < header.min_[j]) {
+				header.min_[j] = pos[j];
+			}
+			if (pos[j] > header.max_[j]) {
+				header.max_[j] = pos[j];
+			}
+		}
+	}
+
+	uint64_t vertices_bytes = (uint64_t)vertex_size * model.num_vertex_;
+	uint64_t indices_bytes = sizeof(uint32_t) * (uint64_t)model.num_index_;
+	uint64_t parts_bytes = sizeof(model_part_s) * (uint64_t)model.num_parts_;
+	uint64_t materials_bytes = sizeof(model_material_s) * (uint64_t)model.num_material_;
+
+	header.vertices_offset_ = ModelCache_Align(sizeof(model_cache_header_s));
+	header.indices_offset_ = ModelCache_Align(header.vertices_offset_ + vertices_bytes);
+	header.parts_offset_ = ModelCache_Align(header.indices_offset_ + indices_bytes);
+	header.materials_offset_ = ModelCache_Align(header.parts_offset_ + parts_bytes);
+	header.file_size_ = header.materials_offset_ + materials_bytes;
+
+	char cache_filename[MAX_PATH];
+	Model_GetCacheFilename(filename, cache_filename, MAX_PATH);
+
+	FILE* f = File_Open(cache_filename, "wb");
+	if (!f) {
+		printf("Model_SaveCache: could not create %s\n", cache_filename);
+		return false;
+	}
+
+	uint64_t written = 0;
+	auto Write = [f, &written](uint64_t offset, const void* data, uint64_t bytes) {
+		static const char ZEROS[MODEL_CACHE_ALIGNMENT] = {};
+		while (written < offset) {
+			size_t pad = (size_t)std::min<uint64_t>(offset - written, MODEL_CACHE_ALIGNMENT);
+			if (fwrite(ZEROS, 1, pad, f) != pad) {
+				return false;
+			}
+			written += pad;
+		}
+		if (bytes && fwrite(data, 1, (size_t)bytes, f) != bytes) {
+			return false;
+		}
+		written += bytes;
+		return true;
+	};
+
+	// the magic is written last, a partially written file never validates
+	model_cache_header_s incomplete_header = header;
+	incomplete_header.magic_ = 0;
+
+	bool ok = Write(0, &incomplete_header, sizeof(incomplete_header))
+		&& Write(header.vertices_offset_, model.vertices_, vertices_bytes)
+		&& Write(header.indices_offset_, model.indices_, indices_bytes)
+		&& Write(header.parts_offset_, model.parts_, parts_bytes);
+
+	// zero the texture path tails, the same model always bakes to the same file
+	for (uint32_t i = 0; i < model.num_material_ && ok; ++i) {
+		model_material_s material = model.materials_[i];
+		size_t len = strnlen(material.tex_file_, MAX_PATH);
+		memset(material.tex_file_ + len, 0, MAX_PATH - len);
+
+		ok = Write(header.materials_offset_ + sizeof(model_material_s) * i, &material, sizeof(material));
+	}
+
+	// without materials the padding before materials_offset_ is still part of file_size_
+	ok = ok && Write(header.file_size_, nullptr, 0);
+
+	if (ok) {
+		ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+	}
+
+	ok = fclose(f) == 0 && ok;
+
+	if (!ok) {
+		printf("Model_SaveCache: failed to write %s\n", cache_filename);
+		remove(cache_filename);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,398 @@
+/******************************************************************************
+ model_optimize.cpp
+
+   reorder model triangles for the post-transform vertex cache and overdraw,
+   then vertices for sequential fetch
+
+   Tipsify: P. V. Sander, D. Nehab, J. Barczak, "Fast Triangle Reordering for
+   Vertex Locality and Reduced Overdraw", SIGGRAPH 2007
+ *****************************************************************************/
+
+#include "inc.h"
+#include <algorithm>
+
+/*
+================================================================================
+vertex cache analysis
+================================================================================
+*/
+COMMON_API void Model_AnalyzeVertexCache(const uint32_t* indices, uint32_t index_count,
+	uint32_t vertex_count, uint32_t cache_size, float& acmr, float& atvr)
+{
+	acmr = 0.0f;
+	atvr = 0.0f;
+
+	if (index_count < 3 || !vertex_count || !cache_size) {
+		return;
+	}
+
+	// FIFO cache: a vertex is in the cache if fewer than cache_size misses happened since it was loaded
+	uint32_t* loaded_at = (uint32_t*)TEMP_ALLOC(sizeof(uint32_t) * vertex_count);
+	if (!loaded_at) {
+		return;
+	}
+	memset(loaded_at, 0, sizeof(uint32_t) * vertex_count);	// 0: never loaded
+
+	uint32_t misses = 0;
+	uint32_t unique_vertices = 0;
+
+	for (uint32_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+
+		if (!loaded_at[v]) {
+			unique_vertices++;
+		}
+
+		if (!loaded_at[v] || misses - loaded_at[v] >= cache_size) {
+			misses++;
+			loaded_at[v] = misses;
+		}
+	}
+
+	TEMP_FREE(loaded_at);
+
+	acmr = (float)misses / (float)(index_count / 3);
+	atvr = (float)misses / (float)unique_vertices;
+}
+
+/*
+================================================================================
+tipsify
+================================================================================
+*/
+struct tipsify_s {
+	const uint32_t *		indices_;
+	uint32_t				cache_size_;
+
+	// vertex -> triangles
+	const uint32_t *		adj_offsets_;
+	const uint32_t *		adj_triangles_;
+
+	uint32_t *				live_;			// not emitted triangles of each vertex
+	uint32_t *				cache_time_;
+	uint32_t				time_;
+	bool *					emitted_;
+
+	std::vector<uint32_t>	dead_end_;
+	std::vector<uint32_t>	candidates_;
+};
+
+// order the triangles [first_triangle, first_triangle + triangle_count)
+// out_triangles: emitted triangles
+// out_cluster_starts: positions in out_triangles where fanning had to jump to a non adjacent vertex
+static void Tipsify(tipsify_s& ctx, uint32_t first_triangle, uint32_t triangle_count,
+	std::vector<uint32_t>& out_triangles, std::vector<uint32_t>& out_cluster_starts)
+{
+	const uint32_t* indices = ctx.indices_;
+
+	for (uint32_t t = first_triangle; t < first_triangle + triangle_count; ++t) {
+		ctx.emitted_[t] = false;
+		ctx.live_[indices[t * 3 + 0]]++;
+		ctx.live_[indices[t * 3 + 1]]++;
+		ctx.live_[indices[t * 3 + 2]]++;
+	}
+
+	ctx.dead_end_.clear();
+
+	uint32_t cursor = first_triangle * 3;	// index position, used when the dead end stack is empty
+	uint32_t cursor_end = (first_triangle + triangle_count) * 3;
+
+	auto SkipDeadEnd = [&]() -> uint32_t {
+		while (!ctx.dead_end_.empty()) {
+			uint32_t d = ctx.dead_end_.back();
+			ctx.dead_end_.pop_back();
+			if (ctx.live_[d]) {
+				return d;
+			}
+		}
+
+		while (cursor < cursor_end) {
+			uint32_t v = indices[cursor];
+			if (ctx.live_[v]) {
+				return v;
+			}
+			cursor++;
+		}
+
+		return VK_INVALID_INDEX;
+	};
+
+	uint32_t fanning = triangle_count ? indices[first_triangle * 3] : VK_INVALID_INDEX;
+	bool jumped = true;
+
+	while (fanning != VK_INVALID_INDEX) {
+		if (jumped) {
+			out_cluster_starts.push_back((uint32_t)out_triangles.size());
+		}
+
+		ctx.candidates_.clear();
+
+		// emit all the triangles around the fanning vertex
+		for (uint32_t a = ctx.adj_offsets_[fanning]; a < ctx.adj_offsets_[fanning + 1]; ++a) {
+			uint32_t t = ctx.adj_triangles_[a];
+			if (ctx.emitted_[t]) {
+				continue;
+			}
+
+			out_triangles.push_back(t);
+			ctx.emitted_[t] = true;
+
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = indices[t * 3 + k];
+
+				ctx.dead_end_.push_back(v);
+				ctx.candidates_.push_back(v);
+				ctx.live_[v]--;
+
+				if (ctx.time_ - ctx.cache_time_[v] > ctx.cache_size_) {
+					ctx.cache_time_[v] = ctx.time_++;
+				}
+			}
+		}
+
+		// next fanning vertex: the one that stays in the cache after its remaining triangles are emitted,
+		// preferring the oldest
+		uint32_t best = VK_INVALID_INDEX;
+		int32_t best_priority = -1;
+
+		for (uint32_t v : ctx.candidates_) {
+			if (!ctx.live_[v]) {
+				continue;
+			}
+
+			int32_t priority = 0;
+			uint32_t age = ctx.time_ - ctx.cache_time_[v];
+			if (age + 2 * ctx.live_[v] <= ctx.cache_size_) {
+				priority = (int32_t)age;
+			}
+
+			if (priority > best_priority) {
+				best_priority = priority;
+				best = v;
+			}
+		}
+
+		jumped = best == VK_INVALID_INDEX;
+		fanning = jumped ? SkipDeadEnd() : best;
+	}
+}
+
+/*
+================================================================================
+overdraw
+================================================================================
+*/
+
+// sort the clusters front to back seen from outside: clusters facing away from the center
+// of the part are drawn first, they tend to occlude the inner ones
+static void SortClustersForOverdraw(const uint32_t* indices, const byte_t* vertices, size_t stride,
+	const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& cluster_starts,
+	uint32_t* out_indices)
+{
+	auto Pos = [vertices, stride](uint32_t v) -> const glm::vec3& {
+		return *(const glm::vec3*)(vertices + stride * v);
+	};
+
+	struct cluster_s {
+		uint32_t	first_;
+		uint32_t	count_;
+		glm::vec3	centroid_;
+		glm::vec3	normal_;
+		float		sort_key_;
+	};
+
+	std::vector<cluster_s> clusters(cluster_starts.size());
+
+	glm::vec3 part_centroid = glm::vec3(0.0f);
+
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		cluster_s& cluster = clusters[c];
+
+		cluster.first_ = cluster_starts[c];
+		cluster.count_ = (c + 1 < clusters.size() ? cluster_starts[c + 1] : (uint32_t)triangles.size()) - cluster.first_;
+		cluster.centroid_ = glm::vec3(0.0f);
+		cluster.normal_ = glm::vec3(0.0f);
+
+		for (uint32_t i = cluster.first_; i < cluster.first_ + cluster.count_; ++i) {
+			uint32_t t = triangles[i];
+
+			const glm::vec3& p0 = Pos(indices[t * 3 + 0]);
+			const glm::vec3& p1 = Pos(indices[t * 3 + 1]);
+			const glm::vec3& p2 = Pos(indices[t * 3 + 2]);
+
+			cluster.centroid_ += (p0 + p1 + p2) * (1.0f / 3.0f);
+			cluster.normal_ += glm::cross(p1 - p0, p2 - p0);	// area weighted
+		}
+
+		part_centroid += cluster.centroid_;
+
+		if (cluster.count_) {
+			cluster.centroid_ /= (float)cluster.count_;
+		}
+	}
+
+	if (!triangles.empty()) {
+		part_centroid /= (float)triangles.size();
+	}
+
+	for (cluster_s& cluster : clusters) {
+		float len = glm::length(cluster.normal_);
+		glm::vec3 n = len > 0.0f ? cluster.normal_ / len : glm::vec3(0.0f);
+
+		cluster.sort_key_ = glm::dot(cluster.centroid_ - part_centroid, n);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const cluster_s& a, const cluster_s& b) {
+		return a.sort_key_ > b.sort_key_;
+	});
+
+	uint32_t written = 0;
+	for (const cluster_s& cluster : clusters) {
+		for (uint32_t i = cluster.first_; i < cluster.first_ + cluster.count_; ++i) {
+			uint32_t t = triangles[i];
+
+			out_indices[written * 3 + 0] = indices[t * 3 + 0];
+			out_indices[written * 3 + 1] = indices[t * 3 + 1];
+			out_indices[written * 3 + 2] = indices[t * 3 + 2];
+			written++;
+		}
+	}
+}
+
+/*
+================================================================================
+Model_Optimize
+================================================================================
+*/
+COMMON_API bool Model_Optimize(model_s& model, uint32_t cache_size, model_optimize_stats_s* stats) {
+	size_t stride = Model_GetVertexSize(model.vertex_format_);
+	if (!stride || !cache_size) {
+		printf("Model_Optimize: bad parameters\n");
+		return false;
+	}
+
+	for (uint32_t i = 0; i < model.num_parts_; ++i) {
+		const model_part_s& part = model.parts_[i];
+		if (part.index_offset_ % 3 || part.index_count_ % 3 ||
+			part.index_offset_ + part.index_count_ > model.num_index_) {
+			printf("Model_Optimize: part %u is not a triangle list\n", i);
+			return false;
+		}
+	}
+
+	if (stats) {
+		Model_AnalyzeVertexCache(model.indices_, model.num_index_, model.num_vertex_, cache_size,
+			stats->acmr_before_, stats->atvr_before_);
+	}
+
+	uint32_t num_vertex = model.num_vertex_;
+	uint32_t num_triangle = model.num_index_ / 3;
+	const uint32_t* indices = model.indices_;
+
+	// vertex -> triangles adjacency
+	std::vector<uint32_t> adj_offsets(num_vertex + 1, 0);
+	std::vector<uint32_t> adj_triangles(num_triangle * 3);
+
+	for (uint32_t i = 0; i < num_triangle * 3; ++i) {
+		adj_offsets[indices[i] + 1]++;
+	}
+	for (uint32_t v = 0; v < num_vertex; ++v) {
+		adj_offsets[v + 1] += adj_offsets[v];
+	}
+
+	std::vector<uint32_t> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+	for (uint32_t i = 0; i < num_triangle * 3; ++i) {
+		adj_triangles[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<uint32_t> live(num_vertex, 0);
+	std::vector<uint32_t> cache_time(num_vertex, 0);
+	bool* emitted = (bool*)TEMP_ALLOC(sizeof(bool) * (num_triangle ? num_triangle : 1));
+	uint32_t* new_indices = (uint32_t*)TEMP_ALLOC(sizeof(uint32_t) * (model.num_index_ ? model.num_index_ : 1));
+
+	if (!emitted || !new_indices) {
+		SAFE_FREE(new_indices);
+		SAFE_FREE(emitted);
+		printf("Model_Optimize: memory overflow\n");
+		return false;
+	}
+
+	memset(emitted, 1, sizeof(bool) * num_triangle);	// triangles of other parts are skipped
+	memcpy(new_indices, indices, sizeof(uint32_t) * model.num_index_);
+
+	tipsify_s ctx;
+	ctx.indices_ = indices;
+	ctx.cache_size_ = cache_size;
+	ctx.adj_offsets_ = adj_offsets.data();
+	ctx.adj_triangles_ = adj_triangles.data();
+	ctx.live_ = live.data();
+	ctx.cache_time_ = cache_time.data();
+	ctx.time_ = cache_size + 1;
+	ctx.emitted_ = emitted;
+
+	std::vector<uint32_t> triangles;
+	std::vector<uint32_t> cluster_starts;
+
+	// 1. vertex cache, 2. overdraw, per part
+	for (uint32_t i = 0; i < model.num_parts_; ++i) {
+		const model_part_s& part = model.parts_[i];
+
+		triangles.clear();
+		cluster_starts.clear();
+
+		Tipsify(ctx, part.index_offset_ / 3, part.index_count_ / 3, triangles, cluster_starts);
+
+		SortClustersForOverdraw(indices, (const byte_t*)model.vertices_, stride,
+			triangles, cluster_starts, new_indices + part.index_offset_);
+	}
+
+	TEMP_FREE(emitted);
+
+	// 3. vertices in order of first use, unreferenced vertices are kept at the end
+	std::vector<uint32_t> remap(num_vertex, VK_INVALID_INDEX);
+	uint32_t next_vertex = 0;
+
+	for (uint32_t i = 0; i < model.num_index_; ++i) {
+		uint32_t& v = new_indices[i];
+		if (remap[v] == VK_INVALID_INDEX) {
+			remap[v] = next_vertex++;
+		}
+		v = remap[v];
+	}
+
+	for (uint32_t v = 0; v < num_vertex; ++v) {
+		if (remap[v] == VK_INVALID_INDEX) {
+			remap[v] = next_vertex++;
+		}
+	}
+
+	byte_t* new_vertices = (byte_t*)TEMP_ALLOC(stride * (num_vertex ? num_vertex : 1));
+	if (!new_vertices) {
+		TEMP_FREE(new_indices);
+		printf("Model_Optimize: memory overflow\n");
+		return false;
+	}
+
+	const byte_t* old_vertices = (const byte_t*)model.vertices_;
+	for (uint32_t v = 0; v < num_vertex; ++v) {
+		memcpy(new_vertices + stride * remap[v], old_vertices + stride * v, stride);
+	}
+
+	// a model loaded from the binary cache keeps its arrays in the file mapping
+	if (!Model_IsMapped(model, model.vertices_)) {
+		TEMP_FREE(model.vertices_);
+	}
+	if (!Model_IsMapped(model, model.indices_)) {
+		TEMP_FREE(model.indices_);
+	}
+
+	model.vertices_ = new_vertices;
+	model.indices_ = new_indices;
+
+	if (stats) {
+		Model_AnalyzeVertexCache(model.indices_, model.num_index_, model.num_vertex_, cache_size,
+			stats->acmr_after_, stats->atvr_after_);
+	}
+
+	return true;
+}
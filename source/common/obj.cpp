@@ -32,24 +32,6 @@ static void Line_ParseVec1(const char* s, float& v) {
 	}
 }
 
-static void Line_ParseVec2(const char* s, glm::vec2& v) {
-	v.x = 0.0f;
-	v.y = 0.0f;
-
-	char str_h[64] = {};	// head
-	char str_x[64] = {};
-	char str_y[64] = {};
-
-	char* parts[3] = { str_h, str_x, str_y };
-
-	int tokens = Str_Tokenize(s, parts, 64, 3);
-
-	if (tokens == 3) {
-		v.x = (float)atof(str_x);
-		v.y = (float)atof(str_y);
-	}
-}
-
 static void Line_ParseVec3(const char* s, glm::vec3& v) {
 	v.x = 0.0f;
 	v.y = 0.0f;
@@ -71,6 +53,220 @@ static void Line_ParseVec3(const char* s, glm::vec3& v) {
 	}
 }
 
+/*
+================================================================================
+in place tokenizer
+================================================================================
+*/
+enum class keyword_t {
+	NONE,
+	V,
+	VT,
+	VN,
+	F,
+	USEMTL,
+	MTLLIB
+};
+
+static inline bool Obj_IsBlank(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static inline bool Obj_IsEOL(char c) {
+	return c == '\n' || c == '\r' || c == 0;
+}
+
+static inline const char* Obj_SkipBlank(const char* pc) {
+	while (Obj_IsBlank(*pc)) {
+		pc++;
+	}
+	return pc;
+}
+
+static inline const char* Obj_SkipToken(const char* pc) {
+	while (!Obj_IsBlank(*pc) && !Obj_IsEOL(*pc)) {
+		pc++;
+	}
+	return pc;
+}
+
+// return the beginning of the next line
+static inline const char* Obj_NextLine(const char* pc) {
+	while (!Obj_IsEOL(*pc)) {
+		pc++;
+	}
+
+	if (*pc == '\r') {
+		pc++;
+	}
+	if (*pc == '\n') {
+		pc++;
+	}
+	return pc;
+}
+
+// classify a line by its first characters, no copy
+static inline keyword_t Obj_Keyword(const char* pc) {
+	switch (pc[0]) {
+	case 'v':
+		if (Obj_IsBlank(pc[1])) {
+			return keyword_t::V;
+		}
+		if (pc[1] == 't' && Obj_IsBlank(pc[2])) {
+			return keyword_t::VT;
+		}
+		if (pc[1] == 'n' && Obj_IsBlank(pc[2])) {
+			return keyword_t::VN;
+		}
+		break;
+	case 'f':
+		if (Obj_IsBlank(pc[1])) {
+			return keyword_t::F;
+		}
+		break;
+	case 'u':
+		if (strncmp(pc, "usemtl", 6) == 0 && Obj_IsBlank(pc[6])) {
+			return keyword_t::USEMTL;
+		}
+		break;
+	case 'm':
+		if (strncmp(pc, "mtllib", 6) == 0 && Obj_IsBlank(pc[6])) {
+			return keyword_t::MTLLIB;
+		}
+		break;
+	}
+	return keyword_t::NONE;
+}
+
+static void Obj_CopyToken(const char* pc, char* s, int s_cap) {
+	pc = Obj_SkipBlank(pc);
+
+	int len = 0;
+	while (!Obj_IsBlank(*pc) && !Obj_IsEOL(*pc) && len < s_cap - 1) {
+		s[len++] = *pc++;
+	}
+	s[len] = 0;
+}
+
+// same result as atoi, stops at the first non digit character
+static inline int Obj_ParseInt(const char* pc) {
+	bool neg = false;
+	if (*pc == '-' || *pc == '+') {
+		neg = *pc == '-';
+		pc++;
+	}
+
+	int v = 0;
+	while (*pc >= '0' && *pc <= '9') {
+		v = v * 10 + (*pc - '0');
+		pc++;
+	}
+
+	return neg ? -v : v;
+}
+
+/*
+
+ fast path of decimal to float conversion (Clinger): if the decimal significand fits in
+ 53 bits and the power of ten is exactly representable (|e| <= 22), a single double
+ multiply/divide is correctly rounded, so the result matches (float)atof() bit for bit.
+ Anything else (long significands, big exponents, inf, nan, hex) falls back to strtod.
+
+ */
+static const double OBJ_POW10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static float Obj_ParseFloat(const char* s) {
+	const char* pc = s;
+
+	bool neg = false;
+	if (*pc == '-' || *pc == '+') {
+		neg = *pc == '-';
+		pc++;
+	}
+
+	uint64_t significand = 0;
+	int significand_digits = 0;
+	int exp10 = 0;
+	bool has_digits = false;
+
+	while (*pc >= '0' && *pc <= '9') {
+		if (significand || *pc != '0') {
+			significand = significand * 10 + (*pc - '0');
+			significand_digits++;
+		}
+		has_digits = true;
+		pc++;
+	}
+
+	if (*pc == '.') {
+		pc++;
+		while (*pc >= '0' && *pc <= '9') {
+			if (significand || *pc != '0') {
+				significand = significand * 10 + (*pc - '0');
+				significand_digits++;
+			}
+			exp10--;
+			has_digits = true;
+			pc++;
+		}
+	}
+
+	if (has_digits && (*pc == 'e' || *pc == 'E')) {
+		const char* pe = pc + 1;
+
+		bool exp_neg = false;
+		if (*pe == '-' || *pe == '+') {
+			exp_neg = *pe == '-';
+			pe++;
+		}
+
+		if (*pe >= '0' && *pe <= '9') {
+			int e = 0;
+			while (*pe >= '0' && *pe <= '9') {
+				if (e < 10000) {
+					e = e * 10 + (*pe - '0');
+				}
+				pe++;
+			}
+			exp10 += exp_neg ? -e : e;
+			pc = pe;
+		}
+	}
+
+	if (!has_digits || significand_digits > 19 || significand > (1ull << 53) ||
+		exp10 < -22 || exp10 > 22 || !(Obj_IsBlank(*pc) || Obj_IsEOL(*pc)))
+	{
+		return (float)strtod(s, nullptr);
+	}
+
+	double d = (double)significand;
+	if (exp10 < 0) {
+		d /= OBJ_POW10[-exp10];
+	}
+	else {
+		d *= OBJ_POW10[exp10];
+	}
+
+	return (float)(neg ? -d : d);
+}
+
+// parse count floats following the keyword, all zero if the line is short
+static void Obj_ParseFloats(const char* pc, float* v, int count) {
+	for (int i = 0; i < count; ++i) {
+		pc = Obj_SkipBlank(pc);
+		if (Obj_IsEOL(*pc)) {
+			memset(v, 0, sizeof(float) * count);
+			return;
+		}
+
+		v[i] = Obj_ParseFloat(pc);
+		pc = Obj_SkipToken(pc);
+	}
+}
+
 /*
 ================================================================================
 Obj
@@ -90,14 +286,55 @@ Obj::Obj():
 	materials_(nullptr),
 	material_count_(0)
 {
-	//
+	memset(&counts_, 0, sizeof(counts_));
 }
 
 Obj::~Obj() {
 	Clear();
 }
 
-bool Obj::Load(const char* filename) {
+/*
+
+ the text is split into chunks at line boundaries, each chunk is counted and parsed
+ independently, the serial loader is the single chunk case.
+
+ 1. count v/vt/vn/f/usemtl per chunk
+ 2. prefix sums of the counts give every chunk its write offsets into the shared arrays,
+    so faces and face groups come out in the same order as a single pass would write them
+ 3. parse the chunks, negative indices are resolved against base + local read count
+ 4. faces at the beginning of a chunk belong to the face group opened by a previous chunk,
+    they are added to that group after all chunks finished
+
+ */
+struct Obj::chunk_s {
+	const char *			begin_;
+	const char *			end_;
+
+	counts_s				counts_;				// statements in this chunk
+	uint32_t				leading_face_count_;	// faces before the first usemtl of this chunk
+	std::vector<const char*> mtllibs_;
+
+	// prefix sums of the preceding chunks
+	uint32_t				position_base_;
+	uint32_t				normal_base_;
+	uint32_t				uv_base_;
+	uint32_t				face_base_;
+	uint32_t				face_group_base_;
+	uint32_t				face_group_at_begin_;	// group active at the beginning, VK_INVALID_INDEX if none
+
+	// parse results
+	uint32_t				read_position_count_;
+	uint32_t				read_normal_count_;
+	uint32_t				read_uv_count_;
+	uint32_t				parsed_face_count_;
+	uint32_t				parsed_face_group_count_;
+	uint32_t				face_count_at_begin_;	// faces appended to face_group_at_begin_
+	const char *			error_;
+};
+
+static const int32_t		OBJ_MIN_CHUNK_SIZE = 1024 * 1024;
+
+bool Obj::Load(const char* filename, const counts_s* counts, uint32_t num_threads) {
 	Clear();
 
 	char* text = nullptr;
@@ -107,43 +344,71 @@ bool Obj::Load(const char* filename) {
 		return false;
 	}
 
-	Lexer lexer;
-	lexer.SetPtr(text);
+	if (!num_threads) {
+		num_threads = Thread_GetHardwareConcurrency();
+	}
 
-	// counting
-	const char* line = nullptr;
-	while (line = lexer.ReadLine()) {
-		if (strncmp(line, "mtllib ", 7) == 0) {
-			char mat_filename[256];
-			Line_ParseString(line, mat_filename);
+	uint32_t chunk_count = (uint32_t)(file_size / OBJ_MIN_CHUNK_SIZE);
+	if (chunk_count > num_threads) {
+		chunk_count = num_threads;
+	}
 
-			char filename_folder[MAX_PATH] = {};
-			Str_ExtractFileDir(filename, filename_folder, MAX_PATH);
+	if (chunk_count < 2) {
+		chunk_count = 1;
+	}
+	else {
+		counts = nullptr;	// per chunk counts are needed anyway
+	}
 
-			char full_mat_filename[MAX_PATH];
-			Str_SPrintf(full_mat_filename, MAX_PATH, "%s/%s", filename_folder, mat_filename);
+	std::vector<chunk_s> chunks(chunk_count);
 
-			if (!LoadMTL(full_mat_filename)) {
-				printf("Load mtl file failed\n");
-			}
-		}
-		else if (strncmp(line, "v ", 2) == 0) {
-			position_count_++;
-		}
-		else if (strncmp(line, "vt ", 3) == 0) {
-			uv_count_++;
-		}
-		else if (strncmp(line, "vn ", 3) == 0) {
-			normal_count_++;
+	const char* chunk_begin = text;
+	for (uint32_t i = 0; i < chunk_count; ++i) {
+		chunk_s& chunk = chunks[i];
+		memset(&chunk.counts_, 0, sizeof(chunk.counts_));
+		chunk.leading_face_count_ = 0;
+
+		chunk.begin_ = chunk_begin;
+		if (i + 1 == chunk_count) {
+			chunk.end_ = text + file_size;
 		}
-		else if (strncmp(line, "usemtl ", 7) == 0) {
-			face_group_count_++;
+		else {
+			const char* split = text + (int64_t)file_size * (i + 1) / chunk_count;
+			chunk.end_ = split > chunk_begin ? Obj_NextLine(split) : chunk_begin;
 		}
-		else if (strncmp(line, "f ", 2) == 0) {
-			face_count_++;
+		chunk_begin = chunk.end_;
+	}
+
+	// counting, skipped if the caller already knows the sizes
+	if (counts) {
+		counts_ = *counts;
+	}
+	else {
+		Thread_Run(chunk_count, [this, &chunks](uint32_t idx) {
+			CountChunk(chunks[idx]);
+		});
+
+		memset(&counts_, 0, sizeof(counts_));
+
+		for (chunk_s& chunk : chunks) {
+			for (const char* mtllib : chunk.mtllibs_) {
+				LoadMTLLib(filename, mtllib);
+			}
+
+			counts_.position_count_ += chunk.counts_.position_count_;
+			counts_.normal_count_ += chunk.counts_.normal_count_;
+			counts_.uv_count_ += chunk.counts_.uv_count_;
+			counts_.face_count_ += chunk.counts_.face_count_;
+			counts_.face_group_count_ += chunk.counts_.face_group_count_;
 		}
 	}
 
+	position_count_ = counts_.position_count_;
+	normal_count_ = counts_.normal_count_;
+	uv_count_ = counts_.uv_count_;
+	face_count_ = counts_.face_count_;
+	face_group_count_ = counts_.face_group_count_;
+
 	bool default_face_group = false;
 
 	if (!face_group_count_) {
@@ -151,146 +416,123 @@ bool Obj::Load(const char* filename) {
 		default_face_group = true;
 	}
 
-	if (!position_count_ || !face_count_ || !face_group_count_) {
+	if (!position_count_ || !face_count_) {
 		File_FreeText(text);
 		printf("Bad model\n");
 		return false;
 	}
-	else {
-		// allocate memory
-		positions_ = (glm::vec3*)TEMP_ALLOC(sizeof(glm::vec3) * position_count_);
-		if (!positions_) {
-			return false;
-		}
-		
-		if (normal_count_) {
-			normals_ = (glm::vec3*)TEMP_ALLOC(sizeof(glm::vec3) * normal_count_);
-			if (!normals_) {
-				return false;
-			}
-		}
 
-		if (uv_count_) {
-			uv_list_ = (glm::vec2*)TEMP_ALLOC(sizeof(glm::vec2) * uv_count_);
-			if (!uv_list_) {
-				return false;
-			}
-		}
-
-		faces_ = (face_s*)TEMP_ALLOC(sizeof(face_s) * face_count_);
-		if (!faces_) {
-			return false;
-		}
-
-		face_groups_ = (face_group_s*)TEMP_ALLOC(sizeof(face_group_s) * face_group_count_);
-		if (!face_groups_) {
-			return false;
-		}
+	// allocate memory
+	positions_ = (glm::vec3*)TEMP_ALLOC(sizeof(glm::vec3) * position_count_);
+	if (normal_count_) {
+		normals_ = (glm::vec3*)TEMP_ALLOC(sizeof(glm::vec3) * normal_count_);
+	}
+	if (uv_count_) {
+		uv_list_ = (glm::vec2*)TEMP_ALLOC(sizeof(glm::vec2) * uv_count_);
+	}
+	faces_ = (face_s*)TEMP_ALLOC(sizeof(face_s) * face_count_);
+	face_groups_ = (face_group_s*)TEMP_ALLOC(sizeof(face_group_s) * face_group_count_);
 
-		// read data
-		uint32_t read_position_idx = 0;
-		uint32_t read_normal_idx = 0;
-		uint32_t read_uv_idx = 0;
+	if (!positions_ || (normal_count_ && !normals_) || (uv_count_ && !uv_list_) ||
+		!faces_ || !face_groups_) {
+		File_FreeText(text);
+		Clear();
+		printf("Memory overflow\n");
+		return false;
+	}
 
-		uint32_t parsed_face_count = 0;
-		uint32_t parsed_face_group_count = 0;
+	if (default_face_group) {
+		face_group_s* fg = face_groups_;
 
-		face_group_s* cur_face_group = nullptr;
-		if (default_face_group) {
-			cur_face_group = face_groups_;
+		fg->name_[0] = 0;
+		fg->material_idx_ = VK_INVALID_INDEX;
+		fg->faces_ = faces_;
+		fg->face_count_ = 0;
+	}
 
-			cur_face_group->material_idx_ = (uint32_t)-1;
-			cur_face_group->faces_ = faces_ + parsed_face_count;
-			cur_face_group->face_count_ = 0;
+	// prefix sums
+	uint32_t position_base = 0;
+	uint32_t normal_base = 0;
+	uint32_t uv_base = 0;
+	uint32_t face_base = 0;
+	uint32_t face_group_base = default_face_group ? 1 : 0;
+
+	for (chunk_s& chunk : chunks) {
+		chunk.position_base_ = position_base;
+		chunk.normal_base_ = normal_base;
+		chunk.uv_base_ = uv_base;
+		chunk.face_base_ = face_base;
+		chunk.face_group_base_ = face_group_base;
+		chunk.face_group_at_begin_ = face_group_base ? face_group_base - 1 : VK_INVALID_INDEX;
+
+		position_base += chunk.counts_.position_count_;
+		normal_base += normal_count_ ? chunk.counts_.normal_count_ : 0;
+		uv_base += uv_count_ ? chunk.counts_.uv_count_ : 0;
+		face_group_base += chunk.counts_.face_group_count_;
+
+		// faces without a face group are skipped
+		face_base += chunk.counts_.face_count_;
+		if (chunk.face_group_at_begin_ == VK_INVALID_INDEX) {
+			face_base -= chunk.leading_face_count_;
 		}
+	}
 
-		void* t = this;
-
-		int read_lines = 0;
-		lexer.SetPtr(text);
-		while (line = lexer.ReadLine()) {
-			read_lines++;
-
-			if (this != t) {
-				int bk = 0;
-			}
-
-			if (strncmp(line, "v ", 2) == 0) {
-				Line_ParseVec3(line, positions_[read_position_idx++]);
-			}
-			else if (strncmp(line, "vn ", 3) == 0) {
-				if (normals_) {
-					Line_ParseVec3(line, normals_[read_normal_idx++]);
-				}
-			}
-			else if (strncmp(line, "vt ", 3) == 0) {
-				if (uv_list_) {
-					Line_ParseVec2(line, uv_list_[read_uv_idx++]);
-				}
-			}
-			/*else if (strncmp(line, "o ", 2) == 0) {
-				char obj_name[NAME_LEN];
-				Line_ParseString(line, obj_name);
-
-				cur_face_group = face_groups_ + parsed_face_group_count++;
-				Str_Copy(cur_face_group->name_, NAME_LEN, obj_name);
-				cur_face_group->material_idx_ = VK_INVALID_INDEX;
-				cur_face_group->face_count_ = 0;
-				cur_face_group->faces_ = faces_ + parsed_face_count;
-			}
-			*/
-			else if (strncmp(line, "usemtl ", 7) == 0) {
-				char mat_name[NAME_LEN];
-				Line_ParseString(line, mat_name);
+	// counting pass skipped, materials are loaded while parsing
+	const char* inline_mtllib_filename = counts ? filename : nullptr;
 
-				cur_face_group = face_groups_ + parsed_face_group_count++;
-				Str_Copy(cur_face_group->name_, NAME_LEN, mat_name);
-				cur_face_group->material_idx_ = VK_INVALID_INDEX;
-				cur_face_group->face_count_ = 0;
-				cur_face_group->faces_ = faces_ + parsed_face_count;
+	Thread_Run(chunk_count, [this, &chunks, inline_mtllib_filename, default_face_group](uint32_t idx) {
+		ParseChunk(chunks[idx], inline_mtllib_filename, default_face_group);
+	});
 
+	File_FreeText(text);
 
-				uint32_t mat_idx = GetMaterialIdxByName(mat_name);
-				if (mat_idx == VK_INVALID_INDEX) {
-					printf("Material %s not found\n", mat_name);
-				}
+	for (chunk_s& chunk : chunks) {
+		if (chunk.error_) {
+			Clear();
+			printf("%s\n", chunk.error_);
+			return false;
+		}
 
-				if (parsed_face_group_count) {
-					cur_face_group = &face_groups_[parsed_face_group_count - 1];
-					cur_face_group->material_idx_ = mat_idx;
-				}
-				else {
-					cur_face_group = face_groups_ + parsed_face_group_count++;
-					Str_Copy(cur_face_group->name_, NAME_LEN, mat_name);	// set as mat name
-					cur_face_group->material_idx_ = mat_idx;
-					cur_face_group->face_count_ = 0;
-					cur_face_group->faces_ = faces_ + parsed_face_count;
-				}
-			}
-			else if (strncmp(line, "f ", 2) == 0) {
-				if (!cur_face_group) {
-					continue; // ignore this face
-				}
+		if (chunk.face_count_at_begin_) {
+			face_groups_[chunk.face_group_at_begin_].face_count_ += chunk.face_count_at_begin_;
+		}
+	}
 
-				if (!ParseFace(line, read_position_idx, read_uv_idx, read_normal_idx,
-					faces_ + parsed_face_count++)) {
-					File_FreeText(text);
-					printf("Bad face\n");
-					return false;
-				}
+	if (counts) {
+		const chunk_s& chunk = chunks[0];
 
-				cur_face_group->face_count_++;
-			}
+		if (!chunk.read_position_count_ || !chunk.parsed_face_count_) {
+			Clear();
+			printf("Bad model\n");
+			return false;
 		}
 
-		File_FreeText(text);
-
-		if (!normals_) {
-			CalcNormals();
+		// the sizes passed in are capacities, shrink to what was actually read
+		counts_.position_count_ = chunk.read_position_count_;
+		counts_.normal_count_ = chunk.read_normal_count_;
+		counts_.uv_count_ = chunk.read_uv_count_;
+		counts_.face_count_ = chunk.parsed_face_count_;
+		counts_.face_group_count_ = chunk.parsed_face_group_count_;
+
+		position_count_ = chunk.read_position_count_;
+		normal_count_ = chunk.read_normal_count_;
+		uv_count_ = chunk.read_uv_count_;
+		face_count_ = chunk.parsed_face_count_;
+		face_group_count_ = chunk.parsed_face_group_count_ + (default_face_group ? 1 : 0);
+
+		if (!normal_count_) {
+			SAFE_FREE(normals_);
 		}
+		if (!uv_count_) {
+			SAFE_FREE(uv_list_);
+		}
+	}
 
-		return true;
+	if (!normals_) {
+		CalcNormals();
 	}
+
+	return true;
 }
 
 void Obj::Clear() {
@@ -307,6 +549,12 @@ void Obj::Clear() {
 	face_count_ = 0;
 	face_group_count_ = 0;
 	material_count_ = 0;
+
+	memset(&counts_, 0, sizeof(counts_));
+}
+
+void Obj::GetCounts(counts_s& counts) const {
+	counts = counts_;
 }
 
 const glm::vec3* Obj::GetPos() const {
@@ -493,39 +741,22 @@ bool Obj::LoadMTL(const char* filename) {
 	return true;
 }
 
-bool Obj::ParseFace(const char* line, uint32_t read_position_count,
+// pc points just past the "f" keyword, parsed in place
+bool Obj::ParseFace(const char* pc, uint32_t read_position_count,
 	uint32_t read_uv_count, uint32_t read_normal_count, face_s* face)
 {
-	char head[NAME_LEN];
-	char part1[NAME_LEN];
-	char part2[NAME_LEN];
-	char part3[NAME_LEN];
-	char part4[NAME_LEN];
-
-	char* parts[5] = { head, part1, part2, part3, part4 };
-
-	int tokens = Str_Tokenize(line, parts, NAME_LEN, 5);
-
-	int vertex_count = tokens - 1;
-	if (vertex_count != 3 && vertex_count != 4) {
-		return false;
-	}
-
-	face->vertex_count_ = vertex_count;
-
 	uint32_t read_counts[3] = { read_position_count, read_uv_count, read_normal_count };
 
-	for (int i = 0; i < vertex_count; ++i) {
-		char* str_indices[3] = {};
-
-		// vertex index/uv index/normal index
-		int item_count = Str_Split(parts[1 + i], '/', str_indices, 3);
+	int vertex_count = 0;
 
+	pc = Obj_SkipBlank(pc);
+	while (!Obj_IsEOL(*pc) && vertex_count < 4) {
 		uint32_t indices[3];
 		memset(indices, 0xff, sizeof(indices));
 
-		for (int j = 0; j < item_count; ++j) {
-			int idx = atoi(str_indices[j]);
+		// vertex index/uv index/normal index
+		for (int j = 0; j < 3; ++j) {
+			int idx = Obj_ParseInt(pc);
 
 			if (idx < 0) {
 				// negative indices: e.g. -1 references the last vertex defined
@@ -538,14 +769,33 @@ bool Obj::ParseFace(const char* line, uint32_t read_position_count,
 			else {
 				indices[j] = (uint32_t)idx;	// positive
 			}
+
+			while (!Obj_IsBlank(*pc) && !Obj_IsEOL(*pc) && *pc != '/') {
+				pc++;
+			}
+
+			if (*pc != '/') {
+				break;
+			}
+			pc++;
 		}
 
 		// -1 convert to [0~num-1]
-		face->vertices_[i].pos_idx_ = indices[0] - 1;
-		face->vertices_[i].uv_idx_ = indices[1] - 1;
-		face->vertices_[i].normal_idx_ = indices[2] - 1;
+		face->vertices_[vertex_count].pos_idx_ = indices[0] - 1;
+		face->vertices_[vertex_count].uv_idx_ = indices[1] - 1;
+		face->vertices_[vertex_count].normal_idx_ = indices[2] - 1;
+		vertex_count++;
+
+		pc = Obj_SkipBlank(Obj_SkipToken(pc));
 	}
 
+	// polygons with more than 4 vertices are truncated to the first 4
+	if (vertex_count != 3 && vertex_count != 4) {
+		return false;
+	}
+
+	face->vertex_count_ = vertex_count;
+
 	// fill rest to invalid index
 	for (uint32_t i = face->vertex_count_; i < 4; ++i) {
 		face->vertices_[i].pos_idx_ = VK_INVALID_INDEX;
@@ -556,6 +806,167 @@ bool Obj::ParseFace(const char* line, uint32_t read_position_count,
 	return true;
 }
 
+void Obj::LoadMTLLib(const char* obj_filename, const char* pc) {
+	char mat_filename[NAME_LEN];
+	Obj_CopyToken(pc + 6, mat_filename, NAME_LEN);	// skip "mtllib"
+
+	char filename_folder[MAX_PATH] = {};
+	Str_ExtractFileDir(obj_filename, filename_folder, MAX_PATH);
+
+	char full_mat_filename[MAX_PATH];
+	Str_SPrintf(full_mat_filename, MAX_PATH, "%s/%s", filename_folder, mat_filename);
+
+	if (!LoadMTL(full_mat_filename)) {
+		printf("Load mtl file failed\n");
+	}
+}
+
+void Obj::CountChunk(chunk_s& chunk) const {
+	counts_s& counts = chunk.counts_;
+
+	const char* pc = chunk.begin_;
+	while (pc < chunk.end_ && *pc) {
+		switch (Obj_Keyword(pc)) {
+		case keyword_t::MTLLIB:
+			chunk.mtllibs_.push_back(pc);
+			break;
+		case keyword_t::V:
+			counts.position_count_++;
+			break;
+		case keyword_t::VT:
+			counts.uv_count_++;
+			break;
+		case keyword_t::VN:
+			counts.normal_count_++;
+			break;
+		case keyword_t::USEMTL:
+			counts.face_group_count_++;
+			break;
+		case keyword_t::F:
+			counts.face_count_++;
+			if (!counts.face_group_count_) {
+				chunk.leading_face_count_++;
+			}
+			break;
+		default:
+			break;
+		}
+
+		pc = Obj_NextLine(pc);
+	}
+}
+
+void Obj::ParseChunk(chunk_s& chunk, const char* inline_mtllib_filename, bool default_face_group) {
+	uint32_t read_position_idx = chunk.position_base_;
+	uint32_t read_normal_idx = chunk.normal_base_;
+	uint32_t read_uv_idx = chunk.uv_base_;
+
+	uint32_t parsed_face_count = chunk.face_base_;
+	uint32_t parsed_face_group_count = chunk.face_group_base_;
+
+	uint32_t face_count_at_begin = 0;
+
+	face_group_s* face_group_at_begin = chunk.face_group_at_begin_ != VK_INVALID_INDEX ?
+		face_groups_ + chunk.face_group_at_begin_ : nullptr;
+	face_group_s* cur_face_group = face_group_at_begin;
+
+	const char* error = nullptr;
+
+	const char* pc = chunk.begin_;
+	while (pc < chunk.end_ && *pc && !error) {
+		switch (Obj_Keyword(pc)) {
+		case keyword_t::MTLLIB:
+			if (inline_mtllib_filename) {
+				LoadMTLLib(inline_mtllib_filename, pc);
+			}
+			break;
+		case keyword_t::V:
+			if (read_position_idx >= position_count_) {
+				error = "Too many positions";
+				break;
+			}
+			Obj_ParseFloats(pc + 1, &positions_[read_position_idx++].x, 3);
+			break;
+		case keyword_t::VN:
+			if (normals_) {
+				if (read_normal_idx >= normal_count_) {
+					error = "Too many normals";
+					break;
+				}
+				Obj_ParseFloats(pc + 2, &normals_[read_normal_idx++].x, 3);
+			}
+			break;
+		case keyword_t::VT:
+			if (uv_list_) {
+				if (read_uv_idx >= uv_count_) {
+					error = "Too many uvs";
+					break;
+				}
+				Obj_ParseFloats(pc + 2, &uv_list_[read_uv_idx++].x, 2);
+			}
+			break;
+		case keyword_t::USEMTL:
+			{
+				if (default_face_group || parsed_face_group_count >= face_group_count_) {
+					error = "Too many face groups";
+					break;
+				}
+
+				char mat_name[NAME_LEN];
+				Obj_CopyToken(pc + 6, mat_name, NAME_LEN);
+
+				uint32_t mat_idx = GetMaterialIdxByName(mat_name);
+				if (mat_idx == VK_INVALID_INDEX) {
+					printf("Material %s not found\n", mat_name);
+				}
+
+				cur_face_group = face_groups_ + parsed_face_group_count++;
+				Str_Copy(cur_face_group->name_, NAME_LEN, mat_name);
+				cur_face_group->material_idx_ = mat_idx;
+				cur_face_group->face_count_ = 0;
+				cur_face_group->faces_ = faces_ + parsed_face_count;
+			}
+			break;
+		case keyword_t::F:
+			if (!cur_face_group) {
+				break; // ignore this face
+			}
+
+			if (parsed_face_count >= face_count_) {
+				error = "Too many faces";
+				break;
+			}
+
+			if (!ParseFace(pc + 1, read_position_idx, read_uv_idx, read_normal_idx,
+				faces_ + parsed_face_count++)) {
+				error = "Bad face";
+				break;
+			}
+
+			// the group opened by a previous chunk is updated after all chunks finished
+			if (cur_face_group == face_group_at_begin) {
+				face_count_at_begin++;
+			}
+			else {
+				cur_face_group->face_count_++;
+			}
+			break;
+		default:
+			break;
+		}
+
+		pc = Obj_NextLine(pc);
+	}
+
+	chunk.read_position_count_ = read_position_idx - chunk.position_base_;
+	chunk.read_normal_count_ = read_normal_idx - chunk.normal_base_;
+	chunk.read_uv_count_ = read_uv_idx - chunk.uv_base_;
+	chunk.parsed_face_count_ = parsed_face_count - chunk.face_base_;
+	chunk.parsed_face_group_count_ = parsed_face_group_count - chunk.face_group_base_;
+	chunk.face_count_at_begin_ = face_count_at_begin;
+	chunk.error_ = error;
+}
+
 uint32_t Obj::GetMaterialIdxByName(const char* mat_name) const {
 	for (uint32_t i = 0; i < material_count_; ++i) {
 		if (!strcmp(mat_name, materials_[i].name_)) {
@@ -46,12 +46,26 @@ public:
 		float				alpha_;				// transparency
 	};
 
+	// number of statements in the file, as found by the counting pass
+	struct counts_s {
+		uint32_t			position_count_;	// v
+		uint32_t			normal_count_;		// vn
+		uint32_t			uv_count_;			// vt
+		uint32_t			face_count_;		// f
+		uint32_t			face_group_count_;	// usemtl
+	};
+
 	Obj();
 	~Obj();
 
-	bool					Load(const char* filename);
+	// counts: if not null, the counting pass is skipped and these are used as capacities
+	// num_threads: 0 = hardware concurrency, the result is identical to the serial loader,
+	//   counts are ignored when the file is parsed by more than one thread
+	bool					Load(const char* filename, const counts_s* counts = nullptr, uint32_t num_threads = 1);
 	void					Clear();
 
+	void					GetCounts(counts_s& counts) const;
+
 	const glm::vec3*		GetPos() const;
 	uint32_t				NumberPos() const;
 
@@ -87,8 +101,15 @@ private:
 	material_s *			materials_;
 	uint32_t				material_count_;
 
+	counts_s				counts_;
+
+	struct chunk_s;
+
 	bool					LoadMTL(const char * filename);
-	bool					ParseFace(const char * line, uint32_t read_vertex_count, 
+	void					LoadMTLLib(const char * obj_filename, const char * pc);
+	void					CountChunk(chunk_s & chunk) const;
+	void					ParseChunk(chunk_s & chunk, const char * inline_mtllib_filename, bool default_face_group);
+	bool					ParseFace(const char * pc, uint32_t read_vertex_count, 
 								uint32_t read_uv_count, uint32_t read_normal_count, face_s * face);
 
 	uint32_t				GetMaterialIdxByName(const char * mat_name) const;
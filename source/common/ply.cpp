@@ -4,17 +4,148 @@
 
 #include "inc.h"
 
+/*
+================================================================================
+binary decode helpers
+================================================================================
+*/
+
+// vertices decoded together, the block of source data stays in cache across the properties
+static const uint32_t PLY_DECODE_BLOCK = 4096;
+
+template<typename T, bool SWAP>
+static inline T Ply_Load(const uint8_t* p) {
+	T v;
+	if constexpr (SWAP) {
+		uint8_t b[sizeof(T)];
+		for (size_t k = 0; k < sizeof(T); ++k) {
+			b[k] = p[sizeof(T) - 1 - k];
+		}
+		memcpy(&v, b, sizeof(T));
+	}
+	else {
+		memcpy(&v, p, sizeof(T));
+	}
+	return v;
+}
+
+template<typename T>
+static inline T Ply_Read(const uint8_t* p, bool need_swap) {
+	return need_swap ? Ply_Load<T, true>(p) : Ply_Load<T, false>(p);
+}
+
+// dst[i * dst_stride] = value of the property of vertex i / divisor
+typedef void (*ply_decode_func_t)(const uint8_t* src, uint32_t src_stride, uint32_t count,
+	float* dst, uint32_t dst_stride, float divisor);
+
+template<typename T, bool SWAP>
+static void Ply_DecodeColumn(const uint8_t* src, uint32_t src_stride, uint32_t count,
+	float* dst, uint32_t dst_stride, float divisor)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		dst[(size_t)i * dst_stride] = (float)Ply_Load<T, SWAP>(src + (size_t)i * src_stride) / divisor;
+	}
+}
+
+// destination components: 0 ~ 2 position, 3 ~ 5 normal, 6 ~ 9 color
+static const uint32_t PLY_NUM_CHANNEL = 10;
+
+static float* Ply_Channel(uint32_t channel, glm::vec3* positions, glm::vec3* normals, glm::vec4* colors,
+	uint32_t& stride)
+{
+	if (channel < 3) {
+		stride = 3;
+		return (float*)positions + channel;
+	}
+	else if (channel < 6) {
+		stride = 3;
+		return (float*)normals + (channel - 3);
+	}
+	else {
+		stride = 4;
+		return (float*)colors + (channel - 6);
+	}
+}
+
+// faces of the common "list uchar int vertex_indices" layout
+template<bool SWAP>
+static bool Ply_DecodeFaces(const uint8_t*& src, const uint8_t* end, uint32_t num_face, uint32_t num_vertex,
+	uint32_t* indices, uint32_t& num_triangles)
+{
+	const uint8_t* p = src;
+	uint32_t* out = indices;
+
+	for (uint32_t i = 0; i < num_face; ++i) {
+		if (p >= end) {
+			printf("Read buffer failed\n");
+			return false;
+		}
+
+		uint32_t num_vertex_of_face = *p++;
+
+		if (num_vertex_of_face != 3 && num_vertex_of_face != 4) {
+			printf("Unsupported face vertex count: %u\n", num_vertex_of_face);
+			return false;
+		}
+
+		if ((size_t)(end - p) < num_vertex_of_face * sizeof(uint32_t)) {
+			printf("Read buffer failed\n");
+			return false;
+		}
+
+		uint32_t idx[4];
+		for (uint32_t j = 0; j < num_vertex_of_face; ++j) {
+			idx[j] = Ply_Load<uint32_t, SWAP>(p + j * sizeof(uint32_t));
+			if (idx[j] >= num_vertex) {
+				printf("Invalid vertex index has been found\n");
+				return false;
+			}
+		}
+		p += num_vertex_of_face * sizeof(uint32_t);
+
+		out[0] = idx[0];
+		out[1] = idx[1];
+		out[2] = idx[2];
+
+		if (num_vertex_of_face == 4) {
+			out[3] = idx[2];
+			out[4] = idx[3];
+			out[5] = idx[0];
+			out += 6;
+		}
+		else {
+			out += 3;
+		}
+	}
+
+	src = p;
+	num_triangles = (uint32_t)((out - indices) / 3);
+
+	return true;
+}
+
 /*
 ================================================================================
 PLY
 ================================================================================
 */
+
+struct PLY::decode_op_s {
+	ply_decode_func_t		decode_;
+	uint32_t				src_offset_;	// in bytes from the start of the vertex
+	uint32_t				channel_;
+	float *					dst_;			// component of vertex 0
+	uint32_t				dst_stride_;	// in floats
+	float					divisor_;
+};
+
 PLY::PLY() :
 	buf_(nullptr),
 	cur_read_pos_(nullptr),
 	buf_end_(nullptr),
 	format_(file_format_t::ASCII),
 	num_property_(0),
+	num_face_property_(0),
 	positions_(nullptr),
 	normals_(nullptr),
 	uv_lst_(nullptr),
@@ -35,7 +166,7 @@ PLY::~PLY() {
 	Clear();
 }
 
-bool PLY::Load(const char* filename) {
+bool PLY::Load(const char* filename, bool use_decode_plan) {
 	Clear();
 
 	int32_t file_size = 0;
@@ -52,7 +183,7 @@ bool PLY::Load(const char* filename) {
 		return false;
 	}
 
-	if (!LoadData()) {
+	if (!LoadData(use_decode_plan)) {
 		return false;
 	}
 
@@ -73,6 +204,8 @@ void PLY::Clear() {
 	num_triangles_ = num_face_ = num_index_ = num_vertex_ = 0;
 
 	num_property_ = 0;
+	num_face_property_ = 0;
+	has_normal_ = has_tex_coord_ = has_color_ = false;
 
 	if (buf_) {
 		File_FreeText(buf_);
@@ -200,6 +333,10 @@ bool PLY::LoadHead() {
 		return false;
 	}
 
+	if (!LoadFaceProperties()) {
+		return false;
+	}
+
 	if (!CheckHeadEnd()) {
 		return false;
 	}
@@ -207,7 +344,7 @@ bool PLY::LoadHead() {
 	return true;
 }
 
-bool PLY::LoadData() {
+bool PLY::LoadData(bool use_decode_plan) {
 	if (num_vertex_ == 0 || num_face_ == 0) {
 		printf("bad vertex number or face number\n");
 		return false;
@@ -228,7 +365,7 @@ bool PLY::LoadData() {
 		return LoadData_ASCII();
 	}
 	else {
-		return LoadData_BINARY();
+		return LoadData_BINARY(use_decode_plan);
 	}
 }
 
@@ -247,18 +384,26 @@ bool PLY::LoadData_ASCII() {
 				return false;
 			}
 
+			if (properties_[p].is_list_) {
+				int count = atoi(token);
+				for (int j = 0; j < count; ++j) {
+					if (!Reader_GetToken()) {
+						return false;
+					}
+				}
+				continue;
+			}
+
 			float value = 0.0f;
 
 			switch (properties_[p].type_) {
-			case property_type_t::FLOAT:
+			case property_type_t::FLOAT32:
+			case property_type_t::FLOAT64:
 				value = (float)atof(token);
 				break;
-			case property_type_t::UINT8:
-				value = atoi(token) / 255.0f;
-				break;
 			default:
-				printf("Unsupported data type: %d\n", properties_[p].type_);
-				return false;
+				value = (float)strtoll(token, nullptr, 10) / TypeDivisor(properties_[p]);
+				break;
 			}
 
 			switch (properties_[p].name_) {
@@ -292,6 +437,8 @@ bool PLY::LoadData_ASCII() {
 			case property_name_t::ALPHA:
 				a = value;
 				break;
+			default:
+				break;
 			}
 		}
 
@@ -378,70 +525,191 @@ bool PLY::LoadData_ASCII() {
 	return true;
 }
 
-bool PLY::LoadData_BINARY() {
+bool PLY::LoadData_BINARY(bool use_decode_plan) {
 	bool local_platform_is_big_endian = IsBigEndian();
 
 	bool need_swap = (local_platform_is_big_endian && format_ == file_format_t::BINARY_LIT)
 		|| (!local_platform_is_big_endian && format_ == file_format_t::BINARY_BIG);
 
-	cur_read_pos_++;	// skip '\n'
+	// the token reader consumed the character after end_header, skip the '\n' of "\r\n"
+	if (cur_read_pos_[-1] == '\r' && cur_read_pos_ < buf_end_ && *cur_read_pos_ == '\n') {
+		cur_read_pos_++;
+	}
 
 	if (cur_read_pos_ >= buf_end_) {
 		printf("reached end\n");
 		return false;
 	}
 
-	// read vertices
+	bool vertices_ok = use_decode_plan ? LoadVertices_Plan(need_swap) : LoadVertices_Reference(need_swap);
+	if (!vertices_ok) {
+		return false;
+	}
+
+	return LoadFaces_BINARY(need_swap);
+}
+
+bool PLY::CompileVertexPlan(bool need_swap, std::vector<decode_op_s>& ops, uint32_t& stride) {
+	ops.clear();
+	stride = 0;
+
+	for (uint32_t p = 0; p < num_property_; ++p) {
+		const property_s& prop = properties_[p];
+
+		if (prop.is_list_) {
+			return false;	// variable stride
+		}
+
+		decode_op_s op = {};
+		op.src_offset_ = stride;
+		op.divisor_ = TypeDivisor(prop);
+
+		stride += TypeSize(prop.type_);
 
+		switch (prop.name_) {
+		case property_name_t::POS_X:
+		case property_name_t::POS_Y:
+		case property_name_t::POS_Z:
+		case property_name_t::NORMAL_X:
+		case property_name_t::NORMAL_Y:
+		case property_name_t::NORMAL_Z:
+			op.channel_ = (uint32_t)prop.name_ - (uint32_t)property_name_t::POS_X;
+			break;
+		case property_name_t::RED:
+		case property_name_t::GREEN:
+		case property_name_t::BLUE:
+		case property_name_t::ALPHA:
+			if (!colors_) {
+				continue;
+			}
+			op.channel_ = 6 + (uint32_t)prop.name_ - (uint32_t)property_name_t::RED;
+			break;
+		default:
+			continue;	// skipped
+		}
+
+		op.dst_ = Ply_Channel(op.channel_, positions_, normals_, colors_, op.dst_stride_);
+
+		switch (prop.type_) {
+		case property_type_t::INT8:
+			op.decode_ = Ply_DecodeColumn<int8_t, false>;
+			break;
+		case property_type_t::UINT8:
+			op.decode_ = Ply_DecodeColumn<uint8_t, false>;
+			break;
+		case property_type_t::INT16:
+			op.decode_ = need_swap ? Ply_DecodeColumn<int16_t, true> : Ply_DecodeColumn<int16_t, false>;
+			break;
+		case property_type_t::UINT16:
+			op.decode_ = need_swap ? Ply_DecodeColumn<uint16_t, true> : Ply_DecodeColumn<uint16_t, false>;
+			break;
+		case property_type_t::INT32:
+			op.decode_ = need_swap ? Ply_DecodeColumn<int32_t, true> : Ply_DecodeColumn<int32_t, false>;
+			break;
+		case property_type_t::UINT32:
+			op.decode_ = need_swap ? Ply_DecodeColumn<uint32_t, true> : Ply_DecodeColumn<uint32_t, false>;
+			break;
+		case property_type_t::FLOAT32:
+			op.decode_ = need_swap ? Ply_DecodeColumn<float, true> : Ply_DecodeColumn<float, false>;
+			break;
+		case property_type_t::FLOAT64:
+			op.decode_ = need_swap ? Ply_DecodeColumn<double, true> : Ply_DecodeColumn<double, false>;
+			break;
+		}
+
+		ops.push_back(op);
+	}
+
+	return true;
+}
+
+bool PLY::LoadVertices_Plan(bool need_swap) {
+	std::vector<decode_op_s> ops;
+	uint32_t stride = 0;
+
+	if (!CompileVertexPlan(need_swap, ops, stride)) {
+		return LoadVertices_Reference(need_swap);
+	}
+
+	size_t vertices_size = (size_t)stride * num_vertex_;
+	if (vertices_size > (size_t)(buf_end_ - cur_read_pos_)) {
+		printf("read buffer failed\n");
+		return false;
+	}
+
+	// defaults of the components no property writes, as the reference path
+	bool covered[PLY_NUM_CHANNEL] = {};
+	for (const decode_op_s& op : ops) {
+		covered[op.channel_] = true;
+	}
+
+	for (uint32_t k = 0; k < PLY_NUM_CHANNEL; ++k) {
+		if (covered[k] || (k >= 3 && k < 6 && !has_normal_) || (k >= 6 && !colors_)) {
+			continue;	// normals are calculated later if the file has none
+		}
+
+		uint32_t dst_stride = 0;
+		float* dst = Ply_Channel(k, positions_, normals_, colors_, dst_stride);
+		float value = (k == 5) ? 1.0f : 0.0f;	// nz
+
+		for (uint32_t i = 0; i < num_vertex_; ++i) {
+			dst[(size_t)i * dst_stride] = value;
+		}
+	}
+
+	const uint8_t* src = (const uint8_t*)cur_read_pos_;
+
+	for (uint32_t first = 0; first < num_vertex_; first += PLY_DECODE_BLOCK) {
+		uint32_t count = num_vertex_ - first < PLY_DECODE_BLOCK ? num_vertex_ - first : PLY_DECODE_BLOCK;
+		const uint8_t* block = src + (size_t)stride * first;
+
+		for (const decode_op_s& op : ops) {
+			op.decode_(block + op.src_offset_, stride, count,
+				op.dst_ + (size_t)op.dst_stride_ * first, op.dst_stride_, op.divisor_);
+		}
+	}
+
+	cur_read_pos_ += vertices_size;
+
+	return true;
+}
+
+bool PLY::LoadVertices_Reference(bool need_swap) {
 	for (uint32_t i = 0; i < num_vertex_; ++i) {
 		float x = 0.0f, y = 0.0f, z = 0.0f;
 		float nx = 0.0f, ny = 0.0f, nz = 1.0f;
 		float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f; // color if any
 
 		for (uint32_t p = 0; p < num_property_; ++p) {
-			float value = 0.0f;
-
-			switch (properties_[p].type_) {
-			case property_type_t::FLOAT:
-			{
-				unsigned char buffer1[4], buffer2[4];
+			const property_s& prop = properties_[p];
+			uint8_t buffer[8];
 
-				if (!Reader_Read(buffer1, 4)) {
+			if (prop.is_list_) {
+				if (!Reader_Read(buffer, TypeSize(prop.count_type_))) {
 					printf("read buffer failed\n");
 					return false;
 				}
 
-				if (need_swap) {
-					buffer2[0] = buffer1[3];
-					buffer2[1] = buffer1[2];
-					buffer2[2] = buffer1[1];
-					buffer2[3] = buffer1[0];
-
-					value = *(const float*)buffer2;
-				}
-				else {
-					value = *(const float*)buffer1;
-				}
-			}
-			break;
-			case property_type_t::UINT8:
-			{
-				unsigned char buffer;
+				int64_t count = ReadInteger(buffer, prop.count_type_, need_swap);
+				int64_t list_size = count * TypeSize(prop.type_);
 
-				if (!Reader_Read(&buffer, 1)) {
+				if (count < 0 || list_size > buf_end_ - cur_read_pos_) {
 					printf("read buffer failed\n");
 					return false;
 				}
 
-				value = buffer / 255.0f;
+				cur_read_pos_ += list_size;
+				continue;
 			}
-			break;
-			default:
-				printf("Unsupported data type: %d\n", properties_[p].type_);
+
+			if (!Reader_Read(buffer, TypeSize(prop.type_))) {
+				printf("read buffer failed\n");
 				return false;
 			}
 
-			switch (properties_[p].name_) {
+			float value = (float)ReadValue(buffer, prop.type_, need_swap) / TypeDivisor(prop);
+
+			switch (prop.name_) {
 			case property_name_t::POS_X:
 				x = value;
 				break;
@@ -472,6 +740,8 @@ bool PLY::LoadData_BINARY() {
 			case property_name_t::ALPHA:
 				a = value;
 				break;
+			default:
+				break;
 			}
 		}
 
@@ -491,89 +761,98 @@ bool PLY::LoadData_BINARY() {
 		}
 	}
 
-	// read faces
+	return true;
+}
 
+bool PLY::LoadFaces_BINARY(bool need_swap) {
 	num_triangles_ = 0;
 
-	for (uint32_t i = 0; i < num_face_; ++i) {
-
-		unsigned char num_vertex_of_face;
-
-		if (!Reader_Read(&num_vertex_of_face, 1)) {
-			printf("Read buffer failed\n");
-			return false;
-		}
-
-		if (num_vertex_of_face == 3) {
+	// files without face properties in the header use the usual layout
+	if (num_face_property_ == 0) {
+		face_properties_[0] = { property_type_t::INT32, property_name_t::VERTEX_INDICES, true, property_type_t::UINT8 };
+		num_face_property_ = 1;
+	}
 
-			for (uint32_t j = 0; j < 3; ++j) {
-				unsigned char buffer1[4], buffer2[4];
+	const property_s& first = face_properties_[0];
+	if (num_face_property_ == 1 && first.is_list_ && first.name_ == property_name_t::VERTEX_INDICES
+		&& first.count_type_ == property_type_t::UINT8
+		&& (first.type_ == property_type_t::INT32 || first.type_ == property_type_t::UINT32))
+	{
+		const uint8_t* src = (const uint8_t*)cur_read_pos_;
+		bool ok = need_swap
+			? Ply_DecodeFaces<true>(src, (const uint8_t*)buf_end_, num_face_, num_vertex_, indices_, num_triangles_)
+			: Ply_DecodeFaces<false>(src, (const uint8_t*)buf_end_, num_face_, num_vertex_, indices_, num_triangles_);
+		cur_read_pos_ = (char*)src;
+		return ok;
+	}
 
-				if (!Reader_Read(buffer1, 4)) {
-					printf("Read buffer failed\n");
-					return false;
-				}
+	bool has_indices = false;
+	for (uint32_t p = 0; p < num_face_property_; ++p) {
+		has_indices = has_indices || (face_properties_[p].is_list_ && face_properties_[p].name_ == property_name_t::VERTEX_INDICES);
+	}
 
-				uint32_t index = 0;
+	if (!has_indices) {
+		printf("No vertex_indices in face element\n");
+		return false;
+	}
 
-				if (need_swap) {
-					buffer2[0] = buffer1[3];
-					buffer2[1] = buffer1[2];
-					buffer2[2] = buffer1[1];
-					buffer2[3] = buffer1[0];
+	for (uint32_t i = 0; i < num_face_; ++i) {
+		uint32_t indices_buf[4];
+		uint32_t num_vertex_of_face = 0;
 
-					index = *(uint32_t*)buffer2;
-				}
-				else {
-					index = *(uint32_t*)buffer1;
-				}
+		for (uint32_t p = 0; p < num_face_property_; ++p) {
+			const property_s& prop = face_properties_[p];
+			uint8_t buffer[8];
 
-				if (index >= num_vertex_) {
-					printf("Invalid vertex index has been found\n");
+			if (!prop.is_list_) {
+				if (!Reader_Read(buffer, TypeSize(prop.type_))) {
+					printf("Read buffer failed\n");
 					return false;
 				}
+				continue;
+			}
 
-				indices_[num_triangles_ * 3 + j] = index;
+			if (!Reader_Read(buffer, TypeSize(prop.count_type_))) {
+				printf("Read buffer failed\n");
+				return false;
 			}
 
-			num_triangles_++;
-		}
-		else if (num_vertex_of_face == 4) {
-			uint32_t indices_buf[4];
+			int64_t count = ReadInteger(buffer, prop.count_type_, need_swap);
+			uint32_t item_size = TypeSize(prop.type_);
 
-			for (uint32_t j = 0; j < 4; ++j) {
-				unsigned char buffer1[4], buffer2[4];
+			if (count < 0 || count * item_size > buf_end_ - cur_read_pos_) {
+				printf("Read buffer failed\n");
+				return false;
+			}
 
-				if (!Reader_Read(buffer1, 4)) {
-					printf("Read buffer failed\n");
+			if (prop.name_ == property_name_t::VERTEX_INDICES) {
+				if (count != 3 && count != 4) {
+					printf("Unsupported face vertex count: %u\n", (uint32_t)count);
 					return false;
 				}
 
-				uint32_t index = 0;
+				num_vertex_of_face = (uint32_t)count;
 
-				if (need_swap) {
-					buffer2[0] = buffer1[3];
-					buffer2[1] = buffer1[2];
-					buffer2[2] = buffer1[1];
-					buffer2[3] = buffer1[0];
+				for (uint32_t j = 0; j < num_vertex_of_face; ++j) {
+					int64_t index = ReadInteger((const uint8_t*)cur_read_pos_ + j * item_size, prop.type_, need_swap);
 
-					index = *(uint32_t*)buffer2;
-				}
-				else {
-					index = *(uint32_t*)buffer1;
-				}
+					if (index < 0 || index >= num_vertex_) {
+						printf("Invalid vertex index has been found\n");
+						return false;
+					}
 
-				if (index >= num_vertex_) {
-					printf("Invalid vertex index has been found\n");
-					return false;
+					indices_buf[j] = (uint32_t)index;
 				}
-
-				indices_buf[j] = index;
 			}
 
-			indices_[num_triangles_ * 3] = indices_buf[0];
-			indices_[num_triangles_ * 3 + 1] = indices_buf[1];
-			indices_[num_triangles_ * 3 + 2] = indices_buf[2];
+			cur_read_pos_ += count * item_size;
+		}
+
+		indices_[num_triangles_ * 3] = indices_buf[0];
+		indices_[num_triangles_ * 3 + 1] = indices_buf[1];
+		indices_[num_triangles_ * 3 + 2] = indices_buf[2];
+
+		if (num_vertex_of_face == 4) {
 			indices_[num_triangles_ * 3 + 3] = indices_buf[2];
 			indices_[num_triangles_ * 3 + 4] = indices_buf[3];
 			indices_[num_triangles_ * 3 + 5] = indices_buf[0];
@@ -581,10 +860,8 @@ bool PLY::LoadData_BINARY() {
 			num_triangles_ += 2;
 		}
 		else {
-			printf("Unsupported face vertex count: %u\n", num_vertex_of_face);
-			return false;
+			num_triangles_++;
 		}
-
 	}
 
 	return true;
@@ -681,101 +958,248 @@ bool PLY::LoadVertexCount() {
 	return true;
 }
 
-bool PLY::LoadProperties() {
-	// load properties
-	if (!Reader_FindToken("property")) {
-		printf("Could not find property section\n");
+bool PLY::ParseType(const char* token, property_type_t& type) {
+	if (!strcmp(token, "int8") || !strcmp(token, "char")) {
+		type = property_type_t::INT8;
+	}
+	else if (!strcmp(token, "uint8") || !strcmp(token, "uchar")) {
+		type = property_type_t::UINT8;
+	}
+	else if (!strcmp(token, "int16") || !strcmp(token, "short")) {
+		type = property_type_t::INT16;
+	}
+	else if (!strcmp(token, "uint16") || !strcmp(token, "ushort")) {
+		type = property_type_t::UINT16;
+	}
+	else if (!strcmp(token, "int32") || !strcmp(token, "int")) {
+		type = property_type_t::INT32;
+	}
+	else if (!strcmp(token, "uint32") || !strcmp(token, "uint")) {
+		type = property_type_t::UINT32;
+	}
+	else if (!strcmp(token, "float32") || !strcmp(token, "float")) {
+		type = property_type_t::FLOAT32;
+	}
+	else if (!strcmp(token, "float64") || !strcmp(token, "double")) {
+		type = property_type_t::FLOAT64;
+	}
+	else {
 		return false;
 	}
+	return true;
+}
 
-	const char* token = nullptr;
-	do {
-		if (num_property_ == MAX_PROPERTY) {
-			printf("Too many properties\n");
-			return false;
-		}
+uint32_t PLY::TypeSize(property_type_t type) {
+	switch (type) {
+	case property_type_t::INT8:
+	case property_type_t::UINT8:
+		return 1;
+	case property_type_t::INT16:
+	case property_type_t::UINT16:
+		return 2;
+	case property_type_t::INT32:
+	case property_type_t::UINT32:
+	case property_type_t::FLOAT32:
+		return 4;
+	default:
+		return 8;
+	}
+}
 
-		property_s* prop = properties_ + num_property_++;
+// uchar is normalized to [0, 1] for every property, other integer types for colors only
+float PLY::TypeDivisor(const property_s& prop) {
+	bool is_color = prop.name_ == property_name_t::RED
+		|| prop.name_ == property_name_t::GREEN
+		|| prop.name_ == property_name_t::BLUE
+		|| prop.name_ == property_name_t::ALPHA;
 
-		// get property type
-		token = Reader_GetToken();
-		if (!token) {
-			printf("Could not get token\n");
-			return false;
-		}
+	if (prop.type_ == property_type_t::UINT8) {
+		return 255.0f;
+	}
 
-		if (!strcmp(token, "float32") || !strcmp(token, "float")) {
-			prop->type_ = property_type_t::FLOAT;
-		}
-		else if (!strcmp(token, "uint8") || !strcmp(token, "uchar")) {
-			prop->type_ = property_type_t::UINT8;
-		}
-		else {
-			printf("Unsupported type: %s\n", token);
+	if (!is_color) {
+		return 1.0f;
+	}
+
+	switch (prop.type_) {
+	case property_type_t::INT8:
+		return 127.0f;
+	case property_type_t::INT16:
+		return 32767.0f;
+	case property_type_t::UINT16:
+		return 65535.0f;
+	case property_type_t::INT32:
+		return 2147483647.0f;
+	case property_type_t::UINT32:
+		return 4294967295.0f;
+	default:
+		return 1.0f;
+	}
+}
+
+double PLY::ReadValue(const uint8_t* p, property_type_t type, bool need_swap) {
+	switch (type) {
+	case property_type_t::INT8:
+		return (double)(int8_t)p[0];
+	case property_type_t::UINT8:
+		return (double)p[0];
+	case property_type_t::INT16:
+		return (double)Ply_Read<int16_t>(p, need_swap);
+	case property_type_t::UINT16:
+		return (double)Ply_Read<uint16_t>(p, need_swap);
+	case property_type_t::INT32:
+		return (double)Ply_Read<int32_t>(p, need_swap);
+	case property_type_t::UINT32:
+		return (double)Ply_Read<uint32_t>(p, need_swap);
+	case property_type_t::FLOAT32:
+		return (double)Ply_Read<float>(p, need_swap);
+	default:
+		return Ply_Read<double>(p, need_swap);
+	}
+}
+
+int64_t PLY::ReadInteger(const uint8_t* p, property_type_t type, bool need_swap) {
+	switch (type) {
+	case property_type_t::INT8:
+		return (int8_t)p[0];
+	case property_type_t::UINT8:
+		return p[0];
+	case property_type_t::INT16:
+		return Ply_Read<int16_t>(p, need_swap);
+	case property_type_t::UINT16:
+		return Ply_Read<uint16_t>(p, need_swap);
+	case property_type_t::INT32:
+		return Ply_Read<int32_t>(p, need_swap);
+	case property_type_t::UINT32:
+		return Ply_Read<uint32_t>(p, need_swap);
+	default:
+		return (int64_t)ReadValue(p, type, need_swap);
+	}
+}
+
+bool PLY::LoadProperty(property_s& prop, bool is_face) {
+	// get property type, "list <count type> <item type>" for lists
+	const char* token = Reader_GetToken();
+	if (!token) {
+		printf("Could not get token\n");
+		return false;
+	}
+
+	prop.is_list_ = false;
+	prop.count_type_ = property_type_t::UINT8;
+
+	if (!strcmp(token, "list")) {
+		prop.is_list_ = true;
+
+		token = Reader_GetToken();
+		if (!token || !ParseType(token, prop.count_type_)) {
+			printf("Unsupported type: %s\n", token ? token : "");
 			return false;
 		}
 
-		// get property name
 		token = Reader_GetToken();
 		if (!token) {
 			printf("Could not get token\n");
 			return false;
 		}
+	}
 
-		if (!strcmp(token, "x")) {
-			prop->name_ = property_name_t::POS_X;
-		}
-		else if (!strcmp(token, "y")) {
-			prop->name_ = property_name_t::POS_Y;
-		}
-		else if (!strcmp(token, "z")) {
-			prop->name_ = property_name_t::POS_Z;
-		}
-		else if (!strcmp(token, "nx")) {
-			prop->name_ = property_name_t::NORMAL_X;
-			has_normal_ = true;
-		}
-		else if (!strcmp(token, "ny")) {
-			prop->name_ = property_name_t::NORMAL_Y;
-			has_normal_ = true;
-		}
-		else if (!strcmp(token, "nz")) {
-			prop->name_ = property_name_t::NORMAL_Z;
-			has_normal_ = true;
-		}
-		else if (!strcmp(token, "s")) {
-			prop->name_ = property_name_t::U;
-			has_tex_coord_ = true;
-		}
-		else if (!strcmp(token, "t")) {
-			prop->name_ = property_name_t::V;
-			has_tex_coord_ = true;
-		}
-		else if (!strcmp(token, "confidence")) {
-			prop->name_ = property_name_t::CONFIDENCE;
-		}
-		else if (!strcmp(token, "intensity")) {
-			prop->name_ = property_name_t::INTENSITY;
-		}
-		else if (!strcmp(token, "red")) {
-			prop->name_ = property_name_t::RED;
-			has_color_ = true;
-		}
-		else if (!strcmp(token, "green")) {
-			prop->name_ = property_name_t::GREEN;
-			has_color_ = true;
-		}
-		else if (!strcmp(token, "blue")) {
-			prop->name_ = property_name_t::BLUE;
-			has_color_ = true;
+	if (!ParseType(token, prop.type_)) {
+		printf("Unsupported type: %s\n", token);
+		return false;
+	}
+
+	// get property name
+	token = Reader_GetToken();
+	if (!token) {
+		printf("Could not get token\n");
+		return false;
+	}
+
+	prop.name_ = property_name_t::UNKNOWN;
+
+	if (is_face) {
+		if (prop.is_list_ && (!strcmp(token, "vertex_indices") || !strcmp(token, "vertex_index"))) {
+			prop.name_ = property_name_t::VERTEX_INDICES;
 		}
-		else if (!strcmp(token, "alpha")) {
-			prop->name_ = property_name_t::ALPHA;
-			has_color_ = true;
+	}
+	else if (prop.is_list_) {
+		// skipped
+	}
+	else if (!strcmp(token, "x")) {
+		prop.name_ = property_name_t::POS_X;
+	}
+	else if (!strcmp(token, "y")) {
+		prop.name_ = property_name_t::POS_Y;
+	}
+	else if (!strcmp(token, "z")) {
+		prop.name_ = property_name_t::POS_Z;
+	}
+	else if (!strcmp(token, "nx")) {
+		prop.name_ = property_name_t::NORMAL_X;
+		has_normal_ = true;
+	}
+	else if (!strcmp(token, "ny")) {
+		prop.name_ = property_name_t::NORMAL_Y;
+		has_normal_ = true;
+	}
+	else if (!strcmp(token, "nz")) {
+		prop.name_ = property_name_t::NORMAL_Z;
+		has_normal_ = true;
+	}
+	else if (!strcmp(token, "s")) {
+		prop.name_ = property_name_t::U;
+		has_tex_coord_ = true;
+	}
+	else if (!strcmp(token, "t")) {
+		prop.name_ = property_name_t::V;
+		has_tex_coord_ = true;
+	}
+	else if (!strcmp(token, "confidence")) {
+		prop.name_ = property_name_t::CONFIDENCE;
+	}
+	else if (!strcmp(token, "intensity")) {
+		prop.name_ = property_name_t::INTENSITY;
+	}
+	else if (!strcmp(token, "red")) {
+		prop.name_ = property_name_t::RED;
+		has_color_ = true;
+	}
+	else if (!strcmp(token, "green")) {
+		prop.name_ = property_name_t::GREEN;
+		has_color_ = true;
+	}
+	else if (!strcmp(token, "blue")) {
+		prop.name_ = property_name_t::BLUE;
+		has_color_ = true;
+	}
+	else if (!strcmp(token, "alpha")) {
+		prop.name_ = property_name_t::ALPHA;
+		has_color_ = true;
+	}
+	else {
+		printf("Unknown property name: %s\n", token);
+	}
+
+	return true;
+}
+
+bool PLY::LoadProperties() {
+	// load properties
+	if (!Reader_FindToken("property")) {
+		printf("Could not find property section\n");
+		return false;
+	}
+
+	const char* token = nullptr;
+	do {
+		if (num_property_ == MAX_PROPERTY) {
+			printf("Too many properties\n");
+			return false;
 		}
-		
-		else {
-			printf("Unknown property name: %s\n", token);
+
+		if (!LoadProperty(properties_[num_property_++], false)) {
+			return false;
 		}
 
 		// get next token
@@ -812,8 +1236,36 @@ bool PLY::LoadFaceCount() {
 	return true;
 }
 
+bool PLY::LoadFaceProperties() {
+	const char* token = Reader_GetToken();
+	if (!token) {
+		printf("Could not get token\n");
+		return false;
+	}
+
+	while (!strcmp(token, "property")) {
+		if (num_face_property_ == MAX_PROPERTY) {
+			printf("Too many properties\n");
+			return false;
+		}
+
+		if (!LoadProperty(face_properties_[num_face_property_++], true)) {
+			return false;
+		}
+
+		token = Reader_GetToken();
+		if (!token) {
+			printf("Could not get token\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool PLY::CheckHeadEnd() {
-	if (!Reader_FindToken("end_header")) {
+	// the face properties may have stopped at it already
+	if (strcmp(cur_token_, "end_header") && !Reader_FindToken("end_header")) {
 		printf("Could not find end_header section\n");
 		return false;
 	}
@@ -15,7 +15,9 @@ public:
 	PLY();
 	~PLY();
 
-	bool					Load(const char* filename);
+	// use_decode_plan false: decode binary vertices property by property (reference path,
+	// also taken when the vertex element has list properties)
+	bool					Load(const char* filename, bool use_decode_plan = true);
 	void					Clear();
 
 	const glm::vec3*		GetPos() const;
@@ -36,8 +38,14 @@ private:
 	};
 
 	enum class property_type_t {
-		FLOAT,
-		UINT8
+		INT8,
+		UINT8,
+		INT16,
+		UINT16,
+		INT32,
+		UINT32,
+		FLOAT32,
+		FLOAT64
 	};
 
 	enum class property_name_t {
@@ -54,16 +62,23 @@ private:
 		RED,
 		GREEN,
 		BLUE,
-		ALPHA
+		ALPHA,
+		VERTEX_INDICES,
+		UNKNOWN
 	};
 
 	static const int		MAX_PROPERTY = 32;
 
 	struct property_s {
-		property_type_t		type_;
+		property_type_t		type_;			// item type of lists
 		property_name_t		name_;
+		bool				is_list_;
+		property_type_t		count_type_;
 	};
 
+	// one vertex property converted for a block of vertices
+	struct decode_op_s;
+
 	// buffer
 	static const int		MAX_TOKEN_LEN = 1024;
 
@@ -79,6 +94,9 @@ private:
 	property_s				properties_[MAX_PROPERTY];
 	uint32_t				num_property_;
 
+	property_s				face_properties_[MAX_PROPERTY];
+	uint32_t				num_face_property_;
+
 	glm::vec3*				positions_;
 	glm::vec3*				normals_;
 	glm::vec2*				uv_lst_;
@@ -103,16 +121,28 @@ private:
 
 
 	bool					LoadHead();
-	bool					LoadData();
+	bool					LoadData(bool use_decode_plan);
 	bool					LoadData_ASCII();
-	bool					LoadData_BINARY();
+	bool					LoadData_BINARY(bool use_decode_plan);
+	bool					LoadVertices_Plan(bool need_swap);
+	bool					LoadVertices_Reference(bool need_swap);
+	bool					LoadFaces_BINARY(bool need_swap);
+	bool					CompileVertexPlan(bool need_swap, std::vector<decode_op_s>& ops, uint32_t& stride);
 	void					CalculateNormals();
 
+	static bool				ParseType(const char* token, property_type_t& type);
+	static uint32_t			TypeSize(property_type_t type);
+	static float			TypeDivisor(const property_s& prop);
+	static double			ReadValue(const uint8_t* p, property_type_t type, bool need_swap);
+	static int64_t			ReadInteger(const uint8_t* p, property_type_t type, bool need_swap);
+
 	bool					CheckHeadBegin();
 	bool					LoadFormat();
 	bool					LoadVertexCount();
+	bool					LoadProperty(property_s& prop, bool is_face);
 	bool					LoadProperties();
 	bool					LoadFaceCount();
+	bool					LoadFaceProperties();
 	bool					CheckHeadEnd();
 
 };
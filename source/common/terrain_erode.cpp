@@ -0,0 +1,307 @@
+/******************************************************************************
+ terrain_erode.cpp
+
+   FIR erosion filter of a heightfield, four sweeps:
+     columns, twice along +y (the "left to right" and "right to left" sweeps)
+     rows, twice along +x (the "top to bottom" and "bottom to top" sweeps)
+
+   each pair is fused into a single pass carrying both recurrences,
+   columns are filtered in lockstep tiles so every access is sequential,
+   rows in blocks of 4 transposed into SIMD lanes
+
+   every path evaluates filter * v + (1 - filter) * h with the same float
+   operations as the original per-band loop, the result is bit identical
+ *****************************************************************************/
+
+#include "inc.h"
+
+#if defined(CPU_X86)
+# include <immintrin.h>
+#endif
+
+// columns of one tile, a cache line of floats
+static const uint32_t ERODE_TILE_COLUMNS = 16;
+
+// minimum rows / tiles per thread
+static const uint32_t ERODE_MIN_ROWS = 64;
+static const uint32_t ERODE_MIN_TILES = 4;
+
+/*
+================================================================================
+columns
+================================================================================
+*/
+
+// columns [x_begin, x_end), every column from row 0 to row n - 1
+static void Erode_Columns_Scalar(float* heights, uint32_t n, uint32_t x_begin, uint32_t x_end,
+	float filter, float one_minus_filter)
+{
+	float v1[ERODE_TILE_COLUMNS], v2[ERODE_TILE_COLUMNS];
+
+	for (uint32_t x0 = x_begin; x0 < x_end; x0 += ERODE_TILE_COLUMNS) {
+		uint32_t count = x_end - x0 < ERODE_TILE_COLUMNS ? x_end - x0 : ERODE_TILE_COLUMNS;
+
+		for (uint32_t k = 0; k < count; ++k) {
+			v1[k] = v2[k] = heights[x0 + k];
+		}
+
+		for (uint32_t y = 1; y < n; ++y) {
+			float* row = heights + (size_t)y * n + x0;
+
+			for (uint32_t k = 0; k < count; ++k) {
+				float h1 = filter * v1[k] + one_minus_filter * row[k];
+				v1[k] = h1;
+
+				float h2 = filter * v2[k] + one_minus_filter * h1;
+				v2[k] = h2;
+
+				row[k] = h2;
+			}
+		}
+	}
+}
+
+#if defined(CPU_X86)
+
+static void Erode_Columns_SSE2(float* heights, uint32_t n, uint32_t x_begin, uint32_t x_end,
+	float filter, float one_minus_filter)
+{
+	const uint32_t LANES = 4;
+	const uint32_t VECTORS = ERODE_TILE_COLUMNS / LANES;
+
+	__m128 f = _mm_set1_ps(filter);
+	__m128 g = _mm_set1_ps(one_minus_filter);
+
+	uint32_t x0 = x_begin;
+
+	for (; x0 + ERODE_TILE_COLUMNS <= x_end; x0 += ERODE_TILE_COLUMNS) {
+		__m128 v1[VECTORS], v2[VECTORS];
+
+		for (uint32_t k = 0; k < VECTORS; ++k) {
+			v1[k] = v2[k] = _mm_loadu_ps(heights + x0 + k * LANES);
+		}
+
+		for (uint32_t y = 1; y < n; ++y) {
+			float* row = heights + (size_t)y * n + x0;
+
+			for (uint32_t k = 0; k < VECTORS; ++k) {
+				__m128 h = _mm_loadu_ps(row + k * LANES);
+				__m128 h1 = _mm_add_ps(_mm_mul_ps(f, v1[k]), _mm_mul_ps(g, h));
+				v1[k] = h1;
+
+				__m128 h2 = _mm_add_ps(_mm_mul_ps(f, v2[k]), _mm_mul_ps(g, h1));
+				v2[k] = h2;
+
+				_mm_storeu_ps(row + k * LANES, h2);
+			}
+		}
+	}
+
+	if (x0 < x_end) {
+		Erode_Columns_Scalar(heights, n, x0, x_end, filter, one_minus_filter);
+	}
+}
+
+TARGET_AVX2 static void Erode_Columns_AVX2(float* heights, uint32_t n, uint32_t x_begin, uint32_t x_end,
+	float filter, float one_minus_filter)
+{
+	const uint32_t LANES = 8;
+	const uint32_t VECTORS = ERODE_TILE_COLUMNS / LANES;
+
+	__m256 f = _mm256_set1_ps(filter);
+	__m256 g = _mm256_set1_ps(one_minus_filter);
+
+	uint32_t x0 = x_begin;
+
+	for (; x0 + ERODE_TILE_COLUMNS <= x_end; x0 += ERODE_TILE_COLUMNS) {
+		__m256 v1[VECTORS], v2[VECTORS];
+
+		for (uint32_t k = 0; k < VECTORS; ++k) {
+			v1[k] = v2[k] = _mm256_loadu_ps(heights + x0 + k * LANES);
+		}
+
+		for (uint32_t y = 1; y < n; ++y) {
+			float* row = heights + (size_t)y * n + x0;
+
+			for (uint32_t k = 0; k < VECTORS; ++k) {
+				__m256 h = _mm256_loadu_ps(row + k * LANES);
+				__m256 h1 = _mm256_add_ps(_mm256_mul_ps(f, v1[k]), _mm256_mul_ps(g, h));
+				v1[k] = h1;
+
+				__m256 h2 = _mm256_add_ps(_mm256_mul_ps(f, v2[k]), _mm256_mul_ps(g, h1));
+				v2[k] = h2;
+
+				_mm256_storeu_ps(row + k * LANES, h2);
+			}
+		}
+	}
+
+	if (x0 < x_end) {
+		Erode_Columns_Scalar(heights, n, x0, x_end, filter, one_minus_filter);
+	}
+}
+
+#endif
+
+/*
+================================================================================
+rows
+================================================================================
+*/
+
+// rows [y_begin, y_end), every row from column 0 to column n - 1
+static void Erode_Rows_Scalar(float* heights, uint32_t n, uint32_t y_begin, uint32_t y_end,
+	float filter, float one_minus_filter)
+{
+	for (uint32_t y = y_begin; y < y_end; ++y) {
+		float* row = heights + (size_t)y * n;
+		float v1 = row[0], v2 = row[0];
+
+		for (uint32_t x = 1; x < n; ++x) {
+			float h1 = filter * v1 + one_minus_filter * row[x];
+			v1 = h1;
+
+			float h2 = filter * v2 + one_minus_filter * h1;
+			v2 = h2;
+
+			row[x] = h2;
+		}
+	}
+}
+
+#if defined(CPU_X86)
+
+// 4 rows in lockstep, 4x4 blocks transposed so each lane carries one row
+static void Erode_Rows_SSE2(float* heights, uint32_t n, uint32_t y_begin, uint32_t y_end,
+	float filter, float one_minus_filter)
+{
+	__m128 f = _mm_set1_ps(filter);
+	__m128 g = _mm_set1_ps(one_minus_filter);
+
+	uint32_t y = y_begin;
+
+	for (; y + 4 <= y_end; y += 4) {
+		float* r0 = heights + (size_t)y * n;
+		float* r1 = r0 + n;
+		float* r2 = r1 + n;
+		float* r3 = r2 + n;
+
+		__m128 v1 = _mm_setr_ps(r0[0], r1[0], r2[0], r3[0]);
+		__m128 v2 = v1;
+
+		uint32_t x = 1;
+
+		for (; x + 4 <= n; x += 4) {
+			__m128 c0 = _mm_loadu_ps(r0 + x);
+			__m128 c1 = _mm_loadu_ps(r1 + x);
+			__m128 c2 = _mm_loadu_ps(r2 + x);
+			__m128 c3 = _mm_loadu_ps(r3 + x);
+
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+			__m128* c[4] = { &c0, &c1, &c2, &c3 };
+			for (int k = 0; k < 4; ++k) {
+				__m128 h1 = _mm_add_ps(_mm_mul_ps(f, v1), _mm_mul_ps(g, *c[k]));
+				v1 = h1;
+
+				__m128 h2 = _mm_add_ps(_mm_mul_ps(f, v2), _mm_mul_ps(g, h1));
+				v2 = h2;
+
+				*c[k] = h2;
+			}
+
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+			_mm_storeu_ps(r0 + x, c0);
+			_mm_storeu_ps(r1 + x, c1);
+			_mm_storeu_ps(r2 + x, c2);
+			_mm_storeu_ps(r3 + x, c3);
+		}
+
+		// remaining columns, continuing the recurrences of each lane
+		float lv1[4], lv2[4];
+		_mm_storeu_ps(lv1, v1);
+		_mm_storeu_ps(lv2, v2);
+
+		float* rows[4] = { r0, r1, r2, r3 };
+		for (int k = 0; k < 4; ++k) {
+			for (uint32_t xx = x; xx < n; ++xx) {
+				float h1 = filter * lv1[k] + one_minus_filter * rows[k][xx];
+				lv1[k] = h1;
+
+				float h2 = filter * lv2[k] + one_minus_filter * h1;
+				lv2[k] = h2;
+
+				rows[k][xx] = h2;
+			}
+		}
+	}
+
+	if (y < y_end) {
+		Erode_Rows_Scalar(heights, n, y, y_end, filter, one_minus_filter);
+	}
+}
+
+#endif
+
+/*
+================================================================================
+Terrain_Erode
+================================================================================
+*/
+
+// filter: [0 ~ 1]
+COMMON_API void Terrain_Erode(terrain_s& terrain, float filter) {
+	if (!terrain.heights_ || terrain.vertex_count_per_edge_ < 2) {
+		return;
+	}
+
+	uint32_t n = (uint32_t)terrain.vertex_count_per_edge_;
+	float* heights = terrain.heights_;
+	float one_minus_filter = 1 - filter;
+
+	auto Columns = Erode_Columns_Scalar;
+	auto Rows = Erode_Rows_Scalar;
+
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		Columns = Erode_Columns_AVX2;
+		Rows = Erode_Rows_SSE2;
+		break;
+	case simd_level_t::SSE2:
+		Columns = Erode_Columns_SSE2;
+		Rows = Erode_Rows_SSE2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+
+	// columns, threads get whole tiles so they never share a cache line
+	uint32_t num_tile = (n + ERODE_TILE_COLUMNS - 1) / ERODE_TILE_COLUMNS;
+	uint32_t num_thread = (num_tile + ERODE_MIN_TILES - 1) / ERODE_MIN_TILES;
+	if (num_thread > hardware_threads) {
+		num_thread = hardware_threads;
+	}
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		uint32_t x_begin = num_tile * idx / num_thread * ERODE_TILE_COLUMNS;
+		uint32_t x_end = num_tile * (idx + 1) / num_thread * ERODE_TILE_COLUMNS;
+		Columns(heights, n, x_begin, x_end < n ? x_end : n, filter, one_minus_filter);
+	});
+
+	// rows, after every column is done
+	num_thread = (n + ERODE_MIN_ROWS - 1) / ERODE_MIN_ROWS;
+	if (num_thread > hardware_threads) {
+		num_thread = hardware_threads;
+	}
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		uint32_t y_begin = (uint32_t)((uint64_t)n * idx / num_thread);
+		uint32_t y_end = (uint32_t)((uint64_t)n * (idx + 1) / num_thread);
+		Rows(heights, n, y_begin, y_end, filter, one_minus_filter);
+	});
+}
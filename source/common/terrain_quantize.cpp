@@ -0,0 +1,328 @@
+/******************************************************************************
+ terrain_quantize.cpp
+
+   heights in fewer bits for GPU buffers, see terrain_height_format_t
+
+   UNORM16 spreads [min_z, max_z] over 65536 steps, FLOAT16 keeps the
+   relative precision of a half, BLOCK_DELTA stores every 8x8 vertex block
+   as a 16 bit base and 8 bit deltas scaled by the smallest power of 2 the
+   range of the block fits in
+
+   every SIMD level quantizes with the same float operations as the scalar
+   path, the packed bytes are identical, Terrain_Unpack decodes the way the
+   mesh shader does
+ *****************************************************************************/
+
+#include "inc.h"
+
+#if defined(CPU_X86)
+# include <immintrin.h>
+#endif
+
+// minimum rows per thread
+static const uint32_t QUANTIZE_MIN_ROWS = 64;
+
+// vertices per BLOCK_DELTA block edge, 4 deltas per uint
+static const uint32_t QUANTIZE_BLOCK_SIZE = 8;
+static const uint32_t QUANTIZE_BLOCK_UINTS = QUANTIZE_BLOCK_SIZE * QUANTIZE_BLOCK_SIZE / 4;
+
+/*
+================================================================================
+unorm16
+================================================================================
+*/
+
+// q = clamp((h - min_z) * inv_step + 0.5, 0, 65535), truncated
+static void Quantize_Row_Scalar(const float* src, uint32_t count, float min_z, float inv_step, uint16_t* dst) {
+	for (uint32_t i = 0; i < count; ++i) {
+		float v = (src[i] - min_z) * inv_step + 0.5f;
+		v = v > 0.0f ? v : 0.0f;
+		v = v < 65535.0f ? v : 65535.0f;
+		dst[i] = (uint16_t)v;
+	}
+}
+
+#if defined(CPU_X86)
+
+static void Quantize_Row_SSE2(const float* src, uint32_t count, float min_z, float inv_step, uint16_t* dst) {
+	const __m128 MIN_Z = _mm_set1_ps(min_z);
+	const __m128 INV_STEP = _mm_set1_ps(inv_step);
+	const __m128 HALF = _mm_set1_ps(0.5f);
+	const __m128 MAX_Q = _mm_set1_ps(65535.0f);
+	const __m128i BIAS = _mm_set1_epi32(32768);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// max / min keep the operand order of the scalar compares
+		__m128 a = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i), MIN_Z), INV_STEP), HALF);
+		__m128 b = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i + 4), MIN_Z), INV_STEP), HALF);
+		a = _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), MAX_Q);
+		b = _mm_min_ps(_mm_max_ps(b, _mm_setzero_ps()), MAX_Q);
+
+		// no unsigned pack in SSE2: bias into the signed range and back
+		__m128i q = _mm_packs_epi32(_mm_sub_epi32(_mm_cvttps_epi32(a), BIAS), _mm_sub_epi32(_mm_cvttps_epi32(b), BIAS));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(q, _mm_set1_epi16((short)0x8000)));
+	}
+
+	Quantize_Row_Scalar(src + i, count - i, min_z, inv_step, dst + i);
+}
+
+TARGET_AVX2 static void Quantize_Row_AVX2(const float* src, uint32_t count, float min_z, float inv_step, uint16_t* dst) {
+	const __m256 MIN_Z = _mm256_set1_ps(min_z);
+	const __m256 INV_STEP = _mm256_set1_ps(inv_step);
+	const __m256 HALF = _mm256_set1_ps(0.5f);
+	const __m256 MAX_Q = _mm256_set1_ps(65535.0f);
+
+	uint32_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + i), MIN_Z), INV_STEP), HALF);
+		__m256 b = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + i + 8), MIN_Z), INV_STEP), HALF);
+		a = _mm256_min_ps(_mm256_max_ps(a, _mm256_setzero_ps()), MAX_Q);
+		b = _mm256_min_ps(_mm256_max_ps(b, _mm256_setzero_ps()), MAX_Q);
+
+		// the pack works per 128 bit lane, the permute puts the quarters back in order
+		__m256i q = _mm256_packus_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(q, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	Quantize_Row_SSE2(src + i, count - i, min_z, inv_step, dst + i);
+}
+
+#endif
+
+// every height to unorm16, rows in parallel
+static void Quantize_Heights(const terrain_s& terrain, float min_z, float inv_step, uint16_t* dst) {
+	auto Row = Quantize_Row_Scalar;
+
+#if defined(CPU_X86)
+	switch (Cpu_GetSIMDLevel()) {
+	case simd_level_t::AVX2:
+		Row = Quantize_Row_AVX2;
+		break;
+	case simd_level_t::SSE2:
+		Row = Quantize_Row_SSE2;
+		break;
+	default:
+		break;
+	}
+#endif
+
+	uint32_t n = (uint32_t)terrain.vertex_count_per_edge_;
+	uint32_t num_thread = (n + QUANTIZE_MIN_ROWS - 1) / QUANTIZE_MIN_ROWS;
+	uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+	num_thread = num_thread > hardware_threads ? hardware_threads : num_thread;
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		uint32_t y_begin = (uint32_t)((uint64_t)n * idx / num_thread);
+		uint32_t y_end = (uint32_t)((uint64_t)n * (idx + 1) / num_thread);
+		for (uint32_t y = y_begin; y < y_end; ++y) {
+			Row(terrain.heights_ + (size_t)y * n, n, min_z, inv_step, dst + (size_t)y * n);
+		}
+	});
+}
+
+/*
+================================================================================
+block delta
+================================================================================
+*/
+
+// header: base | shift << 16, deltas row by row, 4 to a uint starting at the low byte
+static void Quantize_EncodeBlock(const uint16_t* q, uint32_t n, uint32_t x0, uint32_t y0,
+	uint32_t* header, uint32_t* deltas)
+{
+	uint32_t x1 = x0 + QUANTIZE_BLOCK_SIZE < n ? x0 + QUANTIZE_BLOCK_SIZE : n;
+	uint32_t y1 = y0 + QUANTIZE_BLOCK_SIZE < n ? y0 + QUANTIZE_BLOCK_SIZE : n;
+
+	uint32_t q_min = 65535, q_max = 0;
+	for (uint32_t y = y0; y < y1; ++y) {
+		for (uint32_t x = x0; x < x1; ++x) {
+			uint32_t v = q[(size_t)y * n + x];
+			q_min = v < q_min ? v : q_min;
+			q_max = v > q_max ? v : q_max;
+		}
+	}
+
+	// the rounded delta of the largest value must fit 8 bits
+	uint32_t range = q_max - q_min;
+	uint32_t shift = 0;
+	while (((range + ((1u << shift) >> 1)) >> shift) > 255) {
+		shift++;
+	}
+
+	*header = q_min | (shift << 16);
+	memset(deltas, 0, QUANTIZE_BLOCK_UINTS * sizeof(uint32_t));
+
+	uint32_t round = (1u << shift) >> 1;
+	for (uint32_t y = y0; y < y1; ++y) {
+		for (uint32_t x = x0; x < x1; ++x) {
+			uint32_t j = (y - y0) * QUANTIZE_BLOCK_SIZE + (x - x0);
+			uint32_t delta = (q[(size_t)y * n + x] - q_min + round) >> shift;
+			deltas[j >> 2] |= delta << ((j & 3) * 8);
+		}
+	}
+}
+
+static void Quantize_EncodeBlocks(const uint16_t* q, uint32_t n, uint32_t blocks_per_row, uint32_t* data) {
+	uint32_t num_block = blocks_per_row * blocks_per_row;
+	uint32_t num_thread = (blocks_per_row * QUANTIZE_BLOCK_SIZE + QUANTIZE_MIN_ROWS - 1) / QUANTIZE_MIN_ROWS;
+	uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+	num_thread = num_thread > hardware_threads ? hardware_threads : num_thread;
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		uint32_t by_begin = (uint32_t)((uint64_t)blocks_per_row * idx / num_thread);
+		uint32_t by_end = (uint32_t)((uint64_t)blocks_per_row * (idx + 1) / num_thread);
+		for (uint32_t by = by_begin; by < by_end; ++by) {
+			for (uint32_t bx = 0; bx < blocks_per_row; ++bx) {
+				uint32_t block = by * blocks_per_row + bx;
+				Quantize_EncodeBlock(q, n, bx * QUANTIZE_BLOCK_SIZE, by * QUANTIZE_BLOCK_SIZE,
+					data + block, data + num_block + (size_t)block * QUANTIZE_BLOCK_UINTS);
+			}
+		}
+	});
+}
+
+/*
+================================================================================
+Terrain_Pack
+================================================================================
+*/
+
+COMMON_API bool Terrain_Pack(const terrain_s& terrain, terrain_height_format_t format, float min_z, float max_z,
+	terrain_packed_s& packed)
+{
+	memset(&packed, 0, sizeof(packed));
+
+	if (!terrain.heights_ || terrain.vertex_count_per_edge_ < 2) {
+		printf("Terrain_Pack: empty terrain\n");
+		return false;
+	}
+
+	if (!(max_z > min_z)) {
+		printf("Terrain_Pack: bad height range [%f, %f]\n", min_z, max_z);
+		return false;
+	}
+
+	uint32_t n = (uint32_t)terrain.vertex_count_per_edge_;
+	size_t num_vertex = (size_t)n * n;
+
+	packed.format_ = format;
+	packed.vertex_count_per_edge_ = terrain.vertex_count_per_edge_;
+	packed.min_z_ = min_z;
+	packed.scale_z_ = (max_z - min_z) / 65535.0f;
+
+	size_t num_uint = 0;
+	switch (format) {
+	case terrain_height_format_t::FLOAT32:
+		num_uint = num_vertex;
+		break;
+	case terrain_height_format_t::UNORM16:
+	case terrain_height_format_t::FLOAT16:
+		num_uint = (num_vertex + 1) / 2;
+		break;
+	case terrain_height_format_t::BLOCK_DELTA:
+		packed.blocks_per_row_ = (n + QUANTIZE_BLOCK_SIZE - 1) / QUANTIZE_BLOCK_SIZE;
+		packed.num_block_ = packed.blocks_per_row_ * packed.blocks_per_row_;
+		num_uint = (size_t)packed.num_block_ * (1 + QUANTIZE_BLOCK_UINTS);
+		break;
+	}
+
+	packed.data_ = new uint32_t[num_uint];
+	packed.size_ = num_uint * sizeof(uint32_t);
+	packed.data_[num_uint - 1] = 0;	// the unused half of an odd count
+
+	float inv_step = 65535.0f / (max_z - min_z);
+
+	switch (format) {
+	case terrain_height_format_t::FLOAT32:
+		memcpy(packed.data_, terrain.heights_, num_vertex * sizeof(float));
+		break;
+	case terrain_height_format_t::UNORM16:
+		Quantize_Heights(terrain, min_z, inv_step, (uint16_t*)packed.data_);
+		break;
+	case terrain_height_format_t::FLOAT16:
+		FloatToHalfFloatArray(terrain.heights_, (float16_t*)packed.data_, num_vertex);
+		break;
+	case terrain_height_format_t::BLOCK_DELTA: {
+		std::vector<uint16_t> q(num_vertex);
+		Quantize_Heights(terrain, min_z, inv_step, q.data());
+		Quantize_EncodeBlocks(q.data(), n, packed.blocks_per_row_, packed.data_);
+		break;
+	}
+	}
+
+	// error of the decoded heights
+	terrain_s decoded = {};
+	if (!Terrain_Unpack(packed, decoded)) {
+		Terrain_FreePacked(packed);
+		return false;
+	}
+
+	double sum = 0.0;
+	float max_error = 0.0f;
+	for (size_t i = 0; i < num_vertex; ++i) {
+		float e = fabsf(decoded.heights_[i] - terrain.heights_[i]);
+		max_error = e > max_error ? e : max_error;
+		sum += (double)e * e;
+	}
+
+	packed.max_error_ = max_error;
+	packed.rms_error_ = (float)sqrt(sum / num_vertex);
+
+	Terrain_Free(decoded);
+
+	return true;
+}
+
+COMMON_API bool Terrain_Unpack(const terrain_packed_s& packed, terrain_s& terrain) {
+	memset(&terrain, 0, sizeof(terrain));
+
+	if (!packed.data_) {
+		return false;
+	}
+
+	uint32_t n = (uint32_t)packed.vertex_count_per_edge_;
+	size_t num_vertex = (size_t)n * n;
+
+	terrain.vertex_count_per_edge_ = packed.vertex_count_per_edge_;
+	terrain.heights_ = new float[num_vertex];
+
+	const uint16_t* q = (const uint16_t*)packed.data_;
+
+	switch (packed.format_) {
+	case terrain_height_format_t::FLOAT32:
+		memcpy(terrain.heights_, packed.data_, num_vertex * sizeof(float));
+		break;
+	case terrain_height_format_t::UNORM16:
+		for (size_t i = 0; i < num_vertex; ++i) {
+			terrain.heights_[i] = packed.min_z_ + (float)q[i] * packed.scale_z_;
+		}
+		break;
+	case terrain_height_format_t::FLOAT16:
+		HalfFloatToFloatArray((const float16_t*)packed.data_, terrain.heights_, num_vertex);
+		break;
+	case terrain_height_format_t::BLOCK_DELTA:
+		for (uint32_t y = 0; y < n; ++y) {
+			for (uint32_t x = 0; x < n; ++x) {
+				uint32_t block = (y / QUANTIZE_BLOCK_SIZE) * packed.blocks_per_row_ + x / QUANTIZE_BLOCK_SIZE;
+				uint32_t header = packed.data_[block];
+				uint32_t j = (y % QUANTIZE_BLOCK_SIZE) * QUANTIZE_BLOCK_SIZE + x % QUANTIZE_BLOCK_SIZE;
+				uint32_t word = packed.data_[packed.num_block_ + (size_t)block * QUANTIZE_BLOCK_UINTS + (j >> 2)];
+				uint32_t delta = (word >> ((j & 3) * 8)) & 0xff;
+				uint32_t v = (header & 0xffff) + (delta << (header >> 16));
+				v = v < 65535 ? v : 65535;
+				terrain.heights_[(size_t)y * n + x] = packed.min_z_ + (float)v * packed.scale_z_;
+			}
+		}
+		break;
+	}
+
+	return true;
+}
+
+COMMON_API void Terrain_FreePacked(terrain_packed_s& packed) {
+	if (packed.data_) {
+		delete[] packed.data_;
+		packed.data_ = nullptr;
+	}
+}
@@ -0,0 +1,360 @@
+/******************************************************************************
+ terrain_texture.cpp
+
+   base texture of a terrain: 4 tile images blended by height
+
+   the blend weights are looked up in a table over [min_z, max_z] instead of
+   evaluated per pixel, the heights are sampled bilinear, the texel columns
+   of every tile are computed once per column, rows run in parallel
+ *****************************************************************************/
+
+#include "inc.h"
+
+#if defined(CPU_X86)
+# include <immintrin.h>
+#endif
+
+// intervals of the blend weight table, linear interpolation in between
+static const int TERRAIN_TEXTURE_LUT_SIZE = 1024;
+
+// minimum rows / heights per thread
+static const int TERRAIN_TEXTURE_MIN_ROWS = 16;
+static const int TERRAIN_TEXTURE_MIN_HEIGHTS = 65536;
+
+static const int TERRAIN_TEXTURE_NUM_TILE = 4;
+
+struct terrain_texture_column_s {
+	int						ix_;		// left height sample
+	float					fx_;
+	int						texel_[TERRAIN_TEXTURE_NUM_TILE];	// byte offset in the row of every tile image
+};
+
+struct terrain_texture_row_s {
+	const byte_t*			texels_[TERRAIN_TEXTURE_NUM_TILE];
+	const int*				lut_index_;		// per pixel
+	const float*			lut_frac_;
+};
+
+/*
+================================================================================
+rows
+================================================================================
+*/
+
+static void TerrainTexture_Row_Scalar(byte_t* dst, int width, const terrain_texture_row_s& row,
+	const terrain_texture_column_s* cols, const glm::vec4* lut)
+{
+	for (int col = 0; col < width; ++col) {
+		const terrain_texture_column_s& c = cols[col];
+
+		int i = row.lut_index_[col];
+		glm::vec4 percentage = lut[i] + (lut[i + 1] - lut[i]) * row.lut_frac_[col];
+
+		float combined[3] = {};
+
+		for (int k = 0; k < TERRAIN_TEXTURE_NUM_TILE; ++k) {
+			const byte_t* pixel = row.texels_[k] + c.texel_[k];
+			combined[0] += (float)pixel[0] * percentage[k];
+			combined[1] += (float)pixel[1] * percentage[k];
+			combined[2] += (float)pixel[2] * percentage[k];
+		}
+
+		byte_t* dst_pixel = dst + col * 4;
+		for (int j = 0; j < 3; ++j) {
+			dst_pixel[j] = (byte_t)(combined[j] > 255.0f ? 255.0f : combined[j]);
+		}
+		dst_pixel[3] = 255;
+	}
+}
+
+#if defined(CPU_X86)
+
+// the rgba of a pixel in the lanes of a vector
+static void TerrainTexture_Row_SSE2(byte_t* dst, int width, const terrain_texture_row_s& row,
+	const terrain_texture_column_s* cols, const glm::vec4* lut)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 max_value = _mm_set1_ps(255.0f);
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+	for (int col = 0; col < width; ++col) {
+		const terrain_texture_column_s& c = cols[col];
+
+		int i = row.lut_index_[col];
+		__m128 w0 = _mm_loadu_ps(&lut[i].x);
+		__m128 w1 = _mm_loadu_ps(&lut[i + 1].x);
+		__m128 percentage = _mm_add_ps(w0, _mm_mul_ps(_mm_sub_ps(w1, w0), _mm_set1_ps(row.lut_frac_[col])));
+
+		__m128 combined = _mm_setzero_ps();
+
+		// k = 0 ~ 3, the same order as the scalar sum
+#define TERRAIN_TEXTURE_BLEND(k) { \
+			int32_t texel; \
+			memcpy(&texel, row.texels_[k] + c.texel_[k], 4); \
+			__m128i p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texel), zero), zero); \
+			__m128 w = _mm_shuffle_ps(percentage, percentage, _MM_SHUFFLE(k, k, k, k)); \
+			combined = _mm_add_ps(combined, _mm_mul_ps(_mm_cvtepi32_ps(p), w)); \
+		}
+
+		TERRAIN_TEXTURE_BLEND(0);
+		TERRAIN_TEXTURE_BLEND(1);
+		TERRAIN_TEXTURE_BLEND(2);
+		TERRAIN_TEXTURE_BLEND(3);
+
+#undef TERRAIN_TEXTURE_BLEND
+
+		__m128i v = _mm_cvttps_epi32(_mm_min_ps(combined, max_value));
+		v = _mm_packus_epi16(_mm_packs_epi32(v, zero), zero);
+		v = _mm_or_si128(_mm_and_si128(v, rgb_mask), alpha);
+
+		int32_t pixel = _mm_cvtsi128_si32(v);
+		memcpy(dst + col * 4, &pixel, 4);
+	}
+}
+
+#endif
+
+/*
+================================================================================
+Terrain_Texture
+================================================================================
+*/
+
+COMMON_API bool	Terrain_Texture(const terrain_texture_tiles_s& tile_images,
+	const terrain_s& terrain,
+	int width, int height, image_s& texture)
+{
+	struct tile_s {
+		const char* filename_;
+		image_s		image_;
+		float		full_lower_;
+		float		full_upper_;
+		float		vanish_lower_;
+		float		vanish_upper_;
+	} tiles[TERRAIN_TEXTURE_NUM_TILE] = {};
+
+	/*
+
+	tile
+
+	|----- vanish_upper_
+	|
+	|----- full_upper_
+	|      100%
+	|----- full_lower_
+	|
+	|----- vanish_lower_
+
+	*/
+
+	auto GetPrecentage = [](const tile_s& tile, float z) -> float {
+		if (z > tile.vanish_upper_ || z < tile.vanish_lower_) {
+			return 0.0f;
+		}
+
+		if (z > tile.full_upper_) {
+			return (tile.vanish_upper_ - z) / (tile.vanish_upper_ - tile.full_upper_);
+		}
+
+		if (z < tile.full_lower_) {
+			return (z - tile.vanish_lower_) / (tile.full_lower_ - tile.vanish_lower_);
+		}
+
+		return 1.0f;
+	};
+
+	auto FreeTiles = [&tiles]() {
+		for (int i = 0; i < TERRAIN_TEXTURE_NUM_TILE; ++i) {
+			if (tiles[i].image_.pixels_) {
+				Img_Free(tiles[i].image_);
+			}
+		}
+	};
+
+	int vertex_count_per_edge = terrain.vertex_count_per_edge_;
+	int z_count = vertex_count_per_edge * vertex_count_per_edge;
+
+	if (vertex_count_per_edge < 2 || width < 1 || height < 1) {
+		printf("Terrain_Texture: bad size\n");
+		return false;
+	}
+
+	uint32_t hardware_threads = Thread_GetHardwareConcurrency();
+
+	// min / max z
+	uint32_t num_thread = (uint32_t)((z_count + TERRAIN_TEXTURE_MIN_HEIGHTS - 1) / TERRAIN_TEXTURE_MIN_HEIGHTS);
+	if (num_thread > hardware_threads) {
+		num_thread = hardware_threads;
+	}
+
+	std::vector<float> thread_min_z(num_thread), thread_max_z(num_thread);
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		int begin = (int)((int64_t)z_count * idx / num_thread);
+		int end = (int)((int64_t)z_count * (idx + 1) / num_thread);
+
+		float min_z = 9999999999.0f;
+		float max_z = -9999999999.0f;
+
+		for (int i = begin; i < end; ++i) {
+			float z = terrain.heights_[i];
+			min_z = z < min_z ? z : min_z;
+			max_z = z > max_z ? z : max_z;
+		}
+
+		thread_min_z[idx] = min_z;
+		thread_max_z[idx] = max_z;
+	});
+
+	float min_z = 9999999999.0f;
+	float max_z = -9999999999.0f;
+
+	for (uint32_t i = 0; i < num_thread; ++i) {
+		min_z = thread_min_z[i] < min_z ? thread_min_z[i] : min_z;
+		max_z = thread_max_z[i] > max_z ? thread_max_z[i] : max_z;
+	}
+
+	float step = (max_z - min_z) / 7.0f;
+
+	tiles[0].filename_ = tile_images.lowest_;
+	tiles[0].full_lower_ = min_z;
+
+	tiles[1].filename_ = tile_images.low_;
+	tiles[1].full_lower_ = min_z + step * 2.0f;
+
+	tiles[2].filename_ = tile_images.high_;
+	tiles[2].full_lower_ = min_z + step * 4.0f;
+
+	tiles[3].filename_ = tile_images.hightest_;
+	tiles[3].full_lower_ = min_z + step * 6.0f;
+
+	for (int i = 0; i < TERRAIN_TEXTURE_NUM_TILE; ++i) {
+		tiles[i].full_upper_ = tiles[i].full_lower_ + step;
+		tiles[i].vanish_lower_ = tiles[i].full_lower_ - step;
+		tiles[i].vanish_upper_ = tiles[i].full_upper_ + step;
+	}
+
+	for (int i = 0; i < TERRAIN_TEXTURE_NUM_TILE; ++i) {
+		if (!Img_Load(tiles[i].filename_, tiles[i].image_)) {
+			FreeTiles();
+			return false;
+		}
+
+		if (tiles[i].image_.format_ != image_format_t::R8G8B8A8) {
+			printf("Terrain_Texture: %s is not R8G8B8A8\n", tiles[i].filename_);
+			FreeTiles();
+			return false;
+		}
+	}
+
+	if (!Img_Create(width, height, image_format_t::R8G8B8A8, texture)) {
+		FreeTiles();
+		return false;
+	}
+
+	// blend weights
+	std::vector<glm::vec4> lut(TERRAIN_TEXTURE_LUT_SIZE + 1);
+
+	for (int i = 0; i <= TERRAIN_TEXTURE_LUT_SIZE; ++i) {
+		float z = min_z + (max_z - min_z) * i / TERRAIN_TEXTURE_LUT_SIZE;
+		for (int k = 0; k < TERRAIN_TEXTURE_NUM_TILE; ++k) {
+			lut[i][k] = GetPrecentage(tiles[k], z);
+		}
+	}
+
+	float lut_scale = max_z > min_z ? TERRAIN_TEXTURE_LUT_SIZE / (max_z - min_z) : 0.0f;
+
+	// texel of a tile image at [0, 1]
+	auto GetTexel = [](int size, float f) -> int {
+		int i = int((size * f) + 0.5f);
+		return i >= size ? size - 1 : i;
+	};
+
+	// left / lower height sample, the last one interpolates towards the edge
+	auto GetSample = [vertex_count_per_edge](float f, int& i, float& frac) {
+		float s = f * (vertex_count_per_edge - 1);
+		i = (int)s;
+		i = i < vertex_count_per_edge - 2 ? i : vertex_count_per_edge - 2;
+		frac = s - (float)i;
+	};
+
+	std::vector<terrain_texture_column_s> cols(width);
+
+	for (int col = 0; col < width; ++col) {
+		float u = width > 1 ? (float)col / (width - 1) : 0.0f;
+
+		terrain_texture_column_s& c = cols[col];
+		GetSample(u, c.ix_, c.fx_);
+
+		for (int k = 0; k < TERRAIN_TEXTURE_NUM_TILE; ++k) {
+			c.texel_[k] = GetTexel(tiles[k].image_.width_, u) * 4;
+		}
+	}
+
+	auto Row = TerrainTexture_Row_Scalar;
+
+#if defined(CPU_X86)
+	if (Cpu_GetSIMDLevel() >= simd_level_t::SSE2) {
+		Row = TerrainTexture_Row_SSE2;
+	}
+#endif
+
+	num_thread = (uint32_t)((height + TERRAIN_TEXTURE_MIN_ROWS - 1) / TERRAIN_TEXTURE_MIN_ROWS);
+	if (num_thread > hardware_threads) {
+		num_thread = hardware_threads;
+	}
+
+	Thread_Run(num_thread, [&](uint32_t idx) {
+		int row_begin = (int)((int64_t)height * idx / num_thread);
+		int row_end = (int)((int64_t)height * (idx + 1) / num_thread);
+
+		std::vector<float> heights(vertex_count_per_edge);
+		std::vector<int> lut_index(width);
+		std::vector<float> lut_frac(width);
+
+		terrain_texture_row_s row;
+		row.lut_index_ = lut_index.data();
+		row.lut_frac_ = lut_frac.data();
+
+		for (int r = row_begin; r < row_end; ++r) {
+			float v = height > 1 ? (float)r / (height - 1) : 0.0f;
+
+			// heights interpolated between the two rows once, then along the row per pixel
+			int iy;
+			float fy;
+			GetSample(v, iy, fy);
+
+			const float* heights0 = terrain.heights_ + iy * vertex_count_per_edge;
+			const float* heights1 = heights0 + vertex_count_per_edge;
+			for (int x = 0; x < vertex_count_per_edge; ++x) {
+				heights[x] = heights0[x] + (heights1[x] - heights0[x]) * fy;
+			}
+
+			for (int col = 0; col < width; ++col) {
+				const terrain_texture_column_s& c = cols[col];
+				float z = heights[c.ix_] + (heights[c.ix_ + 1] - heights[c.ix_]) * c.fx_;
+
+				float t = (z - min_z) * lut_scale;
+				t = t < 0.0f ? 0.0f : (t > (float)TERRAIN_TEXTURE_LUT_SIZE ? (float)TERRAIN_TEXTURE_LUT_SIZE : t);
+
+				int i = (int)t;
+				i = i < TERRAIN_TEXTURE_LUT_SIZE ? i : TERRAIN_TEXTURE_LUT_SIZE - 1;
+
+				lut_index[col] = i;
+				lut_frac[col] = t - (float)i;
+			}
+
+			for (int k = 0; k < TERRAIN_TEXTURE_NUM_TILE; ++k) {
+				const image_s& image = tiles[k].image_;
+				row.texels_[k] = image.pixels_ + GetTexel(image.height_, v) * image.width_ * 4;
+			}
+
+			Row(texture.pixels_ + (size_t)r * width * 4, width, row, cols.data(), lut.data());
+		}
+	});
+
+	FreeTiles();
+
+	return true;
+}
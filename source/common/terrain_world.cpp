@@ -0,0 +1,369 @@
+/******************************************************************************
+ terrain_world.cpp
+
+   large terrains as a grid of tiles, generated on demand by the tile
+   generators of gen_terrain_*.cpp and kept in a LRU cache with a memory budget
+
+   tiles in use (acquired) are never evicted, the budget may be exceeded
+   while they are held
+ *****************************************************************************/
+
+#include "inc.h"
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+bool gen_tile_fault_formation(const terrain_world_params_s& params, uint32_t tile_x, uint32_t tile_y, float* heights);
+void gen_world_mid_point(const terrain_world_params_s& params, std::vector<float>& corners, float& lo, float& hi);
+bool gen_tile_mid_point(const terrain_world_params_s& params, const float* corners, float lo, float hi,
+	uint32_t tile_x, uint32_t tile_y, float* heights);
+
+struct terrain_tile_s {
+	uint32_t				tile_x_;
+	uint32_t				tile_y_;
+	float*					heights_;
+	int						ref_count_;
+	std::list<uint64_t>::iterator lru_;		// position in terrain_world_s::lru_
+};
+
+struct terrain_world_s {
+	terrain_world_params_s	params_;
+	uint32_t				vertex_count_x_;
+	uint32_t				vertex_count_y_;
+	uint64_t				tile_bytes_;
+
+	// mid-point
+	std::vector<float>		corners_;
+	float					lo_;
+	float					hi_;
+
+	std::mutex				mutex_;
+	std::unordered_map<uint64_t, terrain_tile_s> tiles_;
+	std::list<uint64_t>		lru_;	// most recently used first
+	uint64_t				bytes_;
+	uint64_t				hits_;
+	uint64_t				misses_;
+	uint64_t				evictions_;
+};
+
+static uint64_t TerrainWorld_Key(uint32_t tile_x, uint32_t tile_y) {
+	return ((uint64_t)tile_y << 32) | tile_x;
+}
+
+static bool TerrainWorld_GenerateTile(const terrain_world_s* world, uint32_t tile_x, uint32_t tile_y, float* heights) {
+	const terrain_world_params_s& params = world->params_;
+
+	switch (params.algo_) {
+	case terrain_gen_algorithm_t::FAULT_FORMATION:
+		return gen_tile_fault_formation(params, tile_x, tile_y, heights);
+	case terrain_gen_algorithm_t::MID_POINT:
+		return gen_tile_mid_point(params, world->corners_.data(), world->lo_, world->hi_, tile_x, tile_y, heights);
+	default:
+		printf("Unsupported terrain generation algorithm\n");
+		return false;
+	}
+}
+
+// drop the least recently used tiles not in use until the cache fits the budget
+// mutex_ locked
+static void TerrainWorld_Evict(terrain_world_s* world) {
+	auto it = world->lru_.end();
+
+	while (world->bytes_ > world->params_.cache_budget_ && it != world->lru_.begin()) {
+		--it;
+
+		auto tile = world->tiles_.find(*it);
+		if (tile->second.ref_count_ > 0) {
+			continue;
+		}
+
+		delete[] tile->second.heights_;
+		world->tiles_.erase(tile);
+
+		it = world->lru_.erase(it);
+
+		world->bytes_ -= world->tile_bytes_;
+		world->evictions_++;
+	}
+}
+
+// takes ownership of heights, frees them if the tile was inserted by another thread meanwhile
+// mutex_ locked
+static terrain_tile_s& TerrainWorld_Insert(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y, float* heights) {
+	uint64_t key = TerrainWorld_Key(tile_x, tile_y);
+
+	auto it = world->tiles_.find(key);
+	if (it != world->tiles_.end()) {
+		delete[] heights;
+		return it->second;
+	}
+
+	world->lru_.push_front(key);
+
+	terrain_tile_s& tile = world->tiles_[key];
+	tile.tile_x_ = tile_x;
+	tile.tile_y_ = tile_y;
+	tile.heights_ = heights;
+	tile.ref_count_ = 0;
+	tile.lru_ = world->lru_.begin();
+
+	world->bytes_ += world->tile_bytes_;
+
+	return tile;
+}
+
+COMMON_API terrain_world_s* Terrain_CreateWorld(const terrain_world_params_s& params) {
+	uint32_t tile_size = params.tile_size_;
+	if (tile_size < 32 || tile_size > 1024 || (tile_size & (tile_size - 1))) {
+		printf("Terrain_CreateWorld: bad tile size %u\n", tile_size);
+		return nullptr;
+	}
+
+	if (!params.num_tile_x_ || !params.num_tile_y_) {
+		printf("Terrain_CreateWorld: no tiles\n");
+		return nullptr;
+	}
+
+	// world coordinates are exact in float
+	if ((uint64_t)params.num_tile_x_ * tile_size >= (1u << 24) || (uint64_t)params.num_tile_y_ * tile_size >= (1u << 24)) {
+		printf("Terrain_CreateWorld: world too large\n");
+		return nullptr;
+	}
+
+	terrain_world_s* world = new terrain_world_s();
+
+	world->params_ = params;
+	world->vertex_count_x_ = params.num_tile_x_ * tile_size + 1;
+	world->vertex_count_y_ = params.num_tile_y_ * tile_size + 1;
+	world->tile_bytes_ = sizeof(float) * (uint64_t)(tile_size + 1) * (tile_size + 1);
+	world->lo_ = 0.0f;
+	world->hi_ = 0.0f;
+	world->bytes_ = 0;
+	world->hits_ = 0;
+	world->misses_ = 0;
+	world->evictions_ = 0;
+
+	if (params.algo_ == terrain_gen_algorithm_t::MID_POINT) {
+		gen_world_mid_point(params, world->corners_, world->lo_, world->hi_);
+	}
+
+	return world;
+}
+
+COMMON_API void Terrain_DestroyWorld(terrain_world_s* world) {
+	if (!world) {
+		return;
+	}
+
+	for (auto& it : world->tiles_) {
+		delete[] it.second.heights_;
+	}
+
+	delete world;
+}
+
+COMMON_API void Terrain_GetWorldSize(const terrain_world_s* world, uint32_t& vertex_count_x, uint32_t& vertex_count_y) {
+	vertex_count_x = world->vertex_count_x_;
+	vertex_count_y = world->vertex_count_y_;
+}
+
+COMMON_API bool Terrain_RequestTiles(terrain_world_s* world,
+	uint32_t tile_x0, uint32_t tile_y0, uint32_t tile_x1, uint32_t tile_y1)
+{
+	const terrain_world_params_s& params = world->params_;
+
+	tile_x1 = tile_x1 < params.num_tile_x_ ? tile_x1 : params.num_tile_x_;
+	tile_y1 = tile_y1 < params.num_tile_y_ ? tile_y1 : params.num_tile_y_;
+
+	std::vector<uint64_t> missing;
+
+	{
+		std::lock_guard<std::mutex> lock(world->mutex_);
+
+		for (uint32_t ty = tile_y0; ty < tile_y1; ++ty) {
+			for (uint32_t tx = tile_x0; tx < tile_x1; ++tx) {
+				uint64_t key = TerrainWorld_Key(tx, ty);
+				auto it = world->tiles_.find(key);
+				if (it != world->tiles_.end()) {
+					world->lru_.splice(world->lru_.begin(), world->lru_, it->second.lru_);
+					world->hits_++;
+				}
+				else {
+					missing.push_back(key);
+					world->misses_++;
+				}
+			}
+		}
+	}
+
+	if (missing.empty()) {
+		return true;
+	}
+
+	std::atomic<bool> ok = true;
+	uint32_t tile_count = (params.tile_size_ + 1) * (params.tile_size_ + 1);
+
+	// one job per tile
+	Job_ParallelFor(0, (uint32_t)missing.size(), 1, [&](uint32_t tile_begin, uint32_t tile_end) {
+		for (uint32_t i = tile_begin; i < tile_end; ++i) {
+			uint32_t tx = (uint32_t)(missing[i] & 0xFFFFFFFF);
+			uint32_t ty = (uint32_t)(missing[i] >> 32);
+
+			float* heights = new float[tile_count];
+			if (!TerrainWorld_GenerateTile(world, tx, ty, heights)) {
+				delete[] heights;
+				ok = false;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(world->mutex_);
+			TerrainWorld_Insert(world, tx, ty, heights);
+			TerrainWorld_Evict(world);
+		}
+	});
+
+	return ok;
+}
+
+// count: false when the hit was already counted by Terrain_RequestTiles
+static bool TerrainWorld_Acquire(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y, bool count, terrain_s& tile) {
+	uint64_t key = TerrainWorld_Key(tile_x, tile_y);
+
+	{
+		std::lock_guard<std::mutex> lock(world->mutex_);
+
+		auto it = world->tiles_.find(key);
+		if (it != world->tiles_.end()) {
+			it->second.ref_count_++;
+			world->lru_.splice(world->lru_.begin(), world->lru_, it->second.lru_);
+			world->hits_ += count ? 1 : 0;
+
+			tile.vertex_count_per_edge_ = (int)world->params_.tile_size_ + 1;
+			tile.heights_ = it->second.heights_;
+			return true;
+		}
+	}
+
+	float* heights = new float[(world->params_.tile_size_ + 1) * (world->params_.tile_size_ + 1)];
+	if (!TerrainWorld_GenerateTile(world, tile_x, tile_y, heights)) {
+		delete[] heights;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(world->mutex_);
+
+	world->misses_++;
+
+	// referenced before evicting, so it stays
+	terrain_tile_s& t = TerrainWorld_Insert(world, tile_x, tile_y, heights);
+	t.ref_count_++;
+
+	TerrainWorld_Evict(world);
+
+	tile.vertex_count_per_edge_ = (int)world->params_.tile_size_ + 1;
+	tile.heights_ = t.heights_;
+
+	return true;
+}
+
+COMMON_API bool Terrain_AcquireTile(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y, terrain_s& tile) {
+	tile.vertex_count_per_edge_ = 0;
+	tile.heights_ = nullptr;
+
+	if (tile_x >= world->params_.num_tile_x_ || tile_y >= world->params_.num_tile_y_) {
+		printf("Terrain_AcquireTile: tile (%u, %u) out of the world\n", tile_x, tile_y);
+		return false;
+	}
+
+	return TerrainWorld_Acquire(world, tile_x, tile_y, true, tile);
+}
+
+COMMON_API void Terrain_ReleaseTile(terrain_world_s* world, uint32_t tile_x, uint32_t tile_y) {
+	std::lock_guard<std::mutex> lock(world->mutex_);
+
+	auto it = world->tiles_.find(TerrainWorld_Key(tile_x, tile_y));
+	if (it == world->tiles_.end() || it->second.ref_count_ <= 0) {
+		printf("Terrain_ReleaseTile: tile (%u, %u) was not acquired\n", tile_x, tile_y);
+		return;
+	}
+
+	it->second.ref_count_--;
+
+	TerrainWorld_Evict(world);
+}
+
+COMMON_API bool Terrain_GetWorldRegion(terrain_world_s* world, uint32_t x, uint32_t y,
+	int vertex_count_per_edge, terrain_s& terrain)
+{
+	terrain.vertex_count_per_edge_ = 0;
+	terrain.heights_ = nullptr;
+
+	if (vertex_count_per_edge < 2
+		|| (uint64_t)x + vertex_count_per_edge > world->vertex_count_x_
+		|| (uint64_t)y + vertex_count_per_edge > world->vertex_count_y_)
+	{
+		printf("Terrain_GetWorldRegion: region out of the world\n");
+		return false;
+	}
+
+	uint32_t tile_size = world->params_.tile_size_;
+	uint32_t count = (uint32_t)vertex_count_per_edge;
+
+	// the last vertex of a tile is the first one of the next, prefer the next tile
+	// for the first vertices, the last tile of the world for the last vertex
+	auto TileOf = [tile_size](uint32_t v, uint32_t num_tile) {
+		uint32_t t = v / tile_size;
+		return t < num_tile ? t : num_tile - 1;
+	};
+
+	uint32_t tile_x0 = TileOf(x, world->params_.num_tile_x_);
+	uint32_t tile_y0 = TileOf(y, world->params_.num_tile_y_);
+	uint32_t tile_x1 = TileOf(x + count - 1, world->params_.num_tile_x_) + 1;
+	uint32_t tile_y1 = TileOf(y + count - 1, world->params_.num_tile_y_) + 1;
+
+	if (!Terrain_RequestTiles(world, tile_x0, tile_y0, tile_x1, tile_y1)) {
+		return false;
+	}
+
+	float* heights_buffer = new float[(size_t)count * count];
+
+	for (uint32_t ty = tile_y0; ty < tile_y1; ++ty) {
+		for (uint32_t tx = tile_x0; tx < tile_x1; ++tx) {
+			terrain_s tile = {};
+			if (!TerrainWorld_Acquire(world, tx, ty, false, tile)) {
+				delete[] heights_buffer;
+				return false;
+			}
+
+			// part of the tile inside the region, in world vertices
+			uint32_t x_begin = tx * tile_size > x ? tx * tile_size : x;
+			uint32_t y_begin = ty * tile_size > y ? ty * tile_size : y;
+			uint32_t x_end = (tx + 1) * tile_size < x + count - 1 ? (tx + 1) * tile_size : x + count - 1;
+			uint32_t y_end = (ty + 1) * tile_size < y + count - 1 ? (ty + 1) * tile_size : y + count - 1;
+
+			for (uint32_t wy = y_begin; wy <= y_end; ++wy) {
+				memcpy(heights_buffer + (size_t)(wy - y) * count + (x_begin - x),
+					tile.heights_ + (size_t)(wy - ty * tile_size) * (tile_size + 1) + (x_begin - tx * tile_size),
+					sizeof(float) * (x_end - x_begin + 1));
+			}
+
+			Terrain_ReleaseTile(world, tx, ty);
+		}
+	}
+
+	terrain.vertex_count_per_edge_ = vertex_count_per_edge;
+	terrain.heights_ = heights_buffer;
+
+	return true;
+}
+
+COMMON_API void Terrain_GetCacheStats(terrain_world_s* world, terrain_cache_stats_s& stats) {
+	std::lock_guard<std::mutex> lock(world->mutex_);
+
+	stats.num_tile_ = (uint32_t)world->tiles_.size();
+	stats.bytes_ = world->bytes_;
+	stats.hits_ = world->hits_;
+	stats.misses_ = world->misses_;
+	stats.evictions_ = world->evictions_;
+}
@@ -3,6 +3,8 @@
  *****************************************************************************/
 
 #include "../common/inc.h"
+#include <chrono>
+#include <algorithm>
 
 #ifndef COMMON_MODULE
 
@@ -58,6 +60,29 @@ void gen_terrain_tex() {
 	Terrain_Free(terrain);
 }
 
+static const char* pass_fail(bool ok) {
+	return ok ? "PASS" : "FAIL";
+}
+
+// calls func(level name) at every SIMD level the cpu supports up to max_level, scalar first,
+// the highest supported level is restored afterwards
+template<typename FUNC>
+static void for_each_simd_level(FUNC func, simd_level_t max_level = simd_level_t::AVX2) {
+	const simd_level_t LEVELS[] = { simd_level_t::SCALAR, simd_level_t::SSE2, simd_level_t::AVX2 };
+	const char* LEVEL_NAMES[] = { "scalar", "sse2", "avx2" };
+
+	for (int l = 0; l < 3 && LEVELS[l] <= max_level; ++l) {
+		Cpu_SetSIMDLevel(LEVELS[l]);
+		if (Cpu_GetSIMDLevel() != LEVELS[l]) {
+			continue;	// not supported
+		}
+
+		func(LEVEL_NAMES[l]);
+	}
+
+	Cpu_SetSIMDLevel(simd_level_t::AVX2);
+}
+
 void test_proj_mat(float z_near, float z_far) {
 	auto PrintMat = [z_near,z_far](const char* name, const glm::mat4& m) {
 		glm::vec4 v_near = glm::vec4(0.0f, 0.0f, -z_near, 1.0f);
@@ -279,19 +304,2201 @@ static void test_float16() {
 	}
 }
 
-int main(int argc, char** argv) {
-	Common_Init();
+// grid of n x n quads in groups of rows, every material in turn, every other row triangulated
+static bool write_synthetic_obj(const char* obj_filename, const char* mtl_filename, int n) {
+	const char* MATERIALS[] = { "stone", "grass", "bark" };
 
-	//test_proj_mat(1.0f, 16.0f);
-	//test_frustum();
+	FILE* f = File_Open(mtl_filename, "wb");
+	if (!f) {
+		return false;
+	}
 
-	//test();
+	for (int m = 0; m < (int)COUNT_OF(MATERIALS); ++m) {
+		fprintf(f, "newmtl %s\nKa 0.2 0.2 0.2\nKd 0.%d 0.5 0.5\nKs 1.0 1.0 1.0\nNs %d\nd 1.0\nmap_Kd %s.png\n\n",
+			MATERIALS[m], m + 1, 10 * (m + 1), MATERIALS[m]);
+	}
+	fclose(f);
 
-	//test_float16();
+	f = File_Open(obj_filename, "wb");
+	if (!f) {
+		return false;
+	}
 
-	//test_dds("ocean/perlin_noise.dds");
-	test_dds("ocean/sky_cube.dds");
-	//test_dds("ocean/reflect_cube.dds");
+	const char* mtl_name = strrchr(mtl_filename, '/');
+	fprintf(f, "# synthetic grid\nmtllib %s\n", mtl_name ? mtl_name + 1 : mtl_filename);
+
+	for (int y = 0; y <= n; ++y) {
+		for (int x = 0; x <= n; ++x) {
+			fprintf(f, "v %f %f %f\n", (float)x, sinf(x * 0.37f) * cosf(y * 0.21f), (float)y);
+		}
+	}
+	for (int y = 0; y <= n; ++y) {
+		for (int x = 0; x <= n; ++x) {
+			fprintf(f, "vt %f %f\n", (float)x / n, (float)y / n);
+		}
+	}
+	for (int y = 0; y <= n; ++y) {
+		for (int x = 0; x <= n; ++x) {
+			glm::vec3 normal = glm::normalize(glm::vec3(-0.37f * cosf(x * 0.37f) * cosf(y * 0.21f), 1.0f,
+				0.21f * sinf(x * 0.37f) * sinf(y * 0.21f)));
+			fprintf(f, "vn %f %f %f\n", normal.x, normal.y, normal.z);
+		}
+	}
+
+	const int ROWS_PER_GROUP = 16;
+
+	for (int y = 0; y < n; ++y) {
+		if (y % ROWS_PER_GROUP == 0) {
+			fprintf(f, "g rows_%d\nusemtl %s\n", y, MATERIALS[y / ROWS_PER_GROUP % (int)COUNT_OF(MATERIALS)]);
+		}
+
+		for (int x = 0; x < n; ++x) {
+			int i0 = y * (n + 1) + x + 1, i1 = i0 + 1, i2 = i1 + n + 1, i3 = i0 + n + 1;
+			if (y & 1) {
+				fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, i0, i1, i1, i1, i2, i2, i2);
+				fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, i0, i2, i2, i2, i3, i3, i3);
+			}
+			else {
+				fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, i0, i1, i1, i1, i2, i2, i2, i3, i3, i3);
+			}
+		}
+	}
+	fclose(f);
+
+	return true;
+}
+
+// byte for byte, the texture paths compared as strings (the bytes past them are undefined)
+static bool same_model(const model_s& a, const model_s& b) {
+	bool same = a.vertex_format_ == b.vertex_format_
+		&& a.num_vertex_ == b.num_vertex_
+		&& a.num_index_ == b.num_index_
+		&& a.num_parts_ == b.num_parts_
+		&& a.num_material_ == b.num_material_
+		&& memcmp(a.vertices_, b.vertices_, Model_GetVertexSize(a.vertex_format_) * a.num_vertex_) == 0
+		&& memcmp(a.indices_, b.indices_, sizeof(uint32_t) * a.num_index_) == 0
+		&& memcmp(a.parts_, b.parts_, sizeof(model_part_s) * a.num_parts_) == 0;
+
+	const size_t MATERIAL_VALUES = sizeof(model_material_s) - offsetof(model_material_s, ambient_);
+
+	for (uint32_t i = 0; same && i < a.num_material_; ++i) {
+		same = strcmp(a.materials_[i].tex_file_, b.materials_[i].tex_file_) == 0
+			&& memcmp(&a.materials_[i].ambient_, &b.materials_[i].ambient_, MATERIAL_VALUES) == 0;
+	}
+
+	return same;
+}
+
+static void test_obj_load_throughput() {
+	// more than one chunk of the parallel loader (1 MB each), serial and parallel results identical
+	const uint32_t NUM_THREADS[] = { 2, 3, 4, 7 };
+
+	if (write_synthetic_obj("./test_synthetic.obj", "./test_synthetic.mtl", 256)) {
+		uint64_t file_size = 0;
+		int64_t mtime = 0;
+		File_GetStat("./test_synthetic.obj", file_size, mtime);
+
+		Model_SetUseCache(false);
+
+		model_s serial = {};
+		Model_SetLoadThreadCount(1);
+		bool ok = Model_Load("./test_synthetic.obj", false, serial);
+
+		printf("synthetic %.2f MB, %u vertices, %u indices, %u parts, %u materials\n",
+			file_size / (1024.0 * 1024.0), serial.num_vertex_, serial.num_index_, serial.num_parts_, serial.num_material_);
+
+		for (uint32_t num_thread : NUM_THREADS) {
+			model_s parallel = {};
+			Model_SetLoadThreadCount(num_thread);
+			bool parallel_ok = ok && Model_Load("./test_synthetic.obj", false, parallel);
+
+			printf("synthetic %u threads: %s\n", num_thread,
+				!parallel_ok ? "load failed" : pass_fail(file_size > 2 * 1024 * 1024 && same_model(serial, parallel)));
+
+			Model_Free(parallel);
+		}
+
+		Model_Free(serial);
+		Model_SetLoadThreadCount(1);
+		Model_SetUseCache(true);
+	}
+	else {
+		printf("synthetic: could not write ./test_synthetic.obj\n");
+	}
+
+	const char* MODELS[] = {
+		"floor/floor.obj",
+		"low_poly_tree/Lowpoly_tree_sample.obj",
+		"tree/tree.obj",
+		"bixler/bixler.obj"
+	};
+
+	const int ROUNDS = 8;
+
+	for (const char* model : MODELS) {
+		char full_filename[MAX_PATH];
+		Str_SPrintf(full_filename, COUNT_OF(full_filename), "%s/models/%s",
+			GetDataFolder(), model);
+
+		void* data = nullptr;
+		int32_t file_size = 0;
+		if (!File_LoadBinary32(full_filename, data, file_size)) {
+			printf("%s: not found\n", model);
+			continue;
+		}
+		File_FreeBinary(data);
+
+		Obj::counts_s counts = {};
+
+		// pass 0: with counting pass, pass 1: sizes known in advance, pass 2: all threads
+		const char* PASS_NAMES[] = { "count", "hint ", "mt   " };
+
+		for (int pass = 0; pass < 3; ++pass) {
+			uint32_t num_pos = 0;
+
+			auto t0 = std::chrono::steady_clock::now();
+			for (int i = 0; i < ROUNDS; ++i) {
+				Obj obj;
+				if (!obj.Load(full_filename, pass == 1 ? &counts : nullptr, pass == 2 ? 0 : 1)) {
+					printf("%s: load failed\n", model);
+					return;
+				}
+				obj.GetCounts(counts);
+				num_pos = obj.NumberPos();
+			}
+			auto t1 = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(t1 - t0).count() / ROUNDS;
+
+			printf("%-40s %s %8.2f ms %9.2f MB/s %12.0f vertices/s\n", model,
+				PASS_NAMES[pass], seconds * 1000.0,
+				file_size / (1024.0 * 1024.0) / seconds, num_pos / seconds);
+		}
+	}
+}
+
+static void test_model_weld_report() {
+	const char* MODELS[] = {
+		"floor/floor.obj",
+		"low_poly_tree/Lowpoly_tree_sample.obj",
+		"tree/tree.obj",
+		"bixler/bixler.obj"
+	};
+
+	printf("%-40s %10s %10s %12s %12s %8s\n", "model", "corners", "welded", "bytes", "welded bytes", "ratio");
+
+	for (const char* model : MODELS) {
+		char full_filename[MAX_PATH];
+		Str_SPrintf(full_filename, COUNT_OF(full_filename), "%s/models/%s",
+			GetDataFolder(), model);
+
+		model_s m0 = {}, m1 = {};
+
+		Model_SetWeldVertices(false);
+		bool ok = Model_Load(full_filename, false, m0);
+
+		Model_SetWeldVertices(true);
+		ok = ok && Model_Load(full_filename, false, m1);
+
+		if (ok) {
+			size_t bytes0 = Model_GetVertexSize(m0.vertex_format_) * m0.num_vertex_ + sizeof(uint32_t) * m0.num_index_;
+			size_t bytes1 = Model_GetVertexSize(m1.vertex_format_) * m1.num_vertex_ + sizeof(uint32_t) * m1.num_index_;
+
+			printf("%-40s %10u %10u %12zu %12zu %7.2fx\n", model, m0.num_vertex_, m1.num_vertex_,
+				bytes0, bytes1, (double)bytes0 / bytes1);
+		}
+		else {
+			printf("%-40s load failed\n", model);
+		}
+
+		Model_Free(m1);
+		Model_Free(m0);
+	}
+}
+
+static void test_model_optimize() {
+	// grid of quads with shuffled triangles
+	const uint32_t N = 64;
+	const uint32_t CACHE_SIZE = 16;
+
+	model_s model = {};
+	model.vertex_format_ = vertex_format_t::VF_POS;
+	model.num_vertex_ = (N + 1) * (N + 1);
+	model.num_index_ = N * N * 6;
+	model.num_parts_ = 1;
+	model.vertices_ = TEMP_ALLOC(sizeof(vertex_pos_s) * model.num_vertex_);
+	model.indices_ = (uint32_t*)TEMP_ALLOC(sizeof(uint32_t) * model.num_index_);
+	model.parts_ = (model_part_s*)TEMP_ALLOC(sizeof(model_part_s));
+
+	vertex_pos_s* vertices = (vertex_pos_s*)model.vertices_;
+	for (uint32_t y = 0; y <= N; ++y) {
+		for (uint32_t x = 0; x <= N; ++x) {
+			vertices[y * (N + 1) + x].pos_ = glm::vec3((float)x, (float)y, 0.0f);
+		}
+	}
+
+	uint32_t* indices = model.indices_;
+	for (uint32_t y = 0; y < N; ++y) {
+		for (uint32_t x = 0; x < N; ++x) {
+			uint32_t v0 = y * (N + 1) + x;
+			uint32_t* quad = indices + (y * N + x) * 6;
+			quad[0] = v0; quad[1] = v0 + 1; quad[2] = v0 + N + 2;
+			quad[3] = v0 + N + 2; quad[4] = v0 + N + 1; quad[5] = v0;
+		}
+	}
+
+	SRand(1234);
+	for (uint32_t i = N * N * 2 - 1; i > 0; --i) {
+		uint32_t j = (Rand() * 32768 + Rand()) % (i + 1);
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t t = indices[i * 3 + k];
+			indices[i * 3 + k] = indices[j * 3 + k];
+			indices[j * 3 + k] = t;
+		}
+	}
+
+	model.parts_[0] = { VK_INVALID_INDEX, 0, model.num_index_ };
+
+	// triangles as position triples, to check nothing was lost or flipped
+	auto Triangles = [](const model_s& m) {
+		std::vector<std::array<float, 9>> tris(m.num_index_ / 3);
+		const vertex_pos_s* v = (const vertex_pos_s*)m.vertices_;
+		for (uint32_t i = 0; i < m.num_index_ / 3; ++i) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				const glm::vec3& p = v[m.indices_[i * 3 + k]].pos_;
+				tris[i][k * 3 + 0] = p.x;
+				tris[i][k * 3 + 1] = p.y;
+				tris[i][k * 3 + 2] = p.z;
+			}
+		}
+		std::sort(tris.begin(), tris.end());
+		return tris;
+	};
+
+	auto tris_before = Triangles(model);
+
+	model_optimize_stats_s stats = {};
+	bool ok = Model_Optimize(model, CACHE_SIZE, &stats);
+
+	bool same_triangles = ok && Triangles(model) == tris_before;
+
+	bool sequential = true;
+	uint32_t next_vertex = 0;
+	for (uint32_t i = 0; i < model.num_index_ && ok; ++i) {
+		if (model.indices_[i] > next_vertex) {
+			sequential = false;
+		}
+		else if (model.indices_[i] == next_vertex) {
+			next_vertex++;
+		}
+	}
+
+	printf("test_model_optimize: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, triangles %s, fetch %s: %s\n",
+		stats.acmr_before_, stats.acmr_after_, stats.atvr_before_, stats.atvr_after_,
+		same_triangles ? "kept" : "CHANGED", sequential ? "sequential" : "NOT SEQUENTIAL",
+		pass_fail(same_triangles && sequential && stats.acmr_after_ < stats.acmr_before_));
+
+	Model_Free(model);
+
+	// assets
+	const char* MODELS[] = {
+		"tree/tree.obj",
+		"bixler/bixler.obj",
+		"bun_zipper.ply"
+	};
+
+	for (const char* name : MODELS) {
+		char full_filename[MAX_PATH];
+		Str_SPrintf(full_filename, COUNT_OF(full_filename), "%s/models/%s",
+			GetDataFolder(), name);
+
+		model_s m = {};
+		if (Model_Load(full_filename, false, m) && Model_Optimize(m, CACHE_SIZE, &stats)) {
+			printf("%-20s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name,
+				stats.acmr_before_, stats.acmr_after_, stats.atvr_before_, stats.atvr_after_);
+		}
+		else {
+			printf("%-20s load failed\n", name);
+		}
+		Model_Free(m);
+	}
+}
+
+static void test_model_cache() {
+	const char* MODELS[] = {
+		"bun_zipper.ply",
+		"tree/tree.obj",
+		"bixler/bixler.obj"
+	};
+
+	printf("%-20s %10s %10s %7s %s\n", "model", "parse ms", "map ms", "mapped", "result");
+
+	for (const char* name : MODELS) {
+		char full_filename[MAX_PATH];
+		Str_SPrintf(full_filename, COUNT_OF(full_filename), "%s/models/%s",
+			GetDataFolder(), name);
+
+		model_s parsed = {}, cached = {};
+
+		auto t0 = std::chrono::steady_clock::now();
+
+		Model_SetUseCache(false);
+		bool ok = Model_Load(full_filename, false, parsed);
+
+		auto t1 = std::chrono::steady_clock::now();
+
+		ok = ok && Model_SaveCache(full_filename, parsed);
+		Model_SetUseCache(true);
+
+		auto t2 = std::chrono::steady_clock::now();
+
+		ok = ok && Model_Load(full_filename, false, cached);
+
+		auto t3 = std::chrono::steady_clock::now();
+
+		// the second load has to come from the mapped cache file, not from parsing the model again
+		bool mapped = ok && Model_IsMapped(cached, cached.vertices_) && Model_IsMapped(cached, cached.indices_);
+
+		bool same = ok && parsed.vertex_format_ == cached.vertex_format_
+			&& parsed.num_vertex_ == cached.num_vertex_
+			&& parsed.num_index_ == cached.num_index_
+			&& parsed.num_parts_ == cached.num_parts_
+			&& parsed.num_material_ == cached.num_material_
+			&& memcmp(parsed.vertices_, cached.vertices_, Model_GetVertexSize(parsed.vertex_format_) * parsed.num_vertex_) == 0
+			&& memcmp(parsed.indices_, cached.indices_, sizeof(uint32_t) * parsed.num_index_) == 0
+			&& memcmp(parsed.parts_, cached.parts_, sizeof(model_part_s) * parsed.num_parts_) == 0
+			&& memcmp(parsed.min_, cached.min_, sizeof(parsed.min_)) == 0
+			&& memcmp(parsed.max_, cached.max_, sizeof(parsed.max_)) == 0;
+
+		for (uint32_t i = 0; same && i < parsed.num_material_; ++i) {
+			same = strcmp(parsed.materials_[i].tex_file_, cached.materials_[i].tex_file_) == 0;
+		}
+
+		printf("%-20s %10.2f %10.2f %7s %s\n", name,
+			std::chrono::duration<double, std::milli>(t1 - t0).count(),
+			std::chrono::duration<double, std::milli>(t3 - t2).count(),
+			mapped ? "yes" : "no",
+			!ok ? "load failed" : pass_fail(mapped && same));
+
+		Model_Free(cached);
+		Model_Free(parsed);
+	}
+}
+
+// little endian: x y z [nx ny nz] [red green blue alpha as uchar], faces as list uchar int
+static bool write_binary_ply(const char* filename, const glm::vec3* positions, const glm::vec3* normals,
+	const glm::vec4* colors, uint32_t num_vertex, const uint32_t* indices, uint32_t num_triangle)
+{
+	FILE* f = File_Open(filename, "wb");
+	if (!f) {
+		return false;
+	}
+
+	fprintf(f, "ply\nformat binary_little_endian 1.0\nelement vertex %u\n", num_vertex);
+	fprintf(f, "property float x\nproperty float y\nproperty float z\n");
+	if (normals) {
+		fprintf(f, "property float nx\nproperty float ny\nproperty float nz\n");
+	}
+	if (colors) {
+		fprintf(f, "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n");
+	}
+	fprintf(f, "element face %u\nproperty list uchar int vertex_indices\nend_header\n", num_triangle);
+
+	std::vector<uint8_t> buffer;
+	const uint32_t BLOCK = 65536;
+
+	for (uint32_t first = 0; first < num_vertex; first += BLOCK) {
+		buffer.clear();
+		for (uint32_t i = first; i < num_vertex && i < first + BLOCK; ++i) {
+			const uint8_t* p = (const uint8_t*)&positions[i];
+			buffer.insert(buffer.end(), p, p + sizeof(glm::vec3));
+			if (normals) {
+				p = (const uint8_t*)&normals[i];
+				buffer.insert(buffer.end(), p, p + sizeof(glm::vec3));
+			}
+			if (colors) {
+				for (int k = 0; k < 4; ++k) {
+					buffer.push_back((uint8_t)(colors[i][k] * 255.0f + 0.5f));
+				}
+			}
+		}
+		fwrite(buffer.data(), 1, buffer.size(), f);
+	}
+
+	for (uint32_t first = 0; first < num_triangle; first += BLOCK) {
+		buffer.clear();
+		for (uint32_t i = first; i < num_triangle && i < first + BLOCK; ++i) {
+			buffer.push_back(3);
+			const uint8_t* p = (const uint8_t*)&indices[i * 3];
+			buffer.insert(buffer.end(), p, p + sizeof(uint32_t) * 3);
+		}
+		fwrite(buffer.data(), 1, buffer.size(), f);
+	}
+
+	return fclose(f) == 0;
+}
+
+// binary ply: compiled decode plan vs the property by property reference path
+static void test_ply_binary_decode() {
+	const char* BUNNY_FILENAME = "ply_bench_bunny.ply";
+	const char* SYNTHETIC_FILENAME = "ply_bench_10m.ply";
+
+	// bun_zipper.ply is ascii, convert it
+	{
+		char full_filename[MAX_PATH];
+		Str_SPrintf(full_filename, COUNT_OF(full_filename), "%s/models/bun_zipper.ply", GetDataFolder());
+
+		PLY ascii;
+		if (!ascii.Load(full_filename) || !write_binary_ply(BUNNY_FILENAME, ascii.GetPos(), nullptr, nullptr,
+			ascii.NumberVertex(), ascii.GetIndices(), ascii.NumberTriangle()))
+		{
+			printf("test_ply_binary_decode: could not write %s\n", BUNNY_FILENAME);
+			return;
+		}
+	}
+
+	// 10M points with normals and colors
+	{
+		const uint32_t NUM_VERTEX = 10 * 1000 * 1000;
+		const uint32_t NUM_TRIANGLE = NUM_VERTEX / 2;
+
+		std::vector<glm::vec3> positions(NUM_VERTEX), normals(NUM_VERTEX);
+		std::vector<glm::vec4> colors(NUM_VERTEX);
+		std::vector<uint32_t> indices(NUM_TRIANGLE * 3);
+
+		SRand(1234);
+		for (uint32_t i = 0; i < NUM_VERTEX; ++i) {
+			positions[i] = glm::vec3(RandNeg1Pos1(), RandNeg1Pos1(), RandNeg1Pos1()) * 100.0f;
+			normals[i] = glm::vec3(0.0f, 0.0f, 1.0f);
+			colors[i] = glm::vec4(Rand01(), Rand01(), Rand01(), 1.0f);
+		}
+		for (uint32_t i = 0; i < NUM_TRIANGLE; ++i) {
+			indices[i * 3 + 0] = i;
+			indices[i * 3 + 1] = i + 1;
+			indices[i * 3 + 2] = i + 2;
+		}
+
+		if (!write_binary_ply(SYNTHETIC_FILENAME, positions.data(), normals.data(), colors.data(),
+			NUM_VERTEX, indices.data(), NUM_TRIANGLE))
+		{
+			printf("test_ply_binary_decode: could not write %s\n", SYNTHETIC_FILENAME);
+			return;
+		}
+	}
+
+	printf("%-20s %10s %12s %12s %10s %s\n", "file", "vertices", "reference ms", "plan ms", "MB/s", "result");
+
+	for (const char* filename : { BUNNY_FILENAME, SYNTHETIC_FILENAME }) {
+		PLY reference, plan;
+
+		auto t0 = std::chrono::steady_clock::now();
+		bool ok = reference.Load(filename, false);
+		auto t1 = std::chrono::steady_clock::now();
+		ok = ok && plan.Load(filename, true);
+		auto t2 = std::chrono::steady_clock::now();
+
+		uint32_t n = plan.NumberVertex();
+		bool same = ok && n == reference.NumberVertex()
+			&& plan.NumberTriangle() == reference.NumberTriangle()
+			&& memcmp(plan.GetPos(), reference.GetPos(), sizeof(glm::vec3) * n) == 0
+			&& memcmp(plan.GetNormal(), reference.GetNormal(), sizeof(glm::vec3) * n) == 0
+			&& (!plan.GetColor() || memcmp(plan.GetColor(), reference.GetColor(), sizeof(glm::vec4) * n) == 0)
+			&& memcmp(plan.GetIndices(), reference.GetIndices(), sizeof(uint32_t) * 3 * plan.NumberTriangle()) == 0;
+
+		FILE* f = File_Open(filename, "rb");
+		double mb = 0.0;
+		if (f) {
+			fseek(f, 0, SEEK_END);
+			mb = ftell(f) / (1024.0 * 1024.0);
+			fclose(f);
+		}
+
+		double reference_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+		double plan_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+		printf("%-20s %10u %12.2f %12.2f %10.1f %s\n", filename, n, reference_ms, plan_ms,
+			mb / (plan_ms * 0.001), !ok ? "load failed" : pass_fail(same));
+
+		remove(filename);
+	}
+}
+
+// FIR erosion as it was before blocking: left to right, right to left, top to bottom, bottom to top
+static void reference_erode(float* heights, uint32_t n, float filter) {
+	auto FilterHeightBand = [](float* band, uint32_t step, uint32_t count, float filter) {
+		float v = band[0];
+		for (uint32_t i = 1; i < count; ++i) {
+			band[i * step] = filter * v + (1 - filter) * band[i * step];
+			v = band[i * step];
+		}
+	};
+
+	for (uint32_t i = 0; i < n; ++i) {
+		FilterHeightBand(heights + i, n, n, filter);
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		FilterHeightBand(heights + n - i - 1, n, n, filter);
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		FilterHeightBand(heights + n * (n - 1) - i * n, 1, n, filter);
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		FilterHeightBand(heights + i * n, 1, n, filter);
+	}
+}
+
+// the generator seeded terrains were always made with, its own copy so a change of Rand() shows
+struct legacy_rand_s {
+	uint32_t				next_;
+
+	uint32_t Rand() {
+		next_ = next_ * 1103515245 + 12345;
+		return next_ / 65536 % 32768;
+	}
+
+	float Rand01() {
+		return Rand() / 32767.0f;
+	}
+};
+
+// fault formation as it was before vectorization: every fault line over the whole grid
+static void reference_fault_formation(uint32_t n, float min_z, float max_z, int iterations, uint32_t seed, std::vector<float>& heights) {
+	heights.assign((size_t)n * n, 0.0f);
+
+	legacy_rand_s rand = { seed };
+
+	auto GetRandomVec2 = [n, &rand](int edge) -> glm::vec2 {
+		float dim = (float)(n - 1);
+		switch (edge) {
+		case 0:
+			return glm::vec2(dim * rand.Rand01(), 0.0f);
+		case 1:
+			return glm::vec2(dim, dim * rand.Rand01());
+		case 2:
+			return glm::vec2(dim * rand.Rand01(), dim);
+		default:
+			return glm::vec2(0.0f, dim * rand.Rand01());
+		}
+	};
+
+	for (int i = 0; i < iterations; ++i) {
+		float add_z = max_z - ((max_z - min_z) * i / iterations);
+
+		int edge0 = rand.Rand() % 4;
+		int edge1 = (edge0 + (rand.Rand() % 3) + 1) % 4;
+
+		glm::vec2 pt0 = GetRandomVec2(edge0);
+		glm::vec2 pt1 = GetRandomVec2(edge1);
+		glm::vec2 pt1_pt0 = pt1 - pt0;
+
+		for (uint32_t y = 0; y < n; ++y) {
+			for (uint32_t x = 0; x < n; ++x) {
+				glm::vec3 c = glm::cross(glm::vec3(glm::vec2(x, y) - pt0, 0.0f), glm::vec3(pt1_pt0, 0.0f));
+				if (c.z > 0.0f) {
+					heights[y * n + x] += add_z;
+				}
+			}
+		}
+	}
+
+	reference_erode(heights.data(), n, 0.33f);
+}
+
+static void test_terrain_fault_formation() {
+	const float TOLERANCE = 1.0e-5f;
+
+	for (terrain_size_t sz : { terrain_size_t::TS_32, terrain_size_t::TS_128, terrain_size_t::TS_1K }) {
+		uint32_t n = Terrain_GetVertexCountPerEdge(sz);
+
+		terrain_gen_params_s params = {
+			.algo_ = terrain_gen_algorithm_t::FAULT_FORMATION,
+			.sz_ = sz,
+			.min_z_ = 0.0f,
+			.max_z_ = 2.5f,
+			.iterations_ = 128,
+			.filter_ = 0.4f,
+			.roughness_ = 0.0f
+		};
+
+		std::vector<float> reference;
+
+		auto t0 = std::chrono::steady_clock::now();
+		reference_fault_formation(n, params.min_z_, params.max_z_, params.iterations_, 2024, reference);
+		auto t1 = std::chrono::steady_clock::now();
+
+		printf("%5u reference %8.2f ms\n", n, std::chrono::duration<double, std::milli>(t1 - t0).count());
+
+		for_each_simd_level([&](const char* level_name) {
+			terrain_s terrain = {};
+
+			auto t2 = std::chrono::steady_clock::now();
+			SRand(2024);
+			bool ok = Terrain_Generate(params, terrain);
+			auto t3 = std::chrono::steady_clock::now();
+
+			float max_diff = 0.0f;
+			uint32_t num_exact = 0;
+			for (uint32_t i = 0; ok && i < n * n; ++i) {
+				float diff = fabsf(terrain.heights_[i] - reference[i]);
+				max_diff = diff > max_diff ? diff : max_diff;
+				num_exact += terrain.heights_[i] == reference[i] ? 1 : 0;
+			}
+
+			printf("%5u %-9s %8.2f ms, max diff %g, %u / %u exact: %s\n", n, level_name,
+				std::chrono::duration<double, std::milli>(t3 - t2).count(), max_diff, num_exact, n * n,
+				pass_fail(ok && max_diff <= TOLERANCE));
+
+			Terrain_Free(terrain);
+		});
+	}
+}
+
+static void test_terrain_erode() {
+	// odd sizes leave partial tiles and partial row blocks
+	for (uint32_t n : { 2u, 7u, 33u, 100u, 1025u, 2049u }) {
+		std::vector<float> source((size_t)n * n);
+		SRand(n);
+		for (float& h : source) {
+			h = Rand01() * 10.0f - 5.0f;
+		}
+
+		std::vector<float> reference = source;
+
+		auto t0 = std::chrono::steady_clock::now();
+		reference_erode(reference.data(), n, 0.33f);
+		auto t1 = std::chrono::steady_clock::now();
+
+		printf("%5u reference %8.2f ms\n", n, std::chrono::duration<double, std::milli>(t1 - t0).count());
+
+		for_each_simd_level([&](const char* level_name) {
+			std::vector<float> heights = source;
+			terrain_s terrain = { (int)n, heights.data() };
+
+			auto t2 = std::chrono::steady_clock::now();
+			Terrain_Erode(terrain, 0.33f);
+			auto t3 = std::chrono::steady_clock::now();
+
+			bool same = memcmp(heights.data(), reference.data(), sizeof(float) * n * n) == 0;
+
+			printf("%5u %-9s %8.2f ms: %s\n", n, level_name,
+				std::chrono::duration<double, std::milli>(t3 - t2).count(), pass_fail(same));
+		});
+	}
+}
+
+static void test_terrain_quantize() {
+	const terrain_height_format_t FORMATS[] = {
+		terrain_height_format_t::FLOAT32, terrain_height_format_t::UNORM16,
+		terrain_height_format_t::FLOAT16, terrain_height_format_t::BLOCK_DELTA
+	};
+	const char* FORMAT_NAMES[] = { "float32", "unorm16", "float16", "block delta" };
+
+	const float MAX_Z = 64.0f;
+
+	for (terrain_size_t sz : { terrain_size_t::TS_32, terrain_size_t::TS_512, terrain_size_t::TS_4K }) {
+		terrain_gen_params_s params = {
+			.algo_ = terrain_gen_algorithm_t::MID_POINT,
+			.sz_ = sz,
+			.min_z_ = 0.0f,
+			.max_z_ = MAX_Z,
+			.iterations_ = 0,
+			.filter_ = 0.0f,
+			.roughness_ = 0.75f
+		};
+
+		SRand(3);
+
+		terrain_s terrain = {};
+		if (!Terrain_Generate(params, terrain)) {
+			printf("Terrain_Generate failed\n");
+			continue;
+		}
+
+		int n = terrain.vertex_count_per_edge_;
+		size_t float_size = sizeof(float) * n * n;
+
+		// half a step of the 16 bit formats, half float spacing at the top of the range, the largest block shift,
+		// plus the float rounding of the decode
+		float step = MAX_Z / 65535.0f;
+		float ulp = MAX_Z * FLT_EPSILON;
+		const float MAX_ERRORS[] = { 0.0f, step * 0.5f + ulp, MAX_Z / 2048.0f, step * 128.5f + ulp };
+
+		for (int f = 0; f < 4; ++f) {
+			terrain_packed_s reference = {};
+
+			for_each_simd_level([&](const char* level_name) {
+				terrain_packed_s packed = {};
+
+				auto t0 = std::chrono::steady_clock::now();
+				bool ok = Terrain_Pack(terrain, FORMATS[f], 0.0f, MAX_Z, packed);
+				auto t1 = std::chrono::steady_clock::now();
+
+				ok = ok && packed.max_error_ <= MAX_ERRORS[f];
+				if (!reference.data_) {
+					reference = packed;
+				}
+				else {
+					ok = ok && packed.size_ == reference.size_ && memcmp(packed.data_, reference.data_, packed.size_) == 0;
+					Terrain_FreePacked(packed);
+				}
+
+				printf("%4d %-11s %-6s %10zu bytes %6.2fx max error %9.6f rms %9.6f %8.2f ms: %s\n", n,
+					FORMAT_NAMES[f], level_name, reference.size_, (double)float_size / reference.size_,
+					reference.max_error_, reference.rms_error_,
+					std::chrono::duration<double, std::milli>(t1 - t0).count(), pass_fail(ok));
+			});
+
+			Terrain_FreePacked(reference);
+		}
+
+		Terrain_Free(terrain);
+	}
+}
+
+static void test_terrain_world() {
+	for (terrain_gen_algorithm_t algo : { terrain_gen_algorithm_t::FAULT_FORMATION, terrain_gen_algorithm_t::MID_POINT }) {
+		terrain_world_params_s params = {
+			.algo_ = algo,
+			.tile_size_ = 128,
+			.num_tile_x_ = 6,
+			.num_tile_y_ = 4,
+			.seed_ = 2024,
+			.min_z_ = 0.0f,
+			.max_z_ = 2.5f,
+			.iterations_ = 256,
+			.filter_ = 0.33f,
+			.roughness_ = 1.0f,
+			.cache_budget_ = 4 * sizeof(float) * 129 * 129	// 4 tiles
+		};
+
+		terrain_world_s* world = Terrain_CreateWorld(params);
+		if (!world) {
+			printf("Could not create world\n");
+			return;
+		}
+
+		uint32_t vertex_count_x = 0, vertex_count_y = 0;
+		Terrain_GetWorldSize(world, vertex_count_x, vertex_count_y);
+
+		// every tile, the vertices shared by neighbor tiles must get the same heights
+		std::vector<float> heights((size_t)vertex_count_x * vertex_count_y, NAN);
+		uint32_t num_seam_diff = 0;
+
+		auto t0 = std::chrono::steady_clock::now();
+
+		for (uint32_t ty = 0; ty < params.num_tile_y_; ++ty) {
+			for (uint32_t tx = 0; tx < params.num_tile_x_; ++tx) {
+				terrain_s tile = {};
+				if (!Terrain_AcquireTile(world, tx, ty, tile)) {
+					printf("Could not acquire tile (%u, %u)\n", tx, ty);
+					Terrain_DestroyWorld(world);
+					return;
+				}
+
+				for (uint32_t y = 0; y <= params.tile_size_; ++y) {
+					for (uint32_t x = 0; x <= params.tile_size_; ++x) {
+						float h = tile.heights_[y * tile.vertex_count_per_edge_ + x];
+						float& w = heights[(size_t)(ty * params.tile_size_ + y) * vertex_count_x + tx * params.tile_size_ + x];
+						num_seam_diff += (!isnan(w) && w != h) ? 1 : 0;
+						w = h;
+					}
+				}
+
+				Terrain_ReleaseTile(world, tx, ty);
+			}
+		}
+
+		auto t1 = std::chrono::steady_clock::now();
+
+		// a window across tiles, most of them evicted and generated again
+		const int REGION_SIZE = 300;
+		uint32_t region_x = 100, region_y = 50;
+		uint32_t num_region_diff = 0;
+
+		terrain_s region = {};
+		if (Terrain_GetWorldRegion(world, region_x, region_y, REGION_SIZE, region)) {
+			for (int y = 0; y < REGION_SIZE; ++y) {
+				for (int x = 0; x < REGION_SIZE; ++x) {
+					float h = heights[(size_t)(region_y + y) * vertex_count_x + region_x + x];
+					num_region_diff += region.heights_[y * REGION_SIZE + x] != h ? 1 : 0;
+				}
+			}
+
+			Terrain_Free(region);
+		}
+		else {
+			num_region_diff = REGION_SIZE * REGION_SIZE;
+		}
+
+		terrain_cache_stats_s stats = {};
+		Terrain_GetCacheStats(world, stats);
+
+		printf("%-15s %ux%u vertices, %6.2f ms per tile, seam diff %u, region diff %u, cache %u tiles %llu bytes, hits %llu, misses %llu, evictions %llu: %s\n",
+			algo == terrain_gen_algorithm_t::FAULT_FORMATION ? "fault formation" : "mid-point",
+			vertex_count_x, vertex_count_y,
+			std::chrono::duration<double, std::milli>(t1 - t0).count() / (params.num_tile_x_ * params.num_tile_y_),
+			num_seam_diff, num_region_diff, stats.num_tile_, (unsigned long long)stats.bytes_,
+			(unsigned long long)stats.hits_, (unsigned long long)stats.misses_, (unsigned long long)stats.evictions_,
+			pass_fail(num_seam_diff == 0 && num_region_diff == 0 && stats.bytes_ <= params.cache_budget_));
+
+		Terrain_DestroyWorld(world);
+	}
+}
+
+// Terrain_Texture as it was before the weight table: per pixel weights, nearest or bilinear heights
+static bool reference_terrain_texture(const image_s* tile_images, const terrain_s& terrain, int width, int height,
+	bool bilinear, image_s& texture)
+{
+	struct tile_s {
+		float		full_lower_;
+		float		full_upper_;
+		float		vanish_lower_;
+		float		vanish_upper_;
+	} tiles[4] = {};
+
+	auto GetPrecentage = [](const tile_s& tile, float z) -> float {
+		if (z > tile.vanish_upper_ || z < tile.vanish_lower_) {
+			return 0.0f;
+		}
+		if (z > tile.full_upper_) {
+			return (tile.vanish_upper_ - z) / (tile.vanish_upper_ - tile.full_upper_);
+		}
+		if (z < tile.full_lower_) {
+			return (z - tile.vanish_lower_) / (tile.full_lower_ - tile.vanish_lower_);
+		}
+		return 1.0f;
+	};
+
+	auto GetPixel = [](const image_s& image, float u, float v) -> glm::uvec3 {
+		int x = int((image.width_ * u) + 0.5f);
+		int y = int((image.height_ * v) + 0.5f);
+		x = x >= image.width_ ? image.width_ - 1 : x;
+		y = y >= image.height_ ? image.height_ - 1 : y;
+		const byte_t* pixel = image.pixels_ + y * image.width_ * 4 + x * 4;
+		return glm::uvec3(pixel[0], pixel[1], pixel[2]);
+	};
+
+	int n = terrain.vertex_count_per_edge_;
+
+	float min_z = 9999999999.0f;
+	float max_z = -9999999999.0f;
+	for (int i = 0; i < n * n; ++i) {
+		min_z = terrain.heights_[i] < min_z ? terrain.heights_[i] : min_z;
+		max_z = terrain.heights_[i] > max_z ? terrain.heights_[i] : max_z;
+	}
+
+	float step = (max_z - min_z) / 7.0f;
+	for (int i = 0; i < 4; ++i) {
+		tiles[i].full_lower_ = min_z + step * 2.0f * i;
+		tiles[i].full_upper_ = tiles[i].full_lower_ + step;
+		tiles[i].vanish_lower_ = tiles[i].full_lower_ - step;
+		tiles[i].vanish_upper_ = tiles[i].full_upper_ + step;
+	}
+
+	if (!Img_Create(width, height, image_format_t::R8G8B8A8, texture)) {
+		return false;
+	}
+
+	for (int row = 0; row < height; ++row) {
+		float v = (float)row / (height - 1);
+		float y = v * (n - 1);
+		for (int col = 0; col < width; ++col) {
+			float u = (float)col / (width - 1);
+			float x = u * (n - 1);
+
+			int ix = (int)x;
+			int iy = (int)y;
+
+			float z = terrain.heights_[iy * n + ix];
+
+			if (bilinear) {
+				ix = ix < n - 2 ? ix : n - 2;
+				iy = iy < n - 2 ? iy : n - 2;
+				float fx = x - (float)ix, fy = y - (float)iy;
+				const float* h0 = terrain.heights_ + iy * n;
+				const float* h1 = h0 + n;
+				float z0 = h0[ix] + (h0[ix + 1] - h0[ix]) * fx;
+				float z1 = h1[ix] + (h1[ix + 1] - h1[ix]) * fx;
+				z = z0 + (z1 - z0) * fy;
+			}
+
+			glm::vec3 combined = glm::vec3(0.0f);
+			for (int i = 0; i < 4; ++i) {
+				glm::uvec3 pixel = GetPixel(tile_images[i], u, v);
+				float percentage = GetPrecentage(tiles[i], z);
+				combined.r += (float)pixel.r * percentage;
+				combined.g += (float)pixel.g * percentage;
+				combined.b += (float)pixel.b * percentage;
+			}
+
+			byte_t* dst_pixel = texture.pixels_ + row * width * 4 + col * 4;
+			dst_pixel[0] = (byte_t)(combined.r > 255.0f ? 255.0f : combined.r);
+			dst_pixel[1] = (byte_t)(combined.g > 255.0f ? 255.0f : combined.g);
+			dst_pixel[2] = (byte_t)(combined.b > 255.0f ? 255.0f : combined.b);
+			dst_pixel[3] = 255;
+		}
+	}
+
+	return true;
+}
+
+static void test_terrain_texture() {
+	terrain_gen_params_s terrain_gen_params = {
+		.algo_ = terrain_gen_algorithm_t::FAULT_FORMATION,
+		.sz_ = terrain_size_t::TS_512,
+		.min_z_ = 0.0f,
+		.max_z_ = 2.5f,
+		.iterations_ = 128,
+		.filter_ = 0.4f,
+		.roughness_ = 0.0f
+	};
+
+	terrain_s terrain = {};
+	if (!Terrain_Generate(terrain_gen_params, terrain)) {
+		return;
+	}
+
+	const char* data_foler = GetDataFolder();
+
+	terrain_texture_tiles_s tiles;
+	Str_SPrintf(tiles.lowest_, MAX_PATH, "%s/textures/terrain/lowestTile.tga", data_foler);
+	Str_SPrintf(tiles.low_, MAX_PATH, "%s/textures/terrain/lowTile.tga", data_foler);
+	Str_SPrintf(tiles.high_, MAX_PATH, "%s/textures/terrain/HighTile.tga", data_foler);
+	Str_SPrintf(tiles.hightest_, MAX_PATH, "%s/textures/terrain/highestTile.tga", data_foler);
+
+	image_s tile_images[4] = {};
+	const char* tile_files[4] = { tiles.lowest_, tiles.low_, tiles.high_, tiles.hightest_ };
+	for (int i = 0; i < 4; ++i) {
+		if (!Img_Load(tile_files[i], tile_images[i])) {
+			for (int j = 0; j < i; ++j) {
+				Img_Free(tile_images[j]);
+			}
+			Terrain_Free(terrain);
+			return;
+		}
+	}
+
+	auto Ms = [](auto t0, auto t1) {
+		return std::chrono::duration<double, std::milli>(t1 - t0).count();
+	};
+
+	// max and mean channel difference
+	auto Compare = [](const image_s& a, const image_s& b, int& max_diff, double& mean_diff) {
+		size_t count = (size_t)a.width_ * a.height_ * 4;
+		uint64_t sum = 0;
+		max_diff = 0;
+		for (size_t i = 0; i < count; ++i) {
+			int d = abs((int)a.pixels_[i] - (int)b.pixels_[i]);
+			max_diff = d > max_diff ? d : max_diff;
+			sum += d;
+		}
+		mean_diff = (double)sum / count;
+	};
+
+	for (int size : { 512, 2048, 8192 }) {
+		image_s nearest = {}, bilinear = {}, texture = {};
+
+		auto t0 = std::chrono::steady_clock::now();
+		reference_terrain_texture(tile_images, terrain, size, size, false, nearest);
+		auto t1 = std::chrono::steady_clock::now();
+		reference_terrain_texture(tile_images, terrain, size, size, true, bilinear);
+		auto t2 = std::chrono::steady_clock::now();
+
+		printf("%5d^2 reference %9.2f ms, reference bilinear %9.2f ms\n", size, Ms(t0, t1), Ms(t1, t2));
+
+		for_each_simd_level([&](const char* level_name) {
+			auto t3 = std::chrono::steady_clock::now();
+			bool ok = Terrain_Texture(tiles, terrain, size, size, texture);
+			auto t4 = std::chrono::steady_clock::now();
+
+			if (!ok) {
+				printf("Terrain_Texture failed\n");
+				return;
+			}
+
+			// against bilinear only the weight table differs, against nearest the heights as well
+			int max_diff_bilinear = 0, max_diff_nearest = 0;
+			double mean_diff_bilinear = 0.0, mean_diff_nearest = 0.0;
+			Compare(texture, bilinear, max_diff_bilinear, mean_diff_bilinear);
+			Compare(texture, nearest, max_diff_nearest, mean_diff_nearest);
+
+			printf("%5d^2 %-6s %9.2f ms (tile loading included), vs bilinear: max %d mean %.4f, vs nearest: max %d mean %.4f: %s\n",
+				size, level_name, Ms(t3, t4),
+				max_diff_bilinear, mean_diff_bilinear, max_diff_nearest, mean_diff_nearest,
+				pass_fail(max_diff_bilinear <= 1));
+
+			Img_Free(texture);
+		}, simd_level_t::SSE2);
+
+		Img_Free(nearest);
+		Img_Free(bilinear);
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		Img_Free(tile_images[i]);
+	}
+
+	Terrain_Free(terrain);
+}
+
+// DDS file with a legacy FourCC header, or a DX10 header when dxgi_format is not 0
+static bool write_test_dds(const char* filename, uint32_t width, uint32_t height, uint32_t mip_levels,
+	uint32_t four_cc, uint32_t dxgi_format, bool cubemap, const void* data, size_t data_size)
+{
+	const uint32_t DX10 = 0x30315844;	// "DX10"
+
+	uint32_t head[1 + 31] = {};
+	head[0] = 0x20534444;				// "DDS "
+	head[1] = 124;						// dwSize
+	head[2] = 0x00001007 | (mip_levels > 1 ? 0x00020000 : 0);
+	head[3] = height;
+	head[4] = width;
+	head[7] = mip_levels;
+	head[19] = 32;						// ddspf.dwSize
+	head[20] = 0x00000004;				// DDPF_FOURCC
+	head[21] = dxgi_format ? DX10 : four_cc;
+	head[27] = 0x00001000 | (mip_levels > 1 ? 0x00400008 : 0) | (cubemap ? 0x00000008 : 0);
+	head[28] = cubemap && !dxgi_format ? 0x0000fe00 : 0;
+
+	// dxgiFormat, resourceDimension (2D), miscFlag (cube), arraySize, reserved
+	uint32_t dx10[5] = { dxgi_format, 3, cubemap ? 4u : 0u, 1, 0 };
+
+	FILE* f = File_Open(filename, "wb");
+	if (!f) {
+		return false;
+	}
+
+	fwrite(head, sizeof(head), 1, f);
+	if (dxgi_format) {
+		fwrite(dx10, sizeof(dx10), 1, f);
+	}
+	fwrite(data, data_size, 1, f);
+	fclose(f);
+
+	return true;
+}
+
+static void test_dds_compressed() {
+	const char* FILENAME = "test_compressed.dds";
+
+	// 128 bit blocks packed from the least significant bit
+	struct block_writer_s {
+		byte_t		bytes_[16];
+		int			pos_;
+
+		void Write(uint32_t value, int count) {
+			for (int k = 0; k < count; ++k, ++pos_) {
+				bytes_[pos_ >> 3] |= ((value >> k) & 1) << (pos_ & 7);
+			}
+		}
+	};
+
+	auto Texel = [](const image_s& image, int x, int y) -> const byte_t* {
+		return image.pixels_ + ((size_t)y * image.width_ + x) * 4;
+	};
+
+	auto Report = [](const char* name, bool ok) {
+		printf("%-32s %s\n", name, pass_fail(ok));
+	};
+
+	// BC1 8x8, 4 levels: 4 opaque blocks (row y uses color index y), then 3 transparent blocks
+	{
+		byte_t blocks[7][8] = {};
+		for (int i = 0; i < 7; ++i) {
+			uint16_t c0 = i < 4 ? 0xf800 : 0x001f;		// red, blue
+			uint16_t c1 = i < 4 ? 0x001f : 0xf800;
+			uint32_t indices = i < 4 ? 0xffaa5500 : 0xffffffff;
+			memcpy(blocks[i], &c0, 2);
+			memcpy(blocks[i] + 2, &c1, 2);
+			memcpy(blocks[i] + 4, &indices, 4);
+		}
+
+		const byte_t COLORS[4][4] = { { 255, 0, 0, 255 }, { 0, 0, 255, 255 }, { 170, 0, 85, 255 }, { 85, 0, 170, 255 } };
+
+		image_s image = {};
+		bool ok = write_test_dds(FILENAME, 8, 8, 4, 0x31545844 /* DXT1 */, 0, false, blocks, sizeof(blocks))
+			&& Img_LoadCompressed(FILENAME, image);
+
+		ok = ok && image.format_ == image_format_t::BC1_UNORM && image.mip_levels_ == 4 && image.array_layers_ == 1
+			&& Img_GetDataSize(image) == sizeof(blocks) && Img_GetSubresourceOffset(image, 0, 3) == 48;
+
+		image_s level0 = {}, level3 = {}, legacy = {};
+		ok = ok && Img_Decompress(image, 0, 0, level0) && Img_Decompress(image, 0, 3, level3);
+		ok = ok && level3.width_ == 1 && level3.height_ == 1 && memcmp(Texel(level3, 0, 0), "\0\0\0\0", 4) == 0;
+
+		// Img_Load decodes level 0 with rows from the bottom, as it always did
+		ok = ok && Img_Load(FILENAME, legacy) && legacy.format_ == image_format_t::R8G8B8A8;
+
+		for (int y = 0; ok && y < 8; ++y) {
+			for (int x = 0; ok && x < 8; ++x) {
+				ok = memcmp(Texel(level0, x, y), COLORS[y & 3], 4) == 0
+					&& memcmp(Texel(legacy, x, 7 - y), COLORS[y & 3], 4) == 0;
+			}
+		}
+
+		Report("BC1 levels, 3 color mode", ok);
+
+		Img_Free(legacy);
+		Img_Free(level3);
+		Img_Free(level0);
+		Img_Free(image);
+	}
+
+	// BC7 mode 6: endpoints (255, 1, 129, 255) ~ (0, 254, 128, 254), texel i uses index i
+	{
+		block_writer_s block = {};
+		block.Write(1 << 6, 7);
+		for (uint32_t v : { 127, 0, 0, 127, 64, 64, 127, 127 }) {
+			block.Write(v, 7);
+		}
+		block.Write(1, 1);
+		block.Write(0, 1);
+		for (int i = 0; i < 16; ++i) {
+			block.Write(i, i == 0 ? 3 : 4);
+		}
+
+		const int E0[4] = { 255, 1, 129, 255 };
+		const int E1[4] = { 0, 254, 128, 254 };
+		const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		image_s image = {}, decompressed = {};
+		bool ok = write_test_dds(FILENAME, 4, 4, 1, 0, 98 /* DXGI_FORMAT_BC7_UNORM */, false, block.bytes_, 16)
+			&& Img_LoadCompressed(FILENAME, image) && image.format_ == image_format_t::BC7_UNORM
+			&& Img_Decompress(image, 0, 0, decompressed);
+
+		for (int i = 0; ok && i < 16; ++i) {
+			const byte_t* texel = Texel(decompressed, i & 3, i >> 2);
+			for (int c = 0; c < 4; ++c) {
+				ok = ok && texel[c] == (E0[c] * (64 - WEIGHTS[i]) + E1[c] * WEIGHTS[i] + 32) >> 6;
+			}
+		}
+
+		Report("BC7 mode 6", ok);
+
+		Img_Free(decompressed);
+		Img_Free(image);
+	}
+
+	// BC6H mode 11 (10 bit endpoints, unsigned): 0 ~ 1023, the largest half float at the far end
+	{
+		block_writer_s block = {};
+		block.Write(0x03, 5);
+		for (uint32_t v : { 0, 0, 0, 1023, 1023, 1023 }) {
+			block.Write(v, 10);
+		}
+		for (int i = 0; i < 16; ++i) {
+			block.Write(i, i == 0 ? 3 : 4);
+		}
+
+		image_s image = {}, decompressed = {};
+		bool ok = write_test_dds(FILENAME, 4, 4, 1, 0, 95 /* DXGI_FORMAT_BC6H_UF16 */, false, block.bytes_, 16)
+			&& Img_LoadCompressed(FILENAME, image) && image.format_ == image_format_t::BC6H_UFLOAT
+			&& Img_Decompress(image, 0, 0, decompressed)
+			&& decompressed.format_ == image_format_t::R16G16B16A16_FLOAT;
+
+		const float16_t* texels = ok ? (const float16_t*)decompressed.pixels_ : nullptr;
+		for (int i = 0; ok && i < 16; ++i) {
+			ok = texels[i * 4] == texels[i * 4 + 1] && texels[i * 4] == texels[i * 4 + 2] && texels[i * 4 + 3] == 0x3c00
+				&& (i == 0 || texels[i * 4] > texels[i * 4 - 4]);
+		}
+		ok = ok && texels[0] == 0 && HalfFloatToFloat(texels[15 * 4]) == 65504.0f;
+
+		Report("BC6H mode 11", ok);
+
+		Img_Free(decompressed);
+		Img_Free(image);
+	}
+
+	// BC4 cube map, face i filled with i * 40
+	{
+		byte_t blocks[6][8] = {};
+		for (int i = 0; i < 6; ++i) {
+			blocks[i][0] = blocks[i][1] = (byte_t)(i * 40);
+		}
+
+		const int CROSS_X[6] = { 2, 0, 1, 1, 1, 3 };
+		const int CROSS_Y[6] = { 1, 1, 2, 0, 1, 1 };
+
+		image_s image = {}, legacy = {};
+		bool ok = write_test_dds(FILENAME, 4, 4, 1, 0, 80 /* DXGI_FORMAT_BC4_UNORM */, true, blocks, sizeof(blocks))
+			&& Img_LoadCompressed(FILENAME, image) && image.format_ == image_format_t::BC4_UNORM
+			&& image.cubemap_ && image.array_layers_ == 6
+			&& Img_Load(FILENAME, legacy) && legacy.width_ == 16 && legacy.height_ == 12;
+
+		for (int i = 0; ok && i < 6; ++i) {
+			image_s face = {};
+			ok = Img_Decompress(image, i, 0, face) && Texel(face, 3, 3)[0] == i * 40 && Texel(face, 3, 3)[3] == 255
+				&& Texel(legacy, CROSS_X[i] * 4, CROSS_Y[i] * 4)[0] == i * 40;
+			Img_Free(face);
+		}
+
+		Report("BC4 cube map", ok);
+
+		Img_Free(legacy);
+		Img_Free(image);
+	}
+
+	remove(FILENAME);
+}
+
+// one texel of a BC1 / BC3 / BC4 / BC5 block straight from the specification, i = y * 4 + x
+static void reference_bc_texel(image_format_t fmt, const byte_t* block, int i, byte_t rgba[4]) {
+	auto Color = [](const byte_t* b, int i, bool bc1, byte_t rgba[4]) {
+		int c[2] = { b[0] | (b[1] << 8), b[2] | (b[3] << 8) };
+		int e[2][3];
+		for (int k = 0; k < 2; ++k) {
+			// 5 / 6 bits to 8 bits by bit replication
+			e[k][0] = (((c[k] >> 11) & 31) << 3) | ((c[k] >> 13) & 7);
+			e[k][1] = (((c[k] >> 5) & 63) << 2) | ((c[k] >> 9) & 3);
+			e[k][2] = ((c[k] & 31) << 3) | ((c[k] >> 2) & 7);
+		}
+
+		int idx = (b[4 + (i >> 2)] >> ((i & 3) * 2)) & 3;
+		bool four = !bc1 || c[0] > c[1];
+
+		for (int k = 0; k < 3; ++k) {
+			int v = 0;
+			switch (idx) {
+			case 0: v = e[0][k]; break;
+			case 1: v = e[1][k]; break;
+			case 2: v = four ? (2 * e[0][k] + e[1][k] + 1) / 3 : (e[0][k] + e[1][k] + 1) / 2; break;
+			case 3: v = four ? (e[0][k] + 2 * e[1][k] + 1) / 3 : 0; break;
+			}
+			rgba[k] = (byte_t)v;
+		}
+
+		rgba[3] = four || idx != 3 ? 255 : 0;
+	};
+
+	auto Channel = [](const byte_t* b, int i, bool snorm) -> byte_t {
+		int bit = 16 + i * 3;
+		int idx = ((b[bit >> 3] | (b[(bit >> 3) + 1] << 8)) >> (bit & 7)) & 7;
+
+		int a0 = snorm ? (int8_t)b[0] : b[0];
+		int a1 = snorm ? (int8_t)b[1] : b[1];
+		a0 = snorm && a0 == -128 ? -127 : a0;
+		a1 = snorm && a1 == -128 ? -127 : a1;
+
+		int num = 0, den = 1;
+		if (idx < 2) {
+			num = idx == 0 ? a0 : a1;
+		}
+		else if (a0 > a1) {
+			num = (8 - idx) * a0 + (idx - 1) * a1;
+			den = 7;
+		}
+		else if (idx < 6) {
+			num = (6 - idx) * a0 + (idx - 1) * a1;
+			den = 5;
+		}
+		else {
+			num = idx == 6 ? (snorm ? -127 : 0) : (snorm ? 127 : 255);
+		}
+
+		// nearest, ties away from zero
+		int v = (int)floor(fabs((double)num / den) + 0.5);
+		return (byte_t)(num < 0 ? -v : v);
+	};
+
+	bool snorm = fmt == image_format_t::BC4_SNORM || fmt == image_format_t::BC5_SNORM;
+
+	switch (fmt) {
+	case image_format_t::BC1_UNORM:
+		Color(block, i, true, rgba);
+		break;
+	case image_format_t::BC3_UNORM:
+		Color(block + 8, i, false, rgba);
+		rgba[3] = Channel(block, i, false);
+		break;
+	case image_format_t::BC4_UNORM:
+	case image_format_t::BC4_SNORM:
+		rgba[0] = Channel(block, i, snorm);
+		rgba[1] = rgba[2] = 0;
+		rgba[3] = snorm ? 127 : 255;
+		break;
+	default:
+		rgba[0] = Channel(block, i, snorm);
+		rgba[1] = Channel(block + 8, i, snorm);
+		rgba[2] = 0;
+		rgba[3] = snorm ? 127 : 255;
+		break;
+	}
+}
+
+static void test_bc_decode() {
+	const image_format_t FORMATS[] = {
+		image_format_t::BC1_UNORM, image_format_t::BC3_UNORM, image_format_t::BC4_UNORM,
+		image_format_t::BC4_SNORM, image_format_t::BC5_UNORM, image_format_t::BC5_SNORM
+	};
+	const char* FORMAT_NAMES[] = { "BC1", "BC3", "BC4", "BC4 snorm", "BC5", "BC5 snorm" };
+
+	const int BENCH_SIZE = 4096;
+	const int BENCH_ROUNDS = 8;
+
+	for (int f = 0; f < 6; ++f) {
+		image_format_t fmt = FORMATS[f];
+		int block_bytes = Img_GetBlockBytes(fmt);
+
+		// random blocks hit both interpolation modes and the -128 snorm endpoint, the odd size leaves edge blocks
+		image_s image = {};
+		Img_Create(101, 67, fmt, image);
+
+		SRand(f + 1);
+		for (size_t i = 0; i < Img_GetDataSize(image); ++i) {
+			image.pixels_[i] = (byte_t)Rand();
+		}
+
+		image_s bench = {};
+		Img_Create(BENCH_SIZE, BENCH_SIZE, fmt, bench);
+		for (size_t i = 0; i < Img_GetDataSize(bench); ++i) {
+			bench.pixels_[i] = (byte_t)Rand();
+		}
+
+		for_each_simd_level([&](const char* level_name) {
+			image_s decoded = {};
+			bool ok = Img_Decompress(image, 0, 0, decoded);
+
+			int blocks_x = (image.width_ + 3) / 4;
+			for (int y = 0; ok && y < image.height_; ++y) {
+				for (int x = 0; ok && x < image.width_; ++x) {
+					const byte_t* block = image.pixels_ + ((size_t)(y / 4) * blocks_x + x / 4) * block_bytes;
+
+					byte_t expected[4];
+					reference_bc_texel(fmt, block, (y & 3) * 4 + (x & 3), expected);
+					ok = memcmp(expected, decoded.pixels_ + ((size_t)y * image.width_ + x) * 4, 4) == 0;
+				}
+			}
+
+			Img_Free(decoded);
+
+			auto t0 = std::chrono::steady_clock::now();
+			for (int r = 0; r < BENCH_ROUNDS; ++r) {
+				Img_Decompress(bench, 0, 0, decoded);
+				Img_Free(decoded);
+			}
+			auto t1 = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(t1 - t0).count() / BENCH_ROUNDS;
+			double mb = (double)BENCH_SIZE * BENCH_SIZE * 4 / (1024.0 * 1024.0);
+
+			printf("%-10s %-7s %8.2f ms %9.2f MB/s: %s\n", FORMAT_NAMES[f], level_name,
+				seconds * 1000.0, mb / seconds, pass_fail(ok));
+		});
+
+		Img_Free(bench);
+		Img_Free(image);
+	}
+}
+
+static double psnr_rgba(const image_s& a, const image_s& b, int channels) {
+	double sum = 0.0;
+	size_t n = (size_t)a.width_ * a.height_;
+	for (size_t i = 0; i < n; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			double d = (double)a.pixels_[i * 4 + c] - b.pixels_[i * 4 + c];
+			sum += d * d;
+		}
+	}
+
+	double mse = sum / (n * channels);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static void test_bc_encode() {
+	const char* FILENAME = "test_encode.dds";
+
+	const image_format_t FORMATS[] = {
+		image_format_t::BC1_UNORM, image_format_t::BC3_UNORM, image_format_t::BC4_UNORM,
+		image_format_t::BC5_UNORM, image_format_t::BC7_UNORM, image_format_t::BC7_UNORM
+	};
+	const char* FORMAT_NAMES[] = { "BC1", "BC3", "BC4", "BC5", "BC7", "BC7 opaque" };
+	const int CHANNELS[] = { 3, 4, 1, 2, 4, 3 };
+	const bool OPAQUE[] = { true, false, false, false, false, true };
+	// minimum PSNR of each format at fast / normal / high
+	const double MIN_PSNR[6][3] = {
+		{ 32.0, 34.0, 34.0 },
+		{ 32.0, 34.0, 34.0 },
+		{ 42.0, 44.0, 44.0 },
+		{ 42.0, 44.0, 44.0 },
+		{ 38.0, 40.0, 40.0 },
+		{ 38.0, 40.0, 42.0 }
+	};
+	const char* QUALITY_NAMES[] = { "fast", "normal", "high" };
+
+	// smooth gradients with some noise and an alpha ramp, the odd size leaves edge blocks
+	image_s image = {};
+	Img_Create(125, 83, image_format_t::R8G8B8A8, image);
+
+	SRand(7);
+	for (int y = 0; y < image.height_; ++y) {
+		for (int x = 0; x < image.width_; ++x) {
+			byte_t* texel = image.pixels_ + ((size_t)y * image.width_ + x) * 4;
+			int noise = Rand() % 9 - 4;
+			int r = x * 2 + noise;
+			int g = y * 3 - noise;
+			int b = 128 + (int)(100.0 * sin(x * 0.1 + y * 0.07));
+			texel[0] = (byte_t)(r < 0 ? 0 : (r > 255 ? 255 : r));
+			texel[1] = (byte_t)(g < 0 ? 0 : (g > 255 ? 255 : g));
+			texel[2] = (byte_t)b;
+			texel[3] = (byte_t)(x * 255 / (image.width_ - 1));
+		}
+	}
+
+	image_s opaque = {};
+	Img_Create(image.width_, image.height_, image_format_t::R8G8B8A8, opaque);
+	memcpy(opaque.pixels_, image.pixels_, (size_t)image.width_ * image.height_ * 4);
+	for (int i = 0; i < image.width_ * image.height_; ++i) {
+		opaque.pixels_[i * 4 + 3] = 255;
+	}
+
+	for (int f = 0; f < 6; ++f) {
+		const image_s& source = OPAQUE[f] ? opaque : image;
+
+		for (int q = 0; q < 3; ++q) {
+			image_s compressed = {}, decoded = {};
+
+			auto t0 = std::chrono::steady_clock::now();
+			bool ok = Img_Compress(source, FORMATS[f], (bc_quality_t)q, compressed);
+			auto t1 = std::chrono::steady_clock::now();
+
+			ok = ok && Img_Decompress(compressed, 0, 0, decoded);
+			double psnr = ok ? psnr_rgba(source, decoded, CHANNELS[f]) : 0.0;
+			ok = ok && psnr >= MIN_PSNR[f][q];
+
+			printf("%-10s %-7s %6.2f dB %8.2f ms: %s\n", FORMAT_NAMES[f], QUALITY_NAMES[q], psnr,
+				std::chrono::duration<double>(t1 - t0).count() * 1000.0, pass_fail(ok));
+
+			Img_Free(decoded);
+			Img_Free(compressed);
+		}
+	}
+
+	// mip chain down to 1x1, then written and read back as DDS
+	{
+		image_s mipmapped = {}, compressed = {}, loaded = {};
+
+		bool ok = Img_GenerateMipmaps(image, mip_filter_t::KAISER, true, mipmapped);
+		ok = ok && mipmapped.mip_levels_ == 7;
+		ok = ok && Img_Compress(mipmapped, image_format_t::BC7_SRGB, bc_quality_t::FAST, compressed);
+		ok = ok && Img_Save(FILENAME, compressed);
+		ok = ok && Img_LoadCompressed(FILENAME, loaded);
+		ok = ok && loaded.format_ == compressed.format_ && loaded.mip_levels_ == compressed.mip_levels_;
+		ok = ok && memcmp(loaded.pixels_, compressed.pixels_, Img_GetDataSize(compressed)) == 0;
+
+		// a flat image keeps its color in every level
+		image_s flat = {}, flat_mipmapped = {};
+		Img_Create(6, 3, image_format_t::R8G8B8A8, flat);
+		memset(flat.pixels_, 200, (size_t)6 * 3 * 4);
+		ok = ok && Img_GenerateMipmaps(flat, mip_filter_t::BOX, true, flat_mipmapped);
+		for (size_t i = 0; ok && i < Img_GetDataSize(flat_mipmapped); ++i) {
+			ok = flat_mipmapped.pixels_[i] == 200;
+		}
+
+		printf("%-10s %-7s: %s\n", "mips", "dds", pass_fail(ok));
+
+		Img_Free(flat_mipmapped);
+		Img_Free(flat);
+		Img_Free(loaded);
+		Img_Free(compressed);
+		Img_Free(mipmapped);
+		remove(FILENAME);
+	}
+
+	Img_Free(opaque);
+	Img_Free(image);
+}
+
+static void test_image_batch() {
+	const char* FILES[] = {
+		"textures/color.bmp", "textures/gray.bmp", "textures/grass.bmp", "textures/blue_cube.png",
+		"models/tree/bark_0021.png", "models/tree/DB2X2_L01.png",
+		"textures/terrain/HighTile.tga", "textures/terrain/grass_1.tga", "textures/terrain/detailMap.tga"
+	};
+	const uint32_t NUM_FILE = (uint32_t)COUNT_OF(FILES);
+
+	char filenames[COUNT_OF(FILES)][MAX_PATH];
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		Str_SPrintf(filenames[i], MAX_PATH, "%s/%s", GetDataFolder(), FILES[i]);
+	}
+
+	// reference: one at a time, bottom row first
+	std::vector<image_s> reference(NUM_FILE);
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		reference[i] = {};
+		Img_Load(filenames[i], reference[i]);
+	}
+	auto t1 = std::chrono::steady_clock::now();
+
+	// top row first, into one block of caller memory laid out from the headers
+	std::vector<image_load_s> loads(NUM_FILE);
+	std::vector<size_t> offsets(NUM_FILE);
+	size_t total = 0;
+
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		int width = 0, height = 0;
+		Img_GetSize(filenames[i], width, height);
+		offsets[i] = total;
+		total += (size_t)width * height * 4;
+	}
+
+	std::vector<byte_t> memory(total);
+
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		loads[i] = {};
+		loads[i].filename_ = filenames[i];
+		loads[i].top_first_ = true;
+		loads[i].dst_ = memory.data() + offsets[i];
+		loads[i].dst_size_ = (i + 1 < NUM_FILE ? offsets[i + 1] : total) - offsets[i];
+	}
+
+	auto t2 = std::chrono::steady_clock::now();
+	bool ok = Img_LoadBatch(loads.data(), NUM_FILE);
+	auto t3 = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		const image_s& a = reference[i];
+		const image_s& b = loads[i].image_;
+
+		bool same = loads[i].ok_ && a.pixels_ && a.width_ == b.width_ && a.height_ == b.height_
+			&& b.pixels_ == loads[i].dst_;
+		for (int y = 0; same && y < a.height_; ++y) {
+			same = memcmp(a.pixels_ + (size_t)y * a.width_ * 4,
+				b.pixels_ + (size_t)(b.height_ - 1 - y) * b.width_ * 4, (size_t)a.width_ * 4) == 0;
+		}
+
+		printf("%-32s %4dx%-4d: %s\n", FILES[i], a.width_, a.height_, pass_fail(same));
+		ok = ok && same;
+	}
+
+	// allocated, bottom row first, written back as png without a flip
+	{
+		image_load_s load = {};
+		load.filename_ = filenames[3];
+
+		image_s saved = {};
+		bool same = Img_LoadBatch(&load, 1) && Img_Save("test_batch.png", load.image_)
+			&& Img_Load("test_batch.png", saved)
+			&& memcmp(saved.pixels_, reference[3].pixels_, (size_t)saved.width_ * saved.height_ * 4) == 0;
+
+		printf("%-32s: %s\n", "png save / load", pass_fail(same));
+		ok = ok && same;
+
+		Img_Free(saved);
+		Img_Free(load.image_);
+		remove("test_batch.png");
+	}
+
+	printf("Img_Load %.2f ms, Img_LoadBatch %.2f ms: %s\n",
+		std::chrono::duration<double>(t1 - t0).count() * 1000.0,
+		std::chrono::duration<double>(t3 - t2).count() * 1000.0, pass_fail(ok));
+
+	for (uint32_t i = 0; i < NUM_FILE; ++i) {
+		Img_Free(reference[i]);
+	}
+}
+
+// independent of the tables: exact value through double, NaNs quieted
+static uint32_t reference_half_to_float_bits(float16_t h) {
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t e = (h >> 10) & 0x1f;
+	uint32_t m = h & 0x3ff;
+
+	if (e == 31) {
+		return sign | 0x7f800000 | (m ? 0x00400000 | (m << 13) : 0);
+	}
+
+	float f = (float)ldexp(e ? (double)(m | 0x400) : (double)m, e ? (int)e - 25 : -24);
+	uint32_t bits;
+	memcpy(&bits, &f, 4);
+	return sign | bits;
+}
+
+static float16_t reference_float_to_half(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, 4);
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	if ((bits & 0x7fffffff) > 0x7f800000) {
+		return (float16_t)(sign | 0x7e00 | ((bits >> 13) & 0x3ff));
+	}
+
+	double a = fabs((double)f);
+	if (a >= 65520.0) {
+		return (float16_t)(sign | 0x7c00);
+	}
+	if (a == 0.0) {
+		return (float16_t)sign;
+	}
+
+	// n quanta of the half binade holding a, 2^-24 below the normals, rounded to nearest even
+	int e = 0;
+	frexp(a, &e);
+	int q = e - 11 < -24 ? -24 : e - 11;
+	uint32_t n = (uint32_t)nearbyint(ldexp(a, -q));
+
+	return (float16_t)(sign | (((q + 24) << 10) + n));
+}
+
+static void test_float16_arrays() {
+	// every half, the count leaves a tail for the scalar loop
+	const size_t NUM_HALF = 65536 + 13;
+	std::vector<float16_t> halfs(NUM_HALF);
+	for (size_t i = 0; i < NUM_HALF; ++i) {
+		halfs[i] = (float16_t)i;
+	}
+
+	// edges, every half and the midpoints around it, random bit patterns
+	std::vector<float> floats;
+	const uint32_t EDGES[] = {
+		0x00000000, 0x80000000, 0x00000001, 0x33000000, 0x33000001, 0x337fffff, 0x38800000, 0x387fffff,
+		0x477fe000, 0x477fefff, 0x477ff000, 0x477fffff, 0x47800000, 0x7f7fffff, 0x7f800000, 0xff800000,
+		0x7f800001, 0x7fc00000, 0xffffffff, 0x7f802000
+	};
+	for (uint32_t bits : EDGES) {
+		float f;
+		memcpy(&f, &bits, 4);
+		floats.push_back(f);
+	}
+	for (uint32_t h = 0; h < 0x7c00; ++h) {
+		uint32_t bits = reference_half_to_float_bits((float16_t)h);
+		uint32_t next = reference_half_to_float_bits((float16_t)(h + 1));
+		uint32_t mid = bits + (next - bits) / 2;
+		const uint32_t VALUES[] = { bits, mid - 1, mid, mid + 1 };
+		for (uint32_t v : VALUES) {
+			float f;
+			memcpy(&f, &v, 4);
+			floats.push_back(f);
+			floats.push_back(-f);
+		}
+	}
+	SRand(17);
+	for (int i = 0; i < (1 << 20); ++i) {
+		uint32_t bits = (Rand() << 16) ^ Rand();
+		float f;
+		memcpy(&f, &bits, 4);
+		floats.push_back(f);
+	}
+
+	const size_t BENCH_COUNT = 1 << 24;
+	const int BENCH_ROUNDS = 8;
+	std::vector<float16_t> bench_halfs(BENCH_COUNT);
+	std::vector<float> bench_floats(BENCH_COUNT);
+	for (size_t i = 0; i < BENCH_COUNT; ++i) {
+		bench_floats[i] = RandNeg1Pos1() * 1000.0f;
+	}
+
+	for_each_simd_level([&](const char* level_name) {
+		std::vector<float> to_float(NUM_HALF);
+		HalfFloatToFloatArray(halfs.data(), to_float.data(), NUM_HALF);
+
+		bool ok_to_float = true;
+		for (size_t i = 0; ok_to_float && i < NUM_HALF; ++i) {
+			uint32_t bits;
+			memcpy(&bits, &to_float[i], 4);
+			ok_to_float = bits == reference_half_to_float_bits(halfs[i]);
+		}
+
+		std::vector<float16_t> to_half(floats.size());
+		FloatToHalfFloatArray(floats.data(), to_half.data(), floats.size());
+
+		bool ok_to_half = true;
+		for (size_t i = 0; ok_to_half && i < floats.size(); ++i) {
+			ok_to_half = to_half[i] == reference_float_to_half(floats[i]);
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < BENCH_ROUNDS; ++r) {
+			FloatToHalfFloatArray(bench_floats.data(), bench_halfs.data(), BENCH_COUNT);
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		for (int r = 0; r < BENCH_ROUNDS; ++r) {
+			HalfFloatToFloatArray(bench_halfs.data(), bench_floats.data(), BENCH_COUNT);
+		}
+		auto t2 = std::chrono::steady_clock::now();
+
+		double to_half_s = std::chrono::duration<double>(t1 - t0).count() / BENCH_ROUNDS;
+		double to_float_s = std::chrono::duration<double>(t2 - t1).count() / BENCH_ROUNDS;
+
+		printf("%-10s half -> float %8.1f Melem/s: %s, float -> half %8.1f Melem/s: %s\n", level_name,
+			BENCH_COUNT / to_float_s * 1.0e-6, pass_fail(ok_to_float),
+			BENCH_COUNT / to_half_s * 1.0e-6, pass_fail(ok_to_half));
+	});
+}
+
+// busy work of about cost units, not optimized away
+static double job_work(uint32_t seed, uint32_t cost) {
+	double x = seed * 1.0e-3;
+	for (uint32_t i = 0; i < cost; ++i) {
+		x = x * 0.999 + sin(x + i);
+	}
+	return x;
+}
+
+static void test_job_system() {
+	Job_Init(0);
+
+	// parallel_for covers every index once
+	{
+		const uint32_t COUNT = 1000003;
+		std::vector<uint8_t> hits(COUNT, 0);
+		Job_ParallelFor(0, COUNT, 97, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				hits[i]++;
+			}
+		});
+		bool ok = std::all_of(hits.begin(), hits.end(), [](uint8_t h) { return h == 1; });
+		printf("parallel_for coverage: %s\n", pass_fail(ok));
+	}
+
+	// reduce matches the serial sum, float partials the same on every thread count
+	{
+		const uint32_t COUNT = 10000000;
+		uint64_t sum = Job_ParallelReduce<uint64_t>(0, COUNT, 0, 0,
+			[](uint32_t begin, uint32_t end, const uint64_t& init) {
+				uint64_t s = init;
+				for (uint32_t i = begin; i < end; ++i) {
+					s += i;
+				}
+				return s;
+			},
+			[](const uint64_t& a, const uint64_t& b) { return a + b; });
+
+		auto FloatSum = [] {
+			return Job_ParallelReduce<double>(0, 1000000, 1000, 0.0,
+				[](uint32_t begin, uint32_t end, const double& init) {
+					double s = init;
+					for (uint32_t i = begin; i < end; ++i) {
+						s += sin((double)i);
+					}
+					return s;
+				},
+				[](const double& a, const double& b) { return a + b; });
+		};
+
+		double f0 = FloatSum();
+		Job_Init(1);
+		double f1 = FloatSum();
+		Job_Init(0);
+
+		printf("parallel_reduce: %s, deterministic: %s\n", pass_fail(sum == (uint64_t)COUNT * (COUNT - 1) / 2),
+			pass_fail(f0 == f1));
+	}
+
+	// nested loops, Thread_Run inside jobs
+	{
+		std::atomic<uint32_t> total = 0;
+		Job_ParallelFor(0, 64, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				Thread_Run(8, [&](uint32_t idx) {
+					Job_ParallelFor(0, 100, 7, [&](uint32_t b, uint32_t e) { total += e - b; });
+				});
+			}
+		});
+		printf("nested: %s\n", pass_fail(total == 64 * 8 * 100));
+	}
+
+	// graph: a diamond per layer, every task after its dependencies
+	{
+		const uint32_t LAYERS = 200;
+		std::atomic<uint32_t> clock = 0;
+		std::vector<uint32_t> finished(LAYERS * 4, 0);
+
+		job_graph_s* graph = Job_CreateGraph();
+		for (uint32_t l = 0; l < LAYERS; ++l) {
+			for (uint32_t k = 0; k < 4; ++k) {
+				Job_AddTask(graph, [&, l, k] {
+					job_work(l * 4 + k, 200);
+					finished[l * 4 + k] = ++clock;
+				});
+			}
+			// top -> left, right -> bottom -> next top
+			Job_AddDependency(graph, l * 4 + 0, l * 4 + 1);
+			Job_AddDependency(graph, l * 4 + 0, l * 4 + 2);
+			Job_AddDependency(graph, l * 4 + 1, l * 4 + 3);
+			Job_AddDependency(graph, l * 4 + 2, l * 4 + 3);
+			if (l) {
+				Job_AddDependency(graph, l * 4 - 1, l * 4);
+			}
+		}
+
+		bool ok = true;
+		for (int run = 0; run < 2; ++run) {
+			clock = 0;
+			ok = ok && Job_RunGraph(graph);
+			for (uint32_t l = 0; ok && l < LAYERS; ++l) {
+				const uint32_t* f = &finished[l * 4];
+				ok = f[0] < f[1] && f[0] < f[2] && f[1] < f[3] && f[2] < f[3] && (!l || f[-1] < f[0]);
+			}
+		}
+
+		Job_AddDependency(graph, LAYERS * 4 - 1, 0);
+		bool cycle = !Job_RunGraph(graph);
+
+		Job_DestroyGraph(graph);
+
+		printf("graph order: %s, cycle rejected: %s\n", pass_fail(ok), pass_fail(cycle));
+	}
+
+	// scaling: fine uniform items, coarse items of irregular cost, nested loops
+	const uint32_t THREADS[] = { 1, 2, 4, 8, 16, 32, 64 };
+	const char* WORKLOADS[] = { "fine", "irregular", "nested" };
+	double base_ms[3] = {};
+
+	printf("%8s %-10s %10s %8s %10s %8s %10s\n", "threads", "workload", "ms", "speedup", "executed", "steals", "idle ms");
+
+	for (uint32_t threads : THREADS) {
+		Job_Init(threads);
+
+		for (int w = 0; w < 3; ++w) {
+			Job_ResetStats();
+			auto t0 = std::chrono::steady_clock::now();
+
+			std::atomic<uint64_t> sink = 0;
+			if (w == 0) {
+				Job_ParallelFor(0, 1 << 20, 256, [&](uint32_t begin, uint32_t end) {
+					double s = 0.0;
+					for (uint32_t i = begin; i < end; ++i) {
+						s += job_work(i, 8);
+					}
+					sink += (uint64_t)s;
+				});
+			}
+			else if (w == 1) {
+				Job_ParallelFor(0, 4096, 1, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t i = begin; i < end; ++i) {
+						sink += (uint64_t)job_work(i, 100 + RandHash(1, i, 0) % 4000);
+					}
+				});
+			}
+			else {
+				Job_ParallelFor(0, 256, 1, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t i = begin; i < end; ++i) {
+						Job_ParallelFor(0, 256, 16, [&](uint32_t b, uint32_t e) {
+							double s = 0.0;
+							for (uint32_t j = b; j < e; ++j) {
+								s += job_work(i * 256 + j, 32);
+							}
+							sink += (uint64_t)s;
+						});
+					}
+				});
+			}
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+			if (threads == 1) {
+				base_ms[w] = ms;
+			}
+
+			job_stats_s total = {};
+			uint32_t num_worker = Job_GetWorkerCount();
+			for (uint32_t k = 0; k <= num_worker; ++k) {
+				job_stats_s stats;
+				Job_GetStats(k, stats);
+				total.executed_ += stats.executed_;
+				total.steals_ += stats.steals_;
+				total.idle_ms_ += stats.idle_ms_;
+			}
+
+			printf("%8u %-10s %10.2f %7.2fx %10llu %8llu %10.2f\n", threads, WORKLOADS[w], ms, base_ms[w] / ms,
+				(unsigned long long)total.executed_, (unsigned long long)total.steals_, total.idle_ms_);
+		}
+	}
+
+	Job_Init(0);
+}
+
+static void test_random_streams() {
+	// pcg32-demo, seed 42 stream 54
+	const uint32_t REFERENCE[] = { 0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e };
+	rand_stream_s rs;
+	Rand_Init(rs, 42, 54);
+	bool ok_reference = true;
+	for (uint32_t r : REFERENCE) {
+		ok_reference = ok_reference && Rand_Next(rs) == r;
+	}
+
+	// advance matches stepping
+	rand_stream_s stepped, jumped;
+	Rand_Init(stepped, 7, 3);
+	jumped = stepped;
+	for (int i = 0; i < 12345; ++i) {
+		Rand_Next(stepped);
+	}
+	Rand_Advance(jumped, 12345);
+	bool ok_advance = Rand_Next(stepped) == Rand_Next(jumped);
+
+	// range: in bounds, buckets within 1% of flat
+	const uint32_t BUCKETS = 7, DRAWS = 7000000;
+	uint32_t hist[BUCKETS] = {};
+	bool ok_range = true;
+	for (uint32_t i = 0; i < DRAWS; ++i) {
+		uint32_t v = Rand_Range(rs, BUCKETS);
+		if (v >= BUCKETS) {
+			ok_range = false;
+			break;
+		}
+		hist[v]++;
+	}
+	for (uint32_t b = 0; b < BUCKETS; ++b) {
+		ok_range = ok_range && fabs(hist[b] - DRAWS / (double)BUCKETS) < DRAWS / BUCKETS * 0.01;
+	}
+
+	printf("pcg32 reference: %s, advance: %s, range: %s\n", pass_fail(ok_reference),
+		pass_fail(ok_advance), pass_fail(ok_range));
+
+	// fills: the same values on every SIMD level, in range, centered
+	const size_t FILL_COUNT = (1 << 20) + 5;
+	const int BENCH_ROUNDS = 16;
+
+	std::vector<float> reference01, referenceNeg1Pos1;
+	std::vector<float> values01(FILL_COUNT), valuesNeg1Pos1(FILL_COUNT);
+
+	for_each_simd_level([&](const char* level_name) {
+		Rand_Init(rs, 2024, 1);
+		Rand_Fill01(rs, values01.data(), FILL_COUNT);
+		Rand_FillNeg1Pos1(rs, valuesNeg1Pos1.data(), FILL_COUNT);
+
+		if (reference01.empty()) {
+			reference01 = values01;
+			referenceNeg1Pos1 = valuesNeg1Pos1;
+		}
+
+		double sum01 = 0.0, sumNeg1Pos1 = 0.0;
+		bool ok_bounds = true;
+		for (size_t i = 0; i < FILL_COUNT; ++i) {
+			ok_bounds = ok_bounds && values01[i] >= 0.0f && values01[i] <= 1.0f && fabsf(valuesNeg1Pos1[i]) <= 1.0f;
+			sum01 += values01[i];
+			sumNeg1Pos1 += valuesNeg1Pos1[i];
+		}
+		bool ok_mean = fabs(sum01 / FILL_COUNT - 0.5) < 0.002 && fabs(sumNeg1Pos1 / FILL_COUNT) < 0.004;
+		bool ok_same = values01 == reference01 && valuesNeg1Pos1 == referenceNeg1Pos1;
+
+		auto t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < BENCH_ROUNDS; ++r) {
+			Rand_FillNeg1Pos1(rs, valuesNeg1Pos1.data(), FILL_COUNT);
+		}
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / BENCH_ROUNDS;
+
+		printf("%-7s fill %8.1f Mfloat/s, bounds: %s, mean: %s, same as scalar: %s\n", level_name,
+			FILL_COUNT / s * 1.0e-6, pass_fail(ok_bounds), pass_fail(ok_mean), pass_fail(ok_same));
+	});
+
+	// a stream per task: the same sum whatever the thread count
+	auto TaskSum = [] {
+		return Job_ParallelReduce<double>(0, 256, 1, 0.0,
+			[](uint32_t begin, uint32_t end, const double& init) {
+				double sum = init;
+				for (uint32_t task = begin; task < end; ++task) {
+					rand_stream_s task_rs;
+					Rand_Init(task_rs, 99, task);
+					for (int i = 0; i < 10000; ++i) {
+						sum += Rand_FloatNeg1Pos1(task_rs);
+					}
+				}
+				return sum;
+			},
+			[](const double& a, const double& b) { return a + b; });
+	};
+
+	Job_Init(1);
+	double single = TaskSum();
+	Job_Init(0);
+	double multi = TaskSum();
+	printf("per task streams deterministic: %s\n", pass_fail(single == multi));
+
+	// the compatibility layer: the legacy sequence, seed 1 is what a new thread starts from
+	const uint32_t LEGACY_SEED1[] = { 16838, 5758, 10113, 17515, 31051 };
+
+	auto IsLegacySeed1 = [&LEGACY_SEED1] {
+		bool legacy = true;
+		for (uint32_t r : LEGACY_SEED1) {
+			legacy = legacy && Rand() == r;
+		}
+		return legacy;
+	};
+
+	SRand(1);
+	bool ok_seeded = IsLegacySeed1();
+
+	const uint32_t NEW_THREADS = 4;
+	std::atomic<uint32_t> num_legacy = 0;
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < NEW_THREADS; ++t) {
+		threads.emplace_back([&] {
+			num_legacy += IsLegacySeed1() ? 1 : 0;
+		});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	printf("Rand() legacy sequence: %s, new threads: %s\n", pass_fail(ok_seeded),
+		pass_fail(num_legacy == NEW_THREADS));
+
+	// scalar draws on every thread at once
+	const uint32_t DRAWS_PER_THREAD = 1 << 22;
+	uint32_t num_thread = Thread_GetHardwareConcurrency();
+	std::atomic<uint32_t> sink = 0;
+
+	auto t0 = std::chrono::steady_clock::now();
+	Thread_Run(num_thread, [&](uint32_t) {
+		uint32_t x = 0;
+		for (uint32_t i = 0; i < DRAWS_PER_THREAD; ++i) {
+			x += Rand();
+		}
+		sink += x;
+	});
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	printf("Rand() on %u threads: %.1f Mdraw/s\n", num_thread, DRAWS_PER_THREAD * (double)num_thread / s * 1.0e-6);
+}
+
+static void test_memory_tlsf() {
+	// random sizes and alignments against a map of the granules in use
+	const uint64_t SIZE = 64ull * 1024 * 1024;
+	const uint64_t GRANULE = 16;
+	const int ROUNDS = 200000;
+
+	struct live_s {
+		uint32_t		handle_;
+		uint64_t		offset_;
+		uint64_t		size_;
+	};
+
+	mem_tlsf_s* tlsf = Mem_CreateTlsf(SIZE);
+	std::vector<byte_t> owner(SIZE / GRANULE, 0);
+	std::vector<live_s> live;
+
+	rand_stream_s rs;
+	Rand_Init(rs, 1, 1);
+
+	bool ok_overlap = true, ok_align = true, ok_stats = true;
+	uint32_t failed = 0;
+	uint64_t used = 0;
+
+	for (int i = 0; i < ROUNDS && ok_overlap; ++i) {
+		if (live.empty() || Rand_Range(rs, 100) < 55) {
+			// mostly small uniform buffers and vertex data, now and then a texture
+			uint64_t size = Rand_Range(rs, 100) < 90 ? 16 + Rand_Range(rs, 64 * 1024) : 64 * 1024 + Rand_Range(rs, 4 * 1024 * 1024);
+			uint64_t alignment = 1ull << (4 + Rand_Range(rs, 13));	// 16 ~ 64K
+
+			uint64_t offset = 0;
+			uint32_t handle = Mem_TlsfAlloc(tlsf, size, alignment, offset);
+			if (handle == VK_INVALID_INDEX) {
+				failed++;
+				continue;
+			}
+
+			uint64_t rounded = (size + GRANULE - 1) / GRANULE * GRANULE;
+			ok_align = ok_align && offset % alignment == 0 && offset + rounded <= SIZE;
+
+			for (uint64_t g = offset / GRANULE; g < (offset + rounded) / GRANULE; ++g) {
+				ok_overlap = ok_overlap && !owner[g];
+				owner[g] = 1;
+			}
+
+			live.push_back({ handle, offset, rounded });
+			used += rounded;
+		}
+		else {
+			uint32_t k = Rand_Range(rs, (uint32_t)live.size());
+			for (uint64_t g = live[k].offset_ / GRANULE; g < (live[k].offset_ + live[k].size_) / GRANULE; ++g) {
+				owner[g] = 0;
+			}
+
+			Mem_TlsfFree(tlsf, live[k].handle_);
+			used -= live[k].size_;
+			live[k] = live.back();
+			live.pop_back();
+		}
+
+		if (i % 1000 == 0) {
+			mem_range_stats_s stats;
+			Mem_TlsfGetStats(tlsf, stats);
+			ok_stats = ok_stats && stats.used_bytes_ == used && stats.allocation_count_ == (uint32_t)live.size();
+		}
+	}
+
+	mem_range_stats_s stats;
+	Mem_TlsfGetStats(tlsf, stats);
+	printf("tlsf: %u live, %u failed, %.1f MB used, %u free ranges, largest %.1f MB\n", (uint32_t)live.size(), failed,
+		stats.used_bytes_ / (1024.0 * 1024.0), stats.free_range_count_, stats.largest_free_ / (1024.0 * 1024.0));
+
+	// the ranges tile [0, SIZE) in address order
+	uint64_t next_offset = 0;
+	bool ok_walk = true;
+	Mem_TlsfWalk(tlsf, [&](uint64_t offset, uint64_t size, bool in_use) {
+		ok_walk = ok_walk && offset == next_offset;
+		next_offset = offset + size;
+	});
+	ok_walk = ok_walk && next_offset == SIZE;
+
+	// everything freed: merged back into one range
+	for (const live_s& l : live) {
+		Mem_TlsfFree(tlsf, l.handle_);
+	}
+	Mem_TlsfGetStats(tlsf, stats);
+	bool ok_merge = stats.free_range_count_ == 1 && stats.largest_free_ == SIZE && !stats.allocation_count_;
+
+	printf("overlap: %s, alignment: %s, stats: %s, walk: %s, merge: %s\n", pass_fail(ok_overlap),
+		pass_fail(ok_align), pass_fail(ok_stats), pass_fail(ok_walk), pass_fail(ok_merge));
+
+	// throughput: a window of 4096 uniform buffer sized allocations
+	const int BENCH_OPS = 1 << 22;
+	std::vector<uint32_t> window(4096, VK_INVALID_INDEX);
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_OPS; ++i) {
+		uint32_t& slot = window[i & 4095];
+		if (slot != VK_INVALID_INDEX) {
+			Mem_TlsfFree(tlsf, slot);
+		}
+		uint64_t offset;
+		slot = Mem_TlsfAlloc(tlsf, 256 + (i & 7) * 256, 256, offset);
+	}
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	printf("tlsf alloc + free: %.1f ns\n", s / BENCH_OPS * 1.0e9);
+
+	Mem_DestroyTlsf(tlsf);
+}
+
+int main(int argc, char** argv) {
+	Common_Init();
+
+	//test_proj_mat(1.0f, 16.0f);
+	//test_frustum();
+
+	//test();
+
+	//test_float16();
+
+	//test_obj_load_throughput();
+	//test_model_weld_report();
+	//test_model_optimize();
+	//test_model_cache();
+	//test_ply_binary_decode();
+	//test_terrain_fault_formation();
+	//test_terrain_erode();
+	//test_terrain_quantize();
+	//test_terrain_world();
+	//test_terrain_texture();
+	//test_dds_compressed();
+	//test_bc_decode();
+	//test_bc_encode();
+	//test_image_batch();
+	//test_float16_arrays();
+	//test_job_system();
+	//test_random_streams();
+	//test_memory_tlsf();
+
+	//test_dds("ocean/perlin_noise.dds");
+	test_dds("ocean/sky_cube.dds");
+	//test_dds("ocean/reflect_cube.dds");
+
+	Common_Shutdown();
 
 	return 0;
 }
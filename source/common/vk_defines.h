@@ -60,9 +60,19 @@ buffer
 ================================================================================
 */
 
+// a range of a device memory block of VkMemoryAllocator
+struct vk_allocation_s {
+    VkDeviceMemory          memory_;        // the block, VK_NULL_HANDLE: not allocated
+    VkDeviceSize            offset_;
+    VkDeviceSize            size_;
+    void *                  mapped_;        // host visible memory: the range in the persistent mapping of the block
+    uint32_t                block_;
+    uint32_t                range_;
+};
+
 // uniform buffer & shader storage buffer
 struct vk_buffer_s {
-    VkDeviceMemory		    memory_;
+    vk_allocation_s         allocation_;
     VkMemoryPropertyFlags   memory_prop_flags_;
     VkDeviceSize		    memory_size_;
     VkBuffer			    buffer_;
@@ -70,9 +80,11 @@ struct vk_buffer_s {
 
 struct vk_image_s {
     VkImage				    image_;
+    VkFormat                format_;
     uint32_t                width_;
     uint32_t                height_;
-    VkDeviceMemory		    memory_;
+    uint32_t                mip_levels_;
+    vk_allocation_s         allocation_;
     VkMemoryPropertyFlags   memory_prop_flags_;
     VkDeviceSize		    memory_size_;
     VkImageView			    image_view_;
@@ -90,6 +102,10 @@ COMMON_API const char* Vk_PresentModelToStr(VkPresentModeKHR present_mode);
 COMMON_API void Vk_PushDescriptorSetLayoutBinding_UBO(std::vector<VkDescriptorSetLayoutBinding> & bindings,
     uint32_t binding, VkShaderStageFlags stage_flags);
 
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: each vkCmdBindDescriptorSets passes the offset, see VkUniformRing
+COMMON_API void Vk_PushDescriptorSetLayoutBinding_DynamicUBO(std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    uint32_t binding, VkShaderStageFlags stage_flags);
+
 COMMON_API void Vk_PushDescriptorSetLayoutBinding_Tex(std::vector<VkDescriptorSetLayoutBinding>& bindings,
     uint32_t binding, VkShaderStageFlags stage_flags);
 
@@ -112,6 +128,11 @@ COMMON_API void Vk_PushWriteDescriptorSet_UBO(
     VkDescriptorSet vk_desc_set, uint32_t binding,
     VkBuffer vk_buffer, VkDeviceSize vk_buffer_offset, VkDeviceSize vk_buffer_range);
 
+COMMON_API void Vk_PushWriteDescriptorSet_DynamicUBO(
+    update_desc_sets_buffer_s & buffer,
+    VkDescriptorSet vk_desc_set, uint32_t binding,
+    VkBuffer vk_buffer, VkDeviceSize vk_buffer_range);
+
 COMMON_API void Vk_PushWriteDescriptorSet_Tex(
     update_desc_sets_buffer_s& buffer,
     VkDescriptorSet vk_desc_set, uint32_t binding, const vk_image_s & texture);
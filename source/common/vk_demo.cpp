@@ -3,6 +3,8 @@
  *****************************************************************************/
 
 #include "inc.h"
+#include <chrono>
+#include <algorithm>
 
 #if defined(_WIN32)
 # include <windowsx.h>
@@ -14,45 +16,44 @@
 helper
 ================================================================================
 */
-// image_memory_barrier: in/out
-static void SetAccessMaskOfImageMemoryBarrier(VkImageMemoryBarrier & image_memory_barrier) {
-    image_memory_barrier.srcAccessMask = 0;
-    image_memory_barrier.dstAccessMask = 0;
-    
-    switch (image_memory_barrier.oldLayout) {
-    case VK_IMAGE_LAYOUT_UNDEFINED:
-        image_memory_barrier.srcAccessMask = 0;
-        break;
-    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        break;
-    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        break;
-    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-        image_memory_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        break;
-    default:
-        printf("Not processed old image layout %d\n", (int)image_memory_barrier.oldLayout);
-        break;
-    }
-    
-    switch (image_memory_barrier.newLayout) {
-    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-        image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        break;
-    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-        image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        break;
-    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-        if (image_memory_barrier.srcAccessMask == 0) {
-            image_memory_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-        }
-        image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        break;
+static VkFormat GetVkFormat(image_format_t fmt) {
+    switch (fmt) {
+    case image_format_t::R8G8B8A8:              return VK_FORMAT_R8G8B8A8_UNORM;
+    case image_format_t::R16G16B16A16_FLOAT:    return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case image_format_t::BC1_UNORM:             return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case image_format_t::BC1_SRGB:              return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case image_format_t::BC2_UNORM:             return VK_FORMAT_BC2_UNORM_BLOCK;
+    case image_format_t::BC2_SRGB:              return VK_FORMAT_BC2_SRGB_BLOCK;
+    case image_format_t::BC3_UNORM:             return VK_FORMAT_BC3_UNORM_BLOCK;
+    case image_format_t::BC3_SRGB:              return VK_FORMAT_BC3_SRGB_BLOCK;
+    case image_format_t::BC4_UNORM:             return VK_FORMAT_BC4_UNORM_BLOCK;
+    case image_format_t::BC4_SNORM:             return VK_FORMAT_BC4_SNORM_BLOCK;
+    case image_format_t::BC5_UNORM:             return VK_FORMAT_BC5_UNORM_BLOCK;
+    case image_format_t::BC5_SNORM:             return VK_FORMAT_BC5_SNORM_BLOCK;
+    case image_format_t::BC6H_UFLOAT:           return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case image_format_t::BC6H_SFLOAT:           return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case image_format_t::BC7_UNORM:             return VK_FORMAT_BC7_UNORM_BLOCK;
+    case image_format_t::BC7_SRGB:              return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:                                    return VK_FORMAT_UNDEFINED;
+    }
+}
+
+// format of Img_Decompress output, same color space / signedness as the block format
+static VkFormat GetDecompressedVkFormat(image_format_t fmt) {
+    switch (fmt) {
+    case image_format_t::BC1_SRGB:
+    case image_format_t::BC2_SRGB:
+    case image_format_t::BC3_SRGB:
+    case image_format_t::BC7_SRGB:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    case image_format_t::BC4_SNORM:
+    case image_format_t::BC5_SNORM:
+        return VK_FORMAT_R8G8B8A8_SNORM;
+    case image_format_t::BC6H_UFLOAT:
+    case image_format_t::BC6H_SFLOAT:
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
     default:
-        printf("Not processed new image layout %d\n", (int)image_memory_barrier.newLayout);
-        break;
+        return VK_FORMAT_R8G8B8A8_UNORM;
     }
 }
 
@@ -61,6 +62,9 @@ static void SetAccessMaskOfImageMemoryBarrier(VkImageMemoryBarrier & image_memor
 VkDemo
 ================================================================================
 */
+// staging ring of the uploader, an upload of more than half of it gets a staging buffer of its own
+static const VkDeviceSize   UPLOAD_RING_SIZE = 32 * 1024 * 1024;
+
 VkDemo::VkDemo():
     camera_mode_(camera_mode_t::CM_MOVE_CAMERA),
     camera_rotation_flags_(ROTATION_YAW_BIT | ROTATION_PITCH_BIT),
@@ -69,6 +73,14 @@ VkDemo::VkDemo():
     fovy_(70.0f),
     cfg_viewport_cx_(640),
     cfg_viewport_cy_(480),
+    cfg_decode_compressed_textures_(false),
+    cfg_cpu_mipmaps_(false),
+    cfg_headless_(false),
+    cfg_headless_frames_(360),
+    cfg_headless_capture_interval_(0),
+    cfg_headless_yaw_per_frame_(1.0f),
+    cfg_frames_in_flight_(2),
+    cfg_frame_uniform_copies_(false),
 
 #if defined(_WIN32)
     cfg_demo_win_class_name_(TEXT("Vulkan Demo")),
@@ -86,17 +98,19 @@ VkDemo::VkDemo():
 	vk_instance_(VK_NULL_HANDLE),
 	vk_physical_device_(VK_NULL_HANDLE),
 	vk_physical_device_graphics_queue_family_index_(-1),
+    vk_physical_device_transfer_queue_family_index_(VK_INVALID_INDEX),
     vk_depth_format_(VK_FORMAT_UNDEFINED),
 	vk_device_(0),
     vk_device_create_next_chain_(nullptr),
     vk_graphics_queue_(VK_NULL_HANDLE),
-    vk_semaphore_present_complete_(VK_NULL_HANDLE),
-    vk_semaphore_render_complete_(VK_NULL_HANDLE),
+    vk_transfer_queue_(VK_NULL_HANDLE),
     vk_surface_(VK_NULL_HANDLE),
 	vk_swapchain_(VK_NULL_HANDLE),
 	vk_swapchain_color_format_(VK_FORMAT_UNDEFINED),
     vk_swapchain_image_count_(0),
     vk_wait_fence_count_(0),
+    vk_frame_idx_(0),
+    vk_current_image_(0),
     vk_framebuffer_count_(0),
     vk_draw_cmd_buffer_count_(0),
     vk_descriptor_pool_(VK_NULL_HANDLE),
@@ -105,17 +119,25 @@ VkDemo::VkDemo():
 	vk_command_pool_(VK_NULL_HANDLE),
     vk_command_pool_transient_(VK_NULL_HANDLE),
     enable_display_(false),
+    streamer_(nullptr),
+    allocator_(nullptr),
+    uploader_(nullptr),
+    uploads_pending_(false),
     model_scale_(1.0f),
     move_speed_(2.0f),
     model_rotate_mat_(nullptr),
     left_button_down_(false),
     cursor_x_(0),
     cursor_y_(0),
-    mouse_sensitive_(0.5f)
+    mouse_sensitive_(0.5f),
+    headless_frame_(0),
+    vk_timestamp_query_pool_(VK_NULL_HANDLE)
 {
 	shaders_dir_[0] = '\0';
+    demo_name_[0] = '\0';
     textures_dir_[0] = '\0';
     models_dir_[0] = '\0';
+    cfg_memory_dump_[0] = '\0';
 
     model_rotate_mat_ = new glm::mat4(1.0f);
 
@@ -148,7 +170,13 @@ VkDemo::VkDemo():
     memset(vk_framebuffers_, 0, sizeof(vk_framebuffers_));
     memset(vk_draw_cmd_buffers_, 0, sizeof(vk_draw_cmd_buffers_));
 
+    memset(vk_semaphore_present_complete_, 0, sizeof(vk_semaphore_present_complete_));
+    memset(vk_semaphore_render_complete_, 0, sizeof(vk_semaphore_render_complete_));
     memset(vk_wait_fences_, 0, sizeof(vk_wait_fences_));
+    memset(vk_image_fences_, 0, sizeof(vk_image_fences_));
+    memset(vk_timestamp_cmd_buffers_, 0, sizeof(vk_timestamp_cmd_buffers_));
+    memset(frame_timed_, 0, sizeof(frame_timed_));
+    memset(&frame_timing_, 0, sizeof(frame_timing_));
 
 #if defined(_WIN32)
     hInstance_ = GetModuleHandle(NULL);
@@ -183,7 +211,8 @@ bool VkDemo::Init(const char* project_shader_dir,
     uint32_t max_uniform_buffer,
     uint32_t max_storage_buffer,
     uint32_t max_texture,
-    uint32_t max_desp_set) 
+    uint32_t max_desp_set,
+    uint32_t max_dynamic_uniform_buffer)
 {
     // setup folders
     Str_SPrintf(shaders_dir_, MAX_PATH, "%s/%s",
@@ -195,7 +224,9 @@ bool VkDemo::Init(const char* project_shader_dir,
     Str_SPrintf(models_dir_, MAX_PATH, "%s/models",
         GetDataFolder());
 
-    if (!CreateDemoWindow()) {
+    Str_Copy(demo_name_, MAX_PATH, project_shader_dir);
+
+    if (!cfg_headless_ && !CreateDemoWindow()) {
         return false;
     }
 
@@ -216,20 +247,32 @@ bool VkDemo::Init(const char* project_shader_dir,
         return false;
     }
 
-    if (!CreateDemoSemaphores()) {
+    allocator_ = new VkMemoryAllocator();
+    if (!allocator_->Init(vk_device_, vk_physical_device_memory_properties_, vk_physical_device_properties2_.properties.limits)) {
         return false;
     }
 
-    if (!CreateSurface()) {
+    if (!CreateDemoSemaphores()) {
         return false;
     }
 
-    if (!CreateSwapChain(false)) {
+    if (!CreateDemoFences()) {
         return false;
     }
 
-    if (!CreateDemoFences()) {
-        return false;
+    if (cfg_headless_) {
+        if (!CreateOffscreenImages()) {
+            return false;
+        }
+    }
+    else {
+        if (!CreateSurface()) {
+            return false;
+        }
+
+        if (!CreateSwapChain(false)) {
+            return false;
+        }
     }
 
     if (!CreateDepthStencil()) {
@@ -252,21 +295,48 @@ bool VkDemo::Init(const char* project_shader_dir,
         return false;
     }
 
+    if (!CreateFrameTimestamps()) {
+        return false;
+    }
+
     if (!CreatePipelineCache()) {
         return false;
     }
 
-    if (!CreateDescriptorPools(max_uniform_buffer, max_storage_buffer,
+    if (!CreateDescriptorPools(max_uniform_buffer, max_dynamic_uniform_buffer, max_storage_buffer,
         max_texture, max_desp_set)) {
         return false;
     }
 
+    uploader_ = new VkUploader(this);
+    if (!uploader_->Init(UPLOAD_RING_SIZE)) {
+        return false;
+    }
+
+    streamer_ = new VkStreamer(this);
+    if (!streamer_->Init()) {
+        return false;
+    }
+
     return true;
 }
 
 void VkDemo::Shutdown() {
+    if (streamer_) {
+        delete streamer_;   // waits for its uploads
+        streamer_ = nullptr;
+    }
+
+    if (uploader_) {
+        delete uploader_;   // waits for its submissions
+        uploader_ = nullptr;
+    }
+
+    WaitFramesInFlight();
+
     DestroyDescriptorPools();
     DestroyPipelineCache();
+    DestroyFrameTimestamps();
     FreeCommandBuffers();
     DestroyCommandPools();
     DestroyFramebuffers();
@@ -276,46 +346,152 @@ void VkDemo::Shutdown() {
     DestroySwapChain();
     DestroySurface();
     DestroyDemoSemaphores();
+
+    if (allocator_) {
+        delete allocator_;  // reports what the demo did not free
+        allocator_ = nullptr;
+    }
+
     DestroyDevice();
     DestroyVkInstance();
 }
 
+bool VkDemo::ParseCommandLine(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+
+        if (!strcmp(arg, "-headless")) {
+            cfg_headless_ = true;
+            // the frame count is optional
+            if (value[0] >= '0' && value[0] <= '9') {
+                cfg_headless_frames_ = (uint32_t)atoi(value);
+                i++;
+            }
+        }
+        else if (!strcmp(arg, "-capture") && value[0]) {
+            cfg_headless_capture_interval_ = (uint32_t)atoi(value);
+            i++;
+        }
+        else if (!strcmp(arg, "-size") && i + 2 < argc) {
+            cfg_viewport_cx_ = (uint32_t)atoi(argv[i + 1]);
+            cfg_viewport_cy_ = (uint32_t)atoi(argv[i + 2]);
+            i += 2;
+        }
+        else if (!strcmp(arg, "-orbit") && value[0]) {
+            cfg_headless_yaw_per_frame_ = (float)atof(value);
+            i++;
+        }
+        else if (!strcmp(arg, "-inflight") && value[0]) {
+            cfg_frames_in_flight_ = (uint32_t)atoi(value);
+            i++;
+        }
+        else if (!strcmp(arg, "-memdump") && value[0]) {
+            Str_Copy(cfg_memory_dump_, MAX_PATH, value);
+            i++;
+        }
+        else {
+            printf("usage: %s [-headless [frames]] [-capture every_n_frames] [-size width height] [-orbit degrees_per_frame] [-inflight frames] [-memdump json_file]\n", argv[0]);
+            return false;
+        }
+    }
+
+    if (cfg_frames_in_flight_ < 1 || cfg_frames_in_flight_ > MAX_FRAMES_IN_FLIGHT) {
+        printf("frames in flight must be 1 ~ %d\n", MAX_FRAMES_IN_FLIGHT);
+        return false;
+    }
+
+    if (!cfg_headless_frames_ || !cfg_viewport_cx_ || !cfg_viewport_cy_) {
+        printf("frames, width and height must be positive\n");
+        return false;
+    }
+
+    return true;
+}
+
 void VkDemo::Display() {
     uint32_t current_image_idx = 0;
     VkResult rt;
 
-    Update();
+    uint32_t slot = vk_frame_idx_ % (uint32_t)vk_wait_fence_count_;
+    VkFence fence = vk_wait_fences_[slot];
 
-    // If semaphore is not VK_NULL_HANDLE, it must not have any uncompleted signal or wait
-    //   operations pending
-    // If fence is not VK_NULL_HANDLE, fence must be unsignaled
-    // semaphore and fence must not both be equal to VK_NULL_HANDLE
-    rt = vkAcquireNextImageKHR(vk_device_, vk_swapchain_, UINT64_MAX /* never timeout */,
-        vk_semaphore_present_complete_, VK_NULL_HANDLE, &current_image_idx);
+    auto t_wait = std::chrono::steady_clock::now();
 
-    if (rt != VK_SUCCESS) {
-        printf("vkAcquireNextImageKHR error\n");
+    // the frame drawn vk_wait_fence_count_ frames ago is done, its semaphore and fence are free again
+    if (!WaitFrameSlot(slot)) {
         return;
     }
 
-    VkFence fence = vk_wait_fences_[current_image_idx];
+    if (cfg_headless_) {
+        // nothing to acquire from, one offscreen image per frame in flight
+        current_image_idx = slot;
+    }
+    else {
+        // If semaphore is not VK_NULL_HANDLE, it must not have any uncompleted signal or wait
+        //   operations pending
+        // If fence is not VK_NULL_HANDLE, fence must be unsignaled
+        // semaphore and fence must not both be equal to VK_NULL_HANDLE
+        rt = vkAcquireNextImageKHR(vk_device_, vk_swapchain_, UINT64_MAX /* never timeout */,
+            vk_semaphore_present_complete_[slot], VK_NULL_HANDLE, &current_image_idx);
+
+        if (rt != VK_SUCCESS) {
+            printf("vkAcquireNextImageKHR error\n");
+            return;
+        }
+    }
+
+    // the command buffer and the uniform copies of the image may belong to a frame of another slot
+    VkFence image_fence = vk_image_fences_[current_image_idx];
+    if (image_fence && image_fence != fence) {
+        vkWaitForFences(vk_device_, 1, &image_fence, VK_TRUE, UINT64_MAX);
+    }
+    vk_image_fences_[current_image_idx] = fence;
+
+    frame_timing_.cpu_wait_ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_wait).count();
+
+    // textures swapped in by the streamer invalidate the command buffers that bound their descriptor sets
+    if (streamer_ && streamer_->Pump()) {
+        WaitFramesInFlight();
+        BuildCommandBuffers();
+    }
+
+    vk_current_image_ = current_image_idx;
+
+    Update();
+
+    // the first frame waits for the whole initial upload: one submission, one wait
+    if (uploads_pending_) {
+        FlushUploads();
+    }
 
-    vkWaitForFences(vk_device_, 1, &fence, VK_TRUE /* waitAll */, UINT64_MAX /* never timeout */);
     vkResetFences(vk_device_, 1, &fence);	// set the state of current fence to unsignal.
 
     VkSubmitInfo submit_info = {};
 
     VkPipelineStageFlags pipeline_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
+    // timestamps around the draw command buffer, same submission
+    VkCommandBuffer cmd_buffers[3];
+    uint32_t cmd_buffer_count = 0;
+
+    if (vk_timestamp_query_pool_) {
+        cmd_buffers[cmd_buffer_count++] = vk_timestamp_cmd_buffers_[slot][0];
+    }
+    cmd_buffers[cmd_buffer_count++] = vk_draw_cmd_buffers_[current_image_idx];
+    if (vk_timestamp_query_pool_) {
+        cmd_buffers[cmd_buffer_count++] = vk_timestamp_cmd_buffers_[slot][1];
+    }
+
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit_info.pNext = nullptr;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &vk_semaphore_present_complete_;
+    submit_info.waitSemaphoreCount = cfg_headless_ ? 0 : 1;
+    submit_info.pWaitSemaphores = &vk_semaphore_present_complete_[slot];
     submit_info.pWaitDstStageMask = &pipeline_stage_flags;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &vk_draw_cmd_buffers_[current_image_idx];
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &vk_semaphore_render_complete_;
+    submit_info.commandBufferCount = cmd_buffer_count;
+    submit_info.pCommandBuffers = cmd_buffers;
+    submit_info.signalSemaphoreCount = cfg_headless_ ? 0 : 1;
+    submit_info.pSignalSemaphores = &vk_semaphore_render_complete_[current_image_idx];
 
     rt = vkQueueSubmit(vk_graphics_queue_, 1, &submit_info, fence);
     if (rt != VK_SUCCESS) {
@@ -323,51 +499,70 @@ void VkDemo::Display() {
         return;
     }
 
-    VkPresentInfoKHR present_info = {};
+    frame_timed_[slot] = vk_timestamp_query_pool_ != VK_NULL_HANDLE;
+    vk_frame_idx_++;
 
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pNext = nullptr;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &vk_semaphore_render_complete_;
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = &vk_swapchain_;
-    present_info.pImageIndices = &current_image_idx;
-    present_info.pResults = nullptr;
+    if (!cfg_headless_) {
+        VkPresentInfoKHR present_info = {};
 
-    rt = vkQueuePresentKHR(vk_graphics_queue_, &present_info);
-    if (rt != VK_SUCCESS) {
-        printf("vkQueuePresentKHR error\n");
-        return;
-    }
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.pNext = nullptr;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &vk_semaphore_render_complete_[current_image_idx];
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &vk_swapchain_;
+        present_info.pImageIndices = &current_image_idx;
+        present_info.pResults = nullptr;
 
-    rt = vkQueueWaitIdle(vk_graphics_queue_);
-    if (rt != VK_SUCCESS) {
-        printf("vkQueueWaitIdle error\n");
-        return;
+        rt = vkQueuePresentKHR(vk_graphics_queue_, &present_info);
+        if (rt != VK_SUCCESS) {
+            printf("vkQueuePresentKHR error\n");
+            return;
+        }
     }
+
+    // no vkQueueWaitIdle: the next Display waits for this frame only when its slot comes around again
 }
 
 void VkDemo::WindowSizeChanged() {
     // override by child class
 }
 
+bool VkDemo::SwapchainImageCountChanged() {
+    // override by child class
+    return true;
+}
+
 void VkDemo::Update() {
     // override by child class
 }
 
 void VkDemo::MainLoop() {
+    if (cfg_headless_) {
+        HeadlessLoop();
+    }
+    else {
 #if defined(_WIN32)
 
-    if (enable_display_) {
-        Display();
+        if (enable_display_) {
+            Display();
+        }
+
+        MSG msg = {};
+        while (GetMessage(&msg, NULL, 0, 0)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+#endif
     }
 
-    MSG msg = {};
-    while (GetMessage(&msg, NULL, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    // the demo destroys its resources after MainLoop
+    WaitFramesInFlight();
+
+    // the resources of the demo are all still there
+    if (cfg_memory_dump_[0] && allocator_ && allocator_->DumpJson(cfg_memory_dump_)) {
+        printf("Device memory written to %s\n", cfg_memory_dump_);
     }
-#endif
 }
 
 // interface
@@ -411,6 +606,36 @@ bool VkDemo::LoadModel(const char* filename, bool move_to_origin,
     return Model_Load(full_filename, move_to_origin, model, transform);
 }
 
+void VkDemo::GetTextureFilename(const char* filename, char* full_filename, int full_filename_cap) const {
+    if (filename[0] == '/' || filename[1] == ':') {
+        Str_Copy(full_filename, full_filename_cap, filename);    // absolute push
+    }
+    else {
+        // relative path, load from textures folder
+        Str_SPrintf(full_filename, full_filename_cap, "%s/%s", textures_dir_, filename);
+    }
+}
+
+VkStreamer* VkDemo::GetStreamer() const {
+    return streamer_;
+}
+
+VkMemoryAllocator* VkDemo::GetMemoryAllocator() const {
+    return allocator_;
+}
+
+VkUploader* VkDemo::GetUploader() const {
+    return uploader_;
+}
+
+void VkDemo::FlushUploads() {
+    if (uploader_) {
+        uploader_->FlushAndWait();
+    }
+
+    uploads_pending_ = false;
+}
+
 bool VkDemo::CreateBuffer(vk_buffer_s& buffer, 
     VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_prop_flags, VkDeviceSize req_size) const
 {
@@ -435,21 +660,24 @@ bool VkDemo::CreateBuffer(vk_buffer_s& buffer,
     VkMemoryRequirements mem_req = {};
     vkGetBufferMemoryRequirements(vk_device_, buffer.buffer_, &mem_req);
 
-    VkMemoryAllocateInfo mem_alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = mem_req.size,
-        .memoryTypeIndex = GetMemoryTypeIndex(mem_req.memoryTypeBits, mem_prop_flags)
-    };
+    uint32_t memory_type_index = GetMemoryTypeIndex(mem_req.memoryTypeBits, mem_prop_flags);
+    if (memory_type_index == (uint32_t)-1) {
+        return false;
+    }
+
+    // staging and readback buffers live for one copy
+    bool transient = (usage & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) == 0 &&
+        (mem_prop_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-    if (VK_SUCCESS != vkAllocateMemory(vk_device_, &mem_alloc_info, nullptr, &buffer.memory_)) {
+    if (!allocator_->Alloc(mem_req, memory_type_index,
+        transient ? VkMemoryAllocator::usage_t::TRANSIENT : VkMemoryAllocator::usage_t::RESOURCE, buffer.allocation_)) {
         return false;
     }
 
     buffer.memory_prop_flags_ = mem_prop_flags;
     buffer.memory_size_ = aligned_req_size; // not mem_req.size;
 
-    if (VK_SUCCESS != vkBindBufferMemory(vk_device_, buffer.buffer_, buffer.memory_, 0)) {
+    if (VK_SUCCESS != vkBindBufferMemory(vk_device_, buffer.buffer_, buffer.allocation_.memory_, buffer.allocation_.offset_)) {
         return false;
     }
 
@@ -457,16 +685,16 @@ bool VkDemo::CreateBuffer(vk_buffer_s& buffer,
 }
 
 void VkDemo::DestroyBuffer(vk_buffer_s& buffer) const {
-    if (buffer.memory_) {
-        vkFreeMemory(vk_device_, buffer.memory_, nullptr);
-        buffer.memory_ = VK_NULL_HANDLE;
-    }
-
+    // the buffer goes before its memory range can be handed out again
     if (buffer.buffer_) {
         vkDestroyBuffer(vk_device_, buffer.buffer_, nullptr);
         buffer.buffer_ = VK_NULL_HANDLE;
     }
 
+    if (buffer.allocation_.memory_) {
+        allocator_->Free(buffer.allocation_);
+    }
+
     memset(&buffer, 0, sizeof(buffer));
 }
 
@@ -482,45 +710,18 @@ bool VkDemo::UpdateBuffer(vk_buffer_s& buffer, const void* host_data, size_t hos
 }
 
 void* VkDemo::MapBuffer(vk_buffer_s& buffer) const {
-    // entire range: TO FIX
-    VkDeviceSize offset = 0;
-    VkDeviceSize range = buffer.memory_size_;
-
-    void* data = nullptr;
-    VkResult rt = vkMapMemory(vk_device_, buffer.memory_, offset, range, 0, &data);
-    if (rt != VK_SUCCESS) {
-        printf("[MapBuffer] vkMapMemory error\n");
+    // host visible blocks of the allocator are mapped for their lifetime
+    if (!buffer.allocation_.mapped_) {
+        printf("[MapBuffer] buffer is not host visible\n");
         return nullptr;
     }
 
-    return data;
+    return buffer.allocation_.mapped_;
 }
 
 bool VkDemo::UnmapBuffer(vk_buffer_s& buffer) const {
-    bool ok = true;
-
-    if ((buffer.memory_prop_flags_ & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
-        // not use host cache management commands
-
-        // flush to make change visible to device
-        VkMappedMemoryRange mapped_range = {};
-
-        mapped_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mapped_range.pNext = nullptr;
-        mapped_range.memory = buffer.memory_;
-        mapped_range.offset = 0;
-        mapped_range.size = buffer.memory_size_;
-
-        VkResult rt = vkFlushMappedMemoryRanges(vk_device_, 1, &mapped_range);
-        if (rt != VK_SUCCESS) {
-            ok = false;
-            printf("[UpdateBuffer] vkFlushMappedMemoryRanges error\n");
-        }
-    }
-
-    vkUnmapMemory(vk_device_, buffer.memory_);
-
-    return ok;
+    // flush to make change visible to device, nothing to do on coherent memory
+    return allocator_->Flush(buffer.allocation_, 0, buffer.memory_size_);
 }
 
 // Staging buffer
@@ -529,89 +730,32 @@ bool VkDemo::UnmapBuffer(vk_buffer_s& buffer) const {
 bool VkDemo::CreateBufferAddInitData(vk_buffer_s& buffer, VkBufferUsageFlags usage_flags, 
     const void* data, size_t data_size, bool staging) 
 {
-    vk_buffer_s temp_buffer = {};
-
-    VkBufferUsageFlags temp_buffer_usage_flags = usage_flags;
-    if (staging) {
-        temp_buffer_usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    }
-
-    if (!CreateBuffer(temp_buffer, temp_buffer_usage_flags,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        data_size)) {
-        DestroyBuffer(temp_buffer);
-        return false;
-    }
-
-    if (!UpdateBuffer(temp_buffer, data, data_size)) {
-        return false;
-    }
-
     if (!staging) {
-        buffer = temp_buffer;
-        return true;
+        if (!CreateBuffer(buffer, usage_flags,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            data_size)) {
+            DestroyBuffer(buffer);
+            return false;
+        }
+
+        return UpdateBuffer(buffer, data, data_size);
     }
 
     if (!CreateBuffer(buffer, usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, data_size)) {
         DestroyBuffer(buffer);
-        DestroyBuffer(temp_buffer);
-        return false;
-    }
-
-    VkCommandPool command_pool = vk_command_pool_transient_;
-
-    VkCommandBuffer cmd_buffer_copy_buffer = VK_NULL_HANDLE;
-
-    VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
-
-    cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmd_buffer_alloc_info.pNext = nullptr;
-    cmd_buffer_alloc_info.commandPool = command_pool;
-    cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmd_buffer_alloc_info.commandBufferCount = 1;
-
-    if (VK_SUCCESS != vkAllocateCommandBuffers(vk_device_, &cmd_buffer_alloc_info, &cmd_buffer_copy_buffer)) {
-        DestroyBuffer(buffer);
-        DestroyBuffer(temp_buffer);
-        return false;
-    }
-
-    VkCommandBufferBeginInfo cmdbuf_begin_info = {};
-
-    cmdbuf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdbuf_begin_info.pNext = nullptr;
-    cmdbuf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    cmdbuf_begin_info.pInheritanceInfo = nullptr;
-
-    if (VK_SUCCESS != vkBeginCommandBuffer(cmd_buffer_copy_buffer, &cmdbuf_begin_info)) {
-        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_copy_buffer);
-        DestroyBuffer(buffer);
-        DestroyBuffer(temp_buffer);
         return false;
     }
 
-    VkBufferCopy buffer_copy = {};
-
-    buffer_copy.srcOffset = 0;
-    buffer_copy.dstOffset = 0;
-    buffer_copy.size = data_size;
-
-    vkCmdCopyBuffer(cmd_buffer_copy_buffer, temp_buffer.buffer_, buffer.buffer_, 1, &buffer_copy);
-
-    if (VK_SUCCESS != vkEndCommandBuffer(cmd_buffer_copy_buffer)) {
-        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_copy_buffer);
+    // copied through the staging ring of the uploader by the next flush, no submission of its own
+    void* dst = uploader_->UploadBuffer(buffer.buffer_, 0, data_size);
+    if (!dst) {
         DestroyBuffer(buffer);
-        DestroyBuffer(temp_buffer);
         return false;
     }
 
-    SubmitCommandBufferAndWait(cmd_buffer_copy_buffer);
-
-    vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_copy_buffer);
-
-    // free staging buffer
-    DestroyBuffer(temp_buffer);
+    memcpy(dst, data, data_size);
+    uploads_pending_ = true;
 
     return true;
 }
@@ -656,7 +800,7 @@ bool VkDemo::CreateSampler(VkFilter mag_filter, VkFilter min_filter, VkSamplerMi
     create_info.compareEnable = VK_FALSE;
     create_info.compareOp = VK_COMPARE_OP_NEVER;
     create_info.minLod = 0.0f;
-    create_info.maxLod = 1.0f;
+    create_info.maxLod = VK_LOD_CLAMP_NONE;    // every mip level
     create_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE; // if clamp to border
     create_info.unnormalizedCoordinates = VK_FALSE;
 
@@ -676,7 +820,8 @@ bool VkDemo::Create2DImage(vk_image_s& vk_image, VkImageCreateFlags flags, VkFor
     VkImageAspectFlags image_aspect_flags,
     VkImageViewType image_view_type,
     VkSampler sampler,   
-    VkImageLayout image_layout)
+    VkImageLayout image_layout,
+    uint32_t mip_levels)
 {
     VkImageCreateInfo image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -685,7 +830,7 @@ bool VkDemo::Create2DImage(vk_image_s& vk_image, VkImageCreateFlags flags, VkFor
         .imageType = VK_IMAGE_TYPE_2D,
         .format = format,
         .extent = { width, height, 1},
-        .mipLevels = 1,
+        .mipLevels = mip_levels,
         .arrayLayers = array_layers,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = tiling,
@@ -703,22 +848,21 @@ bool VkDemo::Create2DImage(vk_image_s& vk_image, VkImageCreateFlags flags, VkFor
     VkMemoryRequirements memory_requirements = {};
     vkGetImageMemoryRequirements(vk_device_, vk_image.image_, &memory_requirements);
 
-    VkMemoryAllocateInfo memory_allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = memory_requirements.size,
-        .memoryTypeIndex = GetMemoryTypeIndex(
-            memory_requirements.memoryTypeBits,
-            memory_property_flags)
-    };
+    uint32_t memory_type_index = GetMemoryTypeIndex(memory_requirements.memoryTypeBits, memory_property_flags);
+    if (memory_type_index == (uint32_t)-1) {
+        return false;
+    }
 
-    if (VK_SUCCESS != vkAllocateMemory(vk_device_, &memory_allocate_info, nullptr, &vk_image.memory_)) {
+    // optimal tiling images get blocks of their own: no bufferImageGranularity between them and buffers
+    if (!allocator_->Alloc(memory_requirements, memory_type_index,
+        tiling == VK_IMAGE_TILING_OPTIMAL ? VkMemoryAllocator::usage_t::IMAGE : VkMemoryAllocator::usage_t::RESOURCE,
+        vk_image.allocation_)) {
         return false;
     }
 
     vk_image.memory_prop_flags_ = memory_property_flags;
 
-    if (VK_SUCCESS != vkBindImageMemory(vk_device_, vk_image.image_, vk_image.memory_, 0 /* memoryOffset */)) {
+    if (VK_SUCCESS != vkBindImageMemory(vk_device_, vk_image.image_, vk_image.allocation_.memory_, vk_image.allocation_.offset_)) {
         return false;
     }
 
@@ -736,7 +880,7 @@ bool VkDemo::Create2DImage(vk_image_s& vk_image, VkImageCreateFlags flags, VkFor
     // components
     image_view_create_info.subresourceRange.aspectMask = image_aspect_flags;
     image_view_create_info.subresourceRange.baseMipLevel = 0;
-    image_view_create_info.subresourceRange.levelCount = 1;
+    image_view_create_info.subresourceRange.levelCount = mip_levels;
     image_view_create_info.subresourceRange.baseArrayLayer = 0;
     image_view_create_info.subresourceRange.layerCount = array_layers;
 
@@ -745,8 +889,10 @@ bool VkDemo::Create2DImage(vk_image_s& vk_image, VkImageCreateFlags flags, VkFor
         return false;
     }
 
+    vk_image.format_ = format;
     vk_image.width_ = width;
     vk_image.height_ = height;
+    vk_image.mip_levels_ = mip_levels;
 
     vk_image.desc_image_info_.sampler = sampler;
     vk_image.desc_image_info_.imageView = vk_image.image_view_;
@@ -760,14 +906,14 @@ void VkDemo::DestroyImage(vk_image_s& vk_image) {
         vkDestroyImageView(vk_device_, vk_image.image_view_, nullptr);
     }
 
-    if (vk_image.memory_) {
-        vkFreeMemory(vk_device_, vk_image.memory_, nullptr);
-    }
-
     if (vk_image.image_) {
         vkDestroyImage(vk_device_, vk_image.image_, nullptr);
     }
 
+    if (vk_image.allocation_.memory_) {
+        allocator_->Free(vk_image.allocation_);
+    }
+
     memset(&vk_image, 0, sizeof(vk_image));
 }
 
@@ -776,24 +922,9 @@ bool VkDemo::Load2DTexture(const char* filename,
     VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image) 
 {
     memset(&vk_image, 0, sizeof(vk_image));
-    
-    VkFormatProperties format_properties;
-    vkGetPhysicalDeviceFormatProperties(vk_physical_device_, format, &format_properties);
-
-    if (!(format_properties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
-        printf("linearTilingFeatures not support VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT\n");
-        return false;
-    }
 
     char full_filename[MAX_PATH];
-
-    if (filename[0] == '/' || filename[1] == ':') {
-        Str_Copy(full_filename, MAX_PATH, filename);    // absolute push
-    }
-    else {
-        // relative path, load from textures folder
-        Str_SPrintf(full_filename, MAX_PATH, "%s/%s", textures_dir_, filename);
-    }
+    GetTextureFilename(filename, full_filename, MAX_PATH);
 
     image_s pic = {};
     if (!Img_Load(full_filename, pic)) {
@@ -801,24 +932,7 @@ bool VkDemo::Load2DTexture(const char* filename,
         return false;
     }
 
-    // VK_IMAGE_TILING_OPTIMAL: texels are laid out in an implementation-dependent arrangement, 
-    //                          for more efficient memory access
-
-    // VK_IMAGE_TILING_LINEAR: specifies linear tiling (texels are laid out in memory in row-major order, 
-    //                         possibly with some padding on each row).
-    if (!Create2DImage(vk_image, 0, format, VK_IMAGE_TILING_LINEAR, image_usage,
-        (uint32_t)pic.width_, (uint32_t)pic.height_, 1,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, sampler, image_layout))
-    {
-        Img_Free(pic);
-        return false;
-    }
-
-    vk_image.width_ = (uint32_t)pic.width_;
-    vk_image.height_ = (uint32_t)pic.height_;
-
-    bool ok = Update2DTexture(pic, vk_image);
+    bool ok = Create2DTexture(pic, format, image_usage, sampler, image_layout, vk_image);
 
     Img_Free(pic);
 
@@ -836,99 +950,121 @@ bool VkDemo::Update2DTexture(const image_s& pic, vk_image_s& vk_image) {
         return false;
     }
 
-    // copy contents
-    void* mapped = nullptr;
-    if (VK_SUCCESS != vkMapMemory(vk_device_, vk_image.memory_, 0, vk_image.memory_size_, 0 /* flags */, &mapped)) {
+    // the frames in flight may sample the old levels
+    WaitFramesInFlight();
+
+    if (!QueueTextureUpload(pic, vk_image)) {
         return false;
     }
 
-    memcpy(mapped, pic.pixels_, pic.width_ * pic.height_ * 4);
+    FlushUploads();
 
-    if ((vk_image.memory_prop_flags_ & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
-        // not use host cache management commands
+    return true;
+}
 
-        // flush to make change visible to device
-        VkMappedMemoryRange mapped_range = {};
+bool VkDemo::Create2DTexture(const image_s& pic, VkFormat format, VkImageUsageFlags image_usage,
+    VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image, bool async)
+{
+    memset(&vk_image, 0, sizeof(vk_image));
 
-        mapped_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mapped_range.pNext = nullptr;
-        mapped_range.memory = vk_image.memory_;
-        mapped_range.offset = 0;
-        mapped_range.size = vk_image.memory_size_;
+    if (pic.format_ != image_format_t::R8G8B8A8) {
+        printf("Not a RGBA pic\n");
+        return false;
+    }
 
-        if (VK_SUCCESS != vkFlushMappedMemoryRanges(vk_device_, 1, &mapped_range)) {
-            vkUnmapMemory(vk_device_, vk_image.memory_);
-            printf("[UpdateBuffer] vkFlushMappedMemoryRanges error\n");
-            return false;
-        }
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(vk_physical_device_, format, &format_properties);
+
+    if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        printf("optimalTilingFeatures not support VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT\n");
+        return false;
     }
 
-    vkUnmapMemory(vk_device_, vk_image.memory_);
+    // full chain down to 1x1
+    uint32_t mip_levels = 1;
+    for (uint32_t size = (uint32_t)(pic.width_ > pic.height_ ? pic.width_ : pic.height_); size > 1; size >>= 1) {
+        mip_levels++;
+    }
 
-    // change layout from VK_IMAGE_LAYOUT_UNDEFINED -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    // VK_IMAGE_TILING_OPTIMAL: texels are laid out in an implementation-dependent arrangement, 
+    //                          for more efficient memory access, so they are copied in from a staging buffer
+    if (!Create2DImage(vk_image, 0, format, VK_IMAGE_TILING_OPTIMAL,
+        image_usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        (uint32_t)pic.width_, (uint32_t)pic.height_, 1,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, sampler, image_layout, mip_levels))
+    {
+        DestroyImage(vk_image);
+        return false;
+    }
 
-    VkCommandPool command_pool = vk_command_pool_transient_;
+    if (!QueueTextureUpload(pic, vk_image)) {
+        DestroyImage(vk_image);
+        return false;
+    }
 
-    VkCommandBuffer cmd_buffer_load_tex = VK_NULL_HANDLE;
+    if (!async) {
+        uploads_pending_ = true;
+    }
 
-    VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
+    return true;
+}
 
-    cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmd_buffer_alloc_info.pNext = nullptr;
-    cmd_buffer_alloc_info.commandPool = command_pool;
-    cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmd_buffer_alloc_info.commandBufferCount = 1;
+bool VkDemo::QueueTextureUpload(const image_s& pic, vk_image_s& vk_image) {
+    uint32_t mip_levels = vk_image.mip_levels_ > 1 ? vk_image.mip_levels_ : 1;
 
-    if (VK_SUCCESS != vkAllocateCommandBuffers(vk_device_, &cmd_buffer_alloc_info, &cmd_buffer_load_tex)) {
-        return false;
-    }
+    // levels blitted from level 0 when the format allows linear blits, otherwise filtered on the CPU
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(vk_physical_device_, vk_image.format_, &format_properties);
 
-    VkCommandBufferBeginInfo cmdbuf_begin_info = {};
+    const VkFormatFeatureFlags BLIT_FEATURES = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    bool gpu_mipmaps = mip_levels > 1 && !cfg_cpu_mipmaps_
+        && (format_properties.optimalTilingFeatures & BLIT_FEATURES) == BLIT_FEATURES;
 
-    cmdbuf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdbuf_begin_info.pNext = nullptr;
-    cmdbuf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    cmdbuf_begin_info.pInheritanceInfo = nullptr;
+    image_s mipmapped = {};
+    const image_s* src = &pic;
 
-    if (VK_SUCCESS != vkBeginCommandBuffer(cmd_buffer_load_tex, &cmdbuf_begin_info)) {
-        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
-        return false;
+    if (mip_levels > 1 && !gpu_mipmaps) {
+        bool srgb = vk_image.format_ == VK_FORMAT_R8G8B8A8_SRGB || vk_image.format_ == VK_FORMAT_B8G8R8A8_SRGB;
+        if (!Img_GenerateMipmaps(pic, mip_filter_t::BOX, srgb, mipmapped) || (uint32_t)mipmapped.mip_levels_ != mip_levels) {
+            Img_Free(mipmapped);
+            return false;
+        }
+        src = &mipmapped;
     }
 
-    VkImageMemoryBarrier image_memory_barrier = {};
+    uint32_t upload_levels = gpu_mipmaps ? 1 : mip_levels;
 
-    image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    image_memory_barrier.pNext = nullptr;
-    image_memory_barrier.srcAccessMask = 0;
-    image_memory_barrier.dstAccessMask = 0;
-    image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;	// wrong: VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL
-    image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    image_memory_barrier.image = vk_image.image_;
-    image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    image_memory_barrier.subresourceRange.baseMipLevel = 0;
-    image_memory_barrier.subresourceRange.levelCount = 1;
-    image_memory_barrier.subresourceRange.baseArrayLayer = 0;
-    image_memory_barrier.subresourceRange.layerCount = 1;
-    SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
+    std::vector<VkBufferImageCopy> copies(upload_levels);
+    size_t buf_sz = 0;
 
-    vkCmdPipelineBarrier(cmd_buffer_load_tex,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        0 /* dependencyFlags */,
-        0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
-        0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
-        1, &image_memory_barrier);
+    for (uint32_t level = 0; level < upload_levels; ++level) {
+        VkBufferImageCopy& copy = copies[level];
+        copy.bufferOffset = Img_GetSubresourceOffset(*src, 0, (int)level);
+        copy.bufferRowLength = 0;
+        copy.bufferImageHeight = 0;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.mipLevel = level;
+        copy.imageSubresource.baseArrayLayer = 0;
+        copy.imageSubresource.layerCount = 1;
+        copy.imageOffset = { 0, 0, 0 };
+        copy.imageExtent.width = (vk_image.width_ >> level) > 0 ? (vk_image.width_ >> level) : 1;
+        copy.imageExtent.height = (vk_image.height_ >> level) > 0 ? (vk_image.height_ >> level) : 1;
+        copy.imageExtent.depth = 1;
 
-    if (VK_SUCCESS != vkEndCommandBuffer(cmd_buffer_load_tex)) {
-        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
+        buf_sz += Img_GetLevelSize(*src, (int)level);
+    }
+
+    void* dst = uploader_->UploadImage(vk_image, 1, buf_sz, copies.data(), upload_levels, gpu_mipmaps);
+    if (!dst) {
+        Img_Free(mipmapped);
         return false;
     }
 
-    SubmitCommandBufferAndWait(cmd_buffer_load_tex);
+    memcpy(dst, src->pixels_, buf_sz);
 
-    vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
+    Img_Free(mipmapped);
 
     return true;
 }
@@ -956,14 +1092,7 @@ bool VkDemo::LoadCubeMaps(const char* filename,
     memset(&vk_image, 0, sizeof(vk_image));
 
     char full_filename[MAX_PATH];
-
-    if (filename[0] == '/' || filename[1] == ':') {
-        Str_Copy(full_filename, MAX_PATH, filename);    // absolute push
-    }
-    else {
-        // relative path, load from textures folder
-        Str_SPrintf(full_filename, MAX_PATH, "%s/%s", textures_dir_, filename);
-    }
+    GetTextureFilename(filename, full_filename, MAX_PATH);
 
     image_s pic = {};
     if (!Img_Load(full_filename, pic)) {
@@ -986,27 +1115,50 @@ bool VkDemo::LoadCubeMaps(const char* filename,
         return false;
     }
 
-    size_t buf_sz = face_w * face_h * 4 * 6;
+    // specify VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT for cube maps
+    // add VK_IMAGE_USAGE_TRANSFER_DST_BIT flag to use vkCmdCopyBufferToImage command
 
-    vk_buffer_s vk_buf = {};
-    if (!CreateBuffer(vk_buf, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buf_sz))
-    {
+    if (!Create2DImage(vk_image, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
+        format, VK_IMAGE_TILING_OPTIMAL, image_usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, face_w, face_h, 6 /* cube map has 6 faces */,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE,
+        sampler,
+        image_layout)) {
+        DestroyImage(vk_image);
         Img_Free(pic);
-        printf("\"%s\": could not allocate buffer\n", full_filename);
         return false;
     }
 
-    void* vk_buf_ptr = MapBuffer(vk_buf);
-    if (!vk_buf_ptr) {
-        DestroyBuffer(vk_buf);
+    size_t buf_sz = face_w * face_h * 4 * 6;
+
+    std::array<VkBufferImageCopy, 6> buffer_image_copy_array;
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        buffer_image_copy_array[i].bufferOffset = i * face_w * face_h * 4;
+        buffer_image_copy_array[i].bufferRowLength = 0;
+        buffer_image_copy_array[i].bufferImageHeight = 0;
+        buffer_image_copy_array[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        buffer_image_copy_array[i].imageSubresource.mipLevel = 0;
+        buffer_image_copy_array[i].imageSubresource.baseArrayLayer = i;
+        buffer_image_copy_array[i].imageSubresource.layerCount = 1;
+        buffer_image_copy_array[i].imageOffset.x = 0;
+        buffer_image_copy_array[i].imageOffset.y = 0;
+        buffer_image_copy_array[i].imageOffset.z = 0;
+        buffer_image_copy_array[i].imageExtent.width = face_w;
+        buffer_image_copy_array[i].imageExtent.height = face_h;
+        buffer_image_copy_array[i].imageExtent.depth = 1;
+    }
+
+    // the faces are cut out straight into the staging ring
+    byte_t* dst = (byte_t*)uploader_->UploadImage(vk_image, 6 /* 6 faces */, buf_sz,
+        buffer_image_copy_array.data(), 6, false);
+    if (!dst) {
+        DestroyImage(vk_image);
         Img_Free(pic);
-        printf("\"%s\": map buffer error\n", full_filename);
+        printf("\"%s\": could not stage the faces\n", full_filename);
         return false;
     }
 
-    byte_t* dst = (byte_t*)vk_buf_ptr;
-
     // pair: x offset, y offset
     std::array<std::pair<uint32_t, uint32_t>, 6> face_offsets = {
         std::pair<uint32_t, uint32_t>(face_w * 2, face_h * 1),
@@ -1028,143 +1180,155 @@ bool VkDemo::LoadCubeMaps(const char* filename,
         dst += (face_w * face_h * 4);
     }
 
-    UnmapBuffer(vk_buf);
+    Img_Free(pic);
+    uploads_pending_ = true;
 
-    // specify VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT for cube maps
-    // add VK_IMAGE_USAGE_TRANSFER_DST_BIT flag to use vkCmdCopyBufferToImage command
+    return true;
+}
 
-    if (Create2DImage(vk_image, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
-        format, VK_IMAGE_TILING_OPTIMAL, image_usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, face_w, face_h, 6 /* cube map has 6 faces */,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE,
-        sampler,
-        image_layout)) {
+bool VkDemo::LoadCompressedTexture(const char* filename, VkImageUsageFlags image_usage,
+    VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image)
+{
+    memset(&vk_image, 0, sizeof(vk_image));
+
+    char full_filename[MAX_PATH];
+    GetTextureFilename(filename, full_filename, MAX_PATH);
+
+    image_s pic = {};
+    if (!Img_LoadCompressed(full_filename, pic)) {
+        printf("Failed to load texture \"%s\"\n", full_filename);
+        return false;
+    }
 
+    bool ok = UploadImage(pic, image_usage, sampler, image_layout, vk_image);
 
-        VkCommandPool command_pool = vk_command_pool_transient_;
-        VkCommandBuffer cmd_buffer_load_tex = VK_NULL_HANDLE;
+    Img_Free(pic);
 
-        VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
+    return ok;
+}
 
-        cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmd_buffer_alloc_info.pNext = nullptr;
-        cmd_buffer_alloc_info.commandPool = command_pool;
-        cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmd_buffer_alloc_info.commandBufferCount = 1;
+bool VkDemo::UploadImage(const image_s& pic, VkImageUsageFlags image_usage,
+    VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image)
+{
+    memset(&vk_image, 0, sizeof(vk_image));
 
-        if (VK_SUCCESS != vkAllocateCommandBuffers(vk_device_, &cmd_buffer_alloc_info, &cmd_buffer_load_tex)) {
-            DestroyImage(vk_image);
-            DestroyBuffer(vk_buf);
-            Img_Free(pic);
-            return false;
+    uint32_t mip_levels = pic.mip_levels_ > 1 ? (uint32_t)pic.mip_levels_ : 1;
+    uint32_t array_layers = pic.array_layers_ > 1 ? (uint32_t)pic.array_layers_ : 1;
+
+    VkFormat format = GetVkFormat(pic.format_);
+    if (format == VK_FORMAT_UNDEFINED) {
+        printf("Unsupported image format %d\n", (int)pic.format_);
+        return false;
+    }
+
+    auto Sampleable = [this](VkFormat fmt) -> bool {
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(vk_physical_device_, fmt, &format_properties);
+        return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    };
+
+    // blocks go to the GPU as they are, decoded here only when the device can't sample them
+    bool decode = false;
+    if (Img_IsCompressed(pic.format_)) {
+        if (cfg_decode_compressed_textures_ || !vk_physical_device_features_.textureCompressionBC || !Sampleable(format)) {
+            decode = true;
+            format = GetDecompressedVkFormat(pic.format_);
         }
+    }
 
-        VkCommandBufferBeginInfo cmdbuf_begin_info = {};
+    if (!Sampleable(format)) {
+        printf("Format %d could not be sampled\n", (int)format);
+        return false;
+    }
 
-        cmdbuf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cmdbuf_begin_info.pNext = nullptr;
-        cmdbuf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        cmdbuf_begin_info.pInheritanceInfo = nullptr;
+    // staging buffer, subresources in the order of image_s
+    size_t decoded_texel_bytes = format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
 
-        if (VK_SUCCESS != vkBeginCommandBuffer(cmd_buffer_load_tex, &cmdbuf_begin_info)) {
-            vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
-            DestroyImage(vk_image);
-            DestroyBuffer(vk_buf);
-            Img_Free(pic);
-            return false;
+    std::vector<VkBufferImageCopy> copies;
+    copies.reserve(array_layers * mip_levels);
+
+    size_t buf_sz = 0;
+    for (uint32_t layer = 0; layer < array_layers; ++layer) {
+        for (uint32_t level = 0; level < mip_levels; ++level) {
+            uint32_t w = ((uint32_t)pic.width_ >> level) > 0 ? ((uint32_t)pic.width_ >> level) : 1;
+            uint32_t h = ((uint32_t)pic.height_ >> level) > 0 ? ((uint32_t)pic.height_ >> level) : 1;
+
+            VkBufferImageCopy copy = {};
+            copy.bufferOffset = buf_sz;
+            copy.bufferRowLength = 0;
+            copy.bufferImageHeight = 0;
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.imageSubresource.mipLevel = level;
+            copy.imageSubresource.baseArrayLayer = layer;
+            copy.imageSubresource.layerCount = 1;
+            copy.imageOffset = { 0, 0, 0 };
+            copy.imageExtent = { w, h, 1 };
+            copies.push_back(copy);
+
+            buf_sz += decode ? (size_t)w * h * decoded_texel_bytes : Img_GetLevelSize(pic, (int)level);
         }
+    }
 
+    // decoded before the upload is queued, a subresource that fails fails the whole upload
+    std::vector<image_s> decoded(decode ? copies.size() : 0);
 
-        std::array<VkBufferImageCopy, 6> buffer_image_copy_array;
-
-        for (uint32_t i = 0; i < 6; ++i) {
-            buffer_image_copy_array[i].bufferOffset = i * face_w * face_h * 4;
-            buffer_image_copy_array[i].bufferRowLength = 0;
-            buffer_image_copy_array[i].bufferImageHeight = 0;
-            buffer_image_copy_array[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            buffer_image_copy_array[i].imageSubresource.mipLevel = 0;
-            buffer_image_copy_array[i].imageSubresource.baseArrayLayer = i;
-            buffer_image_copy_array[i].imageSubresource.layerCount = 1;
-            buffer_image_copy_array[i].imageOffset.x = 0;
-            buffer_image_copy_array[i].imageOffset.y = 0;
-            buffer_image_copy_array[i].imageOffset.z = 0;
-            buffer_image_copy_array[i].imageExtent.width = face_w;
-            buffer_image_copy_array[i].imageExtent.height = face_h;
-            buffer_image_copy_array[i].imageExtent.depth = 1;
-        }
-
-
-        VkImageMemoryBarrier image_memory_barrier = {};
-
-        image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        image_memory_barrier.pNext = nullptr;
-        image_memory_barrier.srcAccessMask = 0;
-        image_memory_barrier.dstAccessMask = 0;
-        image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        image_memory_barrier.image = vk_image.image_;
-        image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        image_memory_barrier.subresourceRange.baseMipLevel = 0;
-        image_memory_barrier.subresourceRange.levelCount = 1;
-        image_memory_barrier.subresourceRange.baseArrayLayer = 0;
-        image_memory_barrier.subresourceRange.layerCount = 6;   // 6 faces
-        SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
-
-        vkCmdPipelineBarrier(cmd_buffer_load_tex,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            0 /* dependencyFlags */,
-            0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
-            0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
-            1, &image_memory_barrier);
-
-        vkCmdCopyBufferToImage(
-            cmd_buffer_load_tex,
-            vk_buf.buffer_,
-            vk_image.image_,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            6,
-            buffer_image_copy_array.data());
-
-        // set image layout to image_layout
-        image_memory_barrier.srcAccessMask = 0;
-        image_memory_barrier.dstAccessMask = 0;
-        image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        image_memory_barrier.newLayout = image_layout;
-        SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
-
-        vkCmdPipelineBarrier(cmd_buffer_load_tex,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            0 /* dependencyFlags */,
-            0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
-            0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
-            1, &image_memory_barrier);
-
-
-        if (VK_SUCCESS != vkEndCommandBuffer(cmd_buffer_load_tex)) {
-            vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
-            DestroyImage(vk_image);
-            DestroyBuffer(vk_buf);
-            Img_Free(pic);
+    auto FreeDecoded = [&decoded]() {
+        for (image_s& level : decoded) {
+            Img_Free(level);
+        }
+    };
+
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (!Img_Decompress(pic, (int)copies[i].imageSubresource.baseArrayLayer, (int)copies[i].imageSubresource.mipLevel, decoded[i])) {
+            FreeDecoded();
             return false;
         }
+    }
 
-        SubmitCommandBufferAndWait(cmd_buffer_load_tex);
+    VkImageViewType image_view_type = VK_IMAGE_VIEW_TYPE_2D;
+    if (pic.cubemap_) {
+        image_view_type = array_layers > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+    }
+    else if (array_layers > 1) {
+        image_view_type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    }
+
+    if (!Create2DImage(vk_image, pic.cubemap_ ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0,
+        format, VK_IMAGE_TILING_OPTIMAL, image_usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        (uint32_t)pic.width_, (uint32_t)pic.height_, array_layers,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, image_view_type,
+        sampler, image_layout, mip_levels))
+    {
+        DestroyImage(vk_image);
+        FreeDecoded();
+        return false;
+    }
 
-        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_load_tex);
-        DestroyBuffer(vk_buf);
-        Img_Free(pic);
+    byte_t* dst = (byte_t*)uploader_->UploadImage(vk_image, array_layers, buf_sz,
+        copies.data(), (uint32_t)copies.size(), false);
+    if (!dst) {
+        DestroyImage(vk_image);
+        FreeDecoded();
+        printf("Could not stage the texels\n");
+        return false;
+    }
 
-        return true;
+    if (decode) {
+        for (size_t i = 0; i < copies.size(); ++i) {
+            memcpy(dst + copies[i].bufferOffset, decoded[i].pixels_,
+                (size_t)decoded[i].width_ * decoded[i].height_ * decoded_texel_bytes);
+        }
     }
     else {
-        DestroyBuffer(vk_buf);
-        Img_Free(pic);
-        return false;
+        memcpy(dst, pic.pixels_, buf_sz);
     }
+
+    FreeDecoded();
+
+    uploads_pending_ = true;
+
+    return true;
 }
 
 void VkDemo::DestroyFramebuffer(VkFramebuffer& vk_framebuffer) {
@@ -1190,6 +1354,11 @@ void VkDemo::AddAdditionalDeviceExtensions(std::vector<const char*>& extensions)
 }
 
 void VkDemo::SubmitCommandBufferAndWait(VkCommandBuffer command_buffer) {
+    // command_buffer may read what is still queued
+    if (uploads_pending_) {
+        FlushUploads();
+    }
+
     VkFence temp_fence = VK_NULL_HANDLE;
 
     VkFenceCreateInfo fence_create_info = {};
@@ -1231,6 +1400,16 @@ void VkDemo::SubmitCommandBufferAndWait(VkCommandBuffer command_buffer) {
     vkDestroyFence(vk_device_, temp_fence, nullptr);
 }
 
+void VkDemo::WaitFramesInFlight() {
+    if (!vk_device_) {
+        return;
+    }
+
+    for (int i = 0; i < vk_wait_fence_count_; ++i) {
+        WaitFrameSlot((uint32_t)i);
+    }
+}
+
 // helper
 uint32_t VkDemo::GetMemoryTypeIndex(uint32_t memory_type_bits, 
     VkMemoryPropertyFlags required_memory_properties) const
@@ -1255,7 +1434,7 @@ bool VkDemo::LoadShader(const char* filename, VkShaderModule& shader_module) con
     shader_module = VK_NULL_HANDLE;
 
     char fullfilename[1024];
-    sprintf_s(fullfilename, "%s/%s", shaders_dir_, filename);
+    Str_SPrintf(fullfilename, sizeof(fullfilename), "%s/%s", shaders_dir_, filename);
 
     void* code = nullptr;
     int32_t code_len = 0;
@@ -1830,6 +2009,7 @@ bool VkDemo::CreateDemoWindow() {
 
     return hWnd != NULL;
 #else
+    printf("No window on this platform yet, run with -headless\n");
     return false;   // TODO: other platform
 #endif
 }
@@ -1996,6 +2176,8 @@ LRESULT VkDemo::DemoWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         case VK_F12:
         case VK_PRIOR:
         case VK_NEXT:
+            // the demos change pipelines, buffers and command buffers here
+            WaitFramesInFlight();
             FuncKeyDown(wParam);
             InvalidateRect(hWnd, nullptr, FALSE);
             break;
@@ -2073,11 +2255,15 @@ bool VkDemo::CreateVkInstance() {
     enabled_layernames.push_back("VK_LAYER_KHRONOS_validation");    // VK_API_VERSION_1_1
 #endif
 
-    std::vector<const char*> instance_extensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+    std::vector<const char*> instance_extensions;
 
+    // headless: no surface, runs where no display is available
+    if (!cfg_headless_) {
+        instance_extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-    instance_extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+        instance_extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
+    }
 
 #if defined(_DEBUG)
     instance_extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
@@ -2126,6 +2312,7 @@ bool VkDemo::CreateVkInstance() {
         return true;
     }
     else {
+        printf("vkCreateInstance failed: %d\n", (int)rt);
         return false;
     }
 }
@@ -2223,6 +2410,27 @@ bool VkDemo::SelectPhysicalDevice() {
         if (support_graphics) {
             vk_physical_device_ = physical_device;
 
+            // a family that can transfer but not draw is a copy engine, the uploads run there alongside the frames;
+            // one that can also compute only if there is nothing else. the copies are always of whole subresources,
+            // whatever its minImageTransferGranularity
+            vk_physical_device_transfer_queue_family_index_ = VK_INVALID_INDEX;
+
+            for (uint32_t j = 0; j < queue_family_property_count; ++j) {
+                VkQueueFlags flags = queue_family_properties[j].queueFlags;
+                if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                    continue;
+                }
+
+                if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+                    vk_physical_device_transfer_queue_family_index_ = j;
+                    break;
+                }
+
+                if (vk_physical_device_transfer_queue_family_index_ == VK_INVALID_INDEX) {
+                    vk_physical_device_transfer_queue_family_index_ = j;
+                }
+            }
+
             vkGetPhysicalDeviceFeatures(physical_device, &vk_physical_device_features_);
 
             vkGetPhysicalDeviceMemoryProperties(physical_device, &vk_physical_device_memory_properties_);
@@ -2238,6 +2446,12 @@ bool VkDemo::SelectPhysicalDevice() {
             vkGetPhysicalDeviceProperties2(physical_device, &vk_physical_device_properties2_);
 
             printf("DeviceName = \"%s\"\n", vk_physical_device_properties2_.properties.deviceName);
+            if (vk_physical_device_transfer_queue_family_index_ != VK_INVALID_INDEX) {
+                printf("transfer queue family = %u\n", vk_physical_device_transfer_queue_family_index_);
+            }
+            else {
+                printf("transfer queue family = none, uploads go to the graphics queue\n");
+            }
             printf("nonCoherentAtomSize = %llu\n", vk_physical_device_properties2_.properties.limits.nonCoherentAtomSize);
             printf("minUniformBufferOffsetAlignment = %llu\n", vk_physical_device_properties2_.properties.limits.minUniformBufferOffsetAlignment);
             printf("maxTaskWorkGroupCount = [%u,%u,%u]\n", 
@@ -2260,17 +2474,18 @@ bool VkDemo::SelectPhysicalDevice() {
 
 // logic device
 bool VkDemo::CreateDevice() {
-    VkDeviceQueueCreateInfo device_queue_create_info = {};
-
     // The priority of each queue is a normalized floating-point value tetween 0.0 and 1.0,
     // which is then tranlated to a decreate priority level by the implementation.
     // Higher value indicate a higher priority,
     // with 0.0 being the lowest priority and 1.0 being the highest.
 
-    float queue_priorities[1];  // only queue in here
+    float queue_priorities[1];  // one queue per family
 
     queue_priorities[0] = 0.0f; // lowest
 
+    VkDeviceQueueCreateInfo device_queue_create_infos[2] = {};
+    VkDeviceQueueCreateInfo& device_queue_create_info = device_queue_create_infos[0];
+
     device_queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     device_queue_create_info.pNext = nullptr;
     // vkGetDeviceQueue must only be used to get queues that were crated with flags 
@@ -2283,21 +2498,31 @@ bool VkDemo::CreateDevice() {
     device_queue_create_info.queueCount = 1;
     device_queue_create_info.pQueuePriorities = queue_priorities;
 
+    // the uploader's, same priority
+    uint32_t queue_create_info_count = 1;
+    if (vk_physical_device_transfer_queue_family_index_ != VK_INVALID_INDEX) {
+        device_queue_create_infos[1] = device_queue_create_info;
+        device_queue_create_infos[1].queueFamilyIndex = vk_physical_device_transfer_queue_family_index_;
+        queue_create_info_count = 2;
+    }
+
 
     VkDeviceCreateInfo device_create_info = {};
 
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     device_create_info.pNext = vk_device_create_next_chain_;
     device_create_info.flags = 0;
-    device_create_info.queueCreateInfoCount = 1;
-    device_create_info.pQueueCreateInfos = &device_queue_create_info;
+    device_create_info.queueCreateInfoCount = queue_create_info_count;
+    device_create_info.pQueueCreateInfos = device_queue_create_infos;
     // enabledLayerCount is deprecated and should not be used
     device_create_info.enabledLayerCount = 0;
     // ppEnabledLayerNames is deprecated and should not be used
     device_create_info.ppEnabledLayerNames = nullptr;
 
     std::vector<const char*> device_extensions;
-    device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (!cfg_headless_) {
+        device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     // VK_KHR_Maintenance1
     device_extensions.push_back(VK_KHR_MAINTENANCE_1_EXTENSION_NAME);
@@ -2317,6 +2542,9 @@ bool VkDemo::CreateDevice() {
 
     if (rt == VK_SUCCESS) {
         vkGetDeviceQueue(vk_device_, vk_physical_device_graphics_queue_family_index_, 0, &vk_graphics_queue_);
+        if (vk_physical_device_transfer_queue_family_index_ != VK_INVALID_INDEX) {
+            vkGetDeviceQueue(vk_device_, vk_physical_device_transfer_queue_family_index_, 0, &vk_transfer_queue_);
+        }
         return true;
     }
     else {
@@ -2326,6 +2554,7 @@ bool VkDemo::CreateDevice() {
 
 void VkDemo::DestroyDevice() {
     vk_graphics_queue_ = VK_NULL_HANDLE;
+    vk_transfer_queue_ = VK_NULL_HANDLE;
 
     if (vk_device_) {
         vkDestroyDevice(vk_device_, nullptr);
@@ -2346,7 +2575,20 @@ bool VkDemo::CreateDemoSemaphores() {
         return VK_SUCCESS == vkCreateSemaphore(vk_device_, &semaphore_create_info, nullptr, &sem);
     };
 
-    return CreateSamaphore(vk_semaphore_present_complete_) && CreateSamaphore(vk_semaphore_render_complete_);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (!CreateSamaphore(vk_semaphore_present_complete_[i])) {
+            return false;
+        }
+    }
+
+    // the image count is not known yet
+    for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+        if (!CreateSamaphore(vk_semaphore_render_complete_[i])) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 void VkDemo::DestroyDemoSemaphores() {
@@ -2359,8 +2601,13 @@ void VkDemo::DestroyDemoSemaphores() {
         
     };
 
-    DestroySamaphore(vk_semaphore_render_complete_);
-    DestroySamaphore(vk_semaphore_present_complete_);
+    for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+        DestroySamaphore(vk_semaphore_render_complete_[i]);
+    }
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        DestroySamaphore(vk_semaphore_present_complete_[i]);
+    }
 }
 
 // surface
@@ -2682,26 +2929,333 @@ bool VkDemo::CreateSwapChain(bool vsync) {
 }
 
 void VkDemo::DestroySwapChain() {
-    if (vk_swapchain_) {
+    for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+        swapchain_image_s& image = vk_swapchain_images_[i];
 
-        for (int i = 0; i < vk_swapchain_image_count_; ++i) {
-            if (vk_swapchain_images_[i].image_view_) {
-                vkDestroyImageView(vk_device_, vk_swapchain_images_[i].image_view_, nullptr);
-                vk_swapchain_images_[i].image_view_ = VK_NULL_HANDLE;
-            }
+        if (image.image_view_) {
+            vkDestroyImageView(vk_device_, image.image_view_, nullptr);
+            image.image_view_ = VK_NULL_HANDLE;
+        }
+
+        // without a swapchain these are the offscreen images of the headless mode, owned by the demo
+        if (!vk_swapchain_ && image.image_) {
+            vkDestroyImage(vk_device_, image.image_, nullptr);
+        }
+
+        if (image.allocation_.memory_) {
+            allocator_->Free(image.allocation_);
         }
-        vk_swapchain_image_count_ = 0;
 
+        image.image_ = VK_NULL_HANDLE;
+    }
+    vk_swapchain_image_count_ = 0;
+
+    // a new swapchain starts with no frame on its images
+    memset(vk_image_fences_, 0, sizeof(vk_image_fences_));
+
+    if (vk_swapchain_) {
         vkDestroySwapchainKHR(vk_device_, vk_swapchain_, nullptr);
         vk_swapchain_ = VK_NULL_HANDLE;
     }
 }
 
+/*
+================================================================================
+headless
+================================================================================
+*/
+static const float  HEADLESS_PITCH_AMPLITUDE = 10.0f;   // degrees, one period over the run
+
+bool VkDemo::CreateOffscreenImages() {
+    vk_swapchain_color_format_ = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // one per frame in flight, an image is only drawn again once its frame is done
+    for (int i = 0; i < vk_wait_fence_count_; ++i) {
+        swapchain_image_s& offscreen = vk_swapchain_images_[i];
+        memset(&offscreen, 0, sizeof(offscreen));
+
+        // DestroySwapChain releases whatever got created
+        vk_swapchain_image_count_ = i + 1;
+
+        VkImageCreateInfo image_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = vk_swapchain_color_format_,
+            .extent = { cfg_viewport_cx_, cfg_viewport_cy_, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+
+        if (VK_SUCCESS != vkCreateImage(vk_device_, &image_create_info, nullptr, &offscreen.image_)) {
+            return false;
+        }
+
+        VkMemoryRequirements image_memory_requirements = {};
+        vkGetImageMemoryRequirements(vk_device_, offscreen.image_, &image_memory_requirements);
+
+        uint32_t memory_type_index = GetMemoryTypeIndex(image_memory_requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (memory_type_index == (uint32_t)-1) {
+            return false;
+        }
+
+        if (!allocator_->Alloc(image_memory_requirements, memory_type_index, VkMemoryAllocator::usage_t::IMAGE, offscreen.allocation_)) {
+            return false;
+        }
+
+        if (VK_SUCCESS != vkBindImageMemory(vk_device_, offscreen.image_, offscreen.allocation_.memory_, offscreen.allocation_.offset_)) {
+            return false;
+        }
+
+        VkImageViewCreateInfo image_view_create_info = {};
+
+        image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_create_info.pNext = nullptr;
+        image_view_create_info.flags = 0;
+        image_view_create_info.image = offscreen.image_;
+        image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_create_info.format = vk_swapchain_color_format_;
+        image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        image_view_create_info.subresourceRange.baseMipLevel = 0;
+        image_view_create_info.subresourceRange.levelCount = 1;
+        image_view_create_info.subresourceRange.baseArrayLayer = 0;
+        image_view_create_info.subresourceRange.layerCount = 1;
+
+        if (VK_SUCCESS != vkCreateImageView(vk_device_, &image_view_create_info, nullptr, &offscreen.image_view_)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool VkDemo::CaptureFrame(uint32_t image_idx, const char* filename) {
+    uint32_t width = cfg_viewport_cx_;
+    uint32_t height = cfg_viewport_cy_;
+    VkDeviceSize size = (VkDeviceSize)width * height * 4;
+
+    vk_buffer_s readback = {};
+    if (!CreateBuffer(readback, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size)) {
+        DestroyBuffer(readback);
+        return false;
+    }
+
+    VkCommandPool command_pool = vk_command_pool_transient_;
+
+    VkCommandBuffer cmd_buffer_readback = VK_NULL_HANDLE;
+
+    VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
+
+    cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_buffer_alloc_info.pNext = nullptr;
+    cmd_buffer_alloc_info.commandPool = command_pool;
+    cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_buffer_alloc_info.commandBufferCount = 1;
+
+    if (VK_SUCCESS != vkAllocateCommandBuffers(vk_device_, &cmd_buffer_alloc_info, &cmd_buffer_readback)) {
+        DestroyBuffer(readback);
+        return false;
+    }
+
+    VkCommandBufferBeginInfo cmdbuf_begin_info = {};
+
+    cmdbuf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdbuf_begin_info.pNext = nullptr;
+    cmdbuf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdbuf_begin_info.pInheritanceInfo = nullptr;
+
+    if (VK_SUCCESS != vkBeginCommandBuffer(cmd_buffer_readback, &cmdbuf_begin_info)) {
+        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_readback);
+        DestroyBuffer(readback);
+        return false;
+    }
+
+    // the render pass left the image in TRANSFER_SRC_OPTIMAL, its writes still have to reach the copy
+    VkImageMemoryBarrier image_barrier = {};
+
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = vk_swapchain_images_[image_idx].image_;
+    image_barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(cmd_buffer_readback, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &image_barrier);
+
+    VkBufferImageCopy region = {};
+
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;     // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { width, height, 1 };
+
+    vkCmdCopyImageToBuffer(cmd_buffer_readback, vk_swapchain_images_[image_idx].image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        readback.buffer_, 1, &region);
+
+    VkBufferMemoryBarrier buffer_barrier = {};
+
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = readback.buffer_;
+    buffer_barrier.offset = 0;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(cmd_buffer_readback, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
+
+    if (VK_SUCCESS != vkEndCommandBuffer(cmd_buffer_readback)) {
+        vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_readback);
+        DestroyBuffer(readback);
+        return false;
+    }
+
+    SubmitCommandBufferAndWait(cmd_buffer_readback);
+
+    vkFreeCommandBuffers(vk_device_, command_pool, 1, &cmd_buffer_readback);
+
+    const byte_t* texels = (const byte_t*)MapBuffer(readback);
+    bool ok = texels != nullptr;
+
+    if (ok) {
+        image_s pic = {};
+        ok = Img_Create((int)width, (int)height, image_format_t::R8G8B8A8, pic);
+
+        if (ok) {
+            // image_s keeps the bottom row first, alpha opaque as the window shows it
+            for (uint32_t y = 0; y < height; ++y) {
+                const byte_t* src = texels + (size_t)(height - 1 - y) * width * 4;
+                byte_t* dst = pic.pixels_ + (size_t)y * width * 4;
+
+                memcpy(dst, src, (size_t)width * 4);
+                for (uint32_t x = 0; x < width; ++x) {
+                    dst[x * 4 + 3] = 255;
+                }
+            }
+
+            ok = Img_Save(filename, pic);
+            Img_Free(pic);
+        }
+
+        UnmapBuffer(readback);
+    }
+
+    DestroyBuffer(readback);
+
+    if (ok) {
+        printf("Saved %s\n", filename);
+    }
+
+    return ok;
+}
+
+void VkDemo::HeadlessLoop() {
+    if (!enable_display_) {
+        return;
+    }
+
+    printf("Headless: %u frames of %ux%u on \"%s\"\n", cfg_headless_frames_, cfg_viewport_cx_, cfg_viewport_cy_,
+        vk_physical_device_properties2_.properties.deviceName);
+
+    std::vector<double> frame_ms(cfg_headless_frames_);
+
+    memset(&frame_timing_, 0, sizeof(frame_timing_));
+
+    auto t_begin = std::chrono::steady_clock::now();
+
+    for (headless_frame_ = 0; headless_frame_ < cfg_headless_frames_; ++headless_frame_) {
+        // camera script: a function of the frame number only, every run sees the same views
+        float phase = glm::radians(360.0f) / cfg_headless_frames_;
+        float pitch = HEADLESS_PITCH_AMPLITUDE * sinf(phase * headless_frame_);
+        float prev_pitch = HEADLESS_PITCH_AMPLITUDE * sinf(phase * ((float)headless_frame_ - 1.0f));
+
+        // CursorRotate takes mouse deltas at half a degree each
+        CursorRotate(2.0f * cfg_headless_yaw_per_frame_, headless_frame_ ? 2.0f * (pitch - prev_pitch) : 0.0f);
+
+        // Display returns once the frame is submitted, it only blocks on the frames cfg_frames_in_flight_ back:
+        // in the steady state the time per frame is the larger of the CPU and the GPU time, not their sum
+        auto t0 = std::chrono::steady_clock::now();
+        Display();
+        auto t1 = std::chrono::steady_clock::now();
+
+        frame_ms[headless_frame_] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        if (cfg_headless_capture_interval_ && (headless_frame_ + 1) % cfg_headless_capture_interval_ == 0) {
+            char filename[MAX_PATH];
+            Str_SPrintf(filename, MAX_PATH, "%s_%05u.png", demo_name_, headless_frame_);
+            CaptureFrame(vk_current_image_, filename);
+        }
+    }
+
+    // the last frames still count
+    auto t_drain = std::chrono::steady_clock::now();
+    WaitFramesInFlight();
+    frame_timing_.cpu_wait_ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_drain).count();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_begin).count();
+
+    double sum_ms = 0.0;
+    for (double ms : frame_ms) {
+        sum_ms += ms;
+    }
+
+    std::sort(frame_ms.begin(), frame_ms.end());
+
+    printf("Headless: %u frames in %.2f s, ms/frame avg %.3f, min %.3f, median %.3f, p95 %.3f, max %.3f, %.1f fps\n",
+        cfg_headless_frames_, seconds, sum_ms / cfg_headless_frames_, frame_ms.front(),
+        frame_ms[frame_ms.size() / 2], frame_ms[frame_ms.size() * 95 / 100], frame_ms.back(),
+        cfg_headless_frames_ / (sum_ms * 1.0e-3));
+
+    // GPU bound: the CPU waits for the fences most of a frame, CPU bound: GPU busy stays below ms/frame
+    printf("Headless: %d frames in flight, CPU wait avg %.3f ms/frame",
+        vk_wait_fence_count_, frame_timing_.cpu_wait_ms_ / cfg_headless_frames_);
+    if (frame_timing_.gpu_frames_) {
+        printf(", GPU busy avg %.3f ms/frame", frame_timing_.gpu_ms_ / frame_timing_.gpu_frames_);
+    }
+    printf("\n");
+
+    vk_memory_stats_s memory_stats;
+    allocator_->GetStats(memory_stats);
+    printf("Headless: device memory %u blocks (%u dedicated) for %u allocations, %.1f of %.1f MB used, fragmentation %.2f\n",
+        memory_stats.block_count_, memory_stats.dedicated_block_count_, memory_stats.allocation_count_,
+        memory_stats.used_bytes_ / (1024.0 * 1024.0), memory_stats.block_bytes_ / (1024.0 * 1024.0), memory_stats.fragmentation_);
+
+    // the initial upload of a demo is a single submission
+    const vk_upload_stats_s& upload_stats = uploader_->GetStats();
+    printf("Headless: uploads %u submissions on the %s queue, %u buffers and %u images, %.1f MB staged, %u ring stalls\n",
+        upload_stats.submits_, uploader_->HasTransferQueue() ? "transfer" : "graphics",
+        upload_stats.buffer_copies_, upload_stats.image_copies_,
+        upload_stats.staged_bytes_ / (1024.0 * 1024.0), upload_stats.ring_stalls_);
+}
+
 // fences used in thie demo
 bool VkDemo::CreateDemoFences() {
     vk_wait_fence_count_ = 0;
+    vk_frame_idx_ = 0;
 
-    for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+    // a demo with one copy of its uniforms can't let the next Update overwrite them during a frame
+    uint32_t frames_in_flight = cfg_frame_uniform_copies_ ? cfg_frames_in_flight_ : 1;
+
+    for (uint32_t i = 0; i < frames_in_flight; ++i) {
         VkFenceCreateInfo create_info = {};
 
         create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -2726,6 +3280,115 @@ void VkDemo::DestroyDemoFences() {
         }
     }
     vk_wait_fence_count_ = 0;
+
+    memset(vk_image_fences_, 0, sizeof(vk_image_fences_));
+}
+
+bool VkDemo::WaitFrameSlot(uint32_t slot) {
+    VkFence fence = vk_wait_fences_[slot];
+
+    if (!fence) {
+        return false;
+    }
+
+    if (VK_SUCCESS != vkWaitForFences(vk_device_, 1, &fence, VK_TRUE /* waitAll */, UINT64_MAX /* never timeout */)) {
+        printf("vkWaitForFences error\n");
+        return false;
+    }
+
+    if (frame_timed_[slot]) {
+        frame_timed_[slot] = false;
+
+        uint64_t timestamps[2] = {};
+        if (VK_SUCCESS == vkGetQueryPoolResults(vk_device_, vk_timestamp_query_pool_, slot * 2, 2,
+            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT)) {
+            double ns = (double)(timestamps[1] - timestamps[0]) * vk_physical_device_properties2_.properties.limits.timestampPeriod;
+
+            frame_timing_.gpu_ms_ += ns * 1.0e-6;
+            frame_timing_.gpu_frames_++;
+        }
+    }
+
+    return true;
+}
+
+// timestamps
+bool VkDemo::CreateFrameTimestamps() {
+    if (!vk_physical_device_properties2_.properties.limits.timestampComputeAndGraphics) {
+        printf("No timestamps on the graphics queue, GPU time not measured\n");
+        return true;
+    }
+
+    VkQueryPoolCreateInfo query_pool_create_info = {};
+
+    query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.pNext = nullptr;
+    query_pool_create_info.flags = 0;
+    query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount = MAX_FRAMES_IN_FLIGHT * 2;  // begin, end
+    query_pool_create_info.pipelineStatistics = 0;
+
+    if (VK_SUCCESS != vkCreateQueryPool(vk_device_, &query_pool_create_info, nullptr, &vk_timestamp_query_pool_)) {
+        return false;
+    }
+
+    VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
+
+    cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_buffer_alloc_info.pNext = nullptr;
+    cmd_buffer_alloc_info.commandPool = vk_command_pool_;
+    cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_buffer_alloc_info.commandBufferCount = 2;
+
+    // recorded once, submitted again whenever the slot comes around
+    for (int i = 0; i < vk_wait_fence_count_; ++i) {
+        if (VK_SUCCESS != vkAllocateCommandBuffers(vk_device_, &cmd_buffer_alloc_info, vk_timestamp_cmd_buffers_[i])) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < 2; ++j) {
+            VkCommandBuffer cmd_buf = vk_timestamp_cmd_buffers_[i][j];
+            uint32_t query = (uint32_t)i * 2 + j;
+
+            VkCommandBufferBeginInfo cmd_buf_begin_info = {};
+
+            cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            cmd_buf_begin_info.pNext = nullptr;
+            cmd_buf_begin_info.flags = 0;
+            cmd_buf_begin_info.pInheritanceInfo = nullptr;
+
+            vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info);
+
+            if (j == 0) {
+                vkCmdResetQueryPool(cmd_buf, vk_timestamp_query_pool_, query, 2);
+                vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, vk_timestamp_query_pool_, query);
+            }
+            else {
+                vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk_timestamp_query_pool_, query);
+            }
+
+            if (VK_SUCCESS != vkEndCommandBuffer(cmd_buf)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void VkDemo::DestroyFrameTimestamps() {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (vk_timestamp_cmd_buffers_[i][0]) {
+            vkFreeCommandBuffers(vk_device_, vk_command_pool_, 2, vk_timestamp_cmd_buffers_[i]);
+            vk_timestamp_cmd_buffers_[i][0] = vk_timestamp_cmd_buffers_[i][1] = VK_NULL_HANDLE;
+        }
+        frame_timed_[i] = false;
+    }
+
+    if (vk_timestamp_query_pool_) {
+        vkDestroyQueryPool(vk_device_, vk_timestamp_query_pool_, nullptr);
+        vk_timestamp_query_pool_ = VK_NULL_HANDLE;
+    }
 }
 
 // depth stencil
@@ -2774,19 +3437,13 @@ bool VkDemo::CreateDepthStencil() {
         return false;
     }
 
-    VkMemoryAllocateInfo mem_alloc_info = {};
-
-    mem_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_alloc_info.pNext = nullptr;
-    mem_alloc_info.allocationSize = image_memory_requirements.size;
-    mem_alloc_info.memoryTypeIndex = memory_type_index;
-
-    if (VK_SUCCESS != vkAllocateMemory(vk_device_, &mem_alloc_info, nullptr, &vk_depth_stencil_.memory_)) {
+    if (!allocator_->Alloc(image_memory_requirements, memory_type_index, VkMemoryAllocator::usage_t::IMAGE, vk_depth_stencil_.allocation_)) {
         return false;
     }
 
     // Bind device memory to an image object
-    if (VK_SUCCESS != vkBindImageMemory(vk_device_, vk_depth_stencil_.image_, vk_depth_stencil_.memory_, 0)) {
+    if (VK_SUCCESS != vkBindImageMemory(vk_device_, vk_depth_stencil_.image_,
+        vk_depth_stencil_.allocation_.memory_, vk_depth_stencil_.allocation_.offset_)) {
         return false;
     }
 
@@ -2819,15 +3476,14 @@ void VkDemo::DestroyDepthStencil() {
         vk_depth_stencil_.image_view_ = VK_NULL_HANDLE;
     }
 
-    if (vk_depth_stencil_.memory_) {
-        vkFreeMemory(vk_device_, vk_depth_stencil_.memory_, nullptr);
-        vk_depth_stencil_.memory_ = VK_NULL_HANDLE;
-    }
-
     if (vk_depth_stencil_.image_) {
         vkDestroyImage(vk_device_, vk_depth_stencil_.image_, nullptr);
         vk_depth_stencil_.image_ = VK_NULL_HANDLE;
     }
+
+    if (vk_depth_stencil_.allocation_.memory_) {
+        allocator_->Free(vk_depth_stencil_.allocation_);
+    }
 }
 
 // render pass
@@ -2880,8 +3536,8 @@ bool VkDemo::CreateRenderPass() {
     attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    // We want to present the color buffer to the swapchain
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // We want to present the color buffer to the swapchain, headless frames are read back instead
+    attachments[0].finalLayout = cfg_headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     // depth stencil
     attachments[1].flags = 0;
@@ -3058,7 +3714,8 @@ void VkDemo::DestroyPipelineCache() {
 
 // descriptor set pool
 bool VkDemo::CreateDescriptorPools(
-    uint32_t max_uniform_buffer, uint32_t max_storage_buffer, uint32_t max_texture, uint32_t max_desp_set)
+    uint32_t max_uniform_buffer, uint32_t max_dynamic_uniform_buffer, uint32_t max_storage_buffer,
+    uint32_t max_texture, uint32_t max_desp_set)
 {
     VkDescriptorPoolCreateInfo create_info = {};
 
@@ -3071,6 +3728,13 @@ bool VkDemo::CreateDescriptorPools(
             });
     }
 
+    if (max_dynamic_uniform_buffer) {
+        pool_size_array.push_back({
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = max_dynamic_uniform_buffer
+            });
+    }
+
     if (max_storage_buffer) {
         pool_size_array.push_back({
             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
@@ -3133,9 +3797,13 @@ void VkDemo::OnResize() {
         return;
     }
 
+    WaitFramesInFlight();
+
+    int image_count = vk_swapchain_image_count_;
+
     DestroyFramebuffers();
     DestroyDepthStencil();
-    DestroySwapChain();
+    DestroySwapChain();     // and the fences of the last frames on its images
     DestroySurface();
 
     if (!CreateSurface()) {
@@ -3154,6 +3822,20 @@ void VkDemo::OnResize() {
         return;
     }
 
+    // a command buffer, uniform copies and descriptor sets per image of the new swapchain
+    if (vk_swapchain_image_count_ != image_count) {
+        FreeCommandBuffers();
+
+        if (!AllocCommandBuffers()) {
+            return;
+        }
+
+        if (!SwapchainImageCountChanged()) {
+            printf("SwapchainImageCountChanged error\n");
+            return;
+        }
+    }
+
     // notify child class that window resized
     WindowSizeChanged();
 
@@ -4,12 +4,18 @@
 
 #pragma once
 
+class VkStreamer;
+class VkUploader;
+
 /*
 ================================================================================
 VkDemo
 ================================================================================
 */
 class COMMON_API VkDemo {
+    friend class VkStreamer;    // queues its uploads to the uploader
+    friend class VkUploader;    // records on the graphics and transfer queues
+    friend class VkUniformRing; // a copy per swapchain image, writes the one of vk_current_image_
 public:
 	VkDemo();
 	virtual ~VkDemo();
@@ -18,11 +24,17 @@ public:
                                 uint32_t max_uniform_buffer,
                                 uint32_t max_storage_buffer,
                                 uint32_t max_texture,
-                                uint32_t max_desp_set);
+                                uint32_t max_desp_set,
+                                uint32_t max_dynamic_uniform_buffer = 0);  // VkUniformRing
 	void					Shutdown();
+    // [-headless [frames]] [-capture n] [-size width height] [-orbit degrees] [-inflight n] [-memdump file], before Init
+    bool                    ParseCommandLine(int argc, char** argv);
     virtual void			Display();
     virtual void			BuildCommandBuffers() = 0;
     virtual void            WindowSizeChanged();
+    // the swapchain recreated by a resize has another image count: rebuild what the demo keeps per image,
+    // called before WindowSizeChanged, the command buffers are reallocated already
+    virtual bool            SwapchainImageCountChanged();
     virtual void            Update();
 
     void                    MainLoop();
@@ -35,8 +47,20 @@ public:
     size_t                  GetAlignedMinOffsetSize(size_t sz) const;
 
     bool                    LoadModel(const char * filename, bool move_to_origin, model_s & model, const glm::mat4* transform = nullptr) const;
+    // absolute, or relative to the textures folder
+    void                    GetTextureFilename(const char* filename, char* full_filename, int full_filename_cap) const;
+
+    // background loading of models and textures, see VkStreamer
+    VkStreamer *            GetStreamer() const;
+    // the device memory of CreateBuffer and Create2DImage
+    VkMemoryAllocator *     GetMemoryAllocator() const;
+    // the staged uploads of CreateBufferAddInitData and the textures, see VkUploader
+    VkUploader *            GetUploader() const;
+    // submits the queued uploads and waits for them, Display does it before the frame that may read them
+    void                    FlushUploads();
 
     // desc_buffer_info_count can be zero
+    // host visible buffers stay mapped: MapBuffer returns the mapping, UnmapBuffer flushes it
     bool                    CreateBuffer(vk_buffer_s& buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_prop_flags, VkDeviceSize req_size) const;
     void                    DestroyBuffer(vk_buffer_s& buffer) const;
     bool					UpdateBuffer(vk_buffer_s& buffer, const void* host_data, size_t host_data_size) const;
@@ -57,18 +81,35 @@ public:
                                 VkImageAspectFlags image_aspect_flags,
                                 VkImageViewType image_view_type,
                                 VkSampler sampler,
-                                VkImageLayout image_layout);
+                                VkImageLayout image_layout,
+                                uint32_t mip_levels = 1);
     void                    DestroyImage(vk_image_s& vk_image);
 
     bool					Load2DTexture(const char* filename, 
                                 VkFormat format, VkImageUsageFlags image_usage, 
                                 VkSampler sampler, VkImageLayout image_layout, vk_image_s & vk_image);
+    // level 0 is replaced by pic, the other levels are generated again
     bool                    Update2DTexture(const image_s & pic, vk_image_s& vk_image);
+    // staged upload of an R8G8B8A8 pic to an optimal tiling, device local image with a full mip chain,
+    // the levels are blitted on the GPU when the format supports linear blits, otherwise filtered on the CPU
+    // the upload is queued to the uploader; async: the caller waits for its ticket (VkStreamer),
+    // otherwise the next FlushUploads does
+    bool                    Create2DTexture(const image_s& pic, VkFormat format, VkImageUsageFlags image_usage,
+                                VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image,
+                                bool async = false);
 
     bool                    LoadCubeMaps(const char* filename,
                                 VkFormat format, VkImageUsageFlags image_usage,
                                 VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image);
 
+    // block compressed DDS files keep their blocks, mip levels and layers (cube maps too), decoded on the CPU
+    // only when the device can't sample the BC format; other files are uploaded as R8G8B8A8_UNORM
+    bool                    LoadCompressedTexture(const char* filename, VkImageUsageFlags image_usage,
+                                VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image);
+    // staged upload of every subresource of pic to an optimal tiling image
+    bool                    UploadImage(const image_s& pic, VkImageUsageFlags image_usage,
+                                VkSampler sampler, VkImageLayout image_layout, vk_image_s& vk_image);
+
     void                    DestroyFramebuffer(VkFramebuffer & vk_framebuffer);
     void                    DestroyRenderPass(VkRenderPass & vk_render_pass);
 
@@ -91,6 +132,25 @@ protected:
     // configuration
     uint32_t                cfg_viewport_cx_;
     uint32_t                cfg_viewport_cy_;
+    bool                    cfg_decode_compressed_textures_;    // always take the CPU fallback of UploadImage
+    bool                    cfg_cpu_mipmaps_;                   // always filter the levels of Create2DTexture on the CPU
+
+    // headless: no window, surface or swapchain, the frames go to offscreen images,
+    // MainLoop renders cfg_headless_frames_ along a fixed camera script and reports the frame times
+    bool                    cfg_headless_;
+    uint32_t                cfg_headless_frames_;
+    uint32_t                cfg_headless_capture_interval_;     // 0: no readback, n: every n-th frame to <demo>_<frame>.png
+    float                   cfg_headless_yaw_per_frame_;        // camera script, degrees
+
+    // frames in flight: Display only waits for the frame that used the same slot cfg_frames_in_flight_ frames ago,
+    // Update of the next frame runs while the GPU still draws the previous ones
+    static constexpr int    MAX_FRAMES_IN_FLIGHT = 3;
+    uint32_t                cfg_frames_in_flight_;              // 1 ~ MAX_FRAMES_IN_FLIGHT
+    bool                    cfg_frame_uniform_copies_;          // the demo keeps its per frame uniforms per swapchain image,
+                                                                // Update writes the copies of vk_current_image_;
+                                                                // false: one copy, a frame waits for the previous one
+
+    char                    cfg_memory_dump_[MAX_PATH];         // JSON of the device memory blocks at the end of MainLoop, empty: none
 
 #if defined(_WIN32)
     const TCHAR *           cfg_demo_win_class_name_;
@@ -126,6 +186,7 @@ protected:
 	VkPhysicalDeviceFeatures			vk_physical_device_features_;
     // VkPhysicalDeviceFeatures2           vk_physical_device_features2_;
     uint32_t                            vk_physical_device_graphics_queue_family_index_;
+    uint32_t                            vk_physical_device_transfer_queue_family_index_;   // VK_INVALID_INDEX: none without graphics
 
     VkFormat                vk_depth_format_;
 
@@ -133,11 +194,11 @@ protected:
     void *                  vk_device_create_next_chain_;   // fill next pointer
     VkDevice                vk_device_;
     VkQueue                 vk_graphics_queue_; // graphics queue
+    VkQueue                 vk_transfer_queue_; // dedicated transfer queue of the uploader, VK_NULL_HANDLE: none
     
 
     // Semaphore:  GPU, GPU syncronization
-    VkSemaphore             vk_semaphore_present_complete_; // swap chain image presentation
-    VkSemaphore             vk_semaphore_render_complete_;  // command buffer sumission and execution
+    VkSemaphore             vk_semaphore_present_complete_[MAX_FRAMES_IN_FLIGHT];   // swap chain image presentation, per frame
 
     // surface
     VkSurfaceKHR            vk_surface_;
@@ -149,20 +210,28 @@ protected:
     struct swapchain_image_s {
         VkImage             image_;
         VkImageView         image_view_;
+        vk_allocation_s     allocation_;    // offscreen images of the headless mode only
     };
 
     static constexpr int    MAX_SWAPCHAIN_IMAGES = 16;
     swapchain_image_s       vk_swapchain_images_[MAX_SWAPCHAIN_IMAGES];
     int                     vk_swapchain_image_count_;
 
+    // command buffer sumission and execution, per image: the presentation may still wait on it
+    // when the fence of its frame is signaled
+    VkSemaphore             vk_semaphore_render_complete_[MAX_SWAPCHAIN_IMAGES];
+
     // fence: CPU, GPU syncronization
-    VkFence                 vk_wait_fences_[MAX_SWAPCHAIN_IMAGES];
-    int                     vk_wait_fence_count_;
+    VkFence                 vk_wait_fences_[MAX_FRAMES_IN_FLIGHT];  // per frame
+    int                     vk_wait_fence_count_;                   // frames in flight
+    VkFence                 vk_image_fences_[MAX_SWAPCHAIN_IMAGES]; // fence of the last frame drawn to each image, not owned
+    uint32_t                vk_frame_idx_;                          // counts the frames, slot: % vk_wait_fence_count_
+    uint32_t                vk_current_image_;                      // the image Display draws to, valid in Update
 
     // depth stencil
 
     struct depth_stencil_s {
-        VkDeviceMemory      memory_;
+        vk_allocation_s     allocation_;
         VkImage             image_;
         VkImageView         image_view_;
     };
@@ -191,10 +260,17 @@ protected:
 
     bool                    enable_display_;
 
+    VkStreamer *            streamer_;
+    VkMemoryAllocator *     allocator_;
+    VkUploader *            uploader_;
+    bool                    uploads_pending_;   // queued by the demo, FlushUploads waits for them
+
     virtual void            AddAdditionalInstanceExtensions(std::vector<const char*> & extensions) const;
     virtual void            AddAdditionalDeviceExtensions(std::vector<const char*>& extensions) const;
 
     void                    SubmitCommandBufferAndWait(VkCommandBuffer command_buffer);
+    // before the command buffers, pipelines or descriptor sets of the frames in flight change
+    void                    WaitFramesInFlight();
 
     // helper
     uint32_t                GetMemoryTypeIndex(uint32_t memory_type_bits, 
@@ -281,8 +357,27 @@ private:
     int                     cursor_y_;
     float                   mouse_sensitive_;
 
+    char                    demo_name_[MAX_PATH];   // the shader directory, prefix of the captures
+    uint32_t                headless_frame_;
+
+    // GPU time of a frame: timestamps written by two command buffers submitted around the draw command buffer
+    VkQueryPool             vk_timestamp_query_pool_;   // VK_NULL_HANDLE: not supported
+    VkCommandBuffer         vk_timestamp_cmd_buffers_[MAX_FRAMES_IN_FLIGHT][2];
+    bool                    frame_timed_[MAX_FRAMES_IN_FLIGHT];     // the timestamps of the slot are not read yet
+
+    struct frame_timing_s {
+        double              cpu_wait_ms_;   // Display blocked on the fences of earlier frames
+        double              gpu_ms_;        // executing the draw command buffers
+        uint32_t            gpu_frames_;    // frames with timestamps
+    } frame_timing_;
+
     bool                    CreateDemoWindow();
 
+    // textures
+    // queues pic to a texture of Create2DTexture: level 0, the other levels blitted on the GPU when the format
+    // allows linear blits, otherwise filtered on the CPU
+    bool                    QueueTextureUpload(const image_s& pic, vk_image_s& vk_image);
+
 #if defined(_WIN32)
     LRESULT                 DemoWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
     static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -319,9 +414,19 @@ private:
     bool                    CreateSwapChain(bool vsync);
     void                    DestroySwapChain();
 
+    // headless
+    bool                    CreateOffscreenImages();
+    bool                    CaptureFrame(uint32_t image_idx, const char* filename);
+    void                    HeadlessLoop();
+
     // fences used in thie demo
     bool                    CreateDemoFences();
     void                    DestroyDemoFences();
+    bool                    WaitFrameSlot(uint32_t slot);
+
+    // timestamps
+    bool                    CreateFrameTimestamps();
+    void                    DestroyFrameTimestamps();
 
     // depth stencil
     bool                    CreateDepthStencil();
@@ -349,6 +454,7 @@ private:
     // descriptor set pool
     bool					CreateDescriptorPools(
                                 uint32_t max_uniform_buffer,
+                                uint32_t max_dynamic_uniform_buffer,
                                 uint32_t max_storage_buffer,
                                 uint32_t max_texture,
                                 uint32_t max_desp_set);
@@ -0,0 +1,814 @@
+/******************************************************************************
+ device memory
+ *****************************************************************************/
+
+#include "inc.h"
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+/*
+================================================================================
+two level segregated fit
+================================================================================
+*/
+static const uint32_t	TLSF_ALIGN_LOG2 = 4;		// sizes and offsets in multiples of 16
+static const uint32_t	TLSF_SL_LOG2 = 4;			// 16 lists per power of two
+static const uint32_t	TLSF_SL_COUNT = 1 << TLSF_SL_LOG2;
+static const uint32_t	TLSF_FL_SHIFT = TLSF_SL_LOG2 + TLSF_ALIGN_LOG2;	// sizes below 256 bytes share first level 0
+static const uint32_t	TLSF_FL_COUNT = 64 - TLSF_FL_SHIFT + 1;
+
+enum class tlsf_state_t : uint8_t {
+	UNUSED,		// record on the spare list
+	FREE,
+	USED
+};
+
+struct tlsf_range_s {
+	uint64_t				offset_;
+	uint64_t				size_;
+	uint32_t				prev_phys_;		// neighbours in address order
+	uint32_t				next_phys_;
+	uint32_t				prev_free_;		// list of the size class, next_free_ links the spare records too
+	uint32_t				next_free_;
+	tlsf_state_t			state_;
+};
+
+struct mem_tlsf_s {
+	uint64_t				size_;
+	uint64_t				used_bytes_;
+	uint32_t				allocation_count_;
+	uint64_t				fl_bitmap_;
+	uint32_t				sl_bitmap_[TLSF_FL_COUNT];
+	uint32_t				heads_[TLSF_FL_COUNT][TLSF_SL_COUNT];
+	std::vector<tlsf_range_s>	ranges_;
+	uint32_t				spare_;
+};
+
+static uint32_t Tlsf_Msb(uint64_t v) {
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanReverse64(&idx, v);
+	return (uint32_t)idx;
+#else
+	return 63 - (uint32_t)__builtin_clzll(v);
+#endif
+}
+
+static uint32_t Tlsf_Lsb(uint64_t v) {
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return (uint32_t)idx;
+#else
+	return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+static void Tlsf_Mapping(uint64_t size, uint32_t & fl, uint32_t & sl) {
+	if (size < (1ull << TLSF_FL_SHIFT)) {
+		fl = 0;
+		sl = (uint32_t)(size >> TLSF_ALIGN_LOG2);
+	}
+	else {
+		uint32_t msb = Tlsf_Msb(size);
+		fl = msb - TLSF_FL_SHIFT + 1;
+		sl = (uint32_t)(size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+	}
+}
+
+// the first free range of the lists of size or above, rounded up to the next class: any range found fits size
+static uint32_t Tlsf_FindFree(const mem_tlsf_s * tlsf, uint64_t size) {
+	if (size >= (1ull << TLSF_FL_SHIFT)) {
+		size += (1ull << (Tlsf_Msb(size) - TLSF_SL_LOG2)) - 1;
+	}
+
+	uint32_t fl, sl;
+	Tlsf_Mapping(size, fl, sl);
+	if (fl >= TLSF_FL_COUNT) {
+		return VK_INVALID_INDEX;
+	}
+
+	uint32_t sl_map = sl < TLSF_SL_COUNT ? tlsf->sl_bitmap_[fl] & (~0u << sl) : 0;
+	if (!sl_map) {
+		uint64_t fl_map = fl + 1 < 64 ? tlsf->fl_bitmap_ & (~0ull << (fl + 1)) : 0;
+		if (!fl_map) {
+			return VK_INVALID_INDEX;
+		}
+
+		fl = Tlsf_Lsb(fl_map);
+		sl_map = tlsf->sl_bitmap_[fl];
+	}
+
+	sl = Tlsf_Lsb(sl_map);
+	return tlsf->heads_[fl][sl];
+}
+
+static void Tlsf_InsertFree(mem_tlsf_s * tlsf, uint32_t idx) {
+	tlsf_range_s & r = tlsf->ranges_[idx];
+
+	uint32_t fl, sl;
+	Tlsf_Mapping(r.size_, fl, sl);
+
+	r.state_ = tlsf_state_t::FREE;
+	r.prev_free_ = VK_INVALID_INDEX;
+	r.next_free_ = tlsf->heads_[fl][sl];
+	if (r.next_free_ != VK_INVALID_INDEX) {
+		tlsf->ranges_[r.next_free_].prev_free_ = idx;
+	}
+
+	tlsf->heads_[fl][sl] = idx;
+	tlsf->fl_bitmap_ |= 1ull << fl;
+	tlsf->sl_bitmap_[fl] |= 1u << sl;
+}
+
+static void Tlsf_RemoveFree(mem_tlsf_s * tlsf, uint32_t idx) {
+	tlsf_range_s & r = tlsf->ranges_[idx];
+
+	uint32_t fl, sl;
+	Tlsf_Mapping(r.size_, fl, sl);
+
+	if (r.prev_free_ != VK_INVALID_INDEX) {
+		tlsf->ranges_[r.prev_free_].next_free_ = r.next_free_;
+	}
+	else {
+		tlsf->heads_[fl][sl] = r.next_free_;
+		if (r.next_free_ == VK_INVALID_INDEX) {
+			tlsf->sl_bitmap_[fl] &= ~(1u << sl);
+			if (!tlsf->sl_bitmap_[fl]) {
+				tlsf->fl_bitmap_ &= ~(1ull << fl);
+			}
+		}
+	}
+
+	if (r.next_free_ != VK_INVALID_INDEX) {
+		tlsf->ranges_[r.next_free_].prev_free_ = r.prev_free_;
+	}
+
+	r.prev_free_ = r.next_free_ = VK_INVALID_INDEX;
+}
+
+static uint32_t Tlsf_NewRecord(mem_tlsf_s * tlsf) {
+	uint32_t idx = tlsf->spare_;
+	if (idx != VK_INVALID_INDEX) {
+		tlsf->spare_ = tlsf->ranges_[idx].next_free_;
+	}
+	else {
+		idx = (uint32_t)tlsf->ranges_.size();
+		tlsf->ranges_.emplace_back();
+	}
+
+	tlsf_range_s & r = tlsf->ranges_[idx];
+	r.prev_phys_ = r.next_phys_ = VK_INVALID_INDEX;
+	r.prev_free_ = r.next_free_ = VK_INVALID_INDEX;
+	r.state_ = tlsf_state_t::UNUSED;
+	return idx;
+}
+
+static void Tlsf_DeleteRecord(mem_tlsf_s * tlsf, uint32_t idx) {
+	tlsf_range_s & r = tlsf->ranges_[idx];
+	r.state_ = tlsf_state_t::UNUSED;
+	r.next_free_ = tlsf->spare_;
+	tlsf->spare_ = idx;
+}
+
+// splits [offset_ + size, end) of range idx off as a new record after it, returns the new record
+static uint32_t Tlsf_Split(mem_tlsf_s * tlsf, uint32_t idx, uint64_t size) {
+	uint32_t rest = Tlsf_NewRecord(tlsf);	// may move ranges_
+
+	tlsf_range_s & r = tlsf->ranges_[idx];
+	tlsf_range_s & n = tlsf->ranges_[rest];
+
+	n.offset_ = r.offset_ + size;
+	n.size_ = r.size_ - size;
+	n.prev_phys_ = idx;
+	n.next_phys_ = r.next_phys_;
+	if (n.next_phys_ != VK_INVALID_INDEX) {
+		tlsf->ranges_[n.next_phys_].prev_phys_ = rest;
+	}
+
+	r.size_ = size;
+	r.next_phys_ = rest;
+
+	return rest;
+}
+
+// range next is absorbed into range idx
+static void Tlsf_Merge(mem_tlsf_s * tlsf, uint32_t idx, uint32_t next) {
+	tlsf_range_s & r = tlsf->ranges_[idx];
+	tlsf_range_s & n = tlsf->ranges_[next];
+
+	r.size_ += n.size_;
+	r.next_phys_ = n.next_phys_;
+	if (r.next_phys_ != VK_INVALID_INDEX) {
+		tlsf->ranges_[r.next_phys_].prev_phys_ = idx;
+	}
+
+	Tlsf_DeleteRecord(tlsf, next);
+}
+
+COMMON_API mem_tlsf_s * Mem_CreateTlsf(uint64_t size) {
+	size &= ~((1ull << TLSF_ALIGN_LOG2) - 1);
+	if (!size) {
+		return nullptr;
+	}
+
+	mem_tlsf_s * tlsf = new mem_tlsf_s();
+	tlsf->size_ = size;
+	tlsf->used_bytes_ = 0;
+	tlsf->allocation_count_ = 0;
+	tlsf->fl_bitmap_ = 0;
+	memset(tlsf->sl_bitmap_, 0, sizeof(tlsf->sl_bitmap_));
+	memset(tlsf->heads_, 0xff, sizeof(tlsf->heads_));	// VK_INVALID_INDEX
+	tlsf->spare_ = VK_INVALID_INDEX;
+
+	uint32_t idx = Tlsf_NewRecord(tlsf);
+	tlsf->ranges_[idx].offset_ = 0;
+	tlsf->ranges_[idx].size_ = size;
+	Tlsf_InsertFree(tlsf, idx);
+
+	return tlsf;
+}
+
+COMMON_API void Mem_DestroyTlsf(mem_tlsf_s * tlsf) {
+	delete tlsf;
+}
+
+COMMON_API uint32_t Mem_TlsfAlloc(mem_tlsf_s * tlsf, uint64_t size, uint64_t alignment, uint64_t & offset) {
+	const uint64_t granule = 1ull << TLSF_ALIGN_LOG2;
+
+	size = size ? (size + granule - 1) & ~(granule - 1) : granule;
+	alignment = alignment > granule ? alignment : granule;
+	if (size > tlsf->size_) {
+		return VK_INVALID_INDEX;
+	}
+
+	// the head of the list of size is often aligned already, otherwise look for room for the padding too
+	uint32_t idx = Tlsf_FindFree(tlsf, size);
+	if (idx != VK_INVALID_INDEX) {
+		const tlsf_range_s & r = tlsf->ranges_[idx];
+		uint64_t aligned = (r.offset_ + alignment - 1) & ~(alignment - 1);
+		if (aligned + size > r.offset_ + r.size_) {
+			idx = VK_INVALID_INDEX;
+		}
+	}
+
+	if (idx == VK_INVALID_INDEX && alignment > granule) {
+		idx = Tlsf_FindFree(tlsf, size + alignment - granule);
+	}
+
+	if (idx == VK_INVALID_INDEX) {
+		return VK_INVALID_INDEX;
+	}
+
+	Tlsf_RemoveFree(tlsf, idx);
+
+	uint64_t pad = ((tlsf->ranges_[idx].offset_ + alignment - 1) & ~(alignment - 1)) - tlsf->ranges_[idx].offset_;
+	if (pad) {
+		// the front goes back to the free lists, its previous neighbour is in use: free ranges are always merged
+		uint32_t front = idx;
+		idx = Tlsf_Split(tlsf, front, pad);
+		Tlsf_InsertFree(tlsf, front);
+	}
+
+	if (tlsf->ranges_[idx].size_ > size) {
+		uint32_t rest = Tlsf_Split(tlsf, idx, size);
+		Tlsf_InsertFree(tlsf, rest);
+	}
+
+	tlsf_range_s & r = tlsf->ranges_[idx];
+	r.state_ = tlsf_state_t::USED;
+
+	tlsf->used_bytes_ += r.size_;
+	tlsf->allocation_count_++;
+
+	offset = r.offset_;
+	return idx;
+}
+
+COMMON_API void Mem_TlsfFree(mem_tlsf_s * tlsf, uint32_t handle) {
+	if (handle >= tlsf->ranges_.size() || tlsf->ranges_[handle].state_ != tlsf_state_t::USED) {
+		printf("[Mem_TlsfFree] bad handle %u\n", handle);
+		return;
+	}
+
+	tlsf->used_bytes_ -= tlsf->ranges_[handle].size_;
+	tlsf->allocation_count_--;
+
+	uint32_t idx = handle;
+
+	uint32_t prev = tlsf->ranges_[idx].prev_phys_;
+	if (prev != VK_INVALID_INDEX && tlsf->ranges_[prev].state_ == tlsf_state_t::FREE) {
+		Tlsf_RemoveFree(tlsf, prev);
+		Tlsf_Merge(tlsf, prev, idx);
+		idx = prev;
+	}
+
+	uint32_t next = tlsf->ranges_[idx].next_phys_;
+	if (next != VK_INVALID_INDEX && tlsf->ranges_[next].state_ == tlsf_state_t::FREE) {
+		Tlsf_RemoveFree(tlsf, next);
+		Tlsf_Merge(tlsf, idx, next);
+	}
+
+	Tlsf_InsertFree(tlsf, idx);
+}
+
+COMMON_API void Mem_TlsfGetStats(const mem_tlsf_s * tlsf, mem_range_stats_s & stats) {
+	memset(&stats, 0, sizeof(stats));
+
+	stats.size_ = tlsf->size_;
+	stats.used_bytes_ = tlsf->used_bytes_;
+	stats.free_bytes_ = tlsf->size_ - tlsf->used_bytes_;
+	stats.allocation_count_ = tlsf->allocation_count_;
+
+	for (const tlsf_range_s & r : tlsf->ranges_) {
+		if (r.state_ == tlsf_state_t::FREE) {
+			stats.free_range_count_++;
+			stats.largest_free_ = r.size_ > stats.largest_free_ ? r.size_ : stats.largest_free_;
+		}
+	}
+}
+
+COMMON_API void Mem_TlsfWalk(const mem_tlsf_s * tlsf, const std::function<void(uint64_t, uint64_t, bool)> & func) {
+	uint32_t idx = VK_INVALID_INDEX;
+	for (uint32_t i = 0; i < (uint32_t)tlsf->ranges_.size(); ++i) {
+		const tlsf_range_s & r = tlsf->ranges_[i];
+		if (r.state_ != tlsf_state_t::UNUSED && r.prev_phys_ == VK_INVALID_INDEX) {
+			idx = i;
+			break;
+		}
+	}
+
+	while (idx != VK_INVALID_INDEX) {
+		const tlsf_range_s & r = tlsf->ranges_[idx];
+		func(r.offset_, r.size_, r.state_ == tlsf_state_t::USED);
+		idx = r.next_phys_;
+	}
+}
+
+/*
+================================================================================
+VkMemoryAllocator
+================================================================================
+*/
+static const VkDeviceSize	MEMORY_DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+static const char * Mem_UsageToStr(VkMemoryAllocator::usage_t usage) {
+	switch (usage) {
+	case VkMemoryAllocator::usage_t::RESOURCE:	return "resource";
+	case VkMemoryAllocator::usage_t::IMAGE:		return "image";
+	case VkMemoryAllocator::usage_t::TRANSIENT:	return "transient";
+	}
+	return "unknown";
+}
+
+VkMemoryAllocator::VkMemoryAllocator():
+	device_(VK_NULL_HANDLE),
+	non_coherent_atom_size_(1),
+	max_allocation_count_(0),
+	device_allocation_count_(0)
+{
+	memset(&memory_properties_, 0, sizeof(memory_properties_));
+	memset(block_sizes_, 0, sizeof(block_sizes_));
+}
+
+VkMemoryAllocator::~VkMemoryAllocator() {
+	Shutdown();
+}
+
+bool VkMemoryAllocator::Init(VkDevice device, const VkPhysicalDeviceMemoryProperties & memory_properties,
+	const VkPhysicalDeviceLimits & limits, VkDeviceSize block_size)
+{
+	Shutdown();
+
+	device_ = device;
+	memory_properties_ = memory_properties;
+	non_coherent_atom_size_ = limits.nonCoherentAtomSize ? limits.nonCoherentAtomSize : 1;
+	max_allocation_count_ = limits.maxMemoryAllocationCount;
+
+	if (!block_size) {
+		block_size = MEMORY_DEFAULT_BLOCK_SIZE;
+	}
+
+	// a small heap, like the 256MB host visible window into VRAM, is not given away in a few blocks
+	for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i) {
+		VkDeviceSize heap_size = memory_properties_.memoryHeaps[memory_properties_.memoryTypes[i].heapIndex].size;
+		VkDeviceSize size = block_size;
+		while (size > 1024 * 1024 && size > heap_size / 8) {
+			size >>= 1;
+		}
+		block_sizes_[i] = size;
+	}
+
+	return true;
+}
+
+void VkMemoryAllocator::Shutdown() {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	uint32_t leaked = 0;
+	for (uint32_t i = 0; i < (uint32_t)blocks_.size(); ++i) {
+		if (blocks_[i]) {
+			leaked += blocks_[i]->allocation_count_;
+			DestroyBlock(i);
+		}
+	}
+
+	if (leaked) {
+		printf("[VkMemoryAllocator] %u allocations not freed\n", leaked);
+	}
+
+	blocks_.clear();
+	device_allocation_count_ = 0;
+}
+
+bool VkMemoryAllocator::IsCoherent(uint32_t memory_type) const {
+	return (memory_properties_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+VkMemoryAllocator::block_s * VkMemoryAllocator::CreateBlock(uint32_t memory_type, usage_t usage,
+	VkDeviceSize size, bool dedicated, uint32_t & block_idx)
+{
+	if (max_allocation_count_ && device_allocation_count_ >= max_allocation_count_) {
+		printf("[VkMemoryAllocator] maxMemoryAllocationCount %u reached\n", max_allocation_count_);
+		return nullptr;
+	}
+
+	VkMemoryAllocateInfo mem_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type
+	};
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (VK_SUCCESS != vkAllocateMemory(device_, &mem_alloc_info, nullptr, &memory)) {
+		return nullptr;
+	}
+
+	void * mapped = nullptr;
+	if (memory_properties_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (VK_SUCCESS != vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped)) {
+			printf("[VkMemoryAllocator] vkMapMemory error\n");
+			vkFreeMemory(device_, memory, nullptr);
+			return nullptr;
+		}
+	}
+
+	block_s * block = new block_s();
+	block->memory_ = memory;
+	block->size_ = size;
+	block->memory_type_ = memory_type;
+	block->usage_ = usage;
+	block->dedicated_ = dedicated;
+	block->mapped_ = (byte_t*)mapped;
+	block->tlsf_ = (usage != usage_t::TRANSIENT && !dedicated) ? Mem_CreateTlsf(size) : nullptr;
+	block->linear_head_ = 0;
+	block->allocation_count_ = 0;
+	block->used_bytes_ = 0;
+
+	device_allocation_count_++;
+
+	for (block_idx = 0; block_idx < (uint32_t)blocks_.size(); ++block_idx) {
+		if (!blocks_[block_idx]) {
+			break;
+		}
+	}
+
+	if (block_idx == (uint32_t)blocks_.size()) {
+		blocks_.push_back(block);
+	}
+	else {
+		blocks_[block_idx] = block;
+	}
+
+	return block;
+}
+
+void VkMemoryAllocator::DestroyBlock(uint32_t block_idx) {
+	block_s * block = blocks_[block_idx];
+
+	if (block->mapped_) {
+		vkUnmapMemory(device_, block->memory_);
+	}
+
+	vkFreeMemory(device_, block->memory_, nullptr);
+	device_allocation_count_--;
+
+	if (block->tlsf_) {
+		Mem_DestroyTlsf(block->tlsf_);
+	}
+
+	delete block;
+	blocks_[block_idx] = nullptr;
+}
+
+bool VkMemoryAllocator::SubAlloc(block_s * block, VkDeviceSize size, VkDeviceSize alignment,
+	VkDeviceSize & offset, uint32_t & range)
+{
+	if (block->dedicated_) {
+		if (block->allocation_count_) {
+			return false;
+		}
+
+		offset = 0;
+		range = VK_INVALID_INDEX;
+		return true;
+	}
+
+	if (block->tlsf_) {
+		uint64_t range_offset = 0;
+		range = Mem_TlsfAlloc(block->tlsf_, size, alignment, range_offset);
+		offset = range_offset;
+		return range != VK_INVALID_INDEX;
+	}
+
+	// linear
+	VkDeviceSize aligned = (block->linear_head_ + alignment - 1) & ~(alignment - 1);
+	if (aligned + size > block->size_) {
+		return false;
+	}
+
+	block->linear_head_ = aligned + size;
+	offset = aligned;
+	range = VK_INVALID_INDEX;
+	return true;
+}
+
+bool VkMemoryAllocator::Alloc(const VkMemoryRequirements & requirements, uint32_t memory_type_index, usage_t usage,
+	vk_allocation_s & allocation)
+{
+	memset(&allocation, 0, sizeof(allocation));
+
+	if (memory_type_index >= memory_properties_.memoryTypeCount) {
+		printf("[VkMemoryAllocator] bad memory type %u\n", memory_type_index);
+		return false;
+	}
+
+	VkDeviceSize size = requirements.size;
+	VkDeviceSize alignment = requirements.alignment ? requirements.alignment : 1;
+
+	// a flush of non coherent memory covers whole atoms: the atoms of an allocation are its own
+	bool host_visible = (memory_properties_.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	if (host_visible && !IsCoherent(memory_type_index)) {
+		alignment = alignment > non_coherent_atom_size_ ? alignment : non_coherent_atom_size_;
+		size = (size + non_coherent_atom_size_ - 1) / non_coherent_atom_size_ * non_coherent_atom_size_;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	VkDeviceSize block_size = block_sizes_[memory_type_index];
+	bool dedicated = size > block_size / 2;
+
+	block_s * block = nullptr;
+	uint32_t block_idx = VK_INVALID_INDEX;
+	VkDeviceSize offset = 0;
+	uint32_t range = VK_INVALID_INDEX;
+
+	if (!dedicated) {
+		for (uint32_t i = 0; i < (uint32_t)blocks_.size(); ++i) {
+			block_s * b = blocks_[i];
+			if (b && !b->dedicated_ && b->memory_type_ == memory_type_index && b->usage_ == usage &&
+				SubAlloc(b, size, alignment, offset, range)) {
+				block = b;
+				block_idx = i;
+				break;
+			}
+		}
+
+		if (!block) {
+			block = CreateBlock(memory_type_index, usage, block_size, false, block_idx);
+			if (block && !SubAlloc(block, size, alignment, offset, range)) {
+				DestroyBlock(block_idx);
+				block = nullptr;
+			}
+		}
+	}
+
+	// a large resource, or the heap has no room for another full block
+	if (!block) {
+		block = CreateBlock(memory_type_index, usage, size, true, block_idx);
+		if (!block) {
+			printf("[VkMemoryAllocator] out of memory, %llu bytes of memory type %u\n",
+				(unsigned long long)size, memory_type_index);
+			return false;
+		}
+
+		SubAlloc(block, size, alignment, offset, range);
+	}
+
+	block->allocation_count_++;
+	block->used_bytes_ += size;
+
+	allocation.memory_ = block->memory_;
+	allocation.offset_ = offset;
+	allocation.size_ = size;
+	allocation.mapped_ = block->mapped_ ? block->mapped_ + offset : nullptr;
+	allocation.block_ = block_idx;
+	allocation.range_ = range;
+
+	return true;
+}
+
+void VkMemoryAllocator::Free(vk_allocation_s & allocation) {
+	if (!allocation.memory_) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	block_s * block = allocation.block_ < (uint32_t)blocks_.size() ? blocks_[allocation.block_] : nullptr;
+	if (!block || block->memory_ != allocation.memory_) {
+		printf("[VkMemoryAllocator] freeing an allocation of another block\n");
+		return;
+	}
+
+	if (block->tlsf_) {
+		Mem_TlsfFree(block->tlsf_, allocation.range_);
+	}
+	else if (!block->dedicated_ && allocation.offset_ + allocation.size_ == block->linear_head_) {
+		// the last allocation of a linear block, the next one can take its place
+		block->linear_head_ = allocation.offset_;
+	}
+
+	block->allocation_count_--;
+	block->used_bytes_ -= allocation.size_;
+
+	if (!block->allocation_count_) {
+		block->linear_head_ = 0;
+
+		// one empty block per memory type and usage is kept, no allocation churn on a load/free pattern
+		bool keep = !block->dedicated_;
+		for (uint32_t i = 0; keep && i < (uint32_t)blocks_.size(); ++i) {
+			block_s * b = blocks_[i];
+			if (b && b != block && !b->dedicated_ && !b->allocation_count_ &&
+				b->memory_type_ == block->memory_type_ && b->usage_ == block->usage_) {
+				keep = false;
+			}
+		}
+
+		if (!keep) {
+			DestroyBlock(allocation.block_);
+		}
+	}
+
+	memset(&allocation, 0, sizeof(allocation));
+}
+
+bool VkMemoryAllocator::Flush(const vk_allocation_s & allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (!allocation.memory_ || !allocation.mapped_) {
+		return false;
+	}
+
+	uint32_t memory_type = 0;
+	VkDeviceSize block_size = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const block_s * block = blocks_[allocation.block_];
+		memory_type = block->memory_type_;
+		block_size = block->size_;
+	}
+
+	if (IsCoherent(memory_type)) {
+		return true;
+	}
+
+	VkDeviceSize atom = non_coherent_atom_size_;
+	VkDeviceSize begin = (allocation.offset_ + offset) / atom * atom;
+	VkDeviceSize end = (allocation.offset_ + offset + size + atom - 1) / atom * atom;
+	end = end < block_size ? end : block_size;
+
+	VkMappedMemoryRange mapped_range = {};
+
+	mapped_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mapped_range.pNext = nullptr;
+	mapped_range.memory = allocation.memory_;
+	mapped_range.offset = begin;
+	mapped_range.size = end - begin;
+
+	if (VK_SUCCESS != vkFlushMappedMemoryRanges(device_, 1, &mapped_range)) {
+		printf("[VkMemoryAllocator] vkFlushMappedMemoryRanges error\n");
+		return false;
+	}
+
+	return true;
+}
+
+void VkMemoryAllocator::GetBlockStats(const block_s * block, mem_range_stats_s & stats) const {
+	if (block->tlsf_) {
+		Mem_TlsfGetStats(block->tlsf_, stats);
+		return;
+	}
+
+	// dedicated, or linear: the room left is past the head
+	memset(&stats, 0, sizeof(stats));
+
+	stats.size_ = block->size_;
+	stats.used_bytes_ = block->used_bytes_;
+	stats.free_bytes_ = block->size_ - block->used_bytes_;
+	stats.allocation_count_ = block->allocation_count_;
+
+	if (!block->dedicated_ && block->size_ > block->linear_head_) {
+		stats.free_range_count_ = 1;
+		stats.largest_free_ = block->size_ - block->linear_head_;
+	}
+}
+
+void VkMemoryAllocator::GetStats(vk_memory_stats_s & stats) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	memset(&stats, 0, sizeof(stats));
+
+	uint64_t largest_free_sum = 0;
+	for (const block_s * block : blocks_) {
+		if (!block) {
+			continue;
+		}
+
+		mem_range_stats_s block_stats;
+		GetBlockStats(block, block_stats);
+
+		stats.block_count_++;
+		stats.dedicated_block_count_ += block->dedicated_ ? 1 : 0;
+		stats.allocation_count_ += block->allocation_count_;
+		stats.block_bytes_ += block->size_;
+		stats.used_bytes_ += block->used_bytes_;
+		stats.free_bytes_ += block_stats.free_bytes_;
+		stats.largest_free_ = block_stats.largest_free_ > stats.largest_free_ ? block_stats.largest_free_ : stats.largest_free_;
+		largest_free_sum += block_stats.largest_free_;
+	}
+
+	stats.fragmentation_ = stats.free_bytes_ ? 1.0f - (float)((double)largest_free_sum / (double)stats.free_bytes_) : 0.0f;
+}
+
+bool VkMemoryAllocator::DumpJson(const char * filename) {
+	FILE * f = File_Open(filename, "wb");
+	if (!f) {
+		printf("[VkMemoryAllocator] could not write %s\n", filename);
+		return false;
+	}
+
+	vk_memory_stats_s stats;
+	GetStats(stats);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"block_count\": %u,\n", stats.block_count_);
+	fprintf(f, "  \"dedicated_block_count\": %u,\n", stats.dedicated_block_count_);
+	fprintf(f, "  \"allocation_count\": %u,\n", stats.allocation_count_);
+	fprintf(f, "  \"block_bytes\": %llu,\n", (unsigned long long)stats.block_bytes_);
+	fprintf(f, "  \"used_bytes\": %llu,\n", (unsigned long long)stats.used_bytes_);
+	fprintf(f, "  \"free_bytes\": %llu,\n", (unsigned long long)stats.free_bytes_);
+	fprintf(f, "  \"largest_free\": %llu,\n", (unsigned long long)stats.largest_free_);
+	fprintf(f, "  \"fragmentation\": %.4f,\n", stats.fragmentation_);
+	fprintf(f, "  \"blocks\": [");
+
+	bool first_block = true;
+	for (uint32_t i = 0; i < (uint32_t)blocks_.size(); ++i) {
+		const block_s * block = blocks_[i];
+		if (!block) {
+			continue;
+		}
+
+		mem_range_stats_s block_stats;
+		GetBlockStats(block, block_stats);
+
+		fprintf(f, "%s\n    {\n", first_block ? "" : ",");
+		first_block = false;
+
+		fprintf(f, "      \"index\": %u,\n", i);
+		fprintf(f, "      \"memory_type\": %u,\n", block->memory_type_);
+		fprintf(f, "      \"property_flags\": %u,\n", memory_properties_.memoryTypes[block->memory_type_].propertyFlags);
+		fprintf(f, "      \"usage\": \"%s\",\n", Mem_UsageToStr(block->usage_));
+		fprintf(f, "      \"dedicated\": %s,\n", block->dedicated_ ? "true" : "false");
+		fprintf(f, "      \"size\": %llu,\n", (unsigned long long)block->size_);
+		fprintf(f, "      \"allocation_count\": %u,\n", block->allocation_count_);
+		fprintf(f, "      \"used_bytes\": %llu,\n", (unsigned long long)block->used_bytes_);
+		fprintf(f, "      \"free_range_count\": %u,\n", block_stats.free_range_count_);
+		fprintf(f, "      \"largest_free\": %llu", (unsigned long long)block_stats.largest_free_);
+
+		if (block->tlsf_) {
+			// [offset, size, used]
+			fprintf(f, ",\n      \"ranges\": [");
+			bool first_range = true;
+			Mem_TlsfWalk(block->tlsf_, [&](uint64_t offset, uint64_t size, bool used) {
+				fprintf(f, "%s[%llu, %llu, %s]", first_range ? "" : ", ",
+					(unsigned long long)offset, (unsigned long long)size, used ? "true" : "false");
+				first_range = false;
+			});
+			fprintf(f, "]");
+		}
+		else if (!block->dedicated_) {
+			fprintf(f, ",\n      \"linear_head\": %llu", (unsigned long long)block->linear_head_);
+		}
+
+		fprintf(f, "\n    }");
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+	fclose(f);
+
+	return true;
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+ device memory
+ *****************************************************************************/
+
+#pragma once
+
+/*
+================================================================================
+two level segregated fit
+
+  O(1) allocation and freeing of ranges of [0, size), the bookkeeping lives
+  outside the range so it can describe device memory
+================================================================================
+*/
+struct mem_tlsf_s;
+
+struct mem_range_stats_s {
+	uint64_t				size_;
+	uint64_t				used_bytes_;
+	uint64_t				free_bytes_;
+	uint64_t				largest_free_;
+	uint32_t				allocation_count_;
+	uint32_t				free_range_count_;
+};
+
+COMMON_API mem_tlsf_s *		Mem_CreateTlsf(uint64_t size);
+COMMON_API void				Mem_DestroyTlsf(mem_tlsf_s * tlsf);
+// sizes and offsets are multiples of 16, alignment: power of two
+// returns the handle to free the range with, VK_INVALID_INDEX if no free range fits
+COMMON_API uint32_t			Mem_TlsfAlloc(mem_tlsf_s * tlsf, uint64_t size, uint64_t alignment, uint64_t & offset);
+COMMON_API void				Mem_TlsfFree(mem_tlsf_s * tlsf, uint32_t handle);
+COMMON_API void				Mem_TlsfGetStats(const mem_tlsf_s * tlsf, mem_range_stats_s & stats);
+// func(offset, size, used) over all ranges in address order
+COMMON_API void				Mem_TlsfWalk(const mem_tlsf_s * tlsf, const std::function<void(uint64_t, uint64_t, bool)> & func);
+
+/*
+================================================================================
+VkMemoryAllocator
+
+  device memory is allocated in large blocks per memory type, buffers and
+  images are placed in them: a scene costs a handful of vkAllocateMemory calls
+  instead of one per resource. Host visible blocks stay mapped
+================================================================================
+*/
+struct vk_memory_stats_s {
+	uint32_t				block_count_;
+	uint32_t				dedicated_block_count_;	// blocks of one large resource
+	uint32_t				allocation_count_;
+	uint64_t				block_bytes_;			// device memory allocated
+	uint64_t				used_bytes_;			// alignment padding included
+	uint64_t				free_bytes_;
+	uint64_t				largest_free_;
+	float					fragmentation_;			// 0: the free bytes of each block are one range, towards 1: scattered
+};
+
+class COMMON_API VkMemoryAllocator {
+public:
+
+	enum class usage_t {
+		RESOURCE,	// buffers and linear images, any lifetime: two level segregated fit
+		IMAGE,		// optimal tiling images, apart from RESOURCE: no bufferImageGranularity to respect
+		TRANSIENT	// staging and readback buffers freed soon after use: linear, a block rewinds once empty
+	};
+
+	VkMemoryAllocator();
+	~VkMemoryAllocator();
+
+	// block_size: 0 for 64MB, smaller heaps get an eighth of their size
+	bool					Init(VkDevice device, const VkPhysicalDeviceMemoryProperties & memory_properties,
+								const VkPhysicalDeviceLimits & limits, VkDeviceSize block_size = 0);
+	// reports the allocations still alive, frees the blocks
+	void					Shutdown();
+
+	bool					Alloc(const VkMemoryRequirements & requirements, uint32_t memory_type_index, usage_t usage,
+								vk_allocation_s & allocation);
+	void					Free(vk_allocation_s & allocation);
+	// makes host writes to [offset, offset + size) of the allocation visible to the device, nothing to do on coherent memory
+	bool					Flush(const vk_allocation_s & allocation, VkDeviceSize offset, VkDeviceSize size);
+
+	void					GetStats(vk_memory_stats_s & stats);
+	bool					DumpJson(const char * filename);
+
+private:
+
+	struct block_s {
+		VkDeviceMemory		memory_;
+		VkDeviceSize		size_;
+		uint32_t			memory_type_;
+		usage_t				usage_;
+		bool				dedicated_;
+		byte_t *			mapped_;			// host visible
+		mem_tlsf_s *		tlsf_;				// RESOURCE, IMAGE
+		VkDeviceSize		linear_head_;		// TRANSIENT
+		uint32_t			allocation_count_;
+		VkDeviceSize		used_bytes_;
+	};
+
+	VkDevice				device_;
+	VkPhysicalDeviceMemoryProperties	memory_properties_;
+	VkDeviceSize			non_coherent_atom_size_;
+	uint32_t				max_allocation_count_;
+	VkDeviceSize			block_sizes_[VK_MAX_MEMORY_TYPES];
+
+	std::mutex				mutex_;
+	std::vector<block_s*>	blocks_;			// holes of the freed blocks are reused, vk_allocation_s::block_ indexes it
+	uint32_t				device_allocation_count_;
+
+	bool					IsCoherent(uint32_t memory_type) const;
+	block_s *				CreateBlock(uint32_t memory_type, usage_t usage, VkDeviceSize size, bool dedicated, uint32_t & block_idx);
+	void					DestroyBlock(uint32_t block_idx);
+	bool					SubAlloc(block_s * block, VkDeviceSize size, VkDeviceSize alignment,
+								VkDeviceSize & offset, uint32_t & range);
+	void					GetBlockStats(const block_s * block, mem_range_stats_s & stats) const;
+};
@@ -15,11 +15,15 @@ public:
 	struct load_params_s {
 		// use set 1
 		VkDescriptorSetLayout	desc_set_layout_bind0_mat_bind1_tex_;
+		// a model delivered in another vertex format than the pipelines take fails
+		bool					check_vertex_format_;
+		vertex_format_t			vertex_format_;
 	};
 
 	struct vk_material_s {
-		vk_image_s			vk_texture_;
+		vk_image_s			vk_texture_;		// no image: not textured
 		VkDescriptorSet		vk_desc_set_;
+		bool				texture_resident_;	// false: vk_texture_ is the placeholder of the streamer
 	};
 
 	struct vk_model_part_s {
@@ -31,10 +35,19 @@ public:
 	VkModel(VkDemo * owner);
 	~VkModel();
 
+	// waits for the model and its textures to be decoded, their uploads go with the next frame
 	bool					Load(const load_params_s & params, const char * filename, 
 								bool move_to_origin, const glm::mat4* transform = nullptr);
+	// returns at once, the model can be drawn when IsReady, its textures are swapped in as they arrive
+	bool					LoadAsync(const load_params_s & params, const char * filename, 
+								bool move_to_origin, const glm::mat4* transform = nullptr);
 	void					Free();
 
+	// vertices, indices, materials and descriptor sets in place
+	bool					IsReady() const;
+	bool					IsFailed() const;
+	uint32_t				GetPendingTextureCount() const;
+
 	vertex_format_t			GetVertexFormat() const;
 	const float *			GetMin() const;
 	const float *			GetMax() const;
@@ -53,6 +66,13 @@ private:
 
 	VkDemo *				owner_;
 
+	load_params_s			params_;
+	char					filename_[MAX_PATH];
+	bool					loading_;
+	bool					failed_;
+	uint32_t				pending_buffer_count_;
+	uint32_t				pending_texture_count_;
+
 	// sampler
 	VkSampler				vk_sampler_;
 
@@ -71,4 +91,8 @@ private:
 
 	uint32_t				material_count_;
 	uint32_t				part_count_;
+
+	void					OnModelLoaded(model_s* model);
+	bool					CreateMaterials(const model_s& model);
+	void					OnTextureResident(uint32_t material_idx, vk_image_s* vk_image);
 };
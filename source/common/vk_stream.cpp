@@ -0,0 +1,420 @@
+/******************************************************************************
+ asset streaming
+ *****************************************************************************/
+
+#include "inc.h"
+#include <algorithm>
+
+/*
+================================================================================
+VkStreamer
+================================================================================
+*/
+VkStreamer::VkStreamer(VkDemo* owner):
+	owner_(owner),
+	pending_(0),
+	recording_(nullptr),
+	changed_(false)
+{
+	memset(&placeholder_, 0, sizeof(placeholder_));
+}
+
+VkStreamer::~VkStreamer() {
+	Shutdown();
+}
+
+bool VkStreamer::Init() {
+	Shutdown();
+
+	image_s white = {};
+	if (!Img_Create(1, 1, image_format_t::R8G8B8A8, white)) {
+		return false;
+	}
+	memset(white.pixels_, 0xff, 4);
+
+	bool ok = owner_->Create2DTexture(white, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, placeholder_);
+
+	Img_Free(white);
+
+	return ok;
+}
+
+void VkStreamer::Shutdown() {
+	// the jobs not started yet skip decoding
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (job_s* job : running_jobs_) {
+			job->cancelled_ = true;
+		}
+	}
+
+	Job_Wait(pending_);
+
+	for (job_s* job : finished_jobs_) {
+		FreeJob(job);
+	}
+	finished_jobs_.clear();
+
+	// nothing is called back any more, the textures in flight are destroyed,
+	// the uploads not submitted yet are dropped with the other queued ones of the uploader
+	if (recording_) {
+		DestroyBatch(recording_);
+		recording_ = nullptr;
+	}
+	for (batch_s* batch : in_flight_) {
+		for (upload_s& upload : batch->uploads_) {
+			upload.client_ = nullptr;
+		}
+	}
+
+	RetireBatches(true);
+
+	if (placeholder_.image_) {
+		owner_->DestroyImage(placeholder_);
+	}
+
+	changed_ = false;
+}
+
+void VkStreamer::LoadModel(const void* client, const char* filename, bool move_to_origin,
+	const glm::mat4* transform, model_loaded_t on_loaded)
+{
+	job_s* job = new job_s();
+
+	job->type_ = job_type_t::MODEL;
+	job->client_ = client;
+	Str_Copy(job->filename_, MAX_PATH, filename);
+	job->move_to_origin_ = move_to_origin;
+	job->has_transform_ = transform != nullptr;
+	job->transform_ = transform ? *transform : glm::mat4(1.0f);
+	job->on_model_ = on_loaded;
+
+	QueueJob(job);
+}
+
+void VkStreamer::LoadTexture(const void* client, const char* filename, VkFormat format,
+	VkSampler sampler, texture_resident_t on_resident)
+{
+	job_s* job = new job_s();
+
+	job->type_ = job_type_t::TEXTURE;
+	job->client_ = client;
+	owner_->GetTextureFilename(filename, job->filename_, MAX_PATH);
+	job->format_ = format;
+	job->sampler_ = sampler;
+	job->on_texture_ = on_resident;
+
+	QueueJob(job);
+}
+
+bool VkStreamer::UploadBuffer(const void* client, vk_buffer_s& buffer, VkBufferUsageFlags usage,
+	const void* data, size_t data_size, upload_done_t on_done)
+{
+	memset(&buffer, 0, sizeof(buffer));
+
+	if (!owner_->CreateBuffer(buffer, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, data_size))
+	{
+		owner_->DestroyBuffer(buffer);
+		return false;
+	}
+
+	void* dst = owner_->uploader_->UploadBuffer(buffer.buffer_, 0, data_size);
+	if (!dst) {
+		owner_->DestroyBuffer(buffer);
+		return false;
+	}
+
+	memcpy(dst, data, data_size);
+
+	GetRecordingBatch()->uploads_.push_back({ client, {}, nullptr, on_done });
+
+	return true;
+}
+
+const vk_image_s& VkStreamer::GetPlaceholderTexture() const {
+	return placeholder_;
+}
+
+bool VkStreamer::Pump() {
+	RetireBatches(false);
+	HandleFinishedJobs();
+	SubmitBatch();
+
+	bool changed = changed_;
+	changed_ = false;
+
+	return changed;
+}
+
+void VkStreamer::Flush() {
+	while (!IsIdle()) {
+		RetireBatches(false);
+
+		if (HandleFinishedJobs()) {
+			continue;	// the callbacks may have queued more
+		}
+
+		// decodes on this thread too meanwhile
+		if (pending_.load()) {
+			Job_Wait(pending_);
+			continue;
+		}
+
+		// everything is decoded: the uploads join those the demo queued, the next frame submits them all at once
+		// and waits for them, the callbacks need not
+		if (recording_) {
+			batch_s* batch = recording_;
+			recording_ = nullptr;
+
+			owner_->uploads_pending_ = true;
+			owner_->WaitFramesInFlight();
+			CallBack(batch);
+			DestroyBatch(batch);
+		}
+
+		// submitted by an earlier Pump
+		RetireBatches(true);
+	}
+}
+
+void VkStreamer::Cancel(const void* client) {
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		// jobs not started yet skip decoding, jobs being decoded are not interrupted
+		for (job_s* job : running_jobs_) {
+			if (job->client_ == client) {
+				job->cancelled_ = true;
+			}
+		}
+
+		cv_done_.wait(lock, [this, client]() {
+			for (job_s* job : running_jobs_) {
+				if (job->client_ == client) {
+					return false;
+				}
+			}
+			return true;
+		});
+
+		for (auto it = finished_jobs_.begin(); it != finished_jobs_.end(); ) {
+			if ((*it)->client_ == client) {
+				FreeJob(*it);
+				it = finished_jobs_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	bool any_upload = false;
+
+	auto Drop = [client, &any_upload](batch_s* batch) {
+		for (upload_s& upload : batch->uploads_) {
+			if (upload.client_ == client) {
+				upload.client_ = nullptr;
+				any_upload = true;
+			}
+		}
+	};
+
+	if (recording_) {
+		Drop(recording_);
+	}
+	for (batch_s* batch : in_flight_) {
+		Drop(batch);
+	}
+
+	// the buffers of client may be destroyed as soon as this returns, Flush may have left theirs
+	// with the uploads of the demo
+	if (any_upload) {
+		SubmitBatch();
+		RetireBatches(true);
+	}
+
+	if (owner_->uploads_pending_) {
+		owner_->FlushUploads();
+	}
+}
+
+bool VkStreamer::IsIdle() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return running_jobs_.empty() && finished_jobs_.empty() && !recording_ && in_flight_.empty();
+}
+
+void VkStreamer::QueueJob(job_s* job) {
+	job->cancelled_ = false;
+	job->ok_ = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_jobs_.push_back(job);
+	}
+
+	Job_Async(pending_, [this, job]() { DecodeJob(job); });
+}
+
+void VkStreamer::DecodeJob(job_s* job) {
+	bool cancelled;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		cancelled = job->cancelled_;
+	}
+
+	if (!cancelled) {
+		if (job->type_ == job_type_t::MODEL) {
+			job->ok_ = owner_->LoadModel(job->filename_, job->move_to_origin_, job->model_,
+				job->has_transform_ ? &job->transform_ : nullptr);
+		}
+		else {
+			job->ok_ = Img_Load(job->filename_, job->image_);
+		}
+
+		if (!job->ok_) {
+			printf("Failed to load \"%s\"\n", job->filename_);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_jobs_.erase(std::find(running_jobs_.begin(), running_jobs_.end(), job));
+		if (job->cancelled_) {
+			FreeJob(job);	// cancelled while decoding too
+		}
+		else {
+			finished_jobs_.push_back(job);
+		}
+	}
+	cv_done_.notify_all();
+}
+
+void VkStreamer::FreeJob(job_s* job) {
+	if (job->type_ == job_type_t::MODEL) {
+		Model_Free(job->model_);
+	}
+	else {
+		Img_Free(job->image_);
+	}
+
+	delete job;
+}
+
+VkStreamer::batch_s* VkStreamer::GetRecordingBatch() {
+	if (!recording_) {
+		recording_ = new batch_s();
+		recording_->ticket_ = 0;
+	}
+
+	return recording_;
+}
+
+void VkStreamer::SubmitBatch() {
+	if (!recording_) {
+		return;
+	}
+
+	// everything queued to the uploader so far, the demo's own uploads included
+	recording_->ticket_ = owner_->uploader_->Flush();
+
+	in_flight_.push_back(recording_);
+	recording_ = nullptr;
+}
+
+bool VkStreamer::RetireBatches(bool wait) {
+	VkUploader* uploader = owner_->uploader_;
+	bool retired = false;
+
+	// tickets complete in order
+	while (!in_flight_.empty()) {
+		batch_s* batch = in_flight_.front();
+
+		if (wait) {
+			uploader->Wait(batch->ticket_);
+		}
+		else if (!uploader->IsDone(batch->ticket_)) {
+			break;
+		}
+
+		in_flight_.erase(in_flight_.begin());
+
+		// the texture callbacks write descriptor sets the frames in flight may still read
+		if (!retired) {
+			owner_->WaitFramesInFlight();
+		}
+
+		CallBack(batch);
+		DestroyBatch(batch);
+		retired = true;
+	}
+
+	return retired;
+}
+
+void VkStreamer::CallBack(batch_s* batch) {
+	for (upload_s& upload : batch->uploads_) {
+		if (!upload.client_) {
+			continue;
+		}
+
+		if (upload.vk_image_.image_) {
+			upload.on_texture_(&upload.vk_image_);
+			memset(&upload.vk_image_, 0, sizeof(upload.vk_image_));	// owned by the callback
+		}
+		else if (upload.on_buffer_) {
+			upload.on_buffer_();
+		}
+		changed_ = true;
+	}
+}
+
+void VkStreamer::DestroyBatch(batch_s* batch) {
+	// textures whose callback did not take them
+	for (upload_s& upload : batch->uploads_) {
+		if (upload.vk_image_.image_) {
+			owner_->DestroyImage(upload.vk_image_);
+		}
+	}
+
+	delete batch;
+}
+
+bool VkStreamer::HandleFinishedJobs() {
+	std::vector<job_s*> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		finished.swap(finished_jobs_);
+	}
+
+	for (job_s* job : finished) {
+		if (job->type_ == job_type_t::MODEL) {
+			if (job->ok_) {
+				job->on_model_(&job->model_);
+				memset(&job->model_, 0, sizeof(job->model_));	// owned by the callback
+			}
+			else {
+				job->on_model_(nullptr);
+			}
+			changed_ = true;
+		}
+		else {
+			vk_image_s vk_image = {};
+
+			if (job->ok_ && owner_->Create2DTexture(job->image_, job->format_, VK_IMAGE_USAGE_SAMPLED_BIT,
+				job->sampler_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, vk_image, true))
+			{
+				GetRecordingBatch()->uploads_.push_back({ job->client_, vk_image, job->on_texture_, nullptr });
+			}
+			else {
+				job->on_texture_(nullptr);
+				changed_ = true;
+			}
+		}
+
+		FreeJob(job);
+	}
+
+	return !finished.empty();
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+ asset streaming
+ *****************************************************************************/
+
+#pragma once
+
+/*
+================================================================================
+VkStreamer
+
+  models and textures are decoded by jobs of the job pool, the uploads
+  queued in one frame go to the GPU as one submission of the uploader, the
+  callbacks run on the main thread from Pump once its ticket is done
+================================================================================
+*/
+class COMMON_API VkStreamer {
+public:
+
+	// the callback owns the model (Model_Free), nullptr if the file could not be loaded
+	typedef std::function<void(model_s* model)> model_loaded_t;
+	// the callback owns the texture (DestroyImage), nullptr if the file could not be loaded
+	typedef std::function<void(vk_image_s* vk_image)> texture_resident_t;
+	typedef std::function<void()> upload_done_t;
+
+	VkStreamer(VkDemo* owner);
+	~VkStreamer();
+
+	bool					Init();
+	void					Shutdown();
+
+	// requests are tagged by client, see Cancel
+	// filename: relative to the models folder
+	void					LoadModel(const void* client, const char* filename, bool move_to_origin,
+								const glm::mat4* transform, model_loaded_t on_loaded);
+	// filename: absolute or relative to the textures folder, R8G8B8A8 texture of Create2DTexture
+	void					LoadTexture(const void* client, const char* filename, VkFormat format,
+								VkSampler sampler, texture_resident_t on_resident);
+	// creates a device local buffer and copies data to it in the next submission, the buffer
+	// must not be used before on_done
+	bool					UploadBuffer(const void* client, vk_buffer_s& buffer, VkBufferUsageFlags usage,
+								const void* data, size_t data_size, upload_done_t on_done);
+
+	// 1x1 white, to sample until a texture is resident
+	const vk_image_s &		GetPlaceholderTexture() const;
+
+	// main thread, once a frame: hands finished work to the callbacks, submits the recorded uploads
+	// returns true if any callback ran (descriptor sets may have changed)
+	bool					Pump();
+	// decodes everything requested and runs the callbacks, the uploads stay queued: the next frame
+	// (or VkDemo::FlushUploads) submits them with the other uploads of the demo
+	void					Flush();
+	// drops the requests of client, waits for its uploads in flight, no callback of client runs afterwards,
+	// not to be called from a callback
+	void					Cancel(const void* client);
+	bool					IsIdle();
+
+private:
+
+	enum class job_type_t {
+		MODEL,
+		TEXTURE
+	};
+
+	struct job_s {
+		job_type_t			type_;
+		const void*			client_;
+		char				filename_[MAX_PATH];
+		// model
+		bool				move_to_origin_;
+		bool				has_transform_;
+		glm::mat4			transform_;
+		model_loaded_t		on_model_;
+		// texture
+		VkFormat			format_;
+		VkSampler			sampler_;
+		texture_resident_t	on_texture_;
+		// result
+		bool				cancelled_;		// not decoded, freed by the job
+		bool				ok_;
+		model_s				model_;
+		image_s				image_;
+	};
+
+	struct upload_s {
+		const void*			client_;		// nullptr: cancelled
+		vk_image_s			vk_image_;		// texture, or none for a buffer
+		texture_resident_t	on_texture_;
+		upload_done_t		on_buffer_;
+	};
+
+	struct batch_s {
+		uint64_t			ticket_;		// VkUploader::Flush
+		std::vector<upload_s>	uploads_;
+	};
+
+	VkDemo *				owner_;
+	vk_image_s				placeholder_;
+
+	// decoding
+	std::mutex				mutex_;
+	std::condition_variable	cv_done_;		// a job finished
+	std::atomic<uint32_t>	pending_;		// jobs on the pool
+	std::vector<job_s*>		running_jobs_;	// queued or being decoded
+	std::vector<job_s*>		finished_jobs_;
+
+	// uploads
+	batch_s *				recording_;
+	std::vector<batch_s*>	in_flight_;
+	bool					changed_;
+
+	void					QueueJob(job_s* job);
+	void					DecodeJob(job_s* job);
+	void					FreeJob(job_s* job);
+
+	batch_s *				GetRecordingBatch();
+	void					SubmitBatch();
+	bool					RetireBatches(bool wait);
+	void					CallBack(batch_s* batch);
+	void					DestroyBatch(batch_s* batch);
+	bool					HandleFinishedJobs();
+};
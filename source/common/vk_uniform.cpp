@@ -0,0 +1,99 @@
+/******************************************************************************
+ per frame uniforms
+ *****************************************************************************/
+
+#include "inc.h"
+
+/*
+================================================================================
+VkUniformRing
+================================================================================
+*/
+VkUniformRing::VkUniformRing(VkDemo * owner):
+	owner_(owner),
+	data_(nullptr),
+	copy_size_(0),
+	copy_count_(0),
+	used_(0)
+{
+	memset(&buffer_, 0, sizeof(buffer_));
+}
+
+VkUniformRing::~VkUniformRing() {
+	// do nothing
+}
+
+bool VkUniformRing::Init(VkDeviceSize copy_size) {
+	copy_size_ = owner_->GetAlignedMinOffsetSize((size_t)copy_size);
+	used_ = 0;
+
+	return CreateCopies();
+}
+
+void VkUniformRing::Shutdown() {
+	owner_->DestroyBuffer(buffer_);
+	data_ = nullptr;
+	copy_size_ = 0;
+	copy_count_ = 0;
+	used_ = 0;
+}
+
+bool VkUniformRing::Resize() {
+	owner_->DestroyBuffer(buffer_);
+	data_ = nullptr;
+
+	return CreateCopies();
+}
+
+bool VkUniformRing::CreateCopies() {
+	copy_count_ = (uint32_t)owner_->vk_swapchain_image_count_;
+
+	// coherent: a memcpy is all a frame costs, no flush
+	if (!owner_->CreateBuffer(buffer_, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		copy_size_ * copy_count_)) {
+		return false;
+	}
+
+	data_ = (byte_t*)owner_->MapBuffer(buffer_);
+	if (!data_) {
+		owner_->DestroyBuffer(buffer_);
+		return false;
+	}
+
+	// a range nobody wrote yet reads zeros
+	memset(data_, 0, copy_size_ * copy_count_);
+
+	return true;
+}
+
+uint32_t VkUniformRing::Alloc(VkDeviceSize size) {
+	VkDeviceSize aligned_size = owner_->GetAlignedMinOffsetSize((size_t)size);
+
+	if (used_ + aligned_size > copy_size_) {
+		printf("VkUniformRing: %u of %u bytes used, no room for %u\n",
+			(uint32_t)used_, (uint32_t)copy_size_, (uint32_t)size);
+		return VK_INVALID_INDEX;
+	}
+
+	uint32_t range_offset = (uint32_t)used_;
+	used_ += aligned_size;
+
+	return range_offset;
+}
+
+VkBuffer VkUniformRing::GetBuffer() const {
+	return buffer_.buffer_;
+}
+
+uint32_t VkUniformRing::GetDynamicOffset(uint32_t range_offset, uint32_t image) const {
+	return (uint32_t)(copy_size_ * image) + range_offset;
+}
+
+void * VkUniformRing::GetFrameData(uint32_t range_offset) const {
+	return data_ + GetDynamicOffset(range_offset, owner_->vk_current_image_);
+}
+
+void VkUniformRing::Write(uint32_t range_offset, const void * data, size_t size) const {
+	memcpy(GetFrameData(range_offset), data, size);
+}
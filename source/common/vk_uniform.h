@@ -0,0 +1,55 @@
+/******************************************************************************
+ per frame uniforms
+ *****************************************************************************/
+
+#pragma once
+
+/*
+================================================================================
+VkUniformRing
+
+  the uniforms a demo rewrites every frame, in one persistently mapped buffer
+  with a copy per swapchain image: Update memcpys into the copy of
+  vk_current_image_ while the GPU still reads the others. The ranges are bound
+  as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, the command buffer of each image
+  passes the dynamic offsets of its copy
+================================================================================
+*/
+class COMMON_API VkUniformRing {
+public:
+
+	VkUniformRing(VkDemo * owner);
+	~VkUniformRing();
+
+	// after the swapchain is created, copy_size: the ranges of Alloc, alignment included
+	bool					Init(VkDeviceSize copy_size);
+	void					Shutdown();
+	// a copy per image of the swapchain of a resize, the ranges stay,
+	// GetBuffer changes: the descriptor sets on it are to be written again
+	bool					Resize();
+
+	// a range of size bytes in every copy, aligned to minUniformBufferOffsetAlignment,
+	// returns its offset in a copy, VK_INVALID_INDEX if the copy is full
+	uint32_t				Alloc(VkDeviceSize size);
+
+	// the descriptors take offset 0 and the size of the range
+	VkBuffer				GetBuffer() const;
+	// for vkCmdBindDescriptorSets of the command buffer of image
+	uint32_t				GetDynamicOffset(uint32_t range_offset, uint32_t image) const;
+
+	// the range in the copy of the frame being updated
+	void *					GetFrameData(uint32_t range_offset) const;
+	void					Write(uint32_t range_offset, const void * data, size_t size) const;
+
+private:
+
+	VkDemo *				owner_;
+
+	vk_buffer_s				buffer_;
+	byte_t *				data_;
+	VkDeviceSize			copy_size_;
+	uint32_t				copy_count_;
+	VkDeviceSize			used_;				// of each copy, by Alloc
+
+	bool					CreateCopies();
+};
@@ -0,0 +1,737 @@
+/******************************************************************************
+ staged uploads
+ *****************************************************************************/
+
+#include "inc.h"
+
+/*
+================================================================================
+helper
+================================================================================
+*/
+// bufferOffset of an image region: a multiple of 4 and of the texel block size
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// image_memory_barrier: in/out
+static void SetAccessMaskOfImageMemoryBarrier(VkImageMemoryBarrier & image_memory_barrier) {
+	image_memory_barrier.srcAccessMask = 0;
+	image_memory_barrier.dstAccessMask = 0;
+
+	switch (image_memory_barrier.oldLayout) {
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+		image_memory_barrier.srcAccessMask = 0;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		image_memory_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	default:
+		printf("Not processed old image layout %d\n", (int)image_memory_barrier.oldLayout);
+		break;
+	}
+
+	switch (image_memory_barrier.newLayout) {
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		if (image_memory_barrier.srcAccessMask == 0) {
+			image_memory_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	default:
+		printf("Not processed new image layout %d\n", (int)image_memory_barrier.newLayout);
+		break;
+	}
+}
+
+/*
+================================================================================
+VkUploader
+================================================================================
+*/
+VkUploader::VkUploader(VkDemo* owner):
+	owner_(owner),
+	transfer_queue_(VK_NULL_HANDLE),
+	transfer_queue_family_(VK_INVALID_INDEX),
+	graphics_command_pool_(VK_NULL_HANDLE),
+	transfer_command_pool_(VK_NULL_HANDLE),
+	ring_data_(nullptr),
+	ring_size_(0),
+	ring_head_(0),
+	ring_tail_(0),
+	last_ticket_(0),
+	done_ticket_(0)
+{
+	memset(&ring_, 0, sizeof(ring_));
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+VkUploader::~VkUploader() {
+	Shutdown();
+}
+
+bool VkUploader::Init(VkDeviceSize ring_size) {
+	Shutdown();
+
+	VkDevice device = owner_->vk_device_;
+
+	auto CreateCommandPool = [device](uint32_t queue_family, VkCommandPool& command_pool) -> bool {
+		VkCommandPoolCreateInfo command_pool_create_info = {};
+
+		command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		command_pool_create_info.pNext = nullptr;
+		command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		command_pool_create_info.queueFamilyIndex = queue_family;
+
+		return VK_SUCCESS == vkCreateCommandPool(device, &command_pool_create_info, nullptr, &command_pool);
+	};
+
+	if (!CreateCommandPool(owner_->vk_physical_device_graphics_queue_family_index_, graphics_command_pool_)) {
+		return false;
+	}
+
+	if (owner_->vk_transfer_queue_) {
+		transfer_queue_ = owner_->vk_transfer_queue_;
+		transfer_queue_family_ = owner_->vk_physical_device_transfer_queue_family_index_;
+
+		if (!CreateCommandPool(transfer_queue_family_, transfer_command_pool_)) {
+			return false;
+		}
+	}
+
+	ring_size_ = (ring_size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+	if (!owner_->CreateBuffer(ring_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ring_size_))
+	{
+		owner_->DestroyBuffer(ring_);
+		printf("VkUploader: could not allocate the staging ring\n");
+		return false;
+	}
+
+	ring_data_ = (byte_t*)owner_->MapBuffer(ring_);
+
+	return ring_data_ != nullptr;
+}
+
+void VkUploader::Shutdown() {
+	// what is still queued is dropped, its destinations are about to be destroyed
+	buffer_copies_.clear();
+	image_uploads_.clear();
+	image_regions_.clear();
+
+	for (vk_buffer_s& staging : oversize_staging_) {
+		owner_->DestroyBuffer(staging);
+	}
+	oversize_staging_.clear();
+
+	while (RetireOldest(true)) {
+	}
+
+	if (ring_.buffer_) {
+		owner_->DestroyBuffer(ring_);
+	}
+
+	ring_data_ = nullptr;
+	ring_size_ = 0;
+	ring_head_ = 0;
+	ring_tail_ = 0;
+
+	VkDevice device = owner_->vk_device_;
+
+	if (graphics_command_pool_) {
+		vkDestroyCommandPool(device, graphics_command_pool_, nullptr);
+		graphics_command_pool_ = VK_NULL_HANDLE;
+	}
+
+	if (transfer_command_pool_) {
+		vkDestroyCommandPool(device, transfer_command_pool_, nullptr);
+		transfer_command_pool_ = VK_NULL_HANDLE;
+	}
+
+	transfer_queue_ = VK_NULL_HANDLE;
+	transfer_queue_family_ = VK_INVALID_INDEX;
+}
+
+void* VkUploader::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	VkBuffer src = VK_NULL_HANDLE;
+	VkDeviceSize src_offset = 0;
+
+	byte_t* data = Stage(size, src, src_offset);
+	if (!data) {
+		return nullptr;
+	}
+
+	buffer_copy_s copy = {};
+
+	copy.src_ = src;
+	copy.dst_ = buffer;
+	copy.region_.srcOffset = src_offset;
+	copy.region_.dstOffset = offset;
+	copy.region_.size = size;
+
+	buffer_copies_.push_back(copy);
+
+	return data;
+}
+
+void* VkUploader::UploadImage(const vk_image_s& vk_image, uint32_t layer_count, VkDeviceSize size,
+	const VkBufferImageCopy* copies, uint32_t copy_count, bool gpu_mipmaps)
+{
+	VkBuffer src = VK_NULL_HANDLE;
+	VkDeviceSize src_offset = 0;
+
+	byte_t* data = Stage(size, src, src_offset);
+	if (!data) {
+		return nullptr;
+	}
+
+	image_upload_s upload = {};
+
+	upload.src_ = src;
+	upload.image_ = vk_image.image_;
+	upload.width_ = vk_image.width_;
+	upload.height_ = vk_image.height_;
+	upload.mip_levels_ = vk_image.mip_levels_ > 1 ? vk_image.mip_levels_ : 1;
+	upload.layer_count_ = layer_count;
+	upload.layout_ = vk_image.desc_image_info_.imageLayout;
+	upload.gpu_mipmaps_ = gpu_mipmaps && upload.mip_levels_ > 1;
+	upload.first_region_ = (uint32_t)image_regions_.size();
+	upload.region_count_ = copy_count;
+
+	for (uint32_t i = 0; i < copy_count; ++i) {
+		VkBufferImageCopy region = copies[i];
+		region.bufferOffset += src_offset;
+		image_regions_.push_back(region);
+	}
+
+	image_uploads_.push_back(upload);
+
+	return data;
+}
+
+uint64_t VkUploader::Flush() {
+	if (!HasQueued()) {
+		return last_ticket_;
+	}
+
+	VkDevice device = owner_->vk_device_;
+
+	batch_s* batch = new batch_s();
+
+	batch->ticket_ = ++last_ticket_;
+	batch->transfer_cmd_buffer_ = VK_NULL_HANDLE;
+	batch->graphics_cmd_buffer_ = VK_NULL_HANDLE;
+	batch->copied_ = VK_NULL_HANDLE;
+	batch->fence_ = VK_NULL_HANDLE;
+	batch->ring_head_ = ring_head_;
+	batch->oversize_staging_.swap(oversize_staging_);
+
+	auto BeginCommandBuffer = [device](VkCommandPool command_pool, VkCommandBuffer& cmd_buffer) -> bool {
+		VkCommandBufferAllocateInfo cmd_buffer_alloc_info = {};
+
+		cmd_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmd_buffer_alloc_info.pNext = nullptr;
+		cmd_buffer_alloc_info.commandPool = command_pool;
+		cmd_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmd_buffer_alloc_info.commandBufferCount = 1;
+
+		if (VK_SUCCESS != vkAllocateCommandBuffers(device, &cmd_buffer_alloc_info, &cmd_buffer)) {
+			cmd_buffer = VK_NULL_HANDLE;
+			return false;
+		}
+
+		VkCommandBufferBeginInfo cmdbuf_begin_info = {};
+
+		cmdbuf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		cmdbuf_begin_info.pNext = nullptr;
+		cmdbuf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		cmdbuf_begin_info.pInheritanceInfo = nullptr;
+
+		return VK_SUCCESS == vkBeginCommandBuffer(cmd_buffer, &cmdbuf_begin_info);
+	};
+
+	bool ok = BeginCommandBuffer(graphics_command_pool_, batch->graphics_cmd_buffer_);
+	if (ok && transfer_queue_) {
+		ok = BeginCommandBuffer(transfer_command_pool_, batch->transfer_cmd_buffer_);
+	}
+
+	if (ok) {
+		if (transfer_queue_) {
+			// the copies run on the transfer queue, the graphics queue takes the resources over,
+			// then blits the mip levels
+			RecordCopies(batch->transfer_cmd_buffer_);
+			RecordOwnershipTransfer(batch->transfer_cmd_buffer_, true);
+			RecordOwnershipTransfer(batch->graphics_cmd_buffer_, false);
+			RecordFinalLayouts(batch->graphics_cmd_buffer_, true);
+		}
+		else {
+			RecordCopies(batch->graphics_cmd_buffer_);
+			RecordFinalLayouts(batch->graphics_cmd_buffer_, false);
+		}
+
+		ok = VK_SUCCESS == vkEndCommandBuffer(batch->graphics_cmd_buffer_);
+		if (ok && transfer_queue_) {
+			ok = VK_SUCCESS == vkEndCommandBuffer(batch->transfer_cmd_buffer_);
+		}
+	}
+
+	if (ok) {
+		VkFenceCreateInfo fence_create_info = {};
+
+		fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fence_create_info.pNext = nullptr;
+		fence_create_info.flags = 0;
+
+		ok = VK_SUCCESS == vkCreateFence(device, &fence_create_info, nullptr, &batch->fence_);
+	}
+
+	if (ok && transfer_queue_) {
+		VkSemaphoreCreateInfo semaphore_create_info = {};
+
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphore_create_info.pNext = nullptr;
+		semaphore_create_info.flags = 0;
+
+		ok = VK_SUCCESS == vkCreateSemaphore(device, &semaphore_create_info, nullptr, &batch->copied_);
+
+		if (ok) {
+			VkSubmitInfo submit_info = {};
+
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.pNext = nullptr;
+			submit_info.waitSemaphoreCount = 0;
+			submit_info.pWaitSemaphores = nullptr;
+			submit_info.pWaitDstStageMask = nullptr;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &batch->transfer_cmd_buffer_;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &batch->copied_;
+
+			ok = VK_SUCCESS == vkQueueSubmit(transfer_queue_, 1, &submit_info, VK_NULL_HANDLE);
+		}
+	}
+
+	if (ok) {
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo submit_info = {};
+
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = nullptr;
+		submit_info.waitSemaphoreCount = batch->copied_ ? 1 : 0;
+		submit_info.pWaitSemaphores = &batch->copied_;
+		submit_info.pWaitDstStageMask = &wait_stage;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &batch->graphics_cmd_buffer_;
+		submit_info.signalSemaphoreCount = 0;
+		submit_info.pSignalSemaphores = nullptr;
+
+		ok = VK_SUCCESS == vkQueueSubmit(owner_->vk_graphics_queue_, 1, &submit_info, batch->fence_);
+	}
+
+	stats_.buffer_copies_ += (uint32_t)buffer_copies_.size();
+	stats_.image_copies_ += (uint32_t)image_uploads_.size();
+
+	buffer_copies_.clear();
+	image_uploads_.clear();
+	image_regions_.clear();
+
+	if (!ok) {
+		printf("VkUploader: could not submit the uploads\n");
+
+		// the transfer half may be on its way, nothing of the batch is in use once the device is idle
+		vkDeviceWaitIdle(device);
+		while (RetireOldest(true)) {
+		}
+
+		DestroyBatch(batch);
+		ring_tail_ = ring_head_;
+		done_ticket_ = last_ticket_;
+
+		return last_ticket_;
+	}
+
+	stats_.submits_++;
+	in_flight_.push_back(batch);
+
+	return batch->ticket_;
+}
+
+bool VkUploader::IsDone(uint64_t ticket) {
+	while (RetireOldest(false)) {
+	}
+
+	return done_ticket_ >= ticket;
+}
+
+void VkUploader::Wait(uint64_t ticket) {
+	while (done_ticket_ < ticket && RetireOldest(true)) {
+	}
+}
+
+void VkUploader::FlushAndWait() {
+	Wait(Flush());
+}
+
+bool VkUploader::HasQueued() const {
+	return !buffer_copies_.empty() || !image_uploads_.empty();
+}
+
+bool VkUploader::HasTransferQueue() const {
+	return transfer_queue_ != VK_NULL_HANDLE;
+}
+
+const vk_upload_stats_s& VkUploader::GetStats() const {
+	return stats_;
+}
+
+byte_t* VkUploader::Stage(VkDeviceSize size, VkBuffer& src, VkDeviceSize& src_offset) {
+	size = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+	stats_.staged_bytes_ += size;
+
+	// would hold most of the ring on its own: a staging buffer of its own, destroyed with its batch
+	if (size > ring_size_ / 2) {
+		vk_buffer_s staging = {};
+		if (!owner_->CreateBuffer(staging, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size))
+		{
+			owner_->DestroyBuffer(staging);
+			printf("VkUploader: could not allocate %llu bytes of staging memory\n", (unsigned long long)size);
+			return nullptr;
+		}
+
+		oversize_staging_.push_back(staging);
+
+		src = staging.buffer_;
+		src_offset = 0;
+
+		return (byte_t*)owner_->MapBuffer(staging);
+	}
+
+	while (true) {
+		uint64_t head = ring_head_;
+
+		// a region never wraps, the end of the ring is skipped instead
+		VkDeviceSize in_ring = head % ring_size_;
+		if (in_ring + size > ring_size_) {
+			head += ring_size_ - in_ring;
+		}
+
+		if (head + size - ring_tail_ <= ring_size_) {
+			ring_head_ = head + size;
+
+			src = ring_.buffer_;
+			src_offset = head % ring_size_;
+
+			return ring_data_ + src_offset;
+		}
+
+		// full: what is queued goes now, the oldest submission gives its space back
+		stats_.ring_stalls_++;
+
+		Flush();
+
+		if (in_flight_.empty()) {
+			ring_tail_ = ring_head_;	// nothing reads the ring
+		}
+		else if (!RetireOldest(true)) {
+			printf("VkUploader: staging ring stalled\n");
+			return nullptr;
+		}
+	}
+}
+
+void VkUploader::RecordCopies(VkCommandBuffer cmd_buffer) {
+	// every subresource is overwritten, the old contents (if any) are discarded
+	if (!image_uploads_.empty()) {
+		std::vector<VkImageMemoryBarrier> image_memory_barriers(image_uploads_.size());
+
+		for (size_t i = 0; i < image_uploads_.size(); ++i) {
+			const image_upload_s& upload = image_uploads_[i];
+			VkImageMemoryBarrier& image_memory_barrier = image_memory_barriers[i];
+
+			image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			image_memory_barrier.pNext = nullptr;
+			image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_memory_barrier.image = upload.image_;
+			image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			image_memory_barrier.subresourceRange.baseMipLevel = 0;
+			image_memory_barrier.subresourceRange.levelCount = upload.mip_levels_;
+			image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+			image_memory_barrier.subresourceRange.layerCount = upload.layer_count_;
+			SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
+		}
+
+		vkCmdPipelineBarrier(cmd_buffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0 /* dependencyFlags */,
+			0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
+			0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
+			(uint32_t)image_memory_barriers.size(), image_memory_barriers.data());
+	}
+
+	for (const buffer_copy_s& copy : buffer_copies_) {
+		vkCmdCopyBuffer(cmd_buffer, copy.src_, copy.dst_, 1, &copy.region_);
+	}
+
+	for (const image_upload_s& upload : image_uploads_) {
+		vkCmdCopyBufferToImage(
+			cmd_buffer,
+			upload.src_,
+			upload.image_,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			upload.region_count_,
+			image_regions_.data() + upload.first_region_);
+	}
+}
+
+void VkUploader::RecordOwnershipTransfer(VkCommandBuffer cmd_buffer, bool release) {
+	// release on the transfer queue, acquire on the graphics queue: the same barriers on both sides,
+	// the images take their final layout on the way, unless their levels are still to be blitted
+	uint32_t graphics_queue_family = owner_->vk_physical_device_graphics_queue_family_index_;
+
+	std::vector<VkBufferMemoryBarrier> buffer_memory_barriers(buffer_copies_.size());
+
+	for (size_t i = 0; i < buffer_copies_.size(); ++i) {
+		const buffer_copy_s& copy = buffer_copies_[i];
+		VkBufferMemoryBarrier& buffer_memory_barrier = buffer_memory_barriers[i];
+
+		buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		buffer_memory_barrier.pNext = nullptr;
+		buffer_memory_barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+		buffer_memory_barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+		buffer_memory_barrier.srcQueueFamilyIndex = transfer_queue_family_;
+		buffer_memory_barrier.dstQueueFamilyIndex = graphics_queue_family;
+		buffer_memory_barrier.buffer = copy.dst_;
+		buffer_memory_barrier.offset = copy.region_.dstOffset;
+		buffer_memory_barrier.size = copy.region_.size;
+	}
+
+	std::vector<VkImageMemoryBarrier> image_memory_barriers(image_uploads_.size());
+
+	for (size_t i = 0; i < image_uploads_.size(); ++i) {
+		const image_upload_s& upload = image_uploads_[i];
+		VkImageMemoryBarrier& image_memory_barrier = image_memory_barriers[i];
+
+		image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		image_memory_barrier.pNext = nullptr;
+		image_memory_barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+		image_memory_barrier.dstAccessMask = release ? 0
+			: (upload.gpu_mipmaps_ ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_MEMORY_READ_BIT);
+		image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		image_memory_barrier.newLayout = upload.gpu_mipmaps_ ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : upload.layout_;
+		image_memory_barrier.srcQueueFamilyIndex = transfer_queue_family_;
+		image_memory_barrier.dstQueueFamilyIndex = graphics_queue_family;
+		image_memory_barrier.image = upload.image_;
+		image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		image_memory_barrier.subresourceRange.baseMipLevel = 0;
+		image_memory_barrier.subresourceRange.levelCount = upload.mip_levels_;
+		image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+		image_memory_barrier.subresourceRange.layerCount = upload.layer_count_;
+	}
+
+	// the acquire waits for the semaphore the transfer queue signals
+	vkCmdPipelineBarrier(cmd_buffer,
+		release ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0 /* dependencyFlags */,
+		0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
+		(uint32_t)buffer_memory_barriers.size(), buffer_memory_barriers.data(),
+		(uint32_t)image_memory_barriers.size(), image_memory_barriers.data());
+}
+
+void VkUploader::RecordFinalLayouts(VkCommandBuffer cmd_buffer, bool acquired) {
+	if (!acquired) {
+		// everything copied is visible to whatever reads it next
+		VkMemoryBarrier memory_barrier = {};
+
+		memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memory_barrier.pNext = nullptr;
+		memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memory_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+		std::vector<VkImageMemoryBarrier> image_memory_barriers;
+		image_memory_barriers.reserve(image_uploads_.size());
+
+		for (const image_upload_s& upload : image_uploads_) {
+			if (upload.gpu_mipmaps_) {
+				continue;
+			}
+
+			VkImageMemoryBarrier image_memory_barrier = {};
+
+			image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			image_memory_barrier.pNext = nullptr;
+			image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			image_memory_barrier.newLayout = upload.layout_;
+			image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_memory_barrier.image = upload.image_;
+			image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			image_memory_barrier.subresourceRange.baseMipLevel = 0;
+			image_memory_barrier.subresourceRange.levelCount = upload.mip_levels_;
+			image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+			image_memory_barrier.subresourceRange.layerCount = upload.layer_count_;
+			SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
+
+			image_memory_barriers.push_back(image_memory_barrier);
+		}
+
+		vkCmdPipelineBarrier(cmd_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0 /* dependencyFlags */,
+			buffer_copies_.empty() ? 0 : 1, &memory_barrier,
+			0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
+			(uint32_t)image_memory_barriers.size(), image_memory_barriers.data());
+	}
+
+	for (const image_upload_s& upload : image_uploads_) {
+		if (upload.gpu_mipmaps_) {
+			RecordMipmaps(cmd_buffer, upload);
+		}
+	}
+}
+
+void VkUploader::RecordMipmaps(VkCommandBuffer cmd_buffer, const image_upload_s& upload) {
+	// each level is blitted from the one above, which turns into a transfer source first
+	VkImageMemoryBarrier image_memory_barrier = {};
+
+	image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_memory_barrier.pNext = nullptr;
+	image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_memory_barrier.image = upload.image_;
+	image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_memory_barrier.subresourceRange.levelCount = 1;
+	image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+	image_memory_barrier.subresourceRange.layerCount = upload.layer_count_;
+
+	for (uint32_t level = 1; level < upload.mip_levels_; ++level) {
+		image_memory_barrier.subresourceRange.baseMipLevel = level - 1;
+		image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		SetAccessMaskOfImageMemoryBarrier(image_memory_barrier);
+
+		vkCmdPipelineBarrier(cmd_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0 /* dependencyFlags */,
+			0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
+			0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
+			1, &image_memory_barrier);
+
+		int32_t src_w = (int32_t)((upload.width_ >> (level - 1)) > 0 ? (upload.width_ >> (level - 1)) : 1);
+		int32_t src_h = (int32_t)((upload.height_ >> (level - 1)) > 0 ? (upload.height_ >> (level - 1)) : 1);
+		int32_t dst_w = src_w > 1 ? src_w / 2 : 1;
+		int32_t dst_h = src_h > 1 ? src_h / 2 : 1;
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = upload.layer_count_;
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { src_w, src_h, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = upload.layer_count_;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { dst_w, dst_h, 1 };
+
+		vkCmdBlitImage(cmd_buffer,
+			upload.image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			upload.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+	}
+
+	// levels 0 ~ n-2 are transfer sources now, the last one is still a destination
+	VkImageMemoryBarrier image_memory_barriers[2] = { image_memory_barrier, image_memory_barrier };
+
+	image_memory_barriers[0].subresourceRange.baseMipLevel = 0;
+	image_memory_barriers[0].subresourceRange.levelCount = upload.mip_levels_ - 1;
+	image_memory_barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	image_memory_barriers[0].newLayout = upload.layout_;
+	SetAccessMaskOfImageMemoryBarrier(image_memory_barriers[0]);
+
+	image_memory_barriers[1].subresourceRange.baseMipLevel = upload.mip_levels_ - 1;
+	image_memory_barriers[1].subresourceRange.levelCount = 1;
+	image_memory_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	image_memory_barriers[1].newLayout = upload.layout_;
+	SetAccessMaskOfImageMemoryBarrier(image_memory_barriers[1]);
+
+	vkCmdPipelineBarrier(cmd_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0 /* dependencyFlags */,
+		0 /* memoryBarrierCount */, nullptr /* pMemoryBarriers */,
+		0 /* bufferMemoryBarrierCount */, nullptr /* pBufferMemoryBarries */,
+		2, image_memory_barriers);
+}
+
+bool VkUploader::RetireOldest(bool wait) {
+	if (in_flight_.empty()) {
+		return false;
+	}
+
+	VkDevice device = owner_->vk_device_;
+	batch_s* batch = in_flight_.front();
+
+	VkResult rt = wait ? vkWaitForFences(device, 1, &batch->fence_, VK_TRUE, UINT64_MAX)
+		: vkGetFenceStatus(device, batch->fence_);
+	if (rt != VK_SUCCESS) {
+		return false;
+	}
+
+	in_flight_.pop_front();
+
+	ring_tail_ = batch->ring_head_;
+	done_ticket_ = batch->ticket_;
+
+	DestroyBatch(batch);
+
+	return true;
+}
+
+void VkUploader::DestroyBatch(batch_s* batch) {
+	VkDevice device = owner_->vk_device_;
+
+	for (vk_buffer_s& staging : batch->oversize_staging_) {
+		owner_->DestroyBuffer(staging);
+	}
+
+	if (batch->fence_) {
+		vkDestroyFence(device, batch->fence_, nullptr);
+	}
+
+	if (batch->copied_) {
+		vkDestroySemaphore(device, batch->copied_, nullptr);
+	}
+
+	if (batch->graphics_cmd_buffer_) {
+		vkFreeCommandBuffers(device, graphics_command_pool_, 1, &batch->graphics_cmd_buffer_);
+	}
+
+	if (batch->transfer_cmd_buffer_) {
+		vkFreeCommandBuffers(device, transfer_command_pool_, 1, &batch->transfer_cmd_buffer_);
+	}
+
+	delete batch;
+}
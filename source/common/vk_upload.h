@@ -0,0 +1,121 @@
+/******************************************************************************
+ staged uploads
+ *****************************************************************************/
+
+#pragma once
+
+/*
+================================================================================
+VkUploader
+
+  buffer and image uploads are staged in a persistent, mapped ring buffer and
+  only recorded by Flush: everything queued in between goes to the GPU as one
+  submission with one fence, on a dedicated transfer queue when the device has
+  one, the graphics queue then takes the resources over
+================================================================================
+*/
+struct vk_upload_stats_s {
+	uint32_t				submits_;
+	uint32_t				buffer_copies_;
+	uint32_t				image_copies_;		// images, not regions
+	uint64_t				staged_bytes_;
+	uint32_t				ring_stalls_;		// the ring was full, Flush waited for an earlier submission
+};
+
+class COMMON_API VkUploader {
+public:
+
+	VkUploader(VkDemo* owner);
+	~VkUploader();
+
+	bool					Init(VkDeviceSize ring_size);
+	// waits for the submissions in flight
+	void					Shutdown();
+
+	// the pointers returned are where the caller writes the data to before the next call of the uploader,
+	// nullptr on failure. the destination must not be used before the ticket of the Flush that covers it
+	// is done, nor destroyed before that Flush
+
+	// size bytes for [offset, offset + size) of buffer, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	void *					UploadBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+	// size bytes of texels for the regions of copies, their bufferOffset relative to the returned pointer;
+	// the image goes from undefined to desc_image_info_.imageLayout, its old contents are discarded
+	// gpu_mipmaps: the regions are level 0 only, levels 1 ~ mip_levels_ - 1 are blitted from it
+	void *					UploadImage(const vk_image_s& vk_image, uint32_t layer_count, VkDeviceSize size,
+								const VkBufferImageCopy* copies, uint32_t copy_count, bool gpu_mipmaps);
+
+	// records and submits what is queued, returns its ticket, the ticket of the last submission if nothing is queued
+	uint64_t				Flush();
+	bool					IsDone(uint64_t ticket);
+	void					Wait(uint64_t ticket);
+	void					FlushAndWait();
+	bool					HasQueued() const;
+
+	bool					HasTransferQueue() const;
+	const vk_upload_stats_s &	GetStats() const;
+
+private:
+
+	struct buffer_copy_s {
+		VkBuffer			src_;
+		VkBuffer			dst_;
+		VkBufferCopy		region_;
+	};
+
+	struct image_upload_s {
+		VkBuffer			src_;
+		VkImage				image_;
+		uint32_t			width_;
+		uint32_t			height_;
+		uint32_t			mip_levels_;
+		uint32_t			layer_count_;
+		VkImageLayout		layout_;
+		bool				gpu_mipmaps_;
+		uint32_t			first_region_;		// image_regions_
+		uint32_t			region_count_;
+	};
+
+	struct batch_s {
+		uint64_t			ticket_;
+		VkCommandBuffer		transfer_cmd_buffer_;	// VK_NULL_HANDLE without a transfer queue
+		VkCommandBuffer		graphics_cmd_buffer_;
+		VkSemaphore			copied_;				// transfer -> graphics queue
+		VkFence				fence_;
+		uint64_t			ring_head_;				// the ring is free up to here once the fence is signaled
+		std::vector<vk_buffer_s>	oversize_staging_;
+	};
+
+	VkDemo *				owner_;
+
+	VkQueue					transfer_queue_;		// VK_NULL_HANDLE: everything on the graphics queue
+	uint32_t				transfer_queue_family_;
+	VkCommandPool			graphics_command_pool_;
+	VkCommandPool			transfer_command_pool_;
+
+	// staging ring, head_ and tail_ count bytes since Init, the offset in the ring is % ring_size_
+	vk_buffer_s				ring_;
+	byte_t *				ring_data_;
+	VkDeviceSize			ring_size_;
+	uint64_t				ring_head_;
+	uint64_t				ring_tail_;
+
+	// queued
+	std::vector<buffer_copy_s>	buffer_copies_;
+	std::vector<image_upload_s>	image_uploads_;
+	std::vector<VkBufferImageCopy>	image_regions_;
+	std::vector<vk_buffer_s>	oversize_staging_;	// uploads larger than half the ring
+
+	std::deque<batch_s*>	in_flight_;				// in submission order
+	uint64_t				last_ticket_;
+	uint64_t				done_ticket_;
+
+	vk_upload_stats_s		stats_;
+
+	byte_t *				Stage(VkDeviceSize size, VkBuffer& src, VkDeviceSize& src_offset);
+	void					RecordCopies(VkCommandBuffer cmd_buffer);
+	void					RecordOwnershipTransfer(VkCommandBuffer cmd_buffer, bool release);
+	void					RecordFinalLayouts(VkCommandBuffer cmd_buffer, bool acquired);
+	void					RecordMipmaps(VkCommandBuffer cmd_buffer, const image_upload_s& upload);
+	bool					RetireOldest(bool wait);
+	void					DestroyBatch(batch_s* batch);
+};
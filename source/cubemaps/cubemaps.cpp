@@ -15,7 +15,6 @@ CubeMapsDemo::CubeMapsDemo():
 	vk_sampler_scene_(VK_NULL_HANDLE),
 	model_(this),
 	vk_desc_set_layout_mvp_cubemap_(VK_NULL_HANDLE),
-	vk_desc_set_mvp_cubemap_(VK_NULL_HANDLE),
 	vk_pipeline_layout_skybox_(VK_NULL_HANDLE),
 	vk_pipeline_layout_model_(VK_NULL_HANDLE),
 	vk_pipeline_skybox_(VK_NULL_HANDLE),
@@ -26,9 +25,12 @@ CubeMapsDemo::CubeMapsDemo():
 	memset(&point_light_, 0, sizeof(point_light_));
 	
 	// ubo
-	memset(&ubo_mvp_, 0, sizeof(ubo_mvp_));
+	cfg_frame_uniform_copies_ = true;
+
+	memset(ubo_mvp_, 0, sizeof(ubo_mvp_));
 	memset(&ubo_light_, 0, sizeof(ubo_light_));
-	memset(&ubo_viewer_, 0, sizeof(ubo_viewer_));
+	memset(ubo_viewer_, 0, sizeof(ubo_viewer_));
+	memset(vk_desc_sets_mvp_cubemap_, 0, sizeof(vk_desc_sets_mvp_cubemap_));
 
 	// vbo
 	memset(&vbo_box_, 0, sizeof(vbo_box_));
@@ -41,7 +43,7 @@ CubeMapsDemo::~CubeMapsDemo() {
 
 bool CubeMapsDemo::Init() {
 	if (!VkDemo::Init("cubemaps" /* shader files directory */,
-		64, 0, 16, 64)) {
+		64, 0, 16 + MAX_SWAPCHAIN_IMAGES, 64)) {
 		return false;
 	}
 
@@ -202,7 +204,7 @@ void CubeMapsDemo::BuildCommandBuffers() {
 
 		{	// skybox
 
-			VkDescriptorSet descriptor_sets[1] = { vk_desc_set_mvp_cubemap_ };
+			VkDescriptorSet descriptor_sets[1] = { vk_desc_sets_mvp_cubemap_[i] };
 
 			vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 				vk_pipeline_layout_skybox_, 0, 1, descriptor_sets, 0, nullptr);
@@ -224,7 +226,7 @@ void CubeMapsDemo::BuildCommandBuffers() {
 
 		{
 			// model
-			VkDescriptorSet descriptor_sets[1] = { vk_desc_set_mvp_cubemap_ };
+			VkDescriptorSet descriptor_sets[1] = { vk_desc_sets_mvp_cubemap_[i] };
 
 			vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 				vk_pipeline_layout_model_, 0, 1, descriptor_sets, 0, nullptr);
@@ -257,6 +259,14 @@ void CubeMapsDemo::WindowSizeChanged() {
 	//
 }
 
+bool CubeMapsDemo::SwapchainImageCountChanged() {
+	// the descriptor sets are all per image, the light is kept
+	FreeDescriptorSets();
+	DestroyImageUniformBuffers();
+
+	return CreateImageUniformBuffers() && AllocDescriptorSets();
+}
+
 void CubeMapsDemo::Update() {
 	{
 		ubo_mvp_sep_s ubo_mvp = {};
@@ -265,7 +275,7 @@ void CubeMapsDemo::Update() {
 		GetViewMatrix(ubo_mvp.view_);
 		GetModelMatrix(ubo_mvp.model_);
 
-		UpdateBuffer(ubo_mvp_, &ubo_mvp, sizeof(ubo_mvp));
+		UpdateBuffer(ubo_mvp_[vk_current_image_], &ubo_mvp, sizeof(ubo_mvp));
 	}
 
 	{
@@ -273,7 +283,7 @@ void CubeMapsDemo::Update() {
 
 		ubo_viewer.pos_ = glm::vec4(camera_.pos_, 1.0f);
 
-		UpdateBuffer(ubo_viewer_, &ubo_viewer, sizeof(ubo_viewer));
+		UpdateBuffer(ubo_viewer_[vk_current_image_], &ubo_viewer, sizeof(ubo_viewer));
 	}
 }
 
@@ -365,24 +375,44 @@ void CubeMapsDemo::FreeModel() {
 
 // uniform buffer
 bool CubeMapsDemo::CreateUniformBuffers() {
-	return CreateBuffer(ubo_mvp_,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(ubo_mvp_sep_s)) &&
-		CreateBuffer(ubo_light_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_point_light_s)) &&
-		CreateBuffer(ubo_viewer_,
+	if (!CreateImageUniformBuffers()) {
+		return false;
+	}
+
+	// the light is set once
+	return CreateBuffer(ubo_light_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_viewer_s));
+			sizeof(ubo_point_light_s));
 }
 
 void CubeMapsDemo::DestroyUniformBuffers() {
-	DestroyBuffer(ubo_viewer_);
 	DestroyBuffer(ubo_light_);
-	DestroyBuffer(ubo_mvp_);
+	DestroyImageUniformBuffers();
+}
+
+bool CubeMapsDemo::CreateImageUniformBuffers() {
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (!CreateBuffer(ubo_mvp_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_mvp_sep_s)) ||
+			!CreateBuffer(ubo_viewer_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_viewer_s))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CubeMapsDemo::DestroyImageUniformBuffers() {
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		DestroyBuffer(ubo_viewer_[i]);
+		DestroyBuffer(ubo_mvp_[i]);
+	}
 }
 
 bool CubeMapsDemo::CreateDescSetLayouts() {
@@ -417,20 +447,21 @@ bool CubeMapsDemo::AllocDescriptorSets() {
 	allocate_info.descriptorSetCount = (uint32_t)set_layouts.size();
 	allocate_info.pSetLayouts = set_layouts.data();
 
-	VkDescriptorSet sets[8] = {};
-
-	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, sets)) {
-		return false;
-	}
+	update_desc_sets_buffer_s buffer;
 
-	vk_desc_set_mvp_cubemap_ = sets[0];
+	// one set per image, each on its own uniform copies
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		VkDescriptorSet& set = vk_desc_sets_mvp_cubemap_[i];
 
-	update_desc_sets_buffer_s buffer;
+		if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, &set)) {
+			return false;
+		}
 
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_cubemap_, 0, ubo_mvp_.buffer_, 0, ubo_mvp_.memory_size_);
-	Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_mvp_cubemap_, 1, tex_cubemap_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_cubemap_, 2, ubo_light_.buffer_, 0, ubo_light_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_cubemap_, 3, ubo_viewer_.buffer_, 0, ubo_viewer_.memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, set, 0, ubo_mvp_[i].buffer_, 0, ubo_mvp_[i].memory_size_);
+		Vk_PushWriteDescriptorSet_Tex(buffer, set, 1, tex_cubemap_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, set, 2, ubo_light_.buffer_, 0, ubo_light_.memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, set, 3, ubo_viewer_[i].buffer_, 0, ubo_viewer_[i].memory_size_);
+	}
 	
 	vkUpdateDescriptorSets(vk_device_,
 		(uint32_t)buffer.write_descriptor_sets_.size(), buffer.write_descriptor_sets_.data(), 0, nullptr);
@@ -439,12 +470,17 @@ bool CubeMapsDemo::AllocDescriptorSets() {
 }
 
 void CubeMapsDemo::FreeDescriptorSets() {
-	if (vk_desc_set_mvp_cubemap_) {
-		std::vector<VkDescriptorSet> sets;
-		sets.push_back(vk_desc_set_mvp_cubemap_);
+	std::vector<VkDescriptorSet> sets;
+
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		if (vk_desc_sets_mvp_cubemap_[i]) {
+			sets.push_back(vk_desc_sets_mvp_cubemap_[i]);
+			vk_desc_sets_mvp_cubemap_[i] = VK_NULL_HANDLE;
+		}
+	}
 
+	if (!sets.empty()) {
 		vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, (uint32_t)sets.size(), sets.data());
-		vk_desc_set_mvp_cubemap_ = VK_NULL_HANDLE;
 	}
 }
 
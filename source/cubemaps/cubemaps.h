@@ -18,6 +18,7 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					WindowSizeChanged() override;
+	bool					SwapchainImageCountChanged() override;
 	void					Update() override;
 
 private:
@@ -31,10 +32,10 @@ private:
 	// point light
 	ubo_point_light_s		point_light_;
 
-	// ubo
-	vk_buffer_s				ubo_mvp_;
+	// ubo, mvp and viewer per image, see cfg_frame_uniform_copies_
+	vk_buffer_s				ubo_mvp_[MAX_SWAPCHAIN_IMAGES];
 	vk_buffer_s				ubo_light_;
-	vk_buffer_s				ubo_viewer_;
+	vk_buffer_s				ubo_viewer_[MAX_SWAPCHAIN_IMAGES];
 
 	// vbo
 	vk_buffer_s				vbo_box_;
@@ -43,7 +44,7 @@ private:
 
 	// descriptor
 	VkDescriptorSetLayout	vk_desc_set_layout_mvp_cubemap_;
-	VkDescriptorSet			vk_desc_set_mvp_cubemap_;
+	VkDescriptorSet			vk_desc_sets_mvp_cubemap_[MAX_SWAPCHAIN_IMAGES];
 
 	// pipeline
 	VkPipelineLayout		vk_pipeline_layout_skybox_;
@@ -61,6 +62,8 @@ private:
 	// uniform buffer
 	bool					CreateUniformBuffers();
 	void					DestroyUniformBuffers();
+	bool					CreateImageUniformBuffers();	// mvp and viewer, a copy per swapchain image
+	void					DestroyImageUniformBuffers();
 
 	bool					CreateDescSetLayouts();
 
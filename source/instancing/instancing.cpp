@@ -14,7 +14,6 @@ InstancingDemo
 InstancingDemo::InstancingDemo():
 	model_(this),
 	vk_desc_set_layout_(VK_NULL_HANDLE),
-	vk_desc_set_(VK_NULL_HANDLE),
 	vk_pipeline_layout_(VK_NULL_HANDLE),
 	vk_pipeline_(VK_NULL_HANDLE)
 {
@@ -25,7 +24,10 @@ InstancingDemo::InstancingDemo():
 	z_near_ = 1.0f;
 	z_far_ = 1024.0f;
 
-	memset(&ubo_mvp_, 0, sizeof(ubo_mvp_));
+	cfg_frame_uniform_copies_ = true;
+
+	memset(ubo_mvp_, 0, sizeof(ubo_mvp_));
+	memset(vk_desc_sets_, 0, sizeof(vk_desc_sets_));
 	memset(&ubo_viewer_, 0, sizeof(ubo_viewer_));
 	memset(&ubo_light_, 0, sizeof(ubo_light_));
 
@@ -38,7 +40,7 @@ InstancingDemo::~InstancingDemo() {
 
 bool InstancingDemo::Init() {
 	if (!VkDemo::Init("instancing" /* shader files directory */,
-		16, 0, 16, 16)) {
+		3 * MAX_SWAPCHAIN_IMAGES, 0, 16, MAX_SWAPCHAIN_IMAGES)) {
 		return false;
 	}
 
@@ -165,7 +167,7 @@ void InstancingDemo::BuildCommandBuffers() {
 		VkDescriptorSet descriptor_sets[1] = {};
 		VkDeviceSize offset[1] = { 0 };
 
-		descriptor_sets[0] = vk_desc_set_;
+		descriptor_sets[0] = vk_desc_sets_[i];
 
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			vk_pipeline_layout_, 0, 1, descriptor_sets, 0, nullptr);
@@ -203,15 +205,24 @@ void InstancingDemo::Update() {
 	UpdateMVPUniformBuffer();
 }
 
+bool InstancingDemo::SwapchainImageCountChanged() {
+	// the descriptor sets are all per image, viewer and light are kept
+	FreeDescriptorSets();
+	DestroyImageUniformBuffers();
+
+	return CreateImageUniformBuffers() && AllocDescriptorSets();
+}
+
 // uniform buffer
 bool InstancingDemo::CreateUniformBuffers() {
 	VkMemoryPropertyFlags mem_prop_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-	return CreateBuffer(ubo_mvp_,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-		mem_prop_flags,
-		sizeof(ubo_mvp_sep_s)) &&
-		CreateBuffer(ubo_viewer_,
+	if (!CreateImageUniformBuffers()) {
+		return false;
+	}
+
+	// viewer and light are set once
+	return CreateBuffer(ubo_viewer_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			mem_prop_flags,
 			sizeof(ubo_viewer_s)) &&
@@ -224,7 +235,26 @@ bool InstancingDemo::CreateUniformBuffers() {
 void InstancingDemo::DestroyUniformBuffers() {
 	DestroyBuffer(ubo_light_);
 	DestroyBuffer(ubo_viewer_);
-	DestroyBuffer(ubo_mvp_);
+	DestroyImageUniformBuffers();
+}
+
+bool InstancingDemo::CreateImageUniformBuffers() {
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (!CreateBuffer(ubo_mvp_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_mvp_sep_s))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void InstancingDemo::DestroyImageUniformBuffers() {
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		DestroyBuffer(ubo_mvp_[i]);
+	}
 }
 
 bool InstancingDemo::LoadModel() {
@@ -310,15 +340,18 @@ bool InstancingDemo::AllocDescriptorSets() {
 		.pSetLayouts = &vk_desc_set_layout_
 	};
 
-	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, &vk_desc_set_)) {
-		return false;
-	}
-
 	update_desc_sets_buffer_s buffer;
 
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_, 0, ubo_mvp_.buffer_, 0, ubo_mvp_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_, 1, ubo_viewer_.buffer_, 0, ubo_viewer_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_, 2, ubo_light_.buffer_, 0, ubo_light_.memory_size_);
+	// one set per image, each on its own matrix copy
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, vk_desc_sets_ + i)) {
+			return false;
+		}
+
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_sets_[i], 0, ubo_mvp_[i].buffer_, 0, ubo_mvp_[i].memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_sets_[i], 1, ubo_viewer_.buffer_, 0, ubo_viewer_.memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_sets_[i], 2, ubo_light_.buffer_, 0, ubo_light_.memory_size_);
+	}
 
 	vkUpdateDescriptorSets(vk_device_, 
 		(uint32_t)buffer.write_descriptor_sets_.size(), buffer.write_descriptor_sets_.data(), 0, nullptr);
@@ -327,9 +360,11 @@ bool InstancingDemo::AllocDescriptorSets() {
 }
 
 void InstancingDemo::FreeDescriptorSets() {
-	if (vk_desc_set_) {
-		vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, &vk_desc_set_);
-		vk_desc_set_ = VK_NULL_HANDLE;
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		if (vk_desc_sets_[i]) {
+			vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, vk_desc_sets_ + i);
+			vk_desc_sets_[i] = VK_NULL_HANDLE;
+		}
 	}
 }
 
@@ -381,7 +416,7 @@ void InstancingDemo::UpdateMVPUniformBuffer() {
 	GetViewMatrix(ubo_mvp_sep.view_);
 	GetModelMatrix(ubo_mvp_sep.model_);
 
-	UpdateBuffer(ubo_mvp_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
+	UpdateBuffer(ubo_mvp_[vk_current_image_], &ubo_mvp_sep, sizeof(ubo_mvp_sep));
 }
 
 void InstancingDemo::SetupViewerUniformBuffer() {
@@ -18,13 +18,14 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					Update() override;
+	bool					SwapchainImageCountChanged() override;
 
 private:
 
 	const float				VIEW_DISTANCE = 256.0f;
 	static const uint32_t	INSTANCE_COUNT = 512;
 
-	vk_buffer_s				ubo_mvp_;
+	vk_buffer_s				ubo_mvp_[MAX_SWAPCHAIN_IMAGES];	// per image, see cfg_frame_uniform_copies_
 	vk_buffer_s				ubo_viewer_;
 	vk_buffer_s				ubo_light_;
 
@@ -35,7 +36,7 @@ private:
 	// descriptor
 	VkDescriptorSetLayout   vk_desc_set_layout_;
 
-	VkDescriptorSet			vk_desc_set_;
+	VkDescriptorSet			vk_desc_sets_[MAX_SWAPCHAIN_IMAGES];
 
 	// pipeline
 	VkPipelineLayout		vk_pipeline_layout_;
@@ -44,6 +45,8 @@ private:
 	// uniform buffer
 	bool					CreateUniformBuffers();
 	void					DestroyUniformBuffers();
+	bool					CreateImageUniformBuffers();	// ubo_mvp_, a copy per swapchain image
+	void					DestroyImageUniformBuffers();
 
 	bool					LoadModel();
 	void					FreeModel();
@@ -13,14 +13,17 @@ MeshShaderDemo
 MeshShaderDemo::MeshShaderDemo():
 	vkCmdDrawMeshTasksEXT(nullptr),
 	vk_descriptorset_layout_(VK_NULL_HANDLE),
-	vk_descriptorset_(VK_NULL_HANDLE),
 	vk_descriptorset_layout2_(VK_NULL_HANDLE),
 	vk_descriptorset2_(VK_NULL_HANDLE),
 	vk_pipeline_layout_(VK_NULL_HANDLE),
 	vk_pipeline_wireframe_(VK_NULL_HANDLE),
 	vk_pipeline_fill_(VK_NULL_HANDLE),
+	vk_pipeline_packed_wireframe_(VK_NULL_HANDLE),
+	vk_pipeline_packed_fill_(VK_NULL_HANDLE),
 	wireframe_mode_(true),
-	random_seed_(1)
+	random_seed_(1),
+	height_format_(terrain_height_format_t::UNORM16),
+	height_buffer_size_(0)
 {
 #if defined(_WIN32)
 	cfg_demo_win_class_name_ = TEXT("Mesh shader (F2: toggle wireframe & fill mode)");
@@ -40,10 +43,14 @@ MeshShaderDemo::MeshShaderDemo():
 	// will assign to VkDeviceCreateInfo::pNext field to enable task & mesh shaders
 	vk_device_create_next_chain_ = &vk_device_create_next_;
 
-	memset(&uniform_buffer_mvp_, 0, sizeof(uniform_buffer_mvp_));
+	cfg_frame_uniform_copies_ = true;
+
+	memset(uniform_buffer_mvp_, 0, sizeof(uniform_buffer_mvp_));
+	memset(vk_descriptorsets_, 0, sizeof(vk_descriptorsets_));
 	memset(&uniform_buffer_terrain_, 0, sizeof(uniform_buffer_terrain_));
 	memset(&shader_storage_buffer_heights_, 0, sizeof(shader_storage_buffer_heights_));
 	memset(&shader_storage_buffer_color_table_, 0, sizeof(shader_storage_buffer_color_table_));
+	memset(&terrain_, 0, sizeof(terrain_));
 
 	vertex_count_per_edge_ = Terrain_GetVertexCountPerEdge(TERRAIN_SIZE);
 
@@ -62,7 +69,7 @@ MeshShaderDemo::~MeshShaderDemo() {
 
 bool MeshShaderDemo::Init() {
 	if (!VkDemo::Init("mesh_shader" /* shader files directory */,
-		3, 2, 0, 2)) {
+		2 * MAX_SWAPCHAIN_IMAGES + 1, 2 * MAX_SWAPCHAIN_IMAGES, 0, MAX_SWAPCHAIN_IMAGES + 1)) {
 		return false;
 	}
 
@@ -77,51 +84,62 @@ bool MeshShaderDemo::Init() {
 		return false;
 	}
 
-	if (!UpdateTerrainUBO()) {
+	if (!CreateShaderStorageBuffers()) {
 		return false;
 	}
 
-	if (!CreateShaderStorageBuffers()) {
+	if (!CreateDescriptorSetLayout()) {
 		return false;
 	}
 
-	UpdateTerrain();
-
-	if (!CreateDescriptorSetLayout()) {
+	if (!CreateDescriptorSetLayout2()) {
 		return false;
 	}
 
-	if (!AllocDemoDescriptorSet()) {
+	if (!CreatePipelineLayout()) {
 		return false;
 	}
 
-	if (!CreateDescriptorSetLayout2()) {
+	if (!CreatePipelines("SPIR-V/base.mesh.spv", vk_pipeline_wireframe_, vk_pipeline_fill_)) {
 		return false;
 	}
 
-	if (!AllocDemoDescriptorSet2()) {
+	// float heights without packed.mesh.spv, decided before UpdateTerrain sizes the height buffer
+	if (!CreatePipelines("SPIR-V/packed.mesh.spv", vk_pipeline_packed_wireframe_, vk_pipeline_packed_fill_)) {
+		DestroyPipeline(vk_pipeline_packed_fill_);
+		DestroyPipeline(vk_pipeline_packed_wireframe_);
+		printf("packed heights not available, using float heights\n");
+		height_format_ = terrain_height_format_t::FLOAT32;
+	}
+
+	UpdateTerrain();
+
+	if (!height_buffer_size_) {
 		return false;
 	}
 
-	if (!CreatePipelineLayout()) {
+	if (!AllocDemoDescriptorSet()) {
 		return false;
 	}
 
-	if (!CreatePipelines()) {
+	if (!AllocDemoDescriptorSet2()) {
 		return false;
 	}
 
-	BuildCommandBuffer(vk_pipeline_wireframe_);
+	BuildCommandBuffer(GetPipeline());
 
 	enable_display_ = true;
 
 	printf("F2: switch fill & line mode\n");
 	printf("F3: update terrain\n");
+	printf("F4: switch height format\n");
 
 	return true;
 }
 
 void MeshShaderDemo::Shutdown() {
+	DestroyPipeline(vk_pipeline_packed_fill_);
+	DestroyPipeline(vk_pipeline_packed_wireframe_);
 	DestroyPipeline(vk_pipeline_fill_);
 	DestroyPipeline(vk_pipeline_wireframe_);
 	DestroyPipelineLayout(vk_pipeline_layout_);
@@ -131,12 +149,13 @@ void MeshShaderDemo::Shutdown() {
 	DestroyDescriptorSetLayout(vk_descriptorset_layout_);
 	DestroyShaderStorageBuffers();
 	DestroyUniformBuffers();
+	Terrain_Free(terrain_);
 
 	VkDemo::Shutdown();
 }
 
 void MeshShaderDemo::BuildCommandBuffers() {
-	BuildCommandBuffer(wireframe_mode_ ? vk_pipeline_wireframe_ : vk_pipeline_fill_);
+	BuildCommandBuffer(GetPipeline());
 }
 
 void MeshShaderDemo::Update() {
@@ -160,21 +179,40 @@ void MeshShaderDemo::AddAdditionalDeviceExtensions(std::vector<const char*>& ext
 void MeshShaderDemo::FuncKeyDown(uint32_t key) {
 	if (key == KEY_F2) {
 		wireframe_mode_ = !wireframe_mode_;
-		BuildCommandBuffer(wireframe_mode_ ? vk_pipeline_wireframe_ : vk_pipeline_fill_);
+		BuildCommandBuffer(GetPipeline());
 	}
 	else if (key == KEY_F3) {
 		UpdateTerrain();
 	}
+	else if (key == KEY_F4) {
+		if (!vk_pipeline_packed_wireframe_) {
+			printf("packed heights not available\n");
+			return;
+		}
+
+		height_format_ = (terrain_height_format_t)(((int)height_format_ + 1) % 4);
+		UploadHeights();
+		// the descriptor set may point to a new buffer
+		BuildCommandBuffer(GetPipeline());
+	}
+}
+
+bool MeshShaderDemo::SwapchainImageCountChanged() {
+	// the per image sets, written again on the current terrain, height and color buffers; set 2 is kept
+	FreeDemoDescriptorSet();
+	DestroyImageUniformBuffers();
+
+	return CreateImageUniformBuffers() && AllocDemoDescriptorSet();
 }
 
 // uniform buffer
 bool MeshShaderDemo::CreateUniformBuffers() {
-	return CreateBuffer(uniform_buffer_mvp_, 
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(ubo_mat_s))
-		&&
-		CreateBuffer(uniform_buffer_terrain_, 
+	if (!CreateImageUniformBuffers()) {
+		return false;
+	}
+
+	// the terrain only changes in FuncKeyDown, with no frame in flight
+	return CreateBuffer(uniform_buffer_terrain_, 
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			sizeof(ubo_terrain_s));
@@ -182,12 +220,36 @@ bool MeshShaderDemo::CreateUniformBuffers() {
 
 void MeshShaderDemo::DestroyUniformBuffers() {
 	DestroyBuffer(uniform_buffer_terrain_);
-	DestroyBuffer(uniform_buffer_mvp_);
+	DestroyImageUniformBuffers();
+}
+
+bool MeshShaderDemo::CreateImageUniformBuffers() {
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (!CreateBuffer(uniform_buffer_mvp_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_mat_s))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshShaderDemo::DestroyImageUniformBuffers() {
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		DestroyBuffer(uniform_buffer_mvp_[i]);
+	}
 }
 
-bool MeshShaderDemo::UpdateTerrainUBO() {
+bool MeshShaderDemo::UpdateTerrainUBO(const terrain_packed_s& packed) {
 	ubo_terrain_s ubo_terrain = {};
 	ubo_terrain.vertex_count_per_edge_ = vertex_count_per_edge_;
+	ubo_terrain.height_format_ = (int32_t)packed.format_;
+	ubo_terrain.min_z_ = packed.min_z_;
+	ubo_terrain.scale_z_ = packed.scale_z_;
+	ubo_terrain.blocks_per_row_ = packed.blocks_per_row_;
+	ubo_terrain.num_block_ = packed.num_block_;
 
 	// update ubo_terrain
 	return UpdateBuffer(uniform_buffer_terrain_, &ubo_terrain, sizeof(ubo_terrain));
@@ -195,16 +257,7 @@ bool MeshShaderDemo::UpdateTerrainUBO() {
 
 // shader storage buffer
 bool MeshShaderDemo::CreateShaderStorageBuffers() {
-	// -- shader storage buffer of height values --
-
-	uint32_t height_buffer_size = (uint32_t)(sizeof(float) * SQUARE(vertex_count_per_edge_));
-
-	if (!CreateBuffer(shader_storage_buffer_heights_, 
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		height_buffer_size)) {
-		return false;
-	}
+	// -- shader storage buffer of height values: created by UploadHeights --
 
 	// -- shader storage buffer of color table --
 	
@@ -269,16 +322,21 @@ bool MeshShaderDemo::AllocDemoDescriptorSet() {
 	allocate_info.descriptorSetCount = 1;
 	allocate_info.pSetLayouts = &vk_descriptorset_layout_;
 
-	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, &vk_descriptorset_)) {
-		return false;
-	}
-
 	update_desc_sets_buffer_s buffer;
 
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorset_, 0, uniform_buffer_mvp_.buffer_, 0, uniform_buffer_mvp_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorset_, 1, uniform_buffer_terrain_.buffer_, 0, uniform_buffer_terrain_.memory_size_);
-	Vk_PushWriteDescriptorSet_SBO(buffer, vk_descriptorset_, 2, shader_storage_buffer_heights_.buffer_, 0, shader_storage_buffer_heights_.memory_size_);
-	Vk_PushWriteDescriptorSet_SBO(buffer, vk_descriptorset_, 3, shader_storage_buffer_color_table_.buffer_, 0, shader_storage_buffer_color_table_.memory_size_);
+	// one set per image, each on its own matrix copy
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		VkDescriptorSet& set = vk_descriptorsets_[i];
+
+		if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, &set)) {
+			return false;
+		}
+
+		Vk_PushWriteDescriptorSet_UBO(buffer, set, 0, uniform_buffer_mvp_[i].buffer_, 0, uniform_buffer_mvp_[i].memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, set, 1, uniform_buffer_terrain_.buffer_, 0, uniform_buffer_terrain_.memory_size_);
+		Vk_PushWriteDescriptorSet_SBO(buffer, set, 2, shader_storage_buffer_heights_.buffer_, 0, shader_storage_buffer_heights_.memory_size_);
+		Vk_PushWriteDescriptorSet_SBO(buffer, set, 3, shader_storage_buffer_color_table_.buffer_, 0, shader_storage_buffer_color_table_.memory_size_);
+	}
 
 	vkUpdateDescriptorSets(vk_device_, (uint32_t)buffer.write_descriptor_sets_.size(), buffer.write_descriptor_sets_.data(), 0, nullptr);
 
@@ -286,12 +344,14 @@ bool MeshShaderDemo::AllocDemoDescriptorSet() {
 }
 
 void MeshShaderDemo::FreeDemoDescriptorSet() {
-	if (vk_descriptorset_) {
-		vkFreeDescriptorSets(vk_device_,
-			vk_descriptor_pool_,
-			1,
-			&vk_descriptorset_);
-		vk_descriptorset_ = VK_NULL_HANDLE;
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		if (vk_descriptorsets_[i]) {
+			vkFreeDescriptorSets(vk_device_,
+				vk_descriptor_pool_,
+				1,
+				vk_descriptorsets_ + i);
+			vk_descriptorsets_[i] = VK_NULL_HANDLE;
+		}
 	}
 }
 
@@ -365,11 +425,11 @@ bool MeshShaderDemo::CreatePipelineLayout() {
 }
 
 // pipeline
-bool MeshShaderDemo::CreatePipelines() {
+bool MeshShaderDemo::CreatePipelines(const char* mesh_shader_filename, VkPipeline& wireframe, VkPipeline& fill) {
 	VkShaderModule task_shader = VK_NULL_HANDLE, mesh_shader = VK_NULL_HANDLE, fragment_shader = VK_NULL_HANDLE;
 
 	LoadShader("SPIR-V/base.task.spv", task_shader);
-	LoadShader("SPIR-V/base.mesh.spv", mesh_shader);
+	LoadShader(mesh_shader_filename, mesh_shader);
 	LoadShader("SPIR-V/base.frag.spv", fragment_shader);
 
 	if (!task_shader || !mesh_shader || !fragment_shader) {
@@ -548,11 +608,11 @@ bool MeshShaderDemo::CreatePipelines() {
 	create_info.basePipelineIndex = 0;
 
 	VkResult rt1 = vkCreateGraphicsPipelines(vk_device_, vk_pipeline_cache_,
-		1, &create_info, nullptr, &vk_pipeline_wireframe_);
+		1, &create_info, nullptr, &wireframe);
 
 	rasterization_state.polygonMode = VK_POLYGON_MODE_FILL;
 	VkResult rt2 = vkCreateGraphicsPipelines(vk_device_, vk_pipeline_cache_,
-		1, &create_info, nullptr, &vk_pipeline_fill_);
+		1, &create_info, nullptr, &fill);
 
 	// free shader modules
 	vkDestroyShaderModule(vk_device_, fragment_shader, nullptr);
@@ -562,6 +622,15 @@ bool MeshShaderDemo::CreatePipelines() {
 	return rt1 == VK_SUCCESS && rt2 == VK_SUCCESS;
 }
 
+VkPipeline MeshShaderDemo::GetPipeline() const {
+	if (height_format_ == terrain_height_format_t::FLOAT32) {
+		return wireframe_mode_ ? vk_pipeline_wireframe_ : vk_pipeline_fill_;
+	}
+	else {
+		return wireframe_mode_ ? vk_pipeline_packed_wireframe_ : vk_pipeline_packed_fill_;
+	}
+}
+
 void MeshShaderDemo::UpdateTerrain() {
 	SRand(random_seed_++);
 
@@ -577,23 +646,65 @@ void MeshShaderDemo::UpdateTerrain() {
 		.roughness_ = 0.75f,	// 0.25 ~ 1.5
 	};
 
-	terrain_s test_terrain = {};
+	// kept to be packed again when the height format changes
+	Terrain_Free(terrain_);
 	// if sz value changed we need change camera position & value in task shader also
 
-	if (!Terrain_Generate(terrain_gen_params, test_terrain)) {
+	if (!Terrain_Generate(terrain_gen_params, terrain_)) {
 		printf("Could not generate a test terrain\n");
 		return;
 	}
 
-	uint32_t height_buffer_size = (uint32_t)(sizeof(float) * SQUARE(test_terrain.vertex_count_per_edge_));
+	UploadHeights();
+}
 
-	if (!UpdateBuffer(shader_storage_buffer_heights_, test_terrain.heights_, height_buffer_size)) {
-		Terrain_Free(test_terrain);
-		return;
+bool MeshShaderDemo::UploadHeights() {
+	static const char* FORMAT_NAMES[] = { "float32", "unorm16", "float16", "block delta" };
+
+	terrain_packed_s packed = {};
+	if (!Terrain_Pack(terrain_, height_format_, 0.0f, (float)TERRAIN_MAX_Z, packed)) {
+		return false;
+	}
+
+	size_t float_size = sizeof(float) * SQUARE(terrain_.vertex_count_per_edge_);
+	printf("heights %s: %zu bytes (%.2fx smaller than float), max error %f, rms error %f\n",
+		FORMAT_NAMES[(int)packed.format_], packed.size_, (double)float_size / packed.size_,
+		packed.max_error_, packed.rms_error_);
+
+	bool ok = true;
+
+	// a new size needs a new buffer, no frame is in flight: see the WaitFramesInFlight before FuncKeyDown
+	if (packed.size_ != height_buffer_size_) {
+		DestroyBuffer(shader_storage_buffer_heights_);
+		height_buffer_size_ = 0;
+
+		ok = CreateBuffer(shader_storage_buffer_heights_,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			packed.size_);
+
+		if (ok) {
+			height_buffer_size_ = packed.size_;
+		}
+
+		if (ok) {
+			update_desc_sets_buffer_s buffer;
+
+			for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+				if (vk_descriptorsets_[i]) {
+					Vk_PushWriteDescriptorSet_SBO(buffer, vk_descriptorsets_[i], 2, shader_storage_buffer_heights_.buffer_, 0, shader_storage_buffer_heights_.memory_size_);
+				}
+			}
+
+			vkUpdateDescriptorSets(vk_device_, (uint32_t)buffer.write_descriptor_sets_.size(), buffer.write_descriptor_sets_.data(), 0, nullptr);
+		}
 	}
 
-	// now we can free terrain memory
-	Terrain_Free(test_terrain);
+	ok = ok && UpdateBuffer(shader_storage_buffer_heights_, packed.data_, packed.size_) && UpdateTerrainUBO(packed);
+
+	Terrain_FreePacked(packed);
+
+	return ok;
 }
 
 // build command buffer
@@ -657,7 +768,7 @@ void MeshShaderDemo::BuildCommandBuffer(VkPipeline pipeline) {
 
 		vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 
-		VkDescriptorSet descriptor_sets[2] = { vk_descriptorset_, vk_descriptorset2_ };
+		VkDescriptorSet descriptor_sets[2] = { vk_descriptorsets_[i], vk_descriptorset2_ };
 
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			vk_pipeline_layout_, 0, 2, descriptor_sets, 0, nullptr);
@@ -687,7 +798,7 @@ void MeshShaderDemo::UpdateMVPUniformBuffer() {
 
 	ubo_mvp.matrix_ = projection_matrix * view_matrix * model_matrix;
 
-	UpdateBuffer(uniform_buffer_mvp_, &ubo_mvp, sizeof(ubo_mvp));
+	UpdateBuffer(uniform_buffer_mvp_[vk_current_image_], &ubo_mvp, sizeof(ubo_mvp));
 }
 
 /*
@@ -18,11 +18,18 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					Update() override;
+	bool					SwapchainImageCountChanged() override;
 
 private:
 
+	// packed.mesh reads all of it, base.task and base.mesh the first member
 	struct ubo_terrain_s {
 		int32_t				vertex_count_per_edge_;
+		int32_t				height_format_;		// terrain_height_format_t
+		float				min_z_;
+		float				scale_z_;
+		uint32_t			blocks_per_row_;
+		uint32_t			num_block_;
 	};
 
 	// VkDeviceCreateInfo::pNext chain
@@ -33,7 +40,7 @@ private:
 
 	// descriptor
 	VkDescriptorSetLayout   vk_descriptorset_layout_;
-	VkDescriptorSet         vk_descriptorset_;
+	VkDescriptorSet         vk_descriptorsets_[MAX_SWAPCHAIN_IMAGES];
 
 	VkDescriptorSetLayout   vk_descriptorset_layout2_;
 	VkDescriptorSet         vk_descriptorset2_;
@@ -44,7 +51,11 @@ private:
 	VkPipeline              vk_pipeline_wireframe_;
 	VkPipeline				vk_pipeline_fill_;
 
-	vk_buffer_s				uniform_buffer_mvp_;
+	// packed heights, VK_NULL_HANDLE if packed.mesh.spv is missing
+	VkPipeline				vk_pipeline_packed_wireframe_;
+	VkPipeline				vk_pipeline_packed_fill_;
+
+	vk_buffer_s				uniform_buffer_mvp_[MAX_SWAPCHAIN_IMAGES];	// per image, see cfg_frame_uniform_copies_
 	vk_buffer_s				uniform_buffer_terrain_;
 	vk_buffer_s				shader_storage_buffer_heights_;
 	vk_buffer_s				shader_storage_buffer_color_table_;
@@ -54,6 +65,9 @@ private:
 	static const terrain_size_t	TERRAIN_SIZE = terrain_size_t::TS_512;
 	static const int		TERRAIN_MAX_Z = 64;
 	uint32_t				vertex_count_per_edge_;
+	terrain_s				terrain_;
+	terrain_height_format_t	height_format_;
+	size_t					height_buffer_size_;
 
 	void					AddAdditionalInstanceExtensions(std::vector<const char*>& extensions) const override;
 	void					AddAdditionalDeviceExtensions(std::vector<const char*>& extensions) const override;
@@ -63,8 +77,10 @@ private:
 	// uniform buffer
 	bool					CreateUniformBuffers();
 	void					DestroyUniformBuffers();
+	bool					CreateImageUniformBuffers();	// uniform_buffer_mvp_, a copy per swapchain image
+	void					DestroyImageUniformBuffers();
 
-	bool					UpdateTerrainUBO();
+	bool					UpdateTerrainUBO(const terrain_packed_s& packed);
 
 	// shader storage buffers
 	bool					CreateShaderStorageBuffers();
@@ -88,9 +104,12 @@ private:
 	bool					CreatePipelineLayout();
 
 	// pipeline
-	bool					CreatePipelines();
+	bool					CreatePipelines(const char* mesh_shader_filename, VkPipeline& wireframe, VkPipeline& fill);
+	VkPipeline				GetPipeline() const;
 
 	void					UpdateTerrain();
+	// packs terrain_ in height_format_, recreates the height buffer if its size changed
+	bool					UploadHeights();
 
 	// build command buffer
 	void					BuildCommandBuffer(VkPipeline pipeline);
@@ -0,0 +1,98 @@
+/******************************************************************************
+ model_bake
+
+   write the binary cache of every model under data/models (or the folders
+   given on the command line), so the demos never parse obj / ply files
+
+   usage: model_bake [folder ...]
+ *****************************************************************************/
+
+#include "../common/inc.h"
+#include <chrono>
+#include <filesystem>
+
+static bool BakeModel(const char* filename) {
+	auto t0 = std::chrono::steady_clock::now();
+
+	model_s model = {};
+	if (!Model_Load(filename, false, model)) {
+		printf("%-60s load failed\n", filename);
+		return false;
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	bool ok = Model_SaveCache(filename, model);
+
+	auto t2 = std::chrono::steady_clock::now();
+
+	if (ok) {
+		size_t bytes = (size_t)Model_GetVertexSize(model.vertex_format_) * model.num_vertex_
+			+ sizeof(uint32_t) * model.num_index_;
+
+		printf("%-60s %10u %10u %12zu %10.2f %10.2f\n", filename, model.num_vertex_, model.num_index_, bytes,
+			std::chrono::duration<double, std::milli>(t1 - t0).count(),
+			std::chrono::duration<double, std::milli>(t2 - t1).count());
+	}
+
+	Model_Free(model);
+
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	Common_Init();
+
+	// always parse the source, the cache is written explicitly
+	Model_SetUseCache(false);
+	Model_SetLoadThreadCount(0);
+
+	std::vector<std::filesystem::path> folders;
+	for (int i = 1; i < argc; ++i) {
+		folders.push_back(std::filesystem::path(argv[i]));
+	}
+
+	if (folders.empty()) {
+		char models_folder[MAX_PATH];
+		Str_SPrintf(models_folder, COUNT_OF(models_folder), "%s/models", GetDataFolder());
+		folders.push_back(std::filesystem::path(models_folder));
+	}
+
+	printf("%-60s %10s %10s %12s %10s %10s\n", "model", "vertices", "indices", "bytes", "parse ms", "write ms");
+
+	int num_baked = 0, num_failed = 0;
+
+	for (const std::filesystem::path& folder : folders) {
+		std::error_code ec;
+		std::filesystem::recursive_directory_iterator it(folder, ec);
+		if (ec) {
+			printf("could not open folder %s\n", folder.string().c_str());
+			num_failed++;
+			continue;
+		}
+
+		for (const std::filesystem::directory_entry& entry : it) {
+			if (!entry.is_regular_file()) {
+				continue;
+			}
+
+			std::string ext = entry.path().extension().string();
+			if (Str_ICmp(ext.c_str(), ".obj") != 0 && Str_ICmp(ext.c_str(), ".ply") != 0) {
+				continue;
+			}
+
+			if (BakeModel(entry.path().string().c_str())) {
+				num_baked++;
+			}
+			else {
+				num_failed++;
+			}
+		}
+	}
+
+	printf("%d baked, %d failed\n", num_baked, num_failed);
+
+	Common_Shutdown();
+
+	return num_failed ? 1 : 0;
+}
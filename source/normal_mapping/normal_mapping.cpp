@@ -15,7 +15,6 @@ NormalMappingDemo::NormalMappingDemo():
 	index_count_(0),
 	vk_descriptorset_layout_uniform_(VK_NULL_HANDLE),
 	vk_descriptorset_layout_sampler_(VK_NULL_HANDLE),
-	vk_descriptorset_uniform_(VK_NULL_HANDLE),
 	vk_descriptorset_sampler_(VK_NULL_HANDLE),
 	vk_pipeline_layout_(VK_NULL_HANDLE),
 	vk_pipeline_tex_(VK_NULL_HANDLE),
@@ -30,7 +29,10 @@ NormalMappingDemo::NormalMappingDemo():
 	memset(&texture_color_, 0, sizeof(texture_color_));
 	memset(&texture_normal_, 0, sizeof(texture_normal_));
 
-	memset(&uniform_buffer_mat_, 0, sizeof(uniform_buffer_mat_));
+	cfg_frame_uniform_copies_ = true;
+
+	memset(uniform_buffer_mat_, 0, sizeof(uniform_buffer_mat_));
+	memset(vk_descriptorsets_uniform_, 0, sizeof(vk_descriptorsets_uniform_));
 	memset(&uniform_buffer_point_light_, 0, sizeof(uniform_buffer_point_light_));
 
 	memset(&vertex_buffer_, 0, sizeof(vertex_buffer_));
@@ -43,7 +45,7 @@ NormalMappingDemo::~NormalMappingDemo() {
 
 bool NormalMappingDemo::Init() {
 	if (!VkDemo::Init("normal_mapping" /* shader files directory */,
-		16, 0, 16, 16)) {
+		2 * MAX_SWAPCHAIN_IMAGES, 0, 16, MAX_SWAPCHAIN_IMAGES + 1)) {
 		return false;
 	}
 
@@ -197,13 +199,21 @@ void NormalMappingDemo::FreeTextures() {
 	DestroyImage(texture_color_);
 }
 
+bool NormalMappingDemo::SwapchainImageCountChanged() {
+	// the sampler set is allocated again along with the uniform sets, the light is kept
+	FreeDescriptorSets();
+	DestroyImageUniformBuffers();
+
+	return CreateImageUniformBuffers() && AllocDescriptorSets();
+}
+
 bool NormalMappingDemo::CreateUniformBuffers() {
-	return CreateBuffer(uniform_buffer_mat_, 
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			sizeof(ubo_mvp_sep_s))
-			&& 
-			CreateBuffer(uniform_buffer_point_light_,
+	if (!CreateImageUniformBuffers()) {
+		return false;
+	}
+
+	// the light does not change, one copy
+	return CreateBuffer(uniform_buffer_point_light_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			sizeof(ubo_point_light_s));
@@ -211,7 +221,26 @@ bool NormalMappingDemo::CreateUniformBuffers() {
 
 void NormalMappingDemo::DestroyUniformBuffers() {
 	DestroyBuffer(uniform_buffer_point_light_);
-	DestroyBuffer(uniform_buffer_mat_);
+	DestroyImageUniformBuffers();
+}
+
+bool NormalMappingDemo::CreateImageUniformBuffers() {
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (!CreateBuffer(uniform_buffer_mat_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_mvp_sep_s))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void NormalMappingDemo::DestroyImageUniformBuffers() {
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		DestroyBuffer(uniform_buffer_mat_[i]);
+	}
 }
 
 bool NormalMappingDemo::CreateWall() {
@@ -299,32 +328,36 @@ bool NormalMappingDemo::CreateDescriptorSetLayout_Sampler() {
 bool NormalMappingDemo::AllocDescriptorSets() {
 	VkDescriptorSetAllocateInfo allocate_info = {};
 
-	VkDescriptorSetLayout set_layouts[2] = {
-		vk_descriptorset_layout_uniform_,
+	VkDescriptorSetLayout set_layouts[1] = {
 		vk_descriptorset_layout_sampler_
 	};
 
 	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocate_info.pNext = nullptr;
 	allocate_info.descriptorPool = vk_descriptor_pool_;
-	allocate_info.descriptorSetCount = 2;
+	allocate_info.descriptorSetCount = 1;
 	allocate_info.pSetLayouts = set_layouts;
 
-	VkDescriptorSet sets[2] = {};
-
-	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, sets)) {
+	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, &vk_descriptorset_sampler_)) {
 		return false;
 	}
 
-	vk_descriptorset_uniform_ = sets[0];
-	vk_descriptorset_sampler_ = sets[1];
-
 	update_desc_sets_buffer_s buffer;
 
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorset_uniform_,
-		0, uniform_buffer_mat_.buffer_, 0, uniform_buffer_mat_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorset_uniform_,
-		1, uniform_buffer_point_light_.buffer_, 0, uniform_buffer_point_light_.memory_size_);
+	// one uniform set per image, each on its own matrix copy
+	set_layouts[0] = vk_descriptorset_layout_uniform_;
+
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, vk_descriptorsets_uniform_ + i)) {
+			return false;
+		}
+
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorsets_uniform_[i],
+			0, uniform_buffer_mat_[i].buffer_, 0, uniform_buffer_mat_[i].memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorsets_uniform_[i],
+			1, uniform_buffer_point_light_.buffer_, 0, uniform_buffer_point_light_.memory_size_);
+	}
+
 	Vk_PushWriteDescriptorSet_Tex(buffer, vk_descriptorset_sampler_,
 		0, texture_color_);
 	Vk_PushWriteDescriptorSet_Tex(buffer, vk_descriptorset_sampler_,
@@ -336,14 +369,16 @@ bool NormalMappingDemo::AllocDescriptorSets() {
 }
 
 void NormalMappingDemo::FreeDescriptorSets() {
-	if (vk_descriptorset_uniform_) {
-		VkDescriptorSet sets[2] = {
-			vk_descriptorset_uniform_,
-			vk_descriptorset_sampler_
-		};
-		vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 2, sets);
-		
-		vk_descriptorset_uniform_ = vk_descriptorset_sampler_ = VK_NULL_HANDLE;
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		if (vk_descriptorsets_uniform_[i]) {
+			vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, vk_descriptorsets_uniform_ + i);
+			vk_descriptorsets_uniform_[i] = VK_NULL_HANDLE;
+		}
+	}
+
+	if (vk_descriptorset_sampler_) {
+		vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, &vk_descriptorset_sampler_);
+		vk_descriptorset_sampler_ = VK_NULL_HANDLE;
 	}
 }
 
@@ -500,7 +535,7 @@ void NormalMappingDemo::BuildCommandBuffer(VkPipeline pipeline) {
 
 		vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 
-		VkDescriptorSet descriptor_sets[2] = { vk_descriptorset_uniform_, vk_descriptorset_sampler_ };
+		VkDescriptorSet descriptor_sets[2] = { vk_descriptorsets_uniform_[i], vk_descriptorset_sampler_ };
 
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			vk_pipeline_layout_, 0, 2, descriptor_sets, 0, nullptr);
@@ -530,7 +565,7 @@ void NormalMappingDemo::UpdateMVPUniformBuffer() {
 	GetViewMatrix(ubo_mvp_sep.view_);
 	GetModelMatrix(ubo_mvp_sep.model_);
 
-	UpdateBuffer(uniform_buffer_mat_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
+	UpdateBuffer(uniform_buffer_mat_[vk_current_image_], &ubo_mvp_sep, sizeof(ubo_mvp_sep));
 }
 
 void NormalMappingDemo::SetupLightUniformBuffer() {
@@ -21,6 +21,7 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					Update() override;
+	bool					SwapchainImageCountChanged() override;
 
 private:
 
@@ -36,7 +37,7 @@ private:
 	vk_image_s				texture_color_;
 	vk_image_s				texture_normal_;
 
-	vk_buffer_s				uniform_buffer_mat_;
+	vk_buffer_s				uniform_buffer_mat_[MAX_SWAPCHAIN_IMAGES];	// per image, see cfg_frame_uniform_copies_
 	vk_buffer_s				uniform_buffer_point_light_;
 	vk_buffer_s				vertex_buffer_;
 	vk_buffer_s				index_buffer_;
@@ -46,7 +47,7 @@ private:
 	VkDescriptorSetLayout   vk_descriptorset_layout_uniform_;
 	VkDescriptorSetLayout	vk_descriptorset_layout_sampler_;
 
-	VkDescriptorSet         vk_descriptorset_uniform_;
+	VkDescriptorSet         vk_descriptorsets_uniform_[MAX_SWAPCHAIN_IMAGES];
 	VkDescriptorSet			vk_descriptorset_sampler_;
 
 	// pipeline
@@ -67,6 +68,8 @@ private:
 
 	bool					CreateUniformBuffers();
 	void					DestroyUniformBuffers();
+	bool					CreateImageUniformBuffers();	// uniform_buffer_mat_, a copy per swapchain image
+	void					DestroyImageUniformBuffers();
 
 	// vertex buffer
 	bool					CreateWall();
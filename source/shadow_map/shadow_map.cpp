@@ -16,6 +16,11 @@ ShadowMapDemo::ShadowMapDemo() :
 	old_view_cy_(0),
 	model_floor_(this),
 	model_object_(this),
+	uniform_ring_(this),
+	ring_mvp_light_(0),
+	ring_mvp_sep_(0),
+	ring_mvp_fixed_light_(0),
+	ring_mvp_sep_fixed_(0),
 	vk_sampler_depth_(VK_NULL_HANDLE),
 	vk_shadow_map_depth_format_(VK_FORMAT_D16_UNORM),
 	vk_framebuffer_depth_(VK_NULL_HANDLE),
@@ -44,13 +49,11 @@ ShadowMapDemo::ShadowMapDemo() :
 
 	light_dir_ = glm::normalize(glm::vec3(-1.0, 0.0f, -1.0f));
 
+	cfg_frame_uniform_copies_ = true;	// the matrices of Update are in uniform_ring_
+
 	memset(&vk_image_depth_, 0, sizeof(vk_image_depth_));
 
 	memset(&vk_ubo_mvp_overlay_, 0, sizeof(vk_ubo_mvp_overlay_));
-	memset(&vk_ubo_mvp_light_, 0, sizeof(vk_ubo_mvp_light_));
-	memset(&vk_ubo_mvp_sep_, 0, sizeof(vk_ubo_mvp_sep_));
-	memset(&vk_ubo_mvp_fixed_light_, 0, sizeof(vk_ubo_mvp_fixed_light_));
-	memset(&vk_ubo_mvp_sep_fixed_, 0, sizeof(vk_ubo_mvp_sep_fixed_));
 	memset(&vk_ubo_viewer_, 0, sizeof(vk_ubo_viewer_));
 	memset(&vk_ubo_light_, 0, sizeof(vk_ubo_light_));
 
@@ -64,7 +67,7 @@ ShadowMapDemo::~ShadowMapDemo() {
 
 bool ShadowMapDemo::Init() {
 	if (!VkDemo::Init("shadow_map" /* shader files directory */,
-		16, 0, 16, 16)) {
+		16, 0, 16, 16, 16)) {
 		return false;
 	}
 
@@ -103,27 +106,20 @@ bool ShadowMapDemo::Init() {
 	}
 
 	VkModel::load_params_s load_params = {
-		.desc_set_layout_bind0_mat_bind1_tex_ = vk_desc_set_layout_ubo_tex_
+		.desc_set_layout_bind0_mat_bind1_tex_ = vk_desc_set_layout_ubo_tex_,
+		.check_vertex_format_ = true,
+		.vertex_format_ = MODEL_EXPECT_VF
 	};
 
 	if (!model_floor_.Load(load_params, "floor/floor.obj", false)) {
 		return false;
 	}
 
-	if (model_floor_.GetVertexFormat() != MODEL_EXPECT_VF) {
-		printf("Bad vertex format of model_floor\n");
-		return false;
-	}
-
 	glm::mat4 trans = glm::scale(glm::mat4(1.0f), glm::vec3(0.1f));
 	trans = glm::rotate(trans, glm::radians(90.0f),
 		glm::vec3(1.0f, 0.0f, 0.0f));
-	if (!model_object_.Load(load_params, "low_poly_tree/Lowpoly_tree_sample.obj", false, &trans)) {
-		return false;
-	}
-
-	if (model_object_.GetVertexFormat() != MODEL_EXPECT_VF) {
-		printf("Bad vertex format of model_object\n");
+	// the floor is drawn while the tree streams in
+	if (!model_object_.LoadAsync(load_params, "low_poly_tree/Lowpoly_tree_sample.obj", false, &trans)) {
 		return false;
 	}
 
@@ -197,11 +193,8 @@ void ShadowMapDemo::Shutdown() {
 
 	DestroyBuffer(vk_ubo_light_);
 	DestroyBuffer(vk_ubo_viewer_);
-	DestroyBuffer(vk_ubo_mvp_sep_fixed_);
-	DestroyBuffer(vk_ubo_mvp_fixed_light_);
-	DestroyBuffer(vk_ubo_mvp_sep_);
-	DestroyBuffer(vk_ubo_mvp_light_);
 	DestroyBuffer(vk_ubo_mvp_overlay_);
+	uniform_ring_.Shutdown();
 	
 	VkDemo::Shutdown();
 }
@@ -210,7 +203,7 @@ void ShadowMapDemo::BuildCommandBuffers() {
 	const VkModel * models[2] = {&model_floor_, &model_object_};
 	const uint32_t draw_model_count = 2; // 1 2
 
-	auto DrawModels = [&](VkCommandBuffer cmd_buf, bool depth_pass, 
+	auto DrawModels = [&](VkCommandBuffer cmd_buf, uint32_t image, bool depth_pass, 
 		const VkModel * const * models, uint32_t models_count) {
 
 		VkDeviceSize offset[1] = { 0 };
@@ -218,6 +211,11 @@ void ShadowMapDemo::BuildCommandBuffers() {
 		for (uint32_t i = 0; i < models_count; ++i) {
 			const VkModel* m = models[i];
 
+			// drawn once the streamer has uploaded it, never if it failed (reported when delivered)
+			if (!m->IsReady()) {
+				continue;
+			}
+
 			VkBuffer vertex_buffer = m->GetVertexBuffer();
 			vkCmdBindVertexBuffers(cmd_buf, 0, 1, &vertex_buffer, offset);
 
@@ -226,16 +224,20 @@ void ShadowMapDemo::BuildCommandBuffers() {
 
 			if (depth_pass) {
 				std::array<VkDescriptorSet, 1> descriptor_sets;
+				std::array<uint32_t, 2> dynamic_offsets = {};	// binding 1 is not used by the depth pass
 
 				if (m == &model_floor_) {
 					descriptor_sets[0] = vk_desc_set_mvp_fixed_light_;
+					dynamic_offsets[0] = uniform_ring_.GetDynamicOffset(ring_mvp_fixed_light_, image);
 				}
 				else {
 					descriptor_sets[0] = vk_desc_set_mvp_light_;
+					dynamic_offsets[0] = uniform_ring_.GetDynamicOffset(ring_mvp_light_, image);
 				}
 
 				vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-					vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+					vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(),
+					(uint32_t)dynamic_offsets.size(), dynamic_offsets.data());
 
 				vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_depth_);
 
@@ -248,6 +250,12 @@ void ShadowMapDemo::BuildCommandBuffers() {
 			else {
 				uint32_t material_count = m->GetMaterialCount();
 
+				// mvp, light mvp
+				std::array<uint32_t, 2> dynamic_offsets = {
+					uniform_ring_.GetDynamicOffset(m == &model_floor_ ? ring_mvp_sep_fixed_ : ring_mvp_sep_, image),
+					uniform_ring_.GetDynamicOffset(m == &model_floor_ ? ring_mvp_fixed_light_ : ring_mvp_light_, image)
+				};
+
 				for (uint32_t j = 0; j < material_count; ++j) {
 					const VkModel::vk_material_s* vk_mat = m->GetMaterialByIdx(j);
 
@@ -257,7 +265,8 @@ void ShadowMapDemo::BuildCommandBuffers() {
 					};
 
 					vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-						vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+						vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(),
+						(uint32_t)dynamic_offsets.size(), dynamic_offsets.data());
 
 					if (vk_mat->vk_texture_.image_) {
 						// texture
@@ -286,8 +295,12 @@ void ShadowMapDemo::BuildCommandBuffers() {
 
 		descriptor_sets[0] = vk_desc_set_overlay_;
 
+		// the overlay matrix is a buffer of its own, only rewritten when the viewport changes
+		std::array<uint32_t, 2> dynamic_offsets = {};
+
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-			vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+			vk_pipeline_layout_, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(),
+			(uint32_t)dynamic_offsets.size(), dynamic_offsets.data());
 
 		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_overlay_);
 
@@ -359,7 +372,7 @@ void ShadowMapDemo::BuildCommandBuffers() {
 			vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 			//*/
 
-			DrawModels(cmd_buf, true, models, draw_model_count);
+			DrawModels(cmd_buf, i, true, models, draw_model_count);
 
 			vkCmdEndRenderPass(cmd_buf);
 
@@ -414,7 +427,7 @@ void ShadowMapDemo::BuildCommandBuffers() {
 			vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 
 			if (draw_model_) {
-				DrawModels(cmd_buf, false, models, draw_model_count);
+				DrawModels(cmd_buf, i, false, models, draw_model_count);
 			}
 
 			if (draw_overlay_) {
@@ -467,10 +480,10 @@ void ShadowMapDemo::Update() {
 	GetModelMatrix(model);
 
 	ubo_mvp.matrix_ = light_proj * light_view;
-	UpdateBuffer(vk_ubo_mvp_fixed_light_, &ubo_mvp, sizeof(ubo_mvp));
+	uniform_ring_.Write(ring_mvp_fixed_light_, &ubo_mvp, sizeof(ubo_mvp));
 
 	ubo_mvp.matrix_ = ubo_mvp.matrix_ * model;
-	UpdateBuffer(vk_ubo_mvp_light_, &ubo_mvp, sizeof(ubo_mvp));
+	uniform_ring_.Write(ring_mvp_light_, &ubo_mvp, sizeof(ubo_mvp));
 
 	// camera view
 
@@ -481,10 +494,10 @@ void ShadowMapDemo::Update() {
 
 	ubo_mvp_sep.model_ = glm::mat4(1.0f);
 
-	UpdateBuffer(vk_ubo_mvp_sep_fixed_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
+	uniform_ring_.Write(ring_mvp_sep_fixed_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
 
 	ubo_mvp_sep.model_ = model;
-	UpdateBuffer(vk_ubo_mvp_sep_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
+	uniform_ring_.Write(ring_mvp_sep_, &ubo_mvp_sep, sizeof(ubo_mvp_sep));
 
 	UpdateBuffersForOverlay();
 }
@@ -500,30 +513,38 @@ void ShadowMapDemo::FuncKeyDown(uint32_t key) {
 	}
 }
 
+bool ShadowMapDemo::SwapchainImageCountChanged() {
+	// a ring copy per image, the sets on the ring are written again
+	if (!uniform_ring_.Resize()) {
+		return false;
+	}
+
+	FreeDescriptorSets();
+
+	return AllocateDestriptorSets();
+}
+
 bool ShadowMapDemo::CreateUniformBuffers() {
 	VkMemoryPropertyFlags mem_prop_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
+	size_t ring_copy_size = 
+		GetAlignedMinOffsetSize(sizeof(ubo_mat_s)) * 2 +
+		GetAlignedMinOffsetSize(sizeof(ubo_mvp_sep_s)) * 2;
+
+	if (!uniform_ring_.Init(ring_copy_size)) {
+		return false;
+	}
+
+	ring_mvp_light_ = uniform_ring_.Alloc(sizeof(ubo_mat_s));
+	ring_mvp_sep_ = uniform_ring_.Alloc(sizeof(ubo_mvp_sep_s));
+	ring_mvp_fixed_light_ = uniform_ring_.Alloc(sizeof(ubo_mat_s));
+	ring_mvp_sep_fixed_ = uniform_ring_.Alloc(sizeof(ubo_mvp_sep_s));
+
 	return 
 		CreateBuffer(vk_ubo_mvp_overlay_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			mem_prop_flags,
 			sizeof(ubo_mat_s)) &&
-		CreateBuffer(vk_ubo_mvp_light_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			mem_prop_flags,
-			sizeof(ubo_mat_s)) &&
-		CreateBuffer(vk_ubo_mvp_sep_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			mem_prop_flags,
-			sizeof(ubo_mvp_sep_s)) &&
-		CreateBuffer(vk_ubo_mvp_fixed_light_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			mem_prop_flags,
-			sizeof(ubo_mat_s)) &&
-		CreateBuffer(vk_ubo_mvp_sep_fixed_,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			mem_prop_flags,
-			sizeof(ubo_mvp_sep_s)) &&
 		CreateBuffer(vk_ubo_viewer_,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			mem_prop_flags,
@@ -636,8 +657,8 @@ bool ShadowMapDemo::CreateDescriptorSetLayout_UBO4_Tex() {
 
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 1, VK_SHADER_STAGE_VERTEX_BIT);	// light mvp
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 0, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+	Vk_PushDescriptorSetLayoutBinding_DynamicUBO(bindings, 1, VK_SHADER_STAGE_VERTEX_BIT);	// light mvp
 	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 2, VK_SHADER_STAGE_FRAGMENT_BIT);
 	Vk_PushDescriptorSetLayoutBinding_UBO(bindings, 3, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);	// light
 	Vk_PushDescriptorSetLayoutBinding_Tex(bindings, 4, VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -701,23 +722,26 @@ bool ShadowMapDemo::AllocateDestriptorSets() {
 
 	update_desc_sets_buffer_s buffer;
 
+	// the per frame matrices, the command buffers pick the copy and the range with the dynamic offsets
+	VkBuffer ring = uniform_ring_.GetBuffer();
+
 	// overlay
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_overlay_, 0, vk_ubo_mvp_overlay_.buffer_, 0, vk_ubo_mvp_overlay_.memory_size_);
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_overlay_, 0, vk_ubo_mvp_overlay_.buffer_, sizeof(ubo_mat_s));
 	Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_overlay_, 4, vk_image_depth_);
 
 	// object
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_light_, 0, vk_ubo_mvp_light_.buffer_, 0, vk_ubo_mvp_light_.memory_size_);
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_light_, 0, ring, sizeof(ubo_mat_s));
 	
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_, 0, vk_ubo_mvp_sep_.buffer_, 0, vk_ubo_mvp_sep_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_, 1, vk_ubo_mvp_light_.buffer_, 0, vk_ubo_mvp_light_.memory_size_);
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_light_, 0, ring, sizeof(ubo_mvp_sep_s));
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_light_, 1, ring, sizeof(ubo_mat_s));
 	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_, 2, vk_ubo_viewer_.buffer_, 0, vk_ubo_viewer_.memory_size_);
 	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_, 3, vk_ubo_light_.buffer_, 0, vk_ubo_light_.memory_size_);
 	Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_mvp_viewer_light_, 4, vk_image_depth_);
 
 	// floor
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_fixed_light_, 0, vk_ubo_mvp_fixed_light_.buffer_, 0, vk_ubo_mvp_fixed_light_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 0, vk_ubo_mvp_sep_fixed_.buffer_, 0, vk_ubo_mvp_sep_fixed_.memory_size_);
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 1, vk_ubo_mvp_fixed_light_.buffer_, 0, vk_ubo_mvp_fixed_light_.memory_size_);
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_fixed_light_, 0, ring, sizeof(ubo_mat_s));
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 0, ring, sizeof(ubo_mvp_sep_s));
+	Vk_PushWriteDescriptorSet_DynamicUBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 1, ring, sizeof(ubo_mat_s));
 	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 2, vk_ubo_viewer_.buffer_, 0, vk_ubo_viewer_.memory_size_);
 	Vk_PushWriteDescriptorSet_UBO(buffer, vk_desc_set_mvp_viewer_light_fixed_, 3, vk_ubo_light_.buffer_, 0, vk_ubo_light_.memory_size_);
 	Vk_PushWriteDescriptorSet_Tex(buffer, vk_desc_set_mvp_viewer_light_fixed_, 4, vk_image_depth_);
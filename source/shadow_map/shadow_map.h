@@ -19,6 +19,7 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					Update();
+	bool					SwapchainImageCountChanged() override;
 
 protected:
 
@@ -47,17 +48,20 @@ private:
 	VkFramebuffer			vk_framebuffer_depth_;
 
 	vk_buffer_s				vk_ubo_mvp_overlay_;
-	vk_buffer_s				vk_ubo_mvp_light_;
-	vk_buffer_s				vk_ubo_mvp_sep_;
-	vk_buffer_s				vk_ubo_mvp_fixed_light_;
-	vk_buffer_s				vk_ubo_mvp_sep_fixed_;
 	vk_buffer_s				vk_ubo_viewer_;
 	vk_buffer_s				vk_ubo_light_;
 
+	// rewritten every frame, ranges of uniform_ring_
+	VkUniformRing			uniform_ring_;
+	uint32_t				ring_mvp_light_;
+	uint32_t				ring_mvp_sep_;
+	uint32_t				ring_mvp_fixed_light_;
+	uint32_t				ring_mvp_sep_fixed_;
+
 	// vbo
 	vk_buffer_s				vk_vbo_overlay_;
 
-	VkDescriptorSetLayout	vk_desc_set_layout_ubo4_tex_;
+	VkDescriptorSetLayout	vk_desc_set_layout_ubo4_tex_;	// bindings 0, 1: dynamic
 	VkDescriptorSetLayout	vk_desc_set_layout_ubo_tex_;
 
 	VkDescriptorSet			vk_desc_set_overlay_;
@@ -0,0 +1,310 @@
+/******************************************************************************
+ texcook
+
+   cook every bmp / png / tga texture under data/textures and data/models
+   (or the folders / files given on the command line) to a block compressed
+   DDS with its full mip chain, written next to the source as <name>.dds
+
+   files are cooked in parallel, the blocks of each file as well, the report
+   lists the size reduction, the level 0 PSNR and the encode throughput
+
+   usage: texcook [-q fast|normal|high] [-f box|kaiser] [-fmt auto|bc1|bc3|bc5|bc7]
+                  [-srgb] [-j threads] [folder | file ...]
+
+   auto format: BC5 for files named *normal*, BC3 when any texel is not
+   opaque, BC1 otherwise
+ *****************************************************************************/
+
+#include "../common/inc.h"
+#include <chrono>
+#include <filesystem>
+
+struct cook_options_s {
+	bc_quality_t			quality_;
+	mip_filter_t			filter_;
+	int						format_;		// -1: auto, otherwise image_format_t
+	bool					srgb_;
+	uint32_t				num_thread_;	// 0: hardware concurrency
+};
+
+struct cook_result_s {
+	bool					ok_;
+	int						width_;
+	int						height_;
+	image_format_t			format_;
+	int						mip_levels_;
+	size_t					raw_bytes_;		// RGBA8, every level
+	size_t					dds_bytes_;
+	double					psnr_;			// level 0
+	double					ms_;
+};
+
+static const char* FormatName(image_format_t fmt) {
+	switch (fmt) {
+	case image_format_t::BC1_UNORM: return "BC1";
+	case image_format_t::BC1_SRGB: return "BC1 srgb";
+	case image_format_t::BC3_UNORM: return "BC3";
+	case image_format_t::BC3_SRGB: return "BC3 srgb";
+	case image_format_t::BC5_UNORM: return "BC5";
+	case image_format_t::BC7_UNORM: return "BC7";
+	case image_format_t::BC7_SRGB: return "BC7 srgb";
+	default: return "?";
+	}
+}
+
+static image_format_t ChooseFormat(const char* filename, const image_s& image, const cook_options_s& options) {
+	std::string name = std::filesystem::path(filename).stem().string();
+	for (char& c : name) {
+		c = (char)tolower((unsigned char)c);
+	}
+
+	bool normal_map = name.find("normal") != std::string::npos;
+
+	image_format_t fmt;
+	if (options.format_ >= 0) {
+		fmt = (image_format_t)options.format_;
+	}
+	else if (normal_map) {
+		fmt = image_format_t::BC5_UNORM;
+	}
+	else {
+		fmt = image_format_t::BC1_UNORM;
+		for (int i = 0; i < image.width_ * image.height_; ++i) {
+			if (image.pixels_[i * 4 + 3] != 255) {
+				fmt = image_format_t::BC3_UNORM;
+				break;
+			}
+		}
+	}
+
+	// normal maps are data, never sRGB
+	if (options.srgb_ && !normal_map) {
+		switch (fmt) {
+		case image_format_t::BC1_UNORM: return image_format_t::BC1_SRGB;
+		case image_format_t::BC3_UNORM: return image_format_t::BC3_SRGB;
+		case image_format_t::BC7_UNORM: return image_format_t::BC7_SRGB;
+		default: break;
+		}
+	}
+
+	return fmt;
+}
+
+static double LevelPSNR(const image_s& source, const image_s& compressed, int channels) {
+	image_s decoded = {};
+	if (!Img_Decompress(compressed, 0, 0, decoded)) {
+		return 0.0;
+	}
+
+	double sum = 0.0;
+	size_t num_texel = (size_t)source.width_ * source.height_;
+	for (size_t i = 0; i < num_texel; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			double d = (double)source.pixels_[i * 4 + c] - decoded.pixels_[i * 4 + c];
+			sum += d * d;
+		}
+	}
+
+	Img_Free(decoded);
+
+	double mse = sum / (num_texel * channels);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static bool CookTexture(const char* filename, const cook_options_s& options, cook_result_s& result) {
+	auto t0 = std::chrono::steady_clock::now();
+
+	memset(&result, 0, sizeof(result));
+
+	// DDS blocks start at the top row, decoded in that order
+	image_load_s load = {};
+	load.filename_ = filename;
+	load.top_first_ = true;
+	if (!Img_LoadBatch(&load, 1)) {
+		return false;
+	}
+
+	image_s& image = load.image_;
+
+	image_format_t fmt = ChooseFormat(filename, image, options);
+	bool srgb = fmt == image_format_t::BC1_SRGB || fmt == image_format_t::BC3_SRGB || fmt == image_format_t::BC7_SRGB;
+
+	image_s mipmapped = {}, compressed = {};
+	bool ok = Img_GenerateMipmaps(image, options.filter_, srgb, mipmapped)
+		&& Img_Compress(mipmapped, fmt, options.quality_, compressed);
+
+	if (ok) {
+		std::filesystem::path dds_filename = std::filesystem::path(filename).replace_extension(".dds");
+		ok = Img_Save(dds_filename.string().c_str(), compressed);
+	}
+
+	if (ok) {
+		int channels = fmt == image_format_t::BC5_UNORM ? 2 : (fmt == image_format_t::BC1_UNORM || fmt == image_format_t::BC1_SRGB ? 3 : 4);
+
+		result.width_ = image.width_;
+		result.height_ = image.height_;
+		result.format_ = fmt;
+		result.mip_levels_ = mipmapped.mip_levels_;
+		result.raw_bytes_ = Img_GetDataSize(mipmapped);
+		result.dds_bytes_ = Img_GetDataSize(compressed);
+		result.psnr_ = LevelPSNR(image, compressed, channels);
+	}
+
+	Img_Free(compressed);
+	Img_Free(mipmapped);
+	Img_Free(image);
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	result.ok_ = ok;
+	result.ms_ = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+	return ok;
+}
+
+static void PrintUsage() {
+	printf("usage: texcook [-q fast|normal|high] [-f box|kaiser] [-fmt auto|bc1|bc3|bc5|bc7] [-srgb] [-j threads] [folder | file ...]\n");
+}
+
+int main(int argc, char** argv) {
+	Common_Init();
+
+	cook_options_s options = { bc_quality_t::NORMAL, mip_filter_t::KAISER, -1, false, 0 };
+
+	std::vector<std::filesystem::path> inputs;
+
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : "";
+
+		if (!strcmp(arg, "-q")) {
+			if (!Str_ICmp(value, "fast")) options.quality_ = bc_quality_t::FAST;
+			else if (!Str_ICmp(value, "normal")) options.quality_ = bc_quality_t::NORMAL;
+			else if (!Str_ICmp(value, "high")) options.quality_ = bc_quality_t::HIGH;
+			else { PrintUsage(); return 1; }
+			i++;
+		}
+		else if (!strcmp(arg, "-f")) {
+			if (!Str_ICmp(value, "box")) options.filter_ = mip_filter_t::BOX;
+			else if (!Str_ICmp(value, "kaiser")) options.filter_ = mip_filter_t::KAISER;
+			else { PrintUsage(); return 1; }
+			i++;
+		}
+		else if (!strcmp(arg, "-fmt")) {
+			if (!Str_ICmp(value, "auto")) options.format_ = -1;
+			else if (!Str_ICmp(value, "bc1")) options.format_ = (int)image_format_t::BC1_UNORM;
+			else if (!Str_ICmp(value, "bc3")) options.format_ = (int)image_format_t::BC3_UNORM;
+			else if (!Str_ICmp(value, "bc5")) options.format_ = (int)image_format_t::BC5_UNORM;
+			else if (!Str_ICmp(value, "bc7")) options.format_ = (int)image_format_t::BC7_UNORM;
+			else { PrintUsage(); return 1; }
+			i++;
+		}
+		else if (!strcmp(arg, "-srgb")) {
+			options.srgb_ = true;
+		}
+		else if (!strcmp(arg, "-j")) {
+			options.num_thread_ = (uint32_t)atoi(value);
+			i++;
+		}
+		else if (arg[0] == '-') {
+			PrintUsage();
+			return 1;
+		}
+		else {
+			inputs.push_back(std::filesystem::path(arg));
+		}
+	}
+
+	if (inputs.empty()) {
+		char folder[MAX_PATH];
+		Str_SPrintf(folder, COUNT_OF(folder), "%s/textures", GetDataFolder());
+		inputs.push_back(std::filesystem::path(folder));
+		Str_SPrintf(folder, COUNT_OF(folder), "%s/models", GetDataFolder());
+		inputs.push_back(std::filesystem::path(folder));
+	}
+
+	auto IsTexture = [](const std::filesystem::path& path) {
+		std::string ext = path.extension().string();
+		return !Str_ICmp(ext.c_str(), ".bmp") || !Str_ICmp(ext.c_str(), ".png") || !Str_ICmp(ext.c_str(), ".tga");
+	};
+
+	std::vector<std::string> files;
+	int num_failed = 0;
+
+	for (const std::filesystem::path& input : inputs) {
+		if (std::filesystem::is_regular_file(input)) {
+			files.push_back(input.string());
+			continue;
+		}
+
+		std::error_code ec;
+		std::filesystem::recursive_directory_iterator it(input, ec);
+		if (ec) {
+			printf("could not open folder %s\n", input.string().c_str());
+			num_failed++;
+			continue;
+		}
+
+		for (const std::filesystem::directory_entry& entry : it) {
+			if (entry.is_regular_file() && IsTexture(entry.path())) {
+				files.push_back(entry.path().string());
+			}
+		}
+	}
+
+	// one job per file, the block rows of each file are jobs too, idle threads steal either
+	if (options.num_thread_) {
+		Job_Init(options.num_thread_);
+	}
+	uint32_t num_thread = Job_GetWorkerCount() + 1;
+
+	std::vector<cook_result_s> results(files.size());
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	Job_ParallelFor(0, (uint32_t)files.size(), 1, [&](uint32_t file_begin, uint32_t file_end) {
+		for (uint32_t f = file_begin; f < file_end; ++f) {
+			CookTexture(files[f].c_str(), options, results[f]);
+		}
+	});
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	printf("%-60s %11s %-8s %4s %12s %12s %7s %8s %10s %10s\n", "texture", "size", "format", "mips",
+		"rgba bytes", "dds bytes", "ratio", "psnr", "ms", "MPix/s");
+
+	size_t total_raw = 0, total_dds = 0, total_texel = 0;
+	int num_cooked = 0;
+
+	for (size_t f = 0; f < files.size(); ++f) {
+		const cook_result_s& r = results[f];
+		if (!r.ok_) {
+			printf("%-60s cook failed\n", files[f].c_str());
+			num_failed++;
+			continue;
+		}
+
+		char size[32];
+		Str_SPrintf(size, COUNT_OF(size), "%dx%d", r.width_, r.height_);
+
+		size_t num_texel = r.raw_bytes_ / 4;
+		printf("%-60s %11s %-8s %4d %12zu %12zu %6.2fx %8.2f %10.2f %10.2f\n", files[f].c_str(), size,
+			FormatName(r.format_), r.mip_levels_, r.raw_bytes_, r.dds_bytes_, (double)r.raw_bytes_ / r.dds_bytes_,
+			r.psnr_, r.ms_, num_texel / (r.ms_ * 1000.0));
+
+		total_raw += r.raw_bytes_;
+		total_dds += r.dds_bytes_;
+		total_texel += num_texel;
+		num_cooked++;
+	}
+
+	double seconds = std::chrono::duration<double>(t1 - t0).count();
+
+	printf("%d cooked, %d failed: %zu -> %zu bytes (%.2fx), %.2f s, %.2f MPix/s on %u threads\n",
+		num_cooked, num_failed, total_raw, total_dds, total_dds ? (double)total_raw / total_dds : 0.0,
+		seconds, seconds > 0.0 ? total_texel / (seconds * 1.0e6) : 0.0, num_thread);
+
+	Common_Shutdown();
+
+	return num_failed ? 1 : 0;
+}
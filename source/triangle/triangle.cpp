@@ -13,7 +13,6 @@ TriangleDemo
 
 TriangleDemo::TriangleDemo():
 	vk_descriptorset_layout_(VK_NULL_HANDLE),
-	vk_descriptorset_(VK_NULL_HANDLE),
 	vk_pipeline_layout_(VK_NULL_HANDLE),
 	vk_pipeline_(VK_NULL_HANDLE),
 	revert_y_by_proj_mat_(false),
@@ -28,8 +27,10 @@ TriangleDemo::TriangleDemo():
 	fovy_ = 45.0f;
 
 	cfg_viewport_cy_ = cfg_viewport_cx_ = 480;
+	cfg_frame_uniform_copies_ = true;
 
-	memset(&uniform_buffer_mvp_, 0, sizeof(uniform_buffer_mvp_));
+	memset(uniform_buffer_mvp_, 0, sizeof(uniform_buffer_mvp_));
+	memset(vk_descriptorsets_, 0, sizeof(vk_descriptorsets_));
 	memset(&vertex_buffer_, 0, sizeof(vertex_buffer_));
 }
 
@@ -39,7 +40,7 @@ TriangleDemo::~TriangleDemo() {
 
 bool TriangleDemo::Init() {
 	if (!VkDemo::Init("triangle" /* shader files directory */,
-		1, 0, 0, 1)) {
+		MAX_SWAPCHAIN_IMAGES, 0, 0, MAX_SWAPCHAIN_IMAGES)) {
 		return false;
 	}
 
@@ -172,7 +173,7 @@ void TriangleDemo::BuildCommandBuffers() {
 
 		vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 
-		VkDescriptorSet descriptor_sets[1] = { vk_descriptorset_ };
+		VkDescriptorSet descriptor_sets[1] = { vk_descriptorsets_[i] };
 
 		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			vk_pipeline_layout_, 0, 1, descriptor_sets, 0, nullptr);
@@ -225,16 +226,32 @@ void TriangleDemo::FuncKeyDown(uint32_t key) {
 	}
 }
 
+bool TriangleDemo::SwapchainImageCountChanged() {
+	// the uniforms are all per image, so are the descriptor sets
+	FreeDescriptorSets();
+	DestroyUniformBuffer();
+
+	return CreateUniformBuffer() && AllocDescriptorSets();
+}
+
 // uniform buffer
 bool TriangleDemo::CreateUniformBuffer() {
-	return CreateBuffer(uniform_buffer_mvp_, 
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(ubo_mat_s));
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (!CreateBuffer(uniform_buffer_mvp_[i],
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sizeof(ubo_mat_s))) {
+			return false;
+		}
+	}
+
+	return true;
 }
 
 void TriangleDemo::DestroyUniformBuffer() {
-	DestroyBuffer(uniform_buffer_mvp_);
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		DestroyBuffer(uniform_buffer_mvp_[i]);
+	}
 }
 
 // vertex buffer
@@ -290,34 +307,32 @@ bool TriangleDemo::AllocDescriptorSets() {
 	allocate_info.descriptorSetCount = 1;
 	allocate_info.pSetLayouts = set_layouts;
 
-	VkDescriptorSet sets[1] = {};
-
-	if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, sets)) {
-		return false;
-	}
-
-	vk_descriptorset_ = sets[0];
+	// one set per image, each on its own uniform copy
+	for (int i = 0; i < vk_swapchain_image_count_; ++i) {
+		if (VK_SUCCESS != vkAllocateDescriptorSets(vk_device_, &allocate_info, vk_descriptorsets_ + i)) {
+			return false;
+		}
 
-	update_desc_sets_buffer_s buffer;
+		update_desc_sets_buffer_s buffer;
 
-	Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorset_,
-		0, uniform_buffer_mvp_.buffer_, 0, uniform_buffer_mvp_.memory_size_);
+		Vk_PushWriteDescriptorSet_UBO(buffer, vk_descriptorsets_[i],
+			0, uniform_buffer_mvp_[i].buffer_, 0, uniform_buffer_mvp_[i].memory_size_);
 
-	vkUpdateDescriptorSets(vk_device_, 
-		(uint32_t)buffer.write_descriptor_sets_.size(), 
-		buffer.write_descriptor_sets_.data(), 0, nullptr);
+		vkUpdateDescriptorSets(vk_device_, 
+			(uint32_t)buffer.write_descriptor_sets_.size(), 
+			buffer.write_descriptor_sets_.data(), 0, nullptr);
+	}
 
 	return true;
 }
 
 void TriangleDemo::FreeDescriptorSets() {
-	if (vk_descriptorset_) {
-		VkDescriptorSet sets[1] = {
-			vk_descriptorset_
-		};
-		vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, sets);
+	for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
+		if (vk_descriptorsets_[i]) {
+			vkFreeDescriptorSets(vk_device_, vk_descriptor_pool_, 1, vk_descriptorsets_ + i);
 
-		vk_descriptorset_ = VK_NULL_HANDLE;
+			vk_descriptorsets_[i] = VK_NULL_HANDLE;
+		}
 	}
 }
 
@@ -383,7 +398,8 @@ void TriangleDemo::UpdateUniformBuffer() {
 
 	ubo_mvp.matrix_ = proj_mat * view_mat * model_mat;
 
-	UpdateBuffer(uniform_buffer_mvp_, &ubo_mvp, sizeof(ubo_mvp));
+	// the copy of the image this frame draws to, the other copies may still be read by the GPU
+	UpdateBuffer(uniform_buffer_mvp_[vk_current_image_], &ubo_mvp, sizeof(ubo_mvp));
 }
 
 /*
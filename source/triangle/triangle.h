@@ -18,6 +18,7 @@ public:
 	void					Shutdown();
 	void					BuildCommandBuffers() override;
 	void					Update() override;
+	bool					SwapchainImageCountChanged() override;
 
 protected:
 
@@ -25,13 +26,13 @@ protected:
 
 private:
 
-	vk_buffer_s				uniform_buffer_mvp_;
+	vk_buffer_s				uniform_buffer_mvp_[MAX_SWAPCHAIN_IMAGES];	// per image, see cfg_frame_uniform_copies_
 
 	vk_buffer_s				vertex_buffer_;
 
 	// descriptor
 	VkDescriptorSetLayout   vk_descriptorset_layout_;
-	VkDescriptorSet         vk_descriptorset_;
+	VkDescriptorSet         vk_descriptorsets_[MAX_SWAPCHAIN_IMAGES];
 
 	// pipeline
 	VkPipelineLayout		vk_pipeline_layout_;